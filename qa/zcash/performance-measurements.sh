@@ -221,6 +221,15 @@ case "$1" in
                 extract_benchmark_data
                 zcash_rpc zcbenchmark connectblockslow 10
                 ;;
+            replaychain)
+                zcash_rpc_slow zcbenchmark replaychain 5 "${@:3}"
+                ;;
+            replaymempool)
+                zcash_rpc zcbenchmark replaymempool 10 "${@:3}"
+                ;;
+            createblocktemplate)
+                zcash_rpc zcbenchmark createblocktemplate 10
+                ;;
             sendtoaddress)
                 zcash_rpc zcbenchmark sendtoaddress 10 "${@:4}"
                 ;;
@@ -283,6 +292,15 @@ case "$1" in
                 extract_benchmark_data
                 zcash_rpc zcbenchmark connectblockslow 1
                 ;;
+            replaychain)
+                zcash_rpc_slow zcbenchmark replaychain 1 "${@:3}"
+                ;;
+            replaymempool)
+                zcash_rpc zcbenchmark replaymempool 1 "${@:3}"
+                ;;
+            createblocktemplate)
+                zcash_rpc zcbenchmark createblocktemplate 1
+                ;;
             sendtoaddress)
                 zcash_rpc zcbenchmark sendtoaddress 1 "${@:4}"
                 ;;
@@ -343,6 +361,15 @@ case "$1" in
                 extract_benchmark_data
                 zcash_rpc zcbenchmark connectblockslow 1
                 ;;
+            replaychain)
+                zcash_rpc_veryslow zcbenchmark replaychain 1 "${@:3}"
+                ;;
+            replaymempool)
+                zcash_rpc_slow zcbenchmark replaymempool 1 "${@:3}"
+                ;;
+            createblocktemplate)
+                zcash_rpc zcbenchmark createblocktemplate 1
+                ;;
             *)
                 zcashd_valgrind_stop
                 echo "Bad arguments to valgrind."
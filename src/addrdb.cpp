@@ -87,13 +87,14 @@ bool CBanDB::Read(banmap_t& banSet)
     }
     filein.fclose();
 
-    CDataStream ssBanlist(vchData, SER_DISK, CLIENT_VERSION);
-
     // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssBanlist.begin(), ssBanlist.end());
+    uint256 hashTmp = Hash(vchData.begin(), vchData.end());
     if (hashIn != hashTmp)
         return error("%s: Checksum mismatch, data corrupted", __func__);
 
+    // deserialize straight from the file buffer
+    CSpanReader ssBanlist(SER_DISK, CLIENT_VERSION, vchData);
+
     unsigned char pchMsgTmp[4];
     try {
         // de-serialize file header (network specific magic number) and ..
@@ -116,6 +117,7 @@ bool CBanDB::Read(banmap_t& banSet)
 CAddrDB::CAddrDB()
 {
     pathAddr = GetDataDir() / "peers.dat";
+    pathAddrJournal = GetDataDir() / "peers.dat.journal";
 }
 
 bool CAddrDB::Write(const CAddrMan& addr)
@@ -156,6 +158,30 @@ bool CAddrDB::Write(const CAddrMan& addr)
     return true;
 }
 
+template <typename Stream>
+static bool ReadAddrMan(CAddrMan& addr, Stream& ssPeers)
+{
+    unsigned char pchMsgTmp[4];
+    try {
+        // de-serialize file header (network specific magic number) and ..
+        ssPeers >> FLATDATA(pchMsgTmp);
+
+        // ... verify the network matches ours
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: Invalid network magic number", __func__);
+
+        // de-serialize address data into one CAddrMan object
+        ssPeers >> addr;
+    }
+    catch (const std::exception& e) {
+        // de-serialization has failed, ensure addrman is left in a clean state
+        addr.Clear();
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
 bool CAddrDB::Read(CAddrMan& addr)
 {
     // open input file, and associate with CAutoFile
@@ -184,35 +210,128 @@ bool CAddrDB::Read(CAddrMan& addr)
     }
     filein.fclose();
 
-    CDataStream ssPeers(vchData, SER_DISK, CLIENT_VERSION);
-
     // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssPeers.begin(), ssPeers.end());
+    uint256 hashTmp = Hash(vchData.begin(), vchData.end());
     if (hashIn != hashTmp)
         return error("%s: Checksum mismatch, data corrupted", __func__);
 
-    return Read(addr, ssPeers);
+    // deserialize straight from the file buffer
+    CSpanReader ssPeers(SER_DISK, CLIENT_VERSION, vchData);
+    return ReadAddrMan(addr, ssPeers);
 }
 
 bool CAddrDB::Read(CAddrMan& addr, CDataStream& ssPeers)
 {
-    unsigned char pchMsgTmp[4];
-    try {
-        // de-serialize file header (network specific magic number) and ..
-        ssPeers >> FLATDATA(pchMsgTmp);
+    return ReadAddrMan(addr, ssPeers);
+}
 
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
-            return error("%s: Invalid network magic number", __func__);
+bool CAddrDB::HaveSnapshot() const
+{
+    return fs::exists(pathAddr);
+}
 
-        // de-serialize address data into one CAddrMan object
-        ssPeers >> addr;
+uint64_t CAddrDB::JournalSize() const
+{
+    boost::system::error_code ec;
+    uint64_t size = fs::file_size(pathAddrJournal, ec);
+    return ec ? 0 : size;
+}
+
+void CAddrDB::RemoveJournal()
+{
+    boost::system::error_code ec;
+    fs::remove(pathAddrJournal, ec);
+}
+
+bool CAddrDB::AppendJournal(const std::vector<CAddrInfo>& vDelta)
+{
+    if (vDelta.empty())
+        return true;
+
+    // serialize the delta, checksum data up to that point, then append csum
+    CDataStream ssDelta(SER_DISK, CLIENT_VERSION);
+    ssDelta << FLATDATA(Params().MessageStart());
+    ssDelta << vDelta;
+    uint256 hash = Hash(ssDelta.begin(), ssDelta.end());
+    ssDelta << hash;
+
+    FILE *file = fsbridge::fopen(pathAddrJournal, "ab");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathAddrJournal.string());
+
+    // Each record is written as a length-prefixed blob, so the reader can
+    // frame records and stop cleanly at a torn tail.
+    try {
+        fileout << std::vector<unsigned char>(ssDelta.begin(), ssDelta.end());
     }
     catch (const std::exception& e) {
-        // de-serialization has failed, ensure addrman is left in a clean state
-        addr.Clear();
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    return true;
+}
+
+bool CAddrDB::ReplayJournal(CAddrMan& addr)
+{
+    if (!fs::exists(pathAddrJournal))
+        return true;
+
+    FILE *file = fsbridge::fopen(pathAddrJournal, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathAddrJournal.string());
+
+    int nRecords = 0;
+    int nAddresses = 0;
+    while (true) {
+        std::vector<unsigned char> vchRecord;
+        try {
+            filein >> vchRecord;
+        }
+        catch (const std::exception&) {
+            // end of journal (or a torn length prefix from an interrupted append)
+            break;
+        }
+        if (vchRecord.size() < sizeof(uint256) + 4)
+            break;
+
+        // verify the per-record checksum; a mismatch means a torn append,
+        // so everything from here on is discarded
+        uint256 hashIn;
+        memcpy(hashIn.begin(), vchRecord.data() + vchRecord.size() - sizeof(uint256), sizeof(uint256));
+        uint256 hashTmp = Hash(vchRecord.begin(), vchRecord.end() - sizeof(uint256));
+        if (hashIn != hashTmp) {
+            LogPrintf("%s: Checksum mismatch in journal record %d; ignoring the rest\n", __func__, nRecords);
+            break;
+        }
+        vchRecord.resize(vchRecord.size() - sizeof(uint256));
+
+        CSpanReader ssDelta(SER_DISK, CLIENT_VERSION, vchRecord);
+        unsigned char pchMsgTmp[4];
+        std::vector<CAddrInfo> vDelta;
+        try {
+            ssDelta >> FLATDATA(pchMsgTmp);
+            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+                return error("%s: Invalid network magic number", __func__);
+            ssDelta >> vDelta;
+        }
+        catch (const std::exception& e) {
+            LogPrintf("%s: Failed to deserialize journal record %d - %s\n", __func__, nRecords, e.what());
+            break;
+        }
+
+        for (const CAddrInfo& info : vDelta)
+            addr.AddJournaled(info);
+        nRecords++;
+        nAddresses += vDelta.size();
     }
+    filein.fclose();
+
+    if (nRecords > 0)
+        LogPrintf("Replayed %d addresses from %d peers.dat journal records\n", nAddresses, nRecords);
 
     return true;
 }
@@ -14,6 +14,7 @@
 #include <map>
 
 class CSubNet;
+class CAddrInfo;
 class CAddrMan;
 
 typedef enum BanReason
@@ -76,16 +77,34 @@ public:
 
 typedef std::map<CSubNet, CBanEntry> banmap_t;
 
-/** Access to the (IP) address database (peers.dat) */
+/** Access to the (IP) address database (peers.dat).
+ *
+ * Besides full snapshots, an append-only journal (peers.dat.journal) holds
+ * the addresses changed since the last snapshot. Periodic dumps append only
+ * the delta; once the journal grows past a threshold it is compacted back
+ * into a fresh snapshot. Each journal record is individually checksummed, so
+ * a torn append just truncates the replay at the damaged record.
+ */
 class CAddrDB
 {
 private:
     fs::path pathAddr;
+    fs::path pathAddrJournal;
 public:
     CAddrDB();
     bool Write(const CAddrMan& addr);
     bool Read(CAddrMan& addr);
     bool Read(CAddrMan& addr, CDataStream& ssPeers);
+    //! Whether a peers.dat snapshot exists to journal against.
+    bool HaveSnapshot() const;
+    //! Append one delta record to the journal.
+    bool AppendJournal(const std::vector<CAddrInfo>& vDelta);
+    //! Re-apply the journal on top of a freshly read snapshot.
+    bool ReplayJournal(CAddrMan& addr);
+    //! Drop the journal (after it has been compacted into a snapshot).
+    void RemoveJournal();
+    //! Current journal size in bytes (0 if absent).
+    uint64_t JournalSize() const;
 };
 
 /** Access to the banlist database (banlist.dat) */
@@ -88,6 +88,34 @@ struct CAddressUnspentValue {
     }
 };
 
+/** Running totals for one address, keyed by CAddressIndexIteratorKey.
+ *  Maintained as blocks connect and disconnect so that balance queries are a
+ *  single point read instead of a sum over every historical delta. */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    int nHeight; //!< height of the last block folded into the totals
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(nHeight);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        nHeight = -1;
+    }
+};
+
 struct CAddressIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -127,9 +127,48 @@ void CAddrMan::Delete(int nId)
     vRandom.pop_back();
     mapAddr.erase(info);
     mapInfo.erase(nId);
+    setDirty.erase(nId);
     nNew--;
 }
 
+void CAddrMan::OccupySlot(std::vector<int>& vOccupied, std::vector<int>& vSlotIndex, int nSlot)
+{
+    assert(vSlotIndex[nSlot] == -1);
+    vSlotIndex[nSlot] = vOccupied.size();
+    vOccupied.push_back(nSlot);
+}
+
+void CAddrMan::FreeSlot(std::vector<int>& vOccupied, std::vector<int>& vSlotIndex, int nSlot)
+{
+    int nIndex = vSlotIndex[nSlot];
+    assert(nIndex != -1 && vOccupied[nIndex] == nSlot);
+    int nSlotLast = vOccupied.back();
+    vOccupied[nIndex] = nSlotLast;
+    vSlotIndex[nSlotLast] = nIndex;
+    vOccupied.pop_back();
+    vSlotIndex[nSlot] = -1;
+}
+
+void CAddrMan::RebuildSlotCaches()
+{
+    vTriedOccupied.clear();
+    vNewOccupied.clear();
+    vTriedSlotIndex.assign(ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE, -1);
+    vNewSlotIndex.assign(ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE, -1);
+    for (int bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
+        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            if (vvTried[bucket][i] != -1)
+                OccupySlot(vTriedOccupied, vTriedSlotIndex, bucket * ADDRMAN_BUCKET_SIZE + i);
+        }
+    }
+    for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
+        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            if (vvNew[bucket][i] != -1)
+                OccupySlot(vNewOccupied, vNewSlotIndex, bucket * ADDRMAN_BUCKET_SIZE + i);
+        }
+    }
+}
+
 void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
 {
     // if there is an entry in the specified bucket, delete it.
@@ -139,6 +178,7 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
         vvNew[nUBucket][nUBucketPos] = -1;
+        FreeSlot(vNewOccupied, vNewSlotIndex, nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -152,6 +192,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         int pos = info.GetBucketPosition(nKey, true, bucket);
         if (vvNew[bucket][pos] == nId) {
             vvNew[bucket][pos] = -1;
+            FreeSlot(vNewOccupied, vNewSlotIndex, bucket * ADDRMAN_BUCKET_SIZE + pos);
             info.nRefCount--;
         }
     }
@@ -173,6 +214,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
         vvTried[nKBucket][nKBucketPos] = -1;
+        FreeSlot(vTriedOccupied, vTriedSlotIndex, nKBucket * ADDRMAN_BUCKET_SIZE + nKBucketPos);
         nTried--;
 
         // find which new bucket it belongs to
@@ -184,11 +226,13 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
         vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        OccupySlot(vNewOccupied, vNewSlotIndex, nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos);
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
     vvTried[nKBucket][nKBucketPos] = nId;
+    OccupySlot(vTriedOccupied, vTriedSlotIndex, nKBucket * ADDRMAN_BUCKET_SIZE + nKBucketPos);
     nTried++;
     info.fInTried = true;
 }
@@ -212,6 +256,7 @@ void CAddrMan::Good_(const CService& addr, int64_t nTime)
     info.nLastSuccess = nTime;
     info.nLastTry = nTime;
     info.nAttempts = 0;
+    setDirty.insert(nId);
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
 
@@ -252,6 +297,8 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
     CAddrInfo* pinfo = Find(addr, &nId);
 
     if (pinfo) {
+        setDirty.insert(nId);
+
         // periodically update nTime
         bool fCurrentlyOnline = (GetTime() - addr.nTime < 24 * 60 * 60);
         int64_t nUpdateInterval = (fCurrentlyOnline ? 60 * 60 : 24 * 60 * 60);
@@ -284,6 +331,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         pinfo->nTime = std::max((int64_t)0, (int64_t)pinfo->nTime - nTimePenalty);
         nNew++;
         fNew = true;
+        setDirty.insert(nId);
     }
 
     int nUBucket = pinfo->GetNewBucket(nKey, source);
@@ -301,6 +349,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
             vvNew[nUBucket][nUBucketPos] = nId;
+            OccupySlot(vNewOccupied, vNewSlotIndex, nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos);
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -312,7 +361,8 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
 
 void CAddrMan::Attempt_(const CService& addr, int64_t nTime)
 {
-    CAddrInfo* pinfo = Find(addr);
+    int nId;
+    CAddrInfo* pinfo = Find(addr, &nId);
 
     // if not found, bail out
     if (!pinfo)
@@ -327,6 +377,7 @@ void CAddrMan::Attempt_(const CService& addr, int64_t nTime)
     // update info
     info.nLastTry = nTime;
     info.nAttempts++;
+    setDirty.insert(nId);
 }
 
 CAddrInfo CAddrMan::Select_(bool newOnly)
@@ -334,32 +385,23 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
     if (size() == 0)
         return CAddrInfo();
 
-    // Track number of attempts to find a table entry, before giving up to avoid infinite loop
-    const int kMaxRetries = 200000;         // magic number so unit tests can pass
-    const int kRetriesBetweenSleep = 1000;
-    const int kRetrySleepInterval = 100;    // milliseconds
-
     if (newOnly && nNew == 0)
         return CAddrInfo();
 
     // Use a 50% chance for choosing between tried and new table entries.
+    // Drawing a uniformly random occupied slot is equivalent to the old
+    // rejection sampling over random (bucket, position) pairs, but runs in
+    // O(1) regardless of how sparse the tables are, so Select_ no longer
+    // spins (or sleeps) while holding cs.
     if (!newOnly &&
        (nTried > 0 && (nNew == 0 || RandomInt(2) == 0))) {
         // use a tried node
+        if (vTriedOccupied.empty())
+            return CAddrInfo();
         double fChanceFactor = 1.0;
         while (1) {
-            int i = 0;
-            int nKBucket = RandomInt(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = RandomInt(ADDRMAN_BUCKET_SIZE);
-            while (vvTried[nKBucket][nKBucketPos] == -1) {
-                nKBucket = (nKBucket + insecure_rand.randbits(ADDRMAN_TRIED_BUCKET_COUNT_LOG2)) % ADDRMAN_TRIED_BUCKET_COUNT;
-                nKBucketPos = (nKBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
-                if (i++ > kMaxRetries)
-                    return CAddrInfo();
-                if (i % kRetriesBetweenSleep == 0 && !nKey.IsNull())
-                    MilliSleep(kRetrySleepInterval);
-            }
-            int nId = vvTried[nKBucket][nKBucketPos];
+            int nSlot = vTriedOccupied[RandomInt(vTriedOccupied.size())];
+            int nId = vvTried[nSlot / ADDRMAN_BUCKET_SIZE][nSlot % ADDRMAN_BUCKET_SIZE];
             assert(mapInfo.count(nId) == 1);
             CAddrInfo& info = mapInfo[nId];
             if (RandomInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
@@ -368,20 +410,12 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
         }
     } else {
         // use a new node
+        if (vNewOccupied.empty())
+            return CAddrInfo();
         double fChanceFactor = 1.0;
         while (1) {
-            int i = 0;
-            int nUBucket = RandomInt(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = RandomInt(ADDRMAN_BUCKET_SIZE);
-            while (vvNew[nUBucket][nUBucketPos] == -1) {
-                nUBucket = (nUBucket + insecure_rand.randbits(ADDRMAN_NEW_BUCKET_COUNT_LOG2)) % ADDRMAN_NEW_BUCKET_COUNT;
-                nUBucketPos = (nUBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
-                if (i++ > kMaxRetries)
-                    return CAddrInfo();
-                if (i % kRetriesBetweenSleep == 0 && !nKey.IsNull())
-                    MilliSleep(kRetrySleepInterval);
-            }
-            int nId = vvNew[nUBucket][nUBucketPos];
+            int nSlot = vNewOccupied[RandomInt(vNewOccupied.size())];
+            int nId = vvNew[nSlot / ADDRMAN_BUCKET_SIZE][nSlot % ADDRMAN_BUCKET_SIZE];
             assert(mapInfo.count(nId) == 1);
             CAddrInfo& info = mapInfo[nId];
             if (RandomInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
@@ -435,6 +469,8 @@ int CAddrMan::Check_()
 
     for (int n = 0; n < ADDRMAN_TRIED_BUCKET_COUNT; n++) {
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+             if ((vvTried[n][i] != -1) != (vTriedSlotIndex[n * ADDRMAN_BUCKET_SIZE + i] != -1))
+                 return -20;
              if (vvTried[n][i] != -1) {
                  if (!setTried.count(vvTried[n][i]))
                      return -11;
@@ -449,6 +485,8 @@ int CAddrMan::Check_()
 
     for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            if ((vvNew[n][i] != -1) != (vNewSlotIndex[n * ADDRMAN_BUCKET_SIZE + i] != -1))
+                return -21;
             if (vvNew[n][i] != -1) {
                 if (!mapNew.count(vvNew[n][i]))
                     return -12;
@@ -204,6 +204,21 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! Occupied positions in each table, encoded as bucket * ADDRMAN_BUCKET_SIZE + position.
+    //! Kept in sync with vvTried/vvNew so Select_ can draw a uniformly random occupied
+    //! slot in O(1) instead of probing random (mostly empty) slots under cs.
+    std::vector<int> vTriedOccupied;
+    std::vector<int> vNewOccupied;
+
+    //! Reverse index: encoded position -> index into the occupied vector, or -1.
+    std::vector<int> vTriedSlotIndex;
+    std::vector<int> vNewSlotIndex;
+
+    //! nIds of entries changed since the dirty set was last drained (memory
+    //! only). Feeds the incremental peers.dat journal, so periodic dumps can
+    //! persist just the delta instead of reserializing every address.
+    std::set<int> setDirty;
+
 protected:
     //! secret key to randomize bucket select with
     uint256 nKey;
@@ -230,6 +245,15 @@ protected:
     //! Clear a position in a "new" table. This is the only place where entries are actually deleted.
     void ClearNew(int nUBucket, int nUBucketPos);
 
+    //! Record an encoded table position as occupied (swap-and-pop bookkeeping).
+    static void OccupySlot(std::vector<int>& vOccupied, std::vector<int>& vSlotIndex, int nSlot);
+
+    //! Record an encoded table position as free again.
+    static void FreeSlot(std::vector<int>& vOccupied, std::vector<int>& vSlotIndex, int nSlot);
+
+    //! Rebuild the occupied-slot caches from vvTried/vvNew (after deserialization).
+    void RebuildSlotCaches();
+
     //! Mark an entry "good", possibly moving it from "new" to "tried".
     void Good_(const CService &addr, int64_t nTime);
 
@@ -439,6 +463,8 @@ public:
             LogPrint("addrman", "addrman lost %i new and %i tried addresses due to collisions\n", nLostUnk, nLost);
         }
 
+        RebuildSlotCaches();
+
         Check();
     }
 
@@ -457,10 +483,15 @@ public:
                 vvTried[bucket][entry] = -1;
             }
         }
+        vTriedOccupied.clear();
+        vNewOccupied.clear();
+        vTriedSlotIndex.assign(ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE, -1);
+        vNewSlotIndex.assign(ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE, -1);
 
         nIdCount = 0;
         nTried = 0;
         nNew = 0;
+        setDirty.clear();
     }
 
     CAddrMan()
@@ -520,6 +551,36 @@ public:
         return nAdd > 0;
     }
 
+    //! Extract the entries changed since the last drain, for appending to
+    //! the on-disk journal. Entries deleted in the meantime are skipped;
+    //! the next full snapshot drops them from disk too.
+    void GetDirty(std::vector<CAddrInfo> &vInfo)
+    {
+        LOCK(cs);
+        vInfo.reserve(setDirty.size());
+        for (int nId : setDirty) {
+            std::map<int, CAddrInfo>::const_iterator it = mapInfo.find(nId);
+            if (it != mapInfo.end())
+                vInfo.push_back(it->second);
+        }
+        setDirty.clear();
+    }
+
+    //! Re-apply one journal entry: add the address and restore the persisted
+    //! connection statistics that a plain Add would lose.
+    void AddJournaled(const CAddrInfo &entry)
+    {
+        LOCK(cs);
+        Check();
+        Add_(entry, entry.source, 0);
+        CAddrInfo* pinfo = Find(entry);
+        if (pinfo) {
+            pinfo->nLastSuccess = std::max(pinfo->nLastSuccess, entry.nLastSuccess);
+            pinfo->nAttempts = std::max(pinfo->nAttempts, entry.nAttempts);
+        }
+        Check();
+    }
+
     //! Mark an entry as accessible.
     void Good(const CService &addr, int64_t nTime = GetTime())
     {
@@ -149,8 +149,13 @@ bool CAlert::RelayTo(CNode* pnode) const
     // don't relay to nodes which haven't sent their version message
     if (pnode->nVersion == 0)
         return false;
-    // returns true if wasn't already contained in the set
-    if (pnode->setKnown.insert(GetHash()).second)
+    bool fNewToNode;
+    {
+        // setKnown can be touched from any message handler thread
+        LOCK(pnode->cs_inventory);
+        fNewToNode = pnode->setKnown.insert(GetHash()).second;
+    }
+    if (fNewToNode)
     {
         if (AppliesTo(pnode->nVersion, pnode->strSubVer) ||
             AppliesToMe() ||
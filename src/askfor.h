@@ -0,0 +1,138 @@
+// Copyright (c) 2009-2014 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_ASKFOR_H
+#define BITCOIN_ASKFOR_H
+
+#include "primitives/transaction.h"
+#include "protocol.h"
+
+#include <stdint.h>
+#include <vector>
+
+//! Hasher for the per-peer getdata dedup set; txids are already uniformly
+//! distributed, so their cheap prefix is a sufficient hash.
+struct WTxIdHasher {
+    size_t operator()(const WTxId& wtxid) const
+    {
+        return (size_t)wtxid.hash.GetCheapHash();
+    }
+};
+
+/**
+ * Hashed timing wheel holding a peer's scheduled getdata requests.
+ *
+ * A request is filed into the slot its send time falls in; SendMessages
+ * advances a cursor over the slots and emits whatever has become due. Both
+ * operations are O(1) amortized per request, unlike the ordered multimap this
+ * replaces, and the wheel needs no per-entry tree nodes. Times are only kept
+ * at slot granularity (about a second), which is far finer than the retry
+ * delays being scheduled; within a slot, insertion order is preserved.
+ */
+class CAskForWheel
+{
+private:
+    //! log2 of the slot width in microseconds (1 << 20 is ~1.05 s)
+    static const int SLOT_BITS = 20;
+    //! Number of slots; must be a power of two. One turn of the wheel spans
+    //! ~134 s, beyond the maximum two minute retry delay, so at most one
+    //! entry per slot belongs to a later turn.
+    static const int WHEEL_SLOTS = 128;
+
+    struct CAskForEntry {
+        int64_t nSlot; //!< absolute slot number (send time >> SLOT_BITS)
+        CInv inv;
+    };
+
+    std::vector<CAskForEntry> vSlots[WHEEL_SLOTS];
+    //! Entries drained from the cursor slot, emitted one per PopDue call
+    std::vector<CAskForEntry> vDue;
+    size_t nDuePos;
+    //! Next absolute slot number to drain; 0 until the first insert
+    int64_t nCursor;
+    //! Entries still filed in vSlots (excludes the drained ones in vDue)
+    size_t nEntries;
+
+    //! Move the cursor slot's current-turn entries into vDue
+    void DrainSlot(int64_t nUpToSlot)
+    {
+        std::vector<CAskForEntry>& slot = vSlots[nCursor & (WHEEL_SLOTS - 1)];
+        size_t keep = 0;
+        size_t nDrained = 0;
+        for (size_t i = 0; i < slot.size(); i++) {
+            if (slot[i].nSlot <= nUpToSlot) {
+                vDue.push_back(slot[i]);
+                nDrained++;
+            } else {
+                slot[keep++] = slot[i];
+            }
+        }
+        slot.resize(keep);
+        nEntries -= nDrained;
+    }
+
+public:
+    CAskForWheel() : nDuePos(0), nCursor(0), nEntries(0) {}
+
+    size_t size() const { return nEntries + (vDue.size() - nDuePos); }
+    bool empty() const { return size() == 0; }
+
+    void insert(int64_t nTime, const CInv& inv)
+    {
+        int64_t nSlot = nTime >> SLOT_BITS;
+        if (nCursor == 0)
+            nCursor = nSlot;
+        // Never file behind the cursor: that slot would only be visited
+        // again a full turn later.
+        if (nSlot < nCursor)
+            nSlot = nCursor;
+        CAskForEntry entry;
+        entry.nSlot = nSlot;
+        entry.inv = inv;
+        vSlots[nSlot & (WHEEL_SLOTS - 1)].push_back(entry);
+        nEntries++;
+    }
+
+    //! Emit the next request due at nNow, advancing the cursor as needed.
+    //! Returns false once nothing (more) is due.
+    bool PopDue(int64_t nNow, CInv& invOut)
+    {
+        while (true) {
+            if (nDuePos < vDue.size()) {
+                invOut = vDue[nDuePos++].inv;
+                return true;
+            }
+            vDue.clear();
+            nDuePos = 0;
+            if (nCursor == 0)
+                return false;
+            int64_t nNowSlot = nNow >> SLOT_BITS;
+            if (nEntries == 0) {
+                // keep the cursor fresh while the wheel is empty
+                if (nCursor < nNowSlot)
+                    nCursor = nNowSlot;
+                return false;
+            }
+            if (nCursor > nNowSlot)
+                return false;
+            if (nNowSlot - nCursor >= WHEEL_SLOTS) {
+                // Idle for more than a full turn: one sweep over every slot
+                // finds all due entries without walking each elapsed slot.
+                int64_t nSave = nCursor;
+                for (int i = 0; i < WHEEL_SLOTS; i++) {
+                    nCursor = nSave + i;
+                    DrainSlot(nNowSlot);
+                }
+                nCursor = nNowSlot + 1;
+                if (vDue.empty())
+                    return false;
+                continue;
+            }
+            DrainSlot(nCursor);
+            nCursor++;
+        }
+    }
+};
+
+#endif // BITCOIN_ASKFOR_H
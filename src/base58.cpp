@@ -13,6 +13,27 @@
 /** All alphanumeric characters except for "0", "I", "O", and "l" */
 static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
 
+/** Reverse map of pszBase58: character value to digit, -1 for characters not
+ *  in the alphabet. Replaces a linear strchr scan per input character. */
+static const int8_t mapBase58[256] = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1, 0, 1, 2, 3, 4, 5, 6,  7, 8,-1,-1,-1,-1,-1,-1,
+    -1, 9,10,11,12,13,14,15, 16,-1,17,18,19,20,21,-1,
+    22,23,24,25,26,27,28,29, 30,31,32,-1,-1,-1,-1,-1,
+    -1,33,34,35,36,37,38,39, 40,41,42,43,-1,44,45,46,
+    47,48,49,50,51,52,53,54, 55,56,57,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+};
+
 bool DecodeBase58(const char* psz, std::vector<unsigned char>& vch)
 {
     // Skip leading spaces.
@@ -24,22 +45,29 @@ bool DecodeBase58(const char* psz, std::vector<unsigned char>& vch)
         zeroes++;
         psz++;
     }
-    // Allocate enough space in big-endian base256 representation.
-    std::vector<unsigned char> b256(strlen(psz) * 733 / 1000 + 1); // log(58) / log(256), rounded up.
+    // Allocate enough space in big-endian base 2^32 representation. Working
+    // in 32-bit limbs makes the carry propagation loop a quarter the length
+    // of the byte-at-a-time version; for the 26-byte taddr payload it drops
+    // from 26 to 7 iterations per character.
+    int size = strlen(psz) * 733 / 1000 + 1; // log(58) / log(256), rounded up.
+    std::vector<uint32_t> b2_32((size + 3) / 4);
     // Process the characters.
+    int length = 0; // number of low limbs known to be in use
     while (*psz && !isspace(*psz)) {
         // Decode base58 character
-        const char* ch = strchr(pszBase58, *psz);
-        if (ch == NULL)
+        int carry = mapBase58[(uint8_t)*psz];
+        if (carry == -1) // Invalid b58 character
             return false;
-        // Apply "b256 = b256 * 58 + ch".
-        int carry = ch - pszBase58;
-        for (std::vector<unsigned char>::reverse_iterator it = b256.rbegin(); it != b256.rend(); it++) {
-            carry += 58 * (*it);
-            *it = carry % 256;
-            carry /= 256;
+        // Apply "b = b * 58 + carry", touching only limbs that can be nonzero.
+        int i = 0;
+        for (std::vector<uint32_t>::reverse_iterator it = b2_32.rbegin();
+             (carry != 0 || i < length) && (it != b2_32.rend()); ++it, ++i) {
+            uint64_t t = (uint64_t)*it * 58 + carry;
+            *it = (uint32_t)t;
+            carry = (int)(t >> 32);
         }
         assert(carry == 0);
+        length = i;
         psz++;
     }
     // Skip trailing spaces.
@@ -47,7 +75,15 @@ bool DecodeBase58(const char* psz, std::vector<unsigned char>& vch)
         psz++;
     if (*psz != 0)
         return false;
-    // Skip leading zeroes in b256.
+    // Unpack the limbs big-endian, skipping leading zero bytes.
+    std::vector<unsigned char> b256;
+    b256.reserve(b2_32.size() * 4);
+    for (std::vector<uint32_t>::const_iterator limb = b2_32.begin(); limb != b2_32.end(); ++limb) {
+        b256.push_back(*limb >> 24);
+        b256.push_back((*limb >> 16) & 0xff);
+        b256.push_back((*limb >> 8) & 0xff);
+        b256.push_back(*limb & 0xff);
+    }
     std::vector<unsigned char>::iterator it = b256.begin();
     while (it != b256.end() && *it == 0)
         it++;
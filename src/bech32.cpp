@@ -31,6 +31,38 @@ data Cat(data x, const data& y)
     return x;
 }
 
+/** The Bech32 generator constants: for each bit n of the top coefficient,
+ *  the bitpacked coefficients of {2^n}k(x), where k(x) = x^6 mod g(x). */
+constexpr uint32_t GENERATOR[5] = {
+    0x3b6a57b2, //     k(x) = {29}x^5 + {22}x^4 + {20}x^3 + {21}x^2 + {29}x + {18}
+    0x26508e6d, //  {2}k(x) = {19}x^5 +  {5}x^4 +     x^3 +  {3}x^2 + {19}x + {13}
+    0x1ea119fa, //  {4}k(x) = {15}x^5 + {10}x^4 +  {2}x^3 +  {6}x^2 + {15}x + {26}
+    0x3d4233dd, //  {8}k(x) = {30}x^5 + {20}x^4 +  {4}x^3 + {12}x^2 + {30}x + {29}
+    0x2a1462b3, // {16}k(x) = {21}x^5 +     x^4 +  {8}x^3 + {24}x^2 + {21}x + {19}
+};
+
+/** Table folding the five conditional generator XORs into a single lookup,
+ *  indexed by the 5-bit top coefficient c0: TABLE[c0] = {c0}k(x). */
+struct PolyModTable
+{
+    uint32_t v[32];
+};
+
+constexpr PolyModTable MakePolyModTable()
+{
+    PolyModTable table{};
+    for (int c0 = 0; c0 < 32; ++c0) {
+        uint32_t t = 0;
+        for (int n = 0; n < 5; ++n) {
+            if (c0 & (1 << n)) t ^= GENERATOR[n];
+        }
+        table.v[c0] = t;
+    }
+    return table;
+}
+
+constexpr PolyModTable POLYMOD_TABLE = MakePolyModTable();
+
 /** This function will compute what 6 5-bit values to XOR into the last 6 input values, in order to
  *  make the checksum 0. These 6 values are packed together in a single 30-bit integer. The higher
  *  bits correspond to earlier values. */
@@ -80,15 +112,10 @@ uint32_t PolyMod(const data& v)
         // First, determine the value of c0:
         uint8_t c0 = c >> 25;
 
-        // Then compute c1*x^5 + c2*x^4 + c3*x^3 + c4*x^2 + c5*x + v_i:
-        c = ((c & 0x1ffffff) << 5) ^ v_i;
-
-        // Finally, for each set bit n in c0, conditionally add {2^n}k(x):
-        if (c0 & 1)  c ^= 0x3b6a57b2; //     k(x) = {29}x^5 + {22}x^4 + {20}x^3 + {21}x^2 + {29}x + {18}
-        if (c0 & 2)  c ^= 0x26508e6d; //  {2}k(x) = {19}x^5 +  {5}x^4 +     x^3 +  {3}x^2 + {19}x + {13}
-        if (c0 & 4)  c ^= 0x1ea119fa; //  {4}k(x) = {15}x^5 + {10}x^4 +  {2}x^3 +  {6}x^2 + {15}x + {26}
-        if (c0 & 8)  c ^= 0x3d4233dd; //  {8}k(x) = {30}x^5 + {20}x^4 +  {4}x^3 + {12}x^2 + {30}x + {29}
-        if (c0 & 16) c ^= 0x2a1462b3; // {16}k(x) = {21}x^5 +     x^4 +  {8}x^3 + {24}x^2 + {21}x + {19}
+        // Then compute c1*x^5 + c2*x^4 + c3*x^3 + c4*x^2 + c5*x + v_i, and
+        // add {c0}k(x) in a single table lookup instead of five conditional
+        // XORs, removing the data-dependent branches from the loop:
+        c = (((c & 0x1ffffff) << 5) ^ v_i) ^ POLYMOD_TABLE.v[c0];
     }
     return c;
 }
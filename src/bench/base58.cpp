@@ -54,6 +54,26 @@ static void Base58Decode(benchmark::State& state)
 }
 
 
+static void Base58CheckDecode(benchmark::State& state)
+{
+    // A two-byte-prefix 26-byte payload, matching Koto taddr encodings.
+    static const std::array<unsigned char, 26> buff = {
+        {
+            28, 184, 17, 79, 8, 99, 150, 189, 208, 162, 22, 23, 203, 163, 36,
+            58, 147, 227, 139, 2, 215, 100, 91, 38, 11, 141
+        }
+    };
+    std::vector<unsigned char> in;
+    in.assign(buff.begin(), buff.end());
+    const std::string addr = EncodeBase58Check(in);
+    std::vector<unsigned char> vch;
+    while (state.KeepRunning()) {
+        DecodeBase58Check(addr.c_str(), vch);
+    }
+}
+
+
 BENCHMARK(Base58Encode);
 BENCHMARK(Base58CheckEncode);
 BENCHMARK(Base58Decode);
+BENCHMARK(Base58CheckDecode);
@@ -0,0 +1,91 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "proof_verifier.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+
+static const size_t NUM_TRANSACTIONS = 400;
+
+// Build a full-looking block of simple 2-in/2-out transparent transactions.
+// The repo ships no recorded mainnet blocks, so this synthetic block stands
+// in for one; it exercises the same deserialize + CheckBlock path (merkle
+// root, coinbase placement, per-tx consensus checks) that every block pays
+// on connect, without the contextual chainstate a microbenchmark cannot
+// provide.
+static CBlock BuildTestBlock()
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.nTime = 1623202200;
+    block.nBits = 0x1f07ffff;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 100 * COIN;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(CTransaction(coinbase));
+
+    uint256 prevHash;
+    prevHash.SetHex("0000000000000000000000000000000000000000000000000000000000000100");
+    for (size_t i = 0; i < NUM_TRANSACTIONS; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(2);
+        mtx.vin[0].prevout = COutPoint(prevHash, 0);
+        mtx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30)
+                                         << std::vector<unsigned char>(33, 0x02);
+        mtx.vin[1].prevout = COutPoint(prevHash, 1);
+        mtx.vin[1].scriptSig = mtx.vin[0].scriptSig;
+        mtx.vout.resize(2);
+        mtx.vout[0].nValue = 1 * COIN;
+        mtx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160
+                                             << std::vector<unsigned char>(20, (unsigned char)i)
+                                             << OP_EQUALVERIFY << OP_CHECKSIG;
+        mtx.vout[1].nValue = 2 * COIN;
+        mtx.vout[1].scriptPubKey = mtx.vout[0].scriptPubKey;
+        block.vtx.push_back(CTransaction(mtx));
+        prevHash = block.vtx.back().GetHash();
+    }
+
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+static void DeserializeAndCheckBlock(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << BuildTestBlock();
+    const char rewind = '\0';
+
+    auto verifier = ProofVerifier::Disabled();
+    auto orchardAuth = orchard::AuthValidator::Disabled();
+
+    while (state.KeepRunning()) {
+        // Pad the stream so the rewind after deserialization leaves the
+        // original contents for the next iteration.
+        stream.write(&rewind, 1);
+
+        CBlock block;
+        stream >> block;
+        stream.Rewind(stream.size());
+
+        CValidationState validationState;
+        bool checked = CheckBlock(block, validationState, Params(), verifier, orchardAuth,
+                                  false, true, true);
+        assert(checked);
+    }
+}
+
+BENCHMARK(DeserializeAndCheckBlock);
@@ -0,0 +1,58 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "coins.h"
+#include "script/script.h"
+#include "uint256.h"
+
+#include <vector>
+
+// Roughly the number of new outputs created by a full block of 2-in/2-out
+// transactions.
+static const size_t NUM_COINS = 5000;
+
+// Measure one cache generation of coin churn as block connect/disconnect
+// produces it: create a batch of fresh coins in a child cache, flush them
+// into the parent, then spend them all and flush the erasures. The parent is
+// itself a cache so the flush does real hash-map work instead of hitting the
+// (no-op) base view.
+static void CoinsViewCacheFillFlush(benchmark::State& state)
+{
+    std::vector<uint256> vTxid;
+    vTxid.reserve(NUM_COINS);
+    for (size_t i = 0; i < NUM_COINS; i++) {
+        vTxid.push_back(ArithToUint256(arith_uint256(i + 1)));
+    }
+
+    CCoinsView dummy;
+    CCoinsViewCache base(&dummy);
+
+    while (state.KeepRunning()) {
+        {
+            CCoinsViewCache cache(&base);
+            for (const uint256& txid : vTxid) {
+                CCoinsModifier coins = cache.ModifyNewCoins(txid);
+                coins->nVersion = 1;
+                coins->nHeight = 1;
+                coins->vout.resize(2);
+                coins->vout[0].nValue = 1000;
+                coins->vout[0].scriptPubKey = CScript() << OP_1;
+                coins->vout[1].nValue = 2000;
+                coins->vout[1].scriptPubKey = CScript() << OP_1;
+            }
+            cache.Flush();
+        }
+        {
+            CCoinsViewCache cache(&base);
+            for (const uint256& txid : vTxid) {
+                cache.ModifyCoins(txid)->Clear();
+            }
+            cache.Flush();
+        }
+    }
+}
+
+BENCHMARK(CoinsViewCacheFillFlush);
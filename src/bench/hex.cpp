@@ -0,0 +1,33 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+
+#include "random.h"
+#include "utilstrencodings.h"
+
+#include <string>
+#include <vector>
+
+static void HexStrBench(benchmark::State& state)
+{
+    std::vector<unsigned char> data(4096);
+    GetRandBytes(data.data(), data.size());
+    while (state.KeepRunning()) {
+        HexStr(data);
+    }
+}
+
+static void ParseHexBench(benchmark::State& state)
+{
+    std::vector<unsigned char> data(4096);
+    GetRandBytes(data.data(), data.size());
+    const std::string hex = HexStr(data);
+    while (state.KeepRunning()) {
+        ParseHex(hex);
+    }
+}
+
+BENCHMARK(HexStrBench);
+BENCHMARK(ParseHexBench);
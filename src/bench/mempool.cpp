@@ -0,0 +1,56 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "amount.h"
+#include "policy/fees.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "txmempool.h"
+#include "utiltime.h"
+
+#include <list>
+#include <vector>
+
+static const size_t CHAIN_LENGTH = 400;
+
+// Measure the bookkeeping cost of adding a chain of dependent transactions to
+// the mempool and then removing it recursively from the root, which is what a
+// reorg does. This exercises the per-entry ancestor tracking without the
+// script and proof verification that dominates a full AcceptToMemoryPool call
+// (and which needs a chainstate a microbenchmark cannot provide); those paths
+// are covered by the verification benches.
+static void MempoolAddRemove(benchmark::State& state)
+{
+    std::vector<CTransaction> vChain;
+    vChain.reserve(CHAIN_LENGTH);
+    uint256 prevHash;
+    prevHash.SetHex("0000000000000000000000000000000000000000000000000000000000000100");
+    for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevHash, 0);
+        mtx.vin[0].scriptSig = CScript() << OP_1;
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 10 * COIN - (i + 1) * 1000;
+        mtx.vout[0].scriptPubKey = CScript() << OP_1;
+        vChain.push_back(CTransaction(mtx));
+        prevHash = vChain.back().GetHash();
+    }
+
+    CTxMemPool pool(CFeeRate(1000));
+    int64_t nTime = GetTime();
+
+    while (state.KeepRunning()) {
+        for (const CTransaction& tx : vChain) {
+            pool.addUnchecked(tx.GetHash(),
+                              CTxMemPoolEntry(tx, 1000, nTime, 10.0, 1,
+                                              pool.HasNoInputsOf(tx), false, 1, 0));
+        }
+        std::list<CTransaction> removed;
+        pool.remove(vChain.front(), removed, true);
+    }
+}
+
+BENCHMARK(MempoolAddRemove);
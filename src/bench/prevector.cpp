@@ -0,0 +1,63 @@
+// Copyright (c) 2015-2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "prevector.h"
+#include "serialize.h"
+#include "streams.h"
+#include "version.h"
+
+// Resizing within the direct capacity never touches the heap; one element
+// more forces the indirect representation. Benchmarking both sides of the
+// boundary shows what a different CSCRIPT_PREVECTOR_SIZE would buy.
+static void PrevectorResizeDirect(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        prevector<28, unsigned char> t0;
+        for (auto x = 0; x < 1000; ++x) {
+            t0.resize(28);
+            t0.resize(0);
+        }
+    }
+}
+
+static void PrevectorResizeIndirect(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        prevector<28, unsigned char> t0;
+        for (auto x = 0; x < 1000; ++x) {
+            t0.resize(29);
+            t0.resize(0);
+            t0.shrink_to_fit();
+        }
+    }
+}
+
+// Deserialization is the hottest prevector path in practice: every script of
+// every transaction in every block goes through it.
+static void PrevectorDeserialize(benchmark::State& state)
+{
+    CDataStream s0(SER_NETWORK, INIT_PROTO_VERSION);
+    prevector<28, unsigned char> t0;
+    t0.resize(28);
+    for (auto x = 0; x < 900; ++x) {
+        s0 << t0;
+    }
+    t0.resize(100);
+    for (auto x = 0; x < 101; ++x) {
+        s0 << t0;
+    }
+    const std::vector<char> buf(s0.begin(), s0.end());
+    while (state.KeepRunning()) {
+        CDataStream s1(buf.data(), buf.data() + buf.size(), SER_NETWORK, INIT_PROTO_VERSION);
+        prevector<28, unsigned char> t1;
+        for (auto x = 0; x < 1001; ++x) {
+            s1 >> t1;
+        }
+    }
+}
+
+BENCHMARK(PrevectorResizeDirect);
+BENCHMARK(PrevectorResizeIndirect);
+BENCHMARK(PrevectorDeserialize);
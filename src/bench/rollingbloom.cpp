@@ -6,6 +6,7 @@
 
 #include "bench.h"
 #include "bloom.h"
+#include "uint256.h"
 
 static void RollingBloom(benchmark::State& state)
 {
@@ -39,6 +40,24 @@ static void RollingBloom(benchmark::State& state)
     }
 }
 
+static void RollingBloomBatchInsert(benchmark::State& state)
+{
+    CRollingBloomFilter filter(120000, 0.000001);
+    std::vector<uint256> hashes(1000);
+    uint32_t count = 0;
+    while (state.KeepRunning()) {
+        for (uint256& hash : hashes) {
+            count++;
+            unsigned char* data = hash.begin();
+            data[0] = count;
+            data[1] = count >> 8;
+            data[2] = count >> 16;
+            data[3] = count >> 24;
+        }
+        filter.insert(hashes);
+    }
+}
+
 static void RollingBloomReset(benchmark::State& state)
 {
     CRollingBloomFilter filter(120000, 0.000001);
@@ -48,4 +67,5 @@ static void RollingBloomReset(benchmark::State& state)
 }
 
 BENCHMARK(RollingBloom);
+BENCHMARK(RollingBloomBatchInsert);
 BENCHMARK(RollingBloomReset); // To-backport: 20000
@@ -0,0 +1,78 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+
+#include <utility>
+#include <vector>
+
+static CMutableTransaction BuildTestTransaction()
+{
+    CMutableTransaction mtx;
+    uint256 prevHash;
+    prevHash.SetHex("0000000000000000000000000000000000000000000000000000000000000100");
+    mtx.vin.resize(10);
+    mtx.vout.resize(10);
+    for (size_t i = 0; i < 10; i++) {
+        mtx.vin[i].prevout = COutPoint(prevHash, i);
+        mtx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30)
+                                         << std::vector<unsigned char>(33, 0x02);
+        mtx.vout[i].nValue = 1000 * (i + 1);
+        mtx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160
+                                             << std::vector<unsigned char>(20, (unsigned char)i)
+                                             << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return mtx;
+}
+
+// The relay hot path: a transaction arriving over the wire is deserialized
+// and hashed.
+static void TransactionDeserialize(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CTransaction(BuildTestTransaction());
+    const char rewind = '\0';
+
+    while (state.KeepRunning()) {
+        stream.write(&rewind, 1);
+        CTransaction tx;
+        stream >> tx;
+        stream.Rewind(stream.size());
+    }
+}
+
+// Growing CBlock::vtx without a reserve, as block assembly and relay do.
+// Reallocation moves the already-held transactions when CTransaction's move
+// constructor is noexcept, and copies them otherwise.
+static void TransactionVectorGrowth(benchmark::State& state)
+{
+    const CTransaction tx(BuildTestTransaction());
+
+    while (state.KeepRunning()) {
+        std::vector<CTransaction> vtx;
+        for (int i = 0; i < 256; i++) {
+            vtx.push_back(tx);
+        }
+    }
+}
+
+// Handing a freshly built transaction off without copying its vectors.
+static void TransactionMove(benchmark::State& state)
+{
+    const CTransaction txTemplate(BuildTestTransaction());
+
+    while (state.KeepRunning()) {
+        CTransaction tx(txTemplate);
+        CTransaction moved(std::move(tx));
+        tx = std::move(moved);
+    }
+}
+
+BENCHMARK(TransactionDeserialize);
+BENCHMARK(TransactionVectorGrowth);
+BENCHMARK(TransactionMove);
@@ -0,0 +1,22 @@
+// Copyright (c) 2020 The Koto developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "primitives/block.h"
+
+// Raw yespower hash rate over a block header, the unit of work for both
+// mining and header validation.
+static void YespowerHash(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nBits = 0x1f07ffff;
+
+    while (state.KeepRunning()) {
+        header.nTime++;
+        header.GetPoWHash();
+    }
+}
+
+BENCHMARK(YespowerHash);
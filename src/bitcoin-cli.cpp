@@ -33,6 +33,9 @@ static const char DEFAULT_RPCCONNECT[] = "127.0.0.1";
 static const int DEFAULT_HTTP_CLIENT_TIMEOUT=900;
 static const int CONTINUE_EXECUTION=-1;
 
+//! Set when commands are executed from standard input over one connection (-batch)
+static bool fBatchMode = false;
+
 std::string HelpMessageCli()
 {
     std::string strUsage;
@@ -40,6 +43,7 @@ std::string HelpMessageCli()
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
+    strUsage += HelpMessageOpt("-batch", _("Read commands from standard input, one per line until EOF/Ctrl-D, and execute them over a single keep-alive connection. Replies are written to standard output, one JSON object per line"));
     strUsage += HelpMessageOpt("-stdin", _("Read extra arguments from standard input, one per line until EOF/Ctrl-D (recommended for sensitive information such as passphrases). If first extra argument is `walletpassphrase` then the first line(password) will not be echoed."));
     AppendParamsHelpMessages(strUsage);
     strUsage += HelpMessageOpt("-rpcconnect=<ip>", strprintf(_("Send commands to node running on <ip> (default: %s)"), DEFAULT_RPCCONNECT));
@@ -134,11 +138,12 @@ static int AppInitRPC(int argc, char* argv[])
 /** Reply structure for request_done to fill in */
 struct HTTPReply
 {
-    HTTPReply(): status(0), error(-1) {}
+    HTTPReply(): status(0), error(-1), eventBase(NULL) {}
 
     int status;
     int error;
     std::string body;
+    struct event_base* eventBase; //!< event loop to break out of once the reply is in
 };
 
 const char *http_errorstring(int code)
@@ -172,20 +177,25 @@ static void http_request_done(struct evhttp_request *req, void *ctx)
          * error code will have been passed to http_error_cb.
          */
         reply->status = 0;
-        return;
+    } else {
+        reply->status = evhttp_request_get_response_code(req);
+
+        struct evbuffer *buf = evhttp_request_get_input_buffer(req);
+        if (buf)
+        {
+            size_t size = evbuffer_get_length(buf);
+            const char *data = (const char*)evbuffer_pullup(buf, size);
+            if (data)
+                reply->body = std::string(data, size);
+            evbuffer_drain(buf, size);
+        }
     }
 
-    reply->status = evhttp_request_get_response_code(req);
-
-    struct evbuffer *buf = evhttp_request_get_input_buffer(req);
-    if (buf)
-    {
-        size_t size = evbuffer_get_length(buf);
-        const char *data = (const char*)evbuffer_pullup(buf, size);
-        if (data)
-            reply->body = std::string(data, size);
-        evbuffer_drain(buf, size);
-    }
+    /* The connection is kept open for reuse, so the event loop does not run
+     * out of events on its own once the reply is in.
+     */
+    if (reply->eventBase)
+        event_base_loopbreak(reply->eventBase);
 }
 
 #if LIBEVENT_VERSION_NUMBER >= 0x02010300
@@ -196,19 +206,46 @@ static void http_error_cb(enum evhttp_request_error err, void *ctx)
 }
 #endif
 
+static std::string GetRPCCredentials()
+{
+    // Cached so that batch mode does not re-read the cookie file per command
+    static std::string strRPCUserColonPass;
+    if (!strRPCUserColonPass.empty())
+        return strRPCUserColonPass;
+
+    if (mapArgs["-rpcpassword"] == "") {
+        // Try fall back to cookie-based authentication if no password is provided
+        if (!GetAuthCookie(&strRPCUserColonPass)) {
+            throw std::runtime_error(strprintf(
+                _("Could not locate RPC credentials. No authentication cookie could be found,\n"
+                  "and no rpcpassword is set in the configuration file (%s)."),
+                    GetConfigFile(GetArg("-conf", BITCOIN_CONF_FILENAME)).string().c_str()));
+
+        }
+    } else {
+        strRPCUserColonPass = mapArgs["-rpcuser"] + ":" + mapArgs["-rpcpassword"];
+    }
+    return strRPCUserColonPass;
+}
+
 UniValue CallRPC(const std::string& strMethod, const UniValue& params)
 {
     std::string host = GetArg("-rpcconnect", DEFAULT_RPCCONNECT);
     int port = GetArg("-rpcport", BaseParams().RPCPort());
 
-    // Obtain event base
-    raii_event_base base = obtain_event_base();
-
-    // Synchronously look up hostname
-    raii_evhttp_connection evcon = obtain_evhttp_connection_base(base.get(), host, port);
-    evhttp_connection_set_timeout(evcon.get(), GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
+    // The event base and connection persist across calls so that batch mode
+    // sends every request over one keep-alive connection; libevent
+    // transparently reconnects if the server has closed it in the meantime.
+    static raii_event_base base = obtain_event_base();
+    static raii_evhttp_connection evcon;
+    if (!evcon) {
+        // Synchronously look up hostname
+        evcon = obtain_evhttp_connection_base(base.get(), host, port);
+        evhttp_connection_set_timeout(evcon.get(), GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
+    }
 
     HTTPReply response;
+    response.eventBase = base.get();
     raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
     if (req == NULL)
         throw std::runtime_error("create http request failed");
@@ -217,24 +254,12 @@ UniValue CallRPC(const std::string& strMethod, const UniValue& params)
 #endif
 
     // Get credentials
-    std::string strRPCUserColonPass;
-    if (mapArgs["-rpcpassword"] == "") {
-        // Try fall back to cookie-based authentication if no password is provided
-        if (!GetAuthCookie(&strRPCUserColonPass)) {
-            throw std::runtime_error(strprintf(
-                _("Could not locate RPC credentials. No authentication cookie could be found,\n"
-                  "and no rpcpassword is set in the configuration file (%s)."),
-                    GetConfigFile(GetArg("-conf", BITCOIN_CONF_FILENAME)).string().c_str()));
-
-        }
-    } else {
-        strRPCUserColonPass = mapArgs["-rpcuser"] + ":" + mapArgs["-rpcpassword"];
-    }
+    std::string strRPCUserColonPass = GetRPCCredentials();
 
     struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
     assert(output_headers);
     evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
+    evhttp_add_header(output_headers, "Connection", fBatchMode ? "keep-alive" : "close");
     evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
 
     // Attach request data
@@ -306,6 +331,67 @@ bool SetStdinEcho(bool enable = true)
     return true;
 }
 
+//
+// Batch mode: execute commands read from stdin, one per line, over a single
+// keep-alive connection. One JSON-RPC reply object is written to stdout per
+// command, so scripted callers can pipeline thousands of calls through one
+// authenticated process instead of paying the per-invocation startup cost.
+//
+static int BatchRPC()
+{
+    fBatchMode = true;
+    const bool fWait = GetBoolArg("-rpcwait", false);
+    int nRet = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        UniValue reply(UniValue::VOBJ);
+        try {
+            std::vector<std::string> args;
+            if (!ParseCommandLine(args, line))
+                throw std::runtime_error("parse error: unbalanced ' or \"");
+            if (args.empty())
+                continue; // blank line
+            std::string strMethod = args[0];
+            UniValue params = RPCConvertValues(strMethod, std::vector<std::string>(args.begin() + 1, args.end()));
+
+            do {
+                try {
+                    reply = CallRPC(strMethod, params);
+                    const UniValue& error = find_value(reply, "error");
+                    if (fWait && !error.isNull() && error["code"].get_int() == RPC_IN_WARMUP)
+                        throw CConnectionFailed("server in warmup");
+                    break;
+                }
+                catch (const CConnectionFailed&) {
+                    if (fWait)
+                        MilliSleep(1000);
+                    else
+                        throw;
+                }
+            } while (fWait);
+        }
+        catch (const CConnectionFailed& e) {
+            // The connection is gone; every following command would fail too
+            fprintf(stderr, "error: %s\n", e.what());
+            return EXIT_FAILURE;
+        }
+        catch (const std::exception& e) {
+            UniValue error(UniValue::VOBJ);
+            error.pushKV("code", RPC_MISC_ERROR);
+            error.pushKV("message", std::string(e.what()));
+            reply = UniValue(UniValue::VOBJ);
+            reply.pushKV("result", NullUniValue);
+            reply.pushKV("error", error);
+        }
+
+        if (!find_value(reply, "error").isNull())
+            nRet = EXIT_FAILURE;
+        fprintf(stdout, "%s\n", reply.write().c_str());
+        fflush(stdout); // make each reply available to the consumer immediately
+    }
+    return nRet;
+}
+
 int CommandLineRPC(int argc, char *argv[])
 {
     std::string strPrint;
@@ -317,6 +403,11 @@ int CommandLineRPC(int argc, char *argv[])
             argv++;
         }
         std::vector<std::string> args = std::vector<std::string>(&argv[1], &argv[argc]);
+        if (GetBoolArg("-batch", false)) {
+            if (!args.empty())
+                throw std::runtime_error("-batch takes its commands from standard input, not the command line");
+            return BatchRPC();
+        }
         if (GetBoolArg("-stdin", false)) {
             bool hide = false;
             if (args.size() > 0 && args[0] == "walletpassphrase") {
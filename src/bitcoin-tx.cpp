@@ -20,6 +20,8 @@
 
 #include <stdio.h>
 
+#include <iostream>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
 
@@ -57,6 +59,7 @@ static int AppInitRawTx(int argc, char* argv[])
             _("Usage:") + "\n" +
               "  koto-tx [options] <hex-tx> [commands]  " + _("Update hex-encoded koto transaction") + "\n" +
               "  koto-tx [options] -create [commands]   " + _("Create hex-encoded koto transaction") + "\n" +
+              "  koto-tx [options] -stream [commands]   " + _("Update hex-encoded koto transactions read from stdin, one per line") + "\n" +
               "\n";
 
         fprintf(stdout, "%s", strUsage.c_str());
@@ -65,6 +68,7 @@ static int AppInitRawTx(int argc, char* argv[])
         strUsage += HelpMessageOpt("-?", _("This help message"));
         strUsage += HelpMessageOpt("-create", _("Create new, empty TX."));
         strUsage += HelpMessageOpt("-json", _("Select JSON output"));
+        strUsage += HelpMessageOpt("-stream", _("Read hex-encoded transactions from standard input, one per line until EOF/Ctrl-D, apply the commands to each of them and write the results to standard output, one per line."));
         strUsage += HelpMessageOpt("-txid", _("Output only the hex-encoded transaction id of the resultant transaction."));
         AppendParamsHelpMessages(strUsage);
 
@@ -409,22 +413,31 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& strInput)
 
     if (!registers.count("privatekeys"))
         throw std::runtime_error("privatekeys register variable must be set.");
-    bool fGivenKeys = false;
-    CBasicKeyStore tempKeystore;
+    bool fGivenKeys = true;
     UniValue keysObj = registers["privatekeys"];
-    fGivenKeys = true;
 
     KeyIO keyIO(Params());
 
-    for (size_t kidx = 0; kidx < keysObj.size(); kidx++) {
-        if (!keysObj[kidx].isStr())
-            throw std::runtime_error("privatekey not a std::string");
-        CKey key = keyIO.DecodeSecret(keysObj[kidx].getValStr());
-        if (!key.IsValid()) {
-            throw std::runtime_error("privatekey not valid");
+    // Decoded private keys are kept across sign commands so that stream mode
+    // does not re-parse the same register for every transaction; the keystore
+    // is rebuilt when the register content changes.
+    static std::unique_ptr<CBasicKeyStore> pKeystore;
+    static std::string strCachedKeys;
+    std::string strKeys = keysObj.write();
+    if (!pKeystore || strKeys != strCachedKeys) {
+        pKeystore.reset(new CBasicKeyStore());
+        for (size_t kidx = 0; kidx < keysObj.size(); kidx++) {
+            if (!keysObj[kidx].isStr())
+                throw std::runtime_error("privatekey not a std::string");
+            CKey key = keyIO.DecodeSecret(keysObj[kidx].getValStr());
+            if (!key.IsValid()) {
+                throw std::runtime_error("privatekey not valid");
+            }
+            pKeystore->AddKey(key);
         }
-        tempKeystore.AddKey(key);
+        strCachedKeys = strKeys;
     }
+    CBasicKeyStore& tempKeystore = *pKeystore;
 
     // Add previous txouts given in the RPC call:
     if (!registers.count("prevtxs"))
@@ -534,8 +547,6 @@ public:
 static void MutateTx(CMutableTransaction& tx, const std::string& command,
                      const std::string& commandVal)
 {
-    boost::scoped_ptr<Secp256k1Init> ecc;
-
     if (command == "nversion")
         MutateTxVersion(tx, commandVal);
     else if (command == "locktime")
@@ -556,6 +567,9 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
         MutateTxAddOutScript(tx, commandVal);
 
     else if (command == "sign") {
+        // the ECC context is set up once and reused; stream mode may sign
+        // many transactions in one process
+        static std::unique_ptr<Secp256k1Init> ecc;
         if (!ecc) { ecc.reset(new Secp256k1Init()); }
         MutateTxSign(tx, commandVal);
     }
@@ -623,6 +637,50 @@ static std::string readStdin()
     return ret;
 }
 
+static void ApplyTxCommands(CMutableTransaction& tx, int argc, char* argv[], int startArg)
+{
+    for (int i = startArg; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string key, value;
+        size_t eqpos = arg.find('=');
+        if (eqpos == std::string::npos)
+            key = arg;
+        else {
+            key = arg.substr(0, eqpos);
+            value = arg.substr(eqpos + 1);
+        }
+
+        MutateTx(tx, key, value);
+    }
+}
+
+//
+// Stream mode: apply the command sequence to every hex-encoded transaction
+// read from stdin, one per line, and write each result to stdout. Keys,
+// registers and the ECC context are parsed resp. set up only once, so e.g. a
+// signing pipeline does not pay the per-process startup cost per transaction.
+//
+static int StreamRawTx(int argc, char* argv[])
+{
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        boost::algorithm::trim(line);
+        if (line.empty())
+            continue;
+
+        CTransaction txDecodeTmp;
+        if (!DecodeHexTx(txDecodeTmp, line))
+            throw std::runtime_error("invalid transaction encoding");
+        CMutableTransaction tx(txDecodeTmp);
+
+        ApplyTxCommands(tx, argc, argv, 1);
+
+        OutputTx(tx);
+        fflush(stdout); // make each result available to the consumer immediately
+    }
+    return EXIT_SUCCESS;
+}
+
 static int CommandLineRawTx(int argc, char* argv[])
 {
     std::string strPrint;
@@ -635,6 +693,12 @@ static int CommandLineRawTx(int argc, char* argv[])
             argv++;
         }
 
+        if (GetBoolArg("-stream", false)) {
+            if (fCreateBlank)
+                throw std::runtime_error("-create does not apply to -stream; transactions are read from standard input");
+            return StreamRawTx(argc, argv);
+        }
+
         CTransaction txDecodeTmp;
         int startArg;
 
@@ -657,19 +721,7 @@ static int CommandLineRawTx(int argc, char* argv[])
 
         CMutableTransaction tx(txDecodeTmp);
 
-        for (int i = startArg; i < argc; i++) {
-            std::string arg = argv[i];
-            std::string key, value;
-            size_t eqpos = arg.find('=');
-            if (eqpos == std::string::npos)
-                key = arg;
-            else {
-                key = arg.substr(0, eqpos);
-                value = arg.substr(eqpos + 1);
-            }
-
-            MutateTx(tx, key, value);
-        }
+        ApplyTxCommands(tx, argc, argv, startArg);
 
         OutputTx(tx);
     }
@@ -5,6 +5,7 @@
 #include "bloom.h"
 
 #include "primitives/transaction.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "script/script.h"
 #include "script/standard.h"
@@ -26,6 +27,8 @@ CBloomFilter::CBloomFilter(const unsigned int nElements, const double nFPRate, c
      * We ignore filter parameters which will create a bloom filter larger than the protocol limits
      */
     vData(std::min((unsigned int)(-1  / LN2SQUARED * nElements * log(nFPRate)), MAX_BLOOM_FILTER_SIZE * 8) / 8),
+    isFull(false),
+    isEmpty(true),
     /**
      * The ideal number of hash functions is filter size * ln(2) / number of elements
      * Again, we ignore filter parameters which will create a bloom filter with more hash functions than the protocol limits
@@ -37,45 +40,76 @@ CBloomFilter::CBloomFilter(const unsigned int nElements, const double nFPRate, c
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const unsigned char* pDataToHash, size_t nDataLen) const
 {
     // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, pDataToHash, nDataLen) % (vData.size() * 8);
 }
 
-void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+void CBloomFilter::insert(const unsigned char* pKey, size_t nKeyLen)
 {
+    if (isFull)
+        return;
     if (vData.empty()) // Avoid divide-by-zero (CVE-2013-5700)
         return;
     for (unsigned int i = 0; i < nHashFuncs; i++)
     {
-        unsigned int nIndex = Hash(i, vKey);
+        unsigned int nIndex = Hash(i, pKey, nKeyLen);
         // Sets bit nIndex of vData
         vData[nIndex >> 3] |= (1 << (7 & nIndex));
     }
+    isEmpty = false;
+}
+
+void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    insert(vKey.data(), vKey.size());
 }
 
 void CBloomFilter::insert(const COutPoint& outpoint)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    // A serialized COutPoint is the txid followed by the little-endian output
+    // index; build it on the stack to keep the update path allocation-free.
+    unsigned char data[36];
+    memcpy(data, outpoint.hash.begin(), 32);
+    WriteLE32(data + 32, outpoint.n);
+    insert(data, sizeof(data));
 }
 
 void CBloomFilter::insert(const uint256& hash)
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    insert(hash.begin(), 32);
 }
 
-bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+void CBloomFilter::insert(const std::vector<uint256>& vHashes)
+{
+    if (isFull)
+        return;
+    if (vData.empty()) // Avoid divide-by-zero (CVE-2013-5700)
+        return;
+    for (const uint256& hash : vHashes)
+    {
+        for (unsigned int i = 0; i < nHashFuncs; i++)
+        {
+            unsigned int nIndex = Hash(i, hash.begin(), 32);
+            vData[nIndex >> 3] |= (1 << (7 & nIndex));
+        }
+    }
+    if (!vHashes.empty())
+        isEmpty = false;
+}
+
+bool CBloomFilter::contains(const unsigned char* pKey, size_t nKeyLen) const
 {
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
     if (vData.empty()) // Avoid divide-by-zero (CVE-2013-5700)
         return true;
     for (unsigned int i = 0; i < nHashFuncs; i++)
     {
-        unsigned int nIndex = Hash(i, vKey);
+        unsigned int nIndex = Hash(i, pKey, nKeyLen);
         // Checks bit nIndex of vData
         if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
             return false;
@@ -83,18 +117,22 @@ bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
     return true;
 }
 
+bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(vKey.data(), vKey.size());
+}
+
 bool CBloomFilter::contains(const COutPoint& outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    unsigned char data[36];
+    memcpy(data, outpoint.hash.begin(), 32);
+    WriteLE32(data + 32, outpoint.n);
+    return contains(data, sizeof(data));
 }
 
 bool CBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(hash.begin(), 32);
 }
 
 bool CBloomFilter::IsWithinSizeConstraints() const
@@ -107,8 +145,10 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     bool fFound = false;
     // Match if the filter contains the hash of tx
     //  for finding tx when they appear in a block
-    if (vData.empty()) // zero-size = "match-all" filter
+    if (isFull || vData.empty()) // zero-size = "match-all" filter
         return true;
+    if (isEmpty)
+        return false;
     const uint256& hash = tx.GetHash();
     if (contains(hash))
         fFound = true;
@@ -127,7 +167,7 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
             opcodetype opcode;
             if (!txout.scriptPubKey.GetOp(pc, opcode, data))
                 break;
-            if (data.size() != 0 && contains(data))
+            if (data.size() != 0 && contains(data.data(), data.size()))
             {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
@@ -162,7 +202,7 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
             opcodetype opcode;
             if (!txin.scriptSig.GetOp(pc, opcode, data))
                 break;
-            if (data.size() != 0 && contains(data))
+            if (data.size() != 0 && contains(data.data(), data.size()))
                 return true;
         }
     }
@@ -170,6 +210,19 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     return false;
 }
 
+void CBloomFilter::UpdateEmptyFull()
+{
+    bool full = true;
+    bool empty = true;
+    for (unsigned int i = 0; i < vData.size(); i++)
+    {
+        full &= vData[i] == 0xff;
+        empty &= vData[i] == 0;
+    }
+    isFull = full;
+    isEmpty = empty;
+}
+
 CRollingBloomFilter::CRollingBloomFilter(const unsigned int nElements, const double fpRate)
 {
     double logFpRate = log(fpRate);
@@ -198,8 +251,8 @@ CRollingBloomFilter::CRollingBloomFilter(const unsigned int nElements, const dou
 }
 
 /* Similar to CBloomFilter::Hash */
-static inline uint32_t RollingBloomHash(unsigned int nHashNum, uint32_t nTweak, const std::vector<unsigned char>& vDataToHash) {
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash);
+static inline uint32_t RollingBloomHash(unsigned int nHashNum, uint32_t nTweak, const unsigned char* pDataToHash, size_t nDataLen) {
+    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, pDataToHash, nDataLen);
 }
 
 
@@ -210,28 +263,28 @@ static inline uint32_t FastMod(uint32_t x, size_t n) {
     return ((uint64_t)x * (uint64_t)n) >> 32;
 }
 
-void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
+void CRollingBloomFilter::AdvanceGeneration()
 {
-    if (nEntriesThisGeneration == nEntriesPerGeneration) {
-        nEntriesThisGeneration = 0;
-        nGeneration++;
-        if (nGeneration == 4) {
-            nGeneration = 1;
-        }
-        uint64_t nGenerationMask1 = 0 - (uint64_t)(nGeneration & 1);
-        uint64_t nGenerationMask2 = 0 - (uint64_t)(nGeneration >> 1);
-        /* Wipe old entries that used this generation number. */
-        for (uint32_t p = 0; p < data.size(); p += 2) {
-            uint64_t p1 = data[p], p2 = data[p + 1];
-            uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
-            data[p] = p1 & mask;
-            data[p + 1] = p2 & mask;
-        }
+    nEntriesThisGeneration = 0;
+    nGeneration++;
+    if (nGeneration == 4) {
+        nGeneration = 1;
     }
-    nEntriesThisGeneration++;
+    uint64_t nGenerationMask1 = 0 - (uint64_t)(nGeneration & 1);
+    uint64_t nGenerationMask2 = 0 - (uint64_t)(nGeneration >> 1);
+    /* Wipe old entries that used this generation number. */
+    for (uint32_t p = 0; p < data.size(); p += 2) {
+        uint64_t p1 = data[p], p2 = data[p + 1];
+        uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
+        data[p] = p1 & mask;
+        data[p + 1] = p2 & mask;
+    }
+}
 
+void CRollingBloomFilter::InsertHashes(uint32_t h1, uint32_t h2)
+{
     for (int n = 0; n < nHashFuncs; n++) {
-        uint32_t h = RollingBloomHash(n, nTweak, vKey);
+        uint32_t h = h1 + n * h2;
         int bit = h & 0x3F;
         /* FastMod works with the upper bits of h, so it is safe to ignore that the lower bits of h are already used for bit. */
         uint32_t pos = FastMod(h, data.size());
@@ -241,19 +294,13 @@ void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
     }
 }
 
-void CRollingBloomFilter::insert(const uint256& hash)
-{
-    std::vector<unsigned char> vData(hash.begin(), hash.end());
-    insert(vData);
-}
-
-bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+bool CRollingBloomFilter::ContainsHashes(uint32_t h1, uint32_t h2) const
 {
     for (int n = 0; n < nHashFuncs; n++) {
-        uint32_t h = RollingBloomHash(n, nTweak, vKey);
+        uint32_t h = h1 + n * h2;
         int bit = h & 0x3F;
         uint32_t pos = FastMod(h, data.size());
-        /* If the relevant bit is not set in either data[pos & ~1] or data[pos | 1], the filter does not contain vKey */
+        /* If the relevant bit is not set in either data[pos & ~1] or data[pos | 1], the filter does not contain the key */
         if (!(((data[pos & ~1] | data[pos | 1]) >> bit) & 1)) {
             return false;
         }
@@ -261,10 +308,54 @@ bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
     return true;
 }
 
+void CRollingBloomFilter::insert(const unsigned char* pKey, size_t nKeyLen)
+{
+    if (nEntriesThisGeneration == nEntriesPerGeneration) {
+        AdvanceGeneration();
+    }
+    nEntriesThisGeneration++;
+
+    /* Hash the key once per pass instead of once per hash function: the
+     * remaining nHashFuncs-2 positions are derived from the first two by
+     * double hashing. Forcing h2 odd keeps the stride coprime with the
+     * power-of-two bit space. */
+    uint32_t h1 = RollingBloomHash(0, nTweak, pKey, nKeyLen);
+    uint32_t h2 = RollingBloomHash(1, nTweak, pKey, nKeyLen) | 1;
+    InsertHashes(h1, h2);
+}
+
+void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    insert(vKey.empty() ? nullptr : vKey.data(), vKey.size());
+}
+
+void CRollingBloomFilter::insert(const uint256& hash)
+{
+    insert(hash.begin(), hash.size());
+}
+
+void CRollingBloomFilter::insert(const std::vector<uint256>& vHashes)
+{
+    for (const uint256& hash : vHashes) {
+        insert(hash.begin(), hash.size());
+    }
+}
+
+bool CRollingBloomFilter::contains(const unsigned char* pKey, size_t nKeyLen) const
+{
+    uint32_t h1 = RollingBloomHash(0, nTweak, pKey, nKeyLen);
+    uint32_t h2 = RollingBloomHash(1, nTweak, pKey, nKeyLen) | 1;
+    return ContainsHashes(h1, h2);
+}
+
+bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(vKey.empty() ? nullptr : vKey.data(), vKey.size());
+}
+
 bool CRollingBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> vData(hash.begin(), hash.end());
-    return contains(vData);
+    return contains(hash.begin(), hash.size());
 }
 
 void CRollingBloomFilter::reset()
@@ -45,11 +45,13 @@ class CBloomFilter
 {
 private:
     std::vector<unsigned char> vData;
+    bool isFull;
+    bool isEmpty;
     unsigned int nHashFuncs;
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    unsigned int Hash(unsigned int nHashNum, const unsigned char* pDataToHash, size_t nDataLen) const;
 
 public:
     /**
@@ -62,7 +64,7 @@ public:
      * nFlags should be one of the BLOOM_UPDATE_* enums (not _MASK)
      */
     CBloomFilter(const unsigned int nElements, const double nFPRate, const unsigned int nTweak, unsigned char nFlagsIn);
-    CBloomFilter() : nHashFuncs(0), nTweak(0), nFlags(0) {}
+    CBloomFilter() : isFull(true), isEmpty(false), nHashFuncs(0), nTweak(0), nFlags(0) {}
 
     ADD_SERIALIZE_METHODS;
 
@@ -74,10 +76,17 @@ public:
         READWRITE(nFlags);
     }
 
+    void insert(const unsigned char* pKey, size_t nKeyLen);
     void insert(const std::vector<unsigned char>& vKey);
     void insert(const COutPoint& outpoint);
     void insert(const uint256& hash);
+    //! Insert a batch of hashes with the full/empty guards evaluated once.
+    //! The bit positions are part of the BIP 37 protocol (the SPV client
+    //! computes the same ones), so each element still takes nHashFuncs
+    //! MurmurHash3 passes.
+    void insert(const std::vector<uint256>& vHashes);
 
+    bool contains(const unsigned char* pKey, size_t nKeyLen) const;
     bool contains(const std::vector<unsigned char>& vKey) const;
     bool contains(const COutPoint& outpoint) const;
     bool contains(const uint256& hash) const;
@@ -88,6 +97,9 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+
+    //! Checks for empty and full filters to avoid wasting cpu
+    void UpdateEmptyFull();
 };
 
 /**
@@ -123,8 +135,12 @@ public:
     // constructed before the randomizer is properly initialized.
     CRollingBloomFilter(const unsigned int nElements, const double nFPRate);
 
+    void insert(const unsigned char* pKey, size_t nKeyLen);
     void insert(const std::vector<unsigned char>& vKey);
     void insert(const uint256& hash);
+    //! Insert a batch of hashes in one call.
+    void insert(const std::vector<uint256>& vHashes);
+    bool contains(const unsigned char* pKey, size_t nKeyLen) const;
     bool contains(const std::vector<unsigned char>& vKey) const;
     bool contains(const uint256& hash) const;
 
@@ -137,6 +153,15 @@ private:
     std::vector<uint64_t> data;
     unsigned int nTweak;
     int nHashFuncs;
+
+    //! Retire the oldest generation once the current one fills up.
+    void AdvanceGeneration();
+    //! Set (or test) the nHashFuncs bit positions derived from one hash
+    //! pair by double hashing. Unlike CBloomFilter, the bit positions here
+    //! are never seen by peers, so we are free to compute two MurmurHash3
+    //! passes per element and derive the rest as h1 + n*h2.
+    void InsertHashes(uint32_t h1, uint32_t h2);
+    bool ContainsHashes(uint32_t h1, uint32_t h2) const;
 };
 
 #endif // BITCOIN_BLOOM_H
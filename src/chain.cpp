@@ -11,11 +11,20 @@
 void CChain::SetTip(CBlockIndex *pindex) {
     if (pindex == NULL) {
         vChain.clear();
+        vChainHash.clear();
+        vChainTime.clear();
+        vChainWork.clear();
         return;
     }
     vChain.resize(pindex->nHeight + 1);
+    vChainHash.resize(pindex->nHeight + 1);
+    vChainTime.resize(pindex->nHeight + 1);
+    vChainWork.resize(pindex->nHeight + 1);
     while (pindex && vChain[pindex->nHeight] != pindex) {
         vChain[pindex->nHeight] = pindex;
+        vChainHash[pindex->nHeight] = pindex->GetBlockHash();
+        vChainTime[pindex->nHeight] = pindex->nTime;
+        vChainWork[pindex->nHeight] = pindex->nChainWork;
         pindex = pindex->pprev;
     }
 }
@@ -59,6 +68,26 @@ const CBlockIndex *CChain::FindFork(const CBlockIndex *pindex) const {
 /** Turn the lowest '1' bit in the binary representation of a number into a '0'. */
 int static inline InvertLowestOne(int n) { return n & (n - 1); }
 
+/** Number of trailing zero bits in n. n must be nonzero. */
+int static inline TrailingZeros(int n) {
+    int k = 0;
+    while (!(n & 1)) {
+        n >>= 1;
+        k++;
+    }
+    return k;
+}
+
+/** Position of the highest set bit in n, or -1 if n is zero. */
+int static inline Log2Floor(int n) {
+    int k = -1;
+    while (n) {
+        n >>= 1;
+        k++;
+    }
+    return k;
+}
+
 /** Compute what height to jump back to with the CBlockIndex::pskip pointer. */
 int static inline GetSkipHeight(int height) {
     if (height < 2)
@@ -78,6 +107,19 @@ CBlockIndex* CBlockIndex::GetAncestor(int height)
     CBlockIndex* pindexWalk = this;
     int heightWalk = nHeight;
     while (heightWalk > height) {
+        // Take the largest precomputed jump that neither overshoots the target
+        // nor exceeds this node's level count. Following a 2^k jump from a
+        // height divisible by 2^k lands on a height divisible by 2^(k+1), so
+        // jumps keep doubling until the remaining distance binds, after which
+        // they halve: O(log n) steps in total.
+        int k = std::min(TrailingZeros(heightWalk), Log2Floor(heightWalk - height));
+        if (k >= 1 && (int)pindexWalk->vSkip.size() >= k) {
+            pindexWalk = pindexWalk->vSkip[k - 1];
+            heightWalk -= (1 << k);
+            continue;
+        }
+        // Fall back to the single pskip pointer for nodes whose jump table
+        // has not been built.
         int heightSkip = GetSkipHeight(heightWalk);
         int heightSkipPrev = GetSkipHeight(heightWalk - 1);
         if (pindexWalk->pskip != NULL &&
@@ -105,4 +147,17 @@ void CBlockIndex::BuildSkip()
 {
     if (pprev)
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
+
+    // Precompute the binary-lifting jump table. Lower levels are filled
+    // first, so each GetAncestor call below can use the entries already in
+    // place. Ancestors must have had their own tables built, which holds for
+    // both index load (ascending height) and header acceptance (parent first).
+    vSkip.clear();
+    if (nHeight > 0) {
+        int nLevels = TrailingZeros(nHeight);
+        vSkip.reserve(nLevels);
+        for (int k = 1; k <= nLevels; k++) {
+            vSkip.push_back(GetAncestor(nHeight - (1 << k)));
+        }
+    }
 }
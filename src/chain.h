@@ -12,6 +12,7 @@
 #include "tinyformat.h"
 #include "uint256.h"
 
+#include <deque>
 #include <optional>
 #include <vector>
 
@@ -19,6 +20,7 @@ static const int SPROUT_VALUE_VERSION = 1001400;
 static const int SAPLING_VALUE_VERSION = 1010100;
 static const int CHAIN_HISTORY_ROOT_VERSION = 2010200;
 static const int NU5_DATA_VERSION = 4050000;
+static const int TRANSPARENT_VALUE_VERSION = 4050650;
 
 /**
  * Maximum amount of time that a block timestamp is allowed to be ahead of the
@@ -200,6 +202,11 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip;
 
+    //! (memory only) binary-lifting jump pointers; vSkip[k-1] is the ancestor
+    //! at height nHeight - 2^k, kept for 1 <= k <= (trailing zeros of nHeight).
+    //! Averages two pointers per node and makes GetAncestor O(log n) worst case.
+    std::vector<CBlockIndex*> vSkip;
+
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
@@ -273,6 +280,18 @@ public:
     //! Will be std::nullopt if and only if nChainTx is zero.
     std::optional<CAmount> nChainOrchardValue;
 
+    //! Change in value held by transparent outputs over this block: outputs
+    //! created minus outputs spent. Only set when the block has been connected
+    //! to the main chain, since spent input values require the coins view;
+    //! std::nullopt for blocks connected by older versions until a reindex.
+    std::optional<CAmount> nTransparentValue;
+
+    //! (memory only) Total value held by transparent outputs up to and
+    //! including this block. std::nullopt if any ancestor lacks
+    //! nTransparentValue. Together with the shielded pool aggregates this
+    //! gives the total supply without scanning the UTXO set.
+    std::optional<CAmount> nChainTransparentValue;
+
     //! Root of the Sapling commitment tree as of the end of this block.
     //!
     //! - For blocks prior to (not including) the Heartwood activation block, this is
@@ -316,6 +335,7 @@ public:
         phashBlock = NULL;
         pprev = NULL;
         pskip = NULL;
+        vSkip.clear();
         nHeight = 0;
         nFile = 0;
         nDataPos = 0;
@@ -338,6 +358,8 @@ public:
         nChainSaplingValue = std::nullopt;
         nOrchardValue = 0;
         nChainOrchardValue = std::nullopt;
+        nTransparentValue = std::nullopt;
+        nChainTransparentValue = std::nullopt;
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -561,6 +583,12 @@ public:
             READWRITE(nOrchardValue);
         }
 
+        // Only read/write nTransparentValue if the client version used to
+        // create this index was storing it.
+        if ((s.GetType() & SER_DISK) && (nVersion >= TRANSPARENT_VALUE_VERSION)) {
+            READWRITE(nTransparentValue);
+        }
+
         // If you have just added new serialized fields above, remember to add
         // them to CBlockTreeDB::LoadBlockIndexGuts() in txdb.cpp :)
     }
@@ -590,10 +618,49 @@ public:
     }
 };
 
+/** Chunked arena storage for CBlockIndex nodes.
+ *
+ * Allocating every node individually scatters the block index across the
+ * heap, so chain walks (GetAncestor, FindFork) miss cache on nearly every
+ * hop. The arena hands out nodes from large contiguous chunks in insertion
+ * order — ascending height for the load-from-disk and steady-state sync
+ * paths — so consecutive hops usually land on the same pages. Node addresses
+ * are stable for the life of the arena; nodes are only released all at once.
+ */
+class CBlockIndexArena
+{
+private:
+    std::deque<CBlockIndex> arena;
+
+public:
+    CBlockIndex* Allocate()
+    {
+        arena.emplace_back();
+        return &arena.back();
+    }
+
+    CBlockIndex* Allocate(const CBlockHeader& block)
+    {
+        arena.emplace_back(block);
+        return &arena.back();
+    }
+
+    //! Release every node at once. Callers must have dropped all pointers first.
+    void Clear() { arena.clear(); }
+
+    size_t size() const { return arena.size(); }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
     std::vector<CBlockIndex*> vChain;
+    //! Flat per-height columns mirroring vChain, so scan-heavy consumers can
+    //! walk hash/time/work sequentially instead of chasing CBlockIndex
+    //! pointers through the heap.
+    std::vector<uint256> vChainHash;
+    std::vector<unsigned int> vChainTime;
+    std::vector<arith_uint256> vChainWork;
 
 public:
     /** Returns the index entry for the genesis block of this chain, or NULL if none. */
@@ -637,6 +704,27 @@ public:
         return int(vChain.size()) - 1;
     }
 
+    /** Block hash at a height of this chain, or null if out of range. */
+    uint256 HashAtHeight(int nHeight) const {
+        if (nHeight < 0 || nHeight >= (int)vChainHash.size())
+            return uint256();
+        return vChainHash[nHeight];
+    }
+
+    /** Block time at a height of this chain, or 0 if out of range. */
+    int64_t TimeAtHeight(int nHeight) const {
+        if (nHeight < 0 || nHeight >= (int)vChainTime.size())
+            return 0;
+        return vChainTime[nHeight];
+    }
+
+    /** Cumulative chain work at a height of this chain, or zero if out of range. */
+    arith_uint256 WorkAtHeight(int nHeight) const {
+        if (nHeight < 0 || nHeight >= (int)vChainWork.size())
+            return arith_uint256();
+        return vChainWork[nHeight];
+    }
+
     /** Set/initialize a chain with a given tip. */
     void SetTip(CBlockIndex *pindex);
 
@@ -6,18 +6,27 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "sync.h"
 
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/** Upper bound on the number of per-worker queues we will ever allocate.
+ *  Reserving this up front keeps the queue vector's storage stable, so
+ *  workers may index into it without holding the shared mutex. */
+static const unsigned int MAX_CHECKQUEUE_WORKERS = 64;
+
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
   * operator(), returning a bool.
@@ -26,11 +35,23 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Work is distributed over per-worker queues, each with its own lock:
+  * the master deposits a whole batch (typically one transaction's checks)
+  * on a single queue per Add() call, and workers that run dry steal half
+  * of a sibling's queue instead of serializing on one shared stack.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
+    //! A single worker's queue of elements to be processed.
+    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
+    struct WorkerQueue {
+        boost::mutex mutex;
+        std::vector<T> checks;
+    };
+
     //! Mutex to protect the inner state
     boost::mutex mutex;
 
@@ -40,9 +61,21 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! Per-worker queues. Entries are created under mutex and never removed;
+    //! the vector's capacity is reserved in the constructor so the storage
+    //! never moves and the entries can be indexed without holding mutex.
+    std::vector<std::unique_ptr<WorkerQueue>> localQueues;
+
+    //! Number of Loop() entries so far; used to assign local queues.
+    unsigned int nRegistered;
+
+    //! Round-robin cursor over localQueues for Add(); only the (single)
+    //! master mutates this, under mutex.
+    unsigned int nRound;
+
+    //! The number of checks currently sitting in local queues. Incremented
+    //! under mutex by Add(), decremented by workers as they fetch work.
+    std::atomic<unsigned int> nQueued;
 
     //! The number of workers (including the master) that are idle.
     int nIdle;
@@ -66,6 +99,43 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! When attached to a CValidationPool, Add() signals the pool through
+    //! this instead of waking dedicated workers. The bool is whether more
+    //! than one worker's worth of work arrived.
+    std::function<void(bool)> poolNotify;
+
+    /** Fetch checks into vChecks, trying our own queue first and then
+     *  stealing from siblings. Called without mutex held; returns the number
+     *  of checks fetched (0 if we lost every race). The grab is sized
+     *  adaptively: at most nBatchSize, but never more than an even share of
+     *  the remaining queued work over the nActive workers currently running,
+     *  so the tail of a block is spread across workers instead of one worker
+     *  batching it while the rest go idle. */
+    unsigned int FetchChecks(size_t nMe, size_t nQueues, unsigned int nActive, std::vector<T>& vChecks)
+    {
+        unsigned int nCap = std::min(nBatchSize,
+            std::max(1U, (unsigned int)nQueued / std::max(1U, nActive)));
+        for (size_t i = 0; i < nQueues; i++) {
+            WorkerQueue& local = *localQueues[(nMe + i) % nQueues];
+            boost::unique_lock<boost::mutex> lock(local.mutex);
+            if (local.checks.empty())
+                continue;
+            // Drain our own queue in capped chunks; when stealing take only
+            // half so the owner keeps the locality of what it enqueued.
+            unsigned int nAvail = local.checks.size();
+            unsigned int nTake = std::min(nCap, i == 0 ? nAvail : std::max(1U, nAvail / 2));
+            vChecks.resize(nTake);
+            for (unsigned int j = 0; j < nTake; j++) {
+                // Keep the lock short: swap jobs out instead of copying.
+                vChecks[j].swap(local.checks.back());
+                local.checks.pop_back();
+            }
+            nQueued.fetch_sub(nTake);
+            return nTake;
+        }
+        return 0;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
@@ -73,7 +143,11 @@ private:
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
         unsigned int nNow = 0;
+        bool fFirst = true;
         bool fOk = true;
+        size_t nMe = 0;
+        size_t nQueues = 0;
+        unsigned int nActive = 1;
         do {
             {
                 boost::unique_lock<boost::mutex> lock(mutex);
@@ -84,12 +158,19 @@ private:
                     if (nTodo == 0 && !fMaster)
                         // We processed the last element; inform the master it can exit and return the result
                         condMaster.notify_one();
-                } else {
-                    // first iteration
+                }
+                if (fFirst) {
+                    // first iteration: claim a local queue (shared with another
+                    // worker only once all MAX_CHECKQUEUE_WORKERS slots exist)
+                    nMe = nRegistered % MAX_CHECKQUEUE_WORKERS;
+                    nRegistered++;
+                    if (nMe >= localQueues.size())
+                        localQueues.emplace_back(new WorkerQueue());
                     nTotal++;
+                    fFirst = false;
                 }
                 // logically, the do loop starts here
-                while (queue.empty()) {
+                while (nQueued == 0) {
                     if ((fMaster || fQuit) && nTodo == 0) {
                         nTotal--;
                         bool fRet = fAllOk;
@@ -103,22 +184,14 @@ private:
                     cond.wait(lock); // wait
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
+                nQueues = localQueues.size();
+                nActive = std::max(1, nTotal - nIdle);
                 // Check whether we need to do work at all
                 fOk = fAllOk;
             }
+            // Fetch work outside the shared mutex; if another worker emptied
+            // every queue before we got there, just go around again.
+            nNow = FetchChecks(nMe, nQueues, nActive, vChecks);
             // execute work
             for (T& check : vChecks)
                 if (fOk)
@@ -132,7 +205,10 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nRegistered(0), nRound(0), nQueued(0), nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn)
+    {
+        localQueues.reserve(MAX_CHECKQUEUE_WORKERS);
+    }
 
     //! Worker thread
     void Thread()
@@ -146,27 +222,183 @@ public:
         return Loop(true);
     }
 
-    //! Add a batch of checks to the queue
+    //! Add a batch of checks to the queue. The whole batch lands on a single
+    //! local queue (chosen round-robin), so enqueueing one transaction's
+    //! checks costs one lock acquisition regardless of input count.
     void Add(std::vector<T>& vChecks)
     {
+        if (vChecks.empty())
+            return;
         boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (localQueues.empty())
+            localQueues.emplace_back(new WorkerQueue());
+        nRound = (nRound + 1) % localQueues.size();
+        WorkerQueue& local = *localQueues[nRound];
+        {
+            boost::unique_lock<boost::mutex> lockLocal(local.mutex);
+            for (T& check : vChecks) {
+                local.checks.push_back(T());
+                check.swap(local.checks.back());
+            }
         }
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
+        nQueued.fetch_add(vChecks.size());
+        if (poolNotify)
+            poolNotify(vChecks.size() > 1);
+        else if (vChecks.size() == 1)
             condWorker.notify_one();
         else if (vChecks.size() > 1)
             condWorker.notify_all();
     }
 
+    //! Called by CValidationPool when this queue is registered: route Add()
+    //! wakeups to the pool and make sure enough local queues exist for the
+    //! pool's workers (plus the master) to spread over.
+    void AttachToPool(std::function<void(bool)> notify, unsigned int nWorkers)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        poolNotify = notify;
+        unsigned int nWanted = std::min(nWorkers + 1, MAX_CHECKQUEUE_WORKERS);
+        while (localQueues.size() < nWanted)
+            localQueues.emplace_back(new WorkerQueue());
+    }
+
+    //! Run at most one batch on behalf of a pool worker. Returns false
+    //! without blocking when nothing could be fetched.
+    bool ServiceRound(size_t nWorkerSlot)
+    {
+        if (nQueued == 0)
+            return false;
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        bool fOk;
+        size_t nQueues;
+        unsigned int nActive;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nQueued == 0)
+                return false;
+            nQueues = localQueues.size();
+            // Pool workers do not register in nTotal, so count ourselves on
+            // top of whatever masters are currently in Loop(). Busy pool
+            // siblings are undercounted; that can only enlarge the grab,
+            // which stays bounded by nBatchSize as before.
+            nActive = std::max(1, nTotal - nIdle) + 1;
+            fOk = fAllOk;
+        }
+        unsigned int nNow = FetchChecks(nWorkerSlot % nQueues, nQueues, nActive, vChecks);
+        if (nNow == 0)
+            return false;
+        for (T& check : vChecks)
+            if (fOk)
+                fOk = check();
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fAllOk &= fOk;
+            nTodo -= nNow;
+            if (nTodo == 0)
+                // We processed the last element; the master can exit
+                condMaster.notify_one();
+        }
+        return true;
+    }
+
     ~CCheckQueue()
     {
     }
 
 };
 
+/**
+ * Shared pool of validation worker threads (sized by -par), servicing every
+ * registered CCheckQueue so that the CPU-bound subsystems draw from one set
+ * of threads instead of each spawning their own and oversubscribing the
+ * cores. Queues are serviced in registration order: after every batch a
+ * worker goes back to the first queue with work, so earlier-registered
+ * (higher priority) queues preempt later ones at batch granularity.
+ *
+ * Each queue's master still drives completion through CCheckQueueControl
+ * exactly as before; only the worker side is shared.
+ */
+class CValidationPool
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! Service hooks of the registered queues, in priority order. Bound
+    //! queues must outlive the pool's threads.
+    std::vector<std::function<bool(size_t)>> vQueues;
+    //! Bumped on every work notification so a worker busy during the
+    //! notify re-checks the queues instead of missing the wakeup. Atomic so
+    //! the spin phase in Thread() can poll it without taking mutex.
+    std::atomic<uint64_t> nGeneration;
+    //! Iterations a worker polls for new work before blocking on the
+    //! condition variable; 0 blocks immediately. See SetSpinWait().
+    unsigned int nSpinTries;
+
+public:
+    CValidationPool() : nGeneration(0), nSpinTries(0) {}
+
+    //! Enable a spin-then-sleep wait policy: idle workers poll for up to
+    //! nTries iterations before sleeping, trading idle CPU for not paying a
+    //! condition-variable wakeup on every small batch. Worthwhile at high
+    //! -par counts where checks are short relative to the wakeup latency.
+    //! Not thread-safe against running workers: call during startup only.
+    void SetSpinWait(unsigned int nTries)
+    {
+        nSpinTries = nTries;
+    }
+
+    //! Register a queue; earlier registrations have higher priority.
+    //! Not thread-safe against running workers: call during startup only.
+    template <typename T>
+    void RegisterQueue(CCheckQueue<T>& queue, unsigned int nWorkers)
+    {
+        queue.AttachToPool([this](bool fAll) { NotifyWork(fAll); }, nWorkers);
+        vQueues.push_back([&queue](size_t nWorkerSlot) { return queue.ServiceRound(nWorkerSlot); });
+    }
+
+    void NotifyWork(bool fAll)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nGeneration.fetch_add(1);
+        }
+        if (fAll)
+            cond.notify_all();
+        else
+            cond.notify_one();
+    }
+
+    //! Worker thread entry point; exits via thread interruption.
+    void Thread(size_t nWorkerSlot)
+    {
+        uint64_t nSeen = 0;
+        while (true) {
+            // Spin phase: poll the generation counter before paying for a
+            // condition-variable sleep/wakeup round trip. With many short
+            // batches the next notification usually lands within the spin
+            // window and the worker never blocks.
+            for (unsigned int nTry = 0; nTry < nSpinTries && nGeneration.load() == nSeen; nTry++)
+                boost::this_thread::interruption_point();
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (nGeneration.load() == nSeen)
+                    cond.wait(lock); // interruption point
+                nSeen = nGeneration.load();
+            }
+            // Sweep the queues in priority order; whenever a batch was run,
+            // start over so higher-priority work is picked up first.
+            for (size_t i = 0; i < vQueues.size();) {
+                if (vQueues[i](nWorkerSlot))
+                    i = 0;
+                else
+                    i++;
+            }
+        }
+    }
+};
+
 /** 
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
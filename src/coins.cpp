@@ -11,6 +11,8 @@
 
 #include <assert.h>
 
+#include <atomic>
+
 #include <tracing.h>
 
 /**
@@ -69,6 +71,9 @@ bool CCoinsView::BatchWrite(CCoinsMap &mapCoins,
                             CNullifiersMap &mapOrchardNullifiers,
                             CHistoryCacheMap &historyCacheMap) { return false; }
 bool CCoinsView::GetStats(CCoinsStats &stats) const { return false; }
+bool CCoinsView::WriteSnapshot(CAutoFile &file) const { return false; }
+bool CCoinsView::LoadSnapshot(CAutoFile &file) { return false; }
+void CCoinsView::PrefetchCoins(const uint256 &txid) const { }
 
 
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) { }
@@ -104,10 +109,15 @@ bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins,
                             historyCacheMap);
 }
 bool CCoinsViewBacked::GetStats(CCoinsStats &stats) const { return base->GetStats(stats); }
+bool CCoinsViewBacked::WriteSnapshot(CAutoFile &file) const { return base->WriteSnapshot(file); }
+bool CCoinsViewBacked::LoadSnapshot(CAutoFile &file) { return base->LoadSnapshot(file); }
+void CCoinsViewBacked::PrefetchCoins(const uint256 &txid) const { base->PrefetchCoins(txid); }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0) { }
+SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cacheCoins(0, SaltedTxidHasher(), std::equal_to<uint256>(), CCoinsMapAllocator(&cacheCoinsMemoryResource)), cachedCoinsUsage(0) { }
 
 CCoinsViewCache::~CCoinsViewCache()
 {
@@ -123,9 +133,16 @@ size_t CCoinsViewCache::DynamicMemoryUsage() const {
            memusage::DynamicUsage(cacheSaplingNullifiers) +
            memusage::DynamicUsage(cacheOrchardNullifiers) +
            memusage::DynamicUsage(historyCacheMap) +
+           memusage::DynamicUsage(historyNodeReadCache) +
            cachedCoinsUsage;
 }
 
+void CCoinsViewCache::PrefetchCoins(const uint256 &txid) const {
+    if (cacheCoins.count(txid))
+        return;
+    base->PrefetchCoins(txid);
+}
+
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const {
     CCoinsMap::iterator it = cacheCoins.find(txid);
     if (it != cacheCoins.end())
@@ -260,7 +277,28 @@ HistoryNode CCoinsViewCache::GetHistoryAt(uint32_t epochId, HistoryIndex index)
         return historyCache.appends[index];
     }
 
-    return base->GetHistoryAt(epochId, index);
+    auto key = std::make_pair(epochId, index);
+    auto cached = historyNodeReadCache.find(key);
+    if (cached != historyNodeReadCache.end()) {
+        return cached->second;
+    }
+
+    HistoryNode node = base->GetHistoryAt(epochId, index);
+    if (historyNodeReadCache.size() >= MAX_HISTORY_NODE_READ_CACHE) {
+        historyNodeReadCache.clear();
+    }
+    historyNodeReadCache.emplace(key, node);
+    return node;
+}
+
+void CCoinsViewCache::EvictHistoryNodes(uint32_t epochId, HistoryIndex newLength) const {
+    for (auto it = historyNodeReadCache.begin(); it != historyNodeReadCache.end();) {
+        if (it->first.first == epochId && it->first.second >= newLength) {
+            it = historyNodeReadCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 uint256 CCoinsViewCache::GetHistoryRoot(uint32_t epochId) const {
@@ -583,6 +621,7 @@ void CCoinsViewCache::PopHistoryNode(uint32_t epochId) {
             // Just resetting tree to empty
             historyCache.Truncate(0);
             historyCache.root = uint256();
+            EvictHistoryNodes(epochId, 0);
             return;
         }
         case 2:
@@ -606,6 +645,7 @@ void CCoinsViewCache::PopHistoryNode(uint32_t epochId) {
             }
             historyCache.Truncate(1);
             historyCache.root = newRoot;
+            EvictHistoryNodes(epochId, 1);
             return;
         }
         default:
@@ -628,6 +668,7 @@ void CCoinsViewCache::PopHistoryNode(uint32_t epochId) {
 
             historyCache.Truncate(historyCache.length - numberOfDeletes);
             historyCache.root = newRoot;
+            EvictHistoryNodes(epochId, historyCache.length);
             return;
         }
     }
@@ -665,7 +706,17 @@ void CCoinsViewCache::AbstractPopAnchor(
     }
 }
 
+/** See GetShieldedAnchorEpoch in coins.h. Bumped on every pop, including
+ *  pops on short-lived disconnect views that are later discarded; that only
+ *  over-invalidates, which is safe. */
+static std::atomic<uint64_t> nShieldedAnchorEpoch{0};
+
+uint64_t GetShieldedAnchorEpoch() {
+    return nShieldedAnchorEpoch.load();
+}
+
 void CCoinsViewCache::PopAnchor(const uint256 &newrt, ShieldedType type) {
+    nShieldedAnchorEpoch.fetch_add(1);
     switch (type) {
         case SPROUT:
             AbstractPopAnchor<SproutMerkleTree, CAnchorsSproutMap, CAnchorsSproutCacheEntry>(
@@ -969,6 +1020,25 @@ bool CCoinsViewCache::Flush() {
     return fOk;
 }
 
+void CCoinsViewCache::Reset() {
+    assert(!hasModifier);
+    cacheCoins.clear();
+    cacheSproutAnchors.clear();
+    cacheSaplingAnchors.clear();
+    cacheOrchardAnchors.clear();
+    cacheSproutNullifiers.clear();
+    cacheSaplingNullifiers.clear();
+    cacheOrchardNullifiers.clear();
+    historyCacheMap.clear();
+    // The null hashes double as the "not yet loaded" markers for the
+    // lazily-filled best block and best anchors.
+    hashBlock.SetNull();
+    hashSproutAnchor.SetNull();
+    hashSaplingAnchor.SetNull();
+    hashOrchardAnchor.SetNull();
+    cachedCoinsUsage = 0;
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -994,7 +1064,7 @@ CAmount CCoinsViewCache::GetValueIn(const CTransaction& tx) const
     return nResult;
 }
 
-std::optional<UnsatisfiedShieldedReq> CCoinsViewCache::HaveShieldedRequirements(const CTransaction& tx) const
+std::optional<UnsatisfiedShieldedReq> CCoinsViewCache::HaveShieldedRequirements(const CTransaction& tx, bool fCheckAnchors) const
 {
     boost::unordered_map<uint256, SproutMerkleTree, SaltedTxidHasher> intermediates;
 
@@ -1014,6 +1084,9 @@ std::optional<UnsatisfiedShieldedReq> CCoinsViewCache::HaveShieldedRequirements(
             }
         }
 
+        if (!fCheckAnchors)
+            continue;
+
         SproutMerkleTree tree;
         auto it = intermediates.find(joinsplit.anchor);
         if (it != intermediates.end()) {
@@ -1045,6 +1118,9 @@ std::optional<UnsatisfiedShieldedReq> CCoinsViewCache::HaveShieldedRequirements(
             return UnsatisfiedShieldedReq::SaplingDuplicateNullifier;
         }
 
+        if (!fCheckAnchors)
+            continue;
+
         SaplingMerkleTree tree;
         if (!GetSaplingAnchorAt(spendDescription.anchor, tree)) {
             auto txid = tx.GetHash().ToString();
@@ -1068,7 +1144,7 @@ std::optional<UnsatisfiedShieldedReq> CCoinsViewCache::HaveShieldedRequirements(
     }
 
     std::optional<uint256> root = tx.GetOrchardBundle().GetAnchor();
-    if (root) {
+    if (root && fCheckAnchors) {
         OrchardMerkleTree tree;
         if (!GetOrchardAnchorAt(root.value(), tree)) {
             auto txid = tx.GetHash().ToString();
@@ -11,6 +11,7 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -262,6 +263,24 @@ public:
     }
 };
 
+class SaltedOutpointHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedOutpointHasher();
+
+    /**
+     * As with SaltedTxidHasher, this *must* return size_t; see the note
+     * there regarding Boost's unordered_map on 32-bit systems.
+     */
+    size_t operator()(const COutPoint& outpoint) const {
+        return SipHashUint256Extra(k0, k1, outpoint.hash, outpoint.n);
+    }
+};
+
 struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
@@ -336,13 +355,22 @@ enum ShieldedType
     ORCHARD,
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
+/**
+ * The coin cache is by far the largest of these maps, so its nodes are
+ * carved out of a per-view PoolResource instead of going through malloc
+ * one at a time; see CCoinsViewCache::cacheCoinsMemoryResource.
+ */
+typedef PoolAllocator<std::pair<const uint256, CCoinsCacheEntry> > CCoinsMapAllocator;
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher, std::equal_to<uint256>, CCoinsMapAllocator> CCoinsMap;
 typedef boost::unordered_map<uint256, CAnchorsSproutCacheEntry, SaltedTxidHasher> CAnchorsSproutMap;
 typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, SaltedTxidHasher> CAnchorsSaplingMap;
 typedef boost::unordered_map<uint256, CAnchorsOrchardCacheEntry, SaltedTxidHasher> CAnchorsOrchardMap;
 typedef boost::unordered_map<uint256, CNullifiersCacheEntry, SaltedTxidHasher> CNullifiersMap;
 typedef boost::unordered_map<uint32_t, HistoryCache> CHistoryCacheMap;
 
+//! Upper bound on entries in the history node read cache before it is reset.
+static const size_t MAX_HISTORY_NODE_READ_CACHE = 4096;
+
 struct CCoinsStats
 {
     int nHeight;
@@ -357,6 +385,8 @@ struct CCoinsStats
 };
 
 
+class CAutoFile;
+
 /** Abstract view on the open txout dataset. */
 class CCoinsView
 {
@@ -413,6 +443,20 @@ public:
     //! Calculate statistics about the unspent transaction output set
     virtual bool GetStats(CCoinsStats &stats) const;
 
+    //! Serialize the complete contents of the view into a hash-committed
+    //! snapshot file. Only implemented by the database-backed view.
+    virtual bool WriteSnapshot(CAutoFile &file) const;
+
+    //! Replace the contents of the view with those of a snapshot file
+    //! previously produced by WriteSnapshot(). Only implemented by the
+    //! database-backed view, and only safe on an empty chainstate.
+    virtual bool LoadSnapshot(CAutoFile &file);
+
+    //! Hint that the coins for a given txid will be needed soon. Does not
+    //! mutate the view; implementations may warm lower-level caches. Must be
+    //! safe to call concurrently while the view is otherwise quiescent.
+    virtual void PrefetchCoins(const uint256 &txid) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 };
@@ -437,6 +481,7 @@ public:
     HistoryIndex GetHistoryLength(uint32_t epochId) const;
     HistoryNode GetHistoryAt(uint32_t epochId, HistoryIndex index) const;
     uint256 GetHistoryRoot(uint32_t epochId) const;
+    void PrefetchCoins(const uint256 &txid) const;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins,
                     const uint256 &hashBlock,
@@ -451,6 +496,8 @@ public:
                     CNullifiersMap &mapOrchardNullifiers,
                     CHistoryCacheMap &historyCacheMap);
     bool GetStats(CCoinsStats &stats) const;
+    bool WriteSnapshot(CAutoFile &file) const;
+    bool LoadSnapshot(CAutoFile &file);
 };
 
 
@@ -476,6 +523,13 @@ public:
     friend class CCoinsViewCache;
 };
 
+/** Generation counter for the chain's shielded anchor sets. Pushing an
+ *  anchor only ever adds a root, so a satisfied anchor check stays satisfied
+ *  until an anchor is popped (block disconnect); PopAnchor bumps this
+ *  counter, letting callers cache per-transaction anchor resolution results
+ *  keyed by (txid, epoch). */
+uint64_t GetShieldedAnchorEpoch();
+
 /** The set of shielded requirements that might be unsatisfied. */
 enum class UnsatisfiedShieldedReq {
     SproutDuplicateNullifier,
@@ -499,6 +553,8 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    /* Backing arena for cacheCoins' nodes; must be declared before the map. */
+    mutable PoolResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
     mutable uint256 hashSproutAnchor;
     mutable uint256 hashSaplingAnchor;
@@ -511,6 +567,15 @@ protected:
     mutable CNullifiersMap cacheOrchardNullifiers;
     mutable CHistoryCacheMap historyCacheMap;
 
+    /**
+     * Read cache for history tree nodes fetched from the backing view.
+     * Consecutive appends touch largely the same peak nodes, so remembering
+     * them avoids a database read per peak on every block connect. Entries
+     * above the tree length are evicted on truncation, since those positions
+     * are rewritten when the tree grows again.
+     */
+    mutable boost::unordered_map<std::pair<uint32_t, HistoryIndex>, HistoryNode> historyNodeReadCache;
+
     /* Cached dynamic memory usage for the inner CCoins objects. */
     mutable size_t cachedCoinsUsage;
 
@@ -592,6 +657,13 @@ public:
      */
     bool Flush();
 
+    /**
+     * Discard all cached state without writing it to the base view, so that
+     * subsequent reads are served from the base again. May only be called
+     * when the cache holds no changes that still need to be flushed.
+     */
+    void Reset();
+
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
@@ -611,8 +683,16 @@ public:
     //! Check whether all prevouts of the transaction are present in the UTXO set represented by this view
     bool HaveInputs(const CTransaction& tx) const;
 
-    //! Check whether all joinsplit and sapling spend requirements (anchors/nullifiers) are satisfied
-    std::optional<UnsatisfiedShieldedReq> HaveShieldedRequirements(const CTransaction& tx) const;
+    //! Forward a prefetch hint to the backing view unless the coins are
+    //! already cached here. Only reads this cache, so concurrent prefetches
+    //! are safe while the holder of cs_main is not modifying it.
+    void PrefetchCoins(const uint256 &txid) const;
+
+    //! Check whether all joinsplit and sapling spend requirements (anchors/nullifiers) are satisfied.
+    //! When fCheckAnchors is false the anchor lookups are skipped and only the
+    //! nullifier double-spend checks run; the caller must know the anchors
+    //! resolved against the current root set (see GetShieldedAnchorEpoch).
+    std::optional<UnsatisfiedShieldedReq> HaveShieldedRequirements(const CTransaction& tx, bool fCheckAnchors = true) const;
 
     //! Return priority of tx at height nHeight
     double GetPriority(const CTransaction &tx, int nHeight) const;
@@ -667,6 +747,10 @@ private:
 
     //! Selects history cache for specified epoch.
     HistoryCache& SelectHistoryCache(uint32_t epochId) const;
+
+    //! Drops read-cached history nodes at or above newLength for the epoch;
+    //! called on truncation, after which those positions may be rewritten.
+    void EvictHistoryNodes(uint32_t epochId, HistoryIndex newLength) const;
 };
 
 #endif // BITCOIN_COINS_H
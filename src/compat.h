@@ -76,6 +76,17 @@ typedef int32_t ssize_t;
 #endif
 #endif
 
+// Pick the socket event notification backend for the network thread. epoll
+// and kqueue scale to thousands of sockets with wakeups proportional to the
+// number of ready sockets; select() remains the portable fallback.
+#ifndef WIN32
+#if defined(HAVE_SYS_EPOLL_H)
+#define USE_EPOLL
+#elif defined(HAVE_SYS_EVENT_H)
+#define USE_KQUEUE
+#endif
+#endif
+
 // As Solaris does not have the MSG_NOSIGNAL flag for send(2) syscall, it is defined as 0
 #if !defined(HAVE_MSG_NOSIGNAL) && !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
@@ -97,7 +108,8 @@ size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
 bool static inline IsSelectableSocket(SOCKET s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_EPOLL) || defined(USE_KQUEUE)
+    // epoll and kqueue have no FD_SETSIZE-style limit on descriptor values.
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -9,6 +9,8 @@
 #include "pubkey.h"
 #include "script/standard.h"
 
+#include <algorithm>
+
 bool CScriptCompressor::IsToKeyID(CKeyID &hash) const
 {
     if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160
@@ -183,3 +185,97 @@ uint64_t CTxOutCompressor::DecompressAmount(uint64_t x)
     }
     return n;
 }
+
+/**
+ * Fixed dictionary for CompressBlockData, at most 16 entries (the tag byte
+ * encodes the index in its low nibble). Entries were picked from the byte
+ * strings that recur in serialized Koto transactions: the v4 transaction
+ * header and version group id, P2PKH/P2SH output script framing (including
+ * the leading script length), DER signature framing in scriptSigs, the
+ * final sequence number, and zero-valued 32/64-bit fields (lock time,
+ * expiry height, value balance). No entry is a proper prefix of an entry
+ * listed after it, so the first match below is also the longest one.
+ */
+static const std::vector<std::vector<unsigned char>> vBlockDataDict = {
+    {0x04, 0x00, 0x00, 0x80, 0x85, 0x20, 0x2f, 0x89}, // v4 header + Sapling version group id
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // zero uint64 (value balance)
+    {0x6b, 0x48, 0x30, 0x45, 0x02, 0x21, 0x00},       // scriptSig len + 72-byte DER sig framing
+    {0x6a, 0x47, 0x30, 0x44, 0x02, 0x20},             // scriptSig len + 71-byte DER sig framing
+    {0x48, 0x30, 0x45, 0x02, 0x21, 0x00},             // 72-byte DER sig framing
+    {0x47, 0x30, 0x44, 0x02, 0x20},                   // 71-byte DER sig framing
+    {0x19, 0x76, 0xa9, 0x14},                         // P2PKH script length + prefix
+    {0x17, 0xa9, 0x14},                               // P2SH script length + prefix
+    {0xff, 0xff, 0xff, 0xff},                         // final sequence number
+    {0x00, 0x00, 0x00, 0x00},                         // zero uint32 (lock time, expiry)
+    {0x01, 0x00, 0x00, 0x00},                         // uint32 one (tx version 1)
+    {0x88, 0xac},                                     // P2PKH suffix
+    {0x01, 0x21, 0x02},                               // SIGHASH_ALL + even pubkey framing
+    {0x01, 0x21, 0x03},                               // SIGHASH_ALL + odd pubkey framing
+};
+
+//! Tags at or above this value reference a dictionary entry; below it the
+//! tag is a literal run of tag+1 bytes (so runs of up to 240 bytes).
+static const unsigned char BLOCK_DATA_DICT_TAG = 0xf0;
+
+std::vector<unsigned char> CompressBlockData(const std::vector<unsigned char>& vchIn)
+{
+    std::vector<unsigned char> out;
+    out.reserve(vchIn.size() + vchIn.size() / BLOCK_DATA_DICT_TAG + 1);
+    size_t nLitStart = 0;
+
+    auto FlushLiterals = [&](size_t nEnd) {
+        while (nLitStart < nEnd) {
+            size_t nRun = std::min(nEnd - nLitStart, (size_t)BLOCK_DATA_DICT_TAG);
+            out.push_back((unsigned char)(nRun - 1));
+            out.insert(out.end(), vchIn.begin() + nLitStart, vchIn.begin() + nLitStart + nRun);
+            nLitStart += nRun;
+        }
+    };
+
+    for (size_t i = 0; i < vchIn.size();) {
+        size_t nMatch = vBlockDataDict.size();
+        for (size_t j = 0; j < vBlockDataDict.size(); j++) {
+            const std::vector<unsigned char>& entry = vBlockDataDict[j];
+            if (i + entry.size() <= vchIn.size() &&
+                memcmp(vchIn.data() + i, entry.data(), entry.size()) == 0) {
+                nMatch = j;
+                break; // no later entry can match longer (see table comment)
+            }
+        }
+        if (nMatch < vBlockDataDict.size()) {
+            FlushLiterals(i);
+            out.push_back((unsigned char)(BLOCK_DATA_DICT_TAG + nMatch));
+            i += vBlockDataDict[nMatch].size();
+            nLitStart = i;
+        } else {
+            i++;
+        }
+    }
+    FlushLiterals(vchIn.size());
+    return out;
+}
+
+bool DecompressBlockData(const std::vector<unsigned char>& vchIn, std::vector<unsigned char>& vchOut, size_t nMaxOut)
+{
+    vchOut.clear();
+    size_t i = 0;
+    while (i < vchIn.size()) {
+        unsigned char tag = vchIn[i++];
+        if (tag < BLOCK_DATA_DICT_TAG) {
+            size_t nRun = (size_t)tag + 1;
+            if (nRun > vchIn.size() - i || vchOut.size() + nRun > nMaxOut)
+                return false;
+            vchOut.insert(vchOut.end(), vchIn.begin() + i, vchIn.begin() + i + nRun);
+            i += nRun;
+        } else {
+            size_t nIndex = tag - BLOCK_DATA_DICT_TAG;
+            if (nIndex >= vBlockDataDict.size())
+                return false;
+            const std::vector<unsigned char>& entry = vBlockDataDict[nIndex];
+            if (vchOut.size() + entry.size() > nMaxOut)
+                return false;
+            vchOut.insert(vchOut.end(), entry.begin(), entry.end());
+        }
+    }
+    return true;
+}
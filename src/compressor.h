@@ -118,4 +118,20 @@ public:
     }
 };
 
+/** Dictionary codec for serialized blocks stored on disk (-blockcompress).
+ *
+ *  A compressed record is a stream of tokens: tags below 0xF0 introduce a
+ *  literal run of tag+1 bytes, tags from 0xF0 reference an entry of a fixed
+ *  dictionary of byte strings that recur in serialized transactions (script
+ *  templates, signature framing, common header and sequence values). The
+ *  transform is byte-exact by construction; most of a block (hashes,
+ *  signatures, shielded proofs) is incompressible entropy, so the savings
+ *  are limited to the structural bytes around it.
+ */
+std::vector<unsigned char> CompressBlockData(const std::vector<unsigned char>& vchIn);
+
+/** Invert CompressBlockData. Returns false on a malformed stream or if the
+ *  output would exceed nMaxOut; vchOut is only valid when true is returned. */
+bool DecompressBlockData(const std::vector<unsigned char>& vchIn, std::vector<unsigned char>& vchOut, size_t nMaxOut);
+
 #endif // BITCOIN_COMPRESSOR_H
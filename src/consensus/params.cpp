@@ -13,10 +13,6 @@
 #include <limits.h>
 
 namespace Consensus {
-    bool Params::NetworkUpgradeActive(int nHeight, Consensus::UpgradeIndex idx) const {
-        return NetworkUpgradeState(nHeight, *this, idx) == UPGRADE_ACTIVE;
-    }
-
     bool Params::FeatureRequired(const Consensus::ConsensusFeature feature) const {
         return vRequiredFeatures.count(feature) > 0;
     }
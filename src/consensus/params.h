@@ -229,8 +229,16 @@ struct Params {
      * Returns true if the given network upgrade is active as of the given block
      * height. Caller must check that the height is >= 0 (and handle unknown
      * heights).
+     *
+     * Defined inline: validation calls this several times per transaction, so
+     * the check should compile down to two loads and two comparisons rather
+     * than a cross-translation-unit call into NetworkUpgradeState().
      */
-    bool NetworkUpgradeActive(int nHeight, Consensus::UpgradeIndex idx) const;
+    bool NetworkUpgradeActive(int nHeight, Consensus::UpgradeIndex idx) const {
+        int nActivationHeight = vUpgrades[idx].nActivationHeight;
+        return nActivationHeight != Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT &&
+               nHeight >= nActivationHeight;
+    }
 
     bool FutureTimestampSoftForkActive(int nHeight) const;
 
@@ -85,20 +85,6 @@ UpgradeState NetworkUpgradeState(
     }
 }
 
-int CurrentEpoch(int nHeight, const Consensus::Params& params) {
-    for (auto idxInt = Consensus::MAX_NETWORK_UPGRADES - 1; idxInt >= Consensus::BASE_SPROUT; idxInt--) {
-        if (params.NetworkUpgradeActive(nHeight, Consensus::UpgradeIndex(idxInt))) {
-            return idxInt;
-        }
-    }
-    // Base case
-    return Consensus::BASE_SPROUT;
-}
-
-uint32_t CurrentEpochBranchId(int nHeight, const Consensus::Params& params) {
-    return NetworkUpgradeInfo[CurrentEpoch(nHeight, params)].nBranchId;
-}
-
 uint32_t PrevEpochBranchId(uint32_t currentBranchId, const Consensus::Params& params) {
     for (int idx = Consensus::BASE_SPROUT + 1; idx < Consensus::MAX_NETWORK_UPGRADES; idx++) {
         if (currentBranchId == NetworkUpgradeInfo[idx].nBranchId) {
@@ -43,15 +43,29 @@ UpgradeState NetworkUpgradeState(
  * (corresponding to the current "epoch"). Consensus::BASE_SPROUT is the
  * default value if no upgrades are active. Caller must check that the height
  * is >= 0 (and handle unknown heights).
+ *
+ * Defined inline: this runs for every transaction validated, and vUpgrades is
+ * a small flat array ordered by upgrade index, so the scan compiles down to a
+ * handful of comparisons with no function calls.
  */
-int CurrentEpoch(int nHeight, const Consensus::Params& params);
+inline int CurrentEpoch(int nHeight, const Consensus::Params& params) {
+    for (auto idxInt = Consensus::MAX_NETWORK_UPGRADES - 1; idxInt >= Consensus::BASE_SPROUT; idxInt--) {
+        if (params.NetworkUpgradeActive(nHeight, Consensus::UpgradeIndex(idxInt))) {
+            return idxInt;
+        }
+    }
+    // Base case
+    return Consensus::BASE_SPROUT;
+}
 
 /**
  * Returns the branch ID of the most recent upgrade as of the given block height
  * (corresponding to the current "epoch"), or 0 if no upgrades are active.
  * Caller must check that the height is >= 0 (and handle unknown heights).
  */
-uint32_t CurrentEpochBranchId(int nHeight, const Consensus::Params& params);
+inline uint32_t CurrentEpochBranchId(int nHeight, const Consensus::Params& params) {
+    return NetworkUpgradeInfo[CurrentEpoch(nHeight, params)].nBranchId;
+}
 
 /**
  * Returns the branch ID that preceded currentBranchId, or 0 if no upgrade
@@ -8,7 +8,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-/** A PRNG class for ChaCha20. */
+/** A PRNG class for ChaCha20.
+ *
+ * This scalar implementation only backs FastRandomContext, where single-block
+ * keystream generation dominates and SIMD multi-block kernels would not pay
+ * off. Note encryption and trial decryption do not go through this class:
+ * Sprout uses libsodium's chacha20poly1305 and Sapling goes through
+ * librustzcash, both of which already dispatch to vectorized implementations
+ * at runtime.
+ */
 class ChaCha20
 {
 private:
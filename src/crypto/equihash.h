@@ -223,20 +223,29 @@ public:
 
 #include "equihash.tcc"
 
-static Equihash<96,3> Eh96_3;
+/**
+ * The parameter sets reachable through the Eh* dispatch below. Every set
+ * listed here instantiates the full solver machinery in each translation
+ * unit that solves, so the list is restricted to the sets with an in-tree
+ * caller: (200,9) is the hot set used by the solveequihash benchmark (both
+ * the reference and tromp engines), and (96,5) is exercised by the unit
+ * tests. The chain's proof of work is yespower, so no consensus rule
+ * depends on this list; code that needs another set (e.g. the gtest suite
+ * with (48,5)) can instantiate Equihash<N,K> directly.
+ */
+constexpr bool EhParamsSupported(unsigned int n, unsigned int k)
+{
+    return (n == 200 && k == 9) || (n == 96 && k == 5);
+}
+
 static Equihash<200,9> Eh200_9;
 static Equihash<96,5> Eh96_5;
-static Equihash<48,5> Eh48_5;
 
 #define EhInitialiseState(n, k, base_state)  \
-    if (n == 96 && k == 3) {                 \
-        Eh96_3.InitialiseState(base_state);  \
-    } else if (n == 200 && k == 9) {         \
+    if (n == 200 && k == 9) {                \
         Eh200_9.InitialiseState(base_state); \
     } else if (n == 96 && k == 5) {          \
         Eh96_5.InitialiseState(base_state);  \
-    } else if (n == 48 && k == 5) {          \
-        Eh48_5.InitialiseState(base_state);  \
     } else {                                 \
         throw std::invalid_argument("Unsupported Equihash parameters"); \
     }
@@ -245,14 +254,10 @@ inline bool EhBasicSolve(unsigned int n, unsigned int k, const eh_HashState& bas
                     const std::function<bool(std::vector<unsigned char>)> validBlock,
                     const std::function<bool(EhSolverCancelCheck)> cancelled)
 {
-    if (n == 96 && k == 3) {
-        return Eh96_3.BasicSolve(base_state, validBlock, cancelled);
-    } else if (n == 200 && k == 9) {
+    if (n == 200 && k == 9) {
         return Eh200_9.BasicSolve(base_state, validBlock, cancelled);
     } else if (n == 96 && k == 5) {
         return Eh96_5.BasicSolve(base_state, validBlock, cancelled);
-    } else if (n == 48 && k == 5) {
-        return Eh48_5.BasicSolve(base_state, validBlock, cancelled);
     } else {
         throw std::invalid_argument("Unsupported Equihash parameters");
     }
@@ -269,14 +274,10 @@ inline bool EhOptimisedSolve(unsigned int n, unsigned int k, const eh_HashState&
                     const std::function<bool(std::vector<unsigned char>)> validBlock,
                     const std::function<bool(EhSolverCancelCheck)> cancelled)
 {
-    if (n == 96 && k == 3) {
-        return Eh96_3.OptimisedSolve(base_state, validBlock, cancelled);
-    } else if (n == 200 && k == 9) {
+    if (n == 200 && k == 9) {
         return Eh200_9.OptimisedSolve(base_state, validBlock, cancelled);
     } else if (n == 96 && k == 5) {
         return Eh96_5.OptimisedSolve(base_state, validBlock, cancelled);
-    } else if (n == 48 && k == 5) {
-        return Eh48_5.OptimisedSolve(base_state, validBlock, cancelled);
     } else {
         throw std::invalid_argument("Unsupported Equihash parameters");
     }
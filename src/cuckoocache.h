@@ -0,0 +1,201 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_CUCKOOCACHE_H
+#define BITCOIN_CUCKOOCACHE_H
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+/** Fixed-memory key/value cache based on partial-key cuckoo hashing
+ *  (Fan et al., "Cuckoo Filter: Practically Better Than Bloom").
+ *
+ * All memory is allocated up front, so the cache never grows, never
+ * rebalances, and never allocates on the hot path. Entries live in 4-way
+ * buckets; each slot carries a one-byte tag derived from the key's hash, and
+ * the four tags of a bucket are contiguous so a probe inspects a single
+ * 32-bit word before ever touching a full entry. Every key has two candidate
+ * buckets, the second derived from the first and the tag alone, which lets
+ * insertion displace an existing entry to its alternate bucket without
+ * rehashing its key.
+ *
+ * The cache is lossy by design: if an insertion cannot find room after a
+ * bounded number of displacements, the displaced entry is dropped. It is
+ * therefore only suitable for bookkeeping where forgetting an entry degrades
+ * service quality rather than correctness (block source tracking, inventory
+ * dedup, validation caches).
+ *
+ * The Hasher must produce uniformly distributed 64-bit values; for keys an
+ * adversary can influence it must be keyed (a salted SipHash or similar), as
+ * colliding tags let an attacker evict entries of their choosing.
+ *
+ * Not thread safe; callers synchronize externally (cs_main for the uses in
+ * main.cpp).
+ */
+template <typename K, typename V, typename Hasher>
+class cuckoocache
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+
+private:
+    struct Entry {
+        key_type key;
+        mapped_type value;
+    };
+
+    static const unsigned int BUCKET_SIZE = 4;
+    //! Displacement bound before an insertion gives up and drops an entry.
+    static const unsigned int MAX_KICKS = 32;
+    //! Odd multiplier mixing the tag into the alternate bucket index.
+    static const uint32_t TAG_MULT = 0x5bd1e995;
+
+    //! One-byte partial keys, BUCKET_SIZE per bucket; 0 marks an empty slot.
+    std::vector<uint8_t> vTags;
+    std::vector<Entry> vEntries;
+    //! Number of buckets; always a power of two.
+    uint32_t nBuckets;
+    size_t nEntries;
+    Hasher hasher;
+
+    static uint8_t TagOf(uint64_t hash)
+    {
+        uint8_t tag = hash >> 56;
+        return tag == 0 ? 1 : tag;
+    }
+    uint32_t FirstBucket(uint64_t hash) const { return (uint32_t)hash & (nBuckets - 1); }
+    //! Involution: AltBucket(AltBucket(b, tag), tag) == b, so an entry can be
+    //! bounced between its two buckets knowing only its tag.
+    uint32_t AltBucket(uint32_t bucket, uint8_t tag) const { return (bucket ^ (tag * TAG_MULT)) & (nBuckets - 1); }
+    size_t Slot(uint32_t bucket, unsigned int i) const { return (size_t)bucket * BUCKET_SIZE + i; }
+
+    //! Return the slot holding k in the given bucket, or -1.
+    int FindInBucket(uint32_t bucket, uint8_t tag, const key_type& k) const
+    {
+        for (unsigned int i = 0; i < BUCKET_SIZE; i++) {
+            size_t s = Slot(bucket, i);
+            if (vTags[s] == tag && vEntries[s].key == k)
+                return i;
+        }
+        return -1;
+    }
+
+    //! Place an entry in the first empty slot of a bucket, if any.
+    bool PlaceInBucket(uint32_t bucket, uint8_t tag, const Entry& entry)
+    {
+        for (unsigned int i = 0; i < BUCKET_SIZE; i++) {
+            size_t s = Slot(bucket, i);
+            if (vTags[s] == 0) {
+                vTags[s] = tag;
+                vEntries[s] = entry;
+                nEntries++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    //! All memory is allocated here; nMaxElements is rounded up to the next
+    //! power-of-two number of buckets.
+    cuckoocache(size_t nMaxElements)
+    {
+        assert(nMaxElements > 0);
+        nBuckets = 2;
+        while ((size_t)nBuckets * BUCKET_SIZE < nMaxElements)
+            nBuckets <<= 1;
+        vTags.assign((size_t)nBuckets * BUCKET_SIZE, 0);
+        vEntries.resize((size_t)nBuckets * BUCKET_SIZE);
+        nEntries = 0;
+    }
+
+    size_t size() const { return nEntries; }
+    size_t max_size() const { return vEntries.size(); }
+    bool empty() const { return nEntries == 0; }
+
+    bool find(const key_type& k, mapped_type& v) const
+    {
+        uint64_t hash = hasher(k);
+        uint8_t tag = TagOf(hash);
+        uint32_t bucket = FirstBucket(hash);
+        int i = FindInBucket(bucket, tag, k);
+        if (i < 0) {
+            bucket = AltBucket(bucket, tag);
+            i = FindInBucket(bucket, tag, k);
+            if (i < 0)
+                return false;
+        }
+        v = vEntries[Slot(bucket, i)].value;
+        return true;
+    }
+
+    //! Insert or overwrite. May drop an unrelated entry if both candidate
+    //! buckets along the displacement path are full.
+    void insert(const key_type& k, const mapped_type& v)
+    {
+        uint64_t hash = hasher(k);
+        uint8_t tag = TagOf(hash);
+        uint32_t b1 = FirstBucket(hash);
+        uint32_t b2 = AltBucket(b1, tag);
+        // An existing entry for the key is overwritten in place; insertion
+        // checks both buckets first, so a key is never stored twice.
+        int i = FindInBucket(b1, tag, k);
+        if (i >= 0) {
+            vEntries[Slot(b1, i)].value = v;
+            return;
+        }
+        i = FindInBucket(b2, tag, k);
+        if (i >= 0) {
+            vEntries[Slot(b2, i)].value = v;
+            return;
+        }
+        Entry entry;
+        entry.key = k;
+        entry.value = v;
+        if (PlaceInBucket(b1, tag, entry) || PlaceInBucket(b2, tag, entry))
+            return;
+        // Both buckets full: displace entries towards their alternate buckets
+        // until a slot opens up or the kick budget runs out.
+        uint32_t bucket = b2;
+        for (unsigned int kick = 0; kick < MAX_KICKS; kick++) {
+            size_t s = Slot(bucket, kick & (BUCKET_SIZE - 1));
+            std::swap(tag, vTags[s]);
+            std::swap(entry, vEntries[s]);
+            bucket = AltBucket(bucket, tag);
+            if (PlaceInBucket(bucket, tag, entry))
+                return;
+        }
+        // Give up: drop the entry left in hand. Every swap above replaced a
+        // stored entry with the pending one, so the net effect is that the
+        // new key went in and one old entry was forgotten.
+    }
+
+    void erase(const key_type& k)
+    {
+        uint64_t hash = hasher(k);
+        uint8_t tag = TagOf(hash);
+        uint32_t bucket = FirstBucket(hash);
+        int i = FindInBucket(bucket, tag, k);
+        if (i < 0) {
+            bucket = AltBucket(bucket, tag);
+            i = FindInBucket(bucket, tag, k);
+            if (i < 0)
+                return;
+        }
+        vTags[Slot(bucket, i)] = 0;
+        nEntries--;
+    }
+
+    void clear()
+    {
+        std::fill(vTags.begin(), vTags.end(), 0);
+        nEntries = 0;
+    }
+};
+
+#endif // BITCOIN_CUCKOOCACHE_H
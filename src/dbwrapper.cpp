@@ -19,10 +19,13 @@ static leveldb::Options GetOptions(size_t nCacheSize)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    // Up to two write buffers may be held in memory simultaneously.
+    options.write_buffer_size = GetArg("-dbwritebuffersize", nCacheSize / 4);
+    int nFilterBits = GetArg("-dbfilterbits", DEFAULT_DB_FILTER_BITS);
+    if (nFilterBits > 0)
+        options.filter_policy = leveldb::NewBloomFilterPolicy(nFilterBits);
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.max_open_files = GetArg("-dbmaxopenfiles", DEFAULT_DB_MAX_OPEN_FILES);
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
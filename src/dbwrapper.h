@@ -12,12 +12,19 @@
 #include "util.h"
 #include "version.h"
 
+#include <memory>
+
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+//! -dbfilterbits default: bloom filter bits per key, 0 disables the filter
+static const int DEFAULT_DB_FILTER_BITS = 10;
+//! -dbmaxopenfiles default
+static const int DEFAULT_DB_MAX_OPEN_FILES = 64;
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -44,12 +51,19 @@ class CDBBatch
 private:
     const CDBWrapper &parent;
     leveldb::WriteBatch batch;
+    size_t size_estimate;
 
 public:
     /**
      * @param[in] _parent   CDBWrapper that this batch is to be submitted to
      */
-    CDBBatch(const CDBWrapper &_parent) : parent(_parent) { };
+    CDBBatch(const CDBWrapper &_parent) : parent(_parent), size_estimate(0) { };
+
+    void Clear()
+    {
+        batch.Clear();
+        size_estimate = 0;
+    }
 
     template <typename K, typename V>
     void Write(const K& key, const V& value)
@@ -65,6 +79,26 @@ public:
         leveldb::Slice slValue(ssValue.data(), ssValue.size());
 
         batch.Put(slKey, slValue);
+        // LevelDB serializes writes as:
+        // - byte: header
+        // - varint: key length (1 byte up to 127B, 2 bytes up to 16383B, ...)
+        // - byte[]: key
+        // - varint: value length
+        // - byte[]: value
+        // The formula below assumes the key and value are both less than 16k.
+        size_estimate += 3 + (slKey.size() > 127) + slKey.size() + (slValue.size() > 127) + slValue.size();
+    }
+
+    //! Queue a pre-serialized key/value pair, as produced by
+    //! CDBIterator::GetKeyRaw()/GetValueRaw().
+    void WriteRaw(const std::vector<unsigned char>& key, const std::vector<unsigned char>& value)
+    {
+        leveldb::Slice slKey((const char*)key.data(), key.size());
+        leveldb::Slice slValue((const char*)value.data(), value.size());
+
+        batch.Put(slKey, slValue);
+        // See the comment in Write() for the provenance of this formula.
+        size_estimate += 3 + (slKey.size() > 127) + slKey.size() + (slValue.size() > 127) + slValue.size();
     }
 
     template <typename K>
@@ -76,7 +110,14 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         batch.Delete(slKey);
+        // LevelDB serializes erases as:
+        // - byte: header
+        // - varint: key length
+        // - byte[]: key
+        size_estimate += 2 + (slKey.size() > 127) + slKey.size();
     }
+
+    size_t SizeEstimate() const { return size_estimate; }
 };
 
 class CDBIterator
@@ -120,6 +161,12 @@ public:
         return true;
     }
 
+    //! Copy out the raw serialized key bytes at the current position.
+    void GetKeyRaw(std::vector<unsigned char>& key) {
+        leveldb::Slice slKey = piter->key();
+        key.assign(slKey.data(), slKey.data() + slKey.size());
+    }
+
     unsigned int GetKeySize() {
         return piter->key().size();
     }
@@ -135,12 +182,71 @@ public:
         return true;
     }
 
+    //! Copy out the raw serialized value bytes at the current position.
+    void GetValueRaw(std::vector<unsigned char>& value) {
+        leveldb::Slice slValue = piter->value();
+        value.assign(slValue.data(), slValue.data() + slValue.size());
+    }
+
     unsigned int GetValueSize() {
         return piter->value().size();
     }
 
 };
 
+/** RAII wrapper around a LevelDB snapshot: a consistent, read-only view of
+ *  the database as of the moment it was taken, readable without blocking or
+ *  being affected by concurrent writers. */
+class CDBSnapshot
+{
+private:
+    friend class CDBWrapper;
+
+    leveldb::DB* pdb;
+    const leveldb::Snapshot* psnapshot;
+    leveldb::ReadOptions readoptions;
+
+    CDBSnapshot(leveldb::DB* pdbIn, const leveldb::ReadOptions& baseoptions) : pdb(pdbIn), readoptions(baseoptions)
+    {
+        psnapshot = pdb->GetSnapshot();
+        readoptions.snapshot = psnapshot;
+    }
+
+public:
+    ~CDBSnapshot()
+    {
+        pdb->ReleaseSnapshot(psnapshot);
+    }
+
+    CDBSnapshot(const CDBSnapshot&) = delete;
+    CDBSnapshot& operator=(const CDBSnapshot&) = delete;
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey << key;
+        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return false;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            dbwrapper_private::HandleError(status);
+        }
+        try {
+            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> value;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+};
+
 class CDBWrapper
 {
 private:
@@ -175,6 +281,12 @@ public:
     CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
     ~CDBWrapper();
 
+    //! Fetch a LevelDB property (e.g. "leveldb.stats") for this database.
+    bool GetProperty(const std::string& strProperty, std::string& strValue) const
+    {
+        return pdb->GetProperty(strProperty, &strValue);
+    }
+
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
@@ -254,6 +366,12 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    //! Take a consistent read-only snapshot of the current database state.
+    std::unique_ptr<CDBSnapshot> GetSnapshot() const
+    {
+        return std::unique_ptr<CDBSnapshot>(new CDBSnapshot(pdb, readoptions));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
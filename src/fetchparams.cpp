@@ -13,12 +13,51 @@
 #include <stdio.h>
 #include <curl/curl.h>
 #include <curl/easy.h>
-#include "sha256.h"
+#include "crypto/sha256.h"
 
+#include <atomic>
+#include <fstream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#ifdef WIN32
+#define FSEEK64 _fseeki64
+#else
+#define FSEEK64 fseeko
+#endif
+
+/** Size of one download chunk. Each completed chunk is recorded (with its
+ *  SHA256) in a sidecar state file, so an interrupted download resumes at
+ *  chunk granularity. */
+static const long long FETCH_CHUNK_SIZE = 16 << 20;
+
+/** Number of parallel download connections. */
+static const int FETCH_THREADS = 4;
+
+/** Attempts per chunk before the download is given up (and left on disk for
+ *  the next run to resume). */
+static const int FETCH_CHUNK_RETRIES = 3;
+
+static std::string LTZ_HashToHex(const unsigned char hash[CSHA256::OUTPUT_SIZE])
+{
+    std::ostringstream oss;
+    for (size_t i = 0; i < CSHA256::OUTPUT_SIZE; ++i)
+        oss << strprintf("%02x", hash[i]);
+    return oss.str();
+}
+
+static std::string LTZ_DisplayName(const std::string& file)
+{
+    size_t pos = file.find("sprout");
+    if (pos == std::string::npos)
+        pos = file.find("sapling");
+    return (pos == std::string::npos) ? file : file.substr(pos);
+}
 
 bool LTZ_VerifyParams(std::string file, std::string sha256expected)
 {
@@ -29,42 +68,34 @@ bool LTZ_VerifyParams(std::string file, std::string sha256expected)
     if(!fp) {
         msg = "Can not open " + file + "!";
         LogPrintf("%s\n", msg.c_str());
+        return false;
     }
 
     unsigned char buffer[BUFSIZ];
-    unsigned char hash[32];
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
 
-    int len = 0;
     int bytesRead = 0;
 
-    int pos = file.find("sprout");
-    if (pos == std::string::npos)
-	pos = file.find("sapling");
-    std::string initMsg = "Verifying " + file.substr(pos) + "...";
+    std::string initMsg = "Verifying " + LTZ_DisplayName(file) + "...";
     uiInterface.InitMessage(_(initMsg.c_str()));
 
-    SHA256_CTX ctx;
-    SHA256_Init(&ctx);
-
+    CSHA256 hasher;
     while((bytesRead = fread(buffer, 1, BUFSIZ, fp)))
     {
-        SHA256_Update(&ctx, buffer, bytesRead);
+        hasher.Write(buffer, bytesRead);
     }
-    SHA256_Final(hash, &ctx);
+    hasher.Finalize(hash);
 
     fclose(fp);
 
-    std::ostringstream oss;
-    for (int i = 0; i < 32; ++i)
-        oss << strprintf("%02x", hash[i]);
+    std::string sha256sum = LTZ_HashToHex(hash);
+    LogPrintf("SHA256SUM: %s\n", sha256sum);
 
-    LogPrintf("SHA256SUM: %s\n", oss.str());
-
-    if (!(sha256expected.compare(oss.str()) == 0))
+    if (!(sha256expected.compare(sha256sum) == 0))
     {
         msg = "Deleting corrupted file " + file + "!";
         LogPrintf("%s\n", msg.c_str());
-        initMsg = "Deleting corrupted file " + file.substr(pos) + "!";
+        initMsg = "Deleting corrupted file " + LTZ_DisplayName(file) + "!";
         uiInterface.InitMessage(_(initMsg.c_str()));
         boost::filesystem::remove(file.c_str());
         return false;
@@ -73,48 +104,350 @@ bool LTZ_VerifyParams(std::string file, std::string sha256expected)
     return true;
 }
 
-bool LTZ_FetchParams(std::string url, std::string file)
+/** Probe the server for the size of the file behind url. Returns false if the
+ *  length cannot be determined (in which case we fall back to a single
+ *  stream). */
+static bool LTZ_ProbeLength(const std::string& url, long long& nLength)
+{
+    CURL* curl = curl_easy_init();
+    if (!curl)
+        return false;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
+    CURLcode res = curl_easy_perform(curl);
+    curl_off_t cLength = -1;
+    if (res == CURLE_OK)
+        curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &cLength);
+    curl_easy_cleanup(curl);
+    if (res != CURLE_OK || cLength <= 0)
+        return false;
+    nLength = (long long)cLength;
+    return true;
+}
+
+/** Streams one ranged response into the partial file while hashing it. */
+struct LTZ_ChunkSink
+{
+    FILE* fp;
+    CSHA256 hasher;
+    long long nWritten;
+    long long nExpected;
+};
+
+static size_t LTZ_ChunkWrite(void* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    LTZ_ChunkSink* sink = (LTZ_ChunkSink*)userdata;
+    size_t n = size * nmemb;
+    // More data than the requested range means the server ignored the range
+    // header; abort the transfer rather than scribble over other chunks.
+    if (sink->nWritten + (long long)n > sink->nExpected)
+        return 0;
+    if (fwrite(ptr, 1, n, sink->fp) != n)
+        return 0;
+    sink->hasher.Write((const unsigned char*)ptr, n);
+    sink->nWritten += n;
+    return n;
+}
+
+/** Shared state of one parallel download. */
+struct LTZ_FetchCtx
+{
+    std::string url;
+    std::string partfile;
+    std::string statefile;
+    long long nLength;
+    long long nChunks;
+    std::vector<bool> vHave;              // chunks verified complete before the workers start
+    std::atomic<long long> nNext{0};      // next chunk index to hand out
+    std::atomic<long long> nDone{0};      // chunks finished (including resumed ones)
+    std::atomic<bool> fFailed{false};
+    std::atomic<bool> fNoRanges{false};   // server answered 200 to a range request
+    std::mutex stateMutex;                // guards appends to the state file
+};
+
+/** Load the chunk state file and re-verify every recorded chunk against the
+ *  bytes actually present in the partial file, dropping entries that do not
+ *  match. The state file is rewritten with only the surviving entries. */
+static void LTZ_LoadChunkState(LTZ_FetchCtx& ctx)
+{
+    ctx.vHave.assign(ctx.nChunks, false);
+    std::ifstream in(ctx.statefile.c_str());
+    if (!in)
+        return;
+    FILE* fp = fopen(ctx.partfile.c_str(), "rb");
+    if (!fp)
+        return;
+
+    std::vector<std::pair<long long, std::string>> vValid;
+    std::string line;
+    std::vector<unsigned char> buffer(BUFSIZ);
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        long long idx = -1;
+        std::string hex;
+        if (!(iss >> idx >> hex) || idx < 0 || idx >= ctx.nChunks || ctx.vHave[idx])
+            continue;
+        long long start = idx * FETCH_CHUNK_SIZE;
+        long long remaining = std::min(FETCH_CHUNK_SIZE, ctx.nLength - start);
+        if (FSEEK64(fp, start, SEEK_SET) != 0)
+            continue;
+        CSHA256 hasher;
+        while (remaining > 0) {
+            size_t nRead = fread(buffer.data(), 1, std::min((long long)buffer.size(), remaining), fp);
+            if (nRead == 0)
+                break;
+            hasher.Write(buffer.data(), nRead);
+            remaining -= nRead;
+        }
+        if (remaining != 0)
+            continue;
+        unsigned char hash[CSHA256::OUTPUT_SIZE];
+        hasher.Finalize(hash);
+        if (LTZ_HashToHex(hash) == hex) {
+            ctx.vHave[idx] = true;
+            vValid.emplace_back(idx, hex);
+        }
+    }
+    fclose(fp);
+    in.close();
+
+    std::ofstream out(ctx.statefile.c_str(), std::ios::trunc);
+    for (const auto& entry : vValid)
+        out << entry.first << " " << entry.second << "\n";
+
+    if (!vValid.empty())
+        LogPrintf("Resuming download of %s: %d of %d chunks already present\n",
+                  ctx.partfile, (int)vValid.size(), (int)ctx.nChunks);
+}
+
+/** Download one chunk into the partial file. Returns true and the chunk's
+ *  SHA256 on success. Sets ctx.fNoRanges if the server ignored the range
+ *  request. */
+static bool LTZ_FetchChunk(LTZ_FetchCtx& ctx, CURL* curl, FILE* fp, long long idx, std::string& hexOut)
 {
-    CURL *curl;
-    FILE *fp;
-    CURLcode res;
+    long long start = idx * FETCH_CHUNK_SIZE;
+    long long end = std::min(start + FETCH_CHUNK_SIZE, ctx.nLength) - 1;
 
+    if (FSEEK64(fp, start, SEEK_SET) != 0)
+        return false;
+
+    LTZ_ChunkSink sink;
+    sink.fp = fp;
+    sink.nWritten = 0;
+    sink.nExpected = end - start + 1;
+
+    std::ostringstream range;
+    range << start << "-" << end;
+
+    curl_easy_setopt(curl, CURLOPT_URL, ctx.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_RANGE, range.str().c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, LTZ_ChunkWrite);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
+    curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
+
+    CURLcode res = curl_easy_perform(curl);
+    long responseCode = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    if (responseCode == 200) {
+        ctx.fNoRanges = true;
+        return false;
+    }
+    if (res != CURLE_OK || responseCode != 206 || sink.nWritten != sink.nExpected || fflush(fp) != 0)
+        return false;
+
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    sink.hasher.Finalize(hash);
+    hexOut = LTZ_HashToHex(hash);
+    return true;
+}
+
+static void LTZ_FetchChunkWorker(LTZ_FetchCtx* ctx)
+{
+    CURL* curl = curl_easy_init();
+    FILE* fp = fopen(ctx->partfile.c_str(), "r+b");
+    if (!curl || !fp) {
+        ctx->fFailed = true;
+    } else {
+        while (!ctx->fFailed && !ctx->fNoRanges) {
+            long long idx = ctx->nNext++;
+            if (idx >= ctx->nChunks)
+                break;
+            if (ctx->vHave[idx]) {
+                ctx->nDone++;
+                continue;
+            }
+            bool fOk = false;
+            std::string hex;
+            for (int attempt = 0; attempt < FETCH_CHUNK_RETRIES && !fOk && !ctx->fFailed && !ctx->fNoRanges; attempt++)
+                fOk = LTZ_FetchChunk(*ctx, curl, fp, idx, hex);
+            if (!fOk) {
+                if (!ctx->fNoRanges)
+                    ctx->fFailed = true;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(ctx->stateMutex);
+                std::ofstream out(ctx->statefile.c_str(), std::ios::app);
+                out << idx << " " << hex << "\n";
+            }
+            ctx->nDone++;
+        }
+    }
+    if (fp)
+        fclose(fp);
+    if (curl)
+        curl_easy_cleanup(curl);
+}
+
+/** Single-stream download with resume, used when the server's range support
+ *  or the file length cannot be determined. */
+static bool LTZ_FetchSingleStream(const std::string& url, const std::string& partfile)
+{
+    long long nHave = 0;
+    if (boost::filesystem::exists(partfile))
+        nHave = (long long)boost::filesystem::file_size(partfile);
+
+    CURL* curl = curl_easy_init();
+    if (!curl)
+        return false;
+    FILE* fp = fopen(partfile.c_str(), nHave > 0 ? "ab" : "wb");
+    if (!fp) {
+        curl_easy_cleanup(curl);
+        return false;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+    curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
+    curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)nHave);
+
+    CURLcode res = curl_easy_perform(curl);
+
+    if (res == CURLE_RANGE_ERROR && nHave > 0) {
+        // The server cannot resume; start over from the beginning.
+        LogPrintf("Server cannot resume %s; restarting from scratch\n", url);
+        fclose(fp);
+        fp = fopen(partfile.c_str(), "wb");
+        if (!fp) {
+            curl_easy_cleanup(curl);
+            return false;
+        }
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+        curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)0);
+        res = curl_easy_perform(curl);
+    }
+    fclose(fp);
+    curl_easy_cleanup(curl);
+
+    std::ostringstream oss;
+    oss << "CURL Return code: " << curl_easy_strerror(res) << std::endl;
+    LogPrintf("%s", oss.str());
+
+    return res == CURLE_OK;
+}
+
+bool LTZ_FetchParams(std::string url, std::string file)
+{
     std::string msg = "Downloading " + url + "...";
     LogPrintf("%s\n", msg.c_str());
 
-    int pos = file.find("sprout");
-    if (pos == std::string::npos)
-	pos = file.find("sapling");
-    std::string initMsg = "Downloading " + file.substr(pos) + "...";
-
+    std::string initMsg = "Downloading " + LTZ_DisplayName(file) + "...";
     uiInterface.InitMessage(_(initMsg.c_str()));
 
-    curl = curl_easy_init();
-    if (curl)
-    {
-        fp = fopen(file.c_str(), "wb");
-        if (fp)
-        {
-            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-            curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
-            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
-
-            CURLcode res = curl_easy_perform(curl);
-            fclose(fp);
+    // The easy handles below run on several threads, so the global curl state
+    // must be initialized up front (curl_easy_init would otherwise do it
+    // lazily, which is not thread-safe).
+    curl_global_init(CURL_GLOBAL_DEFAULT);
 
-            std::ostringstream oss;
-            oss << "CURL Return code: " << curl_easy_strerror(res) << std::endl;
-            LogPrintf("%s", oss.str());
+    std::string partfile = file + ".part";
+    std::string statefile = file + ".part.state";
 
-            if (res != CURLE_OK)
+    long long nLength = 0;
+    bool fOk = false;
+    bool fTryParallel = LTZ_ProbeLength(url, nLength);
+
+    if (fTryParallel) {
+        // Make sure the partial file exists with the full length, so the
+        // workers can write their chunks at the right offsets.
+        if (boost::filesystem::exists(partfile) &&
+            (long long)boost::filesystem::file_size(partfile) != nLength) {
+            boost::filesystem::remove(partfile);
+            boost::filesystem::remove(statefile);
+        }
+        if (!boost::filesystem::exists(partfile)) {
+            boost::filesystem::remove(statefile);
+            FILE* fp = fopen(partfile.c_str(), "wb");
+            if (!fp)
                 return false;
+            fclose(fp);
+            boost::filesystem::resize_file(partfile, nLength);
+        }
+
+        LTZ_FetchCtx ctx;
+        ctx.url = url;
+        ctx.partfile = partfile;
+        ctx.statefile = statefile;
+        ctx.nLength = nLength;
+        ctx.nChunks = (nLength + FETCH_CHUNK_SIZE - 1) / FETCH_CHUNK_SIZE;
+        LTZ_LoadChunkState(ctx);
+
+        int nThreads = (int)std::min((long long)FETCH_THREADS, ctx.nChunks);
+        boost::thread_group fetchGroup;
+        for (int i = 0; i < nThreads; i++)
+            fetchGroup.create_thread(boost::bind(&LTZ_FetchChunkWorker, &ctx));
+        while (ctx.nDone < ctx.nChunks && !ctx.fFailed && !ctx.fNoRanges) {
+            int nPercent = (int)((ctx.nDone * 100) / ctx.nChunks);
+            std::ostringstream progress;
+            progress << "Downloading " << LTZ_DisplayName(file) << "... (" << nPercent << "%)";
+            uiInterface.InitMessage(_(progress.str().c_str()));
+            boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+        }
+        fetchGroup.join_all();
+
+        if (ctx.fNoRanges) {
+            // The server ignored our range requests, so the chunk grid on
+            // disk cannot be trusted; wipe it and fall back to one stream.
+            LogPrintf("Server does not support ranged downloads for %s\n", url);
+            boost::filesystem::remove(partfile);
+            boost::filesystem::remove(statefile);
+            fTryParallel = false;
+        } else if (ctx.fFailed) {
+            // Completed chunks stay recorded in the state file, so the next
+            // attempt resumes where this one stopped.
+            LogPrintf("Download of %s failed; completed chunks kept for resume\n", url);
+            return false;
+        } else {
+            fOk = true;
         }
     }
-    curl_easy_cleanup(curl);
 
-    return true;
+    if (!fTryParallel) {
+        // A partial file left behind by the parallel path has holes in it,
+        // so it cannot seed a sequential resume.
+        if (boost::filesystem::exists(statefile)) {
+            boost::filesystem::remove(partfile);
+            boost::filesystem::remove(statefile);
+        }
+        fOk = LTZ_FetchSingleStream(url, partfile);
+        if (!fOk)
+            return false;
+    }
+
+    if (fOk) {
+        boost::filesystem::remove(statefile);
+        boost::filesystem::rename(partfile, file);
+    }
+
+    return fOk;
 }
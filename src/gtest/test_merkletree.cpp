@@ -287,6 +287,61 @@ TEST(merkletree, testZeroElements) {
     }
 }
 
+template<typename Tree, typename Hash>
+void test_append_batch()
+{
+    auto leaf = [](int i) {
+        uint256 u;
+        u.begin()[0] = (unsigned char) i;
+        u.begin()[1] = (unsigned char) (i >> 8);
+        return Hash(u);
+    };
+
+    // For every starting fill and batch size within the testing tree's
+    // capacity, appending a batch must leave the tree in exactly the state
+    // that appending the leaves one at a time would.
+    for (int start = 0; start <= 12; start++) {
+        for (int count = 0; start + count <= 16 && count <= 12; count++) {
+            Tree expected;
+            Tree batched;
+            for (int i = 0; i < start; i++) {
+                expected.append(leaf(i));
+                batched.append(leaf(i));
+            }
+
+            std::vector<Hash> leaves;
+            for (int i = 0; i < count; i++) {
+                leaves.push_back(leaf(1000 + i));
+            }
+            for (const Hash& obj : leaves) {
+                expected.append(obj);
+            }
+            batched.append_batch(leaves);
+
+            ASSERT_TRUE(expected == batched);
+            ASSERT_TRUE(expected.root() == batched.root());
+            ASSERT_EQ(expected.size(), batched.size());
+        }
+    }
+
+    // A batch that would overfill the tree throws, like append on a full
+    // tree does.
+    Tree tree;
+    std::vector<Hash> leaves;
+    for (int i = 0; i < 17; i++) {
+        leaves.push_back(leaf(i));
+    }
+    ASSERT_THROW(tree.append_batch(leaves), std::runtime_error);
+}
+
+TEST(merkletree, appendBatch) {
+    test_append_batch<SproutTestingMerkleTree, libzcash::SHA256Compress>();
+}
+
+TEST(merkletree, AppendBatchSapling) {
+    test_append_batch<SaplingTestingMerkleTree, libzcash::PedersenHash>();
+}
+
 TEST(orchardMerkleTree, emptyroot) {
     // This literal is the depth-32 empty tree root with the bytes reversed, to
     // account for the fact that uint256S() loads a big-endian representation of
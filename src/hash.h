@@ -114,6 +114,17 @@ inline uint160 Hash160(const prevector<N, unsigned char>& vch)
     return Hash160(vch.begin(), vch.end());
 }
 
+/** Compute the 160-bit hashes of a batch of messages in one call.
+ *
+ *  The SHA-256 and RIPEMD-160 states are set up once and reset between
+ *  messages, and every intermediate digest stays in one stack buffer, so the
+ *  per-message cost is just the compression calls; pubkey-sized messages fit
+ *  a single compression of each. The backend is whatever single-stream
+ *  implementation SHA256AutoDetect() selected; a multi-lane implementation
+ *  can be slotted in here without touching callers. */
+void Hash160Batch(const std::vector<std::pair<const unsigned char*, size_t>>& vMessages,
+                  std::vector<uint160>& vHashesOut);
+
 /** A writer stream (for serialization) that computes a 256-bit hash. */
 class CHashWriter
 {
@@ -199,7 +210,12 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
     return ss.GetHash();
 }
 
-unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
+unsigned int MurmurHash3(unsigned int nHashSeed, const unsigned char* pDataToHash, size_t nDataLen);
+
+inline unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
+{
+    return MurmurHash3(nHashSeed, vDataToHash.empty() ? nullptr : vDataToHash.data(), vDataToHash.size());
+}
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
@@ -236,5 +252,8 @@ public:
  *      .Finalize()
  */
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
+/** As SipHashUint256, but with a final 32-bit word mixed in; used for keying
+ *  maps by outpoint (txid, n). */
+uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
 #endif // BITCOIN_HASH_H
@@ -173,24 +173,27 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (!valRequest.read(req->ReadBody()))
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Stream the reply into the output buffer instead of serializing
+            // it to one large string; for bulky responses such as verbose
+            // getblock this bounds the transient memory used per request.
+            UniValue reply = JSONRPCReplyObj(result, NullUniValue, jreq.id);
+            req->WriteHeader("Content-Type", "application/json");
+            WriteJSONToBuffer(req->OutputBuffer(), reply);
+            req->WriteReply(HTTP_OK);
 
         // array of requests
-        } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
-        else
+        } else if (valRequest.isArray()) {
+            std::string strReply = JSONRPCExecBatch(valRequest.get_array());
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strReply);
+        } else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
-
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
@@ -12,7 +12,10 @@
 #include "sync.h"
 #include "ui_interface.h"
 
+#include <univalue.h>
+
 #include <deque>
+#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,6 +33,8 @@
 #include <event2/util.h>
 #include <event2/keyvalq_struct.h>
 
+#include <boost/algorithm/string.hpp>
+
 #ifdef EVENT__HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #ifdef _XOPEN_SOURCE_EXTENDED
@@ -37,6 +42,15 @@
 #endif
 #endif
 
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <unordered_map>
+
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
@@ -150,10 +164,29 @@ struct evhttp* eventHTTP = 0;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Separate lane (with its own worker pool) for known-heavyweight RPCs, so
+//! cheap calls such as load balancer health checks are never stuck behind
+//! a gettxoutsetinfo scan.
+static WorkQueue<HTTPClosure>* workQueueSlow = 0;
+//! RPC method names routed to the slow lane; from -rpcslowmethods.
+static std::set<std::string> setSlowMethods;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 std::vector<evhttp_bound_socket *> boundSockets;
+//! Path of the unix domain socket listener, if one is bound
+std::string unixSocketPath;
+//! Maximum requests served per keep-alive connection, 0 for unlimited
+unsigned int maxKeepAliveRequests = 0;
+//! Requests served so far per connection. Only touched on the event loop
+//! thread (request and close callbacks both run there), so no lock is needed.
+std::unordered_map<evhttp_connection*, unsigned int> mapConnRequests;
+
+/** Forget a connection's request count once it closes */
+static void http_connection_close_cb(struct evhttp_connection* conn, void*)
+{
+    mapConnRequests.erase(conn);
+}
 
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
@@ -194,6 +227,29 @@ static bool InitHTTPAllowList()
     return true;
 }
 
+#ifndef WIN32
+/** Check whether a request arrived over the unix domain socket listener.
+ * Such peers have no network address for ClientAllowed to match; access
+ * control is the 0600 mode on the socket file instead. */
+static bool RequestIsUnixSocket(struct evhttp_request* req)
+{
+    evhttp_connection* con = evhttp_request_get_connection(req);
+    if (!con)
+        return false;
+    bufferevent* bev = evhttp_connection_get_bufferevent(con);
+    if (!bev)
+        return false;
+    evutil_socket_t fd = bufferevent_getfd(bev);
+    if (fd == -1)
+        return false;
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr*)&addr, &len) != 0)
+        return false;
+    return addr.ss_family == AF_UNIX;
+}
+#endif
+
 /** HTTP request method as string - use for logging only */
 static std::string RequestMethodString(HTTPRequest::RequestMethod m)
 {
@@ -215,6 +271,33 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
+/** Decide whether a request should go to the slow lane by peeking at the
+ * request body for a known-heavyweight JSON-RPC method name. The peek uses
+ * evbuffer_pullup without draining, so HTTPRequest::ReadBody still sees the
+ * full body later. A misclassification only affects scheduling, never
+ * correctness, so a cheap substring scan is good enough here.
+ */
+static bool RequestIsSlow(struct evhttp_request* req)
+{
+    if (setSlowMethods.empty())
+        return false;
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return false;
+    size_t size = evbuffer_get_length(buf);
+    if (size > 4096) // method names appear near the front of the request
+        size = 4096;
+    const char* data = (const char*)evbuffer_pullup(buf, size);
+    if (!data)
+        return false;
+    std::string body(data, size);
+    for (const std::string& method : setSlowMethods) {
+        if (body.find("\"" + method + "\"") != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request* req, void* arg)
 {
@@ -228,13 +311,32 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
             }
         }
     }
+    // Enforce -rpcmaxkeepaliverequests: once a connection has served its
+    // quota, answer with Connection: close so the client rotates to a fresh
+    // one instead of a single keep-alive connection aging indefinitely.
+    if (maxKeepAliveRequests > 0) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            unsigned int& nRequests = mapConnRequests[conn];
+            if (nRequests == 0)
+                evhttp_connection_set_closecb(conn, http_connection_close_cb, NULL);
+            if (++nRequests >= maxKeepAliveRequests)
+                evhttp_add_header(evhttp_request_get_output_headers(req), "Connection", "close");
+        }
+    }
+
     std::unique_ptr<HTTPRequest> hreq(new HTTPRequest(req));
 
     LogPrint("http", "Received a %s request for %s from %s\n",
              RequestMethodString(hreq->GetRequestMethod()), hreq->GetURI(), hreq->GetPeer().ToString());
 
     // Early address-based allow check
-    if (!ClientAllowed(hreq->GetPeer())) {
+    bool fAllowed = ClientAllowed(hreq->GetPeer());
+#ifndef WIN32
+    if (!fAllowed)
+        fAllowed = RequestIsUnixSocket(req);
+#endif
+    if (!fAllowed) {
         hreq->WriteReply(HTTP_FORBIDDEN);
         return;
     }
@@ -264,13 +366,14 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        bool fSlow = RequestIsSlow(req);
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        assert(workQueue && workQueueSlow);
+        if ((fSlow ? workQueueSlow : workQueue)->Enqueue(item.get()))
         {
             item.release(); /* if true, queue took ownership */
         } else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http %s work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", fSlow ? "slow" : "fast");
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -332,6 +435,45 @@ static bool HTTPBindAddresses(struct evhttp* http)
             LogPrintf("Binding RPC on address %s port %i failed.\n", i->first, i->second);
         }
     }
+
+#ifndef WIN32
+    // Optional unix domain socket listener for co-located clients, which
+    // avoids TCP handshakes and loopback overhead on the RPC hot path.
+    std::string strUnixSocket = GetArg("-rpcunixsocket", "");
+    if (!strUnixSocket.empty()) {
+        struct sockaddr_un addr_un;
+        memset(&addr_un, 0, sizeof(addr_un));
+        if (strUnixSocket.size() >= sizeof(addr_un.sun_path)) {
+            LogPrintf("Binding RPC on unix socket %s failed: path too long\n", strUnixSocket);
+        } else {
+            addr_un.sun_family = AF_UNIX;
+            strcpy(addr_un.sun_path, strUnixSocket.c_str());
+            unlink(strUnixSocket.c_str()); // remove a stale socket from a previous run
+            bool fBound = false;
+            evutil_socket_t fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd != -1) {
+                evutil_make_socket_nonblocking(fd);
+                evutil_make_socket_closeonexec(fd);
+                if (bind(fd, (struct sockaddr*)&addr_un, sizeof(addr_un)) == 0 &&
+                    chmod(strUnixSocket.c_str(), 0600) == 0 &&
+                    listen(fd, 128) == 0) {
+                    evhttp_bound_socket* bind_handle = evhttp_accept_socket_with_handle(http, fd);
+                    if (bind_handle) {
+                        LogPrint("http", "Binding RPC on unix socket %s\n", strUnixSocket);
+                        boundSockets.push_back(bind_handle);
+                        unixSocketPath = strUnixSocket;
+                        fBound = true;
+                    }
+                }
+                if (!fBound)
+                    evutil_closesocket(fd);
+            }
+            if (!fBound)
+                LogPrintf("Binding RPC on unix socket %s failed.\n", strUnixSocket);
+        }
+    }
+#endif
+
     return !boundSockets.empty();
 }
 
@@ -405,6 +547,8 @@ bool InitHTTPServer()
     evhttp_set_max_body_size(http, MAX_SIZE);
     evhttp_set_gencb(http, http_request_cb, NULL);
 
+    maxKeepAliveRequests = GetArg("-rpcmaxkeepaliverequests", 0);
+
     if (!HTTPBindAddresses(http)) {
         LogPrintf("Unable to bind any endpoint for RPC server\n");
         evhttp_free(http);
@@ -417,6 +561,16 @@ bool InitHTTPServer()
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
     workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueueSlow = new WorkQueue<HTTPClosure>(workQueueDepth);
+
+    setSlowMethods.clear();
+    std::vector<std::string> vSlowMethods;
+    boost::split(vSlowMethods, GetArg("-rpcslowmethods", DEFAULT_HTTP_SLOW_METHODS), boost::is_any_of(","));
+    for (const std::string& method : vSlowMethods) {
+        if (!method.empty())
+            setSlowMethods.insert(method);
+    }
+
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -430,14 +584,18 @@ bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
     int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
+    int rpcFastThreads = std::max((long)GetArg("-rpcfastthreads", DEFAULT_HTTP_FAST_THREADS), 1L);
+    LogPrintf("HTTP: starting %d slow and %d fast worker threads\n", rpcThreads, rpcFastThreads);
     std::packaged_task<bool(event_base*, evhttp*)> task(ThreadHTTP);
     threadResult = task.get_future();
     threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
 
-    for (int i = 0; i < rpcThreads; i++) {
+    for (int i = 0; i < rpcFastThreads; i++) {
         g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue);
     }
+    for (int i = 0; i < rpcThreads; i++) {
+        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueueSlow);
+    }
     return true;
 }
 
@@ -454,6 +612,8 @@ void InterruptHTTPServer()
     }
     if (workQueue)
         workQueue->Interrupt();
+    if (workQueueSlow)
+        workQueueSlow->Interrupt();
 }
 
 void StopHTTPServer()
@@ -466,6 +626,11 @@ void StopHTTPServer()
         }
         g_thread_http_workers.clear();
         delete workQueue;
+        workQueue = 0;
+    }
+    if (workQueueSlow) {
+        delete workQueueSlow;
+        workQueueSlow = 0;
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -491,9 +656,109 @@ void StopHTTPServer()
         event_base_free(eventBase);
         eventBase = 0;
     }
+#ifndef WIN32
+    if (!unixSocketPath.empty()) {
+        unlink(unixSocketPath.c_str());
+        unixSocketPath.clear();
+    }
+#endif
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+void GetHTTPWorkQueueDepths(size_t& nFastDepth, size_t& nSlowDepth)
+{
+    nFastDepth = workQueue ? workQueue->Depth() : 0;
+    nSlowDepth = workQueueSlow ? workQueueSlow->Depth() : 0;
+}
+
+/** Flush the scratch string into the evbuffer once it grows past this size,
+ * bounding the transient memory used while serializing a response. */
+static const size_t JSON_WRITE_CHUNK_SIZE = 0x10000;
+
+/** Append a JSON-escaped string; mirrors the escaping UniValue::write uses */
+static void JSONEscapeTo(const std::string& in, std::string& out)
+{
+    for (unsigned int i = 0; i < in.size(); i++) {
+        unsigned char ch = in[i];
+        switch (ch) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b";  break;
+        case '\t': out += "\\t";  break;
+        case '\n': out += "\\n";  break;
+        case '\f': out += "\\f";  break;
+        case '\r': out += "\\r";  break;
+        default:
+            if (ch < 0x20 || ch == 0x7f) {
+                static const char hexmap[] = "0123456789abcdef";
+                out += "\\u00";
+                out += hexmap[ch >> 4];
+                out += hexmap[ch & 15];
+            } else
+                out += ch;
+        }
+    }
+}
+
+static void WriteJSONValue(struct evbuffer* buf, const UniValue& value, std::string& scratch)
+{
+    if (scratch.size() >= JSON_WRITE_CHUNK_SIZE) {
+        evbuffer_add(buf, scratch.data(), scratch.size());
+        scratch.clear();
+    }
+    switch (value.getType()) {
+    case UniValue::VNULL:
+        scratch += "null";
+        break;
+    case UniValue::VSTR:
+        scratch += '"';
+        JSONEscapeTo(value.getValStr(), scratch);
+        scratch += '"';
+        break;
+    case UniValue::VNUM:
+        scratch += value.getValStr();
+        break;
+    case UniValue::VBOOL:
+        scratch += (value.isTrue() ? "true" : "false");
+        break;
+    case UniValue::VARR: {
+        scratch += '[';
+        const std::vector<UniValue>& values = value.getValues();
+        for (unsigned int i = 0; i < values.size(); i++) {
+            if (i > 0)
+                scratch += ',';
+            WriteJSONValue(buf, values[i], scratch);
+        }
+        scratch += ']';
+        break;
+    }
+    case UniValue::VOBJ: {
+        scratch += '{';
+        const std::vector<std::string>& keys = value.getKeys();
+        const std::vector<UniValue>& values = value.getValues();
+        for (unsigned int i = 0; i < keys.size(); i++) {
+            if (i > 0)
+                scratch += ',';
+            scratch += '"';
+            JSONEscapeTo(keys[i], scratch);
+            scratch += "\":";
+            WriteJSONValue(buf, values[i], scratch);
+        }
+        scratch += '}';
+        break;
+    }
+    }
+}
+
+void WriteJSONToBuffer(struct evbuffer* buf, const UniValue& value)
+{
+    std::string scratch;
+    scratch.reserve(JSON_WRITE_CHUNK_SIZE + 1024);
+    WriteJSONValue(buf, value, scratch);
+    scratch += '\n';
+    evbuffer_add(buf, scratch.data(), scratch.size());
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -577,6 +842,12 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+struct evbuffer* HTTPRequest::OutputBuffer()
+{
+    assert(!replySent && req);
+    return evhttp_request_get_output_buffer(req);
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -10,13 +10,18 @@
 #include <functional>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_FAST_THREADS=2;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+//! Heavyweight RPC methods routed to the slow work queue by default
+static const char * const DEFAULT_HTTP_SLOW_METHODS="gettxoutsetinfo,getblock,getblockdeltas,getaddressdeltas,getaddresstxids,getaddressbalance,getaddressutxos,zcbenchmark";
 
+struct evbuffer;
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+class UniValue;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -31,6 +36,8 @@ bool StartHTTPServer();
 void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
+/** Current depths of the fast and slow work queues, for monitoring */
+void GetHTTPWorkQueueDepths(size_t& nFastDepth, size_t& nSlowDepth);
 
 /** Handler for requests to a certain HTTP path */
 typedef std::function<void(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
@@ -47,6 +54,13 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Serialize a JSON value (followed by a newline) directly into an evbuffer,
+ * flushing in bounded chunks, so large RPC responses never exist as one
+ * contiguous string in memory. Produces the same bytes as
+ * UniValue::write() + "\n".
+ */
+void WriteJSONToBuffer(struct evbuffer* buf, const UniValue& value);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -104,6 +118,15 @@ public:
      */
     virtual void WriteHeader(const std::string& hdr, const std::string& value);
 
+    /**
+     * Get the libevent output buffer, so the response body can be streamed
+     * into it piecewise instead of being built as one large string. After
+     * filling it, call WriteReply with an empty body to send the response.
+     * Only the worker thread handling the request may touch the buffer, and
+     * only before WriteReply is called.
+     */
+    struct evbuffer* OutputBuffer();
+
     /**
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
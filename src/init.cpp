@@ -12,6 +12,7 @@
 #include "amount.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
+#include "crypto/sha256.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
 #include "experimental_features.h"
@@ -40,6 +41,7 @@
 #include "utilmoneystr.h"
 #include "validationinterface.h"
 #ifdef ENABLE_WALLET
+#include "wallet/operationjournal.h"
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
 #endif
@@ -62,6 +64,7 @@
 
 #if ENABLE_ZMQ
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqpublishnotifier.h"
 #endif
 
 #include "fetchparams.h"
@@ -76,6 +79,7 @@ extern void ThreadSendAlert();
 TracingHandle* pTracingHandle = nullptr;
 
 bool fFeeEstimatesInitialized = false;
+static bool fDumpMempoolLater = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_DISABLE_SAFEMODE = false;
@@ -163,7 +167,7 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
+CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -194,6 +198,13 @@ void Shutdown()
     RenameThread("koto-shutoff");
     mempool.AddTransactionsUpdated(1);
 
+#ifdef PREVECTOR_PROFILE
+    LogPrintf("prevector profile: destroyed=%u indirect=%u heap_allocations=%u\n",
+              (uint64_t)prevector_profile::destroyed(),
+              (uint64_t)prevector_profile::destroyed_indirect(),
+              (uint64_t)prevector_profile::heap_allocations());
+#endif
+
     StopHTTPRPC();
     StopREST();
     StopRPC();
@@ -209,6 +220,10 @@ void Shutdown()
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
 
+    if (fDumpMempoolLater && GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        DumpMempool();
+    }
+
     if (fFeeEstimatesInitialized)
     {
         fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
@@ -239,6 +254,10 @@ void Shutdown()
         pwalletMain->Flush(true);
 #endif
 
+    // Flush and stop the notification dispatcher while its listeners are
+    // still registered.
+    StopAsyncNotificationDispatcher();
+
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
@@ -334,6 +353,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless '-whitelistforcerelay' is '1', in which case whitelisted peers' transactions will be relayed. RPC transactions are not affected. (default: %u)"), DEFAULT_BLOCKSONLY));
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-blockcompress", strprintf(_("Store newly received blocks compressed with a transaction-structure dictionary codec; existing blocks are unaffected and both record kinds are read transparently (default: %u)"), DEFAULT_BLOCKCOMPRESS));
+    strUsage += HelpMessageOpt("-blockmmap", strprintf(_("Read blocks from disk through memory-mapped block files instead of buffered I/O (default: %u)"), DEFAULT_BLOCKMMAP));
+#endif
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
@@ -343,9 +366,18 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-daemon", _("Run in the background as a daemon and accept commands"));
 #endif
     }
+    strUsage += HelpMessageOpt("-assumevalid=<hex>", _("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script and proof verification (0 to verify all, default: 0)"));
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-paramsdir=<dir>", _("Specify Koto network parameters directory"));
+    strUsage += HelpMessageOpt("-blockfilechunksize=<n>", strprintf(_("Pre-allocate block files in extents of <n> megabytes, between 1 and %u; undo files scale along at a 16:1 ratio. Larger extents reduce allocation calls and fragmentation on rotating disks (default: %u)"), MAX_BLOCKFILE_SIZE >> 20, DEFAULT_BLOCKFILE_CHUNK_SIZE >> 20));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-maxcachebudget=<n>", _("Single memory ceiling in megabytes shared by the database caches and the signature and script verification caches; overrides -dbcache and may scale down -maxsigcachesize and -maxscriptcachesize (default: 0 = size each cache individually)"));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-dbbatchsize=<n>", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
+        strUsage += HelpMessageOpt("-dbfilterbits=<n>", strprintf("Bloom filter bits per key for database reads, 0 to disable the filter (default: %d)", DEFAULT_DB_FILTER_BITS));
+        strUsage += HelpMessageOpt("-dbmaxopenfiles=<n>", strprintf("Maximum number of files each database may keep open (default: %d)", DEFAULT_DB_MAX_OPEN_FILES));
+        strUsage += HelpMessageOpt("-dbwritebuffersize=<n>", "Database write buffer size in bytes (default: a quarter of that database's cache)");
+    }
     strUsage += HelpMessageOpt("-debuglogfile=<file>", strprintf(_("Specify location of debug log file: this can be an absolute path or a path relative to the data directory (default: %s)"), DEFAULT_DEBUGLOGFILE));
     strUsage += HelpMessageOpt("-exportdir=<dir>", _("Specify directory to be used when exporting data"));
     strUsage += HelpMessageOpt("-ibdskiptxverification", strprintf(_("Skip transaction verification during initial block download up to the last checkpoint height. Incompatible with flags that disable checkpoints. (default = %u)"), DEFAULT_IBD_SKIP_TX_VERIFICATION));
@@ -359,16 +391,19 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode disables wallet support and is incompatible with -txindex. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
+    strUsage += HelpMessageOpt("-pruneretention=<n>", strprintf(_("When pruning, always keep the data of the <n> most recent blocks regardless of the -prune size target (default: %u, which is also the minimum)"), MIN_BLOCKS_TO_KEEP));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+    strUsage += HelpMessageOpt("-standby", strprintf(_("Run as a hot standby: flush the chain state to disk after every block, so the node can be promoted to primary by a plain restart with no replay or revalidation (default: %u)"), DEFAULT_STANDBY));
     strUsage += HelpMessageOpt("-txexpirynotify=<cmd>", _("Execute command when transaction expires (%s in cmd is replaced by transaction id)"));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
+    strUsage += HelpMessageOpt("-addrbroadcastinterval=<n>", strprintf(_("Average delay in seconds between address broadcasts to a peer (default: %u)"), AVG_ADDRESS_BROADCAST_INTERVAL));
     strUsage += HelpMessageOpt("-banscore=<n>", strprintf(_("Threshold for disconnecting misbehaving peers (default: %u)"), DEFAULT_BANSCORE_THRESHOLD));
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
@@ -378,12 +413,15 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-dnsseed", _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect/-noconnect)"));
     strUsage += HelpMessageOpt("-externalip=<ip>", _("Specify your own public address"));
     strUsage += HelpMessageOpt("-forcednsseed", strprintf(_("Always query for peer addresses via DNS lookup (default: %u)"), DEFAULT_FORCEDNSSEED));
+    strUsage += HelpMessageOpt("-invbroadcastinterval=<n>", strprintf(_("Average delay in seconds between inventory broadcasts to inbound peers; larger values coalesce more announcements per message (default: %u)"), INVENTORY_BROADCAST_INTERVAL));
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect/-noconnect)"));
     strUsage += HelpMessageOpt("-listenonion", strprintf(_("Automatically create Tor hidden service (default: %d)"), DEFAULT_LISTEN_ONION));
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-mempoolevictionmemoryminutes=<n>", strprintf(_("The number of minutes before allowing rejected transactions to re-enter the mempool. (default: %u)"), DEFAULT_MEMPOOL_EVICTION_MEMORY_MINUTES));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
+    strUsage += HelpMessageOpt("-msghandlerthreads=<n>", strprintf(_("Number of peer message handling threads (default: %d)"), DEFAULT_MSGHANDLER_THREADS));
     strUsage += HelpMessageOpt("-mempooltxcostlimit=<n>",strprintf(_("An upper bound on the maximum size in bytes of all transactions in the mempool. (default: %s)"), DEFAULT_MEMPOOL_TOTAL_COST_LIMIT));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
@@ -404,6 +442,8 @@ std::string HelpMessage(HelpMessageMode mode)
         " " + _("Whitelisted peers cannot be DoS banned and their transactions are always relayed, even if they are already in the mempool, useful e.g. for a gateway"));
     strUsage += HelpMessageOpt("-whitelistrelay", strprintf(_("Accept relayed transactions received from whitelisted inbound peers even when not relaying transactions (default: %d)"), DEFAULT_WHITELISTRELAY));
     strUsage += HelpMessageOpt("-whitelistforcerelay", strprintf(_("Force relay of transactions from whitelisted inbound peers even they violate local relay policy (default: %d)"), DEFAULT_WHITELISTFORCERELAY));
+    strUsage += HelpMessageOpt("-trustedmempoolsync", strprintf(_("Accept transactions from whitelisted peers without verifying their signatures and proofs. Enable only on co-located node clusters where every whitelisted peer fully validates on behalf of this node (default: %u)"), DEFAULT_TRUSTEDMEMPOOLSYNC));
+    strUsage += HelpMessageOpt("-whitelistnochecksum", strprintf(_("Skip P2P message checksums in both directions for whitelisted peers. Every whitelisted peer must run with the same setting or the connection will fail; only use on trusted local links (default: %d)"), DEFAULT_WHITELISTNOCHECKSUM));
     strUsage += HelpMessageOpt("-maxuploadtarget=<n>", strprintf(_("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)"), DEFAULT_MAX_UPLOAD_TARGET));
 
 #ifdef ENABLE_WALLET
@@ -416,6 +456,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqhwm=<n>", strprintf(_("High water mark for ZeroMQ publishing: bound for the internal publish queue and the socket send buffer (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqdropoldest=<0/1>", _("When the ZeroMQ publish queue is full, drop the oldest queued message instead of the new one (default: 1)"));
 #endif
 
     strUsage += HelpMessageGroup(_("Monitoring options:"));
@@ -434,6 +476,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
         strUsage += HelpMessageOpt("-testsafemode", strprintf("Force safe mode (default: %u)", DEFAULT_TESTSAFEMODE));
         strUsage += HelpMessageOpt("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages");
+        strUsage += HelpMessageOpt("-parspin=<n>", strprintf("Iterations an idle validation worker polls for new work before sleeping; reduces wakeup latency for short script checks at high -par counts at the cost of idle CPU (default: %u)", DEFAULT_SCRIPTCHECK_SPIN));
         strUsage += HelpMessageOpt("-fuzzmessagestest=<n>", "Randomly fuzz 1 of every <n> network messages");
         strUsage += HelpMessageOpt("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT));
         strUsage += HelpMessageOpt("-nuparams=hexBranchId:activationHeight", "Use given activation height for specified network upgrade (regtest-only)");
@@ -450,13 +493,17 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-experimentalfeatures", _("Enable use of experimental features"));
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
+    strUsage += HelpMessageOpt("-logjson", strprintf(_("Write log events as newline-delimited JSON instead of formatted text (default: %u)"), 0));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
+        strUsage += HelpMessageOpt("-lockstats", "Collect per-lock contention statistics from startup; see the getlockstats RPC (default: 0)");
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxscriptcachesize=<n>", strprintf("Limit size of transaction script verification cache to <n> MiB (default: %u)", DEFAULT_MAX_SCRIPT_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
+        strUsage += HelpMessageOpt("-schedulerthreads=<n>", "Number of threads servicing the background task scheduler (default: 1)");
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
         CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)));
@@ -508,13 +555,20 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 8432, 18432));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-rpcunixsocket=<path>", _("Additionally listen for JSON-RPC connections on <path> (unix domain socket, mode 0600), avoiding TCP overhead for co-located clients"));
+#endif
     if (showDebug) {
+        strUsage += HelpMessageOpt("-rpcfastthreads=<n>", strprintf("Set the number of threads reserved for RPC calls not listed in -rpcslowmethods (default: %d)", DEFAULT_HTTP_FAST_THREADS));
+        strUsage += HelpMessageOpt("-rpcslowmethods=<methods>", strprintf("Comma-separated list of RPC methods serviced by a separate worker pool, so that they cannot delay other calls (default: %s)", DEFAULT_HTTP_SLOW_METHODS));
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
+        strUsage += HelpMessageOpt("-rpcmaxkeepaliverequests=<n>", "Close a keep-alive RPC connection after it has served <n> requests, 0 for unlimited (default: 0)");
+        strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", "Execute up to <n> entries of a JSON-RPC batch request concurrently, 1 for sequential (default: 4)");
+        strUsage += HelpMessageOpt("-rpcslowms=<n>", strprintf("Log RPC calls that take longer than <n> milliseconds, 0 to disable (default: %d)", DEFAULT_RPC_SLOW_MS));
     }
 
-    // Disabled until we can lock notes and also tune performance of the prover which by default uses multiple threads
-    //strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service Async RPC calls (default: %d)"), 1));
+    strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service asynchronous RPC operations such as z_sendmany; the operations lock their selected inputs, so concurrent operations spend disjoint coins and notes (default: %d)"), 1));
 
     if (mode == HMM_BITCOIND) {
         strUsage += HelpMessageGroup(_("Metrics Options (only if -daemon and -printtoconsole are not set):"));
@@ -677,6 +731,12 @@ void ThreadImport(std::vector<fs::path> vImportFiles, const CChainParams& chainp
     if (GetBoolArg("-stopafterblockimport", DEFAULT_STOPAFTERBLOCKIMPORT)) {
         LogPrintf("Stopping after block import\n");
         StartShutdown();
+        return;
+    }
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadMempool(chainparams);
+        fDumpMempoolLater = !ShutdownRequested();
     }
 }
 
@@ -893,12 +953,27 @@ void InitLogging()
     pTracingHandle = tracing_init(
         pathDebugCStr, pathDebugLen,
         initialFilter.c_str(),
-        fLogTimestamps);
+        fLogTimestamps,
+        GetBoolArg("-logjson", false));
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("Koto version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
 }
 
+#ifdef ENABLE_WALLET
+//! How often the scheduler checks whether the keypool needs a refill.
+static const int64_t KEYPOOL_TOPUP_INTERVAL = 5;
+
+static void TopUpKeyPool()
+{
+    try {
+        pwalletMain->TopUpKeyPool();
+    } catch (const std::exception& e) {
+        LogPrintf("Background keypool top-up failed: %s\n", e.what());
+    }
+}
+#endif
+
 [[noreturn]] static void new_handler_terminate()
 {
     // Rather than throwing std::bad-alloc if allocation fails, terminate
@@ -1022,6 +1097,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 3: parameter-to-internal-flags
 
+    fLockProfiling = GetBoolArg("-lockstats", false);
+
     fDebug = !mapMultiArgs["-debug"].empty();
     // Special-case: if -debug=0/-nodebug is set, turn off debugging messages
     const std::vector<std::string>& categories = mapMultiArgs["-debug"];
@@ -1063,6 +1140,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fIBDSkipTxVerification = GetBoolArg("-ibdskiptxverification", DEFAULT_IBD_SKIP_TX_VERIFICATION);
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fStandbyMode = GetBoolArg("-standby", DEFAULT_STANDBY);
+    if (fStandbyMode)
+        LogPrintf("Running in standby mode: chain state is flushed after every block.\n");
+
+    hashAssumeValid = uint256S(GetArg("-assumevalid", ""));
+    if (!hashAssumeValid.IsNull())
+        LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
 
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
@@ -1087,6 +1171,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
         LogPrintf("Prune configured to target %uMiB on disk for block and undo files.\n", nPruneTarget / 1024 / 1024);
         fPruneMode = true;
+
+        int64_t nRetention = GetArg("-pruneretention", MIN_BLOCKS_TO_KEEP);
+        if (nRetention < (int64_t)MIN_BLOCKS_TO_KEEP) {
+            return InitError(strprintf(_("-pruneretention cannot be below the minimum of %u blocks."), MIN_BLOCKS_TO_KEEP));
+        }
+        nPruneBlocksToKeep = (unsigned int)nRetention;
+        if (nPruneBlocksToKeep != MIN_BLOCKS_TO_KEEP)
+            LogPrintf("Prune retention window configured to %u blocks.\n", nPruneBlocksToKeep);
     }
 
     RegisterAllCoreRPCCommands(tableRPC);
@@ -1273,18 +1365,23 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Default data directory %s\n", GetDefaultDataDir().string());
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile(GetArg("-conf", BITCOIN_CONF_FILENAME)).string());
+    LogPrintf("Using the '%s' SHA256 implementation\n", SHA256AutoDetect());
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
+        InitValidationPool(nScriptCheckThreads - 1);
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler thread(s); with more than one, a
+    // slow periodic task no longer delays the others past their due times.
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    int nSchedulerThreads = std::max<int64_t>(1, GetArg("-schedulerthreads", 1));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
     // Count uptime
     MarkStartTime();
@@ -1426,6 +1523,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // see Step 2: parameter interactions for more information about these
     fListen = GetBoolArg("-listen", DEFAULT_LISTEN);
+    fWhitelistNoChecksum = GetBoolArg("-whitelistnochecksum", DEFAULT_WHITELISTNOCHECKSUM);
     fDiscover = GetBoolArg("-discover", true);
     fNameLookup = GetBoolArg("-dns", DEFAULT_NAME_LOOKUP);
 
@@ -1476,6 +1574,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         RegisterValidationInterface(pzmqNotificationInterface);
     }
 #endif
+
+    // Deliver fire-and-forget validation notifications off the hot path.
+    StartAsyncNotificationDispatcher();
     if (mapArgs.count("-maxuploadtarget")) {
         CNode::SetMaxOutboundTarget(
             chainparams.GetConsensus().nPostBlossomPowTargetSpacing,
@@ -1489,8 +1590,37 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     fs::create_directories(GetDataDir() / "blocks");
 
+    // block file pre-allocation extent
+    int64_t nChunkMiB = GetArg("-blockfilechunksize", DEFAULT_BLOCKFILE_CHUNK_SIZE >> 20);
+    nChunkMiB = std::max<int64_t>(1, std::min<int64_t>(nChunkMiB, MAX_BLOCKFILE_SIZE >> 20));
+    nBlockfileChunkSize = nChunkMiB << 20;
+    nUndofileChunkSize = std::max<unsigned int>(nBlockfileChunkSize >> 4, 1 << 20);
+
     // cache size calculations
     int64_t nTotalCache = (GetArg("-dbcache", nDefaultDbCache) << 20);
+    int64_t nCacheBudget = GetArg("-maxcachebudget", 0) << 20;
+    if (nCacheBudget > 0) {
+        // One operator-set ceiling shared by the database caches and the two
+        // verification caches. The verification caches keep their configured
+        // sizes up to a quarter of the budget (scaled down proportionally
+        // beyond that); whatever they don't take funds the database caches.
+        int64_t nSigCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) << 20;
+        int64_t nScriptCacheSize = GetArg("-maxscriptcachesize", DEFAULT_MAX_SCRIPT_CACHE_SIZE) << 20;
+        if (nSigCacheSize + nScriptCacheSize > nCacheBudget / 4) {
+            int64_t nVerifyCaches = nCacheBudget / 4;
+            nSigCacheSize = nVerifyCaches * nSigCacheSize / (nSigCacheSize + nScriptCacheSize);
+            nScriptCacheSize = nVerifyCaches - nSigCacheSize;
+            mapArgs["-maxsigcachesize"] = itostr(nSigCacheSize >> 20);
+            mapArgs["-maxscriptcachesize"] = itostr(nScriptCacheSize >> 20);
+            LogPrintf("%s: parameter interaction: -maxcachebudget -> -maxsigcachesize=%d -maxscriptcachesize=%d\n",
+                      __func__, nSigCacheSize >> 20, nScriptCacheSize >> 20);
+        }
+        nTotalCache = nCacheBudget - nSigCacheSize - nScriptCacheSize;
+        // While the verification caches are idle during IBD, lend their
+        // share to the in-memory coins cache; FlushStateToDisk returns it
+        // once IBD ends.
+        nCoinCacheIBDBonus = nSigCacheSize + nScriptCacheSize;
+    }
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greated than nMaxDbcache
     int64_t nBlockTreeDBCache = nTotalCache / 8;
@@ -1534,6 +1664,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
+
+                // If an incremental chainstate flush was interrupted partway
+                // through, the database is inconsistent and must be rebuilt.
+                if (!pcoinsdbview->GetHeadBlocks().empty()) {
+                    strLoadError = _("The coin database was left mid-flush by an unclean shutdown and must be rebuilt using -reindex-chainstate");
+                    break;
+                }
+
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
@@ -1560,10 +1698,19 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
-                // Check for changed -txindex state
+                // Check for changed -txindex state. Enabling the index no
+                // longer needs a reindex: the background indexer rebuilds it
+                // from the block files, starting from the genesis marker.
                 if (fTxIndex != GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -txindex");
-                    break;
+                    if (GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+                        fTxIndex = true;
+                        pblocktree->WriteFlag("txindex", fTxIndex);
+                        pblocktree->WriteTxIndexBestBlock(chainparams.GetConsensus().hashGenesisBlock);
+                        LogPrintf("%s: -txindex enabled; the index will be built in the background\n", __func__);
+                    } else {
+                        strLoadError = _("You need to rebuild the database using -reindex-chainstate to disable -txindex");
+                        break;
+                    }
                 }
 
                 // Check for changed -insightexplorer state
@@ -1658,6 +1805,19 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
+    // Warm the anchor caches: nearly all shielded transactions validated
+    // right after startup reference the current best anchors, so pull those
+    // trees into pcoinsTip before the node starts accepting transactions.
+    {
+        LOCK(cs_main);
+        SproutMerkleTree sproutTree;
+        pcoinsTip->GetSproutAnchorAt(pcoinsTip->GetBestAnchor(SPROUT), sproutTree);
+        SaplingMerkleTree saplingTree;
+        pcoinsTip->GetSaplingAnchorAt(pcoinsTip->GetBestAnchor(SAPLING), saplingTree);
+        OrchardMerkleTree orchardTree;
+        pcoinsTip->GetOrchardAnchorAt(pcoinsTip->GetBestAnchor(ORCHARD), orchardTree);
+    }
+
     fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -1751,8 +1911,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // if pruning, unset the service bit and perform the initial blockstore prune
     // after any wallet rescanning has taken place.
     if (fPruneMode) {
-        LogPrintf("Unsetting NODE_NETWORK on prune mode\n");
+        LogPrintf("Replacing NODE_NETWORK with NODE_NETWORK_LIMITED on prune mode\n");
         nLocalServices &= ~NODE_NETWORK;
+        nLocalServices |= NODE_NETWORK_LIMITED;
         if (!fReindex) {
             uiInterface.InitMessage(_("Pruning blockstore..."));
             PruneAndFlush();
@@ -1775,6 +1936,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles, chainparams));
 
+    if (fTxIndex || fAddressIndex || fSpentIndex || fTimestampIndex)
+        threadGroup.create_thread(boost::bind(&ThreadIndexWriter, boost::cref(chainparams)));
+
+    // pre-reads blocks that peers are about to request
+    threadGroup.create_thread(boost::bind(&ThreadBlockReadAhead, boost::cref(chainparams)));
+
     // Wait for genesis block to be processed
     bool fHaveGenesis = false;
     while (!fHaveGenesis && !fRequestShutdown) {
@@ -1835,8 +2002,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         // Add wallet transactions that aren't already in a block to mapTransactions
         pwalletMain->ReacceptWalletTransactions();
 
+        // Resubmit any fully proven async-operation transactions that were
+        // journaled but not committed before the last shutdown
+        ResumeJournaledOperations();
+
         // Run a thread to flush wallet periodically
         threadGroup.create_thread(boost::bind(&ThreadFlushWalletDB, boost::ref(pwalletMain->strWalletFile)));
+
+        // Refill the keypool from the scheduler thread, so a large drain is
+        // topped back up in the background instead of stalling the next
+        // getnewaddress caller. The check is a no-op while the pool is full.
+        scheduler.scheduleEveryFixedRate("keypool-topup", &TopUpKeyPool, KEYPOOL_TOPUP_INTERVAL);
     }
 #endif
 
@@ -15,6 +15,8 @@
 #include <assert.h>
 #include <string.h>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
 #include <variant>
 
 namespace
@@ -451,8 +453,34 @@ static bool AddUnknownReceiver(void* ua, uint32_t typecode, const unsigned char*
     return reinterpret_cast<libzcash::UnifiedAddress*>(ua)->AddReceiver(receiver);
 }
 
+namespace
+{
+/**
+ * Cache of successfully decoded payment addresses. Payout batches decode the
+ * same addresses over and over, and each miss pays for Bech32 checksum and
+ * base58 work; a hit is a hash lookup and a variant copy. Keys include the
+ * network ID because tests switch networks within one process. Only valid
+ * addresses are cached, so the cache cannot be grown by garbage input beyond
+ * the wholesale clear when it reaches its bound.
+ */
+const size_t MAX_PAYMENT_ADDRESS_CACHE_SIZE = 10000;
+std::mutex g_paymentAddressCacheMutex;
+std::unordered_map<std::string, libzcash::PaymentAddress> g_paymentAddressCache;
+} // namespace
+
 libzcash::PaymentAddress KeyIO::DecodePaymentAddress(const std::string& str)
 {
+    const std::string cacheKey = keyConstants.NetworkIDString() + ":" + str;
+    {
+        std::lock_guard<std::mutex> lock(g_paymentAddressCacheMutex);
+        auto it = g_paymentAddressCache.find(cacheKey);
+        if (it != g_paymentAddressCache.end()) {
+            return it->second;
+        }
+    }
+
+    libzcash::PaymentAddress result = libzcash::InvalidEncoding();
+
     // Try parsing as a Unified Address.
     libzcash::UnifiedAddress ua;
     if (zcash_address_parse_unified(
@@ -464,18 +492,27 @@ libzcash::PaymentAddress KeyIO::DecodePaymentAddress(const std::string& str)
         AddP2PKHReceiver,
         AddUnknownReceiver)
     ) {
-        return ua;
+        result = ua;
+    } else {
+        // Fall back on trying Sprout or Sapling.
+        result = DecodeAny<libzcash::PaymentAddress,
+            libzcash::SproutPaymentAddress,
+            libzcash::SaplingPaymentAddress>(
+                keyConstants,
+                str,
+                std::make_pair(KeyConstants::ZCPAYMENT_ADDRESS, libzcash::SerializedSproutPaymentAddressSize),
+                std::make_pair(KeyConstants::SAPLING_PAYMENT_ADDRESS, ConvertedSaplingPaymentAddressSize)
+            );
     }
 
-    // Fall back on trying Sprout or Sapling.
-    return DecodeAny<libzcash::PaymentAddress,
-        libzcash::SproutPaymentAddress,
-        libzcash::SaplingPaymentAddress>(
-            keyConstants,
-            str,
-            std::make_pair(KeyConstants::ZCPAYMENT_ADDRESS, libzcash::SerializedSproutPaymentAddressSize),
-            std::make_pair(KeyConstants::SAPLING_PAYMENT_ADDRESS, ConvertedSaplingPaymentAddressSize)
-        );
+    if (IsValidPaymentAddress(result)) {
+        std::lock_guard<std::mutex> lock(g_paymentAddressCacheMutex);
+        if (g_paymentAddressCache.size() >= MAX_PAYMENT_ADDRESS_CACHE_SIZE) {
+            g_paymentAddressCache.clear();
+        }
+        g_paymentAddressCache.emplace(cacheKey, result);
+    }
+    return result;
 }
 
 bool KeyIO::IsValidPaymentAddressString(const std::string& str) {
@@ -9,6 +9,29 @@
 #include "pubkey.h"
 #include "util.h"
 
+#include <atomic>
+
+//! Bumped whenever any keystore's transparent key or script material
+//! changes; lets cached IsMine classifications be invalidated in O(1).
+static std::atomic<uint64_t> nKeystoreGeneration{1};
+
+//! Source of unique per-keystore-instance cache ids (0 means uncacheable).
+static std::atomic<uint64_t> nLastIsMineCacheId{0};
+
+uint64_t GetKeystoreGeneration()
+{
+    return nKeystoreGeneration.load();
+}
+
+void BumpKeystoreGeneration()
+{
+    nKeystoreGeneration++;
+}
+
+uint64_t NextIsMineCacheId()
+{
+    return ++nLastIsMineCacheId;
+}
 
 bool CKeyStore::AddKey(const CKey &key) {
     return AddKeyPubKey(key, key.GetPubKey());
@@ -63,6 +86,7 @@ bool CBasicKeyStore::AddKeyPubKey(const CKey& key, const CPubKey &pubkey)
 {
     LOCK(cs_KeyStore);
     mapKeys[pubkey.GetID()] = key;
+    BumpKeystoreGeneration();
     return true;
 }
 
@@ -73,6 +97,7 @@ bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
 
     LOCK(cs_KeyStore);
     mapScripts[CScriptID(redeemScript)] = redeemScript;
+    BumpKeystoreGeneration();
     return true;
 }
 
@@ -117,6 +142,7 @@ bool CBasicKeyStore::AddWatchOnly(const CScript &dest)
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey))
         mapWatchKeys[pubKey.GetID()] = pubKey;
+    BumpKeystoreGeneration();
     return true;
 }
 
@@ -127,6 +153,7 @@ bool CBasicKeyStore::RemoveWatchOnly(const CScript &dest)
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey))
         mapWatchKeys.erase(pubKey.GetID());
+    BumpKeystoreGeneration();
     return true;
 }
 
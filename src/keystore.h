@@ -16,6 +16,14 @@
 
 #include <boost/signals2/signal.hpp>
 
+//! Monotonic counter covering every keystore's transparent key and script
+//! material; cached IsMine classifications are versioned by it.
+uint64_t GetKeystoreGeneration();
+//! Invalidate all cached IsMine classifications.
+void BumpKeystoreGeneration();
+//! Allocate a unique cache id for a new keystore instance.
+uint64_t NextIsMineCacheId();
+
 /** A virtual base class for key stores */
 class CKeyStore
 {
@@ -25,6 +33,10 @@ protected:
 public:
     virtual ~CKeyStore() {}
 
+    //! Identifier used to key cached IsMine classifications for this
+    //! keystore, or 0 if results for this keystore may not be cached.
+    virtual uint64_t GetIsMineCacheId() const { return 0; }
+
     //! Set the HD seed for this keystore
     virtual bool SetHDSeed(const HDSeed& seed) =0;
     virtual bool HaveHDSeed() const =0;
@@ -118,6 +130,11 @@ typedef std::map<libzcash::SaplingPaymentAddress, libzcash::SaplingIncomingViewi
 /** Basic key store, that keeps keys in an address->secret map */
 class CBasicKeyStore : public CKeyStore
 {
+private:
+    //! Never reused across instances, so cached IsMine classifications can
+    //! never outlive the keystore they were computed against.
+    const uint64_t nIsMineCacheId;
+
 protected:
     HDSeed hdSeed;
     KeyMap mapKeys;
@@ -133,6 +150,10 @@ protected:
     SaplingIncomingViewingKeyMap mapSaplingIncomingViewingKeys;
 
 public:
+    CBasicKeyStore() : nIsMineCacheId(NextIsMineCacheId()) {}
+
+    uint64_t GetIsMineCacheId() const { return nIsMineCacheId; }
+
     bool SetHDSeed(const HDSeed& seed);
     bool HaveHDSeed() const;
     bool GetHDSeed(HDSeed& seedOut) const;
@@ -39,13 +39,19 @@ bool LogAcceptCategory(const char* category);
 /** Print to debug.log with level DEBUG. */
 #define LogPrint(category, ...) LogPrintInner("debug", category, __VA_ARGS__)
 
-#define LogPrintInner(level, category, ...) do {           \
-    std::string T_MSG = tfm::format(__VA_ARGS__);          \
-    if (!T_MSG.empty() && T_MSG[T_MSG.size()-1] == '\n') { \
-        T_MSG.erase(T_MSG.size()-1);                       \
-    }                                                      \
-    TracingLog(level, category, T_MSG.c_str());            \
-} while(0)
+/**
+ * The format arguments are only evaluated when the event passes the current
+ * log filter, so a LogPrint for a disabled category costs an atomic load
+ * rather than a tinyformat run; beware of format arguments with side effects.
+ */
+#define LogPrintInner(level, category, ...)                    \
+    TracingLogLazy(level, category, ([&] {                     \
+        std::string T_MSG = tfm::format(__VA_ARGS__);          \
+        if (!T_MSG.empty() && T_MSG[T_MSG.size()-1] == '\n') { \
+            T_MSG.erase(T_MSG.size()-1);                       \
+        }                                                      \
+        return T_MSG;                                          \
+    }()))
 
 #define LogError(category, ...) ([&]() {          \
     std::string T_MSG = tfm::format(__VA_ARGS__); \
@@ -10,6 +10,7 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockencodings.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -17,6 +18,9 @@
 #include "consensus/funding.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
+#include "compressor.h"
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
 #include "deprecation.h"
 #include "experimental_features.h"
 #include "init.h"
@@ -27,6 +31,7 @@
 #include "policy/policy.h"
 #include "pow.h"
 #include "reverse_iterator.h"
+#include "trace.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "undo.h"
@@ -39,9 +44,20 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <sstream>
 #include <variant>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/math/distributions/poisson.hpp>
 #include <boost/thread.hpp>
@@ -64,6 +80,8 @@ using namespace std;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+/** Backing storage for every node in mapBlockIndex; see CBlockIndexArena. */
+static CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
 static std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
@@ -74,6 +92,7 @@ std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = false;
 bool fAddressIndex = false;     // insightexplorer || lightwalletd
+bool fAddressBalanceIndex = false; // running totals present since genesis
 bool fSpentIndex = false;       // insightexplorer
 bool fTimestampIndex = false;   // insightexplorer
 bool fHavePruned = false;
@@ -82,9 +101,15 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 bool fIBDSkipTxVerification = DEFAULT_IBD_SKIP_TX_VERIFICATION;
+bool fStandbyMode = DEFAULT_STANDBY;
+uint256 hashAssumeValid;
 bool fCoinbaseEnforcedShieldingEnabled = true;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nCoinCacheIBDBonus = 0;
+unsigned int nBlockfileChunkSize = DEFAULT_BLOCKFILE_CHUNK_SIZE;
+unsigned int nUndofileChunkSize = DEFAULT_UNDOFILE_CHUNK_SIZE;
 uint64_t nPruneTarget = 0;
+unsigned int nPruneBlocksToKeep = MIN_BLOCKS_TO_KEEP;
 bool fAlerts = DEFAULT_ALERTS;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 
@@ -100,10 +125,37 @@ struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
 };
-map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(cs_main);;
-map<uint256, set<uint256> > mapOrphanTransactionsByPrev GUARDED_BY(cs_main);;
+/* Salted hashing keeps peers from grinding txids into one bucket. */
+typedef boost::unordered_map<uint256, COrphanTx, SaltedTxidHasher> OrphanMap;
+/* Dependents are indexed by the exact outpoint they are waiting on, and are
+ * stored as pointers into OrphanMap — stable, since boost's unordered_map is
+ * node based — so resolving a parent touches no further hash lookups. */
+typedef boost::unordered_map<COutPoint, set<const COrphanTx*>, SaltedOutpointHasher> OrphanMapByPrev;
+OrphanMap mapOrphanTransactions GUARDED_BY(cs_main);
+OrphanMapByPrev mapOrphanTransactionsByPrev GUARDED_BY(cs_main);
 void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Headers whose parent was unknown on arrival. They are kept briefly so a
+ *  late-arriving parent connects its descendants without another round trip;
+ *  both the entry count and age are bounded, so header floods cannot grow
+ *  node memory. */
+struct COrphanHeader {
+    CBlockHeader header;
+    NodeId fromPeer;
+    int64_t nTimeReceived;
+};
+static const unsigned int MAX_ORPHAN_HEADERS = 1000;
+static const int64_t ORPHAN_HEADER_EXPIRE_TIME = 10 * 60;
+static std::map<uint256, COrphanHeader> mapOrphanHeaders GUARDED_BY(cs_main);
+/* Parent hash -> orphan hash, so a freshly connected block finds the headers
+ * waiting on it with one lookup instead of a scan. */
+static std::multimap<uint256, uint256> mapOrphanHeadersByPrev GUARDED_BY(cs_main);
+/* Insertion-order queue backing expiry; receive times are monotone, so the
+ * front is always the oldest entry. Entries already erased through the maps
+ * are skipped lazily. */
+static std::deque<std::pair<int64_t, uint256>> queueOrphanHeaderAge GUARDED_BY(cs_main);
+void EraseOrphanHeadersFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /**
  * Returns true if there are nRequired or more blocks of minVersion or above
  * in the last Consensus::Params::nMajorityWindow blocks, starting at pstart and going backwards.
@@ -145,6 +197,54 @@ namespace {
         }
     }
 
+    /** Bound on the anchor check cache below; sized to comfortably cover a
+     *  mempool's worth of shielded transactions. */
+    const size_t MAX_ANCHOR_CHECK_CACHE = 10000;
+
+    CCriticalSection cs_cachedAnchorChecks;
+    /** txid -> anchor epoch at which every anchor lookup of the transaction
+     *  succeeded against the chain's root sets. */
+    std::map<uint256, uint64_t> mapCachedAnchorChecks GUARDED_BY(cs_cachedAnchorChecks);
+
+    /** HaveShieldedRequirements with memoized anchor resolution.
+     *
+     *  Resolving each JoinSplit/Spend anchor through the coins view costs a
+     *  tree deserialization per anchor, and the same transaction is checked
+     *  repeatedly: twice within one AcceptToMemoryPool (directly and via
+     *  CheckTxInputs), and again for every mempool revalidation and when it
+     *  finally appears in a block. Anchor pushes only ever add roots, so a
+     *  successful resolution stays valid until an anchor is popped;
+     *  GetShieldedAnchorEpoch() tracks pops and stale entries are simply
+     *  ignored. The nullifier double-spend checks change with every block
+     *  and always run.
+     *
+     *  fMayCache must only be set when view resolves anchors against the
+     *  chain's root sets alone: a ConnectBlock view also contains the
+     *  in-block intermediate anchors, which never become cacheable until
+     *  the block commits, so block validation passes false and still
+     *  benefits from entries recorded by AcceptToMemoryPool. */
+    std::optional<UnsatisfiedShieldedReq> HaveShieldedRequirementsCached(
+        const CCoinsViewCache& view, const CTransaction& tx, bool fMayCache)
+    {
+        const uint256 txid = tx.GetHash();
+        const uint64_t nEpoch = GetShieldedAnchorEpoch();
+        bool fAnchorsKnown = false;
+        {
+            LOCK(cs_cachedAnchorChecks);
+            std::map<uint256, uint64_t>::const_iterator it = mapCachedAnchorChecks.find(txid);
+            fAnchorsKnown = (it != mapCachedAnchorChecks.end() && it->second == nEpoch);
+        }
+        auto unmetShieldedReq = view.HaveShieldedRequirements(tx, !fAnchorsKnown);
+        if (!unmetShieldedReq && !fAnchorsKnown && fMayCache &&
+            !(tx.vJoinSplit.empty() && tx.vShieldedSpend.empty() && !tx.GetOrchardBundle().GetAnchor())) {
+            LOCK(cs_cachedAnchorChecks);
+            if (mapCachedAnchorChecks.size() >= MAX_ANCHOR_CHECK_CACHE)
+                mapCachedAnchorChecks.clear();
+            mapCachedAnchorChecks[txid] = nEpoch;
+        }
+        return unmetShieldedReq;
+    }
+
     /** Abort with a message */
     bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
     {
@@ -220,8 +320,15 @@ namespace {
      * Sources of received blocks, saved to be able to send them reject
      * messages or ban them when processing happens afterwards. Protected by
      * cs_main.
+     *
+     * Kept in a fixed-memory cuckoo cache rather than a std::map: entries for
+     * blocks that never get validated (stale side-chain blocks, headers-only
+     * forks) used to accumulate for the lifetime of the node, and forgetting
+     * a source only costs us a reject message or a missed misbehaving mark.
+     * Sized well beyond the number of blocks that can be awaiting validation
+     * at once.
      */
-    map<uint256, NodeId> mapBlockSource;
+    cuckoocache<uint256, NodeId, BlockHasher> mapBlockSource(16384);
 
     /**
      * Filter for transactions that were recently rejected by
@@ -274,7 +381,7 @@ namespace {
     set<int> setDirtyFileInfo;
 
     /** Relay map, protected by cs_main. */
-    typedef std::map<uint256, std::shared_ptr<const CTransaction>> MapRelay;
+    typedef std::map<uint256, CTransactionRef> MapRelay;
     MapRelay mapRelay;
     /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_main). */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
@@ -322,9 +429,19 @@ struct CNodeState {
     bool fSyncStarted;
     //! Since when we're stalling block download progress (in microseconds), or 0.
     int64_t nStallingSince;
+    //! Moving average of how long this peer takes to deliver a requested block
+    //! (request to receipt, in microseconds), or 0 until the first delivery.
+    int64_t nBlockDeliveryEwmaUsec;
     list<QueuedBlock> vBlocksInFlight;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Whether this peer will send us cmpctblocks if we request them (BIP 152).
+    bool fProvidesCmpctBlocks;
+    //! Whether this peer wants new blocks announced to it as cmpctblock
+    //! messages (BIP 152 high-bandwidth mode).
+    bool fPreferCmpctBlocks;
+    //! The compact block we are currently reconstructing from this peer, if any.
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
 
@@ -337,8 +454,11 @@ struct CNodeState {
         pindexLastCommonBlock = NULL;
         fSyncStarted = false;
         nStallingSince = 0;
+        nBlockDeliveryEwmaUsec = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        fProvidesCmpctBlocks = false;
+        fPreferCmpctBlocks = false;
         fPreferredDownload = false;
     }
 };
@@ -397,6 +517,7 @@ void FinalizeNode(NodeId nodeid) {
     for (const QueuedBlock& entry : state->vBlocksInFlight)
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
+    EraseOrphanHeadersFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
 
     mapNodeState.erase(nodeid);
@@ -408,6 +529,12 @@ bool MarkBlockAsReceived(const uint256& hash) {
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState *state = State(itInFlight->second.first);
+        // Score the peer's delivery speed. A re-requested block counts its
+        // full elapsed time, which correctly penalizes peers that never
+        // delivered the first request.
+        int64_t nDelivered = GetTimeMicros() - itInFlight->second.second->nTime;
+        state->nBlockDeliveryEwmaUsec = state->nBlockDeliveryEwmaUsec == 0 ?
+            nDelivered : (7 * state->nBlockDeliveryEwmaUsec + nDelivered) / 8;
         nQueuedValidatedHeaders -= itInFlight->second.second->fValidatedHeaders;
         state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
         state->vBlocksInFlight.erase(itInFlight->second.second);
@@ -437,6 +564,19 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
 
+/** Expected time for a peer to deliver a requested block, in microseconds.
+ *  Uses the measured delivery EWMA when available, falls back to a multiple
+ *  of the ping round trip, and is pessimistic for peers with no measurements
+ *  at all. Requires cs_main. */
+static int64_t ExpectedBlockDeliveryUsec(const CNodeState* state, int64_t nPingUsec)
+{
+    if (state->nBlockDeliveryEwmaUsec > 0)
+        return state->nBlockDeliveryEwmaUsec;
+    if (nPingUsec > 0)
+        return 10 * nPingUsec;
+    return 30 * 1000000;
+}
+
 /** Check whether the last unknown block a peer advertized is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid) {
     CNodeState *state = State(nodeid);
@@ -649,17 +789,18 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(c
     // have been mined or received.
     // 10,000 orphans, each of which is at most 5,000 bytes big is
     // at most 500 megabytes of orphans:
-    unsigned int sz = GetSerializeSize(tx, SER_NETWORK, tx.nVersion);
+    unsigned int sz = tx.GetTotalSize();
     if (sz > 5000)
     {
         LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
+    COrphanTx& orphan = mapOrphanTransactions[hash];
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
     for (const CTxIn& txin : tx.vin)
-        mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
+        mapOrphanTransactionsByPrev[txin.prevout].insert(&orphan);
 
     LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u)\n", hash.ToString(),
              mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
@@ -668,15 +809,15 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(c
 
 void static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
+    OrphanMap::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return;
     for (const CTxIn& txin : it->second.tx.vin)
     {
-        map<uint256, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+        OrphanMapByPrev::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
-        itPrev->second.erase(hash);
+        itPrev->second.erase(&it->second);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
@@ -686,10 +827,10 @@ void static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 void EraseOrphansFor(NodeId peer)
 {
     int nErased = 0;
-    map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
+    OrphanMap::iterator iter = mapOrphanTransactions.begin();
     while (iter != mapOrphanTransactions.end())
     {
-        map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
+        OrphanMap::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
         if (maybeErase->second.fromPeer == peer)
         {
             EraseOrphanTx(maybeErase->second.tx.GetHash());
@@ -705,17 +846,88 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRE
     unsigned int nEvicted = 0;
     while (mapOrphanTransactions.size() > nMaxOrphans)
     {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
+        // Evict a random orphan. The map is small (-maxorphantx), so a
+        // linear advance to a random position is cheap enough.
+        OrphanMap::iterator it = mapOrphanTransactions.begin();
+        std::advance(it, GetRand(mapOrphanTransactions.size()));
         EraseOrphanTx(it->first);
         ++nEvicted;
     }
     return nEvicted;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// mapOrphanHeaders
+//
+
+void static EraseOrphanHeader(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::map<uint256, COrphanHeader>::iterator it = mapOrphanHeaders.find(hash);
+    if (it == mapOrphanHeaders.end())
+        return;
+    auto range = mapOrphanHeadersByPrev.equal_range(it->second.header.hashPrevBlock);
+    for (auto itPrev = range.first; itPrev != range.second; ++itPrev) {
+        if (itPrev->second == hash) {
+            mapOrphanHeadersByPrev.erase(itPrev);
+            break;
+        }
+    }
+    mapOrphanHeaders.erase(it);
+}
+
+void static LimitOrphanHeaders(int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    while (!queueOrphanHeaderAge.empty()) {
+        const std::pair<int64_t, uint256>& oldest = queueOrphanHeaderAge.front();
+        if (oldest.first + ORPHAN_HEADER_EXPIRE_TIME >= nNow &&
+            mapOrphanHeaders.size() < MAX_ORPHAN_HEADERS) {
+            break;
+        }
+        EraseOrphanHeader(oldest.second);
+        queueOrphanHeaderAge.pop_front();
+    }
+}
+
+bool static AddOrphanHeader(const CBlockHeader& header, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    uint256 hash = header.GetHash();
+    if (mapOrphanHeaders.count(hash))
+        return false;
+
+    int64_t nNow = GetTime();
+    // Expire stale entries and make room under the cap before inserting, so
+    // the store never exceeds MAX_ORPHAN_HEADERS fixed-size entries.
+    LimitOrphanHeaders(nNow);
+
+    COrphanHeader& orphan = mapOrphanHeaders[hash];
+    orphan.header = header;
+    orphan.fromPeer = peer;
+    orphan.nTimeReceived = nNow;
+    mapOrphanHeadersByPrev.insert(std::make_pair(header.hashPrevBlock, hash));
+    queueOrphanHeaderAge.push_back(std::make_pair(nNow, hash));
+
+    LogPrint("net", "stored orphan header %s (mapsz %u)\n", hash.ToString(),
+             mapOrphanHeaders.size());
+    return true;
+}
+
+void EraseOrphanHeadersFor(NodeId peer)
+{
+    int nErased = 0;
+    std::map<uint256, COrphanHeader>::iterator iter = mapOrphanHeaders.begin();
+    while (iter != mapOrphanHeaders.end())
+    {
+        std::map<uint256, COrphanHeader>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
+        if (maybeErase->second.fromPeer == peer)
+        {
+            EraseOrphanHeader(maybeErase->first);
+            ++nErased;
+        }
+    }
+    if (nErased > 0) LogPrint("net", "Erased %d orphan headers from peer %d\n", nErased, peer);
+}
+
 bool IsFinalTx(const CTransaction &tx, int nBlockHeight, int64_t nBlockTime)
 {
     if (tx.nLockTime == 0)
@@ -774,16 +986,8 @@ bool CheckFinalTx(const CTransaction &tx, int flags)
 
 unsigned int GetLegacySigOpCount(const CTransaction& tx)
 {
-    unsigned int nSigOps = 0;
-    for (const CTxIn& txin : tx.vin)
-    {
-        nSigOps += txin.scriptSig.GetSigOpCount(false);
-    }
-    for (const CTxOut& txout : tx.vout)
-    {
-        nSigOps += txout.scriptPubKey.GetSigOpCount(false);
-    }
-    return nSigOps;
+    // Counted once in CTransaction::UpdateHash() and cached.
+    return tx.GetLegacySigOpCount();
 }
 
 unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& inputs)
@@ -819,7 +1023,9 @@ bool ContextualCheckTransaction(
         const CChainParams& chainparams,
         const int nHeight,
         const bool isMined,
-        bool (*isInitBlockDownload)(const Consensus::Params&))
+        bool (*isInitBlockDownload)(const Consensus::Params&),
+        sapling::BatchValidator* saplingAuth,
+        ed25519::BatchVerifier* ed25519Auth)
 {
     const int DOS_LEVEL_BLOCK = 100;
     // DoS level set to 10 to be more forgiving.
@@ -943,7 +1149,7 @@ bool ContextualCheckTransaction(
 
         // Reject transactions that exceed pre-sapling size limits
         static_assert(MAX_BLOCK_SIZE > MAX_TX_SIZE_BEFORE_SAPLING); // sanity
-        if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) > MAX_TX_SIZE_BEFORE_SAPLING)
+        if (tx.GetTotalSize() > MAX_TX_SIZE_BEFORE_SAPLING)
             return state.DoS(
                 dosLevelPotentiallyRelaxing,
                 error("ContextualCheckTransaction(): size limits failed"),
@@ -1257,7 +1463,14 @@ bool ContextualCheckTransaction(
 
     if (!tx.vJoinSplit.empty())
     {
-        if (!ed25519_verify(&tx.joinSplitPubKey, &tx.joinSplitSig, dataToBeSigned.begin(), 32)) {
+        if (ed25519Auth != nullptr) {
+            // Queue the signature for block-scoped batch verification. ZIP 215
+            // batch verification accepts exactly the signatures the inline
+            // check below accepts, so this cannot change which blocks are
+            // valid; a failed batch loses the old-consensus-branch-id
+            // diagnostic, but mined blocks are rejected either way.
+            ed25519Auth->Queue(tx.joinSplitPubKey, tx.joinSplitSig, dataToBeSigned.begin(), 32);
+        } else if (!ed25519_verify(&tx.joinSplitPubKey, &tx.joinSplitSig, dataToBeSigned.begin(), 32)) {
             // Check whether the failure was caused by an outdated consensus
             // branch ID; if so, inform the node that they need to upgrade. We
             // only check the previous epoch's branch ID, on the assumption that
@@ -1287,7 +1500,13 @@ bool ContextualCheckTransaction(
         //
         // - spendAuthSig in Sapling Spend descriptions
         // - bindingSigSapling
-        auto ctx = librustzcash_sapling_verification_ctx_init(nu5Active);
+        //
+        // If the caller provided a batch validator, the Groth16 proofs are
+        // queued into it and verified together when the caller invokes
+        // saplingAuth->Validate(); everything else is checked here as usual.
+        auto ctx = saplingAuth != nullptr ?
+            saplingAuth->CreateVerificationContext(nu5Active) :
+            librustzcash_sapling_verification_ctx_init(nu5Active);
 
         for (const SpendDescription &spend : tx.vShieldedSpend) {
             if (!librustzcash_sapling_check_spend(
@@ -1473,7 +1692,7 @@ bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidatio
     // Size limits
     static_assert(MAX_BLOCK_SIZE >= MAX_TX_SIZE_AFTER_SAPLING); // sanity
     static_assert(MAX_TX_SIZE_AFTER_SAPLING > MAX_TX_SIZE_BEFORE_SAPLING); // sanity
-    if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) > MAX_TX_SIZE_AFTER_SAPLING)
+    if (tx.GetTotalSize() > MAX_TX_SIZE_AFTER_SAPLING)
         return state.DoS(100, false, REJECT_INVALID, "bad-txns-oversize");
 
     // Check for negative or overflow output values
@@ -1740,6 +1959,43 @@ CAmount GetMinRelayFee(const CTransaction& tx, const CTxMemPool& pool, unsigned
     return nMinFee;
 }
 
+/**
+ * Warm the coin caches under the given view for every prevout spent by the
+ * given transactions. The reads go to the backing database from a small
+ * group of worker threads, so cold-cache LevelDB latency is overlapped
+ * instead of being paid one sequential miss at a time once validation
+ * starts. Requires cs_main (nothing may modify the view stack underneath).
+ */
+static void PrefetchInputCoins(const CCoinsViewCache& view, const std::vector<const CTransaction*>& vtx)
+{
+    std::vector<uint256> vPrefetch;
+    std::set<uint256> setSeen;
+    for (const CTransaction* ptx : vtx) {
+        if (ptx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : ptx->vin) {
+            if (setSeen.insert(txin.prevout.hash).second)
+                vPrefetch.push_back(txin.prevout.hash);
+        }
+    }
+    if (vPrefetch.empty())
+        return;
+    size_t nThreads = std::min<size_t>(vPrefetch.size(), nScriptCheckThreads > 1 ? nScriptCheckThreads : 1);
+    if (nThreads <= 1 || vPrefetch.size() < 4) {
+        for (const uint256& hash : vPrefetch)
+            view.PrefetchCoins(hash);
+        return;
+    }
+    boost::thread_group prefetchGroup;
+    for (size_t i = 0; i < nThreads; i++) {
+        prefetchGroup.create_thread([&view, &vPrefetch, i, nThreads]() {
+            for (size_t j = i; j < vPrefetch.size(); j += nThreads)
+                view.PrefetchCoins(vPrefetch[j]);
+        });
+    }
+    prefetchGroup.join_all();
+}
+
 /** Convert CValidationState to a human-readable message for logging */
 static std::string FormatStateMessage(const CValidationState &state)
 {
@@ -1749,11 +2005,12 @@ static std::string FormatStateMessage(const CValidationState &state)
         state.GetRejectCode());
 }
 
-bool AcceptToMemoryPool(
+static bool AcceptToMemoryPoolWorker(
         const CChainParams& chainparams,
-        CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-        bool* pfMissingInputs, bool fRejectAbsurdFee)
+        CTxMemPool& pool, CValidationState &state, const CTransactionRef& ptx, bool fLimitFree,
+        bool* pfMissingInputs, bool fRejectAbsurdFee, int64_t nAcceptTime, bool fTrustedPeer)
 {
+    const CTransaction& tx = *ptx;
     AssertLockHeld(cs_main);
     LOCK(pool.cs); // mempool "read lock" (held through pool.addUnchecked())
     if (pfMissingInputs) {
@@ -1770,11 +2027,16 @@ bool AcceptToMemoryPool(
         return false;
     }
 
-    // This will be a single-transaction batch, which is still more efficient as every
-    // Orchard bundle contains at least two signatures.
-    auto orchardAuth = orchard::AuthValidator::Batch();
+    // Transactions relayed by a trusted cluster peer (-trustedmempoolsync)
+    // were already fully validated there; skip the expensive signature and
+    // proof verification and keep the structural and policy checks.
+    //
+    // The batch will be a single-transaction batch, which is still more
+    // efficient as every Orchard bundle contains at least two signatures.
+    auto orchardAuth = fTrustedPeer ? orchard::AuthValidator::Disabled()
+                                    : orchard::AuthValidator::Batch();
 
-    auto verifier = ProofVerifier::Strict();
+    auto verifier = fTrustedPeer ? ProofVerifier::Disabled() : ProofVerifier::Strict();
     if (!CheckTransaction(tx, state, verifier, orchardAuth))
         return false;
 
@@ -1841,6 +2103,9 @@ bool AcceptToMemoryPool(
         CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
         view.SetBackend(viewMemPool);
 
+        // overlap the disk reads for any inputs we don't have cached yet
+        PrefetchInputCoins(view, {&tx});
+
         // do we already have it?
         if (view.HaveCoins(hash))
             return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
@@ -1861,7 +2126,7 @@ bool AcceptToMemoryPool(
             return state.Invalid(false, REJECT_DUPLICATE, "bad-txns-inputs-spent");
 
         // Are the shielded spends' requirements met?
-        auto unmetShieldedReq = view.HaveShieldedRequirements(tx);
+        auto unmetShieldedReq = HaveShieldedRequirementsCached(view, tx, true);
         if (unmetShieldedReq) {
             auto txid = tx.GetHash().ToString();
             auto rejectCode = ShieldedReqRejectCode(*unmetShieldedReq);
@@ -1913,7 +2178,7 @@ bool AcceptToMemoryPool(
         // For v1-v4 transactions, we don't yet know if the transaction commits
         // to consensusBranchId, but if the entry gets added to the mempool, then
         // it has passed ContextualCheckInputs and therefore this is correct.
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), fSpendsCoinbase, nSigOps, consensusBranchId);
+        CTxMemPoolEntry entry(ptx, nFees, nAcceptTime ? nAcceptTime : GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), fSpendsCoinbase, nSigOps, consensusBranchId);
         unsigned int nSize = entry.GetTxSize();
 
         // Before zcashd 4.2.0, we had a condition here to always accept a tx if it contained
@@ -1971,7 +2236,7 @@ bool AcceptToMemoryPool(
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!ContextualCheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, txdata, chainparams.GetConsensus(), consensusBranchId))
+        if (!ContextualCheckInputs(tx, state, view, !fTrustedPeer, STANDARD_SCRIPT_VERIFY_FLAGS, true, txdata, chainparams.GetConsensus(), consensusBranchId))
         {
             return false;
         }
@@ -1985,7 +2250,13 @@ bool AcceptToMemoryPool(
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!ContextualCheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata, chainparams.GetConsensus(), consensusBranchId))
+        //
+        // CHECKLOCKTIMEVERIFY is included so the flag set matches the one
+        // ConnectBlock verifies with, which lets the script execution cache
+        // entry stored here be reused when the transaction is mined. The
+        // STANDARD check above already implies it, so this cannot reject
+        // anything extra.
+        if (!ContextualCheckInputs(tx, state, view, !fTrustedPeer, MANDATORY_SCRIPT_VERIFY_FLAGS | SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY, true, txdata, chainparams.GetConsensus(), consensusBranchId))
         {
             return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
                 __func__, hash.ToString(), FormatStateMessage(state));
@@ -2023,12 +2294,81 @@ bool AcceptToMemoryPool(
     return true;
 }
 
+bool AcceptToMemoryPool(
+        const CChainParams& chainparams,
+        CTxMemPool& pool, CValidationState &state, const CTransactionRef& ptx, bool fLimitFree,
+        bool* pfMissingInputs, bool fRejectAbsurdFee, int64_t nAcceptTime, bool fTrustedPeer)
+{
+    const int64_t nStart = GetTimeMicros();
+    bool fAccepted = AcceptToMemoryPoolWorker(chainparams, pool, state, ptx, fLimitFree,
+                                              pfMissingInputs, fRejectAbsurdFee, nAcceptTime, fTrustedPeer);
+    if (fAccepted) {
+        TRACE4(mempool, accepted,
+               ptx->GetHash().begin(),
+               ptx->GetTotalSize(),
+               mempool.size(),
+               GetTimeMicros() - nStart);
+    } else {
+        TRACE4(mempool, rejected,
+               ptx->GetHash().begin(),
+               state.GetRejectCode(),
+               state.GetRejectReason().c_str(),
+               GetTimeMicros() - nStart);
+    }
+    return fAccepted;
+}
+
+bool AcceptToMemoryPool(
+        const CChainParams& chainparams,
+        CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+        bool* pfMissingInputs, bool fRejectAbsurdFee, int64_t nAcceptTime, bool fTrustedPeer)
+{
+    return AcceptToMemoryPool(chainparams, pool, state, MakeTransactionRef(tx), fLimitFree,
+                              pfMissingInputs, fRejectAbsurdFee, nAcceptTime, fTrustedPeer);
+}
+
+/** Background writer for the optional indexes (-txindex and the
+ *  insightexplorer/lightwalletd indexes).
+ *
+ *  ConnectBlock and DisconnectBlock queue their index mutations here as
+ *  closures instead of writing them under cs_main; ThreadIndexWriter runs
+ *  them strictly in queue order and then records a progress marker, so the
+ *  indexes can catch up from the marker after a crash or after being newly
+ *  enabled, without a chain reindex. */
+static const size_t INDEX_WRITE_QUEUE_DEPTH = 64;
+static boost::mutex indexWriteMutex;
+static boost::condition_variable indexWriteCond;
+//! Queued mutations: the hash of the block whose index state the mutation
+//! completes (its predecessor for disconnects), and the write itself, which
+//! returns false on database failure.
+static std::deque<std::pair<uint256, std::function<bool()> > > indexWriteQueue;
+static bool fIndexWriting = false;
+
+static void QueueIndexWrite(const uint256& hashBlock, std::function<bool()> write)
+{
+    boost::unique_lock<boost::mutex> lock(indexWriteMutex);
+    while (indexWriteQueue.size() >= INDEX_WRITE_QUEUE_DEPTH)
+        indexWriteCond.wait(lock);
+    indexWriteQueue.push_back(std::make_pair(hashBlock, std::move(write)));
+    indexWriteCond.notify_all();
+}
+
+/** Block until the background writer has committed everything queued so far,
+ *  so a subsequent index read sees every connected block. */
+static void WaitForIndexWrites()
+{
+    boost::unique_lock<boost::mutex> lock(indexWriteMutex);
+    while (!indexWriteQueue.empty() || fIndexWriting)
+        indexWriteCond.wait(lock);
+}
+
 bool GetTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
     std::vector<std::pair<uint256, unsigned int> > &hashes)
 {
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
+    WaitForIndexWrites();
     if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes))
         return error("Unable to get hashes for timestamps");
 
@@ -2044,6 +2384,7 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
+    WaitForIndexWrites();
     if (!pblocktree->ReadSpentIndex(key, value))
         return error("Unable to get spent index information");
 
@@ -2052,23 +2393,40 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 
 bool GetAddressIndex(const uint160& addressHash, int type,
                      std::vector<CAddressIndexDbEntry>& addressIndex,
-                     int start, int end)
+                     int start, int end, size_t nMaxEntries)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    WaitForIndexWrites();
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, nMaxEntries))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressBalance(const uint160& addressHash, int type, CAddressBalanceValue& balance)
+{
+    // Only usable when the index has maintained the running totals since
+    // genesis; databases built before the balance index existed need a
+    // reindex, so callers fall back to summing the deltas until then.
+    if (!fAddressIndex || !fAddressBalanceIndex)
+        return false;
+
+    WaitForIndexWrites();
+    if (!pblocktree->ReadAddressBalance(addressHash, type, balance))
+        balance.SetNull(); // address never seen on chain: zero totals
+
+    return true;
+}
+
 bool GetAddressUnspent(const uint160& addressHash, int type,
                        std::vector<CAddressUnspentDbEntry>& unspentOutputs)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
+    WaitForIndexWrites();
     if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
@@ -2079,6 +2437,40 @@ bool GetAddressUnspent(const uint160& addressHash, int type,
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
  */
+/** Cache of the transactions from the most recently connected blocks, so an
+ *  explorer polling getrawtransaction for fresh transactions right after each
+ *  block is served from memory instead of a txindex lookup plus block-file
+ *  seek. Protected by cs_main. */
+static const size_t RECENT_TX_CACHE_BLOCKS = 6;
+static std::map<uint256, std::pair<CTransactionRef, uint256> > mapRecentTxCache;
+//! Per-block txid lists, oldest first, used to evict whole blocks at a time
+static std::deque<std::vector<uint256> > vRecentTxCacheBlocks;
+
+static void AddBlockToRecentTxCache(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    const uint256 hashBlock = block.GetHash();
+    std::vector<uint256> vTxids;
+    vTxids.reserve(block.vtx.size());
+    for (const CTransaction& tx : block.vtx) {
+        mapRecentTxCache[tx.GetHash()] = std::make_pair(MakeTransactionRef(tx), hashBlock);
+        vTxids.push_back(tx.GetHash());
+    }
+    vRecentTxCacheBlocks.push_back(std::move(vTxids));
+    while (vRecentTxCacheBlocks.size() > RECENT_TX_CACHE_BLOCKS) {
+        for (const uint256& txid : vRecentTxCacheBlocks.front())
+            mapRecentTxCache.erase(txid);
+        vRecentTxCacheBlocks.pop_front();
+    }
+}
+
+static void ClearRecentTxCache()
+{
+    AssertLockHeld(cs_main);
+    mapRecentTxCache.clear();
+    vRecentTxCacheBlocks.clear();
+}
+
 bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::Params& consensusParams, uint256& hashBlock, bool fAllowSlow, CBlockIndex* blockIndex)
 {
     CBlockIndex* pindexSlow = blockIndex;
@@ -2093,7 +2485,17 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
             return true;
         }
 
+        std::map<uint256, std::pair<CTransactionRef, uint256> >::const_iterator mi = mapRecentTxCache.find(hash);
+        if (mi != mapRecentTxCache.end()) {
+            txOut = *mi->second.first;
+            hashBlock = mi->second.second;
+            return true;
+        }
+
         if (fTxIndex) {
+            // The index is written by a background thread; catch it up so a
+            // just-connected transaction is visible.
+            WaitForIndexWrites();
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
                 CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
@@ -2151,7 +2553,38 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
 // CBlock and CBlockIndex
 //
 
-bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+/** Magic prefixing block records that are stored compressed (-blockcompress):
+ *  the network magic with the top bit of the last byte flipped, so readers
+ *  can tell the two record kinds apart and the reindex scanner still finds
+ *  records by their first byte. A compressed record's size field holds the
+ *  compressed payload size, not the block's serialized size. */
+static void CompressedMessageStart(const CMessageHeader::MessageStartChars& in, CMessageHeader::MessageStartChars& out)
+{
+    memcpy(out, in, CMessageHeader::MESSAGE_START_SIZE);
+    out[CMessageHeader::MESSAGE_START_SIZE - 1] ^= 0x80;
+}
+
+/** Serialize and compress a block for disk storage. Returns false (leaving
+ *  vchOut empty) when compression does not pay for this block or fails to
+ *  round-trip, in which case the caller stores the block raw. */
+static bool CompressBlockForDisk(const CBlock& block, std::vector<unsigned char>& vchOut)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    std::vector<unsigned char> vchRaw(ss.begin(), ss.end());
+    vchOut = CompressBlockData(vchRaw);
+    // Never write a record we cannot restore bit-exactly.
+    std::vector<unsigned char> vchCheck;
+    if (vchOut.size() >= vchRaw.size() ||
+        !DecompressBlockData(vchOut, vchCheck, vchRaw.size()) ||
+        vchCheck != vchRaw) {
+        vchOut.clear();
+        return false;
+    }
+    return true;
+}
+
+bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, const std::vector<unsigned char>* pvchCompressed)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -2159,38 +2592,248 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
-    fileout << FLATDATA(messageStart) << nSize;
+    if (pvchCompressed && !pvchCompressed->empty()) {
+        CMessageHeader::MessageStartChars compressedStart;
+        CompressedMessageStart(messageStart, compressedStart);
+        fileout << FLATDATA(compressedStart) << (unsigned int)pvchCompressed->size();
+    } else {
+        unsigned int nSize = GetSerializeSize(fileout, block);
+        fileout << FLATDATA(messageStart) << nSize;
+    }
 
     // Write block
     long fileOutPos = ftell(fileout.Get());
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    if (pvchCompressed && !pvchCompressed->empty())
+        fileout.write((const char*)pvchCompressed->data(), pvchCompressed->size());
+    else
+        fileout << block;
+
+    return true;
+}
+
+#ifndef WIN32
+/**
+ * Cache of memory-mapped read-only views of block files, used by
+ * ReadBlockFromDisk when -blockmmap is enabled. Block files are append-only,
+ * so a mapping only ever becomes stale by being too short, in which case it
+ * is remapped at the file's current length.
+ */
+class CBlockFileMapper
+{
+private:
+    struct Mapping {
+        void* addr = nullptr;
+        size_t len = 0;
+    };
+
+    CCriticalSection cs;
+    std::map<int, Mapping> mapFiles;
+
+public:
+    //! Return a pointer to nBytes of block file nFile starting at nOffset,
+    //! or NULL if the file cannot be mapped that far.
+    const unsigned char* Map(int nFile, size_t nOffset, size_t nBytes)
+    {
+        LOCK(cs);
+        Mapping& mapping = mapFiles[nFile];
+        if (mapping.addr == nullptr || nOffset + nBytes > mapping.len) {
+            if (mapping.addr != nullptr) {
+                munmap(mapping.addr, mapping.len);
+                mapping.addr = nullptr;
+                mapping.len = 0;
+            }
+            fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+            int fd = open(path.string().c_str(), O_RDONLY);
+            if (fd == -1)
+                return nullptr;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t)st.st_size < nOffset + nBytes) {
+                close(fd);
+                return nullptr;
+            }
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED)
+                return nullptr;
+            mapping.addr = addr;
+            mapping.len = st.st_size;
+        }
+        return (const unsigned char*)mapping.addr + nOffset;
+    }
+};
+
+/** Minimal read-only stream over a memory-mapped region, mirroring the
+ *  subset of the CAutoFile interface that Unserialize requires. */
+class CMappedBlockStream
+{
+private:
+    const unsigned char* pch;
+    size_t nAvail;
+    int nType;
+    int nVersion;
+
+public:
+    CMappedBlockStream(const unsigned char* pchIn, size_t nAvailIn, int nTypeIn, int nVersionIn)
+        : pch(pchIn), nAvail(nAvailIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    void read(char* pchDest, size_t nSize)
+    {
+        if (nSize > nAvail)
+            throw std::ios_base::failure("CMappedBlockStream::read(): end of mapping");
+        memcpy(pchDest, pch, nSize);
+        pch += nSize;
+        nAvail -= nSize;
+    }
+
+    template <typename T>
+    CMappedBlockStream& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+};
 
+/** Try to deserialize a block straight out of an mmap'd block file.
+ *  Returns false (without logging) if the region cannot be mapped; the
+ *  caller falls back to the buffered read path. */
+static bool ReadBlockFromDiskMmap(CBlock& block, const CDiskBlockPos& pos)
+{
+    static CBlockFileMapper blockFileMapper;
+    if (pos.nPos < 8)
+        return false;
+    // Map from the record header (8 bytes before the block) up to the
+    // serialized size limit; the tail of the file may be shorter than that,
+    // so retry with whatever the file still has.
+    size_t nBytes = MAX_BLOCK_SIZE + 1024;
+    const unsigned char* pch = blockFileMapper.Map(pos.nFile, pos.nPos - 8, nBytes);
+    if (pch == nullptr) {
+        FILE* file = OpenBlockFile(pos, true);
+        if (file == nullptr)
+            return false;
+        if (fseek(file, 0, SEEK_END) != 0) {
+            fclose(file);
+            return false;
+        }
+        long nFileSize = ftell(file);
+        fclose(file);
+        if (nFileSize < 0 || (size_t)nFileSize <= pos.nPos)
+            return false;
+        nBytes = nFileSize - (pos.nPos - 8);
+        pch = blockFileMapper.Map(pos.nFile, pos.nPos - 8, nBytes);
+        if (pch == nullptr)
+            return false;
+    }
+    // Compressed records (-blockcompress) go through the buffered reader,
+    // which performs the decompression.
+    CMessageHeader::MessageStartChars compressedStart;
+    CompressedMessageStart(Params().MessageStart(), compressedStart);
+    if (memcmp(pch, compressedStart, CMessageHeader::MESSAGE_START_SIZE) == 0)
+        return false;
+    CMappedBlockStream stream(pch + 8, nBytes - 8, SER_DISK, CLIENT_VERSION);
+    stream >> block;
     return true;
 }
+#endif // !WIN32
+
+/** Bound on the PoW hash cache below; headers are checked at most a handful
+ *  of times shortly after the hash is first computed, so a small cap keeps
+ *  memory usage trivial without hurting the hit rate. */
+static const size_t MAX_POW_HASH_CACHE = 4096;
+
+static CCriticalSection cs_cachedPoWHash;
+static std::map<uint256, uint256> mapCachedPoWHash GUARDED_BY(cs_cachedPoWHash);
+
+/** Compute (or fetch a recently computed) yespower hash for a block header.
+ *
+ *  GetPoWHash() is expensive, and a block being accepted evaluates it several
+ *  times: once in AcceptBlockHeader, again in CheckBlock, and once more in
+ *  ReadBlockFromDisk if the block is re-read. Memoizing by header hash
+ *  collapses those into a single evaluation, and lets the reindex pipeline in
+ *  LoadExternalBlockFile precompute hashes on worker threads so that none of
+ *  the cost is paid under cs_main.
+ */
+static uint256 GetPoWHashCached(const CBlockHeader& block)
+{
+    const uint256 hash = block.GetHash();
+    {
+        LOCK(cs_cachedPoWHash);
+        std::map<uint256, uint256>::const_iterator it = mapCachedPoWHash.find(hash);
+        if (it != mapCachedPoWHash.end())
+            return it->second;
+    }
+    const uint256 powHash = block.GetPoWHash();
+    {
+        LOCK(cs_cachedPoWHash);
+        if (mapCachedPoWHash.size() >= MAX_POW_HASH_CACHE)
+            mapCachedPoWHash.clear();
+        mapCachedPoWHash.insert(std::make_pair(hash, powHash));
+    }
+    return powHash;
+}
 
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+#ifndef WIN32
+    if (GetBoolArg("-blockmmap", DEFAULT_BLOCKMMAP)) {
+        try {
+            if (ReadBlockFromDiskMmap(block, pos)) {
+                if (!CheckProofOfWork(GetPoWHashCached(block), block.nBits, consensusParams))
+                    return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
+                return true;
+            }
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize error in mapped block file - %s at %s", __func__, e.what(), pos.ToString());
+        }
+        block.SetNull();
+        // fall through to the buffered reader
+    }
+#endif
+
+    // Open history file to read, positioned at the record header (which is
+    // always present: the first record of a file starts at offset 8), so raw
+    // and compressed records can be told apart.
+    if (pos.nPos < 8)
+        return error("ReadBlockFromDisk: invalid block position %s", pos.ToString());
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
     // Read block
     try {
-        filein >> block;
+        CMessageHeader::MessageStartChars blkStart, compressedStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blkStart) >> nSize;
+        CompressedMessageStart(Params().MessageStart(), compressedStart);
+        if (memcmp(blkStart, compressedStart, CMessageHeader::MESSAGE_START_SIZE) == 0) {
+            if (nSize == 0 || nSize > MAX_BLOCK_SIZE)
+                return error("%s: invalid compressed record size %u at %s", __func__, nSize, pos.ToString());
+            std::vector<unsigned char> vchCompressed(nSize);
+            std::vector<unsigned char> vchRaw;
+            filein.read((char*)vchCompressed.data(), nSize);
+            if (!DecompressBlockData(vchCompressed, vchRaw, MAX_BLOCK_SIZE))
+                return error("%s: corrupt compressed block record at %s", __func__, pos.ToString());
+            CDataStream ssBlock(vchRaw, SER_DISK, CLIENT_VERSION);
+            ssBlock >> block;
+        } else {
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    if (!CheckProofOfWork(GetPoWHashCached(block), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
@@ -2206,6 +2849,51 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& rawBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // Seek back to where WriteBlockToDisk put the index header, so the
+    // network magic and length can be validated before the raw copy.
+    if (pos.nPos < 8)
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int nSize;
+        filein >> FLATDATA(blk_start) >> nSize;
+
+        CMessageHeader::MessageStartChars compressedStart;
+        CompressedMessageStart(messageStart, compressedStart);
+        if (memcmp(blk_start, compressedStart, CMessageHeader::MESSAGE_START_SIZE) == 0) {
+            // Compressed record: the raw serialization has to be restored
+            // before it can be served.
+            if (nSize == 0 || nSize > MAX_BLOCK_SIZE)
+                return error("%s: invalid compressed record size %u at %s", __func__, nSize, pos.ToString());
+            std::vector<unsigned char> vchCompressed(nSize);
+            filein.read((char*)vchCompressed.data(), nSize);
+            if (!DecompressBlockData(vchCompressed, rawBlock, MAX_BLOCK_SIZE))
+                return error("%s: corrupt compressed block record at %s", __func__, pos.ToString());
+            return true;
+        }
+        if (memcmp(blk_start, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+            return error("%s: block magic mismatch at %s", __func__, pos.ToString());
+        if (nSize > MAX_BLOCK_SIZE)
+            return error("%s: block size %u exceeds maximum at %s", __func__, nSize, pos.ToString());
+
+        rawBlock.resize(nSize);
+        filein.read((char*)rawBlock.data(), nSize);
+    } catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     CAmount nSubsidy = 100 * COIN;
@@ -2451,14 +3139,15 @@ void static InvalidChainFound(CBlockIndex* pindexNew, const CChainParams& chainP
 void static InvalidBlockFound(CBlockIndex *pindex, const CValidationState &state, const CChainParams& chainParams) {
     int nDoS = 0;
     if (state.IsInvalid(nDoS)) {
-        std::map<uint256, NodeId>::iterator it = mapBlockSource.find(pindex->GetBlockHash());
-        if (it != mapBlockSource.end() && State(it->second)) {
+        NodeId nodeSource;
+        if (mapBlockSource.find(pindex->GetBlockHash(), nodeSource) && State(nodeSource)) {
             assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
             CBlockReject reject = {(unsigned char)state.GetRejectCode(), state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), pindex->GetBlockHash()};
-            State(it->second)->rejects.push_back(reject);
+            State(nodeSource)->rejects.push_back(reject);
             if (nDoS > 0)
-                Misbehaving(it->second, nDoS);
+                Misbehaving(nodeSource, nDoS);
         }
+        mapBlockSource.erase(pindex->GetBlockHash());
     }
     if (!state.CorruptionPossible()) {
         pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -2528,7 +3217,7 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
             return state.Invalid(false, 0, "", "Inputs unavailable");
 
         // Are the shielded spends' requirements met?
-        auto unmetShieldedReq = inputs.HaveShieldedRequirements(tx);
+        auto unmetShieldedReq = HaveShieldedRequirementsCached(inputs, tx, false);
         if (unmetShieldedReq) {
             auto txid = tx.GetHash().ToString();
             auto rejectCode = ShieldedReqRejectCode(*unmetShieldedReq);
@@ -2597,6 +3286,83 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
+/**
+ * Transaction-level script verification cache.
+ *
+ * Once every input script of a transaction has verified under a given flag
+ * set and consensus branch ID, an entry is stored so that validating the same
+ * transaction again -- promoting it from the mempool into a block, or
+ * replaying blocks during a reorg -- skips script execution entirely. v5
+ * transaction ids do not commit to signatures, so the authorizing data digest
+ * is part of the key; the key is salted with a random nonce so entries cannot
+ * be predicted externally.
+ */
+class CScriptExecutionCache
+{
+private:
+    CCriticalSection cs;
+    std::set<uint256> setEntries;
+    uint256 nonce;
+    size_t nMaxEntries;
+
+public:
+    CScriptExecutionCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        // Entries are 32 bytes each; -maxscriptcachesize is in MiB.
+        nMaxEntries = GetArg("-maxscriptcachesize", DEFAULT_MAX_SCRIPT_CACHE_SIZE) * ((size_t)1 << 20) / sizeof(uint256);
+    }
+
+    uint256 ComputeEntry(const CTransaction& tx, unsigned int flags, uint32_t consensusBranchId) const
+    {
+        uint256 entry;
+        CSHA256().Write(nonce.begin(), 32)
+                 .Write(tx.GetHash().begin(), 32)
+                 .Write(tx.GetAuthDigest().begin(), 32)
+                 .Write((const unsigned char*)&flags, sizeof(flags))
+                 .Write((const unsigned char*)&consensusBranchId, sizeof(consensusBranchId))
+                 .Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry)
+    {
+        LOCK(cs);
+        return setEntries.count(entry) != 0;
+    }
+
+    void Set(const uint256& entry)
+    {
+        LOCK(cs);
+        while (setEntries.size() >= nMaxEntries && nMaxEntries > 0) {
+            // Evict a pseudo-random entry
+            std::set<uint256>::iterator it = setEntries.lower_bound(GetRandHash());
+            if (it == setEntries.end())
+                it = setEntries.begin();
+            setEntries.erase(it);
+        }
+        setEntries.insert(entry);
+    }
+
+    size_t DynamicMemoryUsage()
+    {
+        LOCK(cs);
+        return memusage::DynamicUsage(setEntries);
+    }
+};
+
+// Constructed on first use so -maxscriptcachesize has been parsed by then.
+static CScriptExecutionCache& GetScriptExecutionCache()
+{
+    static CScriptExecutionCache scriptExecutionCache;
+    return scriptExecutionCache;
+}
+
+size_t ScriptExecutionCacheBytes()
+{
+    return GetScriptExecutionCache().DynamicMemoryUsage();
+}
+
 bool ContextualCheckInputs(
     const CTransaction& tx,
     CValidationState &state,
@@ -2626,6 +3392,19 @@ bool ContextualCheckInputs(
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            CScriptExecutionCache& scriptExecutionCache = GetScriptExecutionCache();
+
+            // If this transaction's scripts have already fully verified under
+            // these flags and branch ID -- when it entered the mempool, or in
+            // a block that was disconnected during a reorg -- skip script
+            // execution entirely.
+            uint256 hashCacheEntry = scriptExecutionCache.ComputeEntry(tx, flags, consensusBranchId);
+            if (scriptExecutionCache.Get(hashCacheEntry)) {
+                MetricsIncrementCounter("zcash.script.scriptcache.hits");
+                return true;
+            }
+            MetricsIncrementCounter("zcash.script.scriptcache.misses");
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
                 const CCoins* coins = inputs.AccessCoins(prevout.hash);
@@ -2671,6 +3450,12 @@ bool ContextualCheckInputs(
                     return state.DoS(100,false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            if (cacheStore && !pvChecks) {
+                // Every script was executed (not handed off to the parallel
+                // check queue) and passed; remember the whole transaction.
+                scriptExecutionCache.Set(hashCacheEntry);
+            }
         }
     }
 
@@ -2679,7 +3464,11 @@ bool ContextualCheckInputs(
 
 namespace {
 
-bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+/** Append pre-serialized undo data to the undo file. The caller serializes
+ *  the CBlockUndo once (overlapped with script verification in ConnectBlock)
+ *  and the same bytes are reused for the length prefix, the payload and the
+ *  checksum, instead of running three separate serialization passes. */
+bool UndoWriteToDisk(const CDataStream& ssUndo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -2687,7 +3476,7 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
         return error("%s: OpenUndoFile failed", __func__);
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
+    unsigned int nSize = ssUndo.size();
     fileout << FLATDATA(messageStart) << nSize;
 
     // Write undo data
@@ -2695,12 +3484,12 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     if (fileOutPos < 0)
         return error("%s: ftell failed", __func__);
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    fileout.write(ssUndo.data(), ssUndo.size());
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
-    hasher << blockundo;
+    hasher.write(ssUndo.data(), ssUndo.size());
     fileout << hasher.GetHash();
 
     return true;
@@ -2768,18 +3557,7 @@ static bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const CO
     return fClean;
 }
 
-enum DisconnectResult
-{
-    DISCONNECT_OK,      // All good.
-    DISCONNECT_UNCLEAN, // Rolled back, but UTXO set was inconsistent with block.
-    DISCONNECT_FAILED   // Something else went wrong.
-};
-
-/** Undo the effects of this block (with given index) on the UTXO set represented by coins.
- *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state.
- *  The addressIndex and spentIndex will be updated if requested.
- */
-static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state,
+DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state,
     const CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams,
     const bool updateIndices)
 {
@@ -2926,21 +3704,18 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
 
     // insightexplorer
     if (fAddressIndex && updateIndices) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
+        QueueIndexWrite(pindex->pprev->GetBlockHash(),
+            [addressIndex = std::move(addressIndex), addressUnspentIndex = std::move(addressUnspentIndex)]() {
+                return pblocktree->EraseAddressIndex(addressIndex) &&
+                       pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex) &&
+                       pblocktree->UpdateAddressBalances(addressIndex, true);
+            });
     }
     // insightexplorer
     if (fSpentIndex && updateIndices) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            AbortNode(state, "Failed to write transaction index");
-            return DISCONNECT_FAILED;
-        }
+        QueueIndexWrite(pindex->pprev->GetBlockHash(), [spentIndex = std::move(spentIndex)]() {
+            return pblocktree->UpdateSpentIndex(spentIndex);
+        });
     }
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
@@ -2972,9 +3747,36 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
+/** Queue for CheckBlock's per-transaction sanity checks; one check covers a
+ *  whole transaction, so the batch size is small. */
+static CCheckQueue<CBlockTxCheck> blocktxcheckqueue(16);
+
+/** Shared pool the -par worker threads service; all CPU-bound check queues
+ *  register here instead of spawning dedicated threads. scriptcheckqueue is
+ *  registered first so block validation has priority over later queues. */
+static CValidationPool validationPool;
+
+void InitValidationPool(int nWorkers)
+{
+    validationPool.SetSpinWait(GetArg("-parspin", DEFAULT_SCRIPTCHECK_SPIN));
+    validationPool.RegisterQueue(scriptcheckqueue, nWorkers);
+    validationPool.RegisterQueue(blocktxcheckqueue, nWorkers);
+}
+
+bool CBlockTxCheck::operator()()
+{
+    // Orchard signature batching is not thread-safe; the master queues the
+    // signatures itself once every check has passed, so run with a disabled
+    // validator here. The bundle's proofs are still checked.
+    CValidationState state;
+    auto disabledAuth = orchard::AuthValidator::Disabled();
+    return CheckTransaction(*ptx, state, *verifier, disabledAuth);
+}
+
 void ThreadScriptCheck() {
+    static std::atomic<int> nNextWorkerSlot(0);
     RenameThread("koto-scriptch");
-    scriptcheckqueue.Thread();
+    validationPool.Thread(nNextWorkerSlot.fetch_add(1));
 }
 
 static int64_t nTimeVerify = 0;
@@ -2983,6 +3785,19 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/** Number of recently connected blocks to retain timing records for. */
+static const size_t BLOCK_CONNECT_TIMING_WINDOW = 128;
+/** Recent per-block connect timings, oldest first; protected by cs_main. */
+static std::deque<CBlockConnectTiming> vBlockConnectTimings;
+/** Phase timings of the most recent full ConnectBlock run, picked up by
+ *  ConnectTip to build the block's record (both run under cs_main). */
+static struct {
+    int64_t nConnectUsec;
+    int64_t nVerifyUsec;
+    int64_t nIndexUsec;
+    int64_t nCallbacksUsec;
+} lastConnectBlockPhases;
+
 /**
  * Determine whether to do transaction checks when verifying blocks.
  * Returns `false` (allowing transaction checks to be skipped) only if all
@@ -3011,7 +3826,22 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         fExpensiveChecks = false;
     }
 
-    // proof verification is expensive, disable if possible
+    // If the operator supplied -assumevalid, and that block is both on the
+    // best known header chain and a descendant of this block, skip script and
+    // proof verification as well. Amount and UTXO accounting below still run,
+    // so a bad assumed-valid hash can hide invalid signatures and proofs but
+    // cannot inflate the money supply.
+    if (fExpensiveChecks && !hashAssumeValid.IsNull()) {
+        BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+        if (it != mapBlockIndex.end()) {
+            if (it->second->GetAncestor(pindex->nHeight) == pindex &&
+                pindexBestHeader->GetAncestor(pindex->nHeight) == pindex) {
+                fExpensiveChecks = false;
+            }
+        }
+    }
+
+    // proof verification is expensive, disable if possible
     auto verifier = fExpensiveChecks ? ProofVerifier::Strict() : ProofVerifier::Disabled();
 
     // Disable Orchard batch signature validation if possible.
@@ -3109,6 +3939,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
+    CAmount nTransparentValueDelta = 0;
     int nInputs = 0;
     unsigned int nSigOps = 0;
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
@@ -3149,6 +3980,22 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     size_t total_sapling_tx = 0;
     size_t total_orchard_tx = 0;
 
+    // Sapling note commitments are collected across the whole block and
+    // appended to the tree in one batch below, so the Pedersen hashes of the
+    // frontier update cross the FFI once per tree level (and run in
+    // parallel) instead of once per commitment.
+    std::vector<libzcash::PedersenHash> vSaplingCommitments;
+
+    // Overlap the disk reads for the whole block's inputs before validating
+    // transaction by transaction.
+    {
+        std::vector<const CTransaction*> vtxPrefetch;
+        vtxPrefetch.reserve(block.vtx.size());
+        for (const CTransaction& tx : block.vtx)
+            vtxPrefetch.push_back(&tx);
+        PrefetchInputCoins(view, vtxPrefetch);
+    }
+
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
     for (unsigned int i = 0; i < block.vtx.size(); i++)
@@ -3169,7 +4016,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                                  REJECT_INVALID, "bad-txns-inputs-missingorspent");
 
             // Are the shielded spends' requirements met?
-            auto unmetShieldedReq = view.HaveShieldedRequirements(tx);
+            auto unmetShieldedReq = HaveShieldedRequirementsCached(view, tx, false);
             if (unmetShieldedReq) {
                 auto txid = tx.GetHash().ToString();
                 auto rejectCode = ShieldedReqRejectCode(*unmetShieldedReq);
@@ -3224,9 +4071,17 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
         txdata.emplace_back(tx);
 
+        // Track the change in value held by transparent outputs; shielded
+        // pool movements are already tracked per-block on the index.
+        for (const CTxOut& out : tx.vout) {
+            nTransparentValueDelta += out.nValue;
+        }
+
         if (!tx.IsCoinBase())
         {
-            nFees += view.GetValueIn(tx)-tx.GetValueOut();
+            CAmount nTxValueIn = view.GetValueIn(tx);
+            nTransparentValueDelta -= nTxValueIn - tx.GetShieldedValueIn();
+            nFees += nTxValueIn - tx.GetValueOut();
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
@@ -3273,7 +4128,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
 
         for (const OutputDescription &outputDescription : tx.vShieldedOutput) {
-            sapling_tree.append(outputDescription.cmu);
+            vSaplingCommitments.push_back(libzcash::PedersenHash(outputDescription.cmu));
         }
 
         if (!orchard_tree.AppendBundle(tx.GetOrchardBundle())) {
@@ -3294,6 +4149,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
+    sapling_tree.append_batch(vSaplingCommitments);
+
     // Derive the various block commitments.
     // We only derive them if they will be used for this block.
     std::optional<uint256> hashAuthDataRoot;
@@ -3309,6 +4166,16 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     view.PushAnchor(sapling_tree);
     view.PushAnchor(orchard_tree);
     if (!fJustCheck) {
+        pindex->nTransparentValue = nTransparentValueDelta;
+        if (pindex->pprev) {
+            if (pindex->pprev->nChainTransparentValue) {
+                pindex->nChainTransparentValue = *pindex->pprev->nChainTransparentValue + nTransparentValueDelta;
+            } else {
+                pindex->nChainTransparentValue = std::nullopt;
+            }
+        } else {
+            pindex->nChainTransparentValue = nTransparentValueDelta;
+        }
         pindex->hashFinalSproutRoot = sprout_tree.root();
         // - If this block is before Heartwood activation, then we don't set
         //   hashFinalSaplingRoot here to maintain the invariant documented in
@@ -3338,6 +4205,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
     blockundo.old_sprout_tree_root = old_sprout_tree_root;
 
+    // The undo data is complete at this point; serialize it now, while the
+    // script check workers are still draining their queue, so the work
+    // overlaps verification instead of extending the tail after Wait().
+    CDataStream ssUndo(SER_DISK, CLIENT_VERSION);
+    if (!fJustCheck && pindex->GetUndoPos().IsNull()) {
+        ssUndo.reserve(::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION));
+        ssUndo << blockundo;
+    }
+
     if (chainparams.GetConsensus().NetworkUpgradeActive(pindex->nHeight, Consensus::UPGRADE_NU5)) {
         if (fCheckAuthDataRoot) {
             // If NU5 is active, block.hashBlockCommitments must be the top digest
@@ -3416,6 +4292,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime1 = GetTimeMicros(); nTimeConnect += nTime1 - nTimeStart;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime1 - nTimeStart) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime1 - nTimeStart) / (nInputs-1), nTimeConnect * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime1 - nTimeStart) * 0.000001, "phase", "connect");
+    lastConnectBlockPhases.nConnectUsec = nTime1 - nTimeStart;
 
     CAmount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, chainparams.GetConsensus());
     if (block.vtx[0].GetValueOut() > blockReward)
@@ -3458,6 +4336,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return state.DoS(100, false);
     int64_t nTime2 = GetTimeMicros(); nTimeVerify += nTime2 - nTimeStart;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs-1), nTimeVerify * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime2 - nTimeStart) * 0.000001, "phase", "verify");
+    lastConnectBlockPhases.nVerifyUsec = nTime2 - nTimeStart;
 
     if (fJustCheck)
         return true;
@@ -3467,9 +4347,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     {
         if (pindex->GetUndoPos().IsNull()) {
             CDiskBlockPos _pos;
-            if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+            if (!FindUndoPos(state, pindex->nFile, _pos, ssUndo.size() + 40))
                 return error("ConnectBlock(): FindUndoPos failed");
-            if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+            if (!UndoWriteToDisk(ssUndo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
                 return AbortNode(state, "Failed to write undo data");
 
             // update nUndoPos in block index
@@ -3492,43 +4372,43 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
+    if (fTxIndex) {
+        const uint256 hashBlock = pindex->GetBlockHash();
+        QueueIndexWrite(hashBlock, [vPos = std::move(vPos), hashBlock]() {
+            return pblocktree->WriteTxIndex(vPos, hashBlock);
+        });
+    }
 
     // START insightexplorer
     if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
+        QueueIndexWrite(pindex->GetBlockHash(),
+            [addressIndex = std::move(addressIndex), addressUnspentIndex = std::move(addressUnspentIndex)]() {
+                return pblocktree->WriteAddressIndex(addressIndex) &&
+                       pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex) &&
+                       pblocktree->UpdateAddressBalances(addressIndex, false);
+            });
     }
     if (fSpentIndex) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            return AbortNode(state, "Failed to write spent index");
-        }
+        QueueIndexWrite(pindex->GetBlockHash(), [spentIndex = std::move(spentIndex)]() {
+            return pblocktree->UpdateSpentIndex(spentIndex);
+        });
     }
     if (fTimestampIndex) {
-        unsigned int logicalTS = pindex->nTime;
-        unsigned int prevLogicalTS = 0;
-
-        // retrieve logical timestamp of the previous block
-        if (pindex->pprev)
-            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
-                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
-
-        if (logicalTS <= prevLogicalTS) {
-            logicalTS = prevLogicalTS + 1;
-            LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
-        }
-
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
-            return AbortNode(state, "Failed to write blockhash index");
+        // The previous block's logical timestamp is read inside the closure:
+        // queued writes run in order, so by then it has been committed.
+        QueueIndexWrite(pindex->GetBlockHash(), [pindex]() {
+            unsigned int logicalTS = pindex->nTime;
+            unsigned int prevLogicalTS = 0;
+            if (pindex->pprev)
+                if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
+                    LogPrintf("ConnectBlock(): Failed to read previous block's logical timestamp\n");
+            if (logicalTS <= prevLogicalTS) {
+                logicalTS = prevLogicalTS + 1;
+                LogPrintf("ConnectBlock(): Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", pindex->nTime, prevLogicalTS, logicalTS);
+            }
+            return pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())) &&
+                   pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS));
+        });
     }
     // END insightexplorer
 
@@ -3537,14 +4417,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime3 = GetTimeMicros(); nTimeIndex += nTime3 - nTime2;
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeIndex * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime3 - nTime2) * 0.000001, "phase", "index");
+    lastConnectBlockPhases.nIndexUsec = nTime3 - nTime2;
 
     // Watch for changes to the previous coinbase transaction.
     static uint256 hashPrevBestCoinBase;
-    GetMainSignals().UpdatedTransaction(hashPrevBestCoinBase);
+    NotifyUpdatedTransaction(hashPrevBestCoinBase);
     hashPrevBestCoinBase = block.vtx[0].GetHash();
 
     int64_t nTime4 = GetTimeMicros(); nTimeCallbacks += nTime4 - nTime3;
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeCallbacks * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime4 - nTime3) * 0.000001, "phase", "callbacks");
+    lastConnectBlockPhases.nCallbacksUsec = nTime4 - nTime3;
 
     return true;
 }
@@ -3556,6 +4440,56 @@ enum FlushStateMode {
     FLUSH_STATE_ALWAYS
 };
 
+/** Whether a background block index write is currently in flight. */
+static std::atomic<bool> fBackgroundWriteActive(false);
+
+/** Sync the block and undo file for one file number. Unlike FlushBlockFile
+ *  this does not hold cs_LastBlockFile across the fsync, so appends to the
+ *  current file are not stalled behind the disk. */
+void static SyncBlockFile(int nFile)
+{
+    CDiskBlockPos pos(nFile, 0);
+    FILE *file = OpenBlockFile(pos);
+    if (file) {
+        FileCommit(file);
+        fclose(file);
+    }
+    file = OpenUndoFile(pos);
+    if (file) {
+        FileCommit(file);
+        fclose(file);
+    }
+}
+
+/** Sync a block file that FindBlockPos has just finished with, on a detached
+ *  thread so the first append to its successor is not stalled behind two
+ *  fsyncs. Safe to defer: block index entries referring to the file are only
+ *  written by FlushStateToDisk, which syncs every dirty file first. */
+void static BackgroundSyncBlockFile(int nFile)
+{
+    RenameThread("koto-filesync");
+    SyncBlockFile(nFile);
+}
+
+/** Persist a snapshot of dirty block file info and block index entries taken
+ *  by FlushStateToDisk, running on a detached thread so the periodic write
+ *  does not stall block relay under cs_main. The block and undo files are
+ *  synced first: index entries must never refer to contents that are not yet
+ *  durable. */
+void static BackgroundWriteBlockIndex(std::vector<std::pair<int, CBlockFileInfo> > vFiles,
+                                      int nLastFile,
+                                      std::vector<CDiskBlockIndex> vBlocks)
+{
+    RenameThread("koto-indexwrite");
+    for (std::vector<std::pair<int, CBlockFileInfo> >::const_iterator it = vFiles.begin(); it != vFiles.end(); it++) {
+        SyncBlockFile(it->first);
+    }
+    if (!pblocktree->WriteBatchSync(vFiles, nLastFile, vBlocks)) {
+        AbortNode("Failed to write to block index database");
+    }
+    fBackgroundWriteActive = false;
+}
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with
@@ -3592,10 +4526,18 @@ bool static FlushStateToDisk(
         nLastFlush = nNow;
     }
     size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+    const int64_t nFlushStart = nNow;
+    TRACE3(validation, flush_start, (int)mode, cacheSize, pcoinsTip->GetCacheSize());
+    // During IBD the verification caches sit mostly idle (script checks are
+    // skipped below the checkpoints), so the coins cache may borrow their
+    // share of the budget; once IBD ends the next flushes return it.
+    size_t nCoinCacheLimit = nCoinCacheUsage;
+    if (nCoinCacheIBDBonus > 0 && IsInitialBlockDownload(chainparams.GetConsensus()))
+        nCoinCacheLimit += nCoinCacheIBDBonus;
     // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
-    bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0/9) > nCoinCacheUsage;
+    bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0/9) > nCoinCacheLimit;
     // The cache is over the limit, we have to write now.
-    bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nCoinCacheUsage;
+    bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nCoinCacheLimit;
     // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
     bool fPeriodicWrite = mode == FLUSH_STATE_PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
     // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
@@ -3603,12 +4545,16 @@ bool static FlushStateToDisk(
     // Combine all conditions that result in a full cache flush.
     bool fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
     // Write blocks and block index to disk.
-    if (fDoFullFlush || fPeriodicWrite) {
+    if (fDoFullFlush) {
         // Depend on nMinDiskSpace to ensure we can write block index
         if (!CheckDiskSpace(0))
             return state.Error("out of disk space");
-        // First make sure all block and undo data is flushed to disk.
-        FlushBlockFile();
+        // Wait out any in-flight background write: were it to land after the
+        // batch below it would clobber newer entries with its older snapshot.
+        // This also orders all background writes before the shutdown flush.
+        while (fBackgroundWriteActive) {
+            MilliSleep(10);
+        }
         // Then update all block file information (which may refer to block and undo files).
         {
             std::vector<std::pair<int, const CBlockFileInfo*> > vFiles;
@@ -3617,6 +4563,13 @@ bool static FlushStateToDisk(
                 vFiles.push_back(make_pair(*it, &vinfoBlockFile[*it]));
                 it = setDirtyFileInfo.erase(it);
             }
+            // First make sure all block and undo data the new entries refer
+            // to is flushed to disk. Every dirty file is synced, not just the
+            // last one: undo data for a finished file can still trail in
+            // after the rollover, and its rollover sync runs detached.
+            for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it = vFiles.begin(); it != vFiles.end(); it++) {
+                SyncBlockFile(it->first);
+            }
             std::vector<const CBlockIndex*> vBlocks;
             vBlocks.reserve(setDirtyBlockIndex.size());
             for (set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
@@ -3631,6 +4584,32 @@ bool static FlushStateToDisk(
         if (fFlushForPrune)
             UnlinkPrunedFiles(setFilesToPrune);
         nLastWrite = nNow;
+        TRACE1(validation, flush_block_index, GetTimeMicros() - nFlushStart);
+    } else if (fPeriodicWrite && !fBackgroundWriteActive.exchange(true)) {
+        // The periodic write keeps a crash from forcing a redownload, but
+        // nothing afterwards depends on it having completed, so take a
+        // by-value snapshot of the dirty sets under cs_main and let a
+        // detached thread do the file syncs and the LevelDB write. If the
+        // previous background write is still running the dirty sets are
+        // simply left for the next call.
+        if (!CheckDiskSpace(0)) {
+            fBackgroundWriteActive = false;
+            return state.Error("out of disk space");
+        }
+        std::vector<std::pair<int, CBlockFileInfo> > vFiles;
+        vFiles.reserve(setDirtyFileInfo.size());
+        for (set<int>::iterator it = setDirtyFileInfo.begin(); it != setDirtyFileInfo.end(); ) {
+            vFiles.push_back(make_pair(*it, vinfoBlockFile[*it]));
+            it = setDirtyFileInfo.erase(it);
+        }
+        std::vector<CDiskBlockIndex> vBlocks;
+        vBlocks.reserve(setDirtyBlockIndex.size());
+        for (set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
+            vBlocks.push_back(CDiskBlockIndex(*it));
+            it = setDirtyBlockIndex.erase(it);
+        }
+        boost::thread(boost::bind(&BackgroundWriteBlockIndex, vFiles, nLastBlockFile, vBlocks)).detach();
+        nLastWrite = nNow;
     }
     // Flush best chain related state. This can only be done if the blocks / block index write was also done.
     if (fDoFullFlush) {
@@ -3645,7 +4624,10 @@ bool static FlushStateToDisk(
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
         nLastFlush = nNow;
+        TRACE1(validation, flush_chainstate, GetTimeMicros() - nFlushStart);
+        MetricsHistogram("zcash.chain.flush.seconds", (GetTimeMicros() - nFlushStart) * 0.000001);
     }
+    TRACE3(validation, flush_end, (int)mode, fDoFullFlush, GetTimeMicros() - nFlushStart);
     // Don't flush the wallet witness cache (SetBestChain()) here, see #4301
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -3750,6 +4732,14 @@ struct PoolMetrics {
         }                                        \
     } while (0)
 
+/** Latest published tip snapshot; swapped atomically so readers never block. */
+static std::shared_ptr<const CChainTipSnapshot> spChainTipSnapshot;
+
+std::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot()
+{
+    return std::atomic_load(&spChainTipSnapshot);
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
@@ -3758,6 +4748,16 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
+    // Publish the cheap tip state for lock-free readers.
+    auto snapshot = std::make_shared<CChainTipSnapshot>();
+    snapshot->nHeight = pindexNew->nHeight;
+    snapshot->hashBlock = pindexNew->GetBlockHash();
+    snapshot->nChainWork = pindexNew->nChainWork;
+    snapshot->nBits = pindexNew->nBits;
+    snapshot->nBitsNext = GetNextWorkRequired(pindexNew, nullptr, chainParams.GetConsensus());
+    snapshot->nMedianTime = pindexNew->GetMedianTimePast();
+    std::atomic_store(&spChainTipSnapshot, std::shared_ptr<const CChainTipSnapshot>(snapshot));
+
     auto hash = tfm::format("%s", chainActive.Tip()->GetBlockHash().ToString());
     auto height = tfm::format("%d", chainActive.Height());
     auto bits = tfm::format("%d", chainActive.Tip()->nBits);
@@ -3793,7 +4793,11 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
  * Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and
  * mempool.removeWithoutBranchId after this, with cs_main held.
  */
-bool static DisconnectTip(CValidationState &state, const CChainParams& chainparams, bool fBare = false)
+/** Maximum bytes of disconnected transactions kept for reinsertion during a
+ *  reorg; beyond this the tip-most transactions are simply dropped. */
+static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20 * 1000000;
+
+bool static DisconnectTip(CValidationState &state, const CChainParams& chainparams, std::list<CTransaction>* disconnectpool = NULL)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
@@ -3819,14 +4823,23 @@ bool static DisconnectTip(CValidationState &state, const CChainParams& chainpara
     if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_IF_NEEDED))
         return false;
 
-    if (!fBare) {
-        // Resurrect mempool transactions from the disconnected block.
-        for (const CTransaction &tx : block.vtx) {
-            // ignore validation errors in resurrected transactions
-            list<CTransaction> removed;
-            CValidationState stateDummy;
-            if (tx.IsCoinBase() || !AcceptToMemoryPool(chainparams, mempool, stateDummy, tx, false, NULL))
-                mempool.remove(tx, removed, true);
+    if (disconnectpool) {
+        // Save the transactions from the disconnected block for reinsertion
+        // once the reorg has finished; see UpdateMempoolForReorg. Each block
+        // is prepended as a group so the pool stays ordered oldest-first,
+        // with dependencies ahead of their dependents.
+        for (auto it = block.vtx.rbegin(); it != block.vtx.rend(); ++it) {
+            if (!it->IsCoinBase())
+                disconnectpool->push_front(*it);
+        }
+        unsigned int nPoolSize = 0;
+        for (const CTransaction& tx : *disconnectpool)
+            nPoolSize += tx.GetTotalSize();
+        while (nPoolSize > MAX_DISCONNECTED_TX_POOL_SIZE && !disconnectpool->empty()) {
+            // Drop the tip-most transactions first; they are the ones most
+            // likely to depend on something else in the pool.
+            nPoolSize -= disconnectpool->back().GetTotalSize();
+            disconnectpool->pop_back();
         }
         if (sproutAnchorBeforeDisconnect != sproutAnchorAfterDisconnect) {
             // The anchor may not change between block disconnects,
@@ -3843,11 +4856,37 @@ bool static DisconnectTip(CValidationState &state, const CChainParams& chainpara
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev, chainparams);
 
+    // A reorg invalidates the recent-transaction cache wholesale; it will
+    // repopulate as the new chain connects.
+    ClearRecentTxCache();
+
     // Updates to connected wallets are triggered by ThreadNotifyWallets
 
     return true;
 }
 
+/** Reinsert the contents of a disconnectpool filled by DisconnectTip once a
+ *  reorg has finished. The transactions were fully validated when their
+ *  blocks were connected, so signature and proof verification is skipped and
+ *  only the contextual checks (inputs still unspent, anchors, expiry, fees)
+ *  are re-run. Transactions that fail, or that conflict with the new chain,
+ *  are removed from the mempool together with their descendants. If
+ *  fAddToMempool is false the pool is simply discarded. */
+static void UpdateMempoolForReorg(const CChainParams& chainparams, std::list<CTransaction>& disconnectpool, bool fAddToMempool)
+{
+    AssertLockHeld(cs_main);
+    for (const CTransaction& tx : disconnectpool) {
+        // ignore validation errors in resurrected transactions
+        list<CTransaction> removed;
+        CValidationState stateDummy;
+        if (!fAddToMempool ||
+            !AcceptToMemoryPool(chainparams, mempool, stateDummy, tx, false, NULL,
+                                false, 0, /* fTrustedPeer */ true))
+            mempool.remove(tx, removed, true);
+    }
+    disconnectpool.clear();
+}
+
 static int64_t nTimeReadFromDisk = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
@@ -3867,6 +4906,7 @@ uint64_t nNotifiedSequence = 0;
 bool static ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const CBlock* pblock)
 {
     assert(pblock && pindexNew->pprev == chainActive.Tip());
+    TRACE2(validation, connect_block_start, pindexNew->nHeight, pindexNew->phashBlock->begin());
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros();
     int64_t nTime3;
@@ -3891,20 +4931,23 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
-    // Remove conflicting transactions from the mempool.
+    // Remove the block's transactions, their conflicts and newly expired
+    // transactions from the mempool in one maintenance pass.
     std::list<CTransaction> txConflicted;
-    mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload(chainparams.GetConsensus()));
-
-    // Remove transactions that expire at new block height from mempool
-    auto ids = mempool.removeExpired(pindexNew->nHeight);
+    std::vector<uint256> vExpiredTxIds;
+    mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, &vExpiredTxIds, !IsInitialBlockDownload(chainparams.GetConsensus()));
 
-    for (auto id : ids) {
+    for (auto id : vExpiredTxIds) {
         uiInterface.NotifyTxExpiration(id);
     }
 
     // Update chainActive & related variables.
     UpdateTip(pindexNew, chainparams);
 
+    // Keep the new block's transactions available in memory for
+    // GetTransaction; explorers typically fetch them right away.
+    AddBlockToRecentTxCache(*pblock);
+
     // Cache the conflicted transactions for subsequent notification.
     // Updates to connected wallets are triggered by ThreadNotifyWallets
     recentlyConflictedTxs.insert(std::make_pair(pindexNew, txConflicted));
@@ -3914,11 +4957,38 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5;
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
+
+    CBlockConnectTiming timing;
+    timing.nHeight = pindexNew->nHeight;
+    timing.hashBlock = pindexNew->GetBlockHash();
+    timing.nTx = pblock->vtx.size();
+    timing.nConnectUsec = lastConnectBlockPhases.nConnectUsec;
+    timing.nVerifyUsec = lastConnectBlockPhases.nVerifyUsec;
+    timing.nIndexUsec = lastConnectBlockPhases.nIndexUsec;
+    timing.nCallbacksUsec = lastConnectBlockPhases.nCallbacksUsec;
+    timing.nFlushUsec = nTime4 - nTime3;
+    timing.nChainstateUsec = nTime5 - nTime4;
+    timing.nPostConnectUsec = nTime6 - nTime5;
+    timing.nTotalUsec = nTime6 - nTime2;
+    vBlockConnectTimings.push_back(timing);
+    if (vBlockConnectTimings.size() > BLOCK_CONNECT_TIMING_WINDOW)
+        vBlockConnectTimings.pop_front();
+
+    TRACE5(validation, connect_block_end,
+           pindexNew->nHeight, pindexNew->phashBlock->begin(), pblock->vtx.size(),
+           ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION), nTime6 - nTime2);
     // Total connection time benchmarking occurs in ActivateBestChainStep.
     MetricsIncrementCounter("zcash.chain.verified.block.total");
     return true;
 }
 
+std::vector<CBlockConnectTiming> GetBlockConnectTimings(size_t nCount)
+{
+    LOCK(cs_main);
+    size_t nBegin = vBlockConnectTimings.size() > nCount ? vBlockConnectTimings.size() - nCount : 0;
+    return std::vector<CBlockConnectTiming>(vBlockConnectTimings.begin() + nBegin, vBlockConnectTimings.end());
+}
+
 std::pair<std::map<CBlockIndex*, std::list<CTransaction>>, uint64_t> DrainRecentlyConflicted()
 {
     uint64_t recentlyConflictedSequence;
@@ -4051,9 +5121,14 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
+    std::list<CTransaction> disconnectpool;
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams))
+        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+            // It's probably hopeless to try to make the mempool consistent
+            // here if DisconnectTip failed, but we can try.
+            UpdateMempoolForReorg(chainparams, disconnectpool, false);
             return false;
+        }
         fBlocksDisconnected = true;
     }
 
@@ -4101,6 +5176,7 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
                     break;
                 } else {
                     // A system error occurred (disk space, database error, ...).
+                    UpdateMempoolForReorg(chainparams, disconnectpool, false);
                     return false;
                 }
             } else {
@@ -4119,6 +5195,7 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
     }
 
     if (fBlocksDisconnected) {
+        UpdateMempoolForReorg(chainparams, disconnectpool, true);
         mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
     }
     mempool.removeWithoutBranchId(
@@ -4203,20 +5280,44 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
             int nBlockEstimate = 0;
             if (fCheckpointsEnabled)
                 nBlockEstimate = Checkpoints::GetTotalBlocksEstimate(chainparams.Checkpoints());
+            // Build a compact block announcement for peers that asked for
+            // high-bandwidth relay via sendcmpct (BIP 152); everyone else
+            // gets the usual inv.
+            bool fHaveCmpctBlock = false;
+            CBlockHeaderAndShortTxIDs cmpctblock;
+            {
+                CBlock blockNewTip;
+                if (ReadBlockFromDisk(blockNewTip, pindexNewTip, chainparams.GetConsensus())) {
+                    cmpctblock = CBlockHeaderAndShortTxIDs(blockNewTip);
+                    fHaveCmpctBlock = true;
+                }
+            }
             {
-                LOCK(cs_vNodes);
-                for (CNode* pnode : vNodes)
-                    if (nNewHeight > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                        pnode->PushBlockInventory(hashNewTip);
+                LOCK2(cs_main, cs_vNodes);
+                for (CNode* pnode : vNodes) {
+                    if (nNewHeight > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate)) {
+                        CNodeState* nodestate = State(pnode->GetId());
+                        if (fHaveCmpctBlock && nodestate != NULL && nodestate->fPreferCmpctBlocks &&
+                            pnode->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+                            // Skip peers already served by the fast relay
+                            // path before validation finished.
+                            if (pnode->hashBlockPreAnnounced != hashNewTip)
+                                pnode->PushMessage("cmpctblock", cmpctblock);
+                        } else {
+                            pnode->PushBlockInventory(hashNewTip);
+                        }
+                    }
+                }
             }
             // Notify external listeners about the new tip.
-            GetMainSignals().UpdatedBlockTip(pindexNewTip);
+            NotifyUpdatedBlockTip(pindexNewTip);
         }
     } while (pindexNewTip != pindexMostWork);
     CheckBlockIndex(chainparams.GetConsensus());
 
-    // Write changes periodically to disk, after relay.
-    if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_PERIODIC)) {
+    // Write changes periodically to disk, after relay. In standby mode the
+    // on-disk state must track the tip, so force a full flush every time.
+    if (!FlushStateToDisk(chainparams, state, fStandbyMode ? FLUSH_STATE_ALWAYS : FLUSH_STATE_PERIODIC)) {
         return false;
     }
 
@@ -4232,6 +5333,7 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     setDirtyBlockIndex.insert(pindex);
     setBlockIndexCandidates.erase(pindex);
 
+    std::list<CTransaction> disconnectpool;
     while (chainActive.Contains(pindex)) {
         CBlockIndex *pindexWalk = chainActive.Tip();
         pindexWalk->nStatus |= BLOCK_FAILED_CHILD;
@@ -4239,7 +5341,8 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
         setBlockIndexCandidates.erase(pindexWalk);
         // ActivateBestChain considers blocks already in chainActive
         // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state, chainparams)) {
+        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+            UpdateMempoolForReorg(chainparams, disconnectpool, false);
             mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
             mempool.removeWithoutBranchId(
                 CurrentEpochBranchId(chainActive.Tip()->nHeight + 1, chainparams.GetConsensus()));
@@ -4258,6 +5361,7 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     }
 
     InvalidChainFound(pindex, chainparams);
+    UpdateMempoolForReorg(chainparams, disconnectpool, true);
     mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
     mempool.removeWithoutBranchId(
         CurrentEpochBranchId(chainActive.Tip()->nHeight + 1, chainparams.GetConsensus()));
@@ -4297,6 +5401,54 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex) {
     return true;
 }
 
+bool ActivateChainstateSnapshot(const CChainParams& chainparams, const uint256& hashBase, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+
+    BlockMap::iterator mi = mapBlockIndex.find(hashBase);
+    if (mi == mapBlockIndex.end()) {
+        strError = "snapshot base block not found in block index";
+        return false;
+    }
+    CBlockIndex *pindexBase = mi->second;
+
+    // The snapshot vouches for every block up to its base in the same way a
+    // built-in checkpoint does, so mark those blocks as valid; otherwise the
+    // node would try to reconnect blocks whose data it does not have. The
+    // per-block transaction counts are unknown without the block data, so
+    // nTx/nChainTx are filled with placeholders that keep nChainTx non-zero
+    // and monotonic for the candidate-selection logic.
+    for (CBlockIndex *pindex = pindexBase; pindex != NULL; pindex = pindex->pprev) {
+        if (pindex->nTx == 0)
+            pindex->nTx = 1;
+        pindex->nChainTx = pindex->nHeight + 1;
+        if (pindex->RaiseValidity(BLOCK_VALID_SCRIPTS))
+            setDirtyBlockIndex.insert(pindex);
+    }
+
+    // Drop whatever the cache pulled in from the pre-snapshot (empty)
+    // database, then point the active chain at the base.
+    pcoinsTip->Reset();
+    if (pcoinsTip->GetBestBlock() != hashBase) {
+        strError = "chainstate best block does not match snapshot base";
+        return false;
+    }
+    chainActive.SetTip(pindexBase);
+    pindexBase->hashFinalSproutRoot = pcoinsTip->GetBestAnchor(SPROUT);
+    setBlockIndexCandidates.insert(pindexBase);
+    PruneBlockIndexCandidates();
+
+    LogPrintf("%s: new best=%s height=%d\n", __func__,
+        pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+
+    CValidationState state;
+    if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_ALWAYS)) {
+        strError = "failed to flush state to disk";
+        return false;
+    }
+    return true;
+}
+
 CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const Consensus::Params& consensusParams)
 {
     // Check for duplicate
@@ -4306,7 +5458,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const Consensus::Params&
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(block);
     assert(pindexNew);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
@@ -4460,10 +5612,18 @@ bool ReceivedBlockTransactions(
                 } else {
                     pindex->nChainOrchardValue = std::nullopt;
                 }
+                if (pindex->pprev->nChainTransparentValue && pindex->nTransparentValue) {
+                    pindex->nChainTransparentValue = *pindex->pprev->nChainTransparentValue + *pindex->nTransparentValue;
+                } else {
+                    pindex->nChainTransparentValue = std::nullopt;
+                }
             } else {
                 pindex->nChainSproutValue = pindex->nSproutValue;
                 pindex->nChainSaplingValue = pindex->nSaplingValue;
                 pindex->nChainOrchardValue = pindex->nOrchardValue;
+                // The genesis coinbase is never added to the coins view, so
+                // the transparent pool starts empty.
+                pindex->nChainTransparentValue = 0;
             }
 
             // Fall back to hardcoded Sprout value pool balance
@@ -4514,8 +5674,25 @@ bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned int nAdd
     if (nFile != nLastBlockFile) {
         if (!fKnown) {
             LogPrintf("Leaving block file %i: %s\n", nFile, vinfoBlockFile[nFile].ToString());
+            // Cut the preallocated tails off the finished file now, while
+            // cs_LastBlockFile still orders us against late undo appends,
+            // but leave the two fsyncs to a detached thread so the first
+            // write to the new file is not stalled behind the disk.
+            CDiskBlockPos posOld(nLastBlockFile, 0);
+            FILE* fileOld = OpenBlockFile(posOld);
+            if (fileOld) {
+                TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+                fclose(fileOld);
+            }
+            fileOld = OpenUndoFile(posOld);
+            if (fileOld) {
+                TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
+                fclose(fileOld);
+            }
+            boost::thread(boost::bind(&BackgroundSyncBlockFile, nLastBlockFile)).detach();
+        } else {
+            FlushBlockFile();
         }
-        FlushBlockFile(!fKnown);
         nLastBlockFile = nFile;
     }
 
@@ -4526,16 +5703,16 @@ bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned int nAdd
         vinfoBlockFile[nFile].nSize += nAddSize;
 
     if (!fKnown) {
-        unsigned int nOldChunks = (pos.nPos + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
-        unsigned int nNewChunks = (vinfoBlockFile[nFile].nSize + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
+        unsigned int nOldChunks = (pos.nPos + nBlockfileChunkSize - 1) / nBlockfileChunkSize;
+        unsigned int nNewChunks = (vinfoBlockFile[nFile].nSize + nBlockfileChunkSize - 1) / nBlockfileChunkSize;
         if (nNewChunks > nOldChunks) {
             if (fPruneMode)
                 fCheckForPruning = true;
-            if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos)) {
+            if (CheckDiskSpace(nNewChunks * nBlockfileChunkSize - pos.nPos)) {
                 FILE *file = OpenBlockFile(pos);
                 if (file) {
-                    LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * BLOCKFILE_CHUNK_SIZE, pos.nFile);
-                    AllocateFileRange(file, pos.nPos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos);
+                    LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * nBlockfileChunkSize, pos.nFile);
+                    AllocateFileRange(file, pos.nPos, nNewChunks * nBlockfileChunkSize - pos.nPos);
                     fclose(file);
                 }
             }
@@ -4559,16 +5736,16 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     nNewSize = vinfoBlockFile[nFile].nUndoSize += nAddSize;
     setDirtyFileInfo.insert(nFile);
 
-    unsigned int nOldChunks = (pos.nPos + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
-    unsigned int nNewChunks = (nNewSize + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
+    unsigned int nOldChunks = (pos.nPos + nUndofileChunkSize - 1) / nUndofileChunkSize;
+    unsigned int nNewChunks = (nNewSize + nUndofileChunkSize - 1) / nUndofileChunkSize;
     if (nNewChunks > nOldChunks) {
         if (fPruneMode)
             fCheckForPruning = true;
-        if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos)) {
+        if (CheckDiskSpace(nNewChunks * nUndofileChunkSize - pos.nPos)) {
             FILE *file = OpenUndoFile(pos);
             if (file) {
-                LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * UNDOFILE_CHUNK_SIZE, pos.nFile);
-                AllocateFileRange(file, pos.nPos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos);
+                LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * nUndofileChunkSize, pos.nFile);
+                AllocateFileRange(file, pos.nPos, nNewChunks * nUndofileChunkSize - pos.nPos);
                 fclose(file);
             }
         }
@@ -4591,7 +5768,7 @@ bool CheckBlockHeader(
                          REJECT_INVALID, "version-too-low");
 
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, chainparams.GetConsensus()))
+    if (fCheckPOW && !CheckProofOfWork(GetPoWHashCached(block), block.nBits, chainparams.GetConsensus()))
         return state.DoS(50, error("CheckBlockHeader(): proof of work failed"),
                          REJECT_INVALID, "high-hash");
 
@@ -4614,6 +5791,23 @@ bool CheckBlock(const CBlock& block,
     if (!CheckBlockHeader(block, state, chainparams, fCheckPOW))
         return false;
 
+    // The per-transaction sanity checks are independent of each other, so
+    // when worker threads are available dispatch them to the shared
+    // validation pool now and overlap them with the merkle root computation
+    // below; the results are not acted on until the structural checks have
+    // passed.
+    bool fParallelTxChecks =
+        fCheckTransactions && nScriptCheckThreads && block.vtx.size() > 1;
+    CCheckQueueControl<CBlockTxCheck> txcontrol(
+        fParallelTxChecks ? &blocktxcheckqueue : NULL);
+    if (fParallelTxChecks) {
+        std::vector<CBlockTxCheck> vTxChecks;
+        vTxChecks.reserve(block.vtx.size());
+        for (const CTransaction& tx : block.vtx)
+            vTxChecks.emplace_back(tx, verifier);
+        txcontrol.Add(vTxChecks);
+    }
+
     // Check the merkle root.
     if (fCheckMerkleRoot) {
         bool mutated;
@@ -4652,11 +5846,30 @@ bool CheckBlock(const CBlock& block,
     if (!fCheckTransactions) return true;
 
     // Check transactions
-    for (const CTransaction& tx : block.vtx)
-        if (!CheckTransaction(tx, state, verifier, orchardAuth))
-            return error("CheckBlock(): CheckTransaction of %s failed with %s",
-                tx.GetHash().ToString(),
-                FormatStateMessage(state));
+    if (fParallelTxChecks) {
+        if (!txcontrol.Wait()) {
+            // Rare failure path: rerun serially so the precise rejection
+            // reason and DoS level land in state exactly as before.
+            auto disabledAuth = orchard::AuthValidator::Disabled();
+            for (const CTransaction& tx : block.vtx)
+                if (!CheckTransaction(tx, state, verifier, disabledAuth))
+                    return error("CheckBlock(): CheckTransaction of %s failed with %s",
+                        tx.GetHash().ToString(),
+                        FormatStateMessage(state));
+            return state.DoS(100, error("CheckBlock(): parallel transaction check failed"),
+                             REJECT_INVALID, "bad-txns-check-failed");
+        }
+        // The workers ran with a disabled Orchard validator (signature
+        // batching is not thread-safe), so queue the signatures here.
+        for (const CTransaction& tx : block.vtx)
+            tx.GetOrchardBundle().QueueSignatureValidation(orchardAuth, tx.GetHash());
+    } else {
+        for (const CTransaction& tx : block.vtx)
+            if (!CheckTransaction(tx, state, verifier, orchardAuth))
+                return error("CheckBlock(): CheckTransaction of %s failed with %s",
+                    tx.GetHash().ToString(),
+                    FormatStateMessage(state));
+    }
 
     unsigned int nSigOps = 0;
     for (const CTransaction& tx : block.vtx)
@@ -4745,11 +5958,17 @@ bool ContextualCheckBlock(
     const Consensus::Params& consensusParams = chainparams.GetConsensus();
 
     if (fCheckTransactions) {
+        // Batch-validate the Sapling Groth16 proofs and the Sprout
+        // joinSplitSigs across the whole block; this is much cheaper than
+        // verifying each proof and signature individually.
+        sapling::BatchValidator saplingAuth;
+        ed25519::BatchVerifier ed25519Auth;
+
         // Check that all transactions are finalized
         for (const CTransaction& tx : block.vtx) {
 
             // Check transaction contextually against consensus rules at block height
-            if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true)) {
+            if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true, IsInitialBlockDownload, &saplingAuth, &ed25519Auth)) {
                 return false; // Failure reason has been set in validation state object
             }
 
@@ -4762,6 +5981,22 @@ bool ContextualCheckBlock(
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
         }
+
+        // Ensure the batched Sapling proofs are valid. We cannot tell which
+        // transaction contained the invalid proof, but the block is rejected
+        // either way.
+        if (!saplingAuth.Validate()) {
+            return state.DoS(100,
+                error("%s: a Sapling proof within the block is invalid", __func__),
+                REJECT_INVALID, "bad-txns-sapling-proof-invalid");
+        }
+
+        // Likewise for the batched joinSplitSigs.
+        if (!ed25519Auth.Validate()) {
+            return state.DoS(100,
+                error("%s: a joinsplit signature within the block is invalid", __func__),
+                REJECT_INVALID, "bad-txns-invalid-joinsplit-signature");
+        }
     }
 
     // Enforce BIP 34 rule that the coinbase starts with serialized block height.
@@ -4849,6 +6084,38 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+/** Accept any orphan headers that were waiting on hashParent, walking the
+ *  stored descendant chains breadth-first through the parent-hash index. */
+static void ProcessOrphanHeaders(const uint256& hashParent, const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::deque<uint256> queue;
+    queue.push_back(hashParent);
+    while (!queue.empty()) {
+        uint256 hashPrev = queue.front();
+        queue.pop_front();
+
+        // Collect the waiting hashes first; accepting a header mutates the
+        // index we are iterating.
+        std::vector<uint256> vWaiting;
+        auto range = mapOrphanHeadersByPrev.equal_range(hashPrev);
+        for (auto it = range.first; it != range.second; ++it)
+            vWaiting.push_back(it->second);
+
+        for (const uint256& hash : vWaiting) {
+            std::map<uint256, COrphanHeader>::iterator it = mapOrphanHeaders.find(hash);
+            if (it == mapOrphanHeaders.end())
+                continue;
+            CBlockHeader header = it->second.header;
+            EraseOrphanHeader(hash);
+            CValidationState state;
+            if (AcceptBlockHeader(header, state, chainparams)) {
+                LogPrint("net", "connected orphan header %s\n", hash.ToString());
+                queue.push_back(hash);
+            }
+        }
+    }
+}
+
 /**
  * Store block on disk.
  * If dbp is non-NULL, the file is known to already reside on disk.
@@ -4907,13 +6174,20 @@ static bool AcceptBlock(const CBlock& block, CValidationState& state, const CCha
     // Write block to history file
     try {
         unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        // Compress before FindBlockPos so the file space allotted matches
+        // what actually gets written; vchCompressed stays empty (and the
+        // block is stored raw) when compression does not pay.
+        std::vector<unsigned char> vchCompressed;
+        if (dbp == NULL && GetBoolArg("-blockcompress", DEFAULT_BLOCKCOMPRESS))
+            CompressBlockForDisk(block, vchCompressed);
+        unsigned int nRecordSize = vchCompressed.empty() ? nBlockSize : vchCompressed.size();
         CDiskBlockPos blockPos;
         if (dbp != NULL)
             blockPos = *dbp;
-        if (!FindBlockPos(state, blockPos, nBlockSize+8, nHeight, block.GetBlockTime(), dbp != NULL))
+        if (!FindBlockPos(state, blockPos, nRecordSize+8, nHeight, block.GetBlockTime(), dbp != NULL))
             return error("AcceptBlock(): FindBlockPos failed");
         if (dbp == NULL)
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart(), &vchCompressed))
                 AbortNode(state, "Failed to write block");
         if (!ReceivedBlockTransactions(block, state, chainparams, pindex, blockPos))
             return error("AcceptBlock(): ReceivedBlockTransactions failed");
@@ -4940,30 +6214,86 @@ static bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned
 }
 
 
+/**
+ * Optimistically announce a tip-extending block to peers that asked for
+ * high-bandwidth compact block relay (BIP 152), before ConnectBlock has run,
+ * so our validation time no longer adds to network-wide propagation delay.
+ * Only called for blocks whose header, proof of work and merkle root already
+ * passed AcceptBlock, so a bogus announcement costs its producer a valid
+ * proof of work, and the receiving peers validate the block themselves
+ * before relaying it further. Returns whether any peer was told.
+ */
+static bool PreAnnounceBlock(const CBlock& block, const CNode* pfrom)
+{
+    AssertLockHeld(cs_main);
+    CBlockHeaderAndShortTxIDs cmpctblock(block);
+    const uint256 hash = block.GetHash();
+    bool fAnnounced = false;
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        if (pnode == pfrom)
+            continue;
+        CNodeState* nodestate = State(pnode->GetId());
+        if (nodestate == NULL || !nodestate->fPreferCmpctBlocks ||
+            pnode->nVersion < SHORT_IDS_BLOCKS_VERSION)
+            continue;
+        pnode->PushMessage("cmpctblock", cmpctblock);
+        pnode->hashBlockPreAnnounced = hash;
+        fAnnounced = true;
+    }
+    return fAnnounced;
+}
+
 bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp)
 {
     auto span = TracingSpan("info", "main", "ProcessNewBlock");
     auto spanGuard = span.Enter();
 
+    const uint256 hash = pblock->GetHash();
+    bool fPreAnnounced = false;
     {
         LOCK(cs_main);
-        bool fRequested = MarkBlockAsReceived(pblock->GetHash()) | fForceProcessing;
+        bool fRequested = MarkBlockAsReceived(hash) | fForceProcessing;
 
         // Store to disk
         CBlockIndex *pindex = NULL;
         bool ret = AcceptBlock(*pblock, state, chainparams, &pindex, fRequested, dbp);
         if (pindex && pfrom) {
-            mapBlockSource[pindex->GetBlockHash()] = pfrom->GetId();
+            mapBlockSource.insert(pindex->GetBlockHash(), pfrom->GetId());
         }
         CheckBlockIndex(chainparams.GetConsensus());
         if (!ret)
             return error("%s: AcceptBlock FAILED", __func__);
+
+        // Fast relay path: the block extends our tip and its cheap checks
+        // passed, so announce it now rather than after ConnectBlock. Limit
+        // the shortcut to blocks we mined ourselves and blocks from peers
+        // with a clean ban score.
+        if (pindex && pindex->pprev == chainActive.Tip() &&
+            !IsInitialBlockDownload(chainparams.GetConsensus())) {
+            CNodeState* sourcestate = pfrom ? State(pfrom->GetId()) : NULL;
+            if (pfrom == NULL || (sourcestate && sourcestate->nMisbehavior == 0))
+                fPreAnnounced = PreAnnounceBlock(*pblock, pfrom);
+        }
     }
 
     NotifyHeaderTip(chainparams.GetConsensus());
 
-    if (!ActivateBestChain(state, chainparams, pblock))
+    if (!ActivateBestChain(state, chainparams, pblock)) {
+        int nDoS;
+        if (fPreAnnounced && state.IsInvalid(nDoS)) {
+            // Follow up the optimistic announcement with a reject so the
+            // peers we told need not discover the failure on their own; they
+            // validate independently either way.
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes) {
+                if (pnode->hashBlockPreAnnounced == hash)
+                    pnode->PushMessage("reject", std::string("block"), (unsigned char)state.GetRejectCode(),
+                                       state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), hash);
+            }
+        }
         return error("%s: ActivateBestChain failed", __func__);
+    }
 
     return true;
 }
@@ -5069,12 +6399,12 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight
         return;
     }
 
-    unsigned int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP;
+    unsigned int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - nPruneBlocksToKeep;
     uint64_t nCurrentUsage = CalculateCurrentUsage();
     // We don't check to prune until after we've allocated new space for files
     // So we should leave a buffer under our target to account for another allocation
     // before the next pruning.
-    uint64_t nBuffer = BLOCKFILE_CHUNK_SIZE + UNDOFILE_CHUNK_SIZE;
+    uint64_t nBuffer = nBlockfileChunkSize + nUndofileChunkSize;
     uint64_t nBytesToPrune;
     int count=0;
 
@@ -5088,7 +6418,7 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight
             if (nCurrentUsage + nBuffer < nPruneTarget)  // are we below our target?
                 break;
 
-            // don't prune files that could have a block within MIN_BLOCKS_TO_KEEP of the main chain's tip but keep scanning
+            // don't prune files that could have a block within nPruneBlocksToKeep of the main chain's tip but keep scanning
             if (vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
                 continue;
 
@@ -5164,9 +6494,8 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex(): new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
+    assert(pindexNew);
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -5212,11 +6541,17 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
                     } else {
                         pindex->nChainOrchardValue = std::nullopt;
                     }
+                    if (pindex->pprev->nChainTransparentValue && pindex->nTransparentValue) {
+                        pindex->nChainTransparentValue = *pindex->pprev->nChainTransparentValue + *pindex->nTransparentValue;
+                    } else {
+                        pindex->nChainTransparentValue = std::nullopt;
+                    }
                 } else {
                     pindex->nChainTx = 0;
                     pindex->nChainSproutValue = std::nullopt;
                     pindex->nChainSaplingValue = std::nullopt;
                     pindex->nChainOrchardValue = std::nullopt;
+                    pindex->nChainTransparentValue = std::nullopt;
                     mapBlocksUnlinked.insert(std::make_pair(pindex->pprev, pindex));
                 }
             } else {
@@ -5224,6 +6559,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
                 pindex->nChainSproutValue = pindex->nSproutValue;
                 pindex->nChainSaplingValue = pindex->nSaplingValue;
                 pindex->nChainOrchardValue = pindex->nOrchardValue;
+                // The genesis coinbase is never added to the coins view, so
+                // the transparent pool starts empty.
+                pindex->nChainTransparentValue = 0;
             }
 
             // Fall back to hardcoded Sprout value pool balance
@@ -5316,6 +6654,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     bool fLightWalletd = false;
     pblocktree->ReadFlag("insightexplorer", fInsightExplorer);
     pblocktree->ReadFlag("lightwalletd", fLightWalletd);
+    pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
     LogPrintf("%s: insight explorer %s\n", __func__, fInsightExplorer ? "enabled" : "disabled");
     LogPrintf("%s: light wallet daemon %s\n", __func__, fLightWalletd ? "enabled" : "disabled");
     if (fInsightExplorer) {
@@ -5361,6 +6700,64 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     return true;
 }
 
+/**
+ * Closure representing the order-independent startup checks (levels 1 and 2)
+ * for one block in CVerifyDB::VerifyDB. These only read the block and its
+ * undo data, so they can run on CCheckQueue workers while the main thread
+ * keeps streaming blocks off disk; failures are logged here and surface as a
+ * false result from the queue.
+ */
+class CVerifyDBBlockCheck
+{
+private:
+    std::shared_ptr<const CBlock> pblock;
+    const CBlockIndex* pindex;
+    const CChainParams* chainparams;
+    bool fCheckTransactions;
+    int nCheckLevel;
+
+public:
+    CVerifyDBBlockCheck() : pblock(), pindex(NULL), chainparams(NULL), fCheckTransactions(false), nCheckLevel(0) {}
+    CVerifyDBBlockCheck(std::shared_ptr<const CBlock> pblockIn, const CBlockIndex* pindexIn, const CChainParams& chainparamsIn, bool fCheckTransactionsIn, int nCheckLevelIn) :
+        pblock(std::move(pblockIn)), pindex(pindexIn), chainparams(&chainparamsIn), fCheckTransactions(fCheckTransactionsIn), nCheckLevel(nCheckLevelIn) {}
+
+    bool operator()()
+    {
+        auto verifier = ProofVerifier::Disabled(); // No need to verify JoinSplits twice
+        // Each check carries its own Orchard batch: sharing one across worker
+        // threads is not safe, and a block's worth of signatures is still a
+        // useful batch.
+        auto orchardAuth = orchard::AuthValidator::Batch();
+        CValidationState state;
+
+        // check level 1: verify block validity
+        if (!CheckBlock(*pblock, state, *chainparams, verifier, orchardAuth, true, true, fCheckTransactions))
+            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+        if (!orchardAuth.Validate())
+            return error("VerifyDB(): *** found bad Orchard authorizations at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+
+        // check level 2: verify undo validity
+        if (nCheckLevel >= 2) {
+            CBlockUndo undo;
+            CDiskBlockPos pos = pindex->GetUndoPos();
+            if (!pos.IsNull()) {
+                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
+                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+            }
+        }
+        return true;
+    }
+
+    void swap(CVerifyDBBlockCheck& check)
+    {
+        std::swap(pblock, check.pblock);
+        std::swap(pindex, check.pindex);
+        std::swap(chainparams, check.chainparams);
+        std::swap(fCheckTransactions, check.fCheckTransactions);
+        std::swap(nCheckLevel, check.nCheckLevel);
+    }
+};
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -5390,12 +6787,38 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     int nGoodTransactions = 0;
     CValidationState state;
 
-    // Flags used to permit skipping checks for efficiency
-    auto verifier = ProofVerifier::Disabled(); // No need to verify JoinSplits twice
-    bool fCheckTransactions = true;
-    // We may as well check Orchard authorizations if we are checking
-    // transactions, since we can batch-validate them.
-    auto orchardAuth = orchard::AuthValidator::Batch();
+    // The level 1 and 2 checks are independent per block, so they are farmed
+    // out to a worker pool while this thread keeps reading blocks off disk
+    // and running the order-dependent level 3 disconnects. Pending checks are
+    // flushed in bounded batches so the blocks held in flight stay bounded
+    // regardless of -checkblocks. The workers are wound down on every exit
+    // path by the guard below; this thread drains any queued work first via
+    // CCheckQueueControl.
+    CCheckQueue<CVerifyDBBlockCheck> verifyblockqueue(4);
+    boost::thread_group verifyThreadGroup;
+    struct WorkerGuard {
+        boost::thread_group& group;
+        ~WorkerGuard() { group.interrupt_all(); group.join_all(); }
+    } workerGuard{verifyThreadGroup};
+    if (nCheckLevel >= 1) {
+        int nWorkers = std::min<int>((nScriptCheckThreads > 1 ? nScriptCheckThreads : GetNumCores()) - 1, MAX_CHECKQUEUE_WORKERS - 1);
+        for (int i = 0; i < nWorkers; i++) {
+            verifyThreadGroup.create_thread([&verifyblockqueue]() {
+                RenameThread("koto-verifydb");
+                verifyblockqueue.Thread();
+            });
+        }
+    }
+    std::vector<CVerifyDBBlockCheck> vBlockChecks;
+    static const unsigned int VERIFYDB_FLUSH_INTERVAL = 64;
+    auto FlushBlockChecks = [&verifyblockqueue, &vBlockChecks]() {
+        if (vBlockChecks.empty())
+            return true;
+        CCheckQueueControl<CVerifyDBBlockCheck> control(&verifyblockqueue);
+        control.Add(vBlockChecks);
+        vBlockChecks.clear();
+        return control.Wait();
+    };
 
     for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
     {
@@ -5404,30 +6827,23 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
 
-        CBlock block;
+        auto pblock = std::make_shared<CBlock>();
         // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+        if (!ReadBlockFromDisk(*pblock, pindex, chainparams.GetConsensus()))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
 
-        // check level 1: verify block validity
-        fCheckTransactions = ShouldCheckTransactions(chainparams, pindex);
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams, verifier, orchardAuth, true, true, fCheckTransactions))
-            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
+        // check levels 1-2: queue block and undo validity checks for the workers
+        if (nCheckLevel >= 1) {
+            bool fCheckTransactions = ShouldCheckTransactions(chainparams, pindex);
+            vBlockChecks.emplace_back(pblock, pindex, chainparams, fCheckTransactions, nCheckLevel);
+            if (vBlockChecks.size() >= VERIFYDB_FLUSH_INTERVAL && !FlushBlockChecks())
+                return error("VerifyDB(): *** block verification failed (see preceding errors)");
         }
 
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             // insightexplorer: do not update indices (false)
-            DisconnectResult res = DisconnectBlock(block, state, pindex, coins, chainparams, false);
+            DisconnectResult res = DisconnectBlock(*pblock, state, pindex, coins, chainparams, false);
             if (res == DISCONNECT_FAILED) {
                 return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
@@ -5436,13 +6852,15 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
                 nGoodTransactions = 0;
                 pindexFailure = pindex;
             } else {
-                nGoodTransactions += block.vtx.size();
+                nGoodTransactions += pblock->vtx.size();
             }
         }
 
         if (ShutdownRequested())
             return true;
     }
+    if (!FlushBlockChecks())
+        return error("VerifyDB(): *** block verification failed (see preceding errors)");
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
 
@@ -5556,7 +6974,7 @@ bool RewindBlockIndex(const CChainParams& chainparams, bool& clearWitnessCaches)
             // of the blockchain).
             break;
         }
-        if (!DisconnectTip(state, chainparams, true)) {
+        if (!DisconnectTip(state, chainparams)) {
             return error("RewindBlockIndex: unable to disconnect block at height %i", pindex->nHeight);
         }
         // Occasionally flush state to disk.
@@ -5659,10 +7077,8 @@ void UnloadBlockIndex()
     mapNodeState.clear();
     recentRejects.reset(NULL);
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -5692,6 +7108,9 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -insightexplorer or -lightwalletd in the new database
     pblocktree->WriteFlag("insightexplorer", fExperimentalInsightExplorer);
     pblocktree->WriteFlag("lightwalletd", fExperimentalLightWalletd);
+    // A fresh database maintains the running address balances from genesis
+    pblocktree->WriteFlag("addressbalanceindex", true);
+    fAddressBalanceIndex = true;
     if (fExperimentalInsightExplorer) {
         fAddressIndex = true;
         fSpentIndex = true;
@@ -5736,48 +7155,179 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    // One parsed block travelling through the import pipeline below.
+    struct ImportedBlock {
+        uint64_t nSequence;
+        CBlock block;
+        uint64_t nBlockPos;
+        uint64_t nRewind; //!< file position after this block, for progress accounting
+    };
+
     int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
         size_t initialSize = nSizeReindexed;
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
 
-            if (fReindex)
-               nSizeReindexed = initialSize + nRewind;
-
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
+        // Import runs as a three stage pipeline so that disk reads, PoW
+        // hashing and block acceptance overlap: a reader thread scans the
+        // file and deserializes blocks, a pool of workers precomputes each
+        // block's yespower hash (filling the cache that CheckBlockHeader
+        // consults), and this thread hands blocks to AcceptBlock strictly in
+        // file order. The bounded queue keeps the reader at most
+        // IMPORT_READAHEAD blocks ahead of validation.
+        static const size_t IMPORT_READAHEAD = 16;
+        std::mutex importMutex;
+        std::condition_variable condParsed;   // the parse queue gained an item or freed a slot
+        std::condition_variable condChecked;  // a worker delivered a checked block
+        std::deque<ImportedBlock> parseQueue;
+        std::map<uint64_t, ImportedBlock> mapChecked;
+        uint64_t nSequenceParsed = 0;
+        bool fParseDone = false;
+        bool fAbort = false;
+
+        boost::thread threadReader([&]() {
+            uint64_t nRewind = blkdat.GetPos();
             try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+                while (!blkdat.eof()) {
+                    {
+                        std::unique_lock<std::mutex> lock(importMutex);
+                        if (fAbort)
+                            break;
+                    }
+                    blkdat.SetPos(nRewind);
+                    nRewind++; // start one byte further next time, in case of failure
+                    blkdat.SetLimit(); // remove former limit
+                    unsigned int nSize = 0;
+                    bool fCompressed = false;
+                    try {
+                        // locate a header; compressed records (-blockcompress)
+                        // share the magic's first byte, so one scan finds both
+                        unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                        CMessageHeader::MessageStartChars compressedStart;
+                        CompressedMessageStart(chainparams.MessageStart(), compressedStart);
+                        blkdat.FindByte(chainparams.MessageStart()[0]);
+                        nRewind = blkdat.GetPos()+1;
+                        blkdat >> FLATDATA(buf);
+                        if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE)) {
+                            if (memcmp(buf, compressedStart, CMessageHeader::MESSAGE_START_SIZE))
+                                continue;
+                            fCompressed = true;
+                        }
+                        // read size (of the compressed payload, for compressed records)
+                        blkdat >> nSize;
+                        if (fCompressed ? (nSize == 0 || nSize > MAX_BLOCK_SIZE)
+                                        : (nSize < 80 || nSize > MAX_BLOCK_SIZE))
+                            continue;
+                    } catch (const std::exception&) {
+                        // no valid block header found; don't complain
+                        break;
+                    }
+                    try {
+                        // read block
+                        uint64_t nBlockPos = blkdat.GetPos();
+                        blkdat.SetLimit(nBlockPos + nSize);
+                        blkdat.SetPos(nBlockPos);
+                        ImportedBlock item;
+                        item.nSequence = nSequenceParsed;
+                        item.nBlockPos = nBlockPos;
+                        if (fCompressed) {
+                            std::vector<unsigned char> vchCompressed(nSize);
+                            std::vector<unsigned char> vchRaw;
+                            blkdat.read((char*)vchCompressed.data(), nSize);
+                            if (!DecompressBlockData(vchCompressed, vchRaw, MAX_BLOCK_SIZE))
+                                throw std::runtime_error("corrupt compressed block record");
+                            CDataStream ssBlock(vchRaw, SER_DISK, CLIENT_VERSION);
+                            ssBlock >> item.block;
+                        } else {
+                            blkdat >> item.block;
+                        }
+                        nRewind = blkdat.GetPos();
+                        item.nRewind = nRewind;
+
+                        std::unique_lock<std::mutex> lock(importMutex);
+                        condParsed.wait(lock, [&]() { return parseQueue.size() < IMPORT_READAHEAD || fAbort; });
+                        if (fAbort)
+                            break;
+                        parseQueue.push_back(std::move(item));
+                        nSequenceParsed++;
+                        condParsed.notify_all();
+                    } catch (const std::exception& e) {
+                        LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                    }
+                }
+            } catch (const std::exception& e) {
+                LogPrintf("%s: reader error - %s\n", __func__, e.what());
+            }
+            std::unique_lock<std::mutex> lock(importMutex);
+            fParseDone = true;
+            condParsed.notify_all();
+            condChecked.notify_all();
+        });
+
+        boost::thread_group powWorkers;
+        int nWorkers = std::max(1, GetNumCores() - 1);
+        for (int i = 0; i < nWorkers; i++) {
+            powWorkers.create_thread([&]() {
+                while (true) {
+                    ImportedBlock item;
+                    {
+                        std::unique_lock<std::mutex> lock(importMutex);
+                        condParsed.wait(lock, [&]() { return !parseQueue.empty() || fParseDone || fAbort; });
+                        if (fAbort || (parseQueue.empty() && fParseDone))
+                            break;
+                        if (parseQueue.empty())
+                            continue;
+                        item = std::move(parseQueue.front());
+                        parseQueue.pop_front();
+                        condParsed.notify_all(); // a slot freed up; wake the reader
+                    }
+                    // Warm the PoW hash cache so AcceptBlock below never pays
+                    // for yespower under cs_main.
+                    GetPoWHashCached(item.block);
+                    std::unique_lock<std::mutex> lock(importMutex);
+                    mapChecked.emplace(item.nSequence, std::move(item));
+                    condChecked.notify_all();
+                }
+            });
+        }
+
+        auto shutdownPipeline = [&]() {
+            {
+                std::unique_lock<std::mutex> lock(importMutex);
+                fAbort = true;
             }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
+            condParsed.notify_all();
+            condChecked.notify_all();
+            threadReader.join();
+            powWorkers.join_all();
+        };
+
+        try {
+            uint64_t nSequenceNext = 0;
+            while (true) {
+                boost::this_thread::interruption_point();
+
+                ImportedBlock item;
+                {
+                    std::unique_lock<std::mutex> lock(importMutex);
+                    condChecked.wait(lock, [&]() {
+                        return mapChecked.count(nSequenceNext) != 0 ||
+                               (fParseDone && nSequenceNext >= nSequenceParsed);
+                    });
+                    std::map<uint64_t, ImportedBlock>::iterator it = mapChecked.find(nSequenceNext);
+                    if (it == mapChecked.end())
+                        break; // the pipeline has drained
+                    item = std::move(it->second);
+                    mapChecked.erase(it);
+                    nSequenceNext++;
+                }
+
+                if (fReindex)
+                    nSizeReindexed = initialSize + item.nRewind;
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+                    dbp->nPos = item.nBlockPos;
+                CBlock& block = item.block;
 
                 // detect out of order blocks, and store them for later
                 uint256 hash = block.GetHash();
@@ -5835,10 +7385,12 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                         NotifyHeaderTip(chainparams.GetConsensus());
                     }
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+        } catch (...) {
+            shutdownPipeline();
+            throw;
         }
+        shutdownPipeline();
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -5847,31 +7399,274 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     return nLoaded > 0;
 }
 
-void static CheckBlockIndex(const Consensus::Params& consensusParams)
+/** Rebuild the insightexplorer index entries for one block from its block
+ *  and undo files, producing the same entries ConnectBlock would have queued.
+ *  Used by ThreadIndexWriter to catch the indexes up to the active chain. */
+static bool ReplayInsightIndexes(const CChainParams& chainparams, CBlockIndex* pindex)
 {
-    if (!fCheckBlockIndex) {
-        return;
-    }
-
-    LOCK(cs_main);
-
-    // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
-    // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
-    // iterating the block tree require that chainActive has been initialized.)
-    if (chainActive.Height() < 0) {
-        assert(mapBlockIndex.size() <= 1);
-        return;
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+        return error("%s: failure reading block %s", __func__, pindex->GetBlockHash().ToString());
+    CBlockUndo blockUndo;
+    if (pindex->pprev) {
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (pos.IsNull())
+            return error("%s: no undo data for %s", __func__, pindex->GetBlockHash().ToString());
+        if (!UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash()))
+            return error("%s: failure reading undo data for %s", __func__, pindex->GetBlockHash().ToString());
+        if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+            return error("%s: block and undo data inconsistent for %s", __func__, pindex->GetBlockHash().ToString());
     }
 
-    // Build forward-pointing map of the entire block tree.
-    std::multimap<CBlockIndex*,CBlockIndex*> forward;
-    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); it++) {
-        forward.insert(std::make_pair(it->second->pprev, it->second));
-    }
+    std::vector<CAddressIndexDbEntry> addressIndex;
+    std::vector<CAddressUnspentDbEntry> addressUnspentIndex;
+    std::vector<CSpentIndexDbEntry> spentIndex;
 
-    assert(forward.size() == mapBlockIndex.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        const uint256 hash = tx.GetHash();
 
-    std::pair<std::multimap<CBlockIndex*,CBlockIndex*>::iterator,std::multimap<CBlockIndex*,CBlockIndex*>::iterator> rangeGenesis = forward.equal_range(NULL);
+        // Spending activity, with the spent outputs taken from the undo data.
+        if (i > 0 && (fAddressIndex || fSpentIndex)) {
+            const CTxUndo& txundo = blockUndo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const CTxIn input = tx.vin[j];
+                const CTxOut& prevout = txundo.vprevout[j].txout;
+                CScript::ScriptType scriptType = prevout.scriptPubKey.GetType();
+                const uint160 addrHash = prevout.scriptPubKey.AddressHash();
+                if (fAddressIndex && scriptType != CScript::UNKNOWN) {
+                    addressIndex.push_back(make_pair(
+                        CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, j, true),
+                        prevout.nValue * -1));
+                    addressUnspentIndex.push_back(make_pair(
+                        CAddressUnspentKey(scriptType, addrHash, input.prevout.hash, input.prevout.n),
+                        CAddressUnspentValue()));
+                }
+                if (fSpentIndex) {
+                    spentIndex.push_back(make_pair(
+                        CSpentIndexKey(input.prevout.hash, input.prevout.n),
+                        CSpentIndexValue(hash, j, pindex->nHeight, prevout.nValue, scriptType, addrHash)));
+                }
+            }
+        }
+
+        // Receiving activity.
+        if (fAddressIndex) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                CScript::ScriptType scriptType = out.scriptPubKey.GetType();
+                if (scriptType != CScript::UNKNOWN) {
+                    uint160 const addrHash = out.scriptPubKey.AddressHash();
+                    addressIndex.push_back(make_pair(
+                        CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, k, false),
+                        out.nValue));
+                    addressUnspentIndex.push_back(make_pair(
+                        CAddressUnspentKey(scriptType, addrHash, hash, k),
+                        CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+                }
+            }
+        }
+    }
+
+    if (fAddressIndex) {
+        if (!pblocktree->WriteAddressIndex(addressIndex) ||
+            !pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex) ||
+            !pblocktree->UpdateAddressBalances(addressIndex, false))
+            return false;
+    }
+    if (fSpentIndex) {
+        if (!pblocktree->UpdateSpentIndex(spentIndex))
+            return false;
+    }
+    if (fTimestampIndex) {
+        unsigned int logicalTS = pindex->nTime;
+        unsigned int prevLogicalTS = 0;
+        if (pindex->pprev)
+            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
+                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
+        if (logicalTS <= prevLogicalTS)
+            logicalTS = prevLogicalTS + 1;
+        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())) ||
+            !pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
+            return false;
+    }
+    return pblocktree->WriteInsightBestBlock(pindex->GetBlockHash());
+}
+
+/** Collect the stretch of the active chain above the recorded progress
+ *  marker, oldest first. Requires cs_main. */
+static std::vector<CBlockIndex*> CollectBlocksAboveMarker(const uint256& hashMarker)
+{
+    AssertLockHeld(cs_main);
+    std::vector<CBlockIndex*> vToIndex;
+    CBlockIndex* pindexLast = NULL;
+    BlockMap::iterator it = mapBlockIndex.find(hashMarker);
+    if (it != mapBlockIndex.end())
+        pindexLast = it->second;
+    const CBlockIndex* pfork = pindexLast ? chainActive.FindFork(pindexLast) : NULL;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex != pfork; pindex = pindex->pprev)
+        vToIndex.push_back(pindex);
+    std::reverse(vToIndex.begin(), vToIndex.end());
+    return vToIndex;
+}
+
+void ThreadIndexWriter(const CChainParams& chainparams)
+{
+    RenameThread("koto-indexer");
+    const bool fInsight = fAddressIndex || fSpentIndex || fTimestampIndex;
+
+    try {
+        // Catch-up phase: index whatever stretch of the active chain the
+        // progress markers do not cover, reading straight from the block and
+        // undo files. This is how the transaction index rebuilds after being
+        // enabled on an already-synced node, and how all the indexes recover
+        // entries lost to a crash between a block connecting and its queued
+        // index writes committing.
+        if (fTxIndex) {
+            uint256 hashBestIndexed;
+            if (!pblocktree->ReadTxIndexBestBlock(hashBestIndexed)) {
+                // Databases from before the marker existed wrote the index
+                // synchronously in ConnectBlock, so they are current up to the tip.
+                LOCK(cs_main);
+                if (chainActive.Tip()) {
+                    hashBestIndexed = chainActive.Tip()->GetBlockHash();
+                    pblocktree->WriteTxIndexBestBlock(hashBestIndexed);
+                }
+            }
+            std::vector<CBlockIndex*> vToIndex;
+            {
+                LOCK(cs_main);
+                vToIndex = CollectBlocksAboveMarker(hashBestIndexed);
+            }
+            if (!vToIndex.empty()) {
+                LogPrintf("%s: transaction index catching up %u blocks\n", __func__, vToIndex.size());
+                for (CBlockIndex* pindex : vToIndex) {
+                    boost::this_thread::interruption_point();
+                    CBlock block;
+                    if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus())) {
+                        AbortNode("Failed to read block for transaction index");
+                        return;
+                    }
+                    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+                    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+                    vPos.reserve(block.vtx.size());
+                    for (const CTransaction& tx : block.vtx) {
+                        vPos.push_back(std::make_pair(tx.GetHash(), pos));
+                        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+                    }
+                    if (!pblocktree->WriteTxIndex(vPos, pindex->GetBlockHash())) {
+                        AbortNode("Failed to write transaction index");
+                        return;
+                    }
+                    if (pindex->nHeight % 10000 == 0)
+                        LogPrintf("%s: transaction index at height %d\n", __func__, pindex->nHeight);
+                }
+                LogPrintf("%s: transaction index caught up to the tip\n", __func__);
+            }
+        }
+        if (fInsight) {
+            uint256 hashInsightBest;
+            if (!pblocktree->ReadInsightBestBlock(hashInsightBest)) {
+                // Same reasoning as above for pre-marker databases.
+                LOCK(cs_main);
+                if (chainActive.Tip()) {
+                    hashInsightBest = chainActive.Tip()->GetBlockHash();
+                    pblocktree->WriteInsightBestBlock(hashInsightBest);
+                }
+            }
+            std::vector<CBlockIndex*> vToIndex;
+            {
+                LOCK(cs_main);
+                vToIndex = CollectBlocksAboveMarker(hashInsightBest);
+            }
+            if (!vToIndex.empty()) {
+                LogPrintf("%s: explorer indexes catching up %u blocks\n", __func__, vToIndex.size());
+                for (CBlockIndex* pindex : vToIndex) {
+                    boost::this_thread::interruption_point();
+                    if (!ReplayInsightIndexes(chainparams, pindex)) {
+                        AbortNode("Failed to rebuild explorer indexes");
+                        return;
+                    }
+                }
+                LogPrintf("%s: explorer indexes caught up to the tip\n", __func__);
+            }
+        }
+
+        // Service phase: run whatever ConnectBlock and DisconnectBlock have
+        // queued, strictly in order, then advance the progress marker.
+        while (true) {
+            std::deque<std::pair<uint256, std::function<bool()> > > vWork;
+            {
+                boost::unique_lock<boost::mutex> lock(indexWriteMutex);
+                while (indexWriteQueue.empty())
+                    indexWriteCond.wait(lock);
+                vWork.swap(indexWriteQueue);
+                fIndexWriting = true;
+                // Wake any producer blocked on a full queue.
+                indexWriteCond.notify_all();
+            }
+            bool fOk = true;
+            for (const std::pair<uint256, std::function<bool()> >& entry : vWork) {
+                if (!entry.second()) {
+                    fOk = false;
+                    break;
+                }
+            }
+            if (fOk && fInsight)
+                fOk = pblocktree->WriteInsightBestBlock(vWork.back().first);
+            {
+                boost::unique_lock<boost::mutex> lock(indexWriteMutex);
+                fIndexWriting = false;
+                indexWriteCond.notify_all();
+            }
+            if (!fOk) {
+                AbortNode("Failed to write optional index");
+                return;
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Flush anything still queued, so the markers match what was connected.
+        std::deque<std::pair<uint256, std::function<bool()> > > vWork;
+        {
+            boost::unique_lock<boost::mutex> lock(indexWriteMutex);
+            vWork.swap(indexWriteQueue);
+        }
+        bool fOk = true;
+        for (const std::pair<uint256, std::function<bool()> >& entry : vWork)
+            fOk = fOk && entry.second();
+        if (fOk && fInsight && !vWork.empty())
+            pblocktree->WriteInsightBestBlock(vWork.back().first);
+        throw;
+    }
+}
+
+void static CheckBlockIndex(const Consensus::Params& consensusParams)
+{
+    if (!fCheckBlockIndex) {
+        return;
+    }
+
+    LOCK(cs_main);
+
+    // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
+    // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
+    // iterating the block tree require that chainActive has been initialized.)
+    if (chainActive.Height() < 0) {
+        assert(mapBlockIndex.size() <= 1);
+        return;
+    }
+
+    // Build forward-pointing map of the entire block tree.
+    std::multimap<CBlockIndex*,CBlockIndex*> forward;
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); it++) {
+        forward.insert(std::make_pair(it->second->pprev, it->second));
+    }
+
+    assert(forward.size() == mapBlockIndex.size());
+
+    std::pair<std::multimap<CBlockIndex*,CBlockIndex*>::iterator,std::multimap<CBlockIndex*,CBlockIndex*>::iterator> rangeGenesis = forward.equal_range(NULL);
     CBlockIndex *pindex = rangeGenesis.first->second;
     rangeGenesis.first++;
     assert(rangeGenesis.first == rangeGenesis.second); // There is only one index entry with parent NULL.
@@ -6071,7 +7866,9 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
             // are re-validated once their parents have arrived, and all other
             // locations are only possible if the transaction has already been
             // validated (we don't care about alternative authorizing data).
-            return recentRejects->contains(inv.GetWideHash()) ||
+            unsigned char key[WTxId::RAW_SIZE];
+            inv.GetWideHash(key);
+            return recentRejects->contains(key, sizeof(key)) ||
                    mempool.exists(inv.hash) ||
                    mapOrphanTransactions.count(inv.hash) ||
                    pcoinsTip->HaveCoins(inv.hash);
@@ -6083,6 +7880,99 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
+/** Read-ahead cache for serving blocks to peers.
+ *
+ *  Peers doing an initial download request blocks in long sequential ranges,
+ *  and reading each one from disk synchronously inside the message loop
+ *  stalls the handling of every other peer. A background thread pre-reads
+ *  the blocks that are likely to be requested next; ProcessGetData then
+ *  usually serves from memory. Responses are still pushed from the message
+ *  handler thread, which keeps per-peer message ordering intact. */
+static const int BLOCK_READAHEAD_DEPTH = 4;
+static const size_t BLOCK_READAHEAD_MAX_BLOCKS = 8;
+static boost::mutex blockReadAheadMutex;
+static boost::condition_variable blockReadAheadCond;
+static std::map<uint256, std::shared_ptr<const CBlock> > mapBlockReadAhead;
+static std::deque<uint256> readAheadEvictionOrder;
+static std::deque<const CBlockIndex*> blockReadAheadQueue;
+//! Hashes that are queued for reading or already cached, to avoid duplicates
+static std::set<uint256> setBlockReadAheadKnown;
+
+void ThreadBlockReadAhead(const CChainParams& chainparams)
+{
+    RenameThread("koto-blockread");
+    while (true) {
+        const CBlockIndex* pindex = NULL;
+        {
+            boost::unique_lock<boost::mutex> lock(blockReadAheadMutex);
+            while (blockReadAheadQueue.empty())
+                blockReadAheadCond.wait(lock);
+            pindex = blockReadAheadQueue.front();
+            blockReadAheadQueue.pop_front();
+        }
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        bool fRead = ReadBlockFromDisk(*pblock, pindex, chainparams.GetConsensus());
+
+        {
+            boost::unique_lock<boost::mutex> lock(blockReadAheadMutex);
+            if (!fRead) {
+                // e.g. the block file was pruned away; allow re-queueing
+                setBlockReadAheadKnown.erase(pindex->GetBlockHash());
+                continue;
+            }
+            while (mapBlockReadAhead.size() >= BLOCK_READAHEAD_MAX_BLOCKS) {
+                mapBlockReadAhead.erase(readAheadEvictionOrder.front());
+                setBlockReadAheadKnown.erase(readAheadEvictionOrder.front());
+                readAheadEvictionOrder.pop_front();
+            }
+            mapBlockReadAhead[pindex->GetBlockHash()] = pblock;
+            readAheadEvictionOrder.push_back(pindex->GetBlockHash());
+        }
+    }
+}
+
+/** Queue the active-chain successors of pindex for background reading. */
+static void ScheduleBlockReadAhead(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (!chainActive.Contains(pindex))
+        return;
+
+    boost::unique_lock<boost::mutex> lock(blockReadAheadMutex);
+    bool fQueued = false;
+    for (int i = 1; i <= BLOCK_READAHEAD_DEPTH; i++) {
+        const CBlockIndex* pnext = chainActive[pindex->nHeight + i];
+        if (!pnext || !(pnext->nStatus & BLOCK_HAVE_DATA))
+            break;
+        if (setBlockReadAheadKnown.insert(pnext->GetBlockHash()).second) {
+            blockReadAheadQueue.push_back(pnext);
+            fQueued = true;
+        }
+    }
+    if (fQueued)
+        blockReadAheadCond.notify_one();
+}
+
+/** Take a pre-read block out of the read-ahead cache, if present. */
+static std::shared_ptr<const CBlock> GetReadAheadBlock(const uint256& hash)
+{
+    boost::unique_lock<boost::mutex> lock(blockReadAheadMutex);
+    std::map<uint256, std::shared_ptr<const CBlock> >::iterator it = mapBlockReadAhead.find(hash);
+    if (it == mapBlockReadAhead.end())
+        return NULL;
+    std::shared_ptr<const CBlock> pblock = it->second;
+    mapBlockReadAhead.erase(it);
+    setBlockReadAheadKnown.erase(hash);
+    for (std::deque<uint256>::iterator jt = readAheadEvictionOrder.begin(); jt != readAheadEvictionOrder.end(); ++jt) {
+        if (*jt == hash) {
+            readAheadEvictionOrder.erase(jt);
+            break;
+        }
+    }
+    return pblock;
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams)
 {
     int currentHeight = GetHeight();
@@ -6103,7 +7993,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
             {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
@@ -6144,12 +8034,31 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
                 {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
+                    // Send block from the read-ahead cache, or from disk
+                    std::shared_ptr<const CBlock> pblockReadAhead = GetReadAheadBlock(inv.hash);
+                    CBlock blockRead;
+                    if (!pblockReadAhead) {
+                        if (!ReadBlockFromDisk(blockRead, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                    }
+                    const CBlock& block = pblockReadAhead ? *pblockReadAhead : blockRead;
+                    // Sequentially downloading peers will ask for the
+                    // successors next; pre-read them in the background.
+                    ScheduleBlockReadAhead(mi->second);
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
+                    else if (inv.type == MSG_CMPCT_BLOCK)
+                    {
+                        // If a peer is asking for old blocks, we're almost guaranteed
+                        // they won't have a useful mempool to match against a compact block,
+                        // and we don't feel like constructing the object for them, so
+                        // instead we respond with the full, non-compact block.
+                        if (mi->second->nHeight >= chainActive.Height() - 10) {
+                            pfrom->PushMessage("cmpctblock", CBlockHeaderAndShortTxIDs(block));
+                        } else {
+                            pfrom->PushMessage("block", block);
+                        }
+                    }
                     else // MSG_FILTERED_BLOCK)
                     {
                         bool send = false;
@@ -6241,7 +8150,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             // Track requests for our stuff.
             GetMainSignals().Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -6363,6 +8272,13 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         }
         pfrom->fClient = !(pfrom->nServices & NODE_NETWORK);
 
+        // A NODE_NETWORK_LIMITED peer keeps (at least) the most recent 288
+        // blocks, which is enough to serve us while we are near the tip;
+        // during initial download we need deeper history than it retains.
+        if (pfrom->fClient && (pfrom->nServices & NODE_NETWORK_LIMITED) &&
+            !IsInitialBlockDownload(chainparams.GetConsensus()))
+            pfrom->fClient = false;
+
         // Potentially mark this peer as a preferred download peer.
         {
             LOCK(cs_main);
@@ -6446,6 +8362,15 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+            // Tell our peer we are willing to provide version-1 cmpctblocks (BIP 152).
+            // If it responds with sendcmpct(announce=true), it may announce new
+            // blocks to us as cmpctblock messages.
+            bool fAnnounceUsingCMPCTBLOCK = false;
+            uint64_t nCMPCTBLOCKVersion = 1;
+            pfrom->PushMessage("sendcmpct", fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+        }
     }
 
 
@@ -6469,6 +8394,21 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
     }
 
 
+    else if (strCommand == "sendcmpct")
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == 1) {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->fProvidesCmpctBlocks = true;
+            nodestate->fPreferCmpctBlocks = fAnnounceUsingCMPCTBLOCK;
+        }
+        // Ignore any other versions of compact blocks.
+    }
+
+
     else if (strCommand == "addr")
     {
         vector<CAddress> vAddr;
@@ -6586,6 +8526,28 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                     }
                     LogPrint("net", "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
                 }
+                else if (!fAlreadyHave && !fImporting && !fReindex && mapBlocksInFlight.count(inv.hash)) {
+                    // The block is already in flight from another peer. If
+                    // that request has been outstanding for longer than this
+                    // (measurably faster) announcer would be expected to take
+                    // for the whole delivery, re-route the getdata here
+                    // rather than waiting out the slow peer's full timeout.
+                    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(inv.hash);
+                    CNodeState* statefrom = State(pfrom->GetId());
+                    const CNodeState* stateholder = State(itInFlight->second.first);
+                    int64_t nExpected = ExpectedBlockDeliveryUsec(statefrom, pfrom->nPingUsecTime);
+                    if (itInFlight->second.first != pfrom->GetId() &&
+                        chainActive.Tip()->GetBlockTime() > GetTime() - chainparams.GetConsensus().PoWTargetSpacing(pindexBestHeader->nHeight) * 20 &&
+                        statefrom->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER &&
+                        GetTimeMicros() - itInFlight->second.second->nTime > 2 * nExpected &&
+                        2 * nExpected < ExpectedBlockDeliveryUsec(stateholder, 0))
+                    {
+                        LogPrint("net", "re-routing getdata %s from slow peer=%d to peer=%d\n",
+                                 inv.hash.ToString(), itInFlight->second.first, pfrom->id);
+                        vToFetch.push_back(inv);
+                        MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
+                    }
+                }
             }
             else
             {
@@ -6657,7 +8619,7 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             }
             // If pruning, don't inv blocks unless we have on disk and are likely to still have
             // for some reasonable time window (1 hour) that block relay might require.
-            const int nPrunedBlocksLikelyToHave = MIN_BLOCKS_TO_KEEP - 3600 / chainparams.GetConsensus().PoWTargetSpacing(pindex->nHeight);
+            const int nPrunedBlocksLikelyToHave = nPruneBlocksToKeep - 3600 / chainparams.GetConsensus().PoWTargetSpacing(pindex->nHeight);
             if (fPruneMode && (!(pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nHeight <= chainActive.Tip()->nHeight - nPrunedBlocksLikelyToHave))
             {
                 LogPrint("net", " getblocks stopping, pruned or too old block at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -6678,6 +8640,22 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
 
     else if (strCommand == "getheaders")
     {
+        /** Serialized header-range cache for serving getheaders.
+         *
+         * Syncing peers walk the chain in lockstep, so instead of
+         * re-serializing up to MAX_HEADERS_RESULTS headers from scattered
+         * CBlockIndex nodes per request, we keep one contiguous serialized
+         * span of active-chain headers (with per-height offsets) and serve
+         * slices of it with a straight memcpy. The span is rebuilt when a
+         * request falls outside it or when the tip changes (which also
+         * covers reorgs, since any reorg changes the tip hash). Protected
+         * by cs_main. */
+        static const int HEADERS_CACHE_SPAN = 4096;
+        static uint256 hashHeadersCacheTip;
+        static int nHeadersCacheStart = -1;
+        static CDataStream ssHeadersCache(SER_NETWORK, PROTOCOL_VERSION);
+        static std::vector<size_t> vHeadersCacheOffsets;
+
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -6704,17 +8682,62 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                 pindex = chainActive.Next(pindex);
         }
 
-        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
-        vector<CBlock> vHeaders;
-        int nLimit = MAX_HEADERS_RESULTS;
         LogPrint("net", "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
-        for (; pindex; pindex = chainActive.Next(pindex))
-        {
-            vHeaders.push_back(pindex->GetBlockHeader());
-            if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
-                break;
+        if (locator.IsNull() || !pindex || !chainActive.Contains(pindex)) {
+            // Single arbitrary (possibly off-chain) block, or nothing to
+            // serve: take the slow path.
+            // We must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end.
+            vector<CBlock> vHeaders;
+            int nLimit = MAX_HEADERS_RESULTS;
+            for (; pindex; pindex = chainActive.Next(pindex))
+            {
+                vHeaders.push_back(pindex->GetBlockHeader());
+                if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
+                    break;
+            }
+            pfrom->PushMessage("headers", vHeaders);
+            return true;
+        }
+
+        const int nStart = pindex->nHeight;
+        int nEnd = std::min(nStart + (int)MAX_HEADERS_RESULTS - 1, chainActive.Height());
+        if (!hashStop.IsNull()) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second) &&
+                mi->second->nHeight >= nStart) {
+                nEnd = std::min(nEnd, mi->second->nHeight);
+            }
+        }
+
+        const int nCached = (int)vHeadersCacheOffsets.size() - 1;
+        if (chainActive.Tip()->GetBlockHash() != hashHeadersCacheTip ||
+            nStart < nHeadersCacheStart || nEnd >= nHeadersCacheStart + nCached) {
+            // (Re)build the span starting at the requested height.
+            hashHeadersCacheTip = chainActive.Tip()->GetBlockHash();
+            nHeadersCacheStart = nStart;
+            ssHeadersCache.clear();
+            vHeadersCacheOffsets.clear();
+            vHeadersCacheOffsets.push_back(0);
+            const int nSpanEnd = std::min(nStart + HEADERS_CACHE_SPAN - 1, chainActive.Height());
+            for (int nHeight = nStart; nHeight <= nSpanEnd; nHeight++) {
+                // Serialize as CBlocks, which include the 0x00 nTx count at the end.
+                ssHeadersCache << CBlock(chainActive[nHeight]->GetBlockHeader());
+                vHeadersCacheOffsets.push_back(ssHeadersCache.size());
+            }
+        }
+
+        const unsigned int nCount = nEnd >= nStart ? nEnd - nStart + 1 : 0;
+        const size_t nOffBegin = vHeadersCacheOffsets[nStart - nHeadersCacheStart];
+        const size_t nOffEnd = vHeadersCacheOffsets[nStart - nHeadersCacheStart + nCount];
+        try {
+            pfrom->BeginMessage("headers");
+            WriteCompactSize(pfrom->ssSend, nCount);
+            pfrom->ssSend.write(&ssHeadersCache.begin()[nOffBegin], nOffEnd - nOffBegin);
+            pfrom->EndMessage();
+        } catch (...) {
+            pfrom->AbortMessage();
+            throw;
         }
-        pfrom->PushMessage("headers", vHeaders);
     }
 
 
@@ -6728,10 +8751,14 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             return true;
         }
 
-        vector<uint256> vWorkQueue;
+        vector<COutPoint> vWorkQueue;
         vector<uint256> vEraseQueue;
-        CTransaction tx;
-        vRecv >> tx;
+        CTransaction txDeserialized;
+        vRecv >> txDeserialized;
+        // Share one deserialized copy between the mempool, the relay map and
+        // anything else that holds on to it.
+        CTransactionRef ptx = MakeTransactionRef(std::move(txDeserialized));
+        const CTransaction& tx = *ptx;
 
         const uint256& txid = tx.GetHash();
         const WTxId& wtxid = tx.GetWTxId();
@@ -6746,15 +8773,23 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         pfrom->setAskFor.erase(wtxid);
         mapAlreadyAskedFor.erase(wtxid);
 
+        // Transactions from whitelisted peers skip signature, script and
+        // proof verification when -trustedmempoolsync is enabled, so that a
+        // co-located cluster validates each transaction once instead of on
+        // every node. Orphans resolved later are always fully checked, their
+        // provenance is mixed.
+        bool fTrustedPeer = pfrom->fWhitelisted && GetBoolArg("-trustedmempoolsync", DEFAULT_TRUSTEDMEMPOOLSYNC);
+
         // We do the AlreadyHave() check using a MSG_WTX inv unconditionally,
         // because for pre-v5 transactions wtxid.authDigest is set to the same
         // placeholder as is used for the CInv.hashAux field for MSG_TX.
         if (!AlreadyHave(CInv(MSG_WTX, txid, wtxid.authDigest)) &&
-            AcceptToMemoryPool(chainparams, mempool, state, tx, true, &fMissingInputs))
+            AcceptToMemoryPool(chainparams, mempool, state, ptx, true, &fMissingInputs, false, 0, fTrustedPeer))
         {
             mempool.check(pcoinsTip);
             RelayTransaction(tx);
-            vWorkQueue.push_back(txid);
+            for (unsigned int i = 0; i < tx.vout.size(); i++)
+                vWorkQueue.push_back(COutPoint(txid, i));
 
             LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s: accepted %s (poolsz %u txn, %u kB)\n",
                 pfrom->id, pfrom->cleanSubVer,
@@ -6765,16 +8800,16 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             set<NodeId> setMisbehaving;
             for (unsigned int i = 0; i < vWorkQueue.size(); i++)
             {
-                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
+                OrphanMapByPrev::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
                 if (itByPrev == mapOrphanTransactionsByPrev.end())
                     continue;
-                for (set<uint256>::iterator mi = itByPrev->second.begin();
+                for (set<const COrphanTx*>::iterator mi = itByPrev->second.begin();
                      mi != itByPrev->second.end();
                      ++mi)
                 {
-                    const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
+                    const CTransaction& orphanTx = (*mi)->tx;
+                    const uint256& orphanHash = orphanTx.GetHash();
+                    NodeId fromPeer = (*mi)->fromPeer;
                     bool fMissingInputs2 = false;
                     // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
                     // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
@@ -6788,7 +8823,8 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                     {
                         LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
                         RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
+                        for (unsigned int j = 0; j < orphanTx.vout.size(); j++)
+                            vWorkQueue.push_back(COutPoint(orphanHash, j));
                         vEraseQueue.push_back(orphanHash);
                     }
                     else if (!fMissingInputs2)
@@ -6810,7 +8846,9 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                         // these, as they are always bound to the entirety of the
                         // transaction regardless of version.
                         assert(recentRejects);
-                        recentRejects->insert(orphanTx.GetWTxId().ToBytes());
+                        unsigned char key[WTxId::RAW_SIZE];
+                        orphanTx.GetWTxId().ToRawBytes(key);
+                        recentRejects->insert(key, sizeof(key));
                     }
                     mempool.check(pcoinsTip);
                 }
@@ -6838,7 +8876,9 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             // these, as they are always bound to the entirety of the
             // transaction regardless of version.
             assert(recentRejects);
-            recentRejects->insert(tx.GetWTxId().ToBytes());
+            unsigned char key[WTxId::RAW_SIZE];
+            tx.GetWTxId().ToRawBytes(key);
+            recentRejects->insert(key, sizeof(key));
 
             if (pfrom->fWhitelisted && GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
                 // Always relay transactions received from whitelisted peers, even
@@ -6912,12 +8952,28 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         }
 
         CBlockIndex *pindexLast = NULL;
+        bool fStoredOrphans = false;
         for (const CBlockHeader& header : headers) {
             CValidationState state;
             if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
+            if (pindexLast == NULL && mapBlockIndex.count(header.hashPrevBlock) == 0 &&
+                header.GetHash() != chainparams.GetConsensus().hashGenesisBlock) {
+                // Parent unknown: stash the header in the bounded orphan
+                // store instead of punishing the peer, and fill in the gap
+                // below. CheckBlockHeader keeps junk out of the store.
+                if (!CheckBlockHeader(header, state, chainparams)) {
+                    int nDoS;
+                    if (state.IsInvalid(nDoS) && nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS);
+                    return error("invalid header received");
+                }
+                AddOrphanHeader(header, pfrom->GetId());
+                fStoredOrphans = true;
+                continue;
+            }
             if (!AcceptBlockHeader(header, state, chainparams, &pindexLast)) {
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
@@ -6926,6 +8982,16 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                     return error("invalid header received");
                 }
             }
+            if (pindexLast && !mapOrphanHeadersByPrev.empty())
+                ProcessOrphanHeaders(pindexLast->GetBlockHash(), chainparams);
+        }
+
+        if (fStoredOrphans) {
+            // We stored headers we could not connect; ask this peer for the
+            // missing ancestry starting from our best header.
+            pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256());
+            LogPrint("net", "received orphan headers, sending getheaders (%d) to peer=%d\n",
+                     pindexBestHeader ? pindexBestHeader->nHeight : -1, pfrom->id);
         }
 
         if (pindexLast)
@@ -6950,6 +9016,196 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         NotifyHeaderTip(chainparams.GetConsensus());
     }
 
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        LogPrint("net", "received cmpctblock %s peer=%d\n", cmpctblock.header.GetHash().ToString(), pfrom->id);
+
+        // Process the header as if it had arrived on its own; this checks the
+        // proof of work and the contextual header rules before we do any
+        // reconstruction work.
+        CBlockIndex* pindex = NULL;
+        {
+            LOCK(cs_main);
+            CValidationState state;
+            if (!AcceptBlockHeader(cmpctblock.header, state, chainparams, &pindex)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS);
+                    LogPrintf("Peer %d sent us an invalid header via cmpctblock\n", pfrom->id);
+                }
+                return true;
+            }
+            if (!mapOrphanHeadersByPrev.empty())
+                ProcessOrphanHeaders(pindex->GetBlockHash(), chainparams);
+        }
+
+        bool fBlockReconstructed = false;
+        CBlock block;
+        {
+            LOCK(cs_main);
+            if (pindex->nStatus & BLOCK_HAVE_DATA) {
+                // Nothing to do: we already have this block.
+                return true;
+            }
+            if (pindex->nHeight <= chainActive.Height() - 10 ||
+                IsInitialBlockDownload(chainparams.GetConsensus())) {
+                // We are deep in a sync or the block is far from our tip; our
+                // mempool will be of little use for reconstruction, so leave
+                // fetching the block to the regular download logic.
+                return true;
+            }
+
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+            PartiallyDownloadedBlock& partialBlock = *nodestate->partialBlock;
+            ReadStatus status = partialBlock.InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                nodestate->partialBlock.reset();
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us an invalid compact block\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Duplicate short IDs within the block; request it in full.
+                nodestate->partialBlock.reset();
+                vector<CInv> vInv(1);
+                vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
+                pfrom->PushMessage("getdata", vInv);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                if (!partialBlock.IsTxAvailable(i))
+                    req.indexes.push_back(i);
+            }
+            if (req.indexes.empty()) {
+                // The block can be reconstructed from the mempool alone.
+                ReadStatus fillStatus = partialBlock.FillBlock(block, std::vector<CTransaction>());
+                nodestate->partialBlock.reset();
+                if (fillStatus == READ_STATUS_OK) {
+                    fBlockReconstructed = true;
+                } else {
+                    // Short ID collision against our mempool; request the full block.
+                    vector<CInv> vInv(1);
+                    vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
+                    pfrom->PushMessage("getdata", vInv);
+                    return true;
+                }
+            } else {
+                req.blockhash = pindex->GetBlockHash();
+                pfrom->PushMessage("getblocktxn", req);
+            }
+        }
+
+        if (fBlockReconstructed) {
+            CValidationState state;
+            ProcessNewBlock(state, chainparams, pfrom, &block, true, NULL);
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
+                pfrom->PushMessage("reject", (string)"block", (unsigned char)state.GetRejectCode(),
+                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
+                if (nDoS > 0) {
+                    LOCK(cs_main);
+                    Misbehaving(pfrom->GetId(), nDoS);
+                }
+            }
+        }
+    }
+
+
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (it->second->nHeight < chainActive.Height() - 15) {
+            // Peers should only be requesting transactions for recently-announced
+            // compact blocks; anything deeper can be fetched as a full block.
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block > 15 deep\n", pfrom->id);
+            return true;
+        }
+
+        CBlock block;
+        assert(ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()));
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices\n", pfrom->id);
+                return true;
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fBlockRead = false;
+        {
+            LOCK(cs_main);
+
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (!nodestate->partialBlock || nodestate->partialBlock->header.GetHash() != resp.blockhash) {
+                LogPrint("net", "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            ReadStatus status = nodestate->partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                nodestate->partialBlock.reset();
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided; fall back to getdata.
+                nodestate->partialBlock.reset();
+                vector<CInv> vInv(1);
+                vInv[0] = CInv(MSG_BLOCK, resp.blockhash);
+                pfrom->PushMessage("getdata", vInv);
+                return true;
+            } else {
+                fBlockRead = true;
+                nodestate->partialBlock.reset();
+            }
+        }
+
+        if (fBlockRead) {
+            CValidationState state;
+            // Since we requested this block (it was in our partialBlock), force it to be processed.
+            ProcessNewBlock(state, chainparams, pfrom, &block, true, NULL);
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
+                pfrom->PushMessage("reject", (string)"block", (unsigned char)state.GetRejectCode(),
+                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
+                if (nDoS > 0) {
+                    LOCK(cs_main);
+                    Misbehaving(pfrom->GetId(), nDoS);
+                }
+            }
+        }
+    }
+
+
     else if (strCommand == "block" && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         CBlock block;
@@ -6993,7 +9249,10 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addr);
+            pfrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.GetAddr();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr)
@@ -7160,6 +9419,9 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         {
             delete pfrom->pfilter;
             pfrom->pfilter = new CBloomFilter(filter);
+            // precompute the degenerate cases so that serving filtered
+            // blocks against an empty or saturated filter costs nothing
+            pfrom->pfilter->UpdateEmptyFull();
             pfrom->fRelayTxes = true;
         }
     }
@@ -7304,14 +9566,19 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom)
 
         // Checksum
         CDataStream& vRecv = msg.vRecv;
-        uint256 hash = Hash(vRecv.begin(), vRecv.begin() + nMessageSize);
-        if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+        if (!msg.fSkipChecksum)
         {
-            LogPrintf("%s(%s, %u bytes): CHECKSUM ERROR expected %s was %s\n", __func__,
-               SanitizeString(strCommand), nMessageSize,
-               HexStr(hash.begin(), hash.begin()+CMessageHeader::CHECKSUM_SIZE),
-               HexStr(hdr.pchChecksum, hdr.pchChecksum+CMessageHeader::CHECKSUM_SIZE));
-            continue;
+            // The payload was hashed as it arrived from the socket, so no
+            // further pass over the message data is needed here.
+            const uint256& hash = msg.GetMessageHash();
+            if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+            {
+                LogPrintf("%s(%s, %u bytes): CHECKSUM ERROR expected %s was %s\n", __func__,
+                   SanitizeString(strCommand), nMessageSize,
+                   HexStr(hash.begin(), hash.begin()+CMessageHeader::CHECKSUM_SIZE),
+                   HexStr(hdr.pchChecksum, hdr.pchChecksum+CMessageHeader::CHECKSUM_SIZE));
+                continue;
+            }
         }
 
         // Process message
@@ -7429,24 +9696,28 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         // Message: addr
         //
         if (pto->nNextAddrSend < nNow) {
-            pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            pto->nNextAddrSend = PoissonNextSend(nNow,
+                GetArg("-addrbroadcastinterval", AVG_ADDRESS_BROADCAST_INTERVAL));
             vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            for (const CAddress& addr : pto->vAddrToSend)
             {
-                if (!pto->addrKnown.contains(addr.GetKey()))
+                LOCK(pto->cs_addr);
+                vAddr.reserve(pto->vAddrToSend.size());
+                for (const CAddress& addr : pto->vAddrToSend)
                 {
-                    pto->addrKnown.insert(addr.GetKey());
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000)
+                    if (!pto->addrKnown.contains(addr.GetKey()))
                     {
-                        pto->PushMessage("addr", vAddr);
-                        vAddr.clear();
+                        pto->addrKnown.insert(addr.GetKey());
+                        vAddr.push_back(addr);
+                        // receiver rejects addr messages larger than 1000
+                        if (vAddr.size() >= 1000)
+                        {
+                            pto->PushMessage("addr", vAddr);
+                            vAddr.clear();
+                        }
                     }
                 }
+                pto->vAddrToSend.clear();
             }
-            pto->vAddrToSend.clear();
             if (!vAddr.empty())
                 pto->PushMessage("addr", vAddr);
         }
@@ -7509,7 +9780,13 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         vector<CInv> vInv;
         {
             LOCK(pto->cs_inventory);
-            vInv.reserve(std::max<size_t>(pto->vInventoryBlockToSend.size(), INVENTORY_BROADCAST_MAX));
+            // Relay nodes can widen the coalescing window to trade relay
+            // latency for fewer, larger inv messages; the per-window cap
+            // scales with it so the average drain rate is unchanged.
+            const unsigned int nInvBroadcastInterval =
+                GetArg("-invbroadcastinterval", INVENTORY_BROADCAST_INTERVAL);
+            const unsigned int nInvBroadcastMax = 7 * nInvBroadcastInterval;
+            vInv.reserve(std::max<size_t>(pto->vInventoryBlockToSend.size(), nInvBroadcastMax));
 
             // Add blocks
             for (const uint256& hash : pto->vInventoryBlockToSend) {
@@ -7526,7 +9803,7 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
             if (pto->nNextInvSend < nNow) {
                 fSendTrickle = true;
                 // Use half the delay for outbound peers, as there is less privacy concern for them.
-                pto->nNextInvSend = PoissonNextSend(nNow, INVENTORY_BROADCAST_INTERVAL >> !pto->fInbound);
+                pto->nNextInvSend = PoissonNextSend(nNow, nInvBroadcastInterval >> !pto->fInbound);
             }
 
             // Time to send but the peer has requested we not relay transactions.
@@ -7556,7 +9833,12 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                     if (pto->pfilter) {
                         if (!pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
                     }
-                    pto->filterInventoryKnown.insert(hash);
+                    // Key the known-inventory filter by wtxid, matching
+                    // AddKnownTx(), so announcements from this peer actually
+                    // deduplicate against what we have sent it.
+                    unsigned char key[WTxId::RAW_SIZE];
+                    txinfo.tx->GetWTxId().ToRawBytes(key);
+                    pto->filterInventoryKnown.insert(key, sizeof(key));
                     vInv.push_back(inv);
                     if (vInv.size() == MAX_INV_SZ) {
                         pto->PushMessage("inv", vInv);
@@ -7582,7 +9864,7 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                 // especially since we have many peers and some will draw much shorter delays.
                 unsigned int nRelayedTransactions = 0;
                 LOCK(pto->cs_filter);
-                while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
+                while (!vInvTx.empty() && nRelayedTransactions < nInvBroadcastMax) {
                     // Fetch the top element from the heap
                     std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
                     std::set<uint256>::iterator it = vInvTx.back();
@@ -7590,15 +9872,19 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                     uint256 hash = *it;
                     // Remove it from the to-be-sent set
                     pto->setInventoryTxToSend.erase(it);
-                    // Check if not in the filter already
-                    if (pto->filterInventoryKnown.contains(hash)) {
-                        continue;
-                    }
                     // Not in the mempool anymore? don't bother sending it.
                     auto txinfo = mempool.info(hash);
                     if (!txinfo.tx) {
                         continue;
                     }
+                    // Check if not in the filter already. Keyed by wtxid,
+                    // matching AddKnownTx(), so transactions this peer has
+                    // announced to us are not echoed back to it.
+                    unsigned char key[WTxId::RAW_SIZE];
+                    txinfo.tx->GetWTxId().ToRawBytes(key);
+                    if (pto->filterInventoryKnown.contains(key, sizeof(key))) {
+                        continue;
+                    }
                     CInv inv = InvForTransaction(txinfo.tx);
                     // ZIP 239: We won't have v5 transactions in our mempool until after
                     // NU5 activates, at which point we will only be connected to peers
@@ -7626,7 +9912,7 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                         pto->PushMessage("inv", vInv);
                         vInv.clear();
                     }
-                    pto->filterInventoryKnown.insert(hash);
+                    pto->filterInventoryKnown.insert(key, sizeof(key));
                 }
             }
         }
@@ -7669,12 +9955,35 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         // Message: getdata (blocks)
         //
         vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload(params)) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        // Peers that have been delivering blocks faster than the average of
+        // their peers get a deeper in-flight window, so the moving download
+        // window is striped towards the links that can actually fill it.
+        int nMaxInFlight = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+        if (state.nBlockDeliveryEwmaUsec > 0) {
+            int64_t nEwmaSum = 0;
+            int nMeasured = 0;
+            for (const std::pair<const NodeId, CNodeState>& node : mapNodeState) {
+                if (node.second.nBlockDeliveryEwmaUsec > 0) {
+                    nEwmaSum += node.second.nBlockDeliveryEwmaUsec;
+                    nMeasured++;
+                }
+            }
+            if (nMeasured > 1 && state.nBlockDeliveryEwmaUsec * nMeasured < nEwmaSum)
+                nMaxInFlight = MAX_BLOCKS_IN_TRANSIT_PER_FAST_PEER;
+        }
+        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload(params)) && state.nBlocksInFlight < nMaxInFlight) {
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            FindNextBlocksToDownload(pto->GetId(), nMaxInFlight - state.nBlocksInFlight, vToDownload, staller);
             for (CBlockIndex *pindex : vToDownload) {
-                vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
+                if (state.fProvidesCmpctBlocks && pto->nVersion >= SHORT_IDS_BLOCKS_VERSION &&
+                    pindex->nHeight > chainActive.Height() - 10) {
+                    // Near the tip our mempool is likely to hold most of the
+                    // block already, so fetch it as a compact block.
+                    vGetData.push_back(CInv(MSG_CMPCT_BLOCK, pindex->GetBlockHash()));
+                } else {
+                    vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
+                }
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), params, pindex);
                 LogPrint("net", "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                     pindex->nHeight, pto->id);
@@ -7690,9 +9999,10 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         //
         // Message: getdata (non-blocks)
         //
-        while (!pto->fDisconnect && !pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
+        CInv invAskFor;
+        while (!pto->fDisconnect && pto->askForWheel.PopDue(nNow, invAskFor))
         {
-            const CInv& inv = (*pto->mapAskFor.begin()).second;
+            const CInv& inv = invAskFor;
             if (!AlreadyHave(inv))
             {
                 if (fDebug)
@@ -7707,7 +10017,6 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                 //If we're not going to ask, don't expect a response.
                 pto->setAskFor.erase(WTxId(inv.hash, inv.hashAux));
             }
-            pto->mapAskFor.erase(pto->mapAskFor.begin());
         }
         if (!vGetData.empty())
             pto->PushMessage("getdata", vGetData);
@@ -7720,6 +10029,133 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
      return strprintf("CBlockFileInfo(blocks=%u, size=%u, heights=%u...%u, time=%s...%s)", nBlocks, nSize, nHeightFirst, nHeightLast, DateTimeStrFormat("%Y-%m-%d", nTimeFirst), DateTimeStrFormat("%Y-%m-%d", nTimeLast));
  }
 
+//! Version of the on-disk format of mempool.dat
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+bool LoadMempool(const CChainParams& chainparams)
+{
+    fs::path pathMempool = GetDataDir() / "mempool.dat";
+    FILE *file = fsbridge::fopen(pathMempool, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    int64_t count = 0;
+    int64_t failed = 0;
+    int64_t skipped = 0;
+    try {
+        uint64_t version;
+        filein >> version;
+        if (version != MEMPOOL_DUMP_VERSION) {
+            return false;
+        }
+        uint64_t num;
+        filein >> num;
+        while (num--) {
+            CTransaction tx;
+            int64_t nTime;
+            int64_t nFeeDelta;
+            filein >> tx;
+            filein >> nTime;
+            filein >> nFeeDelta;
+
+            if (nFeeDelta) {
+                mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), 0, nFeeDelta);
+            }
+
+            LOCK(cs_main);
+            // Transactions whose expiry height has passed are not worth
+            // offering to AcceptToMemoryPool at all.
+            if (IsExpiredTx(tx, chainActive.Height() + 1)) {
+                skipped++;
+                continue;
+            }
+            CValidationState state;
+            if (AcceptToMemoryPool(chainparams, mempool, state, tx, false, NULL, false, nTime)) {
+                count++;
+            } else {
+                failed++;
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+        std::map<uint256, CAmount> mapDeltas;
+        filein >> mapDeltas;
+        for (const auto& i : mapDeltas) {
+            mempool.PrioritiseTransaction(i.first, i.first.ToString(), 0, i.second);
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, skipped);
+    return true;
+}
+
+bool DumpMempool()
+{
+    int64_t start = GetTimeMicros();
+
+    std::map<uint256, CAmount> mapDeltas;
+    std::vector<std::pair<CTransaction, int64_t> > vinfo;
+
+    {
+        LOCK(mempool.cs);
+        for (const auto& i : mempool.mapDeltas) {
+            mapDeltas[i.first] = i.second.second;
+        }
+        vinfo.reserve(mempool.mapTx.size());
+        // Dump oldest-first so that parents precede their children; on load
+        // each transaction then re-enters through AcceptToMemoryPool with its
+        // inputs already available.
+        const auto& byTime = mempool.mapTx.get<4>();
+        for (auto mi = byTime.begin(); mi != byTime.end(); ++mi) {
+            vinfo.push_back(std::make_pair(mi->GetTx(), mi->GetTime()));
+        }
+    }
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        fs::path pathTmp = GetDataDir() / "mempool.dat.new";
+        FILE *file = fsbridge::fopen(pathTmp, "wb");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull()) {
+            return false;
+        }
+
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        fileout << version;
+
+        fileout << (uint64_t)vinfo.size();
+        for (const auto& i : vinfo) {
+            fileout << i.first;
+            fileout << i.second;
+            std::map<uint256, CAmount>::iterator it = mapDeltas.find(i.first.GetHash());
+            fileout << (int64_t)(it == mapDeltas.end() ? 0 : it->second);
+            mapDeltas.erase(i.first.GetHash());
+        }
+        // Deltas for transactions that are not currently in the pool are
+        // written separately, so prioritisations set before a restart
+        // survive it.
+        fileout << mapDeltas;
+
+        FileCommit(fileout.Get());
+        fileout.fclose();
+        if (!RenameOver(pathTmp, GetDataDir() / "mempool.dat"))
+            return false;
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n", (mid - start) * 0.000001, (last - mid) * 0.000001);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 
 
 static class CMainCleanup
@@ -7728,10 +10164,8 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
 
         // orphan transactions
         mapOrphanTransactions.clear();
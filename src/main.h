@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <stdint.h>
@@ -42,7 +43,9 @@
 #include <utility>
 #include <vector>
 
+#include <rust/ed25519.h>
 #include <rust/orchard.h>
+#include <rust/sapling.h>
 
 #include <boost/unordered_map.hpp>
 
@@ -50,6 +53,7 @@ class CBlockIndex;
 class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewDB;
 class CInv;
 class CScriptCheck;
 class CValidationInterface;
@@ -64,6 +68,8 @@ static const bool DEFAULT_ALERTS = true;
 static const unsigned int MAX_REORG_LENGTH = COINBASE_MATURITY - 1;
 /** Default for DEFAULT_WHITELISTRELAY. */
 static const bool DEFAULT_WHITELISTRELAY = true;
+/** Default for -trustedmempoolsync */
+static const bool DEFAULT_TRUSTEDMEMPOOLSYNC = false;
 /** Default for DEFAULT_WHITELISTFORCERELAY. */
 static const bool DEFAULT_WHITELISTFORCERELAY = true;
 /** Default for -minrelaytxfee, minimum relay fee for transactions */
@@ -83,17 +89,24 @@ static const unsigned int DEFAULT_POST_BLOSSOM_TX_EXPIRY_DELTA = DEFAULT_PRE_BLO
 static constexpr uint32_t TX_EXPIRING_SOON_THRESHOLD = 3;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
-/** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
-static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
-/** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
-static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** Default pre-allocation chunk size for blk?????.dat files (since 0.8) */
+static const unsigned int DEFAULT_BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
+/** Default pre-allocation chunk size for rev?????.dat files (since 0.8) */
+static const unsigned int DEFAULT_UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -parspin default: iterations an idle validation worker polls for new work
+ *  before sleeping on its condition variable (0 = sleep immediately) */
+static const unsigned int DEFAULT_SCRIPTCHECK_SPIN = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** As above, but for peers that have been delivering blocks faster than the average of their
+ *  peers; deepening their share of the download window keeps sync limited by validation speed
+ *  rather than round-trips to the slowest link. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_FAST_PEER = 32;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -128,12 +141,20 @@ static const unsigned int INVENTORY_BROADCAST_MAX = 7 * INVENTORY_BROADCAST_INTE
 static const unsigned int DEFAULT_LIMITFREERELAY = 15;
 static const bool DEFAULT_RELAYPRIORITY = false;
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -maxscriptcachesize, in MiB */
+static const unsigned int DEFAULT_MAX_SCRIPT_CACHE_SIZE = 32;
 
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_IBD_SKIP_TX_VERIFICATION = false;
+/** Default for -standby */
+static const bool DEFAULT_STANDBY = false;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_BLOCKMMAP = false;
+static const bool DEFAULT_BLOCKCOMPRESS = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for -nurejectoldversions */
@@ -168,6 +189,7 @@ extern bool fTxIndex;
 
 // Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses
 extern bool fAddressIndex;
+extern bool fAddressBalanceIndex;
 
 // Maintain a full spent index, used to query the spending txid and input index for an outpoint
 extern bool fSpentIndex;
@@ -181,10 +203,29 @@ extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern bool fIBDSkipTxVerification;
+/**
+ * Hot-standby mode (-standby): flush the chainstate, block index and tree
+ * states to disk after every block connect instead of on the periodic timer,
+ * so the on-disk state is always at the tip. Promoting the standby is then a
+ * plain restart with no replay or revalidation window. Costs one leveldb
+ * batch write per block, which at our block interval is negligible next to
+ * validation itself.
+ */
+extern bool fStandbyMode;
+/** Block hash whose ancestors we assume to have valid scripts and proofs (see -assumevalid). */
+extern uint256 hashAssumeValid;
 // TODO: remove this flag by structuring our code such that
 // it is unneeded for testing
 extern bool fCoinbaseEnforcedShieldingEnabled;
 extern size_t nCoinCacheUsage;
+/** Extra coins-cache budget borrowed from the idle verification caches while
+ *  in initial block download; 0 unless -maxcachebudget is in effect. */
+extern size_t nCoinCacheIBDBonus;
+/** Pre-allocation chunk sizes for block and undo files; set from
+ *  -blockfilechunksize. Larger extents mean fewer fallocate calls and less
+ *  fragmentation on rotating disks. */
+extern unsigned int nBlockfileChunkSize;
+extern unsigned int nUndofileChunkSize;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** Absolute maximum transaction fee (in satoshis) used by wallet and mempool (rejects high fee in sendrawtransaction) */
@@ -196,6 +237,23 @@ extern int64_t nMaxTipAge;
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
 
+/** Immutable snapshot of the cheap tip state, republished by UpdateTip on
+ *  every tip change. Lets monitoring RPCs answer without queueing behind
+ *  cs_main during block validation. */
+struct CChainTipSnapshot {
+    int nHeight;
+    uint256 hashBlock;
+    arith_uint256 nChainWork;
+    //! The tip's own difficulty target.
+    uint32_t nBits;
+    //! The target the next block must meet (getdifficulty semantics).
+    uint32_t nBitsNext;
+    int64_t nMedianTime;
+};
+/** Latest published tip snapshot, or nullptr before the first UpdateTip.
+ *  Safe to call without cs_main; the returned object never changes. */
+std::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot();
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -206,6 +264,9 @@ extern bool fHavePruned;
 extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
+/** Number of most-recent blocks whose data is never pruned (-pruneretention);
+ *  at least MIN_BLOCKS_TO_KEEP. */
+extern unsigned int nPruneBlocksToKeep;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
 
@@ -265,8 +326,15 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom);
  * @param[in]   pto             The node which we are sending messages to.
  */
 bool SendMessages(const Consensus::Params& params, CNode* pto);
-/** Run an instance of the script checking thread */
+/** Register the script check queue with the shared validation worker pool;
+ *  call once before starting the ThreadScriptCheck workers */
+void InitValidationPool(int nWorkers);
+/** Run an instance of the shared validation worker pool */
 void ThreadScriptCheck();
+/** Run the background writer for the optional indexes (-txindex, insightexplorer, lightwalletd) */
+void ThreadIndexWriter(const CChainParams& chainparams);
+/** Run the block read-ahead thread that pre-reads blocks for ProcessGetData */
+void ThreadBlockReadAhead(const CChainParams& chainparams);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload(const Consensus::Params& params);
 /** testing-only, set or reset initial block down (IBD) state, return previous */
@@ -312,11 +380,28 @@ void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 
-/** (try to) add transaction to memory pool **/
+/** (try to) add transaction to memory pool; nAcceptTime overrides the entry's
+ *  timestamp when replaying saved transactions (0 means "now"). The
+ *  CTransactionRef overload shares the caller's transaction with the mempool
+ *  and relay map instead of copying it. **/
+bool AcceptToMemoryPool(
+        const CChainParams& chainparams,
+        CTxMemPool& pool, CValidationState &state, const CTransactionRef& ptx, bool fLimitFree,
+        bool* pfMissingInputs, bool fRejectAbsurdFee=false, int64_t nAcceptTime=0,
+        bool fTrustedPeer=false);
 bool AcceptToMemoryPool(
         const CChainParams& chainparams,
         CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-        bool* pfMissingInputs, bool fRejectAbsurdFee=false);
+        bool* pfMissingInputs, bool fRejectAbsurdFee=false, int64_t nAcceptTime=0,
+        bool fTrustedPeer=false);
+
+/** Load the memory pool from mempool.dat in the data directory, replaying the
+ *  saved transactions through AcceptToMemoryPool. Intended to be run once at
+ *  startup, after the active chain is in place. */
+bool LoadMempool(const CChainParams& chainparams);
+
+/** Dump the memory pool to mempool.dat in the data directory. */
+bool DumpMempool();
 
 
 struct CNodeStateStats {
@@ -326,6 +411,29 @@ struct CNodeStateStats {
     std::vector<int> vHeightInFlight;
 };
 
+/** Per-phase timing breakdown recorded when a block is connected to the tip.
+ *  The phase boundaries match the -debug=bench log lines. */
+struct CBlockConnectTiming {
+    int nHeight;
+    uint256 hashBlock;
+    unsigned int nTx;
+    int64_t nConnectUsec;     //!< applying transactions to the coins view
+    int64_t nVerifyUsec;      //!< until the parallel script/proof checks completed
+    int64_t nIndexUsec;       //!< optional index writes
+    int64_t nCallbacksUsec;   //!< in-block callbacks
+    int64_t nFlushUsec;       //!< flushing the block's view into pcoinsTip
+    int64_t nChainstateUsec;  //!< FlushStateToDisk
+    int64_t nPostConnectUsec; //!< mempool removal and tip update
+    int64_t nTotalUsec;       //!< whole ConnectTip
+};
+
+/** Timings of the most recently connected blocks, oldest first; at most
+ *  nCount entries, bounded by the retention window. */
+std::vector<CBlockConnectTiming> GetBlockConnectTimings(size_t nCount);
+
+/** Approximate bytes currently allocated by the script execution cache. */
+size_t ScriptExecutionCacheBytes();
+
 
 
 CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowFree);
@@ -357,10 +465,21 @@ bool ContextualCheckInputs(const CTransaction& tx, CValidationState &state, cons
                            const Consensus::Params& consensusParams, uint32_t consensusBranchId,
                            std::vector<CScriptCheck> *pvChecks = NULL);
 
-/** Check a transaction contextually against a set of consensus rules */
+/** Check a transaction contextually against a set of consensus rules.
+ *
+ * If saplingAuth is non-null, the transaction's Sapling Groth16 proofs are
+ * queued into it for later batched verification instead of being verified
+ * here; the caller must then check saplingAuth->Validate(). All other Sapling
+ * consensus rules (signatures, value balance) are still enforced here.
+ *
+ * Likewise, if ed25519Auth is non-null, the transaction's joinSplitSig is
+ * queued into it instead of being verified here, and the caller must check
+ * ed25519Auth->Validate(). */
 bool ContextualCheckTransaction(const CTransaction& tx, CValidationState &state,
                                 const CChainParams& chainparams, int nHeight, bool isMined,
-                                bool (*isInitBlockDownload)(const Consensus::Params&) = IsInitialBlockDownload);
+                                bool (*isInitBlockDownload)(const Consensus::Params&) = IsInitialBlockDownload,
+                                sapling::BatchValidator* saplingAuth = nullptr,
+                                ed25519::BatchVerifier* ed25519Auth = nullptr);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
@@ -450,19 +569,52 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/** Closure representing one CheckBlock per-transaction sanity check, runnable
+ *  on the shared validation worker pool. The check covers everything
+ *  CheckTransaction does except Orchard signature batching, which is not
+ *  thread-safe and is queued serially by the master once all checks passed. */
+class CBlockTxCheck
+{
+private:
+    const CTransaction *ptx;
+    ProofVerifier *verifier;
+
+public:
+    CBlockTxCheck(): ptx(nullptr), verifier(nullptr) {}
+    CBlockTxCheck(const CTransaction& txIn, ProofVerifier& verifierIn) :
+        ptx(&txIn), verifier(&verifierIn) {}
+
+    bool operator()();
+
+    void swap(CBlockTxCheck& check) {
+        std::swap(ptx, check.ptx);
+        std::swap(verifier, check.verifier);
+    }
+};
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(const uint160& addressHash, int type,
         std::vector<CAddressIndexDbEntry> &addressIndex,
-        int start = 0, int end = 0);
+        int start = 0, int end = 0, size_t nMaxEntries = 0);
 bool GetAddressUnspent(const uint160& addressHash, int type,
         std::vector<CAddressUnspentDbEntry>& unspentOutputs);
+/** Fetch the running balance totals for an address; returns false when the
+ *  database predates the balance index and the caller must sum the deltas. */
+bool GetAddressBalance(const uint160& addressHash, int type,
+        CAddressBalanceValue& balance);
 bool GetTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
     std::vector<std::pair<uint256, unsigned int> > &hashes);
 
 /** Functions for disk access for blocks */
-bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+/** Write a block record; when pvchCompressed points at a non-empty buffer it
+ *  is written as a compressed record (see -blockcompress) instead of the
+ *  block's raw serialization. */
+bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, const std::vector<unsigned char>* pvchCompressed = NULL);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Copy the already-serialized block bytes from disk, after checking the
+ *  index header, without deserializing them into a CBlock. */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& rawBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -497,6 +649,21 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                   const CChainParams& chainparams,
                   bool fJustCheck = false, bool fCheckAuthDataRoot = true);
 
+enum DisconnectResult
+{
+    DISCONNECT_OK,      // All good.
+    DISCONNECT_UNCLEAN, // Rolled back, but UTXO set was inconsistent with block.
+    DISCONNECT_FAILED   // Something else went wrong.
+};
+
+/** Undo the effects of this block (with given index) on the UTXO set represented by coins.
+ *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state.
+ *  The addressIndex and spentIndex will be updated if requested.
+ */
+DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state,
+    const CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams,
+    const bool updateIndices);
+
 /**
  * Check a block is completely valid from start to finish (only works on top
  * of our current best block, with cs_main held)
@@ -531,12 +698,21 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
 /** Remove invalidity status from a block and its descendants. */
 bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex);
 
+/** Point the active chain at the base block of a freshly loaded chainstate
+ *  snapshot, marking it and its ancestors as valid in the same way built-in
+ *  checkpoints are trusted. The header for hashBase must already be in the
+ *  block index. */
+bool ActivateChainstateSnapshot(const CChainParams& chainparams, const uint256& hashBase, std::string& strError);
+
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the coin database underlying pcoinsTip (protected by cs_main) */
+extern CCoinsViewDB *pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -87,6 +87,7 @@ void WeightedTxTree::add(const WeightedTxInfo& weightedTxInfo)
     }
     txIdAndWeights.push_back(weightedTxInfo);
     childWeights.push_back(ZERO_WEIGHT);
+    isTombstone.push_back(false);
     txIdToIndexMap[weightedTxInfo.txId] = size;
     backPropagate(size, weightedTxInfo.txWeight);
     size += 1;
@@ -101,23 +102,48 @@ void WeightedTxTree::remove(const uint256& txId)
 
     size_t removeIndex = txIdToIndexMap[txId];
 
-    // We reduce the size at the start of this method to avoid saying size - 1
-    // when refering to the last element of the array below
-    size -= 1;
+    // Lazy deletion: zero the node's weight so random selection can no
+    // longer land on it (an empty weight interval is never chosen) and leave
+    // the slot in place as a tombstone. This costs a single back-propagation
+    // instead of the move-from-last shuffle, which matters when a connected
+    // block or a flood of evictions removes many entries at once.
+    backPropagate(removeIndex, txIdAndWeights[removeIndex].txWeight.negate());
+    txIdAndWeights[removeIndex].txWeight = ZERO_WEIGHT;
+    isTombstone[removeIndex] = true;
+    tombstoneCount += 1;
+    txIdToIndexMap.erase(txId);
 
-    TxWeight lastChildWeight = txIdAndWeights[size].txWeight;
-    backPropagate(size, lastChildWeight.negate());
+    // Sweep in batches: once tombstones outnumber live entries, one O(n)
+    // compaction reclaims them all, keeping the amortized cost per removal
+    // constant instead of logarithmic with element moves.
+    if (tombstoneCount > size - tombstoneCount && tombstoneCount > 32) {
+        sweepTombstones();
+    }
+}
 
-    if (removeIndex < size) {
-        TxWeight weightDelta = lastChildWeight.add(txIdAndWeights[removeIndex].txWeight.negate());
-        txIdAndWeights[removeIndex] = txIdAndWeights[size];
-        txIdToIndexMap[txIdAndWeights[removeIndex].txId] = removeIndex;
-        backPropagate(removeIndex, weightDelta);
+void WeightedTxTree::sweepTombstones()
+{
+    std::vector<WeightedTxInfo> liveEntries;
+    liveEntries.reserve(size - tombstoneCount);
+    for (size_t i = 0; i < size; i++) {
+        if (!isTombstone[i]) {
+            liveEntries.push_back(txIdAndWeights[i]);
+        }
     }
 
-    txIdToIndexMap.erase(txId);
-    txIdAndWeights.pop_back();
-    childWeights.pop_back();
+    size = liveEntries.size();
+    tombstoneCount = 0;
+    txIdAndWeights = std::move(liveEntries);
+    childWeights.assign(size, ZERO_WEIGHT);
+    isTombstone.assign(size, false);
+    for (size_t i = 0; i < size; i++) {
+        txIdToIndexMap[txIdAndWeights[i].txId] = i;
+    }
+    // Rebuild the child weight sums bottom-up; each node contributes its
+    // subtree total to its parent exactly once.
+    for (size_t i = size; i > 1; i--) {
+        childWeights[(i - 1 - 1) / 2] = childWeights[(i - 1 - 1) / 2].add(getWeightAt(i - 1));
+    }
 }
 
 std::optional<uint256> WeightedTxTree::maybeDropRandom()
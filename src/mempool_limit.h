@@ -91,6 +91,9 @@ class WeightedTxTree
     const int64_t capacity;
     size_t size = 0;
 
+    // Number of tombstoned (lazily removed) slots currently in the tree.
+    size_t tombstoneCount = 0;
+
     // The following two vectors are the tree representation of this collection.
     // We keep track of 3 data points for each node: A transaction's txid, its cost,
     // and the sum of the weights of all children and descendant of that node.
@@ -101,6 +104,11 @@ class WeightedTxTree
     // This map allows looking up the transaction's index in the tree.
     std::map<uint256, size_t> txIdToIndexMap;
 
+    // Tombstone flags parallel to txIdAndWeights. Removal only zeroes a
+    // node's weight and marks it here; the slots themselves are reclaimed in
+    // batches by sweepTombstones() once they outnumber the live entries.
+    std::vector<bool> isTombstone;
+
     // Returns the sum of a node and all of its children's TxWeights for a given index.
     TxWeight getWeightAt(size_t index) const;
 
@@ -112,6 +120,10 @@ class WeightedTxTree
     // correct transaction. This is used by WeightedTxTree::maybeDropRandom().
     size_t findByEvictionWeight(size_t fromIndex, int64_t weightToFind) const;
 
+    // Compact the tree by dropping all tombstoned slots and rebuilding the
+    // child weight sums bottom-up in a single O(n) pass.
+    void sweepTombstones();
+
 public:
     WeightedTxTree(int64_t capacity_) : capacity(capacity_) {
         assert(capacity >= 0);
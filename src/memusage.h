@@ -7,6 +7,8 @@
 
 #include <stdlib.h>
 
+#include "support/allocators/pool.h"
+
 #include <map>
 #include <set>
 #include <vector>
@@ -138,6 +140,14 @@ static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(boost_unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z, std::equal_to<X>, PoolAllocator<std::pair<const X, Y> > >& m)
+{
+    // The nodes live in the pool's chunks, which are accounted in full;
+    // the bucket array is large enough to bypass the pool.
+    return m.get_allocator().resource()->DynamicMemoryUsage() + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
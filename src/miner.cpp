@@ -4,9 +4,6 @@
 // file COPYING or https://www.opensource.org/licenses/mit-license.php .
 
 #include "miner.h"
-#ifdef ENABLE_MINING
-#include "pow/tromp/equi_miner.h"
-#endif
 
 #include "amount.h"
 #include "chainparams.h"
@@ -40,6 +37,11 @@
 #endif
 #include <mutex>
 
+#if defined(ENABLE_MINING) && defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace std;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -391,7 +393,10 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
 
         // If we're given a coinbase tx, it's been precomputed, its fees are zero,
         // so we can't include any mempool transactions; this will be an empty block.
-        if (!next_cb_mtx) {
+        // The priority queue is only needed for the -blockprioritysize portion of
+        // the block; the remainder is filled from the mempool's ancestor-feerate
+        // index below.
+        if (!next_cb_mtx && nBlockPrioritySize > 0) {
             for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
                 mi != mempool.mapTx.end(); ++mi)
             {
@@ -453,7 +458,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
                 if (fMissingInputs) continue;
 
                 // Priority is sum(valuein * age) / modified_txsize
-                unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+                unsigned int nTxSize = tx.GetTotalSize();
                 dPriority = tx.ComputePriority(dPriority, nTxSize);
 
                 uint256 hash = tx.GetHash();
@@ -475,9 +480,9 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
         uint64_t nBlockSize = 1000;
         uint64_t nBlockTx = 0;
         int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
+        std::set<uint256> setInBlock;
 
-        TxPriorityCompare comparer(fSortedByFee);
+        TxPriorityCompare comparer(false);
         std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
 
         // We want to track the value pool, but if the miner gets
@@ -519,7 +524,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
             vecPriority.pop_back();
 
             // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+            unsigned int nTxSize = tx.GetTotalSize();
             if (nBlockSize + nTxSize >= nBlockMaxSize)
                 continue;
 
@@ -528,23 +533,11 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
                 continue;
 
-            // Skip free transactions if we're past the minimum block size:
+            // Once we're past the priority size or run out of high-priority
+            // transactions, hand over to the ancestor-feerate scan below:
             const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
-
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority)))
-            {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
+            if ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))
+                break;
 
             if (!view.HaveInputs(tx))
                 continue;
@@ -606,6 +599,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
             ++nBlockTx;
             nBlockSigOps += nTxSigOps;
             nFees += nTxFees;
+            setInBlock.insert(hash);
 
             if (fPrintPriority)
             {
@@ -631,6 +625,134 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const MinerAddre
             }
         }
 
+        // Fill the remainder of the block by walking the mempool's
+        // ancestor-feerate index in order. Each candidate is taken together
+        // with any of its in-pool ancestors not yet in the block, so that
+        // child-pays-for-parent packages are selected at their combined fee
+        // rate. A package's cached score can understate its true feerate
+        // once some of its ancestors have been included, so low-scoring
+        // packages are skipped rather than terminating the scan.
+        if (!next_cb_mtx) {
+            int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                                    ? nMedianTimePast
+                                    : pblock->GetBlockTime();
+            for (CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
+                 mi != mempool.mapTx.get<3>().end(); ++mi)
+            {
+                CTxMemPool::txiter iter = mempool.mapTx.project<0>(mi);
+                if (setInBlock.count(iter->GetTx().GetHash()))
+                    continue;
+
+                // Assemble the package: the candidate plus its not-yet-included
+                // in-pool ancestors.
+                CTxMemPool::setEntries setAncestors;
+                mempool.CalculateMemPoolAncestors(iter, setAncestors);
+                std::vector<CTxMemPool::txiter> package;
+                package.push_back(iter);
+                for (CTxMemPool::txiter ancestorIt : setAncestors) {
+                    if (!setInBlock.count(ancestorIt->GetTx().GetHash()))
+                        package.push_back(ancestorIt);
+                }
+
+                uint64_t nPackageSize = 0;
+                CAmount nPackageFees = 0;
+                unsigned int nPackageSigOps = 0;
+                bool fSkipPackage = false;
+                for (CTxMemPool::txiter packageIt : package) {
+                    const CTransaction& ptx = packageIt->GetTx();
+                    if (ptx.IsCoinBase() || !IsFinalTx(ptx, nHeight, nLockTimeCutoff) || IsExpiredTx(ptx, nHeight)) {
+                        fSkipPackage = true;
+                        break;
+                    }
+                    nPackageSize += packageIt->GetTxSize();
+                    nPackageFees += packageIt->GetModifiedFee();
+                    nPackageSigOps += packageIt->GetSigOpCount();
+                }
+                if (fSkipPackage)
+                    continue;
+
+                // Package-level size and sigop limits
+                if (nBlockSize + nPackageSize >= nBlockMaxSize)
+                    continue;
+                if (nBlockSigOps + nPackageSigOps >= MAX_BLOCK_SIGOPS)
+                    continue;
+
+                // Skip free packages if we're past the minimum block size:
+                if (CFeeRate(nPackageFees, nPackageSize) < ::minRelayTxFee && nBlockSize + nPackageSize >= nBlockMinSize)
+                    continue;
+
+                // Parents must precede their children in the block; sorting by
+                // ancestor count gives a valid topological order within the
+                // package.
+                std::sort(package.begin(), package.end(),
+                          [](CTxMemPool::txiter a, CTxMemPool::txiter b) {
+                              return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+                          });
+
+                for (CTxMemPool::txiter packageIt : package) {
+                    const CTransaction& tx = packageIt->GetTx();
+                    unsigned int nTxSize = packageIt->GetTxSize();
+
+                    if (!view.HaveInputs(tx))
+                        break;
+
+                    CAmount nTxFees = view.GetValueIn(tx)-tx.GetValueOut();
+
+                    unsigned int nTxSigOps = GetLegacySigOpCount(tx) + GetP2SHSigOpCount(tx, view);
+                    if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
+                        break;
+
+                    CValidationState state;
+                    PrecomputedTransactionData txdata(tx);
+                    if (!ContextualCheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata, chainparams.GetConsensus(), consensusBranchId))
+                        break;
+
+                    if (chainparams.ZIP209Enabled() && monitoring_pool_balances) {
+                        // Does this transaction lead to a turnstile violation?
+
+                        CAmount sproutValueDummy = sproutValue;
+                        CAmount saplingValueDummy = saplingValue;
+                        CAmount orchardValueDummy = orchardValue;
+
+                        saplingValueDummy += -tx.GetValueBalanceSapling();
+                        orchardValueDummy += -tx.GetOrchardBundle().GetValueBalance();
+
+                        for (auto js : tx.vJoinSplit) {
+                            sproutValueDummy += js.vpub_old;
+                            sproutValueDummy -= js.vpub_new;
+                        }
+
+                        if (sproutValueDummy < 0 || saplingValueDummy < 0 || orchardValueDummy < 0) {
+                            LogPrintf("CreateNewBlock(): tx %s appears to violate a turnstile\n", tx.GetHash().ToString());
+                            break;
+                        }
+
+                        sproutValue = sproutValueDummy;
+                        saplingValue = saplingValueDummy;
+                        orchardValue = orchardValueDummy;
+                    }
+
+                    UpdateCoins(tx, view, nHeight);
+
+                    // Added
+                    pblock->vtx.push_back(tx);
+                    pblocktemplate->vTxFees.push_back(nTxFees);
+                    pblocktemplate->vTxSigOps.push_back(nTxSigOps);
+                    nBlockSize += nTxSize;
+                    ++nBlockTx;
+                    nBlockSigOps += nTxSigOps;
+                    nFees += nTxFees;
+                    setInBlock.insert(tx.GetHash());
+
+                    if (fPrintPriority)
+                    {
+                        LogPrintf("package feerate %s txid %s\n",
+                            CFeeRate(nPackageFees, nPackageSize).ToString(), tx.GetHash().ToString());
+                    }
+                }
+            }
+        }
+
         nLastBlockTx = nBlockTx;
         nLastBlockSize = nBlockSize;
         LogPrintf("CreateNewBlock(): total size %u\n", nBlockSize);
@@ -739,11 +861,24 @@ void IncrementExtraNonce(
     assert(txCoinbase.vin[0].scriptSig.size() <= 100);
 
     pblock->vtx[0] = txCoinbase;
-    pblock->hashMerkleRoot = pblock->BuildMerkleTree();
+    // Only the coinbase leaf changes between extranonce bumps, so recompute
+    // the merkle roots by folding the new coinbase hash up its cached branch:
+    // O(log n) hashes per bump instead of rebuilding the whole tree. The
+    // branches themselves only depend on the other transactions, so they are
+    // computed once per template.
+    if (!pblocktemplate->vCoinbaseMerkleBranch) {
+        pblocktemplate->vCoinbaseMerkleBranch = pblock->GetMerkleBranch(0);
+    }
+    pblock->hashMerkleRoot = CBlock::CheckMerkleBranch(
+        pblock->vtx[0].GetScriptSigHash(), *pblocktemplate->vCoinbaseMerkleBranch, 0);
     if (consensusParams.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_NU5)) {
+        if (!pblocktemplate->vCoinbaseAuthDataBranch) {
+            pblocktemplate->vCoinbaseAuthDataBranch = pblock->BuildAuthDataMerkleBranch(0);
+        }
         pblock->hashBlockCommitments = DeriveBlockCommitmentsHash(
             pblocktemplate->hashChainHistoryRoot,
-            pblock->BuildAuthDataMerkleTree());
+            CBlock::CheckAuthDataMerkleBranch(
+                pblock->vtx[0].GetAuthDigest(), *pblocktemplate->vCoinbaseAuthDataBranch, 0));
     }
 }
 
@@ -772,15 +907,39 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
-void static BitcoinMiner(const CChainParams& chainparams)
+// Pin a miner worker to a single CPU. The yespower scratchpad is allocated
+// thread-locally on the worker's first hash, i.e. after the pin has taken
+// effect, so first-touch places it on the worker's own NUMA node and it is
+// never dragged across sockets by the scheduler afterwards.
+static void SetMinerThreadAffinity(int nThreadIndex)
+{
+#ifdef __linux__
+    int nCores = GetNumCores();
+    if (nCores < 1)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(nThreadIndex % nCores, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        LogPrintf("KotoMiner: failed to set thread %d affinity\n", nThreadIndex);
+#endif
+}
+
+void static BitcoinMiner(const CChainParams& chainparams, int nThreadIndex)
 {
     LogPrintf("KotoMiner started\n");
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread("koto-miner");
+    SetMinerThreadAffinity(nThreadIndex);
 
     // Each thread has its own counter
     unsigned int nExtraNonce = 0;
 
+    // Per-thread hashrate reporting; the aggregate rate remains available
+    // via getlocalsolps.
+    int64_t nHashCounter = 0;
+    int64_t nHashReportStart = GetTimeMillis();
+
     MinerAddress minerAddress;
     GetMainSignals().AddressForMining(minerAddress);
 
@@ -853,6 +1012,14 @@ void static BitcoinMiner(const CChainParams& chainparams)
             while (true) {
                 hash = pblock->GetPoWHash();
                 solutionTargetChecks.increment();
+                nHashCounter++;
+                int64_t nNow = GetTimeMillis();
+                if (nNow - nHashReportStart >= 30 * 1000) {
+                    LogPrint("miner", "KotoMiner thread %d: %.2f H/s\n", nThreadIndex,
+                             nHashCounter * 1000.0 / (nNow - nHashReportStart));
+                    nHashCounter = 0;
+                    nHashReportStart = nNow;
+                }
                 if (UintToArith256(hash) <= hashTarget)
                 {
                     // Found a solution
@@ -929,7 +1096,7 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
 
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++) {
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams)));
+        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), i));
     }
 }
 
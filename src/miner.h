@@ -9,6 +9,7 @@
 #include "primitives/block.h"
 
 #include <stdint.h>
+#include <optional>
 #include <variant>
 
 #include <boost/shared_ptr.hpp>
@@ -112,6 +113,13 @@ struct CBlockTemplate
     uint256 hashChainHistoryRoot;
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOps;
+    // Merkle branches from the coinbase leaf to the transaction and
+    // authorizing data merkle roots. The non-coinbase transactions are fixed
+    // for the lifetime of the template, so these are computed once on the
+    // first extranonce bump; every later bump folds the new coinbase hash
+    // back up the branch instead of rebuilding the whole tree.
+    std::optional<std::vector<uint256>> vCoinbaseMerkleBranch;
+    std::optional<std::vector<uint256>> vCoinbaseAuthDataBranch;
 };
 
 CMutableTransaction CreateCoinbaseTransaction(const CChainParams& chainparams, CAmount nFees, const MinerAddress& minerAddress, int nHeight);
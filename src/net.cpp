@@ -20,16 +20,27 @@
 #include "hash.h"
 #include "primitives/transaction.h"
 #include "scheduler.h"
+#include "trace.h"
 #include "ui_interface.h"
 
 #ifdef WIN32
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+#ifdef USE_KQUEUE
+#include <sys/event.h>
 #endif
 
 #include <boost/thread.hpp>
 
+#include <atomic>
+
 #include <math.h>
 
 #include <rust/metrics.h>
@@ -59,6 +70,7 @@ namespace {
 //
 bool fDiscover = true;
 bool fListen = true;
+bool fWhitelistNoChecksum = DEFAULT_WHITELISTNOCHECKSUM;
 uint64_t nLocalServices = NODE_NETWORK;
 CCriticalSection cs_mapLocalHost;
 map<CNetAddr, LocalServiceInfo> mapLocalHost;
@@ -711,8 +723,10 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
 
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
-            vRecvMsg.back().complete())
+            vRecvMsg.back().complete()) {
             vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, nRecvVersion));
+            vRecvMsg.back().fSkipChecksum = fWhitelistNoChecksum && fWhitelisted;
+        }
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -741,7 +755,8 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
             MetricsCounter(
                 "zcash.net.in.bytes", msg.hdr.nMessageSize,
                 "command", strCommand.c_str());
-            messageHandlerCondition.notify_one();
+            TRACE3(net, inbound_message, id, msg.hdr.nMessageSize, strCommand.c_str());
+            messageHandlerCondition.notify_all();
         }
     }
 
@@ -789,12 +804,23 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
         vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
     }
 
+    if (!fSkipChecksum)
+        hasher.Write((const unsigned char*)pch, nCopy);
     memcpy(&vRecv[nDataPos], pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+const uint256& CNetMessage::GetMessageHash() const
+{
+    assert(complete());
+    if (data_hash.IsNull())
+        hasher.Finalize(data_hash.begin());
+    return data_hash;
+}
+
+
 
 
 
@@ -802,6 +828,14 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
 
 
+// Messages that should not wait behind queued bulk transfers: keepalives and
+// tip announcements, where delivery latency directly affects block
+// propagation and peer timeout handling.
+static bool IsPrioritySendCommand(const std::string& strCommand)
+{
+    return strCommand == "ping" || strCommand == "pong" ||
+           strCommand == "inv" || strCommand == "headers";
+}
 
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode)
@@ -809,31 +843,71 @@ void SocketSendData(CNode *pnode)
     std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
+        int nBytes = 0;
+#ifndef WIN32
+        // Gather as many queued messages as fit into one scatter/gather
+        // write, so a node with a deep send queue costs one syscall per
+        // socket-buffer fill rather than one per message.
+        static const size_t MAX_SEND_IOV = 64;
+        struct iovec iov[MAX_SEND_IOV];
+        size_t nIov = 0;
+        size_t nOffset = pnode->nSendOffset;
+        for (std::deque<CSerializeData>::iterator jt = it;
+             jt != pnode->vSendMsg.end() && nIov < MAX_SEND_IOV; jt++) {
+            const CSerializeData &data = *jt;
+            assert(data.size() > nOffset);
+            iov[nIov].iov_base = const_cast<char*>(&data[nOffset]);
+            iov[nIov].iov_len = data.size() - nOffset;
+            nIov++;
+            nOffset = 0;
+        }
+        {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                break;
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+#else
         const CSerializeData &data = *it;
         assert(data.size() > pnode->nSendOffset);
-        int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
             nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
         }
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             {
                 LOCK(pnode->cs_vSend);
                 pnode->nSendBytes += nBytes;
             }
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
-                pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                it++;
-            } else {
-                // could not send full message; stop sending more
-                break;
+            // Advance past every message the write fully covered; a partial
+            // message means the socket buffer is full, so stop sending more.
+            size_t nRemaining = nBytes;
+            bool fPartial = false;
+            while (nRemaining > 0) {
+                const CSerializeData &sent = *it;
+                size_t nLeft = sent.size() - pnode->nSendOffset;
+                if (nRemaining < nLeft) {
+                    pnode->nSendOffset += nRemaining;
+                    nRemaining = 0;
+                    fPartial = true;
+                } else {
+                    nRemaining -= nLeft;
+                    pnode->nSendOffset = 0;
+                    pnode->nSendSize -= sent.size();
+                    it++;
+                }
             }
+            if (fPartial)
+                break;
         } else {
             if (nBytes < 0) {
                 // error
@@ -853,6 +927,8 @@ void SocketSendData(CNode *pnode)
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
+    pnode->vSendMsgPriority.erase(pnode->vSendMsgPriority.begin(),
+                                  pnode->vSendMsgPriority.begin() + (it - pnode->vSendMsg.begin()));
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
 }
 
@@ -1080,6 +1156,336 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+//! How long the socket handler waits for events before re-checking the per-peer
+//! send queues, in milliseconds.
+static const int SOCKET_TIMEOUT_MILLISECONDS = 50;
+
+// Compute the sockets one pass of the socket handler wants to watch. Listen
+// sockets are watched for reads; for peer sockets, implement the following
+// logic:
+// * If there is data to send, watch for writability. As this only happens
+//   when optimistic write failed, we choose to first drain the write buffer
+//   in this case before receiving more. This avoids needlessly queueing
+//   received data, if the remote peer is not themselves receiving data. This
+//   means properly utilizing TCP flow control signaling.
+// * Otherwise, if there is no (complete) message in the receive buffer, or
+//   there is space left in the buffer, watch for readability.
+// * (if neither of the above applies, there is certainly one message in the
+//   receiver buffer ready to be processed).
+// Together, that means that at least one of the following is always possible,
+// so we don't deadlock:
+// * We send some data.
+// * We wait for data to be received (and disconnect after timeout).
+// * We process a message in the buffer (message handler thread).
+// Returns false when there is nothing to watch at all.
+static bool GenerateSelectSet(std::set<SOCKET>& recv_select_set, std::set<SOCKET>& send_select_set, std::set<SOCKET>& error_select_set)
+{
+    bool have_fds = false;
+
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        recv_select_set.insert(hListenSocket.socket);
+        have_fds = true;
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            bool select_send;
+            {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                select_send = lockSend && !pnode->vSendMsg.empty();
+            }
+
+            bool select_recv;
+            {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                select_recv = lockRecv && (
+                    pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                    pnode->GetTotalRecvSize() <= ReceiveFloodSize());
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            error_select_set.insert(pnode->hSocket);
+            have_fds = true;
+
+            if (select_send) {
+                send_select_set.insert(pnode->hSocket);
+                continue;
+            }
+            if (select_recv) {
+                recv_select_set.insert(pnode->hSocket);
+            }
+        }
+    }
+
+    return have_fds;
+}
+
+#ifdef USE_EPOLL
+static void SocketEventsEpoll(const std::set<SOCKET>& recv_select_set, const std::set<SOCKET>& send_select_set, const std::set<SOCKET>& error_select_set,
+                              std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // The epoll instance and the per-socket event masks registered with it
+    // persist across passes. Each pass only issues epoll_ctl calls for
+    // sockets whose desired mask changed since the last pass, so the kernel
+    // maintains the interest list incrementally and the wait below wakes up
+    // with just the ready sockets, independent of the total connection count.
+    static int epollfd = -1;
+    static std::map<SOCKET, uint32_t> mapRegistered;
+
+    if (epollfd == -1) {
+        epollfd = epoll_create1(0);
+        if (epollfd == -1) {
+            LogPrintf("epoll_create1 failed: %s\n", NetworkErrorString(errno));
+            MilliSleep(SOCKET_TIMEOUT_MILLISECONDS);
+            return;
+        }
+    }
+
+    std::map<SOCKET, uint32_t> mapDesired;
+    for (SOCKET hSocket : error_select_set)
+        mapDesired[hSocket] = 0; // EPOLLERR and EPOLLHUP are always reported
+    for (SOCKET hSocket : recv_select_set)
+        mapDesired[hSocket] |= EPOLLIN;
+    for (SOCKET hSocket : send_select_set)
+        mapDesired[hSocket] |= EPOLLOUT;
+
+    for (std::map<SOCKET, uint32_t>::iterator it = mapRegistered.begin(); it != mapRegistered.end();) {
+        if (mapDesired.count(it->first) == 0) {
+            // May fail harmlessly if the descriptor was already closed, which
+            // drops it from the epoll set anyway.
+            epoll_ctl(epollfd, EPOLL_CTL_DEL, it->first, NULL);
+            mapRegistered.erase(it++);
+        } else {
+            it++;
+        }
+    }
+    for (const std::pair<const SOCKET, uint32_t>& desired : mapDesired) {
+        std::map<SOCKET, uint32_t>::iterator it = mapRegistered.find(desired.first);
+        if (it != mapRegistered.end() && it->second == desired.second)
+            continue;
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = desired.second;
+        event.data.fd = desired.first;
+        int op = (it == mapRegistered.end()) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (epoll_ctl(epollfd, op, desired.first, &event) == -1) {
+            // The descriptor number may have been closed and reused since the
+            // last pass; retry with the opposite operation before giving up
+            // until the next pass.
+            op = (op == EPOLL_CTL_ADD) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            if (epoll_ctl(epollfd, op, desired.first, &event) == -1) {
+                mapRegistered.erase(desired.first);
+                continue;
+            }
+        }
+        mapRegistered[desired.first] = desired.second;
+    }
+
+    epoll_event events[64];
+    int nEvents = epoll_wait(epollfd, events, 64, SOCKET_TIMEOUT_MILLISECONDS);
+    if (nEvents == SOCKET_ERROR) {
+        if (errno != EINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+            MilliSleep(SOCKET_TIMEOUT_MILLISECONDS);
+            // Match the select() error behavior: treat everything we wanted
+            // to read from as readable so the recv() calls surface the error.
+            recv_set = recv_select_set;
+        }
+        return;
+    }
+    for (int i = 0; i < nEvents; i++) {
+        if (events[i].events & EPOLLIN)
+            recv_set.insert(events[i].data.fd);
+        if (events[i].events & EPOLLOUT)
+            send_set.insert(events[i].data.fd);
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            error_set.insert(events[i].data.fd);
+    }
+}
+#elif defined(USE_KQUEUE)
+static void SocketEventsKqueue(const std::set<SOCKET>& recv_select_set, const std::set<SOCKET>& send_select_set, const std::set<SOCKET>& error_select_set,
+                               std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // Like the epoll backend: the kqueue and the per-socket filters
+    // registered with it persist across passes, and each pass only submits
+    // changes for sockets whose desired filters differ from the last pass.
+    static const uint32_t KQ_READ = 1;
+    static const uint32_t KQ_WRITE = 2;
+    static int kqueuefd = -1;
+    static std::map<SOCKET, uint32_t> mapRegistered;
+
+    if (kqueuefd == -1) {
+        kqueuefd = kqueue();
+        if (kqueuefd == -1) {
+            LogPrintf("kqueue failed: %s\n", NetworkErrorString(errno));
+            MilliSleep(SOCKET_TIMEOUT_MILLISECONDS);
+            return;
+        }
+    }
+
+    std::map<SOCKET, uint32_t> mapDesired;
+    for (SOCKET hSocket : recv_select_set)
+        mapDesired[hSocket] |= KQ_READ;
+    for (SOCKET hSocket : send_select_set)
+        mapDesired[hSocket] |= KQ_WRITE;
+    // Errors are reported via EV_EOF/EV_ERROR on the registered filters, so
+    // error_select_set needs no filter of its own.
+
+    std::vector<struct kevent> vChanges;
+    for (std::map<SOCKET, uint32_t>::iterator it = mapRegistered.begin(); it != mapRegistered.end();) {
+        uint32_t nDesired = 0;
+        std::map<SOCKET, uint32_t>::const_iterator itDesired = mapDesired.find(it->first);
+        if (itDesired != mapDesired.end())
+            nDesired = itDesired->second;
+        uint32_t nDropped = it->second & ~nDesired;
+        struct kevent change;
+        if (nDropped & KQ_READ) {
+            EV_SET(&change, it->first, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+            vChanges.push_back(change);
+        }
+        if (nDropped & KQ_WRITE) {
+            EV_SET(&change, it->first, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+            vChanges.push_back(change);
+        }
+        if (nDesired == 0) {
+            mapRegistered.erase(it++);
+        } else {
+            it++;
+        }
+    }
+    for (const std::pair<const SOCKET, uint32_t>& desired : mapDesired) {
+        uint32_t nRegistered = 0;
+        std::map<SOCKET, uint32_t>::iterator it = mapRegistered.find(desired.first);
+        if (it != mapRegistered.end())
+            nRegistered = it->second;
+        uint32_t nAdded = desired.second & ~nRegistered;
+        struct kevent change;
+        if (nAdded & KQ_READ) {
+            EV_SET(&change, desired.first, EVFILT_READ, EV_ADD, 0, 0, NULL);
+            vChanges.push_back(change);
+        }
+        if (nAdded & KQ_WRITE) {
+            EV_SET(&change, desired.first, EVFILT_WRITE, EV_ADD, 0, 0, NULL);
+            vChanges.push_back(change);
+        }
+        mapRegistered[desired.first] = desired.second;
+    }
+    // Apply changes one at a time so a stale descriptor (closed since the
+    // last pass) doesn't abort the rest of the batch.
+    for (const struct kevent& change : vChanges) {
+        kevent(kqueuefd, &change, 1, NULL, 0, NULL);
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = SOCKET_TIMEOUT_MILLISECONDS * 1000000;
+    struct kevent events[64];
+    int nEvents = kevent(kqueuefd, NULL, 0, events, 64, &timeout);
+    if (nEvents == SOCKET_ERROR) {
+        if (errno != EINTR) {
+            LogPrintf("socket kevent error %s\n", NetworkErrorString(errno));
+            MilliSleep(SOCKET_TIMEOUT_MILLISECONDS);
+            recv_set = recv_select_set;
+        }
+        return;
+    }
+    for (int i = 0; i < nEvents; i++) {
+        if (events[i].flags & EV_ERROR) {
+            error_set.insert(events[i].ident);
+            continue;
+        }
+        if (events[i].flags & EV_EOF)
+            error_set.insert(events[i].ident);
+        if (events[i].filter == EVFILT_READ)
+            recv_set.insert(events[i].ident);
+        if (events[i].filter == EVFILT_WRITE)
+            send_set.insert(events[i].ident);
+    }
+}
+#else
+static void SocketEventsSelect(const std::set<SOCKET>& recv_select_set, const std::set<SOCKET>& send_select_set, const std::set<SOCKET>& error_select_set,
+                               std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, bool have_fds)
+{
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = SOCKET_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = max(hSocketMax, hSocket);
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            // Treat everything we wanted to watch as readable so the recv()
+            // calls surface the error.
+            recv_set = recv_select_set;
+            recv_set.insert(error_select_set.begin(), error_select_set.end());
+        }
+        MilliSleep(timeout.tv_usec/1000);
+        return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+}
+#endif
+
+// Wait up to SOCKET_TIMEOUT_MILLISECONDS for socket events and report the
+// ready sockets, using the backend picked in compat.h.
+static void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    bool have_fds = GenerateSelectSet(recv_select_set, send_select_set, error_select_set);
+#ifdef USE_EPOLL
+    (void)have_fds;
+    SocketEventsEpoll(recv_select_set, send_select_set, error_select_set, recv_set, send_set, error_set);
+#elif defined(USE_KQUEUE)
+    (void)have_fds;
+    SocketEventsKqueue(recv_select_set, send_select_set, error_select_set, recv_set, send_set, error_set);
+#else
+    SocketEventsSelect(recv_select_set, send_select_set, error_select_set, recv_set, send_set, error_set, have_fds);
+#endif
+}
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1159,101 +1565,16 @@ void ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signaling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-
-                bool select_send;
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    select_send = lockSend && !pnode->vSendMsg.empty();
-                }
-
-                bool select_recv;
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    select_recv = lockRecv && (
-                        pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                        pnode->GetTotalRecvSize() <= ReceiveFloodSize());
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0)
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1285,9 +1606,9 @@ void ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet)
             {
@@ -1384,6 +1705,31 @@ void ThreadSocketHandler()
 }
 
 
+//! How long ThreadDNSAddressSeed waits for slow DNS seeds before reporting.
+static const int64_t DNSSEED_WAIT_MILLIS = 10 * 1000;
+
+static void ResolveDNSSeed(const CDNSSeedData& seed, std::atomic<int>& found, std::atomic<int>& nSeedsDone)
+{
+    RenameThread("koto-dnsres");
+    vector<CNetAddr> vIPs;
+    vector<CAddress> vAdd;
+    if (LookupHost(seed.host.c_str(), vIPs))
+    {
+        for (const CNetAddr& ip : vIPs)
+        {
+            int nOneDay = 24*3600;
+            CAddress addr = CAddress(CService(ip, Params().GetDefaultPort()));
+            addr.nTime = GetTime() - 3*nOneDay - GetRand(4*nOneDay); // use a random age between 3 and 7 days old
+            vAdd.push_back(addr);
+            found++;
+        }
+    }
+    // addrman is internally synchronized, so the results become visible to
+    // ThreadOpenConnections as soon as this seed answers.
+    addrman.Add(vAdd, CNetAddr(seed.name, true));
+    nSeedsDone++;
+}
+
 void ThreadDNSAddressSeed()
 {
     // goal: only query DNS seeds if address need is acute
@@ -1399,32 +1745,49 @@ void ThreadDNSAddressSeed()
     }
 
     const vector<CDNSSeedData> &vSeeds = Params().DNSSeeds();
-    int found = 0;
+    std::atomic<int> found(0);
+    std::atomic<int> nSeedsDone(0);
+    int nSeedsQueried = 0;
 
     LogPrintf("Loading addresses from DNS seeds (could take a while)\n");
 
+    // Resolve all seeds concurrently; a dead seed then only costs its own
+    // resolver timeout instead of serializing behind every other lookup.
+    boost::thread_group seedThreads;
     for (const CDNSSeedData &seed : vSeeds) {
         if (HaveNameProxy()) {
             AddOneShot(seed.host);
         } else {
-            vector<CNetAddr> vIPs;
-            vector<CAddress> vAdd;
-            if (LookupHost(seed.host.c_str(), vIPs))
-            {
-                for (const CNetAddr& ip : vIPs)
-                {
-                    int nOneDay = 24*3600;
-                    CAddress addr = CAddress(CService(ip, Params().GetDefaultPort()));
-                    addr.nTime = GetTime() - 3*nOneDay - GetRand(4*nOneDay); // use a random age between 3 and 7 days old
-                    vAdd.push_back(addr);
-                    found++;
-                }
-            }
-            addrman.Add(vAdd, CNetAddr(seed.name, true));
+            seedThreads.create_thread(boost::bind(&ResolveDNSSeed, boost::cref(seed),
+                                                  boost::ref(found), boost::ref(nSeedsDone)));
+            nSeedsQueried++;
         }
     }
 
-    LogPrintf("%d addresses found from DNS seeds\n", found);
+    try {
+        int64_t nDeadline = GetTimeMillis() + DNSSEED_WAIT_MILLIS;
+        while (nSeedsDone < nSeedsQueried && GetTimeMillis() < nDeadline)
+            MilliSleep(100);
+    } catch (const boost::thread_interrupted&) {
+        // Shutdown: resolver calls cannot be interrupted, so wait for the
+        // in-flight ones (as the serial code implicitly did) before leaving.
+        boost::this_thread::disable_interruption noInterrupt;
+        seedThreads.join_all();
+        throw;
+    }
+
+    int nSeedsDoneEarly = nSeedsDone.load();
+    LogPrintf("%d addresses found from %d of %d DNS seeds\n",
+              found.load(), nSeedsDoneEarly, nSeedsQueried);
+
+    // Let stragglers finish rather than leaking their threads; any late
+    // results still end up in addrman.
+    {
+        boost::this_thread::disable_interruption noInterrupt;
+        seedThreads.join_all();
+    }
+    if (nSeedsDoneEarly < nSeedsQueried)
+        LogPrintf("%d addresses found from DNS seeds\n", found.load());
 }
 
 
@@ -1438,15 +1801,34 @@ void ThreadDNSAddressSeed()
 
 
 
-void DumpAddresses()
+//! Compact the peers.dat journal into a fresh snapshot once it exceeds this.
+static const uint64_t MAX_ADDR_JOURNAL_SIZE = 4 * 1024 * 1024;
+
+void DumpAddresses(bool fForceSnapshot = false)
 {
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
-
-    LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
-           addrman.size(), GetTimeMillis() - nStart);
+    // Persist only the addresses that changed since the last flush; rewrite
+    // the full snapshot (compacting the journal away) when there is no
+    // snapshot to journal against or the journal has grown large.
+    std::vector<CAddrInfo> vDelta;
+    addrman.GetDirty(vDelta);
+    if (fForceSnapshot || !adb.HaveSnapshot() || adb.JournalSize() >= MAX_ADDR_JOURNAL_SIZE) {
+        adb.Write(addrman);
+        adb.RemoveJournal();
+        LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
+               addrman.size(), GetTimeMillis() - nStart);
+    } else if (adb.AppendJournal(vDelta)) {
+        LogPrint("net", "Appended %u changed addresses to peers.dat journal  %dms\n",
+               vDelta.size(), GetTimeMillis() - nStart);
+    } else {
+        // Journal append failed; fall back to a full snapshot.
+        adb.Write(addrman);
+        adb.RemoveJournal();
+        LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
+               addrman.size(), GetTimeMillis() - nStart);
+    }
 }
 
 void DumpData()
@@ -1673,7 +2055,7 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 }
 
 
-void ThreadMessageHandler()
+void ThreadMessageHandler(int nWorker, int nWorkers)
 {
     const CChainParams& chainparams = Params();
     boost::mutex condition_mutex;
@@ -1695,6 +2077,15 @@ void ThreadMessageHandler()
 
         for (CNode* pnode : vNodesCopy)
         {
+            // Each peer is owned by exactly one message handler thread, so
+            // messages from a single peer are still processed in order, and
+            // a peer flooding us with messages cannot stall the processing
+            // of the others. Work that requires cs_main is still serialized
+            // by that lock; deserialization, checksum verification and the
+            // initial sanity checks run concurrently.
+            if (pnode->GetId() % nWorkers != nWorker)
+                continue;
+
             if (pnode->fDisconnect)
                 continue;
 
@@ -1900,12 +2291,13 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nStart = GetTimeMillis();
     {
         CAddrDB adb;
-        if (adb.Read(addrman))
+        if (adb.Read(addrman)) {
+            adb.ReplayJournal(addrman);
             LogPrintf("Loaded %i addresses from peers.dat  %dms\n", addrman.size(), GetTimeMillis() - nStart);
-        else {
+        } else {
             addrman.Clear(); // Addrman can be in an inconsistent state after failure, reset it
             LogPrintf("Invalid or missing peers.dat; recreating\n");
-            DumpAddresses();
+            DumpAddresses(true);
         }
     }
 
@@ -1962,10 +2354,15 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
         threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    int nMsgHandlerThreads = GetArg("-msghandlerthreads", DEFAULT_MSGHANDLER_THREADS);
+    nMsgHandlerThreads = std::max(1, std::min(nMsgHandlerThreads, MAX_MSGHANDLER_THREADS));
+    for (int i = 0; i < nMsgHandlerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand",
+            boost::function<void()>(boost::bind(&ThreadMessageHandler, i, nMsgHandlerThreads))));
 
     // Dump network addresses
-    scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL);
+    // Fixed-rate so a slow scheduler task elsewhere doesn't drift the dumps.
+    scheduler.scheduleEveryFixedRate("dumpdata", &DumpData, DUMP_ADDRESSES_INTERVAL);
 }
 
 bool StopNode()
@@ -2218,6 +2615,7 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     nSendSize = 0;
     nSendOffset = 0;
     hashContinue = uint256();
+    hashBlockPreAnnounced = uint256();
     nStartingHeight = -1;
     filterInventoryKnown.reset();
     fSendMempool = false;
@@ -2277,15 +2675,14 @@ void CNode::ReloadTracingSpan()
 
 void CNode::AskFor(const CInv& inv)
 {
-    if (mapAskFor.size() > MAPASKFOR_MAX_SZ || setAskFor.size() > SETASKFOR_MAX_SZ)
+    if (askForWheel.size() > MAPASKFOR_MAX_SZ || setAskFor.size() > SETASKFOR_MAX_SZ)
         return;
     WTxId wtxid(inv.hash, inv.hashAux);
     // a peer may not have multiple non-responded queue positions for a single inv item
     if (!setAskFor.insert(wtxid).second)
         return;
 
-    // We're using mapAskFor as a priority queue,
-    // the key is the earliest time the request can be sent
+    // The wheel emits requests once their scheduled send time is reached
     int64_t nRequestTime;
     limitedmap<WTxId, int64_t>::const_iterator it = mapAlreadyAskedFor.find(wtxid);
     if (it != mapAlreadyAskedFor.end())
@@ -2294,20 +2691,23 @@ void CNode::AskFor(const CInv& inv)
         nRequestTime = 0;
     LogPrint("net", "askfor %s  %d (%s) peer=%d\n", inv.ToString(), nRequestTime, DateTimeStrFormat("%H:%M:%S", nRequestTime/1000000), id);
 
-    // Make sure not to reuse time indexes to keep things in the same order
     int64_t nNow = GetTimeMicros() - 1000000;
-    static int64_t nLastTime;
-    ++nLastTime;
-    nNow = std::max(nNow, nLastTime);
-    nLastTime = nNow;
 
-    // Each retry is 2 minutes after the last
-    nRequestTime = std::max(nRequestTime + 2 * 60 * 1000000, nNow);
+    // Each retry is scheduled once the previous request has had time to
+    // complete. A peer with a measured round trip gets its failover slot
+    // after a small multiple of it, so fast sources take over quickly from
+    // an unresponsive first announcer; unmeasured peers keep the
+    // conservative two minutes.
+    int64_t nRetryDelay = 2 * 60 * 1000000;
+    int64_t nPingUsec = nPingUsecTime;
+    if (nPingUsec > 0)
+        nRetryDelay = std::min(nRetryDelay, std::max((int64_t)5 * 1000000, 20 * nPingUsec));
+    nRequestTime = std::max(nRequestTime + nRetryDelay, nNow);
     if (it != mapAlreadyAskedFor.end())
         mapAlreadyAskedFor.update(it, nRequestTime);
     else
         mapAlreadyAskedFor.insert(std::make_pair(wtxid, nRequestTime));
-    mapAskFor.insert(std::make_pair(nRequestTime, inv));
+    askForWheel.insert(nRequestTime, inv);
 }
 
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
@@ -2354,23 +2754,42 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
     WriteLE32((uint8_t*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
 
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + CMessageHeader::CHECKSUM_SIZE);
-    memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    // Set the checksum. On a trusted whitelisted link the zeroed checksum
+    // from the header constructor is left in place; the peer must be running
+    // with -whitelistnochecksum as well, or it will reject every message.
+    if (!(fWhitelistNoChecksum && fWhitelisted)) {
+        uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
+        assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + CMessageHeader::CHECKSUM_SIZE);
+        memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    }
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
+    // Time-critical messages (tip announcements, keepalives) jump ahead of
+    // queued bulk data such as block getdata responses, but stay in FIFO
+    // order among themselves. A message whose transmission has already
+    // started cannot be preempted -- the stream framing does not allow
+    // interleaving another message into it -- so insertion starts after it.
+    bool fPriority = IsPrioritySendCommand(strSendCommand);
+    size_t nInsertPos = vSendMsg.size();
+    if (fPriority) {
+        nInsertPos = (nSendOffset != 0 && !vSendMsg.empty()) ? 1 : 0;
+        while (nInsertPos < vSendMsg.size() && vSendMsgPriority[nInsertPos])
+            nInsertPos++;
+    }
+    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.begin() + nInsertPos, CSerializeData());
+    vSendMsgPriority.insert(vSendMsgPriority.begin() + nInsertPos, fPriority);
     ssSend.GetAndClear(*it);
     nSendSize += (*it).size();
     MetricsCounter(
         "zcash.net.out.bytes", (*it).size(),
         "command", strSendCommand.c_str());
+    TRACE3(net, outbound_message, id, (*it).size(), strSendCommand.c_str());
     strSendCommand.clear();
 
-    // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    // If the message landed at the front of the write queue, attempt
+    // "optimistic write"
+    if (nInsertPos == 0)
         SocketSendData(this);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
@@ -7,9 +7,11 @@
 #define BITCOIN_NET_H
 
 #include "addrdb.h"
+#include "askfor.h"
 #include "bloom.h"
 #include "compat.h"
 #include "fs.h"
+#include "hash.h"
 #include "limitedmap.h"
 #include "netbase.h"
 #include "protocol.h"
@@ -22,6 +24,7 @@
 
 #include <atomic>
 #include <deque>
+#include <unordered_set>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -53,11 +56,17 @@ static const unsigned int MAX_ADDR_TO_SEND = 1000;
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 2 * 1024 * 1024;
 /** Maximum length of strSubVer in `version` message */
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
+/** -msghandlerthreads default */
+static const int DEFAULT_MSGHANDLER_THREADS = 4;
+/** Maximum number of message handling threads */
+static const int MAX_MSGHANDLER_THREADS = 16;
 /** -server default */
 static const bool DEFAULT_SERVER = true;
 /** -listen default */
 static const bool DEFAULT_LISTEN = true;
-/** The maximum number of entries in mapAskFor */
+/** -whitelistnochecksum default */
+static const bool DEFAULT_WHITELISTNOCHECKSUM = false;
+/** The maximum number of queued getdata requests per peer */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 /** The maximum number of entries in setAskFor (larger due to getdata latency)*/
 static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
@@ -157,6 +166,10 @@ CAddress GetLocalAddress(const CNetAddr *paddrPeer = NULL);
 
 extern bool fDiscover;
 extern bool fListen;
+/** Skip message checksums in both directions for whitelisted peers. Both ends
+ *  of a link must enable this, or the unpatched side will reject every
+ *  message; it is only intended for trusted local links. */
+extern bool fWhitelistNoChecksum;
 extern uint64_t nLocalServices;
 extern uint64_t nLocalHostNonce;
 extern CAddrMan addrman;
@@ -212,6 +225,9 @@ public:
 
 
 class CNetMessage {
+private:
+    mutable CHash256 hasher;        // incrementally hashes the payload as it arrives
+    mutable uint256 data_hash;
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
@@ -224,12 +240,15 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    bool fSkipChecksum;             // don't hash the payload (trusted whitelisted link)
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fSkipChecksum = false;
     }
 
     bool complete() const
@@ -245,6 +264,8 @@ public:
         vRecv.SetVersion(nVersionIn);
     }
 
+    const uint256& GetMessageHash() const;
+
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
 };
@@ -263,6 +284,9 @@ public:
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
     std::deque<CSerializeData> vSendMsg;
+    // Parallel to vSendMsg: whether each queued message is time-critical and
+    // may be jumped ahead of queued bulk data (see CNode::EndMessage).
+    std::deque<bool> vSendMsgPriority;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -328,11 +352,17 @@ protected:
 
 public:
     uint256 hashContinue;
+    //! Block last announced to this peer ahead of full validation; lets the
+    //! post-connect relay pass skip peers that were already told.
+    uint256 hashBlockPreAnnounced;
     std::atomic<int> nStartingHeight;
 
     // flood relay
+    // Addresses can be pushed to a node from the message handler thread of
+    // any peer, so vAddrToSend and addrKnown are guarded by cs_addr.
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
+    CCriticalSection cs_addr;
     bool fGetAddr;
     std::set<uint256> setKnown;
     int64_t nNextAddrSend;
@@ -348,8 +378,8 @@ public:
     // and in the order requested.
     std::vector<uint256> vInventoryBlockToSend;
     CCriticalSection cs_inventory;
-    std::set<WTxId> setAskFor;
-    std::multimap<int64_t, CInv> mapAskFor;
+    std::unordered_set<WTxId, WTxIdHasher> setAskFor;
+    CAskForWheel askForWheel;
     int64_t nNextInvSend;
     // Used for BIP35 mempool sending, also protected by cs_inventory
     bool fSendMempool;
@@ -450,11 +480,13 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
+        LOCK(cs_addr);
         addrKnown.insert(addr.GetKey());
     }
 
     void PushAddress(const CAddress& addr, FastRandomContext &insecure_rand)
     {
+        LOCK(cs_addr);
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
@@ -470,16 +502,20 @@ public:
 
     void AddKnownTx(const WTxId& wtxid)
     {
+        unsigned char key[WTxId::RAW_SIZE];
+        wtxid.ToRawBytes(key);
         {
             LOCK(cs_inventory);
-            filterInventoryKnown.insert(wtxid.ToBytes());
+            filterInventoryKnown.insert(key, sizeof(key));
         }
     }
 
     void PushTxInventory(const WTxId& wtxid)
     {
+        unsigned char key[WTxId::RAW_SIZE];
+        wtxid.ToRawBytes(key);
         LOCK(cs_inventory);
-        if (!filterInventoryKnown.contains(wtxid.ToBytes())) {
+        if (!filterInventoryKnown.contains(key, sizeof(key))) {
             setInventoryTxToSend.insert(wtxid.hash);
         }
     }
@@ -251,9 +251,19 @@ public:
     /** Return a fee estimate */
     CFeeRate estimateFee(int confTarget);
 
+    /** Return a fee estimate at the required successful target. If the
+     *  bucketed data cannot answer at confTarget, successively higher
+     *  targets are tried so congestion degrades the answer's horizon
+     *  instead of returning no estimate at all. The target actually
+     *  answered is reported through answerFoundAtTarget. */
+    CFeeRate estimateSmartFee(int confTarget, int *answerFoundAtTarget);
+
     /** Return a priority estimate */
     double estimatePriority(int confTarget);
 
+    /** Return a priority estimate, sliding to higher targets as above. */
+    double estimateSmartPriority(int confTarget, int *answerFoundAtTarget);
+
     /** Write estimation data to a file */
     void Write(CAutoFile& fileout);
 
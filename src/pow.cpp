@@ -12,6 +12,29 @@
 
 #include <librustzcash.h>
 
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * Cache of GetNextWorkRequired results, keyed by the hash of the previous
+ * block. The required work for a block depends (outside the testnet
+ * min-difficulty rule, which returns before the cache is consulted) only on
+ * its predecessor, so competing headers at the same height share an entry,
+ * and a block validated first as a header and later in full computes the
+ * averaging-window walk only once. Keyed by hash rather than CBlockIndex
+ * pointer so entries can never alias a recycled index object.
+ */
+const size_t MAX_RETARGET_CACHE_SIZE = 100000;
+std::mutex g_retargetCacheMutex;
+struct RetargetCacheHasher {
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+std::unordered_map<uint256, unsigned int, RetargetCacheHasher> g_retargetCache;
+
+} // anonymous namespace
+
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
@@ -38,6 +61,19 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
         }
     }
 
+    // Only cache for indexes that carry their block hash: the hash commits to
+    // every field the computation below reads, so an entry can never go
+    // stale. Synthetic indexes built by tests have no hash pointer (and are
+    // mutated in place), so they bypass the cache.
+    const uint256* pcacheKey = pindexLast->phashBlock;
+    if (pcacheKey) {
+        std::lock_guard<std::mutex> lock(g_retargetCacheMutex);
+        auto it = g_retargetCache.find(*pcacheKey);
+        if (it != g_retargetCache.end()) {
+            return it->second;
+        }
+    }
+
     // Find the first block in the averaging interval
     const CBlockIndex* pindexFirst = pindexLast;
     arith_uint256 bnTot {0};
@@ -48,22 +84,33 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
         pindexFirst = pindexFirst->pprev;
     }
 
-    // Check we have enough blocks
-    if (pindexFirst == NULL)
-        return nProofOfWorkLimit;
+    unsigned int nBitsRet;
+    if (pindexFirst == NULL) {
+        // Not enough blocks in the window yet.
+        nBitsRet = nProofOfWorkLimit;
+    } else {
+        // The protocol specification leaves MeanTarget(height) as a rational, and takes the floor
+        // only after dividing by AveragingWindowTimespan in the computation of Threshold(height):
+        // <https://zips.z.cash/protocol/protocol.pdf#diffadjustment>
+        //
+        // Here we take the floor of MeanTarget(height) immediately, but that is equivalent to doing
+        // so only after a further division, as proven in <https://math.stackexchange.com/a/147832/185422>.
+        arith_uint256 bnAvg {bnTot / params.nPowAveragingWindow};
+
+        nBitsRet = CalculateNextWorkRequired(bnAvg,
+                                             pindexLast->GetMedianTimePast(), pindexFirst->GetMedianTimePast(),
+                                             params,
+                                             pindexLast->nHeight + 1);
+    }
 
-    // The protocol specification leaves MeanTarget(height) as a rational, and takes the floor
-    // only after dividing by AveragingWindowTimespan in the computation of Threshold(height):
-    // <https://zips.z.cash/protocol/protocol.pdf#diffadjustment>
-    //
-    // Here we take the floor of MeanTarget(height) immediately, but that is equivalent to doing
-    // so only after a further division, as proven in <https://math.stackexchange.com/a/147832/185422>.
-    arith_uint256 bnAvg {bnTot / params.nPowAveragingWindow};
-
-    return CalculateNextWorkRequired(bnAvg,
-                                     pindexLast->GetMedianTimePast(), pindexFirst->GetMedianTimePast(),
-                                     params,
-                                     pindexLast->nHeight + 1);
+    if (pcacheKey) {
+        std::lock_guard<std::mutex> lock(g_retargetCacheMutex);
+        if (g_retargetCache.size() >= MAX_RETARGET_CACHE_SIZE) {
+            g_retargetCache.clear();
+        }
+        g_retargetCache.emplace(*pcacheKey, nBitsRet);
+    }
+    return nBitsRet;
 }
 
 unsigned int CalculateNextWorkRequired(arith_uint256 bnAvg,
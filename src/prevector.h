@@ -12,6 +12,19 @@
 
 #include <iterator>
 
+#ifdef PREVECTOR_PROFILE
+#include <atomic>
+/** Workload counters for measuring how often prevectors outgrow their direct
+ *  storage. Enabled by building with -DPREVECTOR_PROFILE; totals are logged
+ *  at shutdown. The counters aggregate every instantiation, which in practice
+ *  is dominated by the CScript backing store. */
+namespace prevector_profile {
+inline std::atomic<uint64_t>& destroyed() { static std::atomic<uint64_t> c(0); return c; }
+inline std::atomic<uint64_t>& destroyed_indirect() { static std::atomic<uint64_t> c(0); return c; }
+inline std::atomic<uint64_t>& heap_allocations() { static std::atomic<uint64_t> c(0); return c; }
+}
+#endif
+
 #pragma pack(push, 1)
 /** Implements a drop-in replacement for std::vector<T> which stores up to N
  *  elements directly (without heap allocation). The types Size and Diff are
@@ -174,10 +187,16 @@ private:
                 /* FIXME: Because malloc/realloc here won't call new_handler if allocation fails, assert
                     success. These should instead use an allocator or new/delete so that handlers
                     are called as necessary, but performance would be slightly degraded by doing so. */
+#ifdef PREVECTOR_PROFILE
+                prevector_profile::heap_allocations()++;
+#endif
                 _union.indirect = static_cast<char*>(realloc(_union.indirect, ((size_t)sizeof(T)) * new_capacity));
                 assert(_union.indirect);
                 _union.capacity = new_capacity;
             } else {
+#ifdef PREVECTOR_PROFILE
+                prevector_profile::heap_allocations()++;
+#endif
                 char* new_indirect = static_cast<char*>(malloc(((size_t)sizeof(T)) * new_capacity));
                 assert(new_indirect);
                 T* src = direct_ptr(0);
@@ -423,6 +442,12 @@ public:
     }
 
     ~prevector() {
+#ifdef PREVECTOR_PROFILE
+        prevector_profile::destroyed()++;
+        if (!is_direct()) {
+            prevector_profile::destroyed_indirect()++;
+        }
+#endif
         clear();
         if (!is_direct()) {
             free(_union.indirect);
@@ -175,6 +175,55 @@ uint256 CBlock::BuildAuthDataMerkleTree() const
     return (tree.empty() ? uint256() : tree.back());
 }
 
+std::vector<uint256> CBlock::BuildAuthDataMerkleBranch(size_t nIndex) const
+{
+    assert(nIndex < vtx.size());
+    std::vector<uint256> vMerkleBranch;
+
+    auto perfectSize = next_pow2(vtx.size());
+    std::vector<uint256> layer;
+    layer.reserve(perfectSize);
+    for (auto &tx : vtx) {
+        layer.push_back(tx.GetAuthDigest());
+    }
+    // Append empty leaves until we get a perfect tree, matching
+    // BuildAuthDataMerkleTree above.
+    layer.insert(layer.end(), perfectSize - vtx.size(), uint256());
+
+    while (layer.size() > 1) {
+        vMerkleBranch.push_back(layer[nIndex ^ 1]);
+        std::vector<uint256> next;
+        next.reserve(layer.size() / 2);
+        for (size_t i = 0; i < layer.size(); i += 2) {
+            CBLAKE2bWriter ss(SER_GETHASH, 0, ZCASH_AUTH_DATA_HASH_PERSONALIZATION);
+            ss << layer[i];
+            ss << layer[i + 1];
+            next.push_back(ss.GetHash());
+        }
+        layer = std::move(next);
+        nIndex >>= 1;
+    }
+    return vMerkleBranch;
+}
+
+uint256 CBlock::CheckAuthDataMerkleBranch(uint256 hash, const std::vector<uint256>& vMerkleBranch, size_t nIndex)
+{
+    for (std::vector<uint256>::const_iterator it(vMerkleBranch.begin()); it != vMerkleBranch.end(); ++it)
+    {
+        CBLAKE2bWriter ss(SER_GETHASH, 0, ZCASH_AUTH_DATA_HASH_PERSONALIZATION);
+        if (nIndex & 1) {
+            ss << *it;
+            ss << hash;
+        } else {
+            ss << hash;
+            ss << *it;
+        }
+        hash = ss.GetHash();
+        nIndex >>= 1;
+    }
+    return hash;
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -167,6 +167,11 @@ public:
     // root.
     uint256 BuildAuthDataMerkleTree() const;
 
+    // Compute the authorizing data Merkle branch for the transaction at
+    // nIndex, i.e. the sibling hashes on the path from its leaf to the root.
+    std::vector<uint256> BuildAuthDataMerkleBranch(size_t nIndex) const;
+    static uint256 CheckAuthDataMerkleBranch(uint256 hash, const std::vector<uint256>& vMerkleBranch, size_t nIndex);
+
     std::string ToString() const;
 };
 
@@ -177,18 +177,31 @@ void CTransaction::UpdateHash() const
 {
     if (this->nVersion <= SAPLING_TX_VERSION) {
         *const_cast<uint256*>(&wtxid.hash) = SerializeHash(*this, SER_GETHASH, this->nVersion);
-        return;
+        // The hashing stream above omits scriptSigs, so the network size has
+        // to be measured separately.
+        *const_cast<unsigned int*>(&nCachedSize) = ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+    } else {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << *this;
+        if (!zcash_transaction_digests(
+            reinterpret_cast<const unsigned char*>(ss.data()),
+            ss.size(),
+            const_cast<uint256*>(&wtxid.hash)->begin(),
+            const_cast<uint256*>(&wtxid.authDigest)->begin()))
+        {
+            throw std::ios_base::failure("CTransaction::UpdateHash: Invalid transaction format");
+        }
+        *const_cast<unsigned int*>(&nCachedSize) = ss.size();
     }
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << *this;
-    if (!zcash_transaction_digests(
-        reinterpret_cast<const unsigned char*>(ss.data()),
-        ss.size(),
-        const_cast<uint256*>(&wtxid.hash)->begin(),
-        const_cast<uint256*>(&wtxid.authDigest)->begin()))
-    {
-        throw std::ios_base::failure("CTransaction::UpdateHash: Invalid transaction format");
+
+    unsigned int nSigOps = 0;
+    for (const CTxIn& txin : vin) {
+        nSigOps += txin.scriptSig.GetSigOpCount(false);
     }
+    for (const CTxOut& txout : vout) {
+        nSigOps += txout.scriptPubKey.GetSigOpCount(false);
+    }
+    *const_cast<unsigned int*>(&nCachedLegacySigOpCount) = nSigOps;
 }
 
 uint256 CTransaction::GetScriptSigHash() const
@@ -260,6 +273,53 @@ CTransaction::CTransaction(CMutableTransaction &&tx) : nVersion(tx.nVersion),
     UpdateHash();
 }
 
+CTransaction::CTransaction(CTransaction &&tx) noexcept :
+    nConsensusBranchId(tx.nConsensusBranchId),
+    valueBalanceSapling(tx.valueBalanceSapling),
+    orchardBundle(std::move(tx.orchardBundle)),
+    wtxid(tx.wtxid),
+    nCachedSize(tx.nCachedSize),
+    nCachedLegacySigOpCount(tx.nCachedLegacySigOpCount),
+    fOverwintered(tx.fOverwintered),
+    nVersion(tx.nVersion),
+    nVersionGroupId(tx.nVersionGroupId),
+    vin(std::move(tx.vin)),
+    vout(std::move(const_cast<std::vector<CTxOut>&>(tx.vout))),
+    nLockTime(tx.nLockTime),
+    nExpiryHeight(tx.nExpiryHeight),
+    vShieldedSpend(std::move(const_cast<std::vector<SpendDescription>&>(tx.vShieldedSpend))),
+    vShieldedOutput(std::move(const_cast<std::vector<OutputDescription>&>(tx.vShieldedOutput))),
+    vJoinSplit(std::move(const_cast<std::vector<JSDescription>&>(tx.vJoinSplit))),
+    joinSplitPubKey(tx.joinSplitPubKey),
+    joinSplitSig(tx.joinSplitSig),
+    bindingSig(tx.bindingSig)
+{
+}
+
+CTransaction& CTransaction::operator=(CTransaction &&tx) noexcept {
+    *const_cast<bool*>(&fOverwintered) = tx.fOverwintered;
+    *const_cast<int*>(&nVersion) = tx.nVersion;
+    *const_cast<uint32_t*>(&nVersionGroupId) = tx.nVersionGroupId;
+    nConsensusBranchId = tx.nConsensusBranchId;
+    *const_cast<std::vector<CTxIn>*>(&vin) = std::move(tx.vin);
+    *const_cast<std::vector<CTxOut>*>(&vout) = std::move(const_cast<std::vector<CTxOut>&>(tx.vout));
+    *const_cast<unsigned int*>(&nLockTime) = tx.nLockTime;
+    *const_cast<uint32_t*>(&nExpiryHeight) = tx.nExpiryHeight;
+    valueBalanceSapling = tx.valueBalanceSapling;
+    *const_cast<std::vector<SpendDescription>*>(&vShieldedSpend) = std::move(const_cast<std::vector<SpendDescription>&>(tx.vShieldedSpend));
+    *const_cast<std::vector<OutputDescription>*>(&vShieldedOutput) = std::move(const_cast<std::vector<OutputDescription>&>(tx.vShieldedOutput));
+    orchardBundle = std::move(tx.orchardBundle);
+    *const_cast<std::vector<JSDescription>*>(&vJoinSplit) = std::move(const_cast<std::vector<JSDescription>&>(tx.vJoinSplit));
+    *const_cast<Ed25519VerificationKey*>(&joinSplitPubKey) = tx.joinSplitPubKey;
+    *const_cast<Ed25519Signature*>(&joinSplitSig) = tx.joinSplitSig;
+    *const_cast<binding_sig_t*>(&bindingSig) = tx.bindingSig;
+    *const_cast<uint256*>(&wtxid.hash) = tx.wtxid.hash;
+    *const_cast<uint256*>(&wtxid.authDigest) = tx.wtxid.authDigest;
+    *const_cast<unsigned int*>(&nCachedSize) = tx.nCachedSize;
+    *const_cast<unsigned int*>(&nCachedLegacySigOpCount) = tx.nCachedLegacySigOpCount;
+    return *this;
+}
+
 CTransaction& CTransaction::operator=(const CTransaction &tx) {
     *const_cast<bool*>(&fOverwintered) = tx.fOverwintered;
     *const_cast<int*>(&nVersion) = tx.nVersion;
@@ -279,6 +339,8 @@ CTransaction& CTransaction::operator=(const CTransaction &tx) {
     *const_cast<binding_sig_t*>(&bindingSig) = tx.bindingSig;
     *const_cast<uint256*>(&wtxid.hash) = tx.wtxid.hash;
     *const_cast<uint256*>(&wtxid.authDigest) = tx.wtxid.authDigest;
+    *const_cast<unsigned int*>(&nCachedSize) = tx.nCachedSize;
+    *const_cast<unsigned int*>(&nCachedLegacySigOpCount) = tx.nCachedLegacySigOpCount;
     return *this;
 }
 
@@ -394,7 +456,7 @@ unsigned int CTransaction::CalculateModifiedSize(unsigned int nTxSize) const
     // Providing any more cleanup incentive than making additional inputs free would
     // risk encouraging people to create junk outputs to redeem later.
     if (nTxSize == 0)
-        nTxSize = ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+        nTxSize = nCachedSize ? nCachedSize : ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
     for (std::vector<CTxIn>::const_iterator it(vin.begin()); it != vin.end(); ++it)
     {
         unsigned int offset = 41U + std::min(110U, (unsigned int)it->scriptSig.size());
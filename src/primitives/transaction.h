@@ -16,6 +16,7 @@
 #include "consensus/upgrades.h"
 
 #include <array>
+#include <memory>
 #include <variant>
 
 #include "zcash/NoteEncryption.hpp"
@@ -671,6 +672,16 @@ struct WTxId
         return vData;
     }
 
+    //! Serialized size of ToBytes()/ToRawBytes().
+    static const size_t RAW_SIZE = 64;
+
+    //! Like ToBytes(), but into a caller-provided RAW_SIZE buffer, so hot
+    //! paths (per-peer inventory filters) can avoid a heap allocation.
+    void ToRawBytes(unsigned char* pData) const {
+        memcpy(pData, hash.begin(), hash.size());
+        memcpy(pData + hash.size(), authDigest.begin(), authDigest.size());
+    }
+
     friend bool operator<(const WTxId& a, const WTxId& b)
     {
         return (a.hash < b.hash ||
@@ -704,6 +715,12 @@ private:
 
     /** Memory only. */
     const WTxId wtxid;
+    /** Memory only; filled in by UpdateHash() alongside the hash so that
+     * policy and block-assembly code can read the serialized size and legacy
+     * sigop count without re-serializing the transaction. Zero for
+     * default-constructed transactions, like the cached hash. */
+    const unsigned int nCachedSize{0};
+    const unsigned int nCachedLegacySigOpCount{0};
     void UpdateHash() const;
 
 protected:
@@ -776,8 +793,16 @@ public:
     CTransaction(const CMutableTransaction &tx);
     CTransaction(CMutableTransaction &&tx);
 
+    CTransaction(const CTransaction& tx) = default;
     CTransaction& operator=(const CTransaction& tx);
 
+    /** Move construction/assignment steal the vectors instead of copying
+     *  them, and carry the cached hash along, so vector reallocations of
+     *  CBlock::vtx and hand-offs from deserialization do not touch the heap.
+     *  noexcept so std::vector actually moves on reallocation. */
+    CTransaction(CTransaction&& tx) noexcept;
+    CTransaction& operator=(CTransaction&& tx) noexcept;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -924,6 +949,23 @@ public:
         return wtxid;
     }
 
+    /**
+     * Returns the size of the transaction as serialized for the network,
+     * cached when the hash was computed.
+     */
+    unsigned int GetTotalSize() const {
+        return nCachedSize;
+    }
+
+    /**
+     * Returns the number of sigops in the scriptSigs and scriptPubKeys of
+     * this transaction, counted the legacy (non-P2SH) way, cached when the
+     * hash was computed.
+     */
+    unsigned int GetLegacySigOpCount() const {
+        return nCachedLegacySigOpCount;
+    }
+
     uint32_t GetHeader() const {
         // When serializing v1 and v2, the 4 byte header is nVersion
         uint32_t header = this->nVersion;
@@ -995,6 +1037,18 @@ public:
     std::string ToString() const;
 };
 
+/** A shared pointer to an immutable transaction.
+ *
+ *  The mempool, the relay map and block assembly all hold the same
+ *  deserialized transaction through this handle instead of keeping their own
+ *  copies. */
+typedef std::shared_ptr<const CTransaction> CTransactionRef;
+template <typename Tx>
+static inline CTransactionRef MakeTransactionRef(Tx&& txIn)
+{
+    return std::make_shared<const CTransaction>(std::forward<Tx>(txIn));
+}
+
 /** A mutable version of CTransaction. */
 struct CMutableTransaction
 {
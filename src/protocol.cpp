@@ -126,6 +126,7 @@ std::string CInv::GetCommand() const
     // WTX is not a message type, just an inv type
     case MSG_WTX:            return cmd.append("wtx");
     case MSG_FILTERED_BLOCK: return cmd.append("merkleblock");
+    case MSG_CMPCT_BLOCK:    return cmd.append("cmpctblock");
     default:
         throw std::out_of_range(strprintf("CInv::GetCommand(): type=%d unknown type", type));
     }
@@ -144,6 +145,18 @@ std::vector<unsigned char> CInv::GetWideHash() const
     return vData;
 }
 
+void CInv::GetWideHash(unsigned char* pData) const
+{
+    assert(type != MSG_BLOCK);
+    if (type == MSG_TX) {
+        for (auto byte : hashAux) {
+            assert(byte == 0xff);
+        }
+    };
+    memcpy(pData, hash.begin(), hash.size());
+    memcpy(pData + hash.size(), hashAux.begin(), hashAux.size());
+}
+
 std::string CInv::ToString() const
 {
     switch (type)
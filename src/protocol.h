@@ -72,6 +72,11 @@ enum {
     // Zcash nodes used to support this by default, without advertising this bit,
     // but no longer do as of protocol version 170004 (= NO_BLOOM_VERSION)
     NODE_BLOOM = (1 << 2),
+    // NODE_NETWORK_LIMITED means the node is capable of serving the last
+    // MIN_BLOCKS_TO_KEEP (288) blocks, but not necessarily deeper history.
+    // Set instead of NODE_NETWORK by nodes running with -prune, matching the
+    // bit assignment of BIP159.
+    NODE_NETWORK_LIMITED = (1 << 10),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
@@ -128,6 +133,7 @@ enum GetDataMsg : uint32_t {
     MSG_WTX = 5,             //!< Defined in ZIP 239
     // The following can only occur in getdata. Invs always use TX/WTX or BLOCK.
     MSG_FILTERED_BLOCK = 3,  //!< Defined in BIP37
+    MSG_CMPCT_BLOCK = 4,     //!< Defined in BIP152
 };
 
 /** inv message data */
@@ -160,6 +166,12 @@ public:
         case MSG_BLOCK:
         case MSG_FILTERED_BLOCK:
             break;
+        case MSG_CMPCT_BLOCK:
+            if (nVersion < SHORT_IDS_BLOCKS_VERSION) {
+                throw std::ios_base::failure(
+                    "Negotiated protocol version does not support CInv message type MSG_CMPCT_BLOCK");
+            }
+            break;
         case MSG_WTX:
             if (nVersion < CINV_WTX_VERSION) {
                 throw std::ios_base::failure(
@@ -185,6 +197,9 @@ public:
 
     std::string GetCommand() const;
     std::vector<unsigned char> GetWideHash() const;
+    //! Like GetWideHash(), but into a caller-provided WTxId::RAW_SIZE buffer,
+    //! avoiding a heap allocation per inventory check.
+    void GetWideHash(unsigned char* pData) const;
     std::string ToString() const;
 
     // TODO: make private (improves encapsulation)
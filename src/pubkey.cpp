@@ -8,10 +8,79 @@
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <array>
+#include <cstring>
+#include <mutex>
+
 namespace
 {
-/* Global secp256k1_context object used for verification. */
+/**
+ * Global secp256k1_context object used for verification.
+ *
+ * The context is immutable once ECCVerifyHandle has created it: verification
+ * only reads the precomputed multiplication tables inside, so all script
+ * check threads share this single context without any locking. Creating
+ * per-thread copies would only duplicate the ~1MB ecmult table.
+ */
 secp256k1_context* secp256k1_context_verify = NULL;
+
+/**
+ * Cache of parsed (decompressed) public keys, so that a key appearing in
+ * many inputs of a block — the common case with address reuse — pays the
+ * point decompression in secp256k1_ec_pubkey_parse only once and later
+ * verifications share the precomputed group element.
+ *
+ * The table is direct mapped and each slot has its own lock, so concurrent
+ * script check threads only contend when they hit the same slot; a miss or
+ * a collision simply falls back to parsing, never to a wrong answer.
+ */
+class CParsedPubKeyCache
+{
+private:
+    static const size_t SLOTS = 1024;
+
+    struct Slot {
+        std::mutex cs;
+        unsigned char vch[CPubKey::PUBLIC_KEY_SIZE];
+        unsigned int size;
+        secp256k1_pubkey pubkey;
+
+        Slot() : size(0) {}
+    };
+
+    std::array<Slot, SLOTS> table;
+
+    /* Serialized keys lead with a type byte followed by the x coordinate,
+     * which is uniformly distributed; use its first bytes as the index. */
+    static size_t SlotFor(const unsigned char* vch)
+    {
+        uint64_t n;
+        memcpy(&n, vch + 1, sizeof(n));
+        return n % SLOTS;
+    }
+
+public:
+    bool Get(const unsigned char* vch, unsigned int size, secp256k1_pubkey& pubkeyOut)
+    {
+        Slot& slot = table[SlotFor(vch)];
+        std::lock_guard<std::mutex> lock(slot.cs);
+        if (slot.size != size || memcmp(slot.vch, vch, size) != 0)
+            return false;
+        pubkeyOut = slot.pubkey;
+        return true;
+    }
+
+    void Set(const unsigned char* vch, unsigned int size, const secp256k1_pubkey& pubkeyIn)
+    {
+        Slot& slot = table[SlotFor(vch)];
+        std::lock_guard<std::mutex> lock(slot.cs);
+        memcpy(slot.vch, vch, size);
+        slot.size = size;
+        slot.pubkey = pubkeyIn;
+    }
+};
+
+CParsedPubKeyCache parsedPubKeyCache;
 }
 
 
@@ -20,8 +89,11 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
         return false;
     secp256k1_pubkey pubkey;
     secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
-        return false;
+    if (!parsedPubKeyCache.Get(&(*this)[0], size(), pubkey)) {
+        if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+            return false;
+        }
+        parsedPubKeyCache.Set(&(*this)[0], size(), pubkey);
     }
     if (vchSig.size() == 0) {
         return false;
@@ -113,6 +113,9 @@ CoinControlDialog::CoinControlDialog(const PlatformStyle *platformStyle, QWidget
     // click on checkbox
     connect(ui->treeWidget, SIGNAL(itemChanged(QTreeWidgetItem*, int)), this, SLOT(viewItemChanged(QTreeWidgetItem*, int)));
 
+    // lazy creation of address group children in tree mode
+    connect(ui->treeWidget, SIGNAL(itemExpanded(QTreeWidgetItem*)), this, SLOT(viewItemExpanded(QTreeWidgetItem*)));
+
     // click on header
 #if QT_VERSION < 0x050000
     ui->treeWidget->header()->setClickable(true);
@@ -401,6 +404,26 @@ void CoinControlDialog::viewItemChanged(QTreeWidgetItem* item, int column)
         if (ui->treeWidget->isEnabled()) // do not update on every click for (un)select all
             CoinControlDialog::updateLabels(model, this);
     }
+    else if (column == COLUMN_CHECKBOX && item->childCount() == 0 &&
+             item->text(COLUMN_TXHASH).length() != 64 && !item->text(COLUMN_ADDRESS).isEmpty() &&
+             item->checkState(COLUMN_CHECKBOX) != Qt::PartiallyChecked)
+    {
+        // collapsed address group whose children have not been created yet:
+        // apply the (un)select directly to the cached outputs
+        bool fSelect = (item->checkState(COLUMN_CHECKBOX) == Qt::Checked);
+        for (const CoinEntry& entry : mapCoinEntries.value(item->text(COLUMN_ADDRESS)))
+        {
+            COutPoint outpt(entry.txhash, entry.nOut);
+            if (!fSelect)
+                coinControl->UnSelect(outpt);
+            else if (!model->isLockedCoin(entry.txhash, entry.nOut)) // locked coins stay unselected
+                coinControl->Select(outpt);
+        }
+
+        // selection changed -> update labels
+        if (ui->treeWidget->isEnabled()) // do not update on every click for (un)select all
+            CoinControlDialog::updateLabels(model, this);
+    }
 
     // TODO: Remove this temporary qt5 fix after Qt5.3 and Qt5.4 are no longer used.
     //       Fixed in Qt5.5 and above: https://bugreports.qt.io/browse/QTBUG-43473
@@ -677,7 +700,6 @@ void CoinControlDialog::updateView()
     ui->treeWidget->clear();
     ui->treeWidget->setEnabled(false); // performance, otherwise updateLabels would be called for every checked checkbox
     ui->treeWidget->setAlternatingRowColors(!treeMode);
-    QFlags<Qt::ItemFlag> flgCheckbox = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
     QFlags<Qt::ItemFlag> flgTristate = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable | Qt::ItemIsTristate;
 
     int nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
@@ -686,130 +708,100 @@ void CoinControlDialog::updateView()
     std::map<QString, std::vector<COutput> > mapCoins;
     model->listCoins(mapCoins);
 
+    // Decompose each output into a lightweight entry once. Items are created
+    // from the entries either immediately (list mode) or lazily, when an
+    // address group is first expanded (tree mode), so the widget stays
+    // responsive for wallets with a very large number of outputs.
+    mapCoinEntries.clear();
+
+    KeyIO keyIO(Params());
     for (const auto& [first, second] : mapCoins) {
-        CCoinControlWidgetItem *itemWalletAddress = new CCoinControlWidgetItem();
-        itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
         QString sWalletAddress = first;
         QString sWalletLabel = model->getAddressTableModel()->labelForAddress(sWalletAddress);
         if (sWalletLabel.isEmpty())
             sWalletLabel = tr("(no label)");
 
-        if (treeMode)
-        {
-            // wallet address
-            ui->treeWidget->addTopLevelItem(itemWalletAddress);
-
-            itemWalletAddress->setFlags(flgTristate);
-            itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
-
-            // label
-            itemWalletAddress->setText(COLUMN_LABEL, sWalletLabel);
-
-            // address
-            itemWalletAddress->setText(COLUMN_ADDRESS, sWalletAddress);
-        }
+        QList<CoinEntry>& entries = mapCoinEntries[sWalletAddress];
+        entries.reserve(second.size());
 
         CAmount nSum = 0;
         double dPrioritySum = 0;
-        int nChildren = 0;
         int nInputSum = 0;
-        KeyIO keyIO(Params());
+        int nSelected = 0;
+        int nSelectable = 0;
         for (const COutput& out : second) {
-            int nInputSize = 0;
-            nSum += out.tx->vout[out.i].nValue;
-            nChildren++;
-
-            CCoinControlWidgetItem *itemOutput;
-            if (treeMode)    itemOutput = new CCoinControlWidgetItem(itemWalletAddress);
-            else             itemOutput = new CCoinControlWidgetItem(ui->treeWidget);
-            itemOutput->setFlags(flgCheckbox);
-            itemOutput->setCheckState(COLUMN_CHECKBOX,Qt::Unchecked);
+            CoinEntry entry;
+            entry.txhash = out.tx->GetHash();
+            entry.nOut = out.i;
+            entry.nValue = out.tx->vout[out.i].nValue;
+            entry.nTime = out.tx->GetTxTime();
+            entry.nDepth = out.nDepth;
+            entry.nInputSize = 0;
 
-            // address
             CTxDestination outputAddress;
-            QString sAddress = "";
-            if(ExtractDestination(out.tx->vout[out.i].scriptPubKey, outputAddress))
+            if (ExtractDestination(out.tx->vout[out.i].scriptPubKey, outputAddress))
             {
-                sAddress = QString::fromStdString(keyIO.EncodeDestination(outputAddress));
-
-                // if listMode or change => show bitcoin address. In tree mode, address is not shown again for direct wallet address outputs
-                if (!treeMode || (!(sAddress == sWalletAddress)))
-                    itemOutput->setText(COLUMN_ADDRESS, sAddress);
+                entry.sAddress = QString::fromStdString(keyIO.EncodeDestination(outputAddress));
 
                 CPubKey pubkey;
                 CKeyID *keyid = std::get_if<CKeyID>(&outputAddress);
                 if (keyid && model->getPubKey(*keyid, pubkey) && !pubkey.IsCompressed())
-                    nInputSize = 29; // 29 = 180 - 151 (public key is 180 bytes, priority free area is 151 bytes)
+                    entry.nInputSize = 29; // 29 = 180 - 151 (public key is 180 bytes, priority free area is 151 bytes)
             }
 
-            // label
-            if (!(sAddress == sWalletAddress)) // change
-            {
-                // tooltip from where the change comes from
-                itemOutput->setToolTip(COLUMN_LABEL, tr("change from %1 (%2)").arg(sWalletLabel).arg(sWalletAddress));
-                itemOutput->setText(COLUMN_LABEL, tr("(change)"));
-            }
-            else if (!treeMode)
-            {
-                QString sLabel = model->getAddressTableModel()->labelForAddress(sAddress);
-                if (sLabel.isEmpty())
-                    sLabel = tr("(no label)");
-                itemOutput->setText(COLUMN_LABEL, sLabel);
-            }
-
-            // amount
-            itemOutput->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, out.tx->vout[out.i].nValue));
-            itemOutput->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)out.tx->vout[out.i].nValue)); // padding so that sorting works correctly
-
-            // date
-            itemOutput->setText(COLUMN_DATE, GUIUtil::dateTimeStr(out.tx->GetTxTime()));
-            itemOutput->setData(COLUMN_DATE, Qt::UserRole, QVariant((qlonglong)out.tx->GetTxTime()));
-
-            // confirmations
-            itemOutput->setText(COLUMN_CONFIRMATIONS, QString::number(out.nDepth));
-            itemOutput->setData(COLUMN_CONFIRMATIONS, Qt::UserRole, QVariant((qlonglong)out.nDepth));
-
-            // priority
-            double dPriority = ((double)out.tx->vout[out.i].nValue  / (nInputSize + 78)) * (out.nDepth+1); // 78 = 2 * 34 + 10
-            itemOutput->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPriority, mempoolEstimatePriority));
-            itemOutput->setData(COLUMN_PRIORITY, Qt::UserRole, QVariant((qlonglong)dPriority));
-            dPrioritySum += (double)out.tx->vout[out.i].nValue  * (out.nDepth+1);
-            nInputSum    += nInputSize;
+            nSum += entry.nValue;
+            dPrioritySum += (double)entry.nValue * (out.nDepth+1);
+            nInputSum += entry.nInputSize;
 
-            // transaction hash
-            uint256 txhash = out.tx->GetHash();
-            itemOutput->setText(COLUMN_TXHASH, QString::fromStdString(txhash.GetHex()));
-
-            // vout index
-            itemOutput->setText(COLUMN_VOUT_INDEX, QString::number(out.i));
-
-             // disable locked coins
-            if (model->isLockedCoin(txhash, out.i))
+            if (model->isLockedCoin(entry.txhash, entry.nOut))
             {
-                COutPoint outpt(txhash, out.i);
+                COutPoint outpt(entry.txhash, entry.nOut);
                 coinControl->UnSelect(outpt); // just to be sure
-                itemOutput->setDisabled(true);
-                itemOutput->setIcon(COLUMN_CHECKBOX, platformStyle->MultiColorIcon(":/images/locked"));
             }
+            else
+                nSelectable++;
+            if (coinControl->IsSelected(entry.txhash, entry.nOut))
+                nSelected++;
 
-            // set checkbox
-            if (coinControl->IsSelected(txhash, out.i))
-                itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+            entries.append(entry);
         }
 
-        // amount
         if (treeMode)
         {
+            // wallet address; children are created on first expansion
+            CCoinControlWidgetItem *itemWalletAddress = new CCoinControlWidgetItem();
+            ui->treeWidget->addTopLevelItem(itemWalletAddress);
+
+            itemWalletAddress->setFlags(flgTristate);
+            itemWalletAddress->setCheckState(COLUMN_CHECKBOX,
+                nSelected == 0 ? Qt::Unchecked :
+                (nSelected >= nSelectable ? Qt::Checked : Qt::PartiallyChecked));
+
+            // label
+            itemWalletAddress->setText(COLUMN_LABEL, sWalletLabel);
+
+            // address
+            itemWalletAddress->setText(COLUMN_ADDRESS, sWalletAddress);
+
+            // amount
             dPrioritySum = dPrioritySum / (nInputSum + 78);
-            itemWalletAddress->setText(COLUMN_CHECKBOX, "(" + QString::number(nChildren) + ")");
+            itemWalletAddress->setText(COLUMN_CHECKBOX, "(" + QString::number(entries.size()) + ")");
             itemWalletAddress->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
             itemWalletAddress->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)nSum));
             itemWalletAddress->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPrioritySum, mempoolEstimatePriority));
             itemWalletAddress->setData(COLUMN_PRIORITY, Qt::UserRole, QVariant((qlonglong)dPrioritySum));
+
+            // show the expand arrow even though no children exist yet
+            itemWalletAddress->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        }
+        else
+        {
+            for (const CoinEntry& entry : entries)
+                addCoinItem(NULL, entry, sWalletAddress, sWalletLabel, nDisplayUnit, mempoolEstimatePriority);
         }
     }
 
-    // expand all partially selected
+    // expand all partially selected; expanding materializes the children
     if (treeMode)
     {
         for (int i = 0; i < ui->treeWidget->topLevelItemCount(); i++)
@@ -821,3 +813,96 @@ void CoinControlDialog::updateView()
     sortView(sortColumn, sortOrder);
     ui->treeWidget->setEnabled(true);
 }
+
+// create one output row, either as a top-level item (list mode) or below its
+// address group (tree mode)
+void CoinControlDialog::addCoinItem(QTreeWidgetItem *itemWalletAddress, const CoinEntry &entry,
+                                    const QString &sWalletAddress, const QString &sWalletLabel,
+                                    int nDisplayUnit, double mempoolEstimatePriority)
+{
+    QFlags<Qt::ItemFlag> flgCheckbox = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+
+    CCoinControlWidgetItem *itemOutput;
+    if (itemWalletAddress) itemOutput = new CCoinControlWidgetItem(itemWalletAddress);
+    else                   itemOutput = new CCoinControlWidgetItem(ui->treeWidget);
+    itemOutput->setFlags(flgCheckbox);
+    itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
+
+    // if listMode or change => show bitcoin address. In tree mode, address is not shown again for direct wallet address outputs
+    if (!itemWalletAddress || !(entry.sAddress == sWalletAddress))
+        itemOutput->setText(COLUMN_ADDRESS, entry.sAddress);
+
+    // label
+    if (!(entry.sAddress == sWalletAddress)) // change
+    {
+        // tooltip from where the change comes from
+        itemOutput->setToolTip(COLUMN_LABEL, tr("change from %1 (%2)").arg(sWalletLabel).arg(sWalletAddress));
+        itemOutput->setText(COLUMN_LABEL, tr("(change)"));
+    }
+    else if (!itemWalletAddress)
+    {
+        QString sLabel = model->getAddressTableModel()->labelForAddress(entry.sAddress);
+        if (sLabel.isEmpty())
+            sLabel = tr("(no label)");
+        itemOutput->setText(COLUMN_LABEL, sLabel);
+    }
+
+    // amount
+    itemOutput->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, entry.nValue));
+    itemOutput->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)entry.nValue)); // padding so that sorting works correctly
+
+    // date
+    itemOutput->setText(COLUMN_DATE, GUIUtil::dateTimeStr(entry.nTime));
+    itemOutput->setData(COLUMN_DATE, Qt::UserRole, QVariant((qlonglong)entry.nTime));
+
+    // confirmations
+    itemOutput->setText(COLUMN_CONFIRMATIONS, QString::number(entry.nDepth));
+    itemOutput->setData(COLUMN_CONFIRMATIONS, Qt::UserRole, QVariant((qlonglong)entry.nDepth));
+
+    // priority
+    double dPriority = ((double)entry.nValue / (entry.nInputSize + 78)) * (entry.nDepth+1); // 78 = 2 * 34 + 10
+    itemOutput->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPriority, mempoolEstimatePriority));
+    itemOutput->setData(COLUMN_PRIORITY, Qt::UserRole, QVariant((qlonglong)dPriority));
+
+    // transaction hash
+    itemOutput->setText(COLUMN_TXHASH, QString::fromStdString(entry.txhash.GetHex()));
+
+    // vout index
+    itemOutput->setText(COLUMN_VOUT_INDEX, QString::number(entry.nOut));
+
+    // disable locked coins
+    if (model->isLockedCoin(entry.txhash, entry.nOut))
+    {
+        itemOutput->setDisabled(true);
+        itemOutput->setIcon(COLUMN_CHECKBOX, platformStyle->MultiColorIcon(":/images/locked"));
+    }
+
+    // set checkbox
+    if (coinControl->IsSelected(entry.txhash, entry.nOut))
+        itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+}
+
+// address group expanded for the first time in tree mode -> create its children
+void CoinControlDialog::viewItemExpanded(QTreeWidgetItem* item)
+{
+    if (item->childCount() > 0 || item->text(COLUMN_TXHASH).length() == 64)
+        return; // already materialized, or a child node
+
+    QString sWalletAddress = item->text(COLUMN_ADDRESS);
+    QMap<QString, QList<CoinEntry> >::const_iterator it = mapCoinEntries.constFind(sWalletAddress);
+    if (it == mapCoinEntries.constEnd())
+        return;
+
+    bool fEnabled = ui->treeWidget->isEnabled();
+    ui->treeWidget->setEnabled(false); // performance, otherwise updateLabels would be called for every checked checkbox
+
+    int nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
+    double mempoolEstimatePriority = mempool.estimatePriority(nTxConfirmTarget);
+    QString sWalletLabel = item->text(COLUMN_LABEL);
+
+    for (const CoinEntry& entry : it.value())
+        addCoinItem(item, entry, sWalletAddress, sWalletLabel, nDisplayUnit, mempoolEstimatePriority);
+
+    item->sortChildren(sortColumn, sortOrder);
+    ui->treeWidget->setEnabled(fEnabled);
+}
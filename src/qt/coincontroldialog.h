@@ -6,11 +6,13 @@
 #define BITCOIN_QT_COINCONTROLDIALOG_H
 
 #include "amount.h"
+#include "uint256.h"
 
 #include <QAbstractButton>
 #include <QAction>
 #include <QDialog>
 #include <QList>
+#include <QMap>
 #include <QMenu>
 #include <QPoint>
 #include <QString>
@@ -71,8 +73,25 @@ private:
 
     const PlatformStyle *platformStyle;
 
+    //! One unspent output, cached so tree-mode children can be created
+    //! lazily when their address group is first expanded.
+    struct CoinEntry
+    {
+        uint256 txhash;
+        uint32_t nOut;
+        CAmount nValue;
+        qint64 nTime;
+        int nDepth;
+        int nInputSize;
+        QString sAddress;
+    };
+    QMap<QString, QList<CoinEntry> > mapCoinEntries;
+
     void sortView(int, Qt::SortOrder);
     void updateView();
+    void addCoinItem(QTreeWidgetItem *itemWalletAddress, const CoinEntry &entry,
+                     const QString &sWalletAddress, const QString &sWalletLabel,
+                     int nDisplayUnit, double mempoolEstimatePriority);
 
     enum
     {
@@ -107,6 +126,7 @@ private Q_SLOTS:
     void radioTreeMode(bool);
     void radioListMode(bool);
     void viewItemChanged(QTreeWidgetItem*, int);
+    void viewItemExpanded(QTreeWidgetItem*);
     void headerSectionClicked(int);
     void buttonBoxClicked(QAbstractButton*);
     void buttonSelectAllClicked();
@@ -19,6 +19,7 @@
 #include "rpc/server.h"
 #include "rpc/client.h"
 #include "util.h"
+#include "utilstrencodings.h"
 
 #include <univalue.h>
 
@@ -46,6 +47,16 @@
 
 const int CONSOLE_HISTORY = 50;
 const int INITIAL_TRAFFIC_GRAPH_MINS = 30;
+//! Replies larger than this are rendered with their largest subtrees collapsed
+const size_t CONSOLE_MAX_REPLY_SIZE = 256 * 1024;
+//! Hard cap on the reply bytes appended to the console view
+const size_t CONSOLE_MAX_REPLY_HARD_SIZE = 1024 * 1024;
+//! Elements kept per array/object when a reply is collapsed
+const size_t CONSOLE_COLLAPSE_ELEMS = 32;
+//! Bytes kept per string value when a reply is collapsed
+const size_t CONSOLE_COLLAPSE_STRING = 1024;
+//! Large replies are inserted into the view in chunks of this many characters
+const int CONSOLE_STREAM_CHUNK = 16 * 1024;
 const QSize FONT_RANGE(4, 40);
 const char fontSizeSettingsKey[] = "consoleFontSize";
 
@@ -109,88 +120,42 @@ public:
 
 #include "rpcconsole.moc"
 
-/**
- * Split shell command line into a list of arguments. Aims to emulate \c bash and friends.
- *
- * - Arguments are delimited with whitespace
- * - Extra whitespace at the beginning and end and between arguments will be ignored
- * - Text can be "double" or 'single' quoted
- * - The backslash \c \ is used as escape character
- *   - Outside quotes, any character can be escaped
- *   - Within double quotes, only escape \c " and backslashes before a \c " or another backslash
- *   - Within single quotes, no escaping is possible and no special interpretation takes place
- *
- * @param[out]   args        Parsed arguments will be appended to this list
- * @param[in]    strCommand  Command line to split
+/** Reduce a JSON tree to a bounded size for display: oversized arrays and
+ * objects keep only their first elements and long strings are cut short, so
+ * the overall shape of the reply stays visible.
  */
-bool parseCommandLine(std::vector<std::string> &args, const std::string &strCommand)
+static UniValue CollapseReply(const UniValue& val)
 {
-    enum CmdParseState
+    if (val.isArray() || val.isObject())
     {
-        STATE_EATING_SPACES,
-        STATE_ARGUMENT,
-        STATE_SINGLEQUOTED,
-        STATE_DOUBLEQUOTED,
-        STATE_ESCAPE_OUTER,
-        STATE_ESCAPE_DOUBLEQUOTED
-    } state = STATE_EATING_SPACES;
-    std::string curarg;
-    for (char ch : strCommand)
-    {
-        switch(state)
+        const std::vector<UniValue>& values = val.getValues();
+        UniValue ret(val.isObject() ? UniValue::VOBJ : UniValue::VARR);
+        size_t nKeep = std::min(values.size(), CONSOLE_COLLAPSE_ELEMS);
+        ret.reserve(nKeep + 1);
+        for (size_t i = 0; i < nKeep; i++)
         {
-        case STATE_ARGUMENT: // In or after argument
-        case STATE_EATING_SPACES: // Handle runs of whitespace
-            switch(ch)
-            {
-            case '"': state = STATE_DOUBLEQUOTED; break;
-            case '\'': state = STATE_SINGLEQUOTED; break;
-            case '\\': state = STATE_ESCAPE_OUTER; break;
-            case ' ': case '\n': case '\t':
-                if(state == STATE_ARGUMENT) // Space ends argument
-                {
-                    args.push_back(curarg);
-                    curarg.clear();
-                }
-                state = STATE_EATING_SPACES;
-                break;
-            default: curarg += ch; state = STATE_ARGUMENT;
-            }
-            break;
-        case STATE_SINGLEQUOTED: // Single-quoted string
-            switch(ch)
+            if (val.isObject())
             {
-            case '\'': state = STATE_ARGUMENT; break;
-            default: curarg += ch;
+                std::string key = val.getKeys()[i];
+                ret.pushKV(key, CollapseReply(values[i]));
             }
-            break;
-        case STATE_DOUBLEQUOTED: // Double-quoted string
-            switch(ch)
-            {
-            case '"': state = STATE_ARGUMENT; break;
-            case '\\': state = STATE_ESCAPE_DOUBLEQUOTED; break;
-            default: curarg += ch;
-            }
-            break;
-        case STATE_ESCAPE_OUTER: // '\' outside quotes
-            curarg += ch; state = STATE_ARGUMENT;
-            break;
-        case STATE_ESCAPE_DOUBLEQUOTED: // '\' in double-quoted text
-            if(ch != '"' && ch != '\\') curarg += '\\'; // keep '\' for everything but the quote and '\' itself
-            curarg += ch; state = STATE_DOUBLEQUOTED;
-            break;
+            else
+                ret.push_back(CollapseReply(values[i]));
         }
+        if (values.size() > nKeep)
+        {
+            UniValue note(strprintf("... %u more %s ...", (unsigned int)(values.size() - nKeep), val.isObject() ? "keys" : "elements"));
+            if (val.isObject())
+                ret.pushKV("...", note);
+            else
+                ret.push_back(note);
+        }
+        return ret;
     }
-    switch(state) // final state
-    {
-    case STATE_EATING_SPACES:
-        return true;
-    case STATE_ARGUMENT:
-        args.push_back(curarg);
-        return true;
-    default: // ERROR to end in one of the other states
-        return false;
-    }
+    if (val.isStr() && val.get_str().size() > CONSOLE_COLLAPSE_STRING)
+        return UniValue(val.get_str().substr(0, CONSOLE_COLLAPSE_STRING) +
+                        strprintf("... (%u more bytes)", (unsigned int)(val.get_str().size() - CONSOLE_COLLAPSE_STRING)));
+    return val;
 }
 
 void RPCExecutor::request(const QString &command)
@@ -222,7 +187,7 @@ void RPCExecutor::request(const QString &command)
             "   example:    getblock(getblockhash(0),true)[tx][0]\n\n")));
         return;
     }
-    if(!parseCommandLine(args, command.toStdString()))
+    if(!ParseCommandLine(args, command.toStdString()))
     {
         Q_EMIT reply(RPCConsole::CMD_ERROR, QString("Parse error: unbalanced ' or \""));
         return;
@@ -244,7 +209,21 @@ void RPCExecutor::request(const QString &command)
         else if (result.isStr())
             strPrint = result.get_str();
         else
+        {
             strPrint = result.write(2);
+            if (strPrint.size() > CONSOLE_MAX_REPLY_SIZE)
+            {
+                // Rendering e.g. a getblock verbosity-2 reply in full makes
+                // the console unusable; show the tree with its oversized
+                // subtrees collapsed and point at the full size instead.
+                size_t nFullSize = strPrint.size();
+                strPrint = CollapseReply(result).write(2);
+                strPrint += strprintf("\n\n(Reply was %u bytes; large subtrees are shown collapsed in the console. Use koto-cli for the complete response.)", (unsigned int)nFullSize);
+            }
+        }
+        if (strPrint.size() > CONSOLE_MAX_REPLY_HARD_SIZE)
+            strPrint = strPrint.substr(0, CONSOLE_MAX_REPLY_HARD_SIZE) +
+                strprintf("\n\n(... %u more bytes not shown. Use koto-cli for the complete response.)", (unsigned int)(strPrint.size() - CONSOLE_MAX_REPLY_HARD_SIZE));
 
         Q_EMIT reply(RPCConsole::CMD_REPLY, QString::fromStdString(strPrint));
     }
@@ -276,7 +255,8 @@ RPCConsole::RPCConsole(const PlatformStyle *platformStyle, QWidget *parent) :
     platformStyle(platformStyle),
     peersTableContextMenu(0),
     banTableContextMenu(0),
-    consoleFontSize(0)
+    consoleFontSize(0),
+    streamPos(0)
 {
     ui->setupUi(this);
     GUIUtil::restoreWindowGeometry("nRPCConsoleWindow", this->size(), this);
@@ -531,6 +511,9 @@ void RPCConsole::setFontSize(int newSize)
     if (newSize < FONT_RANGE.width() || newSize > FONT_RANGE.height())
         return;
 
+    // finish any reply still being streamed in, the document is rewritten below
+    flushReplyStream();
+
     // temp. store the console content
     QString str = ui->messagesWidget->toHtml();
 
@@ -550,6 +533,10 @@ void RPCConsole::setFontSize(int newSize)
 
 void RPCConsole::clear(bool clearHistory)
 {
+    // drop any reply still being streamed in, its target is cleared anyway
+    streamBuffer.clear();
+    streamPos = 0;
+
     ui->messagesWidget->clear();
     if(clearHistory)
     {
@@ -615,12 +602,70 @@ void RPCConsole::message(int category, const QString &message, bool html)
     out += "<table><tr><td class=\"time\" width=\"65\">" + timeString + "</td>";
     out += "<td class=\"icon\" width=\"32\"><img src=\"" + categoryClass(category) + "\"></td>";
     out += "<td class=\"message " + categoryClass(category) + "\" valign=\"middle\">";
+    bool fStream = !html && message.size() > CONSOLE_STREAM_CHUNK;
     if(html)
         out += message;
-    else
+    else if(!fStream)
         out += GUIUtil::HtmlEscape(message, false);
+    else
+        out += "&#65532;"; // object replacement character, marks where the reply is streamed in
     out += "</td></tr></table>";
     ui->messagesWidget->append(out);
+    if(fStream)
+        beginReplyStream(message);
+}
+
+// Insert a large reply into the view in chunks, so that the GUI thread keeps
+// processing events while e.g. a multi-megabyte reply is rendered.
+void RPCConsole::beginReplyStream(const QString &text)
+{
+    flushReplyStream(); // only one reply is streamed at a time
+
+    QTextDocument *document = ui->messagesWidget->document();
+    streamCursor = document->find(QString(QChar(0xfffc)), document->characterCount() - 1, QTextDocument::FindBackward);
+    if (streamCursor.isNull()) // marker not found, insert at once
+    {
+        ui->messagesWidget->insertPlainText(text);
+        return;
+    }
+    streamCursor.removeSelectedText();
+    streamBuffer = text;
+    streamPos = 0;
+    QTimer::singleShot(0, this, SLOT(streamReplyChunk()));
+}
+
+void RPCConsole::streamReplyChunk()
+{
+    if (streamPos >= streamBuffer.size())
+        return; // flushed or cleared in the meantime
+
+    QScrollBar *scrollbar = ui->messagesWidget->verticalScrollBar();
+    bool fAtBottom = (scrollbar->value() == scrollbar->maximum());
+
+    streamCursor.insertText(streamBuffer.mid(streamPos, CONSOLE_STREAM_CHUNK));
+    streamPos += CONSOLE_STREAM_CHUNK;
+
+    // follow the reply as it grows, but only if not scrolled away
+    if (fAtBottom)
+        scrollbar->setValue(scrollbar->maximum());
+
+    if (streamPos < streamBuffer.size())
+        QTimer::singleShot(0, this, SLOT(streamReplyChunk()));
+    else
+    {
+        streamBuffer.clear();
+        streamPos = 0;
+    }
+}
+
+// Insert whatever is left of a streaming reply at once. Called before
+// operations that reset or rewrite the whole document.
+void RPCConsole::flushReplyStream()
+{
+    if (streamPos < streamBuffer.size())
+        streamCursor.insertText(streamBuffer.mid(streamPos));
+    streamBuffer.clear();
+    streamPos = 0;
 }
 
 void RPCConsole::setNumConnections(int count)
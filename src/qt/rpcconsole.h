@@ -12,6 +12,7 @@
 
 #include <QWidget>
 #include <QCompleter>
+#include <QTextCursor>
 #include <QThread>
 
 class ClientModel;
@@ -77,6 +78,8 @@ private Q_SLOTS:
     void showOrHideBanTableIfRequired();
     /** clear the selected node */
     void clearSelectedNode();
+    /** insert the next chunk of a large reply into the console view */
+    void streamReplyChunk();
 
 public Q_SLOTS:
     void clear(bool clearHistory = true);
@@ -116,6 +119,10 @@ Q_SIGNALS:
 private:
     static QString FormatBytes(quint64 bytes);
     void startExecutor();
+    /** start inserting a large reply into the view in chunks */
+    void beginReplyStream(const QString &text);
+    /** insert whatever is left of a streaming reply at once */
+    void flushReplyStream();
     void setTrafficGraphRange(int mins);
     /** show detailed information on ui about selected node */
     void updateNodeDetail(const CNodeCombinedStats *stats);
@@ -142,6 +149,9 @@ private:
     int consoleFontSize;
     QCompleter *autoCompleter;
     QThread thread;
+    QTextCursor streamCursor;
+    QString streamBuffer;
+    int streamPos;
 };
 
 #endif // BITCOIN_QT_RPCCONSOLE_H
@@ -25,9 +25,14 @@
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+#include <QTimer>
 
 #include <boost/foreach.hpp>
 
+// Number of wallet transactions materialized per event-loop pass while the
+// model is filling itself after a wallet (re)load.
+static const int LOAD_BATCH_TX_COUNT = 250;
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
         Qt::AlignLeft|Qt::AlignVCenter, /* status */
@@ -74,21 +79,72 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Transactions not yet materialized into cachedWallet, in wallet (hash)
+     * order. Consumed front-to-back by loadBatch(); nPendingPos marks how far
+     * materialization has progressed.
+     */
+    std::vector<uint256> vPendingTxs;
+    size_t nPendingPos = 0;
+
+    /* Re-index the wallet. Only collects the transaction hashes; the records
+     * themselves are materialized in batches by loadBatch() so that opening a
+     * wallet with a large history does not block the GUI on decomposing every
+     * transaction up front.
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
 	TransactionRecord::ztxMap.clear();
+        vPendingTxs.clear();
+        nPendingPos = 0;
         {
             LOCK2(cs_main, wallet->cs_wallet);
+            vPendingTxs.reserve(wallet->mapWallet.size());
             for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
             {
-                if(TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+                vPendingTxs.push_back(it->first);
+            }
+        }
+    }
+
+    /* Materialize records for up to nTxs pending transactions. Returns true
+     * while more remain. Transactions that updateWallet() already inserted
+     * (or that have left the wallet) in the meantime are skipped.
+     */
+    bool loadBatch(int nTxs)
+    {
+        if (nPendingPos >= vPendingTxs.size())
+            return false;
+        TransactionRecord::ztxMap.clear();
+        LOCK2(cs_main, wallet->cs_wallet);
+        for (; nPendingPos < vPendingTxs.size() && nTxs > 0; nPendingPos++, nTxs--)
+        {
+            const uint256 &hash = vPendingTxs[nPendingPos];
+            QList<TransactionRecord>::iterator lower = qLowerBound(
+                cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+            QList<TransactionRecord>::iterator upper = qUpperBound(
+                cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+            if(lower != upper) /* already inserted by updateWallet() */
+                continue;
+            std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+            if(mi == wallet->mapWallet.end() || !TransactionRecord::showTransaction(mi->second))
+                continue;
+            QList<TransactionRecord> toInsert =
+                    TransactionRecord::decomposeTransaction(wallet, mi->second);
+            if(!toInsert.isEmpty())
+            {
+                int insert_idx = lower - cachedWallet.begin();
+                parent->beginInsertRows(QModelIndex(), insert_idx, insert_idx+toInsert.size()-1);
+                for (const TransactionRecord &rec : toInsert)
+                {
+                    cachedWallet.insert(insert_idx, rec);
+                    insert_idx += 1;
+                }
+                parent->endInsertRows();
             }
         }
+        return nPendingPos < vPendingTxs.size();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -248,11 +304,23 @@ TransactionTableModel::TransactionTableModel(const PlatformStyle *platformStyle,
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Label") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
     priv->refreshWallet();
 
+    // Materialize records in batches from the event loop so the window opens
+    // immediately; rows stream into the (sorting) views as they are loaded.
+    loadTimer = new QTimer(this);
+    connect(loadTimer, SIGNAL(timeout()), this, SLOT(loadTransactionsBatch()));
+    loadTimer->start(0);
+
     connect(walletModel->getOptionsModel(), SIGNAL(displayUnitChanged(int)), this, SLOT(updateDisplayUnit()));
 
     subscribeToCoreSignals();
 }
 
+void TransactionTableModel::loadTransactionsBatch()
+{
+    if(!priv->loadBatch(LOAD_BATCH_TX_COUNT))
+        loadTimer->stop();
+}
+
 TransactionTableModel::~TransactionTableModel()
 {
     unsubscribeFromCoreSignals();
@@ -15,6 +15,10 @@ class TransactionRecord;
 class TransactionTablePriv;
 class WalletModel;
 
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
 class CWallet;
 
 /** UI model for the transaction table of a wallet.
@@ -86,6 +90,7 @@ private:
     WalletModel *walletModel;
     QStringList columns;
     TransactionTablePriv *priv;
+    QTimer *loadTimer;
     bool fProcessingQueuedTransactions;
     const PlatformStyle *platformStyle;
 
@@ -113,6 +118,8 @@ public Q_SLOTS:
     void updateAmountColumnTitle();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /* Materialize the next batch of records after a wallet (re)load */
+    void loadTransactionsBatch();
 
     friend class TransactionTablePriv;
 };
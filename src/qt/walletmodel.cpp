@@ -25,6 +25,7 @@
 
 #include <stdint.h>
 
+#include <QDateTime>
 #include <QDebug>
 #include <QSet>
 #include <QTimer>
@@ -39,7 +40,10 @@ WalletModel::WalletModel(const PlatformStyle *platformStyle, CWallet *wallet, Op
     cachedTBalance(0), cachedZBalance(0), cachedUnshielded(0)
 {
     fHaveWatchOnly = wallet->HaveWatchOnly();
-    fForceCheckBalanceChanged = false;
+    // Compute the initial balances on the first poll tick.
+    fForceCheckBalanceChanged = true;
+    fTipChanged = false;
+    nLastBlockTipUpdate = 0;
 
     addressTableModel = new AddressTableModel(wallet, this);
     coinSelectionTableModel = new CoinSelectionTableModel(wallet, this);
@@ -162,6 +166,13 @@ void WalletModel::updateStatus()
 
 void WalletModel::pollBalanceChanged()
 {
+    // Recomputation is driven by wallet and block-tip notifications; the
+    // timer only coalesces bursts of them. When nothing has been flagged
+    // since the last pass, return without touching any locks so an idle GUI
+    // never contends with the core.
+    if(!fForceCheckBalanceChanged && !fTipChanged)
+        return;
+
     // Get required locks upfront. This avoids the GUI from getting stuck on
     // periodical polls if the core is holding the locks for a longer time -
     // for example, during a wallet rescan.
@@ -172,17 +183,12 @@ void WalletModel::pollBalanceChanged()
     if(!lockWallet)
         return;
 
-    if(fForceCheckBalanceChanged || chainActive.Height() != cachedNumBlocks)
-    {
-        fForceCheckBalanceChanged = false;
-
-        // Balance and number of transactions might have changed
-        cachedNumBlocks = chainActive.Height();
+    fForceCheckBalanceChanged = false;
+    fTipChanged = false;
 
-        checkBalanceChanged();
-        if(transactionTableModel)
-            transactionTableModel->updateConfirmations();
-    }
+    checkBalanceChanged();
+    if(transactionTableModel)
+        transactionTableModel->updateConfirmations();
 }
 
 void WalletModel::checkBalanceChanged()
@@ -232,6 +238,19 @@ void WalletModel::updateTransaction()
     fForceCheckBalanceChanged = true;
 }
 
+void WalletModel::updateBlockTip(int height, bool initialSync)
+{
+    cachedNumBlocks = height;
+    // During initial block download confirmations change with every block;
+    // rate-limit the refreshes the tip signal triggers.
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if(!initialSync || now - nLastBlockTipUpdate > 2000)
+    {
+        fTipChanged = true;
+        nLastBlockTipUpdate = now;
+    }
+}
+
 void WalletModel::updateAddressBook(const QString &address, const QString &label,
         bool isMine, const QString &purpose, int status)
 {
@@ -630,6 +649,13 @@ static void NotifyWatchonlyChanged(WalletModel *walletmodel, bool fHaveWatchonly
                               Q_ARG(bool, fHaveWatchonly));
 }
 
+static void NotifyBlockTipChanged(WalletModel *walletmodel, bool initialSync, const CBlockIndex *pIndex)
+{
+    QMetaObject::invokeMethod(walletmodel, "updateBlockTip", Qt::QueuedConnection,
+                              Q_ARG(int, pIndex->nHeight),
+                              Q_ARG(bool, initialSync));
+}
+
 void WalletModel::subscribeToCoreSignals()
 {
     // Connect signals to wallet
@@ -639,6 +665,7 @@ void WalletModel::subscribeToCoreSignals()
     wallet->NotifyTransactionChanged.connect(boost::bind(NotifyTransactionChanged, this, boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
     wallet->ShowProgress.connect(boost::bind(ShowProgress, this, boost::placeholders::_1, boost::placeholders::_2));
     wallet->NotifyWatchonlyChanged.connect(boost::bind(NotifyWatchonlyChanged, this, boost::placeholders::_1));
+    uiInterface.NotifyBlockTip.connect(boost::bind(NotifyBlockTipChanged, this, boost::placeholders::_1, boost::placeholders::_2));
 }
 
 void WalletModel::unsubscribeFromCoreSignals()
@@ -650,6 +677,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     wallet->NotifyTransactionChanged.disconnect(boost::bind(NotifyTransactionChanged, this, boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3));
     wallet->ShowProgress.disconnect(boost::bind(ShowProgress, this, boost::placeholders::_1, boost::placeholders::_2));
     wallet->NotifyWatchonlyChanged.disconnect(boost::bind(NotifyWatchonlyChanged, this, boost::placeholders::_1));
+    uiInterface.NotifyBlockTip.disconnect(boost::bind(NotifyBlockTipChanged, this, boost::placeholders::_1, boost::placeholders::_2));
 }
 
 // WalletModel::UnlockContext implementation
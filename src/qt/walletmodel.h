@@ -204,6 +204,8 @@ private:
     CWallet *wallet;
     bool fHaveWatchOnly;
     bool fForceCheckBalanceChanged;
+    bool fTipChanged;
+    qint64 nLastBlockTipUpdate;
 
     // Wallet has an options model for wallet-specific options
     // (transaction fee, for example)
@@ -273,6 +275,9 @@ public Q_SLOTS:
     void updateWatchOnlyFlag(bool fHaveWatchonly);
     /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
     void pollBalanceChanged();
+    /* New block tip connected; balance/confirmation refresh is driven by this
+       instead of polling the chain height */
+    void updateBlockTip(int height, bool initialSync);
 };
 
 #endif // BITCOIN_QT_WALLETMODEL_H
@@ -39,6 +39,68 @@ void GetRandBytes(unsigned char* buf, size_t num)
     librustzcash_getrandom(buf, num);
 }
 
+namespace {
+
+/**
+ * Per-thread fast CSPRNG backing GetRand/GetRandInt/GetRandHash.
+ *
+ * Each thread keeps its own ChaCha20 stream seeded from the OS entropy
+ * source, so frequent small draws — connection nonces, hasher salts,
+ * random delays — never touch a shared pool or take a lock. The stream
+ * is reseeded from the slow path after a bounded amount of output.
+ *
+ * Long-lived secret key material does not come through here: key.cpp and
+ * the wallet crypter call GetRandBytes directly and always hit the OS.
+ */
+class CFastRandStream
+{
+private:
+    //! Output drawn between reseeds; far below any ChaCha20 usage limit.
+    static const uint64_t RESEED_BYTES = 1 << 20;
+
+    ChaCha20 rng;
+    unsigned char bytebuf[64];
+    size_t bytebuf_used;
+    uint64_t nBytesUntilReseed;
+
+    void Reseed()
+    {
+        unsigned char seed[32];
+        librustzcash_getrandom(seed, sizeof(seed));
+        rng.SetKey(seed, sizeof(seed));
+        memory_cleanse(seed, sizeof(seed));
+        nBytesUntilReseed = RESEED_BYTES;
+        bytebuf_used = sizeof(bytebuf);
+    }
+
+public:
+    CFastRandStream() : bytebuf_used(sizeof(bytebuf)), nBytesUntilReseed(0) {}
+
+    void Output(unsigned char* buf, size_t num)
+    {
+        while (num > 0) {
+            if (bytebuf_used == sizeof(bytebuf)) {
+                if (nBytesUntilReseed < sizeof(bytebuf)) {
+                    Reseed();
+                }
+                rng.Output(bytebuf, sizeof(bytebuf));
+                nBytesUntilReseed -= sizeof(bytebuf);
+                bytebuf_used = 0;
+            }
+            size_t nNow = std::min(num, sizeof(bytebuf) - bytebuf_used);
+            memcpy(buf, bytebuf + bytebuf_used, nNow);
+            memory_cleanse(bytebuf + bytebuf_used, nNow);
+            bytebuf_used += nNow;
+            buf += nNow;
+            num -= nNow;
+        }
+    }
+};
+
+thread_local CFastRandStream fastRandStream;
+
+} // namespace
+
 uint64_t GetRand(uint64_t nMax)
 {
     if (nMax == 0)
@@ -49,7 +111,7 @@ uint64_t GetRand(uint64_t nMax)
     uint64_t nRange = (std::numeric_limits<uint64_t>::max() / nMax) * nMax;
     uint64_t nRand = 0;
     do {
-        GetRandBytes((unsigned char*)&nRand, sizeof(nRand));
+        fastRandStream.Output((unsigned char*)&nRand, sizeof(nRand));
     } while (nRand >= nRange);
     return (nRand % nMax);
 }
@@ -62,7 +124,7 @@ int GetRandInt(int nMax)
 uint256 GetRandHash()
 {
     uint256 hash;
-    GetRandBytes((unsigned char*)&hash, sizeof(hash));
+    fastRandStream.Output((unsigned char*)&hash, sizeof(hash));
     return hash;
 }
 
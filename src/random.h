@@ -15,9 +15,16 @@
 #include <stdint.h>
 
 /**
- * Functions to gather random data via the rand_core OsRng
+ * Gather random data via the rand_core OsRng. This is the slow path; use
+ * it directly for long-lived secret key material.
  */
 void GetRandBytes(unsigned char* buf, size_t num);
+
+/**
+ * Fast random draws from a per-thread ChaCha20 stream that is seeded (and
+ * periodically reseeded) from the OS entropy source. Lock-free and
+ * suitable for nonces, salts and jitter on hot paths.
+ */
 uint64_t GetRand(uint64_t nMax);
 int GetRandInt(int nMax);
 uint256 GetRandHash();
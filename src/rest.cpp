@@ -18,6 +18,8 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/dynamic_bitset.hpp>
 
+#include <event2/buffer.h>
+
 #include <univalue.h>
 
 using namespace std;
@@ -166,7 +168,8 @@ static bool rest_headers(HTTPRequest* req,
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        string strHex((ssHeader.size()) * 2 + 1, '\n');
+        HexEncode(reinterpret_cast<const unsigned char*>(ssHeader.data()), ssHeader.size(), &strHex[0]);
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -179,9 +182,9 @@ static bool rest_headers(HTTPRequest* req,
                 jsonHeaders.push_back(blockheaderToJSON(pindex));
             }
         }
-        string strJSON = jsonHeaders.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), jsonHeaders);
+        req->WriteReply(HTTP_OK);
         return true;
     }
     default: {
@@ -207,8 +210,8 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -218,37 +221,46 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        pos = pblockindex->GetBlockPos();
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
+    // For binary and hex responses, hand back the already-serialized bytes
+    // from the block file; deserializing into a CBlock only to re-serialize
+    // it is pure overhead.
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
+        std::vector<unsigned char> rawBlock;
+        if (!ReadRawBlockFromDisk(rawBlock, pos, Params().MessageStart()))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        evbuffer_add(req->OutputBuffer(), rawBlock.data(), rawBlock.size());
+        req->WriteReply(HTTP_OK);
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::vector<unsigned char> rawBlock;
+        if (!ReadRawBlockFromDisk(rawBlock, pos, Params().MessageStart()))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        string strHex((rawBlock.size()) * 2 + 1, '\n');
+        HexEncode(rawBlock.data(), rawBlock.size(), &strHex[0]);
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
     }
 
     case RF_JSON: {
+        CBlock block;
         UniValue objBlock;
         {
             LOCK(cs_main);
+            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
             objBlock = blockToJSON(block, pblockindex, showTxDetails);
         }
-        string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), objBlock);
+        req->WriteReply(HTTP_OK);
         return true;
     }
 
@@ -285,9 +297,9 @@ static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
     case RF_JSON: {
         UniValue rpcParams(UniValue::VARR);
         UniValue chainInfoObject = getblockchaininfo(rpcParams, false);
-        string strJSON = chainInfoObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), chainInfoObject);
+        req->WriteReply(HTTP_OK);
         return true;
     }
     default: {
@@ -310,9 +322,9 @@ static bool rest_mempool_info(HTTPRequest* req, const std::string& strURIPart)
     case RF_JSON: {
         UniValue mempoolInfoObject = mempoolInfoToJSON();
 
-        string strJSON = mempoolInfoObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), mempoolInfoObject);
+        req->WriteReply(HTTP_OK);
         return true;
     }
     default: {
@@ -335,9 +347,9 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
     case RF_JSON: {
         UniValue mempoolObject = mempoolToJSON(true);
 
-        string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), mempoolObject);
+        req->WriteReply(HTTP_OK);
         return true;
     }
     default: {
@@ -378,7 +390,8 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssTx.begin(), ssTx.end()) + "\n";
+        string strHex((ssTx.size()) * 2 + 1, '\n');
+        HexEncode(reinterpret_cast<const unsigned char*>(ssTx.data()), ssTx.size(), &strHex[0]);
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -387,9 +400,9 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     case RF_JSON: {
         UniValue objTx(UniValue::VOBJ);
         TxToJSON(tx, hashBlock, objTx);
-        string strJSON = objTx.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), objTx);
+        req->WriteReply(HTTP_OK);
         return true;
     }
 
@@ -501,9 +514,49 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     vector<CCoin> outs;
     std::string bitmapStringRepresentation;
     boost::dynamic_bitset<unsigned char> hits(vOutPoints.size());
-    {
+    int nChainHeight = 0;
+    uint256 hashChainTip;
+    bool fQueried = false;
+    if (!fCheckMemPool) {
+        // Chain-only probes are answered from a snapshot of the flushed
+        // coins database without taking cs_main, so they do not contend
+        // with validation; the result is stale by at most the coins not yet
+        // flushed from the in-memory cache, and the reported tip is the one
+        // the answer is consistent with.
+        std::shared_ptr<const CCoinsViewDBSnapshot> snapshot = pcoinsdbview->GetSnapshot();
+        // A snapshot taken during a multi-batch flush is between blocks;
+        // fall back to the locked view for those.
+        if (snapshot->GetHeadBlocks().empty()) {
+            hashChainTip = snapshot->GetBestBlock();
+            {
+                LOCK(cs_main);
+                BlockMap::iterator mi = mapBlockIndex.find(hashChainTip);
+                if (mi != mapBlockIndex.end())
+                    nChainHeight = mi->second->nHeight;
+            }
+            for (size_t i = 0; i < vOutPoints.size(); i++) {
+                CCoins coins;
+                if (snapshot->GetCoins(vOutPoints[i].hash, coins) && coins.IsAvailable(vOutPoints[i].n)) {
+                    hits[i] = true;
+                    CCoin coin;
+                    coin.nTxVer = coins.nVersion;
+                    coin.nHeight = coins.nHeight;
+                    coin.out = coins.vout.at(vOutPoints[i].n);
+                    assert(!coin.out.IsNull());
+                    outs.push_back(coin);
+                }
+
+                bitmapStringRepresentation.append(hits[i] ? "1" : "0"); // form a binary string representation (human-readable for json output)
+            }
+            fQueried = true;
+        }
+    }
+    if (!fQueried) {
         LOCK2(cs_main, mempool.cs);
 
+        nChainHeight = chainActive.Height();
+        hashChainTip = chainActive.Tip()->GetBlockHash();
+
         CCoinsView viewDummy;
         CCoinsViewCache view(&viewDummy);
 
@@ -541,7 +594,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         // serialize data
         // use exact same output as mentioned in Bip64
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nChainHeight << hashChainTip << bitmap << outs;
         string ssGetUTXOResponseString = ssGetUTXOResponse.str();
 
         req->WriteHeader("Content-Type", "application/octet-stream");
@@ -551,8 +604,9 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
     case RF_HEX: {
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
-        string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
+        ssGetUTXOResponse << nChainHeight << hashChainTip << bitmap << outs;
+        string strHex((ssGetUTXOResponse.size()) * 2 + 1, '\n');
+        HexEncode(reinterpret_cast<const unsigned char*>(ssGetUTXOResponse.data()), ssGetUTXOResponse.size(), &strHex[0]);
 
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
@@ -564,8 +618,8 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
         // pack in some essentials
         // use more or less the same output as mentioned in Bip64
-        objGetUTXOResponse.pushKV("chainHeight", chainActive.Height());
-        objGetUTXOResponse.pushKV("chaintipHash", chainActive.Tip()->GetBlockHash().GetHex());
+        objGetUTXOResponse.pushKV("chainHeight", nChainHeight);
+        objGetUTXOResponse.pushKV("chaintipHash", hashChainTip.GetHex());
         objGetUTXOResponse.pushKV("bitmap", bitmapStringRepresentation);
 
         UniValue utxos(UniValue::VARR);
@@ -583,10 +637,10 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         }
         objGetUTXOResponse.pushKV("utxos", utxos);
 
-        // return json string
-        string strJSON = objGetUTXOResponse.write() + "\n";
+        // stream json response
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONToBuffer(req->OutputBuffer(), objGetUTXOResponse);
+        req->WriteReply(HTTP_OK);
         return true;
     }
     default: {
@@ -13,9 +13,11 @@
 #include "main.h"
 #include "metrics.h"
 #include "primitives/transaction.h"
+#include "fs.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "util.h"
 
 #include <stdint.h>
@@ -30,25 +32,10 @@ using namespace std;
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 
-double GetDifficultyINTERNAL(const CBlockIndex* blockindex, bool networkDifficulty)
+static double DifficultyFromBits(uint32_t bits)
 {
     // Floating point number that is a multiple of the minimum difficulty,
     // minimum difficulty = 1.0.
-    if (blockindex == NULL)
-    {
-        if (chainActive.Tip() == NULL)
-            return 1.0;
-        else
-            blockindex = chainActive.Tip();
-    }
-
-    uint32_t bits;
-    if (networkDifficulty) {
-        bits = GetNextWorkRequired(blockindex, nullptr, Params().GetConsensus());
-    } else {
-        bits = blockindex->nBits;
-    }
-
     uint32_t powLimit =
         UintToArith256(Params().GetConsensus().powLimit).GetCompact();
     int nShift = (bits >> 24) & 0xff;
@@ -72,6 +59,26 @@ double GetDifficultyINTERNAL(const CBlockIndex* blockindex, bool networkDifficul
     return dDiff;
 }
 
+double GetDifficultyINTERNAL(const CBlockIndex* blockindex, bool networkDifficulty)
+{
+    if (blockindex == NULL)
+    {
+        if (chainActive.Tip() == NULL)
+            return 1.0;
+        else
+            blockindex = chainActive.Tip();
+    }
+
+    uint32_t bits;
+    if (networkDifficulty) {
+        bits = GetNextWorkRequired(blockindex, nullptr, Params().GetConsensus());
+    } else {
+        bits = blockindex->nBits;
+    }
+
+    return DifficultyFromBits(bits);
+}
+
 double GetDifficulty(const CBlockIndex* blockindex)
 {
     return GetDifficultyINTERNAL(blockindex, false);
@@ -263,6 +270,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.pushKV("anchor", blockindex->hashFinalSproutRoot.GetHex());
 
     UniValue valuePools(UniValue::VARR);
+    valuePools.push_back(ValuePoolDesc("transparent", blockindex->nChainTransparentValue, blockindex->nTransparentValue));
     valuePools.push_back(ValuePoolDesc("sprout", blockindex->nChainSproutValue, blockindex->nSproutValue));
     valuePools.push_back(ValuePoolDesc("sapling", blockindex->nChainSaplingValue, blockindex->nSaplingValue));
     valuePools.push_back(ValuePoolDesc("orchard", blockindex->nChainOrchardValue, blockindex->nOrchardValue));
@@ -289,6 +297,11 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockcount", "")
         );
 
+    // Served from the published tip snapshot so monitoring polls never
+    // queue behind block validation.
+    if (auto snapshot = GetChainTipSnapshot())
+        return snapshot->nHeight;
+
     LOCK(cs_main);
     return chainActive.Height();
 }
@@ -306,6 +319,9 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
+    if (auto snapshot = GetChainTipSnapshot())
+        return snapshot->hashBlock.GetHex();
+
     LOCK(cs_main);
     return chainActive.Tip()->GetBlockHash().GetHex();
 }
@@ -323,44 +339,82 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getdifficulty", "")
         );
 
+    // The snapshot carries the next-work-required target computed at the
+    // last tip change, which is exactly getdifficulty's semantics.
+    if (auto snapshot = GetChainTipSnapshot())
+        return DifficultyFromBits(snapshot->nBitsNext);
+
     LOCK(cs_main);
     return GetNetworkDifficulty();
 }
 
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e, int nChainHeight)
+{
+    UniValue info(UniValue::VOBJ);
+    info.pushKV("size", (int)e.GetTxSize());
+    info.pushKV("fee", ValueFromAmount(e.GetFee()));
+    info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
+    info.pushKV("time", e.GetTime());
+    info.pushKV("height", (int)e.GetHeight());
+    info.pushKV("startingpriority", e.GetPriority(e.GetHeight()));
+    info.pushKV("currentpriority", e.GetPriority(nChainHeight));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    for (const CTxIn& txin : tx.vin)
+    {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    for (const string& dep : setDepends)
+    {
+        depends.push_back(dep);
+    }
+
+    info.pushKV("depends", depends);
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose)
     {
+        // Building the verbose object from scratch is O(pool size) under
+        // mempool.cs, which stalls transaction admission when monitoring
+        // polls a large pool. Keep the per-entry JSON from the previous
+        // call and rebuild only entries that have entered since; when
+        // nothing has changed at all, hand back the cached object as is.
+        static std::map<uint256, UniValue> cachedEntries;
+        static UniValue cachedObject(UniValue::VOBJ);
+        static unsigned int nCachedUpdates = 0;
+        static int nCachedHeight = -1;
+        static bool fCacheValid = false;
+
         LOCK(mempool.cs);
+        int nChainHeight = chainActive.Height();
+        if (fCacheValid && mempool.GetTransactionsUpdated() == nCachedUpdates && nChainHeight == nCachedHeight)
+            return cachedObject;
+        // currentpriority ages with the chain tip, so per-entry JSON can
+        // only be reused while the height is unchanged.
+        if (nChainHeight != nCachedHeight)
+            cachedEntries.clear();
+
         UniValue o(UniValue::VOBJ);
+        std::map<uint256, UniValue> newEntries;
         for (const CTxMemPoolEntry& e : mempool.mapTx)
         {
             const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.pushKV("size", (int)e.GetTxSize());
-            info.pushKV("fee", ValueFromAmount(e.GetFee()));
-            info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
-            info.pushKV("time", e.GetTime());
-            info.pushKV("height", (int)e.GetHeight());
-            info.pushKV("startingpriority", e.GetPriority(e.GetHeight()));
-            info.pushKV("currentpriority", e.GetPriority(chainActive.Height()));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            for (const CTxIn& txin : tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            for (const string& dep : setDepends)
-            {
-                depends.push_back(dep);
-            }
-
-            info.pushKV("depends", depends);
+            std::map<uint256, UniValue>::iterator it = cachedEntries.find(hash);
+            UniValue info = (it != cachedEntries.end()) ? it->second : mempoolEntryToJSON(e, nChainHeight);
             o.pushKV(hash.ToString(), info);
+            newEntries[hash] = info;
         }
+        cachedEntries.swap(newEntries);
+        cachedObject = o;
+        nCachedUpdates = mempool.GetTransactionsUpdated();
+        nCachedHeight = nChainHeight;
+        fCacheValid = true;
         return o;
     }
     else
@@ -376,14 +430,54 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+static UniValue mempoolPageToJSON(bool fVerbose, size_t nMaxCount, const uint256& hashCursor)
+{
+    LOCK(mempool.cs);
+    int nChainHeight = chainActive.Height();
+
+    // Pages walk the entry-time index: its order is deterministic and an
+    // entry's position does not move as other transactions come and go,
+    // so a txid cursor resumes where the previous page stopped.
+    const auto& byTime = mempool.mapTx.get<4>();
+    auto it = byTime.begin();
+    if (!hashCursor.IsNull()) {
+        CTxMemPool::txiter cursorIt = mempool.mapTx.find(hashCursor);
+        if (cursorIt == mempool.mapTx.end())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor transaction is no longer in the mempool");
+        it = mempool.mapTx.project<4>(cursorIt);
+        ++it;
+    }
+
+    UniValue txs(fVerbose ? UniValue::VOBJ : UniValue::VARR);
+    uint256 hashLast;
+    size_t nCount = 0;
+    for (; it != byTime.end() && nCount < nMaxCount; ++it, ++nCount) {
+        hashLast = it->GetTx().GetHash();
+        if (fVerbose)
+            txs.pushKV(hashLast.ToString(), mempoolEntryToJSON(*it, nChainHeight));
+        else
+            txs.push_back(hashLast.ToString());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("transactions", txs);
+    result.pushKV("cursor", it != byTime.end() ? hashLast.GetHex() : "");
+    return result;
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 1)
+    if (fHelp || params.size() > 3)
         throw runtime_error(
-            "getrawmempool ( verbose )\n"
+            "getrawmempool ( verbose maxcount \"cursor\" )\n"
             "\nReturns all transaction ids in memory pool as a json array of string transaction ids.\n"
+            "\nIf maxcount is given, at most that many entries are returned in mempool entry order,\n"
+            "starting after the entry named by cursor; the result then also carries the cursor for\n"
+            "the next page (empty when the pool is exhausted).\n"
             "\nArguments:\n"
             "1. verbose           (boolean, optional, default=false) true for a json object, false for array of transaction ids\n"
+            "2. maxcount          (numeric, optional) page size; enables paginated output\n"
+            "3. \"cursor\"          (string, optional) txid of the last entry of the previous page\n"
             "\nResult: (for verbose = false):\n"
             "[                     (json array of string)\n"
             "  \"transactionid\"     (string) The transaction id\n"
@@ -415,6 +509,16 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
 
+    if (params.size() > 1) {
+        int64_t nMaxCount = params[1].get_int64();
+        if (nMaxCount <= 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "maxcount must be positive");
+        uint256 hashCursor;
+        if (params.size() > 2 && !params[2].get_str().empty())
+            hashCursor = ParseHashV(params[2], "cursor");
+        return mempoolPageToJSON(fVerbose, (size_t)nMaxCount, hashCursor);
+    }
+
     return mempoolToJSON(fVerbose);
 }
 
@@ -691,6 +795,122 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     return blockheaderToJSON(pblockindex);
 }
 
+UniValue getblockheaders(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getblockheaders \"hash\" ( count verbose )\n"
+            "\nReturns up to count headers of the active chain starting from block 'hash',\n"
+            "serialized in one lock acquisition. Intended for header sync by explorers and\n"
+            "light clients instead of calling getblockheader once per block.\n"
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The hash of the first header to return\n"
+            "2. count             (numeric, optional, default=2000) Maximum number of headers to return (1 to 2000)\n"
+            "3. verbose           (boolean, optional, default=false) true for an array of json objects, false for a single hex string of concatenated serialized headers\n"
+            "\nResult (for verbose=false):\n"
+            "\"data\"             (string) Concatenated serialized, hex-encoded headers, in height order\n"
+            "\nResult (for verbose=true):\n"
+            "[\n"
+            "  { ... },           (json object) Same fields as getblockheader\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockheaders", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" 2000")
+            + HelpExampleRpc("getblockheaders", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", 2000")
+        );
+
+    static const int MAX_HEADERS_RESULT = 2000;
+
+    std::string strHash = params[0].get_str();
+    uint256 hash(uint256S(strHash));
+
+    int nCount = MAX_HEADERS_RESULT;
+    if (params.size() > 1)
+        nCount = params[1].get_int();
+    if (nCount < 1 || nCount > MAX_HEADERS_RESULT)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Count must be between 1 and %d", MAX_HEADERS_RESULT));
+
+    bool fVerbose = false;
+    if (params.size() > 2)
+        fVerbose = params[2].get_bool();
+
+    LOCK(cs_main);
+
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
+    if (mi == mapBlockIndex.end())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    const CBlockIndex* pblockindex = mi->second;
+
+    if (fVerbose) {
+        UniValue result(UniValue::VARR);
+        for (; pblockindex && nCount > 0; nCount--) {
+            result.push_back(blockheaderToJSON(pblockindex));
+            // Only the active chain can be walked forward; a starting block
+            // on a side chain yields just its own header.
+            pblockindex = chainActive.Next(pblockindex);
+        }
+        return result;
+    }
+
+    CDataStream ssHeaders(SER_NETWORK, PROTOCOL_VERSION);
+    for (; pblockindex && nCount > 0; nCount--) {
+        ssHeaders << pblockindex->GetBlockHeader();
+        pblockindex = chainActive.Next(pblockindex);
+    }
+    return HexStr(ssHeaders.begin(), ssHeaders.end());
+}
+
+namespace {
+
+/**
+ * Cache of rendered getblock results, keyed by block hash and verbosity.
+ * Explorers tend to request the same recent blocks over and over, and at
+ * verbosity 2 every transaction is re-rendered to JSON on each call. Entries
+ * are only valid for the tip they were rendered under -- confirmations and
+ * nextblockhash change with the tip -- so the cache is dropped whenever the
+ * tip hash differs, which also covers reorgs.
+ */
+struct BlockJSONCacheEntry {
+    uint256 hash;
+    int verbosity;
+    UniValue result;
+};
+
+static const size_t BLOCK_JSON_CACHE_SIZE = 32;
+static CCriticalSection cs_blockJSONCache;
+static uint256 blockJSONCacheTip;
+//! Most recently used first.
+static std::list<BlockJSONCacheEntry> blockJSONCache;
+
+bool BlockJSONCacheLookup(const uint256& hashTip, const uint256& hash, int verbosity, UniValue& result)
+{
+    LOCK(cs_blockJSONCache);
+    if (blockJSONCacheTip != hashTip)
+        return false;
+    for (std::list<BlockJSONCacheEntry>::iterator it = blockJSONCache.begin(); it != blockJSONCache.end(); ++it) {
+        if (it->hash == hash && it->verbosity == verbosity) {
+            blockJSONCache.splice(blockJSONCache.begin(), blockJSONCache, it);
+            result = it->result;
+            return true;
+        }
+    }
+    return false;
+}
+
+void BlockJSONCacheStore(const uint256& hashTip, const uint256& hash, int verbosity, const UniValue& result)
+{
+    LOCK(cs_blockJSONCache);
+    if (blockJSONCacheTip != hashTip) {
+        blockJSONCache.clear();
+        blockJSONCacheTip = hashTip;
+    }
+    blockJSONCache.push_front({hash, verbosity, result});
+    if (blockJSONCache.size() > BLOCK_JSON_CACHE_SIZE)
+        blockJSONCache.pop_back();
+}
+
+} // anonymous namespace
+
 UniValue getblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -769,6 +989,11 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
+    const uint256 hashTip = chainActive.Tip()->GetBlockHash();
+    UniValue cached;
+    if (BlockJSONCacheLookup(hashTip, hash, verbosity, cached))
+        return cached;
+
     CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
@@ -778,15 +1003,17 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
+    UniValue result;
     if (verbosity == 0)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        result = HexStr(ssBlock.begin(), ssBlock.end());
+    } else {
+        result = blockToJSON(block, pblockindex, verbosity >= 2);
     }
-
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    BlockJSONCacheStore(hashTip, hash, verbosity, result);
+    return result;
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
@@ -827,6 +1054,48 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue getdbstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getdbstats\n"
+            "\nReturns LevelDB statistics for the block index and chainstate databases,\n"
+            "useful for sizing -dbcache and the -db* tuning options from data.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blockindex\": {\n"
+            "    \"memoryusage\": n,  (numeric) approximate memory used by the database, in bytes\n"
+            "    \"stats\": \"...\"     (string) the leveldb.stats property: per-level file counts, sizes and read/write volumes\n"
+            "  },\n"
+            "  \"chainstate\": { ... }    (object) same fields for the chainstate database\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    LOCK(cs_main);
+
+    auto dbStats = [](std::function<bool(const std::string&, std::string&)> getProperty) {
+        UniValue obj(UniValue::VOBJ);
+        std::string strValue;
+        if (getProperty("leveldb.approximate-memory-usage", strValue))
+            obj.pushKV("memoryusage", atoi64(strValue));
+        if (getProperty("leveldb.stats", strValue))
+            obj.pushKV("stats", strValue);
+        return obj;
+    };
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("blockindex", dbStats([](const std::string& strProperty, std::string& strValue) {
+        return pblocktree->GetProperty(strProperty, strValue);
+    }));
+    ret.pushKV("chainstate", dbStats([](const std::string& strProperty, std::string& strValue) {
+        return pcoinsdbview->GetDbProperty(strProperty, strValue);
+    }));
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -935,6 +1204,78 @@ UniValue verifychain(const UniValue& params, bool fHelp)
     return CVerifyDB().VerifyDB(Params(), pcoinsTip, nCheckLevel, nCheckDepth);
 }
 
+UniValue getchaintxstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "getchaintxstats ( nblocks \"blockhash\" )\n"
+            "\nCompute statistics about the total number and rate of transactions in the chain.\n"
+            "The rates are derived from the cumulative transaction counters on the block index,\n"
+            "so no blocks are read from disk.\n"
+            "\nArguments:\n"
+            "1. nblocks     (numeric, optional) Size of the window in number of blocks (default: one month).\n"
+            "2. \"blockhash\" (string, optional) The hash of the block that ends the window (default: chain tip).\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"time\": xxxxx,               (numeric) The timestamp for the final block in the window in UNIX format.\n"
+            "  \"txcount\": xxxxx,            (numeric) The total number of transactions in the chain up to that point.\n"
+            "  \"window_block_count\": xxxxx, (numeric) Size of the window in number of blocks.\n"
+            "  \"window_tx_count\": xxxxx,    (numeric) The number of transactions in the window.\n"
+            "  \"window_interval\": xxxxx,    (numeric) The elapsed time in the window in seconds.\n"
+            "  \"txrate\": x.xx,              (numeric) The average rate of transactions per second in the window.\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getchaintxstats", "")
+            + HelpExampleRpc("getchaintxstats", "2016")
+        );
+
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    LOCK(cs_main);
+
+    const CBlockIndex* pindex;
+    if (params.size() > 1 && !params[1].isNull()) {
+        uint256 hash(ParseHashV(params[1], "blockhash"));
+        BlockMap::iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pindex = it->second;
+        if (!chainActive.Contains(pindex))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block is not in main chain");
+    } else {
+        pindex = chainActive.Tip();
+    }
+
+    if (pindex == NULL)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Chain has no blocks");
+
+    // Default: a month's worth of blocks at the target spacing for this
+    // height, clamped for young chains.
+    int blockcount = 30 * 24 * 60 * 60 / consensusParams.PoWTargetSpacing(pindex->nHeight);
+    blockcount = std::max(0, std::min(blockcount, pindex->nHeight - 1));
+    if (params.size() > 0 && !params[0].isNull()) {
+        blockcount = params[0].get_int();
+        if (blockcount < 1 || blockcount >= pindex->nHeight)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block count: should be between 1 and the block's height - 1");
+    }
+
+    const CBlockIndex* pindexPast = pindex->GetAncestor(pindex->nHeight - blockcount);
+    int nTimeDiff = pindex->GetMedianTimePast() - pindexPast->GetMedianTimePast();
+    int nTxDiff = pindex->nChainTx - pindexPast->nChainTx;
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("time", (int64_t)pindex->nTime);
+    ret.pushKV("txcount", (int64_t)pindex->nChainTx);
+    ret.pushKV("window_block_count", blockcount);
+    ret.pushKV("window_tx_count", nTxDiff);
+    ret.pushKV("window_interval", nTimeDiff);
+    if (nTimeDiff > 0) {
+        ret.pushKV("txrate", ((double)nTxDiff) / nTimeDiff);
+    }
+
+    return ret;
+}
+
 /** Implementation of IsSuperMajority with better feedback */
 static UniValue SoftForkMajorityDesc(int minVersion, CBlockIndex* pindex, int nRequired, const Consensus::Params& consensusParams)
 {
@@ -1074,6 +1415,7 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 
     CBlockIndex* tip = chainActive.Tip();
     UniValue valuePools(UniValue::VARR);
+    valuePools.push_back(ValuePoolDesc("transparent", tip->nChainTransparentValue, std::nullopt));
     valuePools.push_back(ValuePoolDesc("sprout", tip->nChainSproutValue, std::nullopt));
     valuePools.push_back(ValuePoolDesc("sapling", tip->nChainSaplingValue, std::nullopt));
     valuePools.push_back(ValuePoolDesc("orchard", tip->nChainOrchardValue, std::nullopt));
@@ -1130,6 +1472,56 @@ struct CompareBlocksByHeight
     }
 };
 
+UniValue getsupplyinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getsupplyinfo\n"
+            "Returns the total coin supply and per-pool balances at the chain tip.\n"
+            "The balances are maintained incrementally as blocks are connected, so\n"
+            "this returns instantly; no chain or UTXO set scan is performed. The\n"
+            "transparent pool (and with it the total) is only monitored once the\n"
+            "chain has been built or reindexed by a version recording transparent\n"
+            "value deltas.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\": xxxxxx,         (numeric) the height of the chain tip\n"
+            "  \"bestblock\": \"...\",       (string) the hash of the chain tip\n"
+            "  \"totalsupply\": x.xxx,     (numeric) sum of all pool balances; only present if every pool is monitored\n"
+            "  \"totalsupplyZat\": n,      (numeric) the same in zatoshis; only present if every pool is monitored\n"
+            "  \"valuePools\": [ ... ]     (array) one entry per pool, as in getblockchaininfo\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getsupplyinfo", "")
+            + HelpExampleRpc("getsupplyinfo", "")
+        );
+
+    LOCK(cs_main);
+
+    const CBlockIndex* tip = chainActive.Tip();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("height", tip->nHeight);
+    obj.pushKV("bestblock", tip->GetBlockHash().GetHex());
+
+    if (tip->nChainTransparentValue && tip->nChainSproutValue &&
+        tip->nChainSaplingValue && tip->nChainOrchardValue) {
+        CAmount totalSupply = *tip->nChainTransparentValue + *tip->nChainSproutValue +
+                              *tip->nChainSaplingValue + *tip->nChainOrchardValue;
+        obj.pushKV("totalsupply", ValueFromAmount(totalSupply));
+        obj.pushKV("totalsupplyZat", totalSupply);
+    }
+
+    UniValue valuePools(UniValue::VARR);
+    valuePools.push_back(ValuePoolDesc("transparent", tip->nChainTransparentValue, std::nullopt));
+    valuePools.push_back(ValuePoolDesc("sprout", tip->nChainSproutValue, std::nullopt));
+    valuePools.push_back(ValuePoolDesc("sapling", tip->nChainSaplingValue, std::nullopt));
+    valuePools.push_back(ValuePoolDesc("orchard", tip->nChainOrchardValue, std::nullopt));
+    obj.pushKV("valuePools", valuePools);
+
+    return obj;
+}
+
 UniValue getchaintips(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -1362,6 +1754,64 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
     return mempoolInfoToJSON();
 }
 
+UniValue getblockconnectstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getblockconnectstats ( count )\n"
+            "\nReturns per-phase timings for recently connected blocks, oldest first.\n"
+            "The phase boundaries match the -debug=bench log lines; only a bounded\n"
+            "window of the most recent connections is retained.\n"
+            "\nArguments:\n"
+            "1. count   (numeric, optional) number of most recent blocks to return (default: all retained)\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"height\": n,              (numeric) block height\n"
+            "    \"hash\": \"hash\",           (string) block hash\n"
+            "    \"txcount\": n,             (numeric) transactions in the block\n"
+            "    \"connect_usec\": n,        (numeric) applying transactions to the coins view\n"
+            "    \"verify_usec\": n,         (numeric) until script/proof verification completed\n"
+            "    \"index_usec\": n,          (numeric) index writes\n"
+            "    \"callbacks_usec\": n,      (numeric) in-block callbacks\n"
+            "    \"flush_usec\": n,          (numeric) flushing the block's view into the coins cache\n"
+            "    \"chainstate_usec\": n,     (numeric) writing chainstate to disk\n"
+            "    \"postconnect_usec\": n,    (numeric) mempool removal and tip update\n"
+            "    \"total_usec\": n           (numeric) whole block connection\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockconnectstats", "10")
+            + HelpExampleRpc("getblockconnectstats", "10")
+        );
+
+    size_t nCount = std::numeric_limits<size_t>::max();
+    if (params.size() == 1) {
+        int64_t n = params[0].get_int64();
+        if (n <= 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be positive");
+        nCount = (size_t)n;
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const CBlockConnectTiming& timing : GetBlockConnectTimings(nCount)) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("height", timing.nHeight);
+        entry.pushKV("hash", timing.hashBlock.GetHex());
+        entry.pushKV("txcount", (uint64_t)timing.nTx);
+        entry.pushKV("connect_usec", timing.nConnectUsec);
+        entry.pushKV("verify_usec", timing.nVerifyUsec);
+        entry.pushKV("index_usec", timing.nIndexUsec);
+        entry.pushKV("callbacks_usec", timing.nCallbacksUsec);
+        entry.pushKV("flush_usec", timing.nFlushUsec);
+        entry.pushKV("chainstate_usec", timing.nChainstateUsec);
+        entry.pushKV("postconnect_usec", timing.nPostConnectUsec);
+        entry.pushKV("total_usec", timing.nTotalUsec);
+        result.push_back(entry);
+    }
+    return result;
+}
+
 UniValue invalidateblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -1439,6 +1889,126 @@ UniValue reconsiderblock(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue dumpchainstate(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumpchainstate \"filename\"\n"
+            "\nWrites the full chainstate (UTXO set, shielded state and chain metadata) to a\n"
+            "hash-committed snapshot file. A new node can import the file with loadchainstate\n"
+            "to skip replaying the whole block chain. Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"filename\"    (string, required) the output file; a relative path is rooted in the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filename\" : \"xxx\",      (string) the path of the snapshot file\n"
+            "  \"blockhash\" : \"hex\",     (string) the block the snapshot was taken at\n"
+            "  \"height\" : n,            (numeric) the height of that block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumpchainstate", "\"snapshot.dat\"")
+            + HelpExampleRpc("dumpchainstate", "\"snapshot.dat\"")
+        );
+
+    LOCK(cs_main);
+
+    if (chainActive.Tip() == NULL)
+        throw JSONRPCError(RPC_INVALID_REQUEST, "Chainstate is empty, nothing to dump");
+
+    fs::path path = params[0].get_str();
+    if (!path.is_absolute())
+        path = GetDataDir() / path;
+    if (fs::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. If you are sure this is what you want, move it out of the way first");
+
+    // Make sure the on-disk view is up to date with the tip before
+    // iterating over it.
+    FlushStateToDisk();
+
+    FILE *file = fsbridge::fopen(path, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open snapshot file " + path.string());
+
+    if (!pcoinsTip->WriteSnapshot(fileout))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to write chainstate snapshot (see debug log)");
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("filename", path.string());
+    result.pushKV("blockhash", chainActive.Tip()->GetBlockHash().GetHex());
+    result.pushKV("height", chainActive.Height());
+    return result;
+}
+
+UniValue loadchainstate(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "loadchainstate \"filename\"\n"
+            "\nImports a chainstate snapshot created with dumpchainstate, making this node\n"
+            "usable within minutes instead of replaying the whole block chain. The node must\n"
+            "have an empty chainstate (a fresh data directory) and must already have synced\n"
+            "the block headers past the snapshot's base block.\n"
+            "\nThe snapshot is trusted in the same way built-in checkpoints are: blocks at or\n"
+            "below its base are not re-validated, and the node cannot reorganize to a chain\n"
+            "that forks below the base. Only import snapshots from a source you trust.\n"
+            "\nArguments:\n"
+            "1. \"filename\"    (string, required) the snapshot file; a relative path is rooted in the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blockhash\" : \"hex\",     (string) the base block of the imported snapshot\n"
+            "  \"height\" : n,            (numeric) the height of that block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadchainstate", "\"snapshot.dat\"")
+            + HelpExampleRpc("loadchainstate", "\"snapshot.dat\"")
+        );
+
+    LOCK(cs_main);
+
+    if (!pcoinsTip->GetBestBlock().IsNull())
+        throw JSONRPCError(RPC_INVALID_REQUEST, "Chainstate is not empty; loadchainstate requires a fresh data directory");
+
+    fs::path path = params[0].get_str();
+    if (!path.is_absolute())
+        path = GetDataDir() / path;
+
+    // First pass: fully verify the hash commitment before writing anything
+    // to the database.
+    CChainstateSnapshotHeader header;
+    std::string strError;
+    {
+        FILE *file = fsbridge::fopen(path, "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open snapshot file " + path.string());
+        if (!VerifyChainstateSnapshot(filein, header, strError))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid snapshot: " + strError);
+    }
+    if (mapBlockIndex.count(header.hashBestBlock) == 0)
+        throw JSONRPCError(RPC_INVALID_REQUEST, "Snapshot base block not in block index; wait for header sync to pass it");
+
+    // Second pass: commit the entries to the chainstate database.
+    {
+        FILE *file = fsbridge::fopen(path, "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open snapshot file " + path.string());
+        if (!pcoinsTip->LoadSnapshot(filein))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to load snapshot; wipe the chainstate with -reindex before retrying");
+    }
+
+    if (!ActivateChainstateSnapshot(Params(), header.hashBestBlock, strError))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to activate snapshot: " + strError);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blockhash", header.hashBestBlock.GetHex());
+    result.pushKV("height", (int64_t)header.nHeight);
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1448,13 +2018,20 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblock",               &getblock,               true  },
     { "blockchain",         "getblockhash",           &getblockhash,           true  },
     { "blockchain",         "getblockheader",         &getblockheader,         true  },
+    { "blockchain",         "getblockheaders",        &getblockheaders,        true  },
+    { "blockchain",         "getsupplyinfo",          &getsupplyinfo,          true  },
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
+    { "blockchain",         "getchaintxstats",        &getchaintxstats,        true  },
     { "blockchain",         "z_gettreestate",         &z_gettreestate,         true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "getdbstats",             &getdbstats,             true  },
+    { "blockchain",         "getblockconnectstats",   &getblockconnectstats,   true  },
+    { "blockchain",         "dumpchainstate",         &dumpchainstate,         true  },
+    { "blockchain",         "loadchainstate",         &loadchainstate,         true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
 
     // insightexplorer
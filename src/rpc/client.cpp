@@ -45,6 +45,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getbalance", 2 },
     { "getbalance", 3 },
     { "getblockhash", 0 },
+    { "getblockconnectstats", 0 },
     { "listtransactions", 1 },
     { "listtransactions", 2 },
     { "listtransactions", 3 },
@@ -64,6 +65,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listunspent", 2 },
     { "getblock", 1 },
     { "getblockheader", 1 },
+    { "getblockheaders", 1 },
+    { "getblockheaders", 2 },
     { "gettransaction", 1 },
     { "getrawtransaction", 1 },
     { "createrawtransaction", 0 },
@@ -85,10 +88,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importpubkey", 2 },
     { "verifychain", 0 },
     { "verifychain", 1 },
+    { "getchaintxstats", 0 },
     { "keypoolrefill", 0 },
     { "getrawmempool", 0 },
     { "estimatefee", 0 },
     { "estimatepriority", 0 },
+    { "estimatesmartfee", 0 },
+    { "estimatesmartpriority", 0 },
     { "prioritisetransaction", 1 },
     { "prioritisetransaction", 2 },
     { "setban", 2 },
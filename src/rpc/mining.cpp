@@ -56,12 +56,12 @@ int64_t GetNetworkHashPS(int lookup, int height) {
     if (lookup > pb->nHeight)
         lookup = pb->nHeight;
 
-    CBlockIndex *pb0 = pb;
-    int64_t minTime = pb0->GetBlockTime();
+    // pb is on the active chain here, so read the flat per-height columns
+    // instead of chasing pprev pointers through the heap.
+    int64_t minTime = chainActive.TimeAtHeight(pb->nHeight);
     int64_t maxTime = minTime;
-    for (int i = 0; i < lookup; i++) {
-        pb0 = pb0->pprev;
-        int64_t time = pb0->GetBlockTime();
+    for (int i = 1; i <= lookup; i++) {
+        int64_t time = chainActive.TimeAtHeight(pb->nHeight - i);
         minTime = std::min(time, minTime);
         maxTime = std::max(time, maxTime);
     }
@@ -70,7 +70,7 @@ int64_t GetNetworkHashPS(int lookup, int height) {
     if (minTime == maxTime)
         return 0;
 
-    arith_uint256 workDiff = pb->nChainWork - pb0->nChainWork;
+    arith_uint256 workDiff = chainActive.WorkAtHeight(pb->nHeight) - chainActive.WorkAtHeight(pb->nHeight - lookup);
     int64_t timeDiff = maxTime - minTime;
 
     return (int64_t)(workDiff.getdouble() / timeDiff);
@@ -358,6 +358,9 @@ UniValue prioritisetransaction(const UniValue& params, bool fHelp)
     CAmount nAmount = params[2].get_int64();
 
     mempool.PrioritiseTransaction(hash, params[0].get_str(), params[1].get_real(), nAmount);
+    // Wake long-polling getblocktemplate clients so the re-prioritised
+    // selection reaches them immediately instead of at their next timeout.
+    cvBlockChange.notify_all();
     return true;
 }
 
@@ -583,15 +586,17 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
                         Params(), CAmount{0}, minerAddress, cached_next_cb_height);
                     next_cb_mtx = cached_next_cb_mtx;
                 }
-                bool timedout = !cvBlockChange.timed_wait(lock, checktxtime);
+                cvBlockChange.timed_wait(lock, checktxtime);
                 ENTER_CRITICAL_SECTION(cs_main);
 
                 // Optimization: even if timed out, a new block may have arrived
                 // while waiting for cs_main; if so, don't discard next_cb_mtx.
                 if (chainActive.Tip()->GetBlockHash() != hashWatchedChain) break;
 
-                // Timeout: Check transactions for update
-                if (timedout && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP) {
+                // Check transactions for update, both on timeout and on an
+                // explicit wakeup (prioritisetransaction notifies here after
+                // reweighting the mempool index).
+                if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP) {
                     // Create a non-empty block.
                     next_cb_mtx = nullopt;
                     break;
@@ -613,8 +618,17 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static CBlockTemplate* pblocktemplate;
-    if (!lpval.isNull() || pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+    static UniValue transactions(UniValue::VARR);
+    static UniValue txCoinbase = NullUniValue;
+    static bool fTemplateTxJsonValid = false;
+    // Long-poll clients only get past the wait loop above once the tip has
+    // changed or new transactions have arrived, so they can share the cached
+    // template like regular polls; the transaction-count check below (without
+    // the 5 second holdoff) picks up the mempool case. This keeps repeated
+    // polls for an unchanged chain from re-running block assembly.
+    if (pindexPrev != chainActive.Tip() ||
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
+         (!lpval.isNull() || GetTime() - nStart > 5)))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -642,6 +656,8 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             throw JSONRPCError(RPC_INTERNAL_ERROR, "No miner address available (mining requires a wallet or -mineraddress)");
         }
 
+        fTemplateTxJsonValid = false;
+
         pblocktemplate = CreateNewBlock(Params(), minerAddress, next_cb_mtx);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
@@ -662,47 +678,54 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
 
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
-    UniValue txCoinbase = NullUniValue;
-    UniValue transactions(UniValue::VARR);
-    map<uint256, int64_t> setTxIndex;
-    int i = 0;
-    for (const CTransaction& tx : pblock->vtx) {
-        uint256 txHash = tx.GetHash();
-        setTxIndex[txHash] = i++;
+    // The per-transaction JSON depends only on the assembled template, and
+    // hex-encoding every transaction is the expensive part of answering from
+    // the cache, so it is cached alongside the template and only rebuilt
+    // after CreateNewBlock has run.
+    if (!fTemplateTxJsonValid) {
+        transactions = UniValue(UniValue::VARR);
+        txCoinbase = NullUniValue;
+        map<uint256, int64_t> setTxIndex;
+        int i = 0;
+        for (const CTransaction& tx : pblock->vtx) {
+            uint256 txHash = tx.GetHash();
+            setTxIndex[txHash] = i++;
 
-        if (tx.IsCoinBase() && !coinbasetxn)
-            continue;
+            if (tx.IsCoinBase() && !coinbasetxn)
+                continue;
 
-        UniValue entry(UniValue::VOBJ);
+            UniValue entry(UniValue::VOBJ);
 
-        entry.pushKV("data", EncodeHexTx(tx));
+            entry.pushKV("data", EncodeHexTx(tx));
 
-        entry.pushKV("hash", tx.GetScriptSigHash().GetHex());
-        entry.pushKV("txid", txHash.GetHex());
+            entry.pushKV("hash", tx.GetScriptSigHash().GetHex());
+            entry.pushKV("txid", txHash.GetHex());
 
-        UniValue deps(UniValue::VARR);
-        for (const CTxIn &in : tx.vin)
-        {
-            if (setTxIndex.count(in.prevout.hash))
-                deps.push_back(setTxIndex[in.prevout.hash]);
-        }
-        entry.pushKV("depends", deps);
+            UniValue deps(UniValue::VARR);
+            for (const CTxIn &in : tx.vin)
+            {
+                if (setTxIndex.count(in.prevout.hash))
+                    deps.push_back(setTxIndex[in.prevout.hash]);
+            }
+            entry.pushKV("depends", deps);
 
-        int index_in_template = i - 1;
-        entry.pushKV("fee", pblocktemplate->vTxFees[index_in_template]);
-        entry.pushKV("sigops", pblocktemplate->vTxSigOps[index_in_template]);
+            int index_in_template = i - 1;
+            entry.pushKV("fee", pblocktemplate->vTxFees[index_in_template]);
+            entry.pushKV("sigops", pblocktemplate->vTxSigOps[index_in_template]);
 
-        if (tx.IsCoinBase()) {
-            // Show founders' reward if it is required
-            if (pblock->vtx[0].vout.size() > 1) {
-                // Correct this if GetBlockTemplate changes the order
-                entry.pushKV("foundersreward", (int64_t)tx.vout[1].nValue);
+            if (tx.IsCoinBase()) {
+                // Show founders' reward if it is required
+                if (pblock->vtx[0].vout.size() > 1) {
+                    // Correct this if GetBlockTemplate changes the order
+                    entry.pushKV("foundersreward", (int64_t)tx.vout[1].nValue);
+                }
+                entry.pushKV("required", true);
+                txCoinbase = entry;
+            } else {
+                transactions.push_back(entry);
             }
-            entry.pushKV("required", true);
-            txCoinbase = entry;
-        } else {
-            transactions.push_back(entry);
         }
+        fTemplateTxJsonValid = true;
     }
 
     UniValue aux(UniValue::VOBJ);
@@ -894,6 +917,76 @@ UniValue estimatepriority(const UniValue& params, bool fHelp)
     return mempool.estimatePriority(nBlocks);
 }
 
+UniValue estimatesmartfee(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "estimatesmartfee nblocks\n"
+            "\nEstimates the approximate fee per kilobyte\n"
+            "needed for a transaction to begin confirmation\n"
+            "within nblocks blocks if possible and return the number of blocks\n"
+            "for which the estimate is valid.\n"
+            "\nArguments:\n"
+            "1. nblocks     (numeric)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"feerate\" : x.x,     (numeric) estimate fee-per-kilobyte (in " + CURRENCY_UNIT + ")\n"
+            "  \"blocks\" : n         (numeric) block number where estimate was found\n"
+            "}\n"
+            "\n"
+            "A negative value is returned if not enough transactions and\n"
+            "blocks have been observed to make an estimate for any number of blocks.\n"
+            "\nExample:\n"
+            + HelpExampleCli("estimatesmartfee", "6")
+            );
+
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VNUM));
+
+    int nBlocks = params[0].get_int();
+
+    UniValue result(UniValue::VOBJ);
+    int answerFound;
+    CFeeRate feeRate = mempool.estimateSmartFee(nBlocks, &answerFound);
+    result.pushKV("feerate", feeRate == CFeeRate(0) ? -1.0 : ValueFromAmount(feeRate.GetFeePerK()));
+    result.pushKV("blocks", answerFound);
+    return result;
+}
+
+UniValue estimatesmartpriority(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "estimatesmartpriority nblocks\n"
+            "\nEstimates the approximate priority\n"
+            "a zero-fee transaction needs to begin confirmation\n"
+            "within nblocks blocks if possible and return the number of blocks\n"
+            "for which the estimate is valid.\n"
+            "\nArguments:\n"
+            "1. nblocks     (numeric)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"priority\" : x.x,    (numeric) estimated priority\n"
+            "  \"blocks\" : n         (numeric) block number where estimate was found\n"
+            "}\n"
+            "\n"
+            "A negative value is returned if not enough transactions and\n"
+            "blocks have been observed to make an estimate for any number of blocks.\n"
+            "\nExample:\n"
+            + HelpExampleCli("estimatesmartpriority", "6")
+            );
+
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VNUM));
+
+    int nBlocks = params[0].get_int();
+
+    UniValue result(UniValue::VOBJ);
+    int answerFound;
+    double priority = mempool.estimateSmartPriority(nBlocks, &answerFound);
+    result.pushKV("priority", priority);
+    result.pushKV("blocks", answerFound);
+    return result;
+}
+
 UniValue getblocksubsidy(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -1011,6 +1104,8 @@ static const CRPCCommand commands[] =
 
     { "util",               "estimatefee",            &estimatefee,            true  },
     { "util",               "estimatepriority",       &estimatepriority,       true  },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       true  },
+    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true  },
 };
 
 void RegisterMiningRPCCommands(CRPCTable &tableRPC)
@@ -11,6 +11,7 @@
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
 #include "txmempool.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
@@ -792,39 +793,71 @@ static void getHeightRange(const UniValue& params, int& start, int& end)
     if (params[0].isObject()) {
         UniValue startValue = find_value(params[0].get_obj(), "start");
         UniValue endValue = find_value(params[0].get_obj(), "end");
-        // If either is not specified, the other is ignored.
-        if (!startValue.isNull() && !endValue.isNull()) {
+        // Either bound may be given on its own; the other side of the
+        // range is then unbounded. Paged queries in particular resume
+        // with only a start height.
+        if (!startValue.isNull()) {
             start = startValue.get_int();
-            end = endValue.get_int();
-            if (start <= 0 || end <= 0) {
+            if (start <= 0) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
                     "Start and end are expected to be greater than zero");
             }
-            if (end < start) {
+        }
+        if (!endValue.isNull()) {
+            end = endValue.get_int();
+            if (end <= 0) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-                    "End value is expected to be greater than start");
+                    "Start and end are expected to be greater than zero");
             }
         }
+        if (start > 0 && end > 0 && end < start) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                "End value is expected to be greater than start");
+        }
     }
 
     LOCK(cs_main);  // for chainActive
-    if (start > chainActive.Height() || end > chainActive.Height()) {
+    // A start beyond the tip simply yields an empty result, so a paged
+    // caller resuming past the last page is not treated as an error.
+    if (end > chainActive.Height()) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Start or end is outside chain range");
     }
 }
 
+// Read an optional positive "maxentries" field enabling paginated results.
+static size_t getMaxEntries(const UniValue& params)
+{
+    size_t nMaxEntries = 0;
+    if (params[0].isObject()) {
+        UniValue maxEntriesValue = find_value(params[0].get_obj(), "maxentries");
+        if (!maxEntriesValue.isNull()) {
+            if (maxEntriesValue.get_int() <= 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER,
+                    "maxentries is expected to be greater than zero");
+            }
+            nMaxEntries = (size_t)maxEntriesValue.get_int();
+        }
+    }
+    return nMaxEntries;
+}
+
 // Parse an address list then fetch the corresponding addressindex information.
 static void getAddressesInHeightRange(
     const UniValue& params,
-    int start, int end,
+    int start, int end, size_t nMaxEntries,
     std::vector<std::pair<uint160, int>>& addresses,
     std::vector<std::pair<CAddressIndexKey, CAmount>> &addressIndex)
 {
     if (!getAddressesFromParams(params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
+    // A single height cursor cannot page several interleaved histories.
+    if (nMaxEntries > 0 && addresses.size() != 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+            "maxentries is only supported with a single address");
+    }
     for (const auto& it : addresses) {
-        if (!GetAddressIndex(it.first, it.second, addressIndex, start, end)) {
+        if (!GetAddressIndex(it.first, it.second, addressIndex, start, end, nMaxEntries)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
                 "No information available for address");
         }
@@ -855,6 +888,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "  \"start\"       (number, optional) The start block height\n"
             "  \"end\"         (number, optional) The end block height\n"
             "  \"chainInfo\"   (boolean, optional, default=false) Include chain info in results, only applies if start and end specified\n"
+            "  \"maxentries\"  (number, optional) Page size; requires a single address. The result then is an object also\n"
+            "                  carrying \"nextstart\", the height to pass as start for the next page; pages end on height\n"
+            "                  boundaries, so an empty page means the history is exhausted\n"
             "}\n"
             "(or)\n"
             "\"address\"       (string) The base58check encoded address\n"
@@ -904,10 +940,11 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
     int start = 0;
     int end = 0;
     getHeightRange(params, start, end);
+    size_t nMaxEntries = getMaxEntries(params);
 
     std::vector<std::pair<uint160, int>> addresses;
     std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
-    getAddressesInHeightRange(params, start, end, addresses, addressIndex);
+    getAddressesInHeightRange(params, start, end, nMaxEntries, addresses, addressIndex);
 
     bool includeChainInfo = false;
     if (params[0].isObject()) {
@@ -936,6 +973,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
 
     UniValue result(UniValue::VOBJ);
 
+    if (nMaxEntries > 0 && !(includeChainInfo && start > 0 && end > 0)) {
+        // Paged form: hand back the height to resume from. An empty page
+        // means the history (or requested range) is exhausted.
+        result.pushKV("deltas", deltas);
+        result.pushKV("nextstart", addressIndex.empty() ? 0 : addressIndex.back().first.blockHeight + 1);
+        return result;
+    }
+
     if (!(includeChainInfo && start > 0 && end > 0)) {
         return deltas;
     }
@@ -954,6 +999,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
     endInfo.pushKV("height", end);
 
     result.pushKV("deltas", deltas);
+    if (nMaxEntries > 0) {
+        result.pushKV("nextstart", addressIndex.empty() ? 0 : addressIndex.back().first.blockHeight + 1);
+    }
     result.pushKV("start", startInfo);
     result.pushKV("end", endInfo);
 
@@ -998,18 +1046,38 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
     }
 
     std::vector<std::pair<uint160, int>> addresses;
-    std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
-    // this method doesn't take start and end block height params, so set
-    // to zero (full range, entire blockchain)
-    getAddressesInHeightRange(params, 0, 0, addresses, addressIndex);
+    getAddressesFromParams(params, addresses);
 
+    // The index keeps running totals per address, so answer with point
+    // reads; databases from before the balance index fall back to summing
+    // every delta until they are reindexed.
     CAmount balance = 0;
     CAmount received = 0;
-    for (const auto& it : addressIndex) {
-        if (it.second > 0) {
-            received += it.second;
+    bool fHaveTotals = true;
+    for (const auto& it : addresses) {
+        CAddressBalanceValue totals;
+        if (!GetAddressBalance(it.first, it.second, totals)) {
+            fHaveTotals = false;
+            break;
+        }
+        balance += totals.balance;
+        received += totals.received;
+    }
+    if (!fHaveTotals) {
+        std::vector<std::pair<uint160, int>> vAddresses;
+        std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
+        // this method doesn't take start and end block height params, so set
+        // to zero (full range, entire blockchain)
+        getAddressesInHeightRange(params, 0, 0, 0, vAddresses, addressIndex);
+
+        balance = 0;
+        received = 0;
+        for (const auto& it : addressIndex) {
+            if (it.second > 0) {
+                received += it.second;
+            }
+            balance += it.second;
         }
-        balance += it.second;
     }
     UniValue result(UniValue::VOBJ);
     result.pushKV("balance", balance);
@@ -1041,6 +1109,9 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number, optional) The start block height\n"
             "  \"end\" (number, optional) The end block height\n"
+            "  \"maxentries\" (number, optional) Page size; requires a single address. The result then is an object with\n"
+            "                 \"txids\" and \"nextstart\", the height to pass as start for the next page; pages end on\n"
+            "                 height boundaries, so an empty page means the history is exhausted\n"
             "}\n"
             "(or)\n"
             "\"address\"  (string) The base58check encoded address\n"
@@ -1062,10 +1133,11 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
     int start = 0;
     int end = 0;
     getHeightRange(params, start, end);
+    size_t nMaxEntries = getMaxEntries(params);
 
     std::vector<std::pair<uint160, int>> addresses;
     std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
-    getAddressesInHeightRange(params, start, end, addresses, addressIndex);
+    getAddressesInHeightRange(params, start, end, nMaxEntries, addresses, addressIndex);
 
     // This is an ordered set, sorted by (height,txindex) so result also sorted by height.
     std::set<std::tuple<int, int, std::string>> txids;
@@ -1077,13 +1149,22 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         // Duplicate entries (two addresses in same tx) are suppressed
         txids.insert(std::make_tuple(height, txindex, txid));
     }
-    UniValue result(UniValue::VARR);
+    UniValue txidList(UniValue::VARR);
     for (const auto& it : txids) {
         // only push the txid, not the height
-        result.push_back(std::get<2>(it));
+        txidList.push_back(std::get<2>(it));
     }
 
-    return result;
+    if (nMaxEntries > 0) {
+        // Paged form: hand back the height to resume from. An empty page
+        // means the history (or requested range) is exhausted.
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("txids", txidList);
+        result.pushKV("nextstart", addressIndex.empty() ? 0 : addressIndex.back().first.blockHeight + 1);
+        return result;
+    }
+
+    return txidList;
 }
 
 // insightexplorer
@@ -1177,6 +1258,12 @@ UniValue getmemoryinfo(const UniValue& params, bool fHelp)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"caches\": {               (json object) Live usage of the main caches, in bytes\n"
+            "    \"coins\": { \"limit\": xxxxx, \"usage\": xxxxx },\n"
+            "    \"sigcache\": { \"limit\": xxxxx, \"usage\": xxxxx },\n"
+            "    \"scriptcache\": { \"limit\": xxxxx, \"usage\": xxxxx },\n"
+            "    \"mempool\": { \"usage\": xxxxx }\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -1185,6 +1272,91 @@ UniValue getmemoryinfo(const UniValue& params, bool fHelp)
         );
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("locked", RPCLockedMemoryInfo());
+
+    UniValue caches(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        UniValue coins(UniValue::VOBJ);
+        coins.pushKV("limit", (uint64_t)nCoinCacheUsage);
+        coins.pushKV("usage", (uint64_t)(pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0));
+        caches.pushKV("coins", coins);
+    }
+    UniValue sigcache(UniValue::VOBJ);
+    sigcache.pushKV("limit", (uint64_t)(GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) << 20));
+    sigcache.pushKV("usage", (uint64_t)SignatureCacheBytes());
+    caches.pushKV("sigcache", sigcache);
+    UniValue scriptcache(UniValue::VOBJ);
+    scriptcache.pushKV("limit", (uint64_t)(GetArg("-maxscriptcachesize", DEFAULT_MAX_SCRIPT_CACHE_SIZE) << 20));
+    scriptcache.pushKV("usage", (uint64_t)ScriptExecutionCacheBytes());
+    caches.pushKV("scriptcache", scriptcache);
+    UniValue mempoolUsage(UniValue::VOBJ);
+    mempoolUsage.pushKV("usage", (uint64_t)mempool.DynamicMemoryUsage());
+    caches.pushKV("mempool", mempoolUsage);
+    obj.pushKV("caches", caches);
+
+    return obj;
+}
+
+UniValue getlockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockstats ( \"command\" )\n"
+            "Returns per-lock contention statistics collected by the lock profiler.\n"
+            "Collection is off by default (enable at startup with -lockstats); while off\n"
+            "the profiler costs one atomic load per lock acquisition.\n"
+            "\nArguments:\n"
+            "1. \"command\"   (string, optional) One of:\n"
+            "       \"start\"  start collecting\n"
+            "       \"stop\"   stop collecting (counters are kept)\n"
+            "       \"reset\"  zero all counters\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,      (boolean) whether collection is currently on\n"
+            "  \"locks\": {\n"
+            "    \"cs_main\": {              (json object) one entry per lock name\n"
+            "      \"acquisitions\": n,      (numeric) times the lock was taken\n"
+            "      \"contended\": n,         (numeric) acquisitions that had to wait\n"
+            "      \"wait_usec_total\": n,   (numeric) total time spent waiting, in microseconds\n"
+            "      \"wait_usec_max\": n,     (numeric) longest single wait\n"
+            "      \"hold_usec_total\": n,   (numeric) total time the lock was held\n"
+            "      \"hold_usec_max\": n,     (numeric) longest single hold\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "\"start\"")
+            + HelpExampleRpc("getlockstats", "")
+        );
+
+    if (params.size() == 1) {
+        std::string strCommand = params[0].get_str();
+        if (strCommand == "start")
+            fLockProfiling = true;
+        else if (strCommand == "stop")
+            fLockProfiling = false;
+        else if (strCommand == "reset")
+            ResetLockStats();
+        else
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "command must be \"start\", \"stop\" or \"reset\"");
+    }
+
+    UniValue locks(UniValue::VOBJ);
+    for (const auto& item : GetLockStats()) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("acquisitions", item.second.nAcquisitions);
+        entry.pushKV("contended", item.second.nContended);
+        entry.pushKV("wait_usec_total", item.second.nWaitMicrosTotal);
+        entry.pushKV("wait_usec_max", item.second.nWaitMicrosMax);
+        entry.pushKV("hold_usec_total", item.second.nHoldMicrosTotal);
+        entry.pushKV("hold_usec_max", item.second.nHoldMicrosMax);
+        locks.pushKV(item.first, entry);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", fLockProfiling.load());
+    obj.pushKV("locks", locks);
     return obj;
 }
 
@@ -1193,6 +1365,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true  },
+    { "control",            "getlockstats",           &getlockstats,           true  },
     { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
     { "util",               "z_validateaddress",      &z_validateaddress,      true  }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true  },
@@ -171,6 +171,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 
     KeyIO keyIO(Params());
     UniValue vin(UniValue::VARR);
+    vin.reserve(tx.vin.size());
     for (const CTxIn& txin : tx.vin) {
         UniValue in(UniValue::VOBJ);
         if (tx.IsCoinBase())
@@ -181,7 +182,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
             UniValue o(UniValue::VOBJ);
             o.pushKV("asm", ScriptToAsmStr(txin.scriptSig, true));
             o.pushKV("hex", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
-            in.pushKV("scriptSig", o);
+            in.pushKV("scriptSig", std::move(o));
 
             // Add address and value info if spentindex enabled
             CSpentIndexValue spentInfo;
@@ -198,10 +199,11 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
             }
         }
         in.pushKV("sequence", (int64_t)txin.nSequence);
-        vin.push_back(in);
+        vin.push_back(std::move(in));
     }
-    entry.pushKV("vin", vin);
+    entry.pushKV("vin", std::move(vin));
     UniValue vout(UniValue::VARR);
+    vout.reserve(tx.vout.size());
     for (unsigned int i = 0; i < tx.vout.size(); i++) {
         const CTxOut& txout = tx.vout[i];
         UniValue out(UniValue::VOBJ);
@@ -211,7 +213,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
         out.pushKV("n", (int64_t)i);
         UniValue o(UniValue::VOBJ);
         ScriptPubKeyToJSON(txout.scriptPubKey, o, true);
-        out.pushKV("scriptPubKey", o);
+        out.pushKV("scriptPubKey", std::move(o));
 
         // Add spent information if spentindex is enabled
         CSpentIndexValue spentInfo;
@@ -221,12 +223,11 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
             out.pushKV("spentIndex", (int)spentInfo.inputIndex);
             out.pushKV("spentHeight", spentInfo.blockHeight);
         }
-        vout.push_back(out);
+        vout.push_back(std::move(out));
     }
-    entry.pushKV("vout", vout);
+    entry.pushKV("vout", std::move(vout));
 
-    UniValue vjoinsplit = TxJoinSplitToJSON(tx);
-    entry.pushKV("vjoinsplit", vjoinsplit);
+    entry.pushKV("vjoinsplit", TxJoinSplitToJSON(tx));
 
     if (tx.fOverwintered && tx.nVersion >= SAPLING_TX_VERSION) {
         entry.pushKV("valueBalance", ValueFromAmount(tx.GetValueBalanceSapling()));
@@ -1048,6 +1049,13 @@ UniValue signrawtransaction(const UniValue& params, bool fHelp)
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mergedTx);
+#ifdef ENABLE_WALLET
+    // Batch signing session: decrypt each wallet key once for all inputs.
+    std::optional<CKeyStoreSigningSession> signingSession;
+    if (pwalletMain && &keystore == pwalletMain) {
+        signingSession.emplace(*pwalletMain);
+    }
+#endif
     // Sign what we can:
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
         CTxIn& txin = mergedTx.vin[i];
@@ -19,6 +19,9 @@
 #include <univalue.h>
 
 class AsyncRPCQueue;
+//! -rpcslowms default: log RPC calls slower than this many milliseconds (0 disables)
+static const int64_t DEFAULT_RPC_SLOW_MS = 0;
+
 class CRPCCommand;
 
 namespace RPCServer
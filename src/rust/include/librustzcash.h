@@ -74,6 +74,21 @@ extern "C" {
         unsigned char *result
     );
 
+    /// Computes `n` independent merkle tree hashes at the
+    /// same depth, in parallel on the Rust side. The `depth`
+    /// parameter should not be larger than 62.
+    ///
+    /// `inputs` must point to `n` concatenated 64-byte pairs
+    /// (left then right); both halves of each pair must be
+    /// scalars of BLS12-381. The `n` 32-byte results are
+    /// placed in `results` in input order.
+    void librustzcash_merkle_hash_batch(
+        size_t depth,
+        const unsigned char *inputs,
+        size_t n,
+        unsigned char *results
+    );
+
     /// Computes the signature for each Spend description, given the key
     /// `ask`, the re-randomization `ar`, the 32-byte sighash `sighash`,
     /// and an output `result` buffer of 64-bytes for the signature.
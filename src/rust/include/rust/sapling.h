@@ -0,0 +1,97 @@
+// Copyright (c) 2021 The Zcash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef ZCASH_RUST_INCLUDE_RUST_SAPLING_H
+#define ZCASH_RUST_INCLUDE_RUST_SAPLING_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct SaplingBatchValidatorPtr;
+typedef struct SaplingBatchValidatorPtr SaplingBatchValidatorPtr;
+
+/// Creates a Sapling proof batch validation context.
+///
+/// Please free this with `librustzcash_sapling_batch_validation_free` when you
+/// are done with it.
+SaplingBatchValidatorPtr* librustzcash_sapling_batch_validation_init();
+
+/// Frees a Sapling proof batch validation context returned from
+/// `librustzcash_sapling_batch_validation_init`.
+void librustzcash_sapling_batch_validation_free(SaplingBatchValidatorPtr* batch);
+
+/// Verifies the Sapling proofs that were queued into this batch, returning
+/// `true` if all proofs were valid and `false` otherwise.
+bool librustzcash_sapling_batch_validate(SaplingBatchValidatorPtr* batch);
+
+/// Creates a Sapling verification context that queues its Groth16 proofs into
+/// the given batch instead of verifying them inline. The returned context is
+/// interchangeable with one returned from
+/// `librustzcash_sapling_verification_ctx_init`, and must be freed with
+/// `librustzcash_sapling_verification_ctx_free`.
+///
+/// `batch` must be non-null and must outlive the returned context.
+void* librustzcash_sapling_verification_ctx_init_batched(
+    SaplingBatchValidatorPtr* batch,
+    bool zip216Enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#include <memory>
+
+namespace sapling
+{
+/**
+ * A validator for the Groth16 proofs in the Sapling component of a block.
+ *
+ * Per-transaction verification contexts created against this batch queue their
+ * Spend and Output proofs here instead of verifying them inline; the whole
+ * batch is then checked in two multi-scalar multiplications by `Validate()`.
+ * Spend authorization and binding signatures are still verified per
+ * transaction.
+ */
+class BatchValidator
+{
+private:
+    /// The batch validator. Memory is allocated by Rust.
+    std::unique_ptr<SaplingBatchValidatorPtr, decltype(&librustzcash_sapling_batch_validation_free)> inner;
+
+public:
+    BatchValidator() : inner(librustzcash_sapling_batch_validation_init(), librustzcash_sapling_batch_validation_free) {}
+
+    // BatchValidator should never be copied
+    BatchValidator(const BatchValidator&) = delete;
+    BatchValidator& operator=(const BatchValidator&) = delete;
+    BatchValidator(BatchValidator&& batch) : inner(std::move(batch.inner)) {}
+    BatchValidator& operator=(BatchValidator&& batch)
+    {
+        if (this != &batch) {
+            inner = std::move(batch.inner);
+        }
+        return *this;
+    }
+
+    /// Creates a Sapling verification context that queues its proofs into this
+    /// batch. Free the returned context with
+    /// `librustzcash_sapling_verification_ctx_free`.
+    void* CreateVerificationContext(bool zip216Enabled) const {
+        return librustzcash_sapling_verification_ctx_init_batched(inner.get(), zip216Enabled);
+    }
+
+    /// Verifies the queued Sapling proofs, returning `true` if all proofs were
+    /// valid and `false` otherwise.
+    bool Validate() const {
+        return librustzcash_sapling_batch_validate(inner.get());
+    }
+};
+} // namespace sapling
+#endif
+
+#endif // ZCASH_RUST_INCLUDE_RUST_SAPLING_H
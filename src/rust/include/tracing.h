@@ -24,11 +24,15 @@ typedef struct TracingHandle TracingHandle;
 /// component. The handle must be freed to close the logging component.
 ///
 /// If log_path is NULL, logging is sent to standard output.
+///
+/// If log_json is true, events are written as newline-delimited JSON objects
+/// instead of formatted text.
 TracingHandle* tracing_init(
     const codeunit* log_path,
     size_t log_path_len,
     const char* initial_filter,
-    bool log_timestamps);
+    bool log_timestamps,
+    bool log_json);
 
 /// Frees a tracing handle returned from `tracing_init`;
 void tracing_free(TracingHandle* handle);
@@ -99,6 +103,13 @@ void tracing_log(
     const char* const* field_values,
     size_t fields_len);
 
+/// Returns whether an event at this callsite would be emitted under the
+/// current filter, without constructing or dispatching anything.
+///
+/// You should usually call the `TracingLogLazy` macro instead of calling this
+/// directly.
+bool tracing_log_enabled(const TracingCallsite* callsite);
+
 #ifdef __cplusplus
 }
 #endif
@@ -272,6 +283,31 @@ public:
         tracing_log(CALLSITE, T_VALUES, T_ARRLEN(T_VALUES)); \
     } while (0)
 
+#ifdef __cplusplus
+/// Constructs a new event, evaluating the message expression only if the
+/// event would be emitted under the current filter.
+///
+/// Use this instead of `TracingLog` when constructing the message is
+/// expensive (e.g. string formatting) and the event is usually filtered out.
+///
+/// level and target MUST be static constants, and MUST be valid UTF-8
+/// strings. msg_expr is evaluated at most once, and MUST evaluate to a
+/// std::string containing valid UTF-8.
+#define TracingLogLazy(level, target, msg_expr)                  \
+    do {                                                         \
+        static constexpr const char* const FIELDS[] =            \
+            {"message"};                                         \
+        static TracingCallsite* CALLSITE = T_CALLSITE(           \
+            "event " __FILE__ ":" T_ESCAPEQUOTE(__LINE__),       \
+            target, level, FIELDS, false);                       \
+        if (tracing_log_enabled(CALLSITE)) {                     \
+            const std::string T_LAZY_MSG = (msg_expr);           \
+            const char* T_VALUES[] = {T_LAZY_MSG.c_str()};       \
+            tracing_log(CALLSITE, T_VALUES, T_ARRLEN(T_VALUES)); \
+        }                                                        \
+    } while (0)
+#endif
+
 /// Constructs an event at the error level.
 ///
 /// Arguments: (target, message)
@@ -19,18 +19,20 @@
 // See https://github.com/rust-lang/rfcs/pull/2585 for more background.
 #![allow(clippy::not_unsafe_ptr_arg_deref)]
 
-use bellman::groth16::{Parameters, PreparedVerifyingKey, Proof};
+use bellman::gadgets::multipack;
+use bellman::groth16::{batch, Parameters, PreparedVerifyingKey, Proof};
 use blake2s_simd::Params as Blake2sParams;
 use bls12_381::Bls12;
-use group::{cofactor::CofactorGroup, GroupEncoding};
+use group::{cofactor::CofactorGroup, Curve, Group, GroupEncoding};
 use libc::{c_uchar, size_t};
 use rand_core::{OsRng, RngCore};
+use rayon::prelude::*;
 use std::fs::File;
 use std::io::BufReader;
 use std::path::{Path, PathBuf};
 use std::slice;
 use subtle::CtOption;
-use tracing::info;
+use tracing::{error, info};
 
 #[cfg(not(target_os = "windows"))]
 use std::ffi::OsStr;
@@ -44,7 +46,10 @@ use std::os::windows::ffi::OsStringExt;
 
 use zcash_primitives::{
     block::equihash,
-    constants::{CRH_IVK_PERSONALIZATION, PROOF_GENERATION_KEY_GENERATOR, SPENDING_KEY_GENERATOR},
+    constants::{
+        CRH_IVK_PERSONALIZATION, PROOF_GENERATION_KEY_GENERATOR, SPENDING_KEY_GENERATOR,
+        VALUE_COMMITMENT_RANDOMNESS_GENERATOR, VALUE_COMMITMENT_VALUE_GENERATOR,
+    },
     merkle_tree::MerklePath,
     sapling::{merkle_hash, spend_sig},
     sapling::{
@@ -219,6 +224,52 @@ pub extern "C" fn librustzcash_merkle_hash(
     *result = tmp;
 }
 
+/// Computes `n` independent merkle tree hashes at the same depth. The
+/// `depth` parameter should not be larger than 62.
+///
+/// `inputs` must point to `n` concatenated 64-byte pairs (left then right);
+/// both halves of each pair must be scalars of BLS12-381. The `n` 32-byte
+/// results are written to `results` in input order.
+///
+/// Hashes within a batch are computed in parallel, so one crossing of the
+/// FFI can use all cores; a Pedersen hash is expensive enough that this pays
+/// off even for small batches.
+#[no_mangle]
+pub extern "C" fn librustzcash_merkle_hash_batch(
+    depth: size_t,
+    inputs: *const c_uchar,
+    n: size_t,
+    results: *mut c_uchar,
+) {
+    if n == 0 {
+        return;
+    }
+
+    // Should be okay, because caller is responsible for ensuring the
+    // pointers are valid pointers to `n` 64-byte (resp. 32-byte) chunks.
+    let inputs = unsafe { slice::from_raw_parts(inputs as *const [c_uchar; 64], n) };
+    let results = unsafe { slice::from_raw_parts_mut(results as *mut [c_uchar; 32], n) };
+
+    let hash_pair = |(input, result): (&[c_uchar; 64], &mut [c_uchar; 32])| {
+        let mut a = [0u8; 32];
+        let mut b = [0u8; 32];
+        a.copy_from_slice(&input[..32]);
+        b.copy_from_slice(&input[32..]);
+        *result = merkle_hash(depth, &a, &b);
+    };
+
+    // Below a handful of hashes the fork/join overhead dominates.
+    const PAR_THRESHOLD: usize = 4;
+    if n >= PAR_THRESHOLD {
+        inputs
+            .par_iter()
+            .zip(results.par_iter_mut())
+            .for_each(hash_pair);
+    } else {
+        inputs.iter().zip(results.iter_mut()).for_each(hash_pair);
+    }
+}
+
 #[no_mangle] // ToScalar
 pub extern "C" fn librustzcash_to_scalar(input: *const [c_uchar; 64], result: *mut [c_uchar; 32]) {
     // Should be okay, because caller is responsible for ensuring
@@ -536,20 +587,179 @@ pub extern "C" fn librustzcash_eh_isvalid(
     equihash::is_valid_solution(n, k, rs_input, rs_nonce, rs_soln).is_ok()
 }
 
+/// A batch of queued Sapling Spend and Output proofs, shared by all of the
+/// transactions in a block.
+///
+/// The queued proofs are verified together in two multi-scalar
+/// multiplications (one per circuit) by [`librustzcash_sapling_batch_validate`],
+/// which is much cheaper than verifying each Groth16 proof individually.
+pub struct SaplingBatchValidator {
+    spend_proofs: batch::Verifier<Bls12>,
+    output_proofs: batch::Verifier<Bls12>,
+    queued_spends: usize,
+    queued_outputs: usize,
+}
+
+impl SaplingBatchValidator {
+    fn validate(&mut self) -> bool {
+        let spend_proofs = std::mem::replace(&mut self.spend_proofs, batch::Verifier::new());
+        let output_proofs = std::mem::replace(&mut self.output_proofs, batch::Verifier::new());
+
+        // An empty batch is always valid, but is not free to run; skip it.
+        if self.queued_spends > 0 {
+            if let Err(e) =
+                spend_proofs.verify(OsRng, &unsafe { SAPLING_SPEND_PARAMS.as_ref() }.unwrap().vk)
+            {
+                error!("Sapling spend proof batch validation failed: {:?}", e);
+                // TODO: Try sub-batches to figure out which proofs are invalid. For
+                // per-block batching we currently don't care which transaction
+                // contained the invalid proof; the block is rejected either way.
+                return false;
+            }
+        }
+        self.queued_spends = 0;
+
+        if self.queued_outputs > 0 {
+            if let Err(e) = output_proofs.verify(
+                OsRng,
+                &unsafe { SAPLING_OUTPUT_PARAMS.as_ref() }.unwrap().vk,
+            ) {
+                error!("Sapling output proof batch validation failed: {:?}", e);
+                return false;
+            }
+        }
+        self.queued_outputs = 0;
+
+        true
+    }
+}
+
+/// Creates a Sapling proof batch validation context. Please free this when
+/// you're done.
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_batch_validation_init() -> *mut SaplingBatchValidator {
+    let ctx = Box::new(SaplingBatchValidator {
+        spend_proofs: batch::Verifier::new(),
+        output_proofs: batch::Verifier::new(),
+        queued_spends: 0,
+        queued_outputs: 0,
+    });
+
+    Box::into_raw(ctx)
+}
+
+/// Frees a Sapling proof batch validation context returned from
+/// [`librustzcash_sapling_batch_validation_init`].
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_batch_validation_free(ctx: *mut SaplingBatchValidator) {
+    if !ctx.is_null() {
+        drop(unsafe { Box::from_raw(ctx) });
+    }
+}
+
+/// Verifies the Sapling proofs that were queued into this batch, returning
+/// `true` if all proofs were valid and `false` otherwise.
+///
+/// The batch is drained by this call; the context may be reused afterwards.
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_batch_validate(ctx: *mut SaplingBatchValidator) -> bool {
+    match unsafe { ctx.as_mut() } {
+        Some(batch) => batch.validate(),
+        None => {
+            error!("librustzcash_sapling_batch_validate() called without batch!");
+            false
+        }
+    }
+}
+
+/// A per-transaction Sapling verification context.
+///
+/// This backs the opaque pointer handed across the FFI by
+/// [`librustzcash_sapling_verification_ctx_init`] and
+/// [`librustzcash_sapling_verification_ctx_init_batched`].
+pub enum SaplingVerificationCtx {
+    /// Verifies each Groth16 proof as it is seen.
+    Direct(SaplingVerificationContext),
+    /// Verifies signatures and value commitments as they are seen, but queues
+    /// the Groth16 proofs into a shared [`SaplingBatchValidator`].
+    ///
+    /// The other consensus checks performed here mirror
+    /// `zcash_proofs::sapling::SaplingVerificationContext` exactly; only the
+    /// point at which the proofs themselves are verified differs.
+    Batched {
+        /// The shared batch. The C++ caller guarantees that the batch outlives
+        /// this context.
+        batch: *mut SaplingBatchValidator,
+        /// Accumulated sum of the transaction's value commitments.
+        cv_sum: jubjub::ExtendedPoint,
+        zip216_enabled: bool,
+    },
+}
+
+/// Computes the value commitment to `value` with zero randomness, i.e. the
+/// point `value * VALUE_COMMITMENT_VALUE_GENERATOR`.
+///
+/// This is a copy of `zcash_proofs::sapling::compute_value_balance`, which is
+/// private to that crate.
+fn sapling_value_balance_point(value: Amount) -> Option<jubjub::ExtendedPoint> {
+    // Compute the absolute value (failing if -i64::MAX is the value)
+    let abs = match i64::from(value).checked_abs() {
+        Some(a) => a as u64,
+        None => return None,
+    };
+
+    // Is it negative? We'll have to negate later if so.
+    let is_negative = value.is_negative();
+
+    // Compute it in the exponent
+    let mut value_balance = VALUE_COMMITMENT_VALUE_GENERATOR * jubjub::Fr::from(abs);
+
+    // Negate if necessary
+    if is_negative {
+        value_balance = -value_balance;
+    }
+
+    // Convert to unknown order point
+    Some(value_balance.into())
+}
+
 /// Creates a Sapling verification context. Please free this when you're done.
 #[no_mangle]
 pub extern "C" fn librustzcash_sapling_verification_ctx_init(
     zip216_enabled: bool,
-) -> *mut SaplingVerificationContext {
-    let ctx = Box::new(SaplingVerificationContext::new(zip216_enabled));
+) -> *mut SaplingVerificationCtx {
+    let ctx = Box::new(SaplingVerificationCtx::Direct(
+        SaplingVerificationContext::new(zip216_enabled),
+    ));
+
+    Box::into_raw(ctx)
+}
+
+/// Creates a Sapling verification context that queues its Groth16 proofs into
+/// the given batch instead of verifying them inline. Please free this when
+/// you're done.
+///
+/// `batch` must outlive the returned context.
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_verification_ctx_init_batched(
+    batch: *mut SaplingBatchValidator,
+    zip216_enabled: bool,
+) -> *mut SaplingVerificationCtx {
+    assert!(!batch.is_null());
+    let ctx = Box::new(SaplingVerificationCtx::Batched {
+        batch,
+        cv_sum: jubjub::ExtendedPoint::identity(),
+        zip216_enabled,
+    });
 
     Box::into_raw(ctx)
 }
 
 /// Frees a Sapling verification context returned from
-/// [`librustzcash_sapling_verification_ctx_init`].
+/// [`librustzcash_sapling_verification_ctx_init`] or
+/// [`librustzcash_sapling_verification_ctx_init_batched`].
 #[no_mangle]
-pub extern "C" fn librustzcash_sapling_verification_ctx_free(ctx: *mut SaplingVerificationContext) {
+pub extern "C" fn librustzcash_sapling_verification_ctx_free(ctx: *mut SaplingVerificationCtx) {
     drop(unsafe { Box::from_raw(ctx) });
 }
 
@@ -561,7 +771,7 @@ const GROTH_PROOF_SIZE: usize = 48 // π_A
 /// commitment into the context.
 #[no_mangle]
 pub extern "C" fn librustzcash_sapling_check_spend(
-    ctx: *mut SaplingVerificationContext,
+    ctx: *mut SaplingVerificationCtx,
     cv: *const [c_uchar; 32],
     anchor: *const [c_uchar; 32],
     nullifier: *const [c_uchar; 32],
@@ -601,23 +811,76 @@ pub extern "C" fn librustzcash_sapling_check_spend(
         Err(_) => return false,
     };
 
-    unsafe { &mut *ctx }.check_spend(
-        cv,
-        anchor,
-        unsafe { &*nullifier },
-        rk,
-        unsafe { &*sighash_value },
-        spend_auth_sig,
-        zkproof,
-        unsafe { SAPLING_SPEND_VK.as_ref() }.unwrap(),
-    )
+    match unsafe { &mut *ctx } {
+        SaplingVerificationCtx::Direct(inner) => inner.check_spend(
+            cv,
+            anchor,
+            unsafe { &*nullifier },
+            rk,
+            unsafe { &*sighash_value },
+            spend_auth_sig,
+            zkproof,
+            unsafe { SAPLING_SPEND_VK.as_ref() }.unwrap(),
+        ),
+        SaplingVerificationCtx::Batched {
+            batch,
+            cv_sum,
+            zip216_enabled,
+        } => {
+            if bool::from(cv.is_small_order() | rk.0.is_small_order()) {
+                return false;
+            }
+
+            // Accumulate the value commitment in the context
+            *cv_sum += cv;
+
+            // Compute the signature's message for rk/spend_auth_sig
+            let mut data_to_be_signed = [0u8; 64];
+            data_to_be_signed[0..32].copy_from_slice(&rk.0.to_bytes());
+            data_to_be_signed[32..64].copy_from_slice(unsafe { &*sighash_value });
+
+            // Verify the spend_auth_sig
+            if !rk.verify_with_zip216(
+                &data_to_be_signed,
+                &spend_auth_sig,
+                SPENDING_KEY_GENERATOR,
+                *zip216_enabled,
+            ) {
+                return false;
+            }
+
+            // Construct public input for circuit
+            let rk_affine = rk.0.to_affine();
+            let cv_affine = cv.to_affine();
+            let nullifier = multipack::compute_multipacking::<bls12_381::Scalar>(
+                &multipack::bytes_to_bits_le(unsafe { &*nullifier }),
+            );
+            assert_eq!(nullifier.len(), 2);
+            let public_input = [
+                rk_affine.get_u(),
+                rk_affine.get_v(),
+                cv_affine.get_u(),
+                cv_affine.get_v(),
+                anchor,
+                nullifier[0],
+                nullifier[1],
+            ];
+
+            // Queue the proof for verification at the end of the batch
+            let batch = unsafe { &mut **batch };
+            batch.spend_proofs.queue((&zkproof, &public_input[..]));
+            batch.queued_spends += 1;
+
+            true
+        }
+    }
 }
 
 /// Check the validity of a Sapling Output description, accumulating the value
 /// commitment into the context.
 #[no_mangle]
 pub extern "C" fn librustzcash_sapling_check_output(
-    ctx: *mut SaplingVerificationContext,
+    ctx: *mut SaplingVerificationCtx,
     cv: *const [c_uchar; 32],
     cm: *const [c_uchar; 32],
     epk: *const [c_uchar; 32],
@@ -648,20 +911,48 @@ pub extern "C" fn librustzcash_sapling_check_output(
         Err(_) => return false,
     };
 
-    unsafe { &mut *ctx }.check_output(
-        cv,
-        cm,
-        epk,
-        zkproof,
-        unsafe { SAPLING_OUTPUT_VK.as_ref() }.unwrap(),
-    )
+    match unsafe { &mut *ctx } {
+        SaplingVerificationCtx::Direct(inner) => inner.check_output(
+            cv,
+            cm,
+            epk,
+            zkproof,
+            unsafe { SAPLING_OUTPUT_VK.as_ref() }.unwrap(),
+        ),
+        SaplingVerificationCtx::Batched { batch, cv_sum, .. } => {
+            if bool::from(cv.is_small_order() | epk.is_small_order()) {
+                return false;
+            }
+
+            // Subtract the value commitment from the context
+            *cv_sum -= cv;
+
+            // Construct public input for circuit
+            let cv_affine = cv.to_affine();
+            let epk_affine = epk.to_affine();
+            let public_input = [
+                cv_affine.get_u(),
+                cv_affine.get_v(),
+                epk_affine.get_u(),
+                epk_affine.get_v(),
+                cm,
+            ];
+
+            // Queue the proof for verification at the end of the batch
+            let batch = unsafe { &mut **batch };
+            batch.output_proofs.queue((&zkproof, &public_input[..]));
+            batch.queued_outputs += 1;
+
+            true
+        }
+    }
 }
 
 /// Finally checks the validity of the entire Sapling transaction given
 /// valueBalance and the binding signature.
 #[no_mangle]
 pub extern "C" fn librustzcash_sapling_final_check(
-    ctx: *mut SaplingVerificationContext,
+    ctx: *mut SaplingVerificationCtx,
     value_balance: i64,
     binding_sig: *const [c_uchar; 64],
     sighash_value: *const [c_uchar; 32],
@@ -677,7 +968,38 @@ pub extern "C" fn librustzcash_sapling_final_check(
         Err(_) => return false,
     };
 
-    unsafe { &*ctx }.final_check(value_balance, unsafe { &*sighash_value }, binding_sig)
+    match unsafe { &*ctx } {
+        SaplingVerificationCtx::Direct(inner) => {
+            inner.final_check(value_balance, unsafe { &*sighash_value }, binding_sig)
+        }
+        SaplingVerificationCtx::Batched {
+            cv_sum,
+            zip216_enabled,
+            ..
+        } => {
+            // Compute value balance
+            let value_balance = match sapling_value_balance_point(value_balance) {
+                Some(vb) => vb,
+                None => return false,
+            };
+
+            // Subtract value_balance from cv_sum to get final bvk
+            let bvk = redjubjub::PublicKey(*cv_sum - value_balance);
+
+            // Compute the signature's message for bvk/binding_sig
+            let mut data_to_be_signed = [0u8; 64];
+            data_to_be_signed[0..32].copy_from_slice(&bvk.0.to_bytes());
+            data_to_be_signed[32..64].copy_from_slice(unsafe { &*sighash_value });
+
+            // Verify the binding_sig
+            bvk.verify_with_zip216(
+                &data_to_be_signed,
+                &binding_sig,
+                VALUE_COMMITMENT_RANDOMNESS_GENERATOR,
+                *zip216_enabled,
+            )
+        }
+    }
 }
 
 /// Sprout JoinSplit proof generation.
@@ -58,6 +58,7 @@ pub extern "C" fn tracing_init(
     log_path_len: usize,
     initial_filter: *const c_char,
     log_timestamps: bool,
+    log_json: bool,
 ) -> *mut TracingHandle {
     let initial_filter = unsafe { CStr::from_ptr(initial_filter) }
         .to_str()
@@ -77,63 +78,94 @@ pub extern "C" fn tracing_init(
 
     let log_path = log_path.as_ref().map(Path::new);
 
-    let (file_logger, file_no_timestamps, file_guard) = if let Some(log_path) = log_path {
+    let (file_logger, file_no_timestamps, file_json, file_guard) = if let Some(log_path) = log_path
+    {
         let file_appender = tracing_appender::rolling::never(
             log_path.parent().unwrap(),
             log_path.file_name().unwrap(),
         );
         let (non_blocking, file_guard) = tracing_appender::non_blocking(file_appender);
 
-        if log_timestamps {
+        if log_json {
+            // JSON events always carry a timestamp field; log_timestamps only
+            // applies to the human-readable format.
             (
+                None,
+                None,
                 Some(
                     tracing_subscriber::fmt::layer()
                         .with_ansi(false)
-                        .with_writer(non_blocking),
+                        .with_writer(non_blocking)
+                        .json(),
                 ),
-                None,
                 Some(file_guard),
             )
-        } else {
+        } else if log_timestamps {
             (
-                None,
                 Some(
                     tracing_subscriber::fmt::layer()
                         .with_ansi(false)
-                        .with_writer(non_blocking)
-                        .without_time(),
+                        .with_writer(non_blocking),
                 ),
+                None,
+                None,
                 Some(file_guard),
             )
-        }
-    } else {
-        (None, None, None)
-    };
-
-    let (stdout_logger, stdout_no_timestamps) = if file_logger.is_none() {
-        if log_timestamps {
-            (Some(tracing_subscriber::fmt::layer().with_ansi(true)), None)
         } else {
             (
                 None,
                 Some(
                     tracing_subscriber::fmt::layer()
-                        .with_ansi(true)
+                        .with_ansi(false)
+                        .with_writer(non_blocking)
                         .without_time(),
                 ),
+                None,
+                Some(file_guard),
             )
         }
     } else {
-        (None, None)
+        (None, None, None, None)
     };
 
+    let (stdout_logger, stdout_no_timestamps, stdout_json) =
+        if file_logger.is_none() && file_json.is_none() {
+            if log_json {
+                (
+                    None,
+                    None,
+                    Some(tracing_subscriber::fmt::layer().with_ansi(false).json()),
+                )
+            } else if log_timestamps {
+                (
+                    Some(tracing_subscriber::fmt::layer().with_ansi(true)),
+                    None,
+                    None,
+                )
+            } else {
+                (
+                    None,
+                    Some(
+                        tracing_subscriber::fmt::layer()
+                            .with_ansi(true)
+                            .without_time(),
+                    ),
+                    None,
+                )
+            }
+        } else {
+            (None, None, None)
+        };
+
     let (filter, reload_handle) = reload::Layer::new(EnvFilter::from(initial_filter));
 
     tracing_subscriber::registry()
         .with(stdout_logger)
         .with(stdout_no_timestamps)
+        .with(stdout_json)
         .with(file_logger)
         .with(file_no_timestamps)
+        .with(file_json)
         .with(filter)
         .init();
 
@@ -555,6 +587,14 @@ pub extern "C" fn tracing_span_exit(guard: *mut Entered) {
     }
 }
 
+#[no_mangle]
+pub extern "C" fn tracing_log_enabled(callsite: *const FfiCallsite) -> bool {
+    let callsite = unsafe { &*callsite };
+    let meta = callsite.metadata();
+    assert!(meta.is_event());
+    level_enabled!(*meta.level()) && callsite.is_enabled()
+}
+
 #[no_mangle]
 pub extern "C" fn tracing_log(
     callsite: *const FfiCallsite,
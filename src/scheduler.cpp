@@ -109,6 +109,51 @@ void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
     scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds), deltaSeconds);
 }
 
+void CScheduler::repeatFixedRate(const std::string& name, CScheduler::Function f,
+                                 boost::chrono::system_clock::duration delta,
+                                 boost::chrono::system_clock::time_point scheduled)
+{
+    boost::chrono::system_clock::time_point started = boost::chrono::system_clock::now();
+    f();
+    boost::chrono::system_clock::time_point finished = boost::chrono::system_clock::now();
+
+    // The next run stays on the original grid; periods the run overran are
+    // skipped rather than run back to back.
+    boost::chrono::system_clock::time_point next = scheduled + delta;
+    uint64_t nMissed = 0;
+    while (next <= finished) {
+        next += delta;
+        nMissed++;
+    }
+
+    int64_t nUsec = boost::chrono::duration_cast<boost::chrono::microseconds>(finished - started).count();
+    {
+        boost::unique_lock<boost::mutex> lock(newTaskMutex);
+        TaskStats& stats = mapTaskStats[name];
+        stats.nRuns++;
+        stats.nMissed += nMissed;
+        stats.nLastUsec = nUsec;
+        if (nUsec > stats.nMaxUsec)
+            stats.nMaxUsec = nUsec;
+        stats.nTotalUsec += nUsec;
+    }
+
+    schedule(boost::bind(&CScheduler::repeatFixedRate, this, name, f, delta, next), next);
+}
+
+void CScheduler::scheduleEveryFixedRate(const std::string& name, CScheduler::Function f, int64_t deltaSeconds)
+{
+    boost::chrono::system_clock::duration delta = boost::chrono::seconds(deltaSeconds);
+    boost::chrono::system_clock::time_point first = boost::chrono::system_clock::now() + delta;
+    schedule(boost::bind(&CScheduler::repeatFixedRate, this, name, f, delta, first), first);
+}
+
+std::map<std::string, CScheduler::TaskStats> CScheduler::getTaskStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return mapTaskStats;
+}
+
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
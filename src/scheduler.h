@@ -13,6 +13,7 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+#include <string>
 
 //
 // Simple class for background tasks that should be run
@@ -53,6 +54,28 @@ public:
     // need more accurate scheduling, don't use this method.
     void scheduleEvery(Function f, int64_t deltaSeconds);
 
+    // Aggregate runtime statistics for one task scheduled with
+    // scheduleEveryFixedRate.
+    struct TaskStats {
+        uint64_t nRuns = 0;       // completed runs
+        uint64_t nMissed = 0;     // periods skipped because a run overran them
+        int64_t nLastUsec = 0;    // duration of the most recent run
+        int64_t nMaxUsec = 0;     // longest run so far
+        int64_t nTotalUsec = 0;   // total time spent in runs
+    };
+
+    // Like scheduleEvery, but with fixed-rate semantics: each run is
+    // scheduled deltaSeconds after the previous run was *due* rather than
+    // after it finished, so one slow run doesn't shift every later run.
+    // Periods a run overran entirely are skipped (and counted in the task's
+    // stats) instead of being run back to back, which also keeps a task from
+    // running concurrently with itself when multiple threads service the
+    // queue. Runtime stats are recorded under the given name.
+    void scheduleEveryFixedRate(const std::string& name, Function f, int64_t deltaSeconds);
+
+    // Snapshot of the per-task stats recorded by scheduleEveryFixedRate.
+    std::map<std::string, TaskStats> getTaskStats() const;
+
     // To keep things as simple as possible, there is no unschedule.
 
     // Services the queue 'forever'. Should be run in a thread,
@@ -70,7 +93,12 @@ public:
                         boost::chrono::system_clock::time_point &last) const;
 
 private:
+    void repeatFixedRate(const std::string& name, Function f,
+                         boost::chrono::system_clock::duration delta,
+                         boost::chrono::system_clock::time_point scheduled);
+
     std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    std::map<std::string, TaskStats> mapTaskStats;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
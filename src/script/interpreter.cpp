@@ -304,7 +304,9 @@ bool EvalScript(
                 if (fRequireMinimal && !CheckMinimalPush(vchPushValue, opcode)) {
                     return set_error(serror, SCRIPT_ERR_MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                // vchPushValue is refilled by the next GetOp, so hand the
+                // buffer to the stack instead of copying it.
+                stack.push_back(std::move(vchPushValue));
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF))
             switch (opcode)
             {
@@ -457,7 +459,7 @@ bool EvalScript(
                 {
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    altstack.push_back(stacktop(-1));
+                    altstack.push_back(std::move(stacktop(-1)));
                     popstack(stack);
                 }
                 break;
@@ -466,7 +468,7 @@ bool EvalScript(
                 {
                     if (altstack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_ALTSTACK_OPERATION);
-                    stack.push_back(altstacktop(-1));
+                    stack.push_back(std::move(altstacktop(-1)));
                     popstack(altstack);
                 }
                 break;
@@ -610,10 +612,10 @@ bool EvalScript(
                     popstack(stack);
                     if (n < 0 || n >= (int)stack.size())
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-n-1);
+                    valtype vch = opcode == OP_ROLL ? std::move(stacktop(-n-1)) : stacktop(-n-1);
                     if (opcode == OP_ROLL)
                         stack.erase(stack.end()-n-1);
-                    stack.push_back(vch);
+                    stack.push_back(std::move(vch));
                 }
                 break;
 
@@ -1140,13 +1142,23 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
         txTo.nVersionGroupId == SAPLING_VERSION_GROUP_ID &&
         txTo.nVersion == SAPLING_TX_VERSION;
 
-    if (!txTo.fOverwintered || isOverwinterV3 || isSaplingV4) {
+    if (!txTo.fOverwintered) {
+        // Pre-Overwinter transactions take the legacy SignatureHash path,
+        // which re-serializes per input and never consults these midstates;
+        // computing them here would be pure overhead.
+    } else if (isOverwinterV3 || isSaplingV4) {
         hashPrevouts = GetPrevoutHash(txTo);
         hashSequence = GetSequenceHash(txTo);
         hashOutputs = GetOutputsHash(txTo);
-        hashJoinSplits = GetJoinSplitsHash(txTo);
-        hashShieldedSpends = GetShieldedSpendsHash(txTo);
-        hashShieldedOutputs = GetShieldedOutputsHash(txTo);
+        // The shielded component hashes are only ever consulted when the
+        // corresponding vectors are non-empty, so skip the BLAKE2b work for
+        // the common all-transparent transaction.
+        if (!txTo.vJoinSplit.empty())
+            hashJoinSplits = GetJoinSplitsHash(txTo);
+        if (!txTo.vShieldedSpend.empty())
+            hashShieldedSpends = GetShieldedSpendsHash(txTo);
+        if (!txTo.vShieldedOutput.empty())
+            hashShieldedOutputs = GetShieldedOutputsHash(txTo);
     } else {
         // TODO: If we already have this serialized, use it.
         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
@@ -1416,7 +1428,9 @@ bool VerifyScript(
     if (!EvalScript(stack, scriptSig, flags, checker, consensusBranchId, serror))
         // serror is set
         return false;
-    if (flags & SCRIPT_VERIFY_P2SH)
+    // The copy is only consumed by the pay-to-script-hash path below, so
+    // don't pay for it on every other input.
+    if ((flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash())
         stackCopy = stack;
     if (!EvalScript(stack, scriptPubKey, flags, checker, consensusBranchId, serror))
         // serror is set
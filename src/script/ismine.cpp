@@ -5,12 +5,15 @@
 
 #include "ismine.h"
 
+#include "cuckoocache.h"
+#include "hash.h"
 #include "key.h"
 #include "keystore.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "script/sign.h"
 
+#include <mutex>
 
 using namespace std;
 
@@ -110,11 +113,58 @@ isminetype IsMineInner(const CKeyStore& keystore, const CScript& scriptPubKey, I
     return ISMINE_NO;
 }
 
+/**
+ * Cached classification of one script against one keystore. An entry is only
+ * trusted if both the keystore's cache id and the global keystore generation
+ * still match: the generation is bumped whenever any keystore's transparent
+ * key or script material changes, and cache ids are never reused, so stale
+ * hits are impossible. Keeps rescans and index builds from re-running the
+ * solver and key lookups for the same scriptPubKeys millions of times.
+ */
+struct IsMineCacheEntry
+{
+    uint64_t nCacheId;
+    uint64_t nGeneration;
+    isminetype result;
+};
+
+struct IsMineCacheHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+
+static std::mutex g_ismineCacheMutex;
+static cuckoocache<uint256, IsMineCacheEntry, IsMineCacheHasher> g_ismineCache(16384);
+
 } // namespace
 
 isminetype IsMine(const CKeyStore& keystore, const CScript& scriptPubKey)
 {
-    return IsMineInner(keystore, scriptPubKey, IsMineSigVersion::TOP);
+    const uint64_t nCacheId = keystore.GetIsMineCacheId();
+    // The generation is captured before classifying: if the keystore changes
+    // while we classify, the stored generation is already behind and the
+    // entry simply never hits.
+    const uint64_t nGeneration = GetKeystoreGeneration();
+    uint256 key;
+    if (nCacheId != 0) {
+        key = Hash(scriptPubKey.begin(), scriptPubKey.end());
+        std::lock_guard<std::mutex> lock(g_ismineCacheMutex);
+        IsMineCacheEntry entry;
+        if (g_ismineCache.find(key, entry) && entry.nCacheId == nCacheId && entry.nGeneration == nGeneration)
+            return entry.result;
+    }
+
+    isminetype ret = IsMineInner(keystore, scriptPubKey, IsMineSigVersion::TOP);
+
+    if (nCacheId != 0) {
+        IsMineCacheEntry entry;
+        entry.nCacheId = nCacheId;
+        entry.nGeneration = nGeneration;
+        entry.result = ret;
+        std::lock_guard<std::mutex> lock(g_ismineCacheMutex);
+        g_ismineCache.insert(key, entry);
+    }
+    return ret;
 }
 
 isminetype IsMine(const CKeyStore& keystore, const CTxDestination& dest)
@@ -380,7 +380,15 @@ private:
     int64_t m_value;
 };
 
-typedef prevector<28, unsigned char> CScriptBase;
+/** Direct (in-object) capacity of the script backing store. 28 bytes covers
+ * every standard scriptPubKey (P2PKH is 25, P2SH is 23); scriptSigs and
+ * larger redeem scripts spill to the heap. Overridable from CPPFLAGS so a
+ * workload measured with -DPREVECTOR_PROFILE can be retuned without edits. */
+#ifndef CSCRIPT_PREVECTOR_SIZE
+#define CSCRIPT_PREVECTOR_SIZE 28
+#endif
+
+typedef prevector<CSCRIPT_PREVECTOR_SIZE, unsigned char> CScriptBase;
 
 /** Serialized script, used inside transaction inputs and outputs */
 class CScript : public CScriptBase
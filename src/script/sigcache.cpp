@@ -5,43 +5,90 @@
 
 #include "sigcache.h"
 
-#include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
 #include <boost/thread.hpp>
-#include <boost/unordered_set.hpp>
 
-namespace {
+#include <rust/metrics.h>
 
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- */
-class CSignatureCacheHasher
-{
-public:
-    size_t operator()(const uint256& key) const {
-        return key.GetCheapHash();
-    }
-};
+namespace {
 
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
- * again when accepted into the block chain)
+ * again when accepted into the block chain).
+ *
+ * The cache is split into SIGCACHE_SHARDS independently locked shards, each
+ * an open-addressed table of cache-line-sized slots, so concurrent lookups
+ * from AcceptToMemoryPool and ConnectBlock only contend when they land on
+ * the same shard. Eviction is generation based: once a shard fills up past
+ * its high-water mark its generation counter is bumped, which lazily
+ * invalidates the older entries as the probe sequences reuse their slots.
  */
 class CSignatureCache
 {
 private:
-     //! Entries are SHA256(nonce || signature hash || public key || signature):
+    //! Number of shards; must be a power of two.
+    static const size_t SIGCACHE_SHARDS = 16;
+    //! Linear probe window within a shard's table.
+    static const size_t SIGCACHE_PROBES = 8;
+
+    //! One slot, padded out to a cache line so neighbouring slots don't
+    //! false-share between shards' readers and a writer.
+    struct Slot {
+        uint256 hash;
+        uint32_t nGeneration;
+        unsigned char padding[64 - sizeof(uint256) - sizeof(uint32_t)];
+    };
+
+    struct Shard {
+        boost::shared_mutex cs;
+        std::vector<Slot> table;
+        //! Mask over table size (a power of two), 0 until initialized.
+        size_t nMask;
+        //! Current generation; slots from older generations are free.
+        uint32_t nGeneration;
+        //! Entries written since the last generation bump.
+        size_t nWritten;
+
+        Shard() : nMask(0), nGeneration(1), nWritten(0) {}
+    };
+
+    //! Entries are SHA256(nonce || signature hash || public key || signature):
     uint256 nonce;
-    typedef boost::unordered_set<uint256, CSignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
+    Shard shards[SIGCACHE_SHARDS];
 
+    Shard& GetShard(const uint256& entry)
+    {
+        return shards[entry.GetCheapHash() & (SIGCACHE_SHARDS - 1)];
+    }
+
+    //! Slot index for the start of an entry's probe window. Uses the upper
+    //! cheap-hash bits so it is independent of the shard selector.
+    static size_t FirstSlot(const Shard& shard, const uint256& entry)
+    {
+        return (entry.GetCheapHash() >> 32) & shard.nMask;
+    }
+
+    //! Size a shard's table from -maxsigcachesize; returns false if caching
+    //! is disabled. Requires the shard's lock held exclusively.
+    static bool InitShard(Shard& shard)
+    {
+        if (shard.nMask != 0)
+            return true;
+        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t)1 << 20);
+        if (nMaxCacheSize <= 0)
+            return false;
+        size_t nSlots = 1;
+        while (nSlots * 2 * sizeof(Slot) * SIGCACHE_SHARDS <= nMaxCacheSize)
+            nSlots *= 2;
+        shard.table.resize(nSlots);
+        shard.nMask = nSlots - 1;
+        return true;
+    }
 
 public:
     CSignatureCache()
@@ -58,50 +105,109 @@ public:
     bool
     Get(const uint256& entry)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.count(entry);
+        Shard& shard = GetShard(entry);
+        boost::shared_lock<boost::shared_mutex> lock(shard.cs);
+        if (shard.nMask == 0)
+            return false;
+        size_t nFirst = FirstSlot(shard, entry);
+        for (size_t i = 0; i < SIGCACHE_PROBES; i++) {
+            const Slot& slot = shard.table[(nFirst + i) & shard.nMask];
+            if (slot.nGeneration == shard.nGeneration && slot.hash == entry)
+                return true;
+        }
+        return false;
     }
 
     void Erase(const uint256& entry)
     {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.erase(entry);
+        Shard& shard = GetShard(entry);
+        boost::unique_lock<boost::shared_mutex> lock(shard.cs);
+        if (shard.nMask == 0)
+            return;
+        size_t nFirst = FirstSlot(shard, entry);
+        for (size_t i = 0; i < SIGCACHE_PROBES; i++) {
+            Slot& slot = shard.table[(nFirst + i) & shard.nMask];
+            if (slot.nGeneration == shard.nGeneration && slot.hash == entry) {
+                slot.nGeneration = 0;
+                return;
+            }
+        }
     }
 
     void Set(const uint256& entry)
     {
-        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
-        {
-            map_type::size_type s = GetRand(setValid.bucket_count());
-            map_type::local_iterator it = setValid.begin(s);
-            if (it != setValid.end(s)) {
-                setValid.erase(*it);
+        Shard& shard = GetShard(entry);
+        boost::unique_lock<boost::shared_mutex> lock(shard.cs);
+        if (!InitShard(shard))
+            return;
+        size_t nFirst = FirstSlot(shard, entry);
+        size_t nVictim = nFirst;
+        for (size_t i = 0; i < SIGCACHE_PROBES; i++) {
+            Slot& slot = shard.table[(nFirst + i) & shard.nMask];
+            if (slot.nGeneration != shard.nGeneration) {
+                // Free (or stale) slot: claim it.
+                nVictim = (nFirst + i) & shard.nMask;
+                break;
             }
+            if (slot.hash == entry)
+                return;
         }
+        Slot& slot = shard.table[nVictim];
+        if (slot.nGeneration != shard.nGeneration)
+            shard.nWritten++;
+        slot.hash = entry;
+        slot.nGeneration = shard.nGeneration;
+        // Once the shard is mostly full, retire the whole generation rather
+        // than thrashing the probe windows one eviction at a time.
+        if (shard.nWritten * 4 >= shard.table.size() * 3) {
+            shard.nGeneration++;
+            if (shard.nGeneration == 0)
+                shard.nGeneration = 1;
+            shard.nWritten = 0;
+        }
+    }
 
-        setValid.insert(entry);
+    size_t DynamicMemoryUsage()
+    {
+        size_t nBytes = 0;
+        for (size_t i = 0; i < SIGCACHE_SHARDS; i++) {
+            boost::shared_lock<boost::shared_mutex> lock(shards[i].cs);
+            nBytes += shards[i].table.capacity() * sizeof(Slot);
+        }
+        return nBytes;
     }
 };
 
+// Constructed on first use so the nonce isn't drawn during static
+// initialization.
+CSignatureCache& GetSignatureCache()
+{
+    static CSignatureCache signatureCache;
+    return signatureCache;
+}
+
+}
+
+size_t SignatureCacheBytes()
+{
+    return GetSignatureCache().DynamicMemoryUsage();
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = GetSignatureCache();
 
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
 
     if (signatureCache.Get(entry)) {
+        MetricsIncrementCounter("zcash.script.sigcache.hits");
         if (!store) {
             signatureCache.Erase(entry);
         }
         return true;
     }
+    MetricsIncrementCounter("zcash.script.sigcache.misses");
 
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
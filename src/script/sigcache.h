@@ -27,4 +27,7 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/** Approximate bytes currently allocated by the signature cache. */
+size_t SignatureCacheBytes();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -84,47 +84,74 @@ bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<std::v
 {
     vSolutionsRet.clear();
 
-    // Shortcut for pay-to-script-hash, which are more constrained than the other types:
-    // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
-    if (scriptPubKey.IsPayToScriptHash())
-    {
-        typeRet = TX_SCRIPTHASH;
-        vector<unsigned char> hashBytes(scriptPubKey.begin()+2, scriptPubKey.begin()+22);
-        vSolutionsRet.push_back(hashBytes);
-        return true;
-    }
-
-    // Provably prunable, data-carrying output
-    //
-    // So long as script passes the IsUnspendable() test and all but the first
-    // byte passes the IsPushOnly() test we don't care what exactly is in the
-    // script.
-    if (scriptPubKey.size() >= 1 && scriptPubKey[0] == OP_RETURN && scriptPubKey.IsPushOnly(scriptPubKey.begin()+1)) {
-        typeRet = TX_NULL_DATA;
-        return true;
-    }
-
-    std::vector<unsigned char> data;
-    if (MatchPayToPubkey(scriptPubKey, data)) {
-        typeRet = TX_PUBKEY;
-        vSolutionsRet.push_back(std::move(data));
-        return true;
-    }
+    // Every standard output type starts with a distinct first byte (an
+    // opcode, or the push length of a pubkey), so a single switch dispatches
+    // straight to the one template that can possibly match instead of trying
+    // each matcher in turn. The matchers below verify the rest of the
+    // template, so the results are identical to attempting them all.
+    if (scriptPubKey.size() > 0) {
+        switch (scriptPubKey[0]) {
+        case OP_HASH160:
+            // Pay-to-script-hash is more constrained than the other types:
+            // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
+            if (scriptPubKey.IsPayToScriptHash()) {
+                typeRet = TX_SCRIPTHASH;
+                vector<unsigned char> hashBytes(scriptPubKey.begin()+2, scriptPubKey.begin()+22);
+                vSolutionsRet.push_back(hashBytes);
+                return true;
+            }
+            break;
+
+        case OP_RETURN:
+            // Provably prunable, data-carrying output
+            //
+            // So long as script passes the IsUnspendable() test and all but the first
+            // byte passes the IsPushOnly() test we don't care what exactly is in the
+            // script.
+            if (scriptPubKey.IsPushOnly(scriptPubKey.begin()+1)) {
+                typeRet = TX_NULL_DATA;
+                return true;
+            }
+            break;
+
+        case CPubKey::PUBLIC_KEY_SIZE:
+        case CPubKey::COMPRESSED_PUBLIC_KEY_SIZE:
+        {
+            std::vector<unsigned char> data;
+            if (MatchPayToPubkey(scriptPubKey, data)) {
+                typeRet = TX_PUBKEY;
+                vSolutionsRet.push_back(std::move(data));
+                return true;
+            }
+            break;
+        }
 
-    if (MatchPayToPubkeyHash(scriptPubKey, data)) {
-        typeRet = TX_PUBKEYHASH;
-        vSolutionsRet.push_back(std::move(data));
-        return true;
-    }
+        case OP_DUP:
+        {
+            std::vector<unsigned char> data;
+            if (MatchPayToPubkeyHash(scriptPubKey, data)) {
+                typeRet = TX_PUBKEYHASH;
+                vSolutionsRet.push_back(std::move(data));
+                return true;
+            }
+            break;
+        }
 
-    unsigned int required;
-    std::vector<std::vector<unsigned char>> keys;
-    if (MatchMultisig(scriptPubKey, required, keys)) {
-        typeRet = TX_MULTISIG;
-        vSolutionsRet.push_back({static_cast<unsigned char>(required)}); // safe as required is in range 1..16
-        vSolutionsRet.insert(vSolutionsRet.end(), keys.begin(), keys.end());
-        vSolutionsRet.push_back({static_cast<unsigned char>(keys.size())}); // safe as size is in range 1..16
-        return true;
+        default:
+            // Multisig starts with a small integer (OP_1 through OP_16).
+            if (IsSmallInteger((opcodetype)scriptPubKey[0])) {
+                unsigned int required;
+                std::vector<std::vector<unsigned char>> keys;
+                if (MatchMultisig(scriptPubKey, required, keys)) {
+                    typeRet = TX_MULTISIG;
+                    vSolutionsRet.push_back({static_cast<unsigned char>(required)}); // safe as required is in range 1..16
+                    vSolutionsRet.insert(vSolutionsRet.end(), keys.begin(), keys.end());
+                    vSolutionsRet.push_back({static_cast<unsigned char>(keys.size())}); // safe as size is in range 1..16
+                    return true;
+                }
+            }
+            break;
+        }
     }
 
     vSolutionsRet.clear();
@@ -198,15 +225,22 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, vecto
     if (typeRet == TX_MULTISIG)
     {
         nRequiredRet = vSolutions.front()[0];
+        // A multisig script is the one script yielding several key IDs, so
+        // derive them with one batched Hash160 pass over the valid keys.
+        std::vector<std::pair<const unsigned char*, size_t>> vMessages;
+        vMessages.reserve(vSolutions.size() - 2);
         for (unsigned int i = 1; i < vSolutions.size()-1; i++)
         {
             CPubKey pubKey(vSolutions[i]);
             if (!pubKey.IsValid())
                 continue;
 
-            CTxDestination address = pubKey.GetID();
-            addressRet.push_back(address);
+            vMessages.push_back(std::make_pair(vSolutions[i].data(), vSolutions[i].size()));
         }
+        std::vector<uint160> vKeyIDs;
+        Hash160Batch(vMessages, vKeyIDs);
+        for (const uint160& keyID : vKeyIDs)
+            addressRet.push_back(CKeyID(keyID));
 
         if (addressRet.empty())
             return false;
@@ -423,6 +423,58 @@ public:
 
 };
 
+/** Minimal read-only stream that deserializes directly from a caller-owned
+ * buffer, without copying it into an intermediate vector first. The buffer
+ * must outlive the reader.
+ */
+class CSpanReader
+{
+private:
+    const int nType;
+    int nVersion;
+    const unsigned char* pdata;
+    size_t nRemaining;
+
+public:
+    CSpanReader(int nTypeIn, int nVersionIn, const unsigned char* pdataIn, size_t nSizeIn) :
+            nType(nTypeIn), nVersion(nVersionIn), pdata(pdataIn), nRemaining(nSizeIn) { }
+
+    CSpanReader(int nTypeIn, int nVersionIn, const std::vector<unsigned char>& vchIn) :
+            CSpanReader(nTypeIn, nVersionIn, vchIn.data(), vchIn.size()) { }
+
+    size_t size() const          { return nRemaining; }
+    bool empty() const           { return nRemaining == 0; }
+    bool eof() const             { return nRemaining == 0; }
+    int GetType() const          { return nType; }
+    void SetVersion(int n)       { nVersion = n; }
+    int GetVersion() const       { return nVersion; }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > nRemaining)
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        memcpy(pch, pdata, nSize);
+        pdata += nSize;
+        nRemaining -= nSize;
+    }
+
+    void ignore(size_t nSize)
+    {
+        if (nSize > nRemaining)
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        pdata += nSize;
+        nRemaining -= nSize;
+    }
+
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
 
 
 
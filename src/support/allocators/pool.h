@@ -0,0 +1,180 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+//
+// A memory resource similar to std::pmr::unsynchronized_pool_resource, but
+// tailored to node-based containers: all blocks up to MAX_BLOCK_SIZE_BYTES
+// are carved out of large chunks and recycled through per-size free lists,
+// so the many small node allocations of an unordered_map neither thrash
+// malloc nor scatter across the heap. Larger (or over-aligned) requests,
+// such as the hash table's bucket array, fall through to ::operator new.
+// Freed blocks are kept for reuse and only returned to the system when the
+// resource is destroyed, which suits a cache that is filled, consulted and
+// periodically flushed.
+//
+// This class is NOT thread safe; the container using it is expected to be
+// externally synchronized, as CCoinsViewCache already is via cs_main.
+//
+class PoolResource
+{
+private:
+    //! Allocation granularity and guaranteed alignment of pooled blocks.
+    static const size_t ELEM_ALIGN_BYTES = alignof(std::max_align_t);
+
+    //! Largest request served from the pool; anything bigger goes to new.
+    static const size_t MAX_BLOCK_SIZE_BYTES = 256;
+
+    //! Bytes requested from the system per chunk.
+    static const size_t CHUNK_SIZE_BYTES = 262144;
+
+    //! In-place singly linked list of free blocks of one size class.
+    struct ListNode {
+        ListNode* next;
+    };
+
+    //! Head of the free list for each size class (index = size / ELEM_ALIGN_BYTES).
+    ListNode* freeLists[MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1];
+
+    //! All chunks obtained from the system, released in the destructor.
+    std::vector<void*> vChunks;
+
+    //! Bump pointer into the current chunk, and bytes still available there.
+    char* pAvailable;
+    size_t nAvailableBytes;
+
+    static bool IsPooled(size_t bytes, size_t align)
+    {
+        return bytes <= MAX_BLOCK_SIZE_BYTES && align <= ELEM_ALIGN_BYTES;
+    }
+
+    //! Round a pooled request up to its size class in bytes.
+    static size_t RoundUp(size_t bytes)
+    {
+        // A block must be able to hold the free list node once returned.
+        if (bytes < sizeof(ListNode))
+            bytes = sizeof(ListNode);
+        return (bytes + ELEM_ALIGN_BYTES - 1) & ~(ELEM_ALIGN_BYTES - 1);
+    }
+
+    void AllocateChunk()
+    {
+        void* chunk = ::operator new(CHUNK_SIZE_BYTES);
+        vChunks.push_back(chunk);
+        pAvailable = static_cast<char*>(chunk);
+        nAvailableBytes = CHUNK_SIZE_BYTES;
+    }
+
+    // No copying: handed-out pointers refer into this resource.
+    PoolResource(const PoolResource&);
+    PoolResource& operator=(const PoolResource&);
+
+public:
+    PoolResource() : pAvailable(NULL), nAvailableBytes(0)
+    {
+        for (size_t i = 0; i < sizeof(freeLists) / sizeof(freeLists[0]); i++)
+            freeLists[i] = NULL;
+    }
+
+    ~PoolResource()
+    {
+        for (size_t i = 0; i < vChunks.size(); i++)
+            ::operator delete(vChunks[i]);
+    }
+
+    void* Allocate(size_t bytes, size_t align)
+    {
+        if (!IsPooled(bytes, align))
+            return ::operator new(bytes);
+        size_t nClassBytes = RoundUp(bytes);
+        ListNode*& freeList = freeLists[nClassBytes / ELEM_ALIGN_BYTES];
+        if (freeList != NULL) {
+            void* block = freeList;
+            freeList = freeList->next;
+            return block;
+        }
+        if (nAvailableBytes < nClassBytes)
+            AllocateChunk();
+        void* block = pAvailable;
+        pAvailable += nClassBytes;
+        nAvailableBytes -= nClassBytes;
+        return block;
+    }
+
+    void Deallocate(void* p, size_t bytes, size_t align)
+    {
+        if (!IsPooled(bytes, align)) {
+            ::operator delete(p);
+            return;
+        }
+        size_t nClassBytes = RoundUp(bytes);
+        ListNode* node = static_cast<ListNode*>(p);
+        ListNode*& freeList = freeLists[nClassBytes / ELEM_ALIGN_BYTES];
+        node->next = freeList;
+        freeList = node;
+    }
+
+    //! Memory held by this resource, whether handed out, free-listed or unused.
+    size_t DynamicMemoryUsage() const
+    {
+        return vChunks.size() * CHUNK_SIZE_BYTES + vChunks.capacity() * sizeof(void*);
+    }
+};
+
+//
+// STL-compatible allocator that draws from a PoolResource. The resource is
+// not owned: it must outlive every container (and every rebound copy) that
+// allocates through it.
+//
+template <typename T>
+class PoolAllocator
+{
+private:
+    PoolResource* m_resource;
+
+    template <typename U>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+
+    explicit PoolAllocator(PoolResource* resource) : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : m_resource(other.m_resource) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    PoolResource* resource() const { return m_resource; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const
+    {
+        return m_resource == other.m_resource;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const
+    {
+        return m_resource != other.m_resource;
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -34,8 +34,10 @@ struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
 };
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
-extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+typedef boost::unordered_map<uint256, COrphanTx, SaltedTxidHasher> OrphanMap;
+typedef boost::unordered_map<COutPoint, std::set<const COrphanTx*>, SaltedOutpointHasher> OrphanMapByPrev;
+extern OrphanMap mapOrphanTransactions;
+extern OrphanMapByPrev mapOrphanTransactionsByPrev;
 
 CService ip(uint32_t i)
 {
@@ -114,10 +116,8 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
 
 CTransaction RandomOrphan()
 {
-    std::map<uint256, COrphanTx>::iterator it;
-    it = mapOrphanTransactions.lower_bound(GetRandHash());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
+    OrphanMap::iterator it = mapOrphanTransactions.begin();
+    std::advance(it, GetRand(mapOrphanTransactions.size()));
     return it->second.tx;
 }
 
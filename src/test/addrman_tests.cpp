@@ -332,6 +332,54 @@ BOOST_AUTO_TEST_CASE(addrman_delete)
     BOOST_CHECK(info2 == NULL);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_dirty_tracking)
+{
+    CAddrManTest addrman;
+
+    // Set addrman addr placement to be deterministic.
+    addrman.MakeDeterministic();
+
+    CNetAddr source = CNetAddr("252.2.2.2");
+    CService addr1 = CService("250.1.1.1", 8333);
+    CService addr2 = CService("250.1.1.2", 8333);
+
+    // Adding addresses marks them dirty, and draining clears the set.
+    addrman.Add(CAddress(addr1), source);
+    addrman.Add(CAddress(addr2), source);
+    std::vector<CAddrInfo> vDirty;
+    addrman.GetDirty(vDirty);
+    BOOST_CHECK_EQUAL(vDirty.size(), 2);
+    vDirty.clear();
+    addrman.GetDirty(vDirty);
+    BOOST_CHECK_EQUAL(vDirty.size(), 0);
+
+    // Connection attempts and successes mark the entry dirty again.
+    addrman.Attempt(addr1);
+    addrman.GetDirty(vDirty);
+    BOOST_CHECK_EQUAL(vDirty.size(), 1);
+    vDirty.clear();
+    addrman.Good(addr1);
+    addrman.GetDirty(vDirty);
+    BOOST_CHECK_EQUAL(vDirty.size(), 1);
+
+    // Replaying the drained entries into a fresh addrman restores them.
+    CAddrManTest addrman2;
+    addrman2.MakeDeterministic();
+    addrman2.AddJournaled(vDirty[0]);
+    BOOST_CHECK_EQUAL(addrman2.size(), 1);
+    BOOST_CHECK(addrman2.Find(addr1) != NULL);
+
+    // Deleted entries drop out of the dirty set.
+    int nId;
+    CService addr3 = CService("250.1.1.3", 8333);
+    addrman.Create(CAddress(addr3), source, &nId);
+    addrman.Attempt(addr3);
+    addrman.Delete(nId);
+    vDirty.clear();
+    addrman.GetDirty(vDirty);
+    BOOST_CHECK_EQUAL(vDirty.size(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_getaddr)
 {
     CAddrManTest addrman;
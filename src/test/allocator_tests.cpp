@@ -4,10 +4,12 @@
 
 #include "util.h"
 
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_bitcoin.h"
 
 #include <boost/test/unit_test.hpp>
+#include <boost/unordered_map.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
 
@@ -225,4 +227,40 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     pool.free(nullptr);
 }
 
+BOOST_AUTO_TEST_CASE(poolresource_tests)
+{
+    PoolResource resource;
+    BOOST_CHECK(resource.DynamicMemoryUsage() == 0);
+
+    // A small block is served from a chunk and recycled on reallocation.
+    void *a0 = resource.Allocate(32, alignof(std::max_align_t));
+    BOOST_CHECK(a0);
+    *((uint32_t*)a0) = 0x1234;
+    BOOST_CHECK(*((uint32_t*)a0) == 0x1234);
+    size_t usage = resource.DynamicMemoryUsage();
+    BOOST_CHECK(usage > 0);
+    resource.Deallocate(a0, 32, alignof(std::max_align_t));
+    void *a1 = resource.Allocate(32, alignof(std::max_align_t));
+    BOOST_CHECK(a1 == a0);
+    resource.Deallocate(a1, 32, alignof(std::max_align_t));
+    // Chunk memory is retained for reuse, not returned to the system.
+    BOOST_CHECK(resource.DynamicMemoryUsage() == usage);
+
+    // Oversized requests fall through to operator new.
+    void *a2 = resource.Allocate(1 << 20, alignof(std::max_align_t));
+    BOOST_CHECK(a2);
+    BOOST_CHECK(resource.DynamicMemoryUsage() == usage);
+    resource.Deallocate(a2, 1 << 20, alignof(std::max_align_t));
+
+    // The allocator is usable by a node-based container.
+    PoolResource mapResource;
+    typedef boost::unordered_map<int, int, boost::hash<int>, std::equal_to<int>, PoolAllocator<std::pair<const int, int> > > PooledMap;
+    PooledMap map(0, boost::hash<int>(), std::equal_to<int>(), PoolAllocator<std::pair<const int, int> >(&mapResource));
+    for (int i = 0; i < 1000; i++)
+        map[i] = i;
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(map[i] == i);
+    BOOST_CHECK(mapResource.DynamicMemoryUsage() > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -62,4 +62,46 @@ BOOST_AUTO_TEST_CASE(compress_amounts)
         BOOST_CHECK(TestDecode(i));
 }
 
+static bool TestBlockDataRoundTrip(const std::vector<unsigned char>& in)
+{
+    std::vector<unsigned char> compressed = CompressBlockData(in);
+    std::vector<unsigned char> out;
+    return DecompressBlockData(compressed, out, in.size()) && out == in;
+}
+
+BOOST_AUTO_TEST_CASE(compress_block_data)
+{
+    // empty input and inputs with no dictionary hits
+    BOOST_CHECK(TestBlockDataRoundTrip({}));
+    BOOST_CHECK(TestBlockDataRoundTrip({0x42}));
+    std::vector<unsigned char> noise;
+    for (unsigned int i = 0; i < 1000; i++)
+        noise.push_back((unsigned char)(i * 0x9e + 0x37));
+    BOOST_CHECK(TestBlockDataRoundTrip(noise));
+
+    // a run longer than one literal token can carry
+    std::vector<unsigned char> longrun(10000, 0x42);
+    BOOST_CHECK(TestBlockDataRoundTrip(longrun));
+
+    // dictionary material: a P2PKH output script surrounded by entropy
+    std::vector<unsigned char> script = noise;
+    const unsigned char p2pkh[] = {0x19, 0x76, 0xa9, 0x14, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                   11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 0x88, 0xac};
+    script.insert(script.end(), p2pkh, p2pkh + sizeof(p2pkh));
+    script.insert(script.end(), noise.begin(), noise.end());
+    BOOST_CHECK(TestBlockDataRoundTrip(script));
+    BOOST_CHECK(CompressBlockData(script).size() < script.size() + 2 * (script.size() / 240 + 1));
+
+    // zero runs are covered by dictionary entries and must still round-trip
+    // when their length is not a multiple of the entry size
+    for (size_t len = 1; len <= 40; len++)
+        BOOST_CHECK(TestBlockDataRoundTrip(std::vector<unsigned char>(len, 0x00)));
+
+    // truncated and malformed compressed streams must fail, not crash
+    std::vector<unsigned char> out;
+    BOOST_CHECK(!DecompressBlockData({0x05}, out, 100));           // literal run past end
+    BOOST_CHECK(!DecompressBlockData({0xff}, out, 100));           // dictionary index out of range
+    BOOST_CHECK(!DecompressBlockData({0x00, 0x11, 0x00, 0x22}, out, 1)); // output cap exceeded
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,103 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+
+#include "random.h"
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+namespace {
+struct CheapHasher {
+    uint64_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(cuckoocache_basic)
+{
+    cuckoocache<uint256, int, CheapHasher> cache(64);
+
+    BOOST_CHECK(cache.empty());
+    BOOST_CHECK(cache.max_size() >= 64);
+
+    uint256 key = GetRandHash();
+    cache.insert(key, 7);
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+
+    int value = 0;
+    BOOST_CHECK(cache.find(key, value));
+    BOOST_CHECK_EQUAL(value, 7);
+
+    // Inserting the same key again overwrites rather than duplicating.
+    cache.insert(key, 11);
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+    BOOST_CHECK(cache.find(key, value));
+    BOOST_CHECK_EQUAL(value, 11);
+
+    // A key that was never inserted is not found.
+    BOOST_CHECK(!cache.find(GetRandHash(), value));
+
+    cache.erase(key);
+    BOOST_CHECK(cache.empty());
+    BOOST_CHECK(!cache.find(key, value));
+
+    // Erasing an absent key is a no-op.
+    cache.erase(key);
+    BOOST_CHECK(cache.empty());
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_fill)
+{
+    // Fill the cache to half its capacity; at that load everything inserted
+    // must still be retrievable, and the mapping must match a reference map.
+    cuckoocache<uint256, int, CheapHasher> cache(1024);
+    std::map<uint256, int> reference;
+    for (int i = 0; i < 512; i++) {
+        uint256 key = GetRandHash();
+        cache.insert(key, i);
+        reference[key] = i;
+    }
+    BOOST_CHECK_EQUAL(cache.size(), reference.size());
+    for (const std::pair<const uint256, int>& item : reference) {
+        int value = -1;
+        BOOST_CHECK(cache.find(item.first, value));
+        BOOST_CHECK_EQUAL(value, item.second);
+    }
+
+    cache.clear();
+    BOOST_CHECK(cache.empty());
+    int value;
+    BOOST_CHECK(!cache.find(reference.begin()->first, value));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_overfill)
+{
+    // Inserting far more elements than the cache can hold must neither grow
+    // it nor corrupt it; entries that survive must still map correctly.
+    cuckoocache<uint256, int, CheapHasher> cache(64);
+    std::map<uint256, int> reference;
+    for (int i = 0; i < 1000; i++) {
+        uint256 key = GetRandHash();
+        cache.insert(key, i);
+        reference[key] = i;
+    }
+    BOOST_CHECK(cache.size() <= cache.max_size());
+    size_t found = 0;
+    for (const std::pair<const uint256, int>& item : reference) {
+        int value = -1;
+        if (cache.find(item.first, value)) {
+            BOOST_CHECK_EQUAL(value, item.second);
+            found++;
+        }
+    }
+    BOOST_CHECK_EQUAL(found, cache.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -79,6 +79,45 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+// Test raw (pre-serialized) accessors used by chainstate snapshots
+BOOST_AUTO_TEST_CASE(dbwrapper_raw)
+{
+    {
+        path ph = temp_directory_path() / unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false);
+        CDBWrapper dbw2(ph / "copy", (1 << 20), true, false);
+
+        char key = 'k';
+        uint256 in = GetRandHash();
+        BOOST_CHECK(dbw.Write(key, in));
+
+        // Copy the sole entry into a second database via the raw accessors.
+        boost::scoped_ptr<CDBIterator> it(dbw.NewIterator());
+        it->SeekToFirst();
+        BOOST_CHECK(it->Valid());
+
+        std::vector<unsigned char> rawKey;
+        std::vector<unsigned char> rawValue;
+        it->GetKeyRaw(rawKey);
+        it->GetValueRaw(rawValue);
+        BOOST_CHECK_EQUAL(rawKey.size(), it->GetKeySize());
+        BOOST_CHECK_EQUAL(rawValue.size(), it->GetValueSize());
+
+        CDBBatch batch(dbw2);
+        batch.WriteRaw(rawKey, rawValue);
+        BOOST_CHECK(batch.SizeEstimate() > rawKey.size() + rawValue.size());
+        BOOST_CHECK(dbw2.WriteBatch(batch));
+
+        // The copy must deserialize to the original value.
+        uint256 res;
+        BOOST_CHECK(dbw2.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+
+        it->Next();
+        BOOST_CHECK(!it->Valid());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     {
@@ -181,6 +181,128 @@ BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    /* Chain of three: tx1 <- tx2 <- tx3 */
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), entry.Fee(10000LL).FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_11;
+    tx2.vin[0].prevout.hash = tx1.GetHash();
+    tx2.vin[0].prevout.n = 0;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 9 * COIN;
+    pool.addUnchecked(tx2.GetHash(), entry.Fee(20000LL).FromTx(tx2));
+
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vin.resize(1);
+    tx3.vin[0].scriptSig = CScript() << OP_11;
+    tx3.vin[0].prevout.hash = tx2.GetHash();
+    tx3.vin[0].prevout.n = 0;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 8 * COIN;
+    pool.addUnchecked(tx3.GetHash(), entry.Fee(5000LL).FromTx(tx3));
+
+    /* Independent transaction */
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(tx4.GetHash(), entry.Fee(15000LL).FromTx(tx4));
+    BOOST_CHECK_EQUAL(pool.size(), 4);
+
+    CTxMemPool::txiter it1 = pool.mapTx.find(tx1.GetHash());
+    CTxMemPool::txiter it2 = pool.mapTx.find(tx2.GetHash());
+    CTxMemPool::txiter it3 = pool.mapTx.find(tx3.GetHash());
+    CTxMemPool::txiter it4 = pool.mapTx.find(tx4.GetHash());
+
+    // Cached ancestor package state should cover each entry and everything
+    // above it in the chain:
+    BOOST_CHECK_EQUAL(it1->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(it2->GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(it3->GetCountWithAncestors(), 3);
+    BOOST_CHECK_EQUAL(it4->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(it2->GetModFeesWithAncestors(), 30000LL);
+    BOOST_CHECK_EQUAL(it3->GetModFeesWithAncestors(), 35000LL);
+    BOOST_CHECK_EQUAL(it2->GetSizeWithAncestors(), it1->GetTxSize() + it2->GetTxSize());
+    BOOST_CHECK_EQUAL(it3->GetSizeWithAncestors(),
+                      it1->GetTxSize() + it2->GetTxSize() + it3->GetTxSize());
+
+    // Parent/child links:
+    BOOST_CHECK_EQUAL(pool.GetMemPoolChildren(it1).size(), 1);
+    BOOST_CHECK_EQUAL(pool.GetMemPoolParents(it3).size(), 1);
+    BOOST_CHECK_EQUAL(pool.GetMemPoolParents(it4).size(), 0);
+    CTxMemPool::setEntries setAncestors;
+    pool.CalculateMemPoolAncestors(it3, setAncestors);
+    BOOST_CHECK_EQUAL(setAncestors.size(), 2);
+    BOOST_CHECK(setAncestors.count(it1));
+    BOOST_CHECK(setAncestors.count(it2));
+
+    // A fee delta on tx1 should propagate into its descendants' package fees:
+    pool.PrioritiseTransaction(tx1.GetHash(), tx1.GetHash().ToString(), 0, 1000LL);
+    BOOST_CHECK_EQUAL(it2->GetModFeesWithAncestors(), 31000LL);
+    BOOST_CHECK_EQUAL(it3->GetModFeesWithAncestors(), 36000LL);
+
+    // The ancestor score index must contain every entry exactly once:
+    {
+        std::set<uint256> seen;
+        for (CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator it = pool.mapTx.get<3>().begin();
+             it != pool.mapTx.get<3>().end(); ++it) {
+            BOOST_CHECK(seen.insert(it->GetTx().GetHash()).second);
+        }
+        BOOST_CHECK_EQUAL(seen.size(), 4);
+    }
+
+    // Removing the root removes the whole package and leaves tx4's state intact:
+    std::list<CTransaction> removed;
+    pool.remove(tx1, removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 3);
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+    it4 = pool.mapTx.find(tx4.GetHash());
+    BOOST_CHECK_EQUAL(it4->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(it4->GetModFeesWithAncestors(), 15000LL);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolEntryTimeIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    /* Three independent transactions entered out of time order */
+    std::vector<int64_t> vTimes = {20, 5, 10};
+    for (size_t i = 0; i < vTimes.size(); i++) {
+        CMutableTransaction tx = CMutableTransaction();
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = (i + 1) * COIN;
+        pool.addUnchecked(tx.GetHash(), entry.Fee(10000LL).Time(vTimes[i]).FromTx(tx));
+    }
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+
+    // The entry time index iterates oldest-first:
+    int64_t nPrevTime = 0;
+    int nSeen = 0;
+    for (auto it = pool.mapTx.get<4>().begin(); it != pool.mapTx.get<4>().end(); ++it) {
+        BOOST_CHECK(it->GetTime() >= nPrevTime);
+        nPrevTime = it->GetTime();
+        nSeen++;
+    }
+    BOOST_CHECK_EQUAL(nSeen, 3);
+    BOOST_CHECK_EQUAL(pool.mapTx.get<4>().begin()->GetTime(), 5);
+}
+
 BOOST_AUTO_TEST_CASE(RemoveWithoutBranchId) {
     CTxMemPool pool(CFeeRate(0));
     TestMemPoolEntryHelper entry;
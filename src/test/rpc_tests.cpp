@@ -6,6 +6,7 @@
 #include "rpc/client.h"
 
 #include "experimental_features.h"
+#include "httpserver.h"
 #include "key_io.h"
 #include "main.h"
 #include "netbase.h"
@@ -16,6 +17,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <event2/buffer.h>
+
 #include <univalue.h>
 
 using namespace std;
@@ -412,4 +415,43 @@ BOOST_AUTO_TEST_CASE(rpc_insightexplorer)
     fTimestampIndex = false;
 }
 
+static std::string StreamToString(const UniValue& value)
+{
+    struct evbuffer* buf = evbuffer_new();
+    BOOST_REQUIRE(buf != nullptr);
+    WriteJSONToBuffer(buf, value);
+    size_t size = evbuffer_get_length(buf);
+    std::string result(size, '\0');
+    evbuffer_copyout(buf, &result[0], size);
+    evbuffer_free(buf);
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_streaming_json_writer)
+{
+    // The streaming writer must produce exactly the bytes of write() + "\n"
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("null", NullUniValue);
+    obj.pushKV("string", "quote \" backslash \\ newline \n control \x01 del \x7f");
+    obj.pushKV("number", int64_t(12345678901234567LL));
+    obj.pushKV("amount", ValueFromAmount(12349999));
+    obj.pushKV("bool", true);
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        arr.push_back(i);
+        arr.push_back(obj);
+    }
+    UniValue top(UniValue::VOBJ);
+    top.pushKV("result", arr);
+    top.pushKV("empty_obj", UniValue(UniValue::VOBJ));
+    top.pushKV("empty_arr", UniValue(UniValue::VARR));
+    BOOST_CHECK_EQUAL(StreamToString(top), top.write() + "\n");
+
+    // A string large enough to force several chunked flushes
+    UniValue big(UniValue::VARR);
+    for (int i = 0; i < 100; i++)
+        big.push_back(std::string(10000, 'x') + "\"");
+    BOOST_CHECK_EQUAL(StreamToString(big), big.write() + "\n");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -34,6 +34,12 @@ BOOST_AUTO_TEST_CASE(skiplist_test)
         }
     }
 
+    for (int i=1; i<SKIPLIST_LENGTH; i++) {
+        for (size_t k=1; k <= vIndex[i].vSkip.size(); k++) {
+            BOOST_CHECK(vIndex[i].vSkip[k - 1] == &vIndex[i - (1 << k)]);
+        }
+    }
+
     for (int i=0; i < 1000; i++) {
         int from = insecure_rand() % (SKIPLIST_LENGTH - 1);
         int to = insecure_rand() % (from + 1);
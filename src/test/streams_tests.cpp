@@ -11,6 +11,34 @@
 
 BOOST_FIXTURE_TEST_SUITE(streams_tests, TestingSetup)
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    // Serialize a few values into a buffer, then deserialize them through a
+    // CSpanReader over that buffer.
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    uint32_t a = 0xdeadbeef;
+    std::string b = "span";
+    std::vector<uint8_t> c = {1, 2, 3};
+    ss << a << b << c;
+
+    std::vector<unsigned char> vch(ss.begin(), ss.end());
+    CSpanReader reader(SER_NETWORK, PROTOCOL_VERSION, vch);
+    BOOST_CHECK_EQUAL(reader.size(), vch.size());
+
+    uint32_t a2;
+    std::string b2;
+    std::vector<uint8_t> c2;
+    reader >> a2 >> b2 >> c2;
+    BOOST_CHECK_EQUAL(a, a2);
+    BOOST_CHECK_EQUAL(b, b2);
+    BOOST_CHECK(c == c2);
+    BOOST_CHECK(reader.empty());
+
+    // Reading past the end of the buffer must throw.
+    uint32_t d;
+    BOOST_CHECK_THROW(reader >> d, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(streams_buffered_file)
 {
     FILE* file = fopen("streams_test_tmp", "w+b");
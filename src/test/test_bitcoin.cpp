@@ -105,6 +105,7 @@ TestingSetup::TestingSetup(const std::string& chainName) : JoinSplitTestingSetup
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
         InitBlockIndex(chainparams);
         nScriptCheckThreads = 3;
+        InitValidationPool(nScriptCheckThreads - 1);
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
         RegisterNodeSignals(GetNodeSignals());
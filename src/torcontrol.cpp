@@ -43,6 +43,9 @@ static const std::string TOR_SAFE_CLIENTKEY = "Tor safe cookie authentication co
 static const float RECONNECT_TIMEOUT_START = 1.0;
 /** Exponential backoff configuration - growth factor */
 static const float RECONNECT_TIMEOUT_EXP = 1.5;
+/** Exponential backoff configuration - maximum timeout in seconds, so the
+ * hidden service comes back promptly even after a long Tor outage */
+static const float RECONNECT_TIMEOUT_MAX = 60.0;
 /** Maximum length for lines received on TorControlConnection.
  * tor-control-spec.txt mentions that there is explicitly no limit defined to line length,
  * this is belt-and-suspenders sanity limit to prevent memory exhaustion.
@@ -447,6 +450,8 @@ private:
     void connected_cb(TorControlConnection& conn);
     /** Callback after connection lost or failed connection attempt */
     void disconnected_cb(TorControlConnection& conn);
+    /** Arm the single-shot reconnect timer with exponential backoff */
+    void ScheduleReconnect();
 
     /** Callback for reconnect timer */
     static void reconnect_cb(evutil_socket_t fd, short what, void *arg);
@@ -463,7 +468,8 @@ TorController::TorController(struct event_base* _base, const std::string& _targe
     // Start connection attempts immediately
     if (!conn.Connect(_target, boost::bind(&TorController::connected_cb, this, _1),
          boost::bind(&TorController::disconnected_cb, this, _1) )) {
-        LogPrintf("tor: Initiating connection to Tor control port %s failed\n", _target);
+        LogPrintf("tor: Initiating connection to Tor control port %s failed, will retry\n", _target);
+        ScheduleReconnect();
     }
     // Read service private key if cached
     std::pair<bool,std::string> pkf = ReadBinaryFile(GetPrivateKeyFile());
@@ -701,21 +707,30 @@ void TorController::disconnected_cb(TorControlConnection& _conn)
 
     LogPrint("tor", "tor: Not connected to Tor control port %s, trying to reconnect\n", target);
 
-    // Single-shot timer for reconnect. Use exponential backoff.
+    ScheduleReconnect();
+}
+
+void TorController::ScheduleReconnect()
+{
+    // Single-shot timer for reconnect. Use exponential backoff, capped so the
+    // service is re-registered promptly once Tor comes back.
     struct timeval time = MillisToTimeval(int64_t(reconnect_timeout * 1000.0));
     if (reconnect_ev)
         event_add(reconnect_ev, &time);
-    reconnect_timeout *= RECONNECT_TIMEOUT_EXP;
+    reconnect_timeout = std::min(reconnect_timeout * RECONNECT_TIMEOUT_EXP, RECONNECT_TIMEOUT_MAX);
 }
 
 void TorController::Reconnect()
 {
     /* Try to reconnect and reestablish if we get booted - for example, Tor
-     * may be restarting.
+     * may be restarting. A synchronously failed connection attempt (Tor not
+     * yet listening again) does not invoke disconnected_cb, so re-arm the
+     * timer here rather than giving up for good.
      */
     if (!conn.Connect(target, boost::bind(&TorController::connected_cb, this, _1),
          boost::bind(&TorController::disconnected_cb, this, _1) )) {
-        LogPrintf("tor: Re-initiating connection to Tor control port %s failed\n", target);
+        LogPrintf("tor: Re-initiating connection to Tor control port %s failed, will retry\n", target);
+        ScheduleReconnect();
     }
 }
 
@@ -15,6 +15,8 @@
 #include <librustzcash.h>
 #include <rust/ed25519.h>
 
+#include <boost/thread.hpp>
+
 SpendDescriptionInfo::SpendDescriptionInfo(
     libzcash::SaplingExpandedSpendingKey expsk,
     libzcash::SaplingNote note,
@@ -359,17 +361,46 @@ TransactionBuilderResult TransactionBuilder::Build()
     }
 
     //
-    // Sapling spends and outputs
+    // Sapling spends and outputs, and Sprout JoinSplits
     //
 
     auto ctx = librustzcash_sapling_proving_ctx_init();
 
-    // Create Sapling SpendDescriptions
+    Ed25519SigningKey joinSplitPrivKey;
+    ed25519_generate_keypair(&joinSplitPrivKey, &mtx.joinSplitPubKey);
+
+    // The Sprout proofs depend only on the JoinSplit inputs and outputs and
+    // write only to mtx.vJoinSplit, so build them on a separate thread while
+    // this one works through the Sapling proofs below. Any exception is
+    // carried back and surfaced after the join.
+    boost::thread threadSprout;
+    std::exception_ptr sproutException;
+    if (!jsInputs.empty() || !jsOutputs.empty()) {
+        threadSprout = boost::thread([&]() {
+            try {
+                CreateJSDescriptions();
+            } catch (...) {
+                sproutException = std::current_exception();
+            }
+        });
+    }
+    auto joinSproutThread = [&]() {
+        if (threadSprout.joinable()) {
+            threadSprout.join();
+        }
+    };
+
+    // Create Sapling SpendDescriptions. The proofs must be created one at a
+    // time: librustzcash samples each proof's value commitment randomness
+    // inside the opaque proving context and derives the binding signature
+    // from the context's accumulated state, so the context can neither be
+    // shared across threads nor split into per-thread instances.
     for (auto spend : spends) {
         auto cm = spend.note.cmu();
         auto nf = spend.note.nullifier(
             spend.expsk.full_viewing_key(), spend.witness.position());
         if (!cm || !nf) {
+            joinSproutThread();
             librustzcash_sapling_proving_ctx_free(ctx);
             return TransactionBuilderResult("Spend is invalid");
         }
@@ -393,6 +424,7 @@ TransactionBuilderResult TransactionBuilder::Build()
                 sdesc.cv.begin(),
                 sdesc.rk.begin(),
                 sdesc.zkproof.data())) {
+            joinSproutThread();
             librustzcash_sapling_proving_ctx_free(ctx);
             return TransactionBuilderResult("Spend proof failed");
         }
@@ -406,12 +438,14 @@ TransactionBuilderResult TransactionBuilder::Build()
     for (auto output : outputs) {
         // Check this out here as well to provide better logging.
         if (!output.note.cmu()) {
+            joinSproutThread();
             librustzcash_sapling_proving_ctx_free(ctx);
             return TransactionBuilderResult("Output is invalid");
         }
 
         auto odesc = output.Build(ctx);
         if (!odesc) {
+            joinSproutThread();
             librustzcash_sapling_proving_ctx_free(ctx);
             return TransactionBuilderResult("Failed to create output description");
         }
@@ -419,24 +453,18 @@ TransactionBuilderResult TransactionBuilder::Build()
         mtx.vShieldedOutput.push_back(odesc.value());
     }
 
-    //
-    // Sprout JoinSplits
-    //
-
-    Ed25519SigningKey joinSplitPrivKey;
-    ed25519_generate_keypair(&joinSplitPrivKey, &mtx.joinSplitPubKey);
-
-    // Create Sprout JSDescriptions
-    if (!jsInputs.empty() || !jsOutputs.empty()) {
+    // The JoinSplits must be in place before the signature hash below covers
+    // them, so collect the Sprout thread here and surface any failure the
+    // same way the synchronous path did.
+    joinSproutThread();
+    if (sproutException) {
+        librustzcash_sapling_proving_ctx_free(ctx);
         try {
-            CreateJSDescriptions();
-        } catch (JSDescException e) {
-            librustzcash_sapling_proving_ctx_free(ctx);
+            std::rethrow_exception(sproutException);
+        } catch (JSDescException& e) {
             return TransactionBuilderResult(e.what());
-        } catch (std::runtime_error e) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            throw e;
         }
+        // std::runtime_error (and anything else) propagates to the caller.
     }
 
     //
@@ -12,6 +12,7 @@
 #include "chain.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,6 +25,7 @@ class CBlockIndex;
 // START insightexplorer
 struct CAddressUnspentKey;
 struct CAddressUnspentValue;
+struct CAddressBalanceValue;
 struct CAddressIndexKey;
 struct CAddressIndexIteratorKey;
 struct CAddressIndexIteratorHeightKey;
@@ -43,11 +45,31 @@ class uint256;
 
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 450;
+//! -dbbatchsize default (bytes)
+static const int64_t nDefaultDbBatchSize = 16 << 20;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
 
+//! Version of the chainstate snapshot format written by CCoinsViewDB::WriteSnapshot()
+static const uint32_t CHAINSTATE_SNAPSHOT_VERSION = 1;
+
+/** Metadata at the start of a chainstate snapshot file */
+struct CChainstateSnapshotHeader
+{
+    uint32_t nVersion;
+    uint256 hashBestBlock;
+    int32_t nHeight;
+
+    CChainstateSnapshotHeader() : nVersion(0), nHeight(0) {}
+};
+
+/** Read a snapshot file end to end, checking the network magic, format
+ *  version, and hash commitment without touching the database. On success
+ *  the file's metadata is returned in header. */
+bool VerifyChainstateSnapshot(CAutoFile& filein, CChainstateSnapshotHeader& header, std::string& strError);
+
 struct CDiskTxPos : public CDiskBlockPos
 {
     unsigned int nTxOffset; // after header
@@ -74,6 +96,27 @@ struct CDiskTxPos : public CDiskBlockPos
 };
 
 /** CCoinsView backed by the coin database (chainstate/) */
+/** A consistent, read-only view of the coins database as last flushed to
+ *  disk. Reads take no locks and do not contend with validation; the data is
+ *  stale by whatever has not yet been flushed from the in-memory cache. */
+class CCoinsViewDBSnapshot
+{
+private:
+    friend class CCoinsViewDB;
+
+    std::unique_ptr<CDBSnapshot> snapshot;
+
+    CCoinsViewDBSnapshot(std::unique_ptr<CDBSnapshot> snapshotIn) : snapshot(std::move(snapshotIn)) {}
+
+public:
+    bool GetCoins(const uint256 &txid, CCoins &coins) const;
+    uint256 GetBestBlock() const;
+    //! Non-empty when the snapshot caught a multi-batch flush mid-write and
+    //! the coin state is between blocks; callers should then fall back to
+    //! the locked view.
+    std::vector<uint256> GetHeadBlocks() const;
+};
+
 class CCoinsViewDB : public CCoinsView
 {
 protected:
@@ -82,13 +125,22 @@ protected:
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
+    //! Fetch a LevelDB property of the underlying database (see CDBWrapper::GetProperty).
+    bool GetDbProperty(const std::string& strProperty, std::string& strValue) const
+    {
+        return db.GetProperty(strProperty, strValue);
+    }
+
     bool GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const;
     bool GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const;
     bool GetOrchardAnchorAt(const uint256 &rt, OrchardMerkleTree &tree) const;
     bool GetNullifier(const uint256 &nf, ShieldedType type) const;
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    void PrefetchCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
+    std::vector<uint256> GetHeadBlocks() const;
+    std::shared_ptr<const CCoinsViewDBSnapshot> GetSnapshot() const;
     uint256 GetBestAnchor(ShieldedType type) const;
     HistoryIndex GetHistoryLength(uint32_t epochId) const;
     HistoryNode GetHistoryAt(uint32_t epochId, HistoryIndex index) const;
@@ -106,6 +158,8 @@ public:
                     CNullifiersMap &mapOrchardNullifiers,
                     CHistoryCacheMap &historyCacheMap);
     bool GetStats(CCoinsStats &stats) const;
+    bool WriteSnapshot(CAutoFile &fileout) const;
+    bool LoadSnapshot(CAutoFile &filein);
 };
 
 /** Access to the block database (blocks/index/) */
@@ -118,20 +172,31 @@ private:
     void operator=(const CBlockTreeDB&);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
+    //! Variant taking snapshotted copies, for writes performed off cs_main.
+    bool WriteBatchSync(const std::vector<std::pair<int, CBlockFileInfo> >& fileInfo, int nLastFile, const std::vector<CDiskBlockIndex>& blockinfo);
     bool EraseBatchSync(const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     bool ReadReindexing(bool &fReindexing);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
+    //! Write a batch of index entries, optionally updating the progress marker in the same batch.
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect, const uint256 &hashBestBlock = uint256());
+    //! Hash of the last block whose transactions the background indexer has committed.
+    bool ReadTxIndexBestBlock(uint256 &hashBestBlock);
+    bool WriteTxIndexBestBlock(const uint256 &hashBestBlock);
+    //! Hash of the last block whose insightexplorer/lightwalletd index mutations are committed.
+    bool ReadInsightBestBlock(uint256 &hashBestBlock);
+    bool WriteInsightBestBlock(const uint256 &hashBestBlock);
 
     // START insightexplorer
     bool UpdateAddressUnspentIndex(const std::vector<CAddressUnspentDbEntry> &vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type, std::vector<CAddressUnspentDbEntry> &vect);
     bool WriteAddressIndex(const std::vector<CAddressIndexDbEntry> &vect);
     bool EraseAddressIndex(const std::vector<CAddressIndexDbEntry> &vect);
-    bool ReadAddressIndex(uint160 addressHash, int type, std::vector<CAddressIndexDbEntry> &addressIndex, int start = 0, int end = 0);
+    bool ReadAddressIndex(uint160 addressHash, int type, std::vector<CAddressIndexDbEntry> &addressIndex, int start = 0, int end = 0, size_t nMaxEntries = 0);
+    bool UpdateAddressBalances(const std::vector<CAddressIndexDbEntry> &vect, bool fDisconnect);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool UpdateSpentIndex(const std::vector<CSpentIndexDbEntry> &vect);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
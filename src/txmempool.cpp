@@ -23,25 +23,41 @@ using namespace std;
 
 CTxMemPoolEntry::CTxMemPoolEntry():
     nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0),
-    hadNoDependencies(false), spendsCoinbase(false)
+    hadNoDependencies(false), spendsCoinbase(false),
+    nCountWithAncestors(1), nSizeWithAncestors(0), nModFeesWithAncestors(0),
+    nSigOpCountWithAncestors(0)
 {
     nHeight = MEMPOOL_HEIGHT;
 }
 
-CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
+CTxMemPoolEntry::CTxMemPoolEntry(CTransactionRef _tx, const CAmount& _nFee,
                                  int64_t _nTime, double _dPriority,
                                  unsigned int _nHeight, bool poolHasNoInputsOf,
                                  bool _spendsCoinbase, unsigned int _sigOps, uint32_t _nBranchId):
-    tx(std::make_shared<CTransaction>(_tx)), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight),
+    tx(std::move(_tx)), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight),
     hadNoDependencies(poolHasNoInputsOf),
     spendsCoinbase(_spendsCoinbase), sigOpCount(_sigOps), nBranchId(_nBranchId)
 {
-    nTxSize = ::GetSerializeSize(_tx, SER_NETWORK, PROTOCOL_VERSION);
-    nModSize = _tx.CalculateModifiedSize(nTxSize);
+    nTxSize = tx->GetTotalSize();
+    nModSize = tx->CalculateModifiedSize(nTxSize);
     nUsageSize = RecursiveDynamicUsage(*tx) + memusage::DynamicUsage(tx);
     feeRate = CFeeRate(nFee, nTxSize);
 
     feeDelta = 0;
+
+    nCountWithAncestors = 1;
+    nSizeWithAncestors = nTxSize;
+    nModFeesWithAncestors = nFee;
+    nSigOpCountWithAncestors = sigOpCount;
+}
+
+CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
+                                 int64_t _nTime, double _dPriority,
+                                 unsigned int _nHeight, bool poolHasNoInputsOf,
+                                 bool _spendsCoinbase, unsigned int _sigOps, uint32_t _nBranchId):
+    CTxMemPoolEntry(MakeTransactionRef(_tx), _nFee, _nTime, _dPriority, _nHeight,
+                    poolHasNoInputsOf, _spendsCoinbase, _sigOps, _nBranchId)
+{
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -60,9 +76,21 @@ CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
 
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
 {
+    nModFeesWithAncestors += newFeeDelta - feeDelta;
     feeDelta = newFeeDelta;
 }
 
+void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount, int modifySigOps)
+{
+    nSizeWithAncestors += modifySize;
+    assert(int64_t(nSizeWithAncestors) > 0);
+    nModFeesWithAncestors += modifyFee;
+    nCountWithAncestors += modifyCount;
+    assert(int64_t(nCountWithAncestors) > 0);
+    nSigOpCountWithAncestors += modifySigOps;
+    assert(int(nSigOpCountWithAncestors) >= 0);
+}
+
 CTxMemPool::CTxMemPool(const CFeeRate& _minReasonableRelayFee) :
     nTransactionsUpdated(0)
 {
@@ -138,6 +166,9 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     for (const uint256 &orchardNullifier : tx.GetOrchardBundle().GetNullifiers()) {
         mapOrchardNullifiers[orchardNullifier] = &tx;
     }
+    if (tx.nExpiryHeight != 0) {
+        mapExpiryHeight.insert(std::make_pair(tx.nExpiryHeight, hash));
+    }
 
     // Update transaction's score for any feeDelta created by PrioritiseTransaction
     std::map<uint256, std::pair<double, CAmount> >::const_iterator pos = mapDeltas.find(hash);
@@ -148,6 +179,46 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         }
     }
 
+    // Link the new entry to its in-pool parents and children, then seed its
+    // cached ancestor package state. In-pool children can only exist when a
+    // disconnected block's transactions are re-accepted during a reorg; the
+    // cached state of every descendant then has to be recomputed, since the
+    // ancestors regained through this entry were not being counted.
+    mapLinks.insert(make_pair(newit, TxLinks()));
+    std::set<uint256> setParentTransactions;
+    for (const CTxIn& txin : tx.vin) {
+        setParentTransactions.insert(txin.prevout.hash);
+    }
+    for (const uint256 &phash : setParentTransactions) {
+        txiter pit = mapTx.find(phash);
+        if (pit != mapTx.end()) {
+            UpdateParent(newit, pit, true);
+            UpdateChild(pit, newit, true);
+        }
+    }
+    bool fHasChildren = false;
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        std::map<COutPoint, CInPoint>::iterator spendit = mapNextTx.find(COutPoint(hash, i));
+        if (spendit != mapNextTx.end()) {
+            txiter childit = mapTx.find(spendit->second.ptx->GetHash());
+            if (childit != mapTx.end()) {
+                UpdateChild(newit, childit, true);
+                UpdateParent(childit, newit, true);
+                fHasChildren = true;
+            }
+        }
+    }
+    RecalculateAncestorStateOf(newit);
+    if (fHasChildren) {
+        setEntries setDescendants;
+        CalculateDescendants(newit, setDescendants);
+        for (txiter dit : setDescendants) {
+            if (dit != newit) {
+                RecalculateAncestorStateOf(dit);
+            }
+        }
+    }
+
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
     minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
@@ -310,9 +381,19 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
             for (const uint256 &orchardNullifier : tx.GetOrchardBundle().GetNullifiers()) {
                 mapOrchardNullifiers.erase(orchardNullifier);
             }
+            if (tx.nExpiryHeight != 0) {
+                auto range = mapExpiryHeight.equal_range(tx.nExpiryHeight);
+                for (auto eit = range.first; eit != range.second; ++eit) {
+                    if (eit->second == hash) {
+                        mapExpiryHeight.erase(eit);
+                        break;
+                    }
+                }
+            }
             removed.push_back(tx);
             totalTxSize -= mapTx.find(hash)->GetTxSize();
             cachedInnerUsage -= mapTx.find(hash)->DynamicMemoryUsage();
+            UpdateForRemoveFromMempool(mapTx.find(hash));
             mapTx.erase(hash);
             nTransactionsUpdated++;
             minerPolicyEstimator->removeTx(hash);
@@ -329,6 +410,111 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
     }
 }
 
+const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
+{
+    assert(entry != mapTx.end());
+    txlinksMap::const_iterator it = mapLinks.find(entry);
+    assert(it != mapLinks.end());
+    return it->second.parents;
+}
+
+const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
+{
+    assert(entry != mapTx.end());
+    txlinksMap::const_iterator it = mapLinks.find(entry);
+    assert(it != mapLinks.end());
+    return it->second.children;
+}
+
+void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
+{
+    if (add) {
+        mapLinks[entry].parents.insert(parent);
+    } else {
+        mapLinks[entry].parents.erase(parent);
+    }
+}
+
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+{
+    if (add) {
+        mapLinks[entry].children.insert(child);
+    } else {
+        mapLinks[entry].children.erase(child);
+    }
+}
+
+void CTxMemPool::CalculateMemPoolAncestors(txiter entry, setEntries &setAncestors) const
+{
+    setEntries stage = GetMemPoolParents(entry);
+    while (!stage.empty()) {
+        txiter it = *stage.begin();
+        stage.erase(stage.begin());
+        if (setAncestors.insert(it).second) {
+            const setEntries &parents = GetMemPoolParents(it);
+            stage.insert(parents.begin(), parents.end());
+        }
+    }
+}
+
+void CTxMemPool::CalculateDescendants(txiter entry, setEntries &setDescendants) const
+{
+    setEntries stage;
+    stage.insert(entry);
+    while (!stage.empty()) {
+        txiter it = *stage.begin();
+        stage.erase(stage.begin());
+        if (setDescendants.insert(it).second) {
+            const setEntries &children = GetMemPoolChildren(it);
+            stage.insert(children.begin(), children.end());
+        }
+    }
+}
+
+void CTxMemPool::RecalculateAncestorStateOf(txiter entry)
+{
+    setEntries setAncestors;
+    CalculateMemPoolAncestors(entry, setAncestors);
+    uint64_t nCount = 1;
+    int64_t nSize = entry->GetTxSize();
+    CAmount nModFees = entry->GetModifiedFee();
+    int nSigOps = entry->GetSigOpCount();
+    for (txiter ait : setAncestors) {
+        nCount++;
+        nSize += ait->GetTxSize();
+        nModFees += ait->GetModifiedFee();
+        nSigOps += ait->GetSigOpCount();
+    }
+    mapTx.modify(entry, update_ancestor_state(
+        nSize - (int64_t)entry->GetSizeWithAncestors(),
+        nModFees - entry->GetModFeesWithAncestors(),
+        (int64_t)nCount - (int64_t)entry->GetCountWithAncestors(),
+        nSigOps - (int)entry->GetSigOpCountWithAncestors()));
+}
+
+void CTxMemPool::UpdateForRemoveFromMempool(txiter entry)
+{
+    assert(entry != mapTx.end());
+    // Everything that descends from this entry loses it (and only it) from
+    // its ancestor package: descendants keep their other ancestors because
+    // remove() is always called on whole descendant sets.
+    setEntries setDescendants;
+    CalculateDescendants(entry, setDescendants);
+    setDescendants.erase(entry);
+    for (txiter dit : setDescendants) {
+        mapTx.modify(dit, update_ancestor_state(-(int64_t)entry->GetTxSize(),
+                                                -entry->GetModifiedFee(), -1,
+                                                -(int)entry->GetSigOpCount()));
+    }
+    for (txiter pit : GetMemPoolParents(entry)) {
+        UpdateChild(pit, entry, false);
+    }
+    for (txiter cit : GetMemPoolChildren(entry)) {
+        UpdateParent(cit, entry, false);
+    }
+    mapLinks.erase(entry);
+}
+
 void CTxMemPool::removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags)
 {
     // Remove transactions spending a coinbase which are now immature and no-longer-final transactions
@@ -446,17 +632,19 @@ void CTxMemPool::removeConflicts(const CTransaction &tx, std::list<CTransaction>
     }
 }
 
-std::vector<uint256> CTxMemPool::removeExpired(unsigned int nBlockHeight)
+std::vector<uint256> CTxMemPool::_removeExpired(unsigned int nBlockHeight)
 {
-    // Remove expired txs from the mempool
-    LOCK(cs);
+    AssertLockHeld(cs);
+    // Scan only the expired prefix of the expiry index. Collect before
+    // removing: remove() erases index entries at arbitrary heights when it
+    // recursively drops descendants.
     list<CTransaction> transactionsToRemove;
-    for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++)
+    for (auto it = mapExpiryHeight.begin();
+         it != mapExpiryHeight.end() && it->first < nBlockHeight; ++it)
     {
-        const CTransaction& tx = it->GetTx();
-        if (IsExpiredTx(tx, nBlockHeight)) {
-            transactionsToRemove.push_back(tx);
-        }
+        indexed_transaction_set::const_iterator mi = mapTx.find(it->second);
+        if (mi != mapTx.end())
+            transactionsToRemove.push_back(mi->GetTx());
     }
     std::vector<uint256> ids;
     for (const CTransaction& tx : transactionsToRemove) {
@@ -468,11 +656,22 @@ std::vector<uint256> CTxMemPool::removeExpired(unsigned int nBlockHeight)
     return ids;
 }
 
+std::vector<uint256> CTxMemPool::removeExpired(unsigned int nBlockHeight)
+{
+    // Remove expired txs from the mempool
+    LOCK(cs);
+    return _removeExpired(nBlockHeight);
+}
+
 /**
- * Called when a block is connected. Removes from mempool and updates the miner fee estimator.
+ * Called when a block is connected. Removes the block's transactions, their
+ * mempool conflicts and (when pvExpiredTxIds is given) newly expired
+ * transactions in one pass under a single lock acquisition, and updates the
+ * miner fee estimator.
  */
 void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned int nBlockHeight,
-                                std::list<CTransaction>& conflicts, bool fCurrentEstimate)
+                                std::list<CTransaction>& conflicts, std::vector<uint256>* pvExpiredTxIds,
+                                bool fCurrentEstimate)
 {
     LOCK(cs);
     std::vector<CTxMemPoolEntry> entries;
@@ -491,6 +690,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
         removeConflicts(tx, conflicts);
         ClearPrioritisation(tx.GetHash());
     }
+    if (pvExpiredTxIds)
+        *pvExpiredTxIds = _removeExpired(nBlockHeight);
     // After the txs in the new block have been removed from the mempool, update policy estimates
     minerPolicyEstimator->processBlock(nBlockHeight, entries, fCurrentEstimate);
 }
@@ -519,8 +720,10 @@ void CTxMemPool::removeWithoutBranchId(uint32_t nMemPoolBranchId)
 
 void CTxMemPool::_clear()
 {
+    mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    mapExpiryHeight.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     ++nTransactionsUpdated;
@@ -556,6 +759,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
         bool fDependsWait = false;
+        setEntries setParentCheck;
         for (const CTxIn &txin : tx.vin) {
             // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
             indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
@@ -563,6 +767,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
                 const CTransaction& tx2 = it2->GetTx();
                 assert(tx2.vout.size() > txin.prevout.n && !tx2.vout[txin.prevout.n].IsNull());
                 fDependsWait = true;
+                setParentCheck.insert(it2);
             } else {
                 const CCoins* coins = pcoins->AccessCoins(txin.prevout.hash);
                 assert(coins && coins->IsAvailable(txin.prevout.n));
@@ -574,6 +779,48 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             assert(it3->second.n == i);
             i++;
         }
+        // Verify the parent links, and that the cached ancestor package
+        // state matches a recomputation from those links.
+        assert(setParentCheck == GetMemPoolParents(it));
+        setEntries setAncestors;
+        CalculateMemPoolAncestors(it, setAncestors);
+        uint64_t nCountCheck = setAncestors.size() + 1;
+        int64_t nSizeCheck = it->GetTxSize();
+        CAmount nFeesCheck = it->GetModifiedFee();
+        int nSigOpCheck = it->GetSigOpCount();
+        for (txiter ancestorIt : setAncestors) {
+            nSizeCheck += ancestorIt->GetTxSize();
+            nFeesCheck += ancestorIt->GetModifiedFee();
+            nSigOpCheck += ancestorIt->GetSigOpCount();
+        }
+        assert(it->GetCountWithAncestors() == nCountCheck);
+        assert((int64_t)it->GetSizeWithAncestors() == nSizeCheck);
+        assert(it->GetModFeesWithAncestors() == nFeesCheck);
+        assert((int)it->GetSigOpCountWithAncestors() == nSigOpCheck);
+        // Verify the child links against mapNextTx.
+        setEntries setChildrenCheck;
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            std::map<COutPoint, CInPoint>::const_iterator spendit = mapNextTx.find(COutPoint(tx.GetHash(), j));
+            if (spendit != mapNextTx.end()) {
+                txiter childit = mapTx.find(spendit->second.ptx->GetHash());
+                assert(childit != mapTx.end());
+                setChildrenCheck.insert(childit);
+            }
+        }
+        assert(setChildrenCheck == GetMemPoolChildren(it));
+
+        // Every expiring transaction must be present in the expiry index.
+        if (tx.nExpiryHeight != 0) {
+            bool fIndexed = false;
+            auto range = mapExpiryHeight.equal_range(tx.nExpiryHeight);
+            for (auto eit = range.first; eit != range.second; ++eit) {
+                if (eit->second == tx.GetHash()) {
+                    fIndexed = true;
+                    break;
+                }
+            }
+            assert(fIndexed);
+        }
 
         // The SaltedTxidHasher is fine to use here; it salts the map keys automatically
         // with randomness generated on construction.
@@ -745,7 +992,7 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
-std::shared_ptr<const CTransaction> CTxMemPool::get(const uint256& hash) const
+CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
     indexed_transaction_set::const_iterator i = mapTx.find(hash);
@@ -768,12 +1015,24 @@ CFeeRate CTxMemPool::estimateFee(int nBlocks) const
     LOCK(cs);
     return minerPolicyEstimator->estimateFee(nBlocks);
 }
+CFeeRate CTxMemPool::estimateSmartFee(int nBlocks, int *answerFoundAtBlocks) const
+{
+    LOCK(cs);
+    return minerPolicyEstimator->estimateSmartFee(nBlocks, answerFoundAtBlocks);
+}
+
 double CTxMemPool::estimatePriority(int nBlocks) const
 {
     LOCK(cs);
     return minerPolicyEstimator->estimatePriority(nBlocks);
 }
 
+double CTxMemPool::estimateSmartPriority(int nBlocks, int *answerFoundAtBlocks) const
+{
+    LOCK(cs);
+    return minerPolicyEstimator->estimateSmartPriority(nBlocks, answerFoundAtBlocks);
+}
+
 bool
 CTxMemPool::WriteFeeEstimates(CAutoFile& fileout) const
 {
@@ -819,6 +1078,18 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const std::string str
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(deltas.second));
+            // The delta changes this entry's modified fee, and with it the
+            // cached ancestor fees of everything that descends from it.
+            setEntries setDescendants;
+            CalculateDescendants(it, setDescendants);
+            setDescendants.erase(it);
+            for (txiter dit : setDescendants) {
+                mapTx.modify(dit, update_ancestor_state(0, nFeeDelta, 0, 0));
+            }
+            // The index has already re-sorted the affected package; bump the
+            // update counter so cached block templates and the internal miner
+            // notice the change without waiting for new transactions.
+            nTransactionsUpdated++;
         }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
@@ -919,13 +1190,16 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
 
     size_t total = 0;
 
-    // Estimate the overhead of mapTx to be 9 pointers + an allocation, as no exact formula for
+    // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for
     // boost::multi_index_contained is implemented.
-    total += memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 9 * sizeof(void*)) * mapTx.size();
+    total += memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size();
 
     // Two metadata maps inherited from Bitcoin Core
     total += memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas);
 
+    // In-pool ancestor/descendant links
+    total += memusage::DynamicUsage(mapLinks);
+
     // Saves iterating over the full map
     total += cachedInnerUsage;
 
@@ -46,7 +46,7 @@ static const unsigned int MEMPOOL_HEIGHT = 0x7FFFFFFF;
 class CTxMemPoolEntry
 {
 private:
-    std::shared_ptr<const CTransaction> tx;
+    CTransactionRef tx;
     CAmount nFee;              //!< Cached to avoid expensive parent-transaction lookups
     size_t nTxSize;            //!< ... and avoid recomputing tx size
     size_t nModSize;           //!< ... and modified size for priority
@@ -61,7 +61,19 @@ private:
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     uint32_t nBranchId;        //!< Branch ID this transaction is known to commit to, cached for efficiency
 
+    // Cached state of this transaction together with all of its unconfirmed
+    // ancestors, maintained incrementally by CTxMemPool as entries enter and
+    // leave the pool. Used for package-ordered block template assembly.
+    uint64_t nCountWithAncestors;      //!< number of in-mempool ancestor transactions (including this one)
+    uint64_t nSizeWithAncestors;       //!< ... and their total size
+    CAmount nModFeesWithAncestors;     //!< ... and their total modified (fee delta adjusted) fees
+    unsigned int nSigOpCountWithAncestors; //!< ... and their total sigop count
+
 public:
+    CTxMemPoolEntry(CTransactionRef _tx, const CAmount& _nFee,
+                    int64_t _nTime, double _dPriority, unsigned int _nHeight,
+                    bool poolHasNoInputsOf, bool spendsCoinbase,
+                    unsigned int nSigOps, uint32_t nBranchId);
     CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
                     int64_t _nTime, double _dPriority, unsigned int _nHeight,
                     bool poolHasNoInputsOf, bool spendsCoinbase,
@@ -70,7 +82,7 @@ public:
     CTxMemPoolEntry(const CTxMemPoolEntry& other);
 
     const CTransaction& GetTx() const { return *this->tx; }
-    std::shared_ptr<const CTransaction> GetSharedTx() const { return this->tx; }
+    CTransactionRef GetSharedTx() const { return this->tx; }
     double GetPriority(unsigned int currentHeight) const;
     const CAmount& GetFee() const { return nFee; }
     CFeeRate GetFeeRate() const { return feeRate; }
@@ -82,8 +94,16 @@ public:
     int64_t GetModifiedFee() const { return nFee + feeDelta; }
     size_t DynamicMemoryUsage() const { return nUsageSize; }
 
-    // Updates the fee delta used for mining priority score
+    // Updates the fee delta used for mining priority score, and the
+    // cached ancestor package fees that include it
     void UpdateFeeDelta(int64_t feeDelta);
+    // Adjusts the cached ancestor package state
+    void UpdateAncestorState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount, int modifySigOps);
+
+    uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
+    unsigned int GetSigOpCountWithAncestors() const { return nSigOpCountWithAncestors; }
 
     bool GetSpendsCoinbase() const { return spendsCoinbase; }
     uint32_t GetValidatedBranchId() const { return nBranchId; }
@@ -99,6 +119,21 @@ private:
     int64_t feeDelta;
 };
 
+struct update_ancestor_state
+{
+    update_ancestor_state(int64_t _modifySize, CAmount _modifyFee, int64_t _modifyCount, int _modifySigOps) :
+        modifySize(_modifySize), modifyFee(_modifyFee), modifyCount(_modifyCount), modifySigOps(_modifySigOps)
+    { }
+
+    void operator() (CTxMemPoolEntry &e) { e.UpdateAncestorState(modifySize, modifyFee, modifyCount, modifySigOps); }
+
+private:
+    int64_t modifySize;
+    CAmount modifyFee;
+    int64_t modifyCount;
+    int modifySigOps;
+};
+
 // extracts a TxMemPoolEntry's transaction hash
 struct mempoolentry_txid
 {
@@ -138,6 +173,38 @@ public:
     }
 };
 
+/** \class CompareTxMemPoolEntryByAncestorFee
+ *
+ *  Sort by ancestor package score ((modified fees with ancestors) /
+ *  (size with ancestors)) in descending order.
+ */
+class CompareTxMemPoolEntryByAncestorFee
+{
+public:
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        double f1 = (double)a.GetModFeesWithAncestors() * b.GetSizeWithAncestors();
+        double f2 = (double)b.GetModFeesWithAncestors() * a.GetSizeWithAncestors();
+        if (f1 == f2) {
+            return b.GetTx().GetHash() < a.GetTx().GetHash();
+        }
+        return f1 > f2;
+    }
+};
+
+/** \class CompareTxMemPoolEntryByEntryTime
+ *
+ *  Sort by time of entry into the mempool, oldest first.
+ */
+class CompareTxMemPoolEntryByEntryTime
+{
+public:
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        return a.GetTime() < b.GetTime();
+    }
+};
+
 class CBlockPolicyEstimator;
 
 /** An inpoint - a combination of a transaction and an index n into its vin */
@@ -160,7 +227,7 @@ public:
 struct TxMempoolInfo
 {
     /** The transaction itself */
-    std::shared_ptr<const CTransaction> tx;
+    CTransactionRef tx;
 
     /** Time the transaction entered the mempool. */
     int64_t nTime;
@@ -181,11 +248,17 @@ struct TxMempoolInfo
  *
  * CTxMemPool::mapTx, and CTxMemPoolEntry bookkeeping:
  *
- * mapTx is a boost::multi_index that sorts the mempool on 3 criteria:
+ * mapTx is a boost::multi_index that sorts the mempool on 4 criteria:
  * - transaction hash
  * - feerate
  * - mining score (feerate modified by any fee deltas from PrioritiseTransaction)
+ * - ancestor package score (modified feerate of the transaction together with
+ *   all of its unconfirmed ancestors)
  *
+ * The ancestor package state cached in each CTxMemPoolEntry is kept up to
+ * date incrementally as entries are added and removed, so block template
+ * assembly can consume the ancestor-score index directly instead of
+ * re-resolving dependencies on every call.
  */
 class CTxMemPool
 {
@@ -204,11 +277,19 @@ private:
     std::map<uint256, const CTransaction*> mapSproutNullifiers;
     std::map<uint256, const CTransaction*> mapSaplingNullifiers;
     std::map<uint256, const CTransaction*> mapOrchardNullifiers;
+    //! Transactions with a nonzero nExpiryHeight, ordered by that height, so
+    //! the post-block expiry sweep scans only the expired prefix instead of
+    //! walking the whole pool.
+    std::multimap<uint32_t, uint256> mapExpiryHeight;
     RecentlyEvictedList* recentlyEvicted = new RecentlyEvictedList(DEFAULT_MEMPOOL_EVICTION_MEMORY_MINUTES * 60);
     WeightedTxTree* weightedTxTree = new WeightedTxTree(DEFAULT_MEMPOOL_TOTAL_COST_LIMIT);
 
     void checkNullifiers(ShieldedType type) const;
 
+    //! Remove every transaction whose expiry height is below nBlockHeight,
+    //! and their descendants; cs must already be held. Returns their txids.
+    std::vector<uint256> _removeExpired(unsigned int nBlockHeight);
+
     CFeeRate minReasonableRelayFee;
 
 public:
@@ -226,6 +307,16 @@ public:
             boost::multi_index::ordered_unique<
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByScore
+            >,
+            // sorted by ancestor package score (for block template assembly)
+            boost::multi_index::ordered_unique<
+                boost::multi_index::identity<CTxMemPoolEntry>,
+                CompareTxMemPoolEntryByAncestorFee
+            >,
+            // sorted by entry time
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::identity<CTxMemPoolEntry>,
+                CompareTxMemPoolEntryByEntryTime
             >
         >
     > indexed_transaction_set;
@@ -233,8 +324,39 @@ public:
     mutable CCriticalSection cs;
     indexed_transaction_set mapTx;
     typedef indexed_transaction_set::nth_index<0>::type::iterator txiter;
+    struct CompareIteratorByHash {
+        bool operator()(const txiter &a, const txiter &b) const {
+            return a->GetTx().GetHash() < b->GetTx().GetHash();
+        }
+    };
+    typedef std::set<txiter, CompareIteratorByHash> setEntries;
+
+    const setEntries & GetMemPoolParents(txiter entry) const;
+    const setEntries & GetMemPoolChildren(txiter entry) const;
+
+    /** Collect all in-mempool ancestors of an entry (not including the entry
+     *  itself) by walking the cached parent links. */
+    void CalculateMemPoolAncestors(txiter entry, setEntries& setAncestors) const;
+    /** Collect all in-mempool descendants of an entry (including the entry
+     *  itself) by walking the cached child links. */
+    void CalculateDescendants(txiter entry, setEntries& setDescendants) const;
 
 private:
+    struct TxLinks {
+        setEntries parents;
+        setEntries children;
+    };
+    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
+    txlinksMap mapLinks;
+
+    void UpdateParent(txiter entry, txiter parent, bool add);
+    void UpdateChild(txiter entry, txiter child, bool add);
+    /** Recompute an entry's cached ancestor package state from its in-pool
+     *  parents. */
+    void RecalculateAncestorStateOf(txiter entry);
+    /** Subtract an entry that is about to be erased from the cached ancestor
+     *  state of its remaining descendants, and drop its links. */
+    void UpdateForRemoveFromMempool(txiter entry);
     // insightexplorer
     std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> mapAddress;
     std::map<uint256, std::vector<CMempoolAddressDeltaKey> > mapAddressInserted;
@@ -283,7 +405,8 @@ public:
     void removeConflicts(const CTransaction &tx, std::list<CTransaction>& removed);
     std::vector<uint256> removeExpired(unsigned int nBlockHeight);
     void removeForBlock(const std::vector<CTransaction>& vtx, unsigned int nBlockHeight,
-                        std::list<CTransaction>& conflicts, bool fCurrentEstimate = true);
+                        std::list<CTransaction>& conflicts, std::vector<uint256>* pvExpiredTxIds = nullptr,
+                        bool fCurrentEstimate = true);
     void removeWithoutBranchId(uint32_t nMemPoolBranchId);
     void clear();
     void _clear(); // unlocked
@@ -327,16 +450,24 @@ public:
         return (mapTx.count(hash) != 0);
     }
 
-    std::shared_ptr<const CTransaction> get(const uint256& hash) const;
+    CTransactionRef get(const uint256& hash) const;
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
+    /** Estimate fee rate needed to get into the next nBlocks, sliding to a
+     *  higher target when the data cannot answer at nBlocks. */
+    CFeeRate estimateSmartFee(int nBlocks, int *answerFoundAtBlocks = NULL) const;
+
     /** Estimate priority needed to get into the next nBlocks */
     double estimatePriority(int nBlocks) const;
 
+    /** Estimate priority needed to get into the next nBlocks, sliding to a
+     *  higher target when the data cannot answer at nBlocks. */
+    double estimateSmartPriority(int nBlocks, int *answerFoundAtBlocks = NULL) const;
+
     /** Write/Read estimates to disk */
     bool WriteFeeEstimates(CAutoFile& fileout) const;
     bool ReadFeeEstimates(CAutoFile& filein);
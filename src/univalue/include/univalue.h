@@ -25,6 +25,10 @@ public:
         typ = initialType;
         val = initialStr;
     }
+    UniValue(UniValue::VType initialType, std::string&& initialStr) {
+        typ = initialType;
+        val = std::move(initialStr);
+    }
     UniValue(uint64_t val_) {
         setInt(val_);
     }
@@ -43,6 +47,9 @@ public:
     UniValue(const std::string& val_) {
         setStr(val_);
     }
+    UniValue(std::string&& val_) {
+        setStr(std::move(val_));
+    }
     UniValue(const char *val_) {
         std::string s(val_);
         setStr(s);
@@ -58,6 +65,7 @@ public:
     bool setInt(int val_) { return setInt((int64_t)val_); }
     bool setFloat(double val);
     bool setStr(const std::string& val);
+    bool setStr(std::string&& val);
     bool setArray();
     bool setObject();
 
@@ -67,6 +75,14 @@ public:
 
     size_t size() const { return values.size(); }
 
+    //! Reserve space for n elements (and, for objects, n keys) ahead of a
+    //! sequence of push_back/pushKV calls.
+    void reserve(size_t n) {
+        if (typ == VOBJ)
+            keys.reserve(n);
+        values.reserve(n);
+    }
+
     bool getBool() const { return isTrue(); }
     void getObjMap(std::map<std::string,UniValue>& kv) const;
     bool checkObject(const std::map<std::string,UniValue::VType>& memberTypes) const;
@@ -84,10 +100,15 @@ public:
     bool isObject() const { return (typ == VOBJ); }
 
     bool push_back(const UniValue& val);
+    bool push_back(UniValue&& val);
     bool push_back(const std::string& val_) {
         UniValue tmpVal(VSTR, val_);
         return push_back(tmpVal);
     }
+    bool push_back(std::string&& val_) {
+        UniValue tmpVal(VSTR, std::move(val_));
+        return push_back(std::move(tmpVal));
+    }
     bool push_back(const char *val_) {
         std::string s(val_);
         return push_back(s);
@@ -115,11 +136,17 @@ public:
     bool push_backV(const std::vector<UniValue>& vec);
 
     void _pushKV(const std::string& key, const UniValue& val);
+    void _pushKV(const std::string& key, UniValue&& val);
     bool pushKV(const std::string& key, const UniValue& val);
+    bool pushKV(const std::string& key, UniValue&& val);
     bool pushKV(const std::string& key, const std::string& val_) {
         UniValue tmpVal(VSTR, val_);
         return pushKV(key, tmpVal);
     }
+    bool pushKV(const std::string& key, std::string&& val_) {
+        UniValue tmpVal(VSTR, std::move(val_));
+        return pushKV(key, std::move(tmpVal));
+    }
     bool pushKV(const std::string& key, const char *val_) {
         std::string _val(val_);
         return pushKV(key, _val);
@@ -54,22 +54,45 @@ bool UniValue::setNumStr(const std::string& val_)
     return true;
 }
 
+// Integers are always valid JSON numbers, so they are formatted directly
+// instead of round-tripping through an ostringstream and re-tokenizing the
+// result with getJsonToken().
 bool UniValue::setInt(uint64_t val_)
 {
-    std::ostringstream oss;
-
-    oss << val_;
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do {
+        *--p = '0' + (val_ % 10);
+        val_ /= 10;
+    } while (val_);
 
-    return setNumStr(oss.str());
+    clear();
+    typ = VNUM;
+    val.assign(p, end);
+    return true;
 }
 
 bool UniValue::setInt(int64_t val_)
 {
-    std::ostringstream oss;
-
-    oss << val_;
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    // Negate via the unsigned representation so that INT64_MIN is handled.
+    uint64_t u = (uint64_t)val_;
+    if (val_ < 0)
+        u = 0 - u;
+    do {
+        *--p = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+    if (val_ < 0)
+        *--p = '-';
 
-    return setNumStr(oss.str());
+    clear();
+    typ = VNUM;
+    val.assign(p, end);
+    return true;
 }
 
 bool UniValue::setFloat(double val_)
@@ -91,6 +114,14 @@ bool UniValue::setStr(const std::string& val_)
     return true;
 }
 
+bool UniValue::setStr(std::string&& val_)
+{
+    clear();
+    typ = VSTR;
+    val = std::move(val_);
+    return true;
+}
+
 bool UniValue::setArray()
 {
     clear();
@@ -114,6 +145,15 @@ bool UniValue::push_back(const UniValue& val_)
     return true;
 }
 
+bool UniValue::push_back(UniValue&& val_)
+{
+    if (typ != VARR)
+        return false;
+
+    values.push_back(std::move(val_));
+    return true;
+}
+
 bool UniValue::push_backV(const std::vector<UniValue>& vec)
 {
     if (typ != VARR)
@@ -130,6 +170,12 @@ void UniValue::_pushKV(const std::string& key, const UniValue& val_)
     values.push_back(val_);
 }
 
+void UniValue::_pushKV(const std::string& key, UniValue&& val_)
+{
+    keys.push_back(key);
+    values.push_back(std::move(val_));
+}
+
 bool UniValue::pushKV(const std::string& key, const UniValue& val_)
 {
     if (typ != VOBJ)
@@ -143,6 +189,19 @@ bool UniValue::pushKV(const std::string& key, const UniValue& val_)
     return true;
 }
 
+bool UniValue::pushKV(const std::string& key, UniValue&& val_)
+{
+    if (typ != VOBJ)
+        return false;
+
+    size_t idx;
+    if (findKey(key, idx))
+        values[idx] = std::move(val_);
+    else
+        _pushKV(key, std::move(val_));
+    return true;
+}
+
 bool UniValue::pushKVs(const UniValue& obj)
 {
     if (typ != VOBJ || obj.typ != VOBJ)
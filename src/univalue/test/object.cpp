@@ -405,6 +405,41 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK(!v.read("{} 42"));
 }
 
+BOOST_AUTO_TEST_CASE(univalue_move)
+{
+    UniValue v;
+    BOOST_CHECK(v.setInt((int64_t)-9223372036854775807LL - 1));
+    BOOST_CHECK_EQUAL(v.getValStr(), "-9223372036854775808");
+    BOOST_CHECK(v.setInt((uint64_t)18446744073709551615ULL));
+    BOOST_CHECK_EQUAL(v.getValStr(), "18446744073709551615");
+    BOOST_CHECK(v.setInt((int64_t)0));
+    BOOST_CHECK_EQUAL(v.getValStr(), "0");
+
+    std::string s("movable");
+    UniValue mv(std::move(s));
+    BOOST_CHECK(mv.isStr());
+    BOOST_CHECK_EQUAL(mv.getValStr(), "movable");
+
+    UniValue arr(UniValue::VARR);
+    arr.reserve(2);
+    BOOST_CHECK(arr.push_back(std::move(mv)));
+    BOOST_CHECK(arr.push_back(std::string("tail")));
+    BOOST_CHECK_EQUAL(arr.size(), 2);
+    BOOST_CHECK_EQUAL(arr[0].getValStr(), "movable");
+    BOOST_CHECK_EQUAL(arr[1].getValStr(), "tail");
+
+    UniValue obj(UniValue::VOBJ);
+    obj.reserve(2);
+    BOOST_CHECK(obj.pushKV("arr", std::move(arr)));
+    BOOST_CHECK(obj.pushKV("str", std::string("value")));
+    BOOST_CHECK_EQUAL(obj["arr"].size(), 2);
+    BOOST_CHECK_EQUAL(obj["str"].getValStr(), "value");
+    // pushKV with an existing key replaces the value, moved or not.
+    BOOST_CHECK(obj.pushKV("str", std::string("replaced")));
+    BOOST_CHECK_EQUAL(obj.size(), 2);
+    BOOST_CHECK_EQUAL(obj["str"].getValStr(), "replaced");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 int main (int argc, char *argv[])
@@ -415,6 +450,7 @@ int main (int argc, char *argv[])
     univalue_array();
     univalue_object();
     univalue_readwrite();
+    univalue_move();
     return 0;
 }
 
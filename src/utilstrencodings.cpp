@@ -13,6 +13,10 @@
 #include <iomanip>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 static const string CHARS_ALPHA_NUM = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -99,12 +103,78 @@ bool IsHex(const string& str)
     return (str.size() > 0) && (str.size()%2 == 0);
 }
 
+void HexEncode(const unsigned char* pbegin, size_t len, char* pout)
+{
+    static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Split each of 16 input bytes into its two nibbles, map the nibbles to
+    // ASCII ('0'+n, or 'a'+n-10 for n > 9) and interleave high/low back into
+    // 32 output characters.
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pbegin + i));
+        __m128i mask = _mm_set1_epi8(0x0F);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        __m128i nine = _mm_set1_epi8(9);
+        __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+        __m128i zero = _mm_set1_epi8('0');
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), gap));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), gap));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pout + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pout + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for (; i < len; i++) {
+        pout[2 * i] = hexmap[pbegin[i] >> 4];
+        pout[2 * i + 1] = hexmap[pbegin[i] & 15];
+    }
+}
+
+#if defined(__SSE2__)
+/** Decode 16 hex characters at psz into 8 bytes appended to vch. Returns
+ * false (appending nothing) if any of the 16 characters is not a hex digit,
+ * leaving the caller's scalar loop to deal with whitespace or the end of the
+ * string. */
+static bool DecodeHex16(const char* psz, vector<unsigned char>& vch)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(psz));
+    __m128i lc = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), v));
+    __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lc));
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF)
+        return false;
+    __m128i vals = _mm_or_si128(
+        _mm_and_si128(is_digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+        _mm_and_si128(is_alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+    // Each 16-bit lane now holds [high nibble, low nibble]; fold the pair
+    // into the lane's low byte and pack the eight low bytes together.
+    __m128i folded = _mm_or_si128(_mm_slli_epi16(vals, 4), _mm_srli_epi16(vals, 8));
+    folded = _mm_and_si128(folded, _mm_set1_epi16(0x00FF));
+    __m128i packed = _mm_packus_epi16(folded, _mm_setzero_si128());
+    size_t nOld = vch.size();
+    vch.resize(nOld + 8);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(vch.data() + nOld), packed);
+    return true;
+}
+#endif
+
 vector<unsigned char> ParseHex(const char* psz)
 {
     // convert hex dump to vector
+    size_t len = strlen(psz);
+    const char* pend = psz + len;
     vector<unsigned char> vch;
+    vch.reserve(len / 2);
     while (true)
     {
+#if defined(__SSE2__)
+        while (pend - psz >= 16 && DecodeHex16(psz, vch))
+            psz += 16;
+#endif
         while (isspace(*psz))
             psz++;
         signed char c = HexDigit(*psz++);
@@ -414,6 +484,76 @@ static inline bool ProcessMantissaDigit(char ch, int64_t &mantissa, int &mantiss
     return true;
 }
 
+bool ParseCommandLine(std::vector<std::string> &args, const std::string &strCommand)
+{
+    enum CmdParseState
+    {
+        STATE_EATING_SPACES,
+        STATE_ARGUMENT,
+        STATE_SINGLEQUOTED,
+        STATE_DOUBLEQUOTED,
+        STATE_ESCAPE_OUTER,
+        STATE_ESCAPE_DOUBLEQUOTED
+    } state = STATE_EATING_SPACES;
+    std::string curarg;
+    for (char ch : strCommand)
+    {
+        switch(state)
+        {
+        case STATE_ARGUMENT: // In or after argument
+        case STATE_EATING_SPACES: // Handle runs of whitespace
+            switch(ch)
+            {
+            case '"': state = STATE_DOUBLEQUOTED; break;
+            case '\'': state = STATE_SINGLEQUOTED; break;
+            case '\\': state = STATE_ESCAPE_OUTER; break;
+            case ' ': case '\n': case '\t':
+                if(state == STATE_ARGUMENT) // Space ends argument
+                {
+                    args.push_back(curarg);
+                    curarg.clear();
+                }
+                state = STATE_EATING_SPACES;
+                break;
+            default: curarg += ch; state = STATE_ARGUMENT;
+            }
+            break;
+        case STATE_SINGLEQUOTED: // Single-quoted string
+            switch(ch)
+            {
+            case '\'': state = STATE_ARGUMENT; break;
+            default: curarg += ch;
+            }
+            break;
+        case STATE_DOUBLEQUOTED: // Double-quoted string
+            switch(ch)
+            {
+            case '"': state = STATE_ARGUMENT; break;
+            case '\\': state = STATE_ESCAPE_DOUBLEQUOTED; break;
+            default: curarg += ch;
+            }
+            break;
+        case STATE_ESCAPE_OUTER: // '\' outside quotes
+            curarg += ch; state = STATE_ARGUMENT;
+            break;
+        case STATE_ESCAPE_DOUBLEQUOTED: // '\' in double-quoted text
+            if(ch != '"' && ch != '\\') curarg += '\\'; // keep '\' for everything but the quote and '\' itself
+            curarg += ch; state = STATE_DOUBLEQUOTED;
+            break;
+        }
+    }
+    switch(state) // final state
+    {
+    case STATE_EATING_SPACES:
+        return true;
+    case STATE_ARGUMENT:
+        args.push_back(curarg);
+        return true;
+    default: // ERROR to end in one of the other states
+        return false;
+    }
+}
+
 bool ParseFixedPoint(const std::string &val, int decimals, int64_t *amount_out)
 {
     int64_t mantissa = 0;
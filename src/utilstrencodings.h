@@ -78,13 +78,30 @@ bool ParseInt64(const std::string& str, int64_t *out);
  */
 bool ParseDouble(const std::string& str, double *out);
 
+/**
+ * Encode len bytes starting at pbegin as 2*len lowercase hex characters at
+ * pout (no terminator). Vectorized with SSE2 where available.
+ */
+void HexEncode(const unsigned char* pbegin, size_t len, char* pout);
+
 template<typename T>
 std::string HexStr(const T itbegin, const T itend, bool fSpaces=false)
 {
     std::string rv;
     static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-    rv.reserve((itend-itbegin)*3);
+    size_t len = itend - itbegin;
+    if (!fSpaces && len > 0 && sizeof(*itbegin) == 1 &&
+        (len == 1 || &itbegin[1] == &itbegin[0] + 1)) {
+        // Every byte iterator passed here (plain pointers, std::vector,
+        // prevector and CDataStream iterators) is contiguous, so the range
+        // can be encoded straight into the string's final buffer. The
+        // adjacency check keeps e.g. reverse iterators on the slow path.
+        rv.resize(len * 2);
+        HexEncode(reinterpret_cast<const unsigned char*>(&itbegin[0]), len, &rv[0]);
+        return rv;
+    }
+    rv.reserve(len*3);
     for(T it = itbegin; it < itend; ++it)
     {
         unsigned char val = (unsigned char)(*it);
@@ -109,6 +126,22 @@ inline std::string HexStr(const T& vch, bool fSpaces=false)
  */
 std::string FormatParagraph(const std::string& in, size_t width = 79, size_t indent = 0);
 
+/**
+ * Split shell command line into a list of arguments. Aims to emulate \c bash and friends.
+ *
+ * - Arguments are delimited with whitespace
+ * - Extra whitespace at the beginning and end and between arguments will be ignored
+ * - Text can be "double" or 'single' quoted
+ * - The backslash \c \ is used as escape character
+ *   - Outside quotes, any character can be escaped
+ *   - Within double quotes, only escape \c " and backslashes before a \c " or another backslash
+ *   - Within single quotes, no escaping is possible and no special interpretation takes place
+ *
+ * @param[out]   args        Parsed arguments will be appended to this list
+ * @param[in]    strCommand  Command line to split
+ */
+bool ParseCommandLine(std::vector<std::string>& args, const std::string& strCommand);
+
 /**
  * Timing-attack-resistant comparison.
  * Takes time proportional to length
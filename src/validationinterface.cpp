@@ -14,6 +14,10 @@
 #include <boost/thread.hpp>
 
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <thread>
 
 using namespace boost::placeholders;
@@ -68,6 +72,116 @@ void SyncWithWallets(const CTransaction &tx, const CBlock *pblock, const int nHe
     g_signals.SyncTransaction(tx, pblock, nHeight);
 }
 
+/** Bounded queue of deferred notification callbacks, drained by a dedicated
+ * dispatcher thread so listener work is not charged to block connection.
+ * Wallet transaction notifications already run asynchronously on
+ * ThreadNotifyWallets below; this covers the remaining fire-and-forget
+ * signals emitted from the validation hot path. */
+class CAsyncNotificationQueue
+{
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> queue;
+    bool running;
+    size_t maxDepth;
+    uint64_t nDropped;
+
+public:
+    CAsyncNotificationQueue(size_t maxDepthIn) : running(true), maxDepth(maxDepthIn), nDropped(0) {}
+
+    void Enqueue(std::function<void()> callback)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (queue.size() >= maxDepth)
+        {
+            // Keep the newest notifications; a listener that is this far
+            // behind has already missed intermediate states.
+            nDropped++;
+            LogPrintf("WARNING: notification queue full, dropping oldest notification (%d dropped so far)\n", nDropped);
+            queue.pop_front();
+        }
+        queue.push_back(std::move(callback));
+        cond.notify_one();
+    }
+
+    void Run()
+    {
+        RenameThread("koto-notifier");
+        while (true) {
+            std::function<void()> callback;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (running && queue.empty())
+                    cond.wait(lock);
+                // Drain the backlog before exiting so listeners see the
+                // final chain state at shutdown.
+                if (!running && queue.empty())
+                    break;
+                callback = std::move(queue.front());
+                queue.pop_front();
+            }
+            try {
+                callback();
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "AsyncNotificationDispatcher()");
+            } catch (...) {
+                PrintExceptionContinue(NULL, "AsyncNotificationDispatcher()");
+            }
+        }
+    }
+
+    void Interrupt()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        running = false;
+        cond.notify_all();
+    }
+};
+
+//! Generous bound; entries are only dropped if the dispatcher is wedged.
+static const size_t MAX_NOTIFICATION_QUEUE_DEPTH = 4096;
+
+static CAsyncNotificationQueue* asyncNotificationQueue = 0;
+static std::thread threadAsyncNotifier;
+
+void StartAsyncNotificationDispatcher()
+{
+    assert(!asyncNotificationQueue);
+    asyncNotificationQueue = new CAsyncNotificationQueue(MAX_NOTIFICATION_QUEUE_DEPTH);
+    threadAsyncNotifier = std::thread(&CAsyncNotificationQueue::Run, asyncNotificationQueue);
+}
+
+void StopAsyncNotificationDispatcher()
+{
+    if (!asyncNotificationQueue)
+        return;
+    asyncNotificationQueue->Interrupt();
+    threadAsyncNotifier.join();
+    delete asyncNotificationQueue;
+    asyncNotificationQueue = 0;
+}
+
+void NotifyUpdatedBlockTip(const CBlockIndex *pindexNew)
+{
+    // Block index entries are never freed, so the pointer stays valid for
+    // the dispatcher thread.
+    if (asyncNotificationQueue) {
+        asyncNotificationQueue->Enqueue([pindexNew] { g_signals.UpdatedBlockTip(pindexNew); });
+    } else {
+        g_signals.UpdatedBlockTip(pindexNew);
+    }
+}
+
+void NotifyUpdatedTransaction(const uint256 &hashTx)
+{
+    if (asyncNotificationQueue) {
+        asyncNotificationQueue->Enqueue([hashTx] { g_signals.UpdatedTransaction(hashTx); });
+    } else {
+        g_signals.UpdatedTransaction(hashTx);
+    }
+}
+
 struct CachedBlockData {
     CBlockIndex *pindex;
     std::pair<SproutMerkleTree, SaplingMerkleTree> oldTrees;
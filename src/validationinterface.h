@@ -74,6 +74,17 @@ struct CMainSignals {
 
 CMainSignals& GetMainSignals();
 
+/** Start/stop the thread that delivers queued notifications. While it runs,
+ * NotifyUpdatedBlockTip and NotifyUpdatedTransaction hand their signal off to
+ * it instead of invoking the listeners from the validation thread. */
+void StartAsyncNotificationDispatcher();
+void StopAsyncNotificationDispatcher();
+
+/** Emit UpdatedBlockTip, via the dispatcher thread when it is running. */
+void NotifyUpdatedBlockTip(const CBlockIndex *pindexNew);
+/** Emit UpdatedTransaction, via the dispatcher thread when it is running. */
+void NotifyUpdatedTransaction(const uint256 &hashTx);
+
 void ThreadNotifyWallets(CBlockIndex *pindexLastTip);
 
 #endif // BITCOIN_VALIDATIONINTERFACE_H
@@ -9,7 +9,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 170015;
+static const int PROTOCOL_VERSION = 170016;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -37,4 +37,7 @@ static const int NO_BLOOM_VERSION = 170004;
 //! - MSG_WTX type defined, which contains two 32-byte hashes.
 static const int CINV_WTX_VERSION = 170014;
 
+//! short-id-based block download starts with this version (BIP 152)
+static const int SHORT_IDS_BLOCKS_VERSION = 170016;
+
 #endif // BITCOIN_VERSION_H
@@ -3,18 +3,27 @@
 #include "core_io.h"
 #include "init.h"
 #include "rpc/protocol.h"
+#include "utiltime.h"
+#include "wallet/operationjournal.h"
 
 extern UniValue signrawtransaction(const UniValue& params, bool fHelp);
 
-UniValue SendTransaction(CTransaction& tx, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode) {
+UniValue SendTransaction(CTransaction& tx, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode, const std::string& opId) {
     UniValue o(UniValue::VOBJ);
     // Send the transaction
     if (!testmode) {
+        // Checkpoint the proven transaction so a restart between here and a
+        // completed commit resubmits it instead of redoing the proofs.
+        std::shared_ptr<OperationJournalDB> journal = OperationJournalDB::sharedInstance();
+        const std::string journalKey = tx.GetHash().ToString();
+        journal->Put(journalKey, OperationJournalRecord(opId, tx, GetTime()));
         CWalletTx wtx(pwalletMain, tx);
         if (!pwalletMain->CommitTransaction(wtx, reservekey)) {
-            // More details in debug.log
+            // More details in debug.log. The journal entry is kept so the
+            // next startup can retry the commit.
             throw JSONRPCError(RPC_WALLET_ERROR, "SendTransaction: CommitTransaction failed");
         }
+        journal->Erase(journalKey);
         o.pushKV("txid", tx.GetHash().ToString());
     } else {
         // Test mode does not send the transaction to the network.
@@ -25,7 +34,7 @@ UniValue SendTransaction(CTransaction& tx, std::optional<std::reference_wrapper<
     return o;
 }
 
-std::pair<CTransaction, UniValue> SignSendRawTransaction(UniValue obj, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode) {
+std::pair<CTransaction, UniValue> SignSendRawTransaction(UniValue obj, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode, const std::string& opId) {
     // Sign the raw transaction
     UniValue rawtxnValue = find_value(obj, "rawtxn");
     if (rawtxnValue.isNull()) {
@@ -53,7 +62,7 @@ std::pair<CTransaction, UniValue> SignSendRawTransaction(UniValue obj, std::opti
     CTransaction tx;
     stream >> tx;
 
-    UniValue sendResult = SendTransaction(tx, reservekey, testmode);
+    UniValue sendResult = SendTransaction(tx, reservekey, testmode, opId);
 
     return std::make_pair(tx, sendResult);
 }
@@ -19,8 +19,13 @@
  * 
  * If testmode is true, do not commit the transaction,
  * return {"test": 1, "txid": tx.GetHash().ToString(), "hex": EncodeHexTx(tx)}
+ *
+ * When committing, the fully proven transaction is checkpointed to the
+ * operation journal before the commit and removed afterwards, so a restart
+ * in between resubmits it instead of redoing the proving work. opId is
+ * recorded in the journal entry for operator reference and may be empty.
  */
-UniValue SendTransaction(CTransaction& tx, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode);
+UniValue SendTransaction(CTransaction& tx, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode, const std::string& opId = std::string());
 
 /**
  * Sign and send a raw transaction.
@@ -28,6 +33,6 @@ UniValue SendTransaction(CTransaction& tx, std::optional<std::reference_wrapper<
  * 
  * Returns a pair of (the parsed transaction, and the result of sending)
  */
-std::pair<CTransaction, UniValue> SignSendRawTransaction(UniValue obj, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode);
+std::pair<CTransaction, UniValue> SignSendRawTransaction(UniValue obj, std::optional<std::reference_wrapper<CReserveKey>> reservekey, bool testmode, const std::string& opId = std::string());
 
 #endif // ZCASH_WALLET_ASYNCRPCOPERATION_COMMON_H
@@ -194,13 +194,13 @@ void AsyncRPCOperation_mergetoaddress::main()
     if (success && paymentDisclosureMode && paymentDisclosureData_.size() > 0) {
         uint256 txidhash = tx_.GetHash();
         std::shared_ptr<PaymentDisclosureDB> db = PaymentDisclosureDB::sharedInstance();
-        for (PaymentDisclosureKeyInfo p : paymentDisclosureData_) {
+        for (PaymentDisclosureKeyInfo& p : paymentDisclosureData_) {
             p.first.hash = txidhash;
-            if (!db->Put(p.first, p.second)) {
-                LogPrint("paymentdisclosure", "%s: Payment Disclosure: Error writing entry to database for key %s\n", getId(), p.first.ToString());
-            } else {
-                LogPrint("paymentdisclosure", "%s: Payment Disclosure: Successfully added entry to database for key %s\n", getId(), p.first.ToString());
-            }
+        }
+        if (!db->PutBatch(paymentDisclosureData_)) {
+            LogPrint("paymentdisclosure", "%s: Payment Disclosure: Error writing %d entries to database for txid %s\n", getId(), paymentDisclosureData_.size(), txidhash.ToString());
+        } else {
+            LogPrint("paymentdisclosure", "%s: Payment Disclosure: Successfully added %d entries to database for txid %s\n", getId(), paymentDisclosureData_.size(), txidhash.ToString());
         }
     }
     // !!! Payment disclosure END
@@ -356,7 +356,7 @@ bool AsyncRPCOperation_mergetoaddress::main_impl()
         // Build the transaction
         tx_ = builder_.Build().GetTxOrThrow();
 
-        UniValue sendResult = SendTransaction(tx_, std::nullopt, testmode);
+        UniValue sendResult = SendTransaction(tx_, std::nullopt, testmode, getId());
         set_result(sendResult);
 
         return true;
@@ -376,7 +376,7 @@ bool AsyncRPCOperation_mergetoaddress::main_impl()
     if (isPureTaddrOnlyTx) {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("rawtxn", EncodeHexTx(tx_));
-        auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode);
+        auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode, getId());
         tx_ = txAndResult.first;
         set_result(txAndResult.second);
         return true;
@@ -414,7 +414,7 @@ bool AsyncRPCOperation_mergetoaddress::main_impl()
         info.vjsout.push_back(jso);
 
         UniValue obj = perform_joinsplit(info);
-        auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode);
+        auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode, getId());
         tx_ = txAndResult.first;
         set_result(txAndResult.second);
         return true;
@@ -487,6 +487,13 @@ bool AsyncRPCOperation_mergetoaddress::main_impl()
     boost::unordered_map<uint256, SproutMerkleTree, SaltedTxidHasher> intermediates;
     std::vector<uint256> previousCommitments;
 
+    // The chained JoinSplits below are inherently sequential: each step spends
+    // the change note of the previous step, whose witness is built from the
+    // previous JoinSplit's freshly generated commitments, so the proof of step
+    // N cannot be overlapped with the construction of step N+1. Each Groth16
+    // proof already fans out across all cores inside the prover, and large
+    // Sprout sweeps can run as several concurrent operations (each locks its
+    // input notes) when -rpcasyncthreads is raised.
     while (!vpubNewProcessed) {
         MergeToAddressJSInfo info;
         info.vpub_old = 0;
@@ -720,7 +727,7 @@ bool AsyncRPCOperation_mergetoaddress::main_impl()
     assert(zInputsDeque.size() == 0);
     assert(vpubNewProcessed);
 
-    auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode);
+    auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode, getId());
     tx_ = txAndResult.first;
     set_result(txAndResult.second);
     return true;
@@ -11,10 +11,20 @@
 #include "utilmoneystr.h"
 #include "wallet.h"
 
+#include <atomic>
 #include <optional>
 #include <variant>
 
 const int MIGRATION_EXPIRY_DELTA = 450;
+/** Hard bound on transactions created per migration round. The round is
+ *  normally limited by the measured proving throughput below; this cap only
+ *  bounds the pending-transaction memory on very fast machines. */
+const int MIGRATION_TXS_PER_ROUND_LIMIT = 25;
+
+/** Exponential moving average of how long one migration transaction takes to
+ *  build and prove, in microseconds. Shared across rounds (each round is a
+ *  fresh operation) so a round can budget itself from the first iteration. */
+static std::atomic<int64_t> nAvgMigrationBuildUsec{0};
 
 AsyncRPCOperation_saplingmigration::AsyncRPCOperation_saplingmigration(int targetHeight) : targetHeight_(targetHeight) {}
 
@@ -103,11 +113,22 @@ bool AsyncRPCOperation_saplingmigration::main_impl() {
     libzcash::SaplingPaymentAddress migrationDestAddress = getMigrationDestAddress(seed);
 
 
-    // Up to the limit of 5, as many transactions are sent as are needed to migrate the remaining funds
+    // As many transactions are sent as are needed to migrate the remaining
+    // funds, sized adaptively instead of the former fixed limit of 5: each
+    // builder.Build() is timed, and another transaction is only begun when
+    // the measured proving throughput says it can finish at least one block
+    // interval before the batch is committed at targetHeight_ - 1. Fast
+    // machines fill the otherwise idle window between blocks; slow machines
+    // stop before a half-proven transaction would be cancelled. The proofs
+    // themselves already fan out across all cores inside the prover, so the
+    // round builds one transaction at a time and yields the prover to any
+    // foreground z_sendmany as soon as the budget runs out.
     int numTxCreated = 0;
     CAmount amountMigrated = 0;
     std::vector<std::string> migrationTxIds;
     int noteIndex = 0;
+    const int64_t nSpacingUsec = consensusParams.PoWTargetSpacing(targetHeight_) * 1000000;
+    bool fHaveBuildBudget = true;
     CCoinsViewCache coinsView(pcoinsTip);
     do {
         CAmount amountToSend = chooseAmount(availableFunds);
@@ -147,17 +168,36 @@ bool AsyncRPCOperation_saplingmigration::main_impl() {
         // the value of the Sapling output will be 0.00001 ZEC less.
         builder.SetFee(DEFAULT_FEE);
         builder.AddSaplingOutput(ovkForShieldingFromTaddr(seed), migrationDestAddress, amountToSend - DEFAULT_FEE);
+        int64_t nBuildStartUsec = GetTimeMicros();
         CTransaction tx = builder.Build().GetTxOrThrow();
+        int64_t nBuildUsec = GetTimeMicros() - nBuildStartUsec;
+        {
+            int64_t nAvg = nAvgMigrationBuildUsec.load();
+            nAvgMigrationBuildUsec.store(nAvg == 0 ? nBuildUsec : (3 * nAvg + nBuildUsec) / 4);
+        }
         if (isCancelled()) {
             LogPrint("zrpcunsafe", "%s: Canceled. Stopping.\n", getId());
             break;
         }
         pwalletMain->AddPendingSaplingMigrationTx(tx);
-        LogPrint("zrpcunsafe", "%s: Added pending migration transaction with txid=%s\n", getId(), tx.GetHash().ToString());
+        LogPrint("zrpcunsafe", "%s: Added pending migration transaction with txid=%s (built in %.1fs)\n",
+            getId(), tx.GetHash().ToString(), nBuildUsec * 0.000001);
         ++numTxCreated;
         amountMigrated += amountToSend - DEFAULT_FEE;
         migrationTxIds.push_back(tx.GetHash().ToString());
-    } while (numTxCreated < 5 && availableFunds > CENT);
+
+        int nBlocksRemaining;
+        {
+            LOCK(cs_main);
+            nBlocksRemaining = (targetHeight_ - 1) - chainActive.Height();
+        }
+        fHaveBuildBudget = nBlocksRemaining > 1 &&
+            nAvgMigrationBuildUsec.load() <= (nBlocksRemaining - 1) * nSpacingUsec;
+        if (!fHaveBuildBudget && availableFunds > CENT) {
+            LogPrint("zrpcunsafe", "%s: Proving budget exhausted (%d blocks remaining, avg build %.1fs). Deferring remaining funds to the next round.\n",
+                getId(), nBlocksRemaining, nAvgMigrationBuildUsec.load() * 0.000001);
+        }
+    } while (numTxCreated < MIGRATION_TXS_PER_ROUND_LIMIT && availableFunds > CENT && fHaveBuildBudget);
 
     LogPrint("zrpcunsafe", "%s: Created %d transactions with total Sapling output amount=%s\n", getId(), numTxCreated, FormatMoney(amountMigrated));
     setMigrationResult(numTxCreated, amountMigrated, migrationTxIds);
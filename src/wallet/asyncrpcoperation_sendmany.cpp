@@ -170,6 +170,9 @@ void AsyncRPCOperation_sendmany::main() {
 
     stop_execution_clock();
 
+    unlock_utxos(); // clean up
+    unlock_notes(); // clean up
+
     if (success) {
         set_state(OperationStatus::SUCCESS);
     } else {
@@ -188,13 +191,13 @@ void AsyncRPCOperation_sendmany::main() {
     if (success && paymentDisclosureMode && paymentDisclosureData_.size()>0) {
         uint256 txidhash = tx_.GetHash();
         std::shared_ptr<PaymentDisclosureDB> db = PaymentDisclosureDB::sharedInstance();
-        for (PaymentDisclosureKeyInfo p : paymentDisclosureData_) {
+        for (PaymentDisclosureKeyInfo& p : paymentDisclosureData_) {
             p.first.hash = txidhash;
-            if (!db->Put(p.first, p.second)) {
-                LogPrint("paymentdisclosure", "%s: Payment Disclosure: Error writing entry to database for key %s\n", getId(), p.first.ToString());
-            } else {
-                LogPrint("paymentdisclosure", "%s: Payment Disclosure: Successfully added entry to database for key %s\n", getId(), p.first.ToString());
-            }
+        }
+        if (!db->PutBatch(paymentDisclosureData_)) {
+            LogPrint("paymentdisclosure", "%s: Payment Disclosure: Error writing %d entries to database for txid %s\n", getId(), paymentDisclosureData_.size(), txidhash.ToString());
+        } else {
+            LogPrint("paymentdisclosure", "%s: Payment Disclosure: Successfully added %d entries to database for txid %s\n", getId(), paymentDisclosureData_.size(), txidhash.ToString());
         }
     }
     // !!! Payment disclosure END
@@ -396,7 +399,7 @@ bool AsyncRPCOperation_sendmany::main_impl() {
         // Build the transaction
         tx_ = builder_.Build().GetTxOrThrow();
 
-        UniValue sendResult = SendTransaction(tx_, keyChange, testmode);
+        UniValue sendResult = SendTransaction(tx_, keyChange, testmode, getId());
         set_result(sendResult);
 
         return true;
@@ -438,7 +441,7 @@ bool AsyncRPCOperation_sendmany::main_impl() {
 
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("rawtxn", EncodeHexTx(tx_));
-        auto txAndResult = SignSendRawTransaction(obj, keyChange, testmode);
+        auto txAndResult = SignSendRawTransaction(obj, keyChange, testmode, getId());
         tx_ = txAndResult.first;
         set_result(txAndResult.second);
         return true;
@@ -547,7 +550,7 @@ bool AsyncRPCOperation_sendmany::main_impl() {
             obj = perform_joinsplit(info);
         }
 
-        auto txAndResult = SignSendRawTransaction(obj, keyChange, testmode);
+        auto txAndResult = SignSendRawTransaction(obj, keyChange, testmode, getId());
         tx_ = txAndResult.first;
         set_result(txAndResult.second);
         return true;
@@ -832,7 +835,7 @@ bool AsyncRPCOperation_sendmany::main_impl() {
     assert(zOutputsDeque.size() == 0);
     assert(vpubNewProcessed);
 
-    auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode);
+    auto txAndResult = SignSendRawTransaction(obj, std::nullopt, testmode, getId());
     tx_ = txAndResult.first;
     set_result(txAndResult.second);
     return true;
@@ -863,6 +866,10 @@ bool AsyncRPCOperation_sendmany::find_utxos(bool fAcceptCoinbase, TxValues& txVa
     // Load transparent inputs
     load_inputs(txValues);
 
+    // Keep the selection stable while this operation runs: other async
+    // operations skip locked coins when selecting theirs.
+    lock_utxos();
+
     return t_inputs_.size() > 0;
 }
 
@@ -977,6 +984,10 @@ bool AsyncRPCOperation_sendmany::find_unspent_notes() {
             return i.note.value() > j.note.value();
         });
 
+    // Keep the selection stable while this operation runs: other async
+    // operations skip locked notes when selecting theirs.
+    lock_notes();
+
     return true;
 }
 
@@ -1228,6 +1239,54 @@ std::array<unsigned char, ZC_MEMO_SIZE> AsyncRPCOperation_sendmany::get_memo_fro
     return memo;
 }
 
+/**
+ * Lock input utxos
+ */
+void AsyncRPCOperation_sendmany::lock_utxos() {
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    for (auto utxo : t_inputs_) {
+        COutPoint outpt(utxo.tx->GetHash(), utxo.i);
+        pwalletMain->LockCoin(outpt);
+    }
+}
+
+/**
+ * Unlock input utxos
+ */
+void AsyncRPCOperation_sendmany::unlock_utxos() {
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    for (auto utxo : t_inputs_) {
+        COutPoint outpt(utxo.tx->GetHash(), utxo.i);
+        pwalletMain->UnlockCoin(outpt);
+    }
+}
+
+/**
+ * Lock input notes
+ */
+void AsyncRPCOperation_sendmany::lock_notes() {
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    for (auto note : z_sprout_inputs_) {
+        pwalletMain->LockNote(note.point);
+    }
+    for (auto entry : z_sapling_inputs_) {
+        pwalletMain->LockNote(entry.op);
+    }
+}
+
+/**
+ * Unlock input notes
+ */
+void AsyncRPCOperation_sendmany::unlock_notes() {
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    for (auto note : z_sprout_inputs_) {
+        pwalletMain->UnlockNote(note.point);
+    }
+    for (auto entry : z_sapling_inputs_) {
+        pwalletMain->UnlockNote(entry.op);
+    }
+}
+
 /**
  * Override getStatus() to append the operation's input parameters to the default status object.
  */
@@ -130,6 +130,14 @@ private:
     std::array<unsigned char, ZC_MEMO_SIZE> get_memo_from_hex_string(std::string s);
     bool main_impl();
 
+    // Lock the selected inputs for the lifetime of the operation, so that
+    // concurrently executing async operations cannot select the same coins
+    // or notes.
+    void lock_utxos();
+    void unlock_utxos();
+    void lock_notes();
+    void unlock_notes();
+
     // JoinSplit without any input notes to spend
     UniValue perform_joinsplit(AsyncJoinSplitInfo &);
 
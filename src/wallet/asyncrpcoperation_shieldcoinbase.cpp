@@ -166,13 +166,13 @@ void AsyncRPCOperation_shieldcoinbase::main() {
     if (success && paymentDisclosureMode && paymentDisclosureData_.size()>0) {
         uint256 txidhash = tx_.GetHash();
         std::shared_ptr<PaymentDisclosureDB> db = PaymentDisclosureDB::sharedInstance();
-        for (PaymentDisclosureKeyInfo p : paymentDisclosureData_) {
+        for (PaymentDisclosureKeyInfo& p : paymentDisclosureData_) {
             p.first.hash = txidhash;
-            if (!db->Put(p.first, p.second)) {
-                LogPrint("paymentdisclosure", "%s: Payment Disclosure: Error writing entry to database for key %s\n", getId(), p.first.ToString());
-            } else {
-                LogPrint("paymentdisclosure", "%s: Payment Disclosure: Successfully added entry to database for key %s\n", getId(), p.first.ToString());
-            }
+        }
+        if (!db->PutBatch(paymentDisclosureData_)) {
+            LogPrint("paymentdisclosure", "%s: Payment Disclosure: Error writing %d entries to database for txid %s\n", getId(), paymentDisclosureData_.size(), txidhash.ToString());
+        } else {
+            LogPrint("paymentdisclosure", "%s: Payment Disclosure: Successfully added %d entries to database for txid %s\n", getId(), paymentDisclosureData_.size(), txidhash.ToString());
         }
     }
     // !!! Payment disclosure END
@@ -225,7 +225,7 @@ bool ShieldToAddress::operator()(const libzcash::SproutPaymentAddress &zaddr) co
     info.vjsout.push_back(jso);
     UniValue obj = m_op->perform_joinsplit(info);
 
-    auto txAndResult = SignSendRawTransaction(obj, std::nullopt, m_op->testmode);
+    auto txAndResult = SignSendRawTransaction(obj, std::nullopt, m_op->testmode, m_op->getId());
     m_op->tx_ = txAndResult.first;
     m_op->set_result(txAndResult.second);
     return true;
@@ -253,7 +253,7 @@ bool ShieldToAddress::operator()(const libzcash::SaplingPaymentAddress &zaddr) c
     // Build the transaction
     m_op->tx_ = m_op->builder_.Build().GetTxOrThrow();
 
-    UniValue sendResult = SendTransaction(m_op->tx_, std::nullopt, m_op->testmode);
+    UniValue sendResult = SendTransaction(m_op->tx_, std::nullopt, m_op->testmode, m_op->getId());
     m_op->set_result(sendResult);
 
     return true;
@@ -11,9 +11,13 @@
 #include "streams.h"
 #include "util.h"
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 
+#include <boost/thread.hpp>
+
 int CCrypter::BytesToKeySHA512AES(const std::vector<unsigned char>& chSalt, const SecureString& strKeyData, int count, unsigned char *key,unsigned char *iv) const
 {
     // This mimics the behavior of openssl's EVP_BytesToKey with an aes256cbc
@@ -212,6 +216,7 @@ bool CCryptoKeyStore::Lock()
         if (!SetCrypted())
             return false;
         vMasterKey.clear();
+        mapSessionKeys.clear();
     }
 
     NotifyStatusChanged(this);
@@ -236,50 +241,115 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
                 keyPass = true;
             }
         }
-        CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
+        if (!fDecryptionThoroughlyChecked)
         {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            CKey key;
-            if (!DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key))
-            {
-                keyFail = true;
-                break;
+            // The first unlock after load verifies every crypted key. The
+            // checks are independent of each other and dominated by pubkey
+            // verification rather than the AES decrypt itself, so fan them
+            // out across the cores; a strided partition of the work list
+            // needs no synchronization between the workers.
+            std::vector<std::function<bool()>> vChecks;
+            for (const auto& item : mapCryptedKeys) {
+                const CPubKey& vchPubKey = item.second.first;
+                const std::vector<unsigned char>& vchCryptedSecret = item.second.second;
+                vChecks.push_back([&vMasterKeyIn, &vchPubKey, &vchCryptedSecret]() {
+                    CKey key;
+                    return DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key);
+                });
+            }
+            for (const auto& item : mapCryptedSproutSpendingKeys) {
+                const libzcash::SproutPaymentAddress& address = item.first;
+                const std::vector<unsigned char>& vchCryptedSecret = item.second;
+                vChecks.push_back([&vMasterKeyIn, &address, &vchCryptedSecret]() {
+                    libzcash::SproutSpendingKey sk;
+                    return DecryptSproutSpendingKey(vMasterKeyIn, vchCryptedSecret, address, sk);
+                });
+            }
+            for (const auto& item : mapCryptedSaplingSpendingKeys) {
+                const libzcash::SaplingExtendedFullViewingKey& extfvk = item.first;
+                const std::vector<unsigned char>& vchCryptedSecret = item.second;
+                vChecks.push_back([&vMasterKeyIn, &extfvk, &vchCryptedSecret]() {
+                    libzcash::SaplingExtendedSpendingKey sk;
+                    return DecryptSaplingSpendingKey(vMasterKeyIn, vchCryptedSecret, extfvk, sk);
+                });
+            }
+
+            std::atomic<bool> fAnyPass(false);
+            std::atomic<bool> fAnyFail(false);
+            size_t nThreads = std::min<size_t>(std::max(1, GetNumCores()), vChecks.size());
+            if (nThreads > 1) {
+                boost::thread_group workers;
+                for (size_t t = 0; t < nThreads; t++) {
+                    workers.create_thread([&, t]() {
+                        for (size_t i = t; i < vChecks.size(); i += nThreads) {
+                            if (vChecks[i]()) {
+                                fAnyPass = true;
+                            } else {
+                                fAnyFail = true;
+                            }
+                        }
+                    });
+                }
+                workers.join_all();
+            } else {
+                for (const auto& check : vChecks) {
+                    if (check()) {
+                        fAnyPass = true;
+                    } else {
+                        fAnyFail = true;
+                    }
+                }
             }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
+            if (fAnyPass) keyPass = true;
+            if (fAnyFail) keyFail = true;
         }
-        CryptedSproutSpendingKeyMap::const_iterator miSprout = mapCryptedSproutSpendingKeys.begin();
-        for (; miSprout != mapCryptedSproutSpendingKeys.end(); ++miSprout)
+        else
         {
-            const libzcash::SproutPaymentAddress &address = (*miSprout).first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*miSprout).second;
-            libzcash::SproutSpendingKey sk;
-            if (!DecryptSproutSpendingKey(vMasterKeyIn, vchCryptedSecret, address, sk))
+            CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
+            for (; mi != mapCryptedKeys.end(); ++mi)
             {
-                keyFail = true;
-                break;
+                const CPubKey &vchPubKey = (*mi).second.first;
+                const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
+                CKey key;
+                if (!DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key))
+                {
+                    keyFail = true;
+                    break;
+                }
+                keyPass = true;
+                if (fDecryptionThoroughlyChecked)
+                    break;
             }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
-        }
-        CryptedSaplingSpendingKeyMap::const_iterator miSapling = mapCryptedSaplingSpendingKeys.begin();
-        for (; miSapling != mapCryptedSaplingSpendingKeys.end(); ++miSapling)
-        {
-            const libzcash::SaplingExtendedFullViewingKey &extfvk = (*miSapling).first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*miSapling).second;
-            libzcash::SaplingExtendedSpendingKey sk;
-            if (!DecryptSaplingSpendingKey(vMasterKeyIn, vchCryptedSecret, extfvk, sk))
+            CryptedSproutSpendingKeyMap::const_iterator miSprout = mapCryptedSproutSpendingKeys.begin();
+            for (; miSprout != mapCryptedSproutSpendingKeys.end(); ++miSprout)
             {
-                keyFail = true;
-                break;
+                const libzcash::SproutPaymentAddress &address = (*miSprout).first;
+                const std::vector<unsigned char> &vchCryptedSecret = (*miSprout).second;
+                libzcash::SproutSpendingKey sk;
+                if (!DecryptSproutSpendingKey(vMasterKeyIn, vchCryptedSecret, address, sk))
+                {
+                    keyFail = true;
+                    break;
+                }
+                keyPass = true;
+                if (fDecryptionThoroughlyChecked)
+                    break;
+            }
+            CryptedSaplingSpendingKeyMap::const_iterator miSapling = mapCryptedSaplingSpendingKeys.begin();
+            for (; miSapling != mapCryptedSaplingSpendingKeys.end(); ++miSapling)
+            {
+                const libzcash::SaplingExtendedFullViewingKey &extfvk = (*miSapling).first;
+                const std::vector<unsigned char> &vchCryptedSecret = (*miSapling).second;
+                libzcash::SaplingExtendedSpendingKey sk;
+                if (!DecryptSaplingSpendingKey(vMasterKeyIn, vchCryptedSecret, extfvk, sk))
+                {
+                    keyFail = true;
+                    break;
+                }
+                keyPass = true;
+                if (fDecryptionThoroughlyChecked)
+                    break;
             }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
         }
         if (keyPass && keyFail)
         {
@@ -385,6 +455,7 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<
         return false;
 
     mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+    BumpKeystoreGeneration();
     return true;
 }
 
@@ -397,13 +468,40 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
     CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
     if (mi != mapCryptedKeys.end())
     {
+        if (nSigningSessions > 0) {
+            std::map<CKeyID, CKey>::const_iterator si = mapSessionKeys.find(address);
+            if (si != mapSessionKeys.end()) {
+                keyOut = si->second;
+                return true;
+            }
+        }
         const CPubKey &vchPubKey = (*mi).second.first;
         const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-        return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut);
+        if (!DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut))
+            return false;
+        if (nSigningSessions > 0) {
+            mapSessionKeys[address] = keyOut;
+        }
+        return true;
     }
     return false;
 }
 
+void CCryptoKeyStore::BeginSigningSession() const
+{
+    LOCK(cs_KeyStore);
+    nSigningSessions++;
+}
+
+void CCryptoKeyStore::EndSigningSession() const
+{
+    LOCK(cs_KeyStore);
+    assert(nSigningSessions > 0);
+    if (--nSigningSessions == 0) {
+        mapSessionKeys.clear();
+    }
+}
+
 bool CCryptoKeyStore::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     LOCK(cs_KeyStore);
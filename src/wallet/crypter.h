@@ -138,6 +138,13 @@ private:
 
     CKeyingMaterial vMasterKey;
 
+    //! Decrypted-key cache for open signing sessions. Only populated while
+    //! nSigningSessions > 0; wiped when the last session closes or the
+    //! store is locked. CKey holds its secret in secure (locked, zeroed on
+    //! free) memory, so cached entries never touch swappable pages.
+    mutable std::map<CKeyID, CKey> mapSessionKeys;
+    mutable unsigned int nSigningSessions = 0;
+
     //! if fUseCrypto is true, mapKeys, mapSproutSpendingKeys, and mapSaplingSpendingKeys must be empty
     //! if fUseCrypto is false, vMasterKey must be empty
     std::atomic<bool> fUseCrypto;
@@ -188,6 +195,13 @@ public:
     }
     bool GetKey(const CKeyID &address, CKey& keyOut) const;
     bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const;
+
+    //! Open/close a signing session during which decrypted keys are cached,
+    //! so a batch of signatures decrypts each key once instead of per input.
+    //! Use via CKeyStoreSigningSession rather than calling these directly.
+    void BeginSigningSession() const;
+    void EndSigningSession() const;
+
     std::set<CKeyID> GetKeys() const
     {
         LOCK(cs_KeyStore);
@@ -259,4 +273,25 @@ public:
     boost::signals2::signal<void (CCryptoKeyStore* wallet)> NotifyStatusChanged;
 };
 
+/** RAII signing session: keeps keys decrypted in the keystore for the
+ *  lifetime of the object, for batch signing. */
+class CKeyStoreSigningSession
+{
+private:
+    const CCryptoKeyStore& keystore;
+
+public:
+    CKeyStoreSigningSession(const CCryptoKeyStore& keystoreIn) : keystore(keystoreIn)
+    {
+        keystore.BeginSigningSession();
+    }
+    ~CKeyStoreSigningSession()
+    {
+        keystore.EndSigningSession();
+    }
+
+    CKeyStoreSigningSession(CKeyStoreSigningSession const&) = delete;
+    CKeyStoreSigningSession& operator=(CKeyStoreSigningSession const&) = delete;
+};
+
 #endif // BITCOIN_WALLET_CRYPTER_H
@@ -220,6 +220,13 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
     dbenv->lsn_reset(strFile.c_str(), 0);
 }
 
+void CDBEnv::Checkpoint()
+{
+    if (!fDbEnvInit || fMockDb)
+        return;
+    dbenv->txn_checkpoint(0, 0, 0);
+}
+
 
 CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
 {
@@ -72,6 +72,13 @@ public:
     void Close();
     void Flush(bool fShutdown);
     void CheckpointLSN(const std::string& strFile);
+    /**
+     * Write a checkpoint without taking cs_db. BDB serializes checkpoints
+     * internally, so concurrent wallet operations keep running while the
+     * dirty pages are flushed; a CheckpointLSN taken shortly afterwards
+     * then has little left to write.
+     */
+    void Checkpoint();
 
     void CloseDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
@@ -1334,6 +1334,62 @@ TEST(WalletTests, CachedWitnessesChainTip) {
     }
 }
 
+TEST(WalletTests, CachedWitnessesLazyUpdate) {
+    TestWallet wallet(Params());
+    LOCK(wallet.cs_wallet);
+    CBlock block1;
+    SproutMerkleTree sproutTree;
+    SaplingMerkleTree saplingTree;
+
+    auto sk = libzcash::SproutSpendingKey::random();
+    wallet.AddSproutSpendingKey(sk);
+
+    // First block, containing our notes
+    CBlockIndex index1(block1);
+    index1.nHeight = 1;
+    auto outpts = CreateValidBlock(wallet, sk, index1, block1, sproutTree, saplingTree);
+
+    std::vector<JSOutPoint> sproutNotes {outpts.first};
+    std::vector<SaplingOutPoint> saplingNotes {outpts.second};
+    std::vector<std::optional<SproutWitness>> sproutWitnesses;
+    std::vector<std::optional<SaplingWitness>> saplingWitnesses;
+
+    auto anchors1 = GetWitnessesAndAnchors(wallet, sproutNotes, saplingNotes, sproutWitnesses, saplingWitnesses);
+    EXPECT_TRUE((bool) sproutWitnesses[0]);
+    EXPECT_TRUE((bool) saplingWitnesses[0]);
+
+    // Second block, containing only note commitments that are not ours
+    auto wtx2 = GetValidSproutReceive(libzcash::SproutSpendingKey::random(), 10, true);
+    CBlock block2;
+    block2.hashPrevBlock = block1.GetHash();
+    block2.vtx.push_back(wtx2);
+    CBlockIndex index2(block2);
+    index2.nHeight = 2;
+    SproutMerkleTree sproutTree2 {sproutTree};
+    SaplingMerkleTree saplingTree2 {saplingTree};
+    wallet.IncrementNoteWitnesses(&index2, &block2, sproutTree2, saplingTree2);
+
+    // The caller's trees still advance past the block...
+    EXPECT_NE(sproutTree.root(), sproutTree2.root());
+
+    // ...but our witnesses are left behind until they are actually needed.
+    // (Without a chain to replay from, they stay at the first block's anchor.)
+    auto anchors2 = GetWitnessesAndAnchors(wallet, sproutNotes, saplingNotes, sproutWitnesses, saplingWitnesses);
+    EXPECT_TRUE((bool) sproutWitnesses[0]);
+    EXPECT_TRUE((bool) saplingWitnesses[0]);
+    EXPECT_EQ(anchors1.first, anchors2.first);
+    EXPECT_EQ(anchors1.second, anchors2.second);
+
+    // Disconnecting the unrelated block leaves the lagging witnesses valid:
+    // they never saw the block's note commitments.
+    wallet.DecrementNoteWitnesses(&index2);
+    auto anchors3 = GetWitnessesAndAnchors(wallet, sproutNotes, saplingNotes, sproutWitnesses, saplingWitnesses);
+    EXPECT_TRUE((bool) sproutWitnesses[0]);
+    EXPECT_TRUE((bool) saplingWitnesses[0]);
+    EXPECT_EQ(anchors1.first, anchors3.first);
+    EXPECT_EQ(anchors1.second, anchors3.second);
+}
+
 TEST(WalletTests, CachedWitnessesDecrementFirst) {
     TestWallet wallet(Params());
     LOCK(wallet.cs_wallet);
@@ -0,0 +1,163 @@
+// Copyright (c) 2026 The Koto developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "wallet/operationjournal.h"
+
+#include "dbwrapper.h"
+#include "fs.h"
+#include "util.h"
+#include "utiltime.h"
+#include "wallet/wallet.h"
+
+using namespace std;
+
+static fs::path emptyPath;
+
+/**
+ * Static method to return the shared/default operation journal database.
+ */
+shared_ptr<OperationJournalDB> OperationJournalDB::sharedInstance() {
+    // Thread-safe in C++11 and gcc 4.3
+    static shared_ptr<OperationJournalDB> ptr = std::make_shared<OperationJournalDB>();
+    return ptr;
+}
+
+// C++11 delegated constructor
+OperationJournalDB::OperationJournalDB() : OperationJournalDB(emptyPath) {
+}
+
+OperationJournalDB::OperationJournalDB(const fs::path& dbPath) {
+    fs::path path(dbPath);
+    if (path.empty()) {
+        path = GetDataDir() / "operationjournal";
+        LogPrintf("OperationJournal: using default path for database: %s\n", path.string());
+    } else {
+        LogPrintf("OperationJournal: using custom path for database: %s\n", path.string());
+    }
+
+    TryCreateDirectory(path);
+    options.create_if_missing = true;
+    leveldb::Status status = leveldb::DB::Open(options, path.string(), &db);
+    dbwrapper_private::HandleError(status); // throws exception
+    LogPrintf("OperationJournal: Opened LevelDB successfully\n");
+}
+
+OperationJournalDB::~OperationJournalDB() {
+    if (db != nullptr) {
+        delete db;
+    }
+}
+
+bool OperationJournalDB::Put(const std::string& key, const OperationJournalRecord& record)
+{
+    if (db == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue.reserve(GetSerializeSize(ssValue, record));
+    ssValue << record;
+    leveldb::Slice slice(&ssValue[0], ssValue.size());
+
+    leveldb::Status status = db->Put(writeOptions, key, slice);
+    dbwrapper_private::HandleError(status);
+    return true;
+}
+
+bool OperationJournalDB::Get(const std::string& key, OperationJournalRecord& record)
+{
+    if (db == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    std::string strValue;
+    leveldb::Status status = db->Get(readOptions, key, &strValue);
+    if (!status.ok()) {
+        if (status.IsNotFound())
+            return false;
+        LogPrintf("OperationJournal: LevelDB read failure: %s\n", status.ToString());
+        dbwrapper_private::HandleError(status);
+    }
+
+    try {
+        CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> record;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+bool OperationJournalDB::Erase(const std::string& key)
+{
+    if (db == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    leveldb::Status status = db->Delete(writeOptions, key);
+    dbwrapper_private::HandleError(status);
+    return true;
+}
+
+bool OperationJournalDB::GetAll(std::vector<std::pair<std::string, OperationJournalRecord>>& entries)
+{
+    if (db == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(readOptions));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        OperationJournalRecord record;
+        try {
+            leveldb::Slice slice = it->value();
+            CDataStream ssValue(slice.data(), slice.data() + slice.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> record;
+        } catch (const std::exception&) {
+            // A corrupt entry cannot be resubmitted; skip it rather than
+            // blocking the rest of the journal.
+            LogPrintf("OperationJournal: skipping corrupt entry for key %s\n", it->key().ToString());
+            continue;
+        }
+        entries.push_back(std::make_pair(it->key().ToString(), record));
+    }
+    dbwrapper_private::HandleError(it->status());
+    return true;
+}
+
+void ResumeJournaledOperations()
+{
+    if (!pwalletMain) {
+        return;
+    }
+
+    shared_ptr<OperationJournalDB> journal = OperationJournalDB::sharedInstance();
+    std::vector<std::pair<std::string, OperationJournalRecord>> entries;
+    if (!journal->GetAll(entries) || entries.empty()) {
+        return;
+    }
+
+    LogPrintf("OperationJournal: resubmitting %u journaled transaction(s) from previous run\n", entries.size());
+    for (const auto& entry : entries) {
+        CTransaction tx(entry.second.mtx);
+        CWalletTx wtx(pwalletMain, tx);
+        if (pwalletMain->CommitTransaction(wtx, std::nullopt)) {
+            LogPrintf("OperationJournal: resubmitted txid=%s%s\n", tx.GetHash().ToString(),
+                      entry.second.opId.empty() ? "" : strprintf(" (operation %s)", entry.second.opId));
+            journal->Erase(entry.first);
+        } else {
+            // More details in debug.log; keep the entry so the transaction is
+            // not lost and the next startup can try again.
+            LogPrintf("OperationJournal: failed to resubmit txid=%s, keeping journal entry\n",
+                      tx.GetHash().ToString());
+        }
+    }
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2026 The Koto developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef ZCASH_WALLET_OPERATIONJOURNAL_H
+#define ZCASH_WALLET_OPERATIONJOURNAL_H
+
+#include "clientversion.h"
+#include "fs.h"
+#include "primitives/transaction.h"
+#include "serialize.h"
+#include "streams.h"
+#include "version.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <leveldb/db.h>
+
+#define OPERATION_JOURNAL_VERSION 1
+
+/**
+ * A fully proven, signed transaction produced by an async RPC operation,
+ * checkpointed just before it is handed to the wallet for commit and
+ * broadcast. Proving can take minutes; journaling the finished transaction
+ * means a restart in the window between proving and broadcast only costs a
+ * resubmission instead of redoing the proofs.
+ */
+struct OperationJournalRecord {
+    uint8_t version;
+    int64_t nCreationTime;
+    std::string opId;          // async operation id, e.g. opid-..., may be empty
+    CMutableTransaction mtx;   // the fully proven and signed transaction
+
+    OperationJournalRecord() : version(OPERATION_JOURNAL_VERSION), nCreationTime(0) { }
+
+    OperationJournalRecord(const std::string& opIdIn, const CTransaction& txIn, int64_t nCreationTimeIn)
+        : version(OPERATION_JOURNAL_VERSION), nCreationTime(nCreationTimeIn), opId(opIdIn), mtx(txIn) { }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(version);
+        READWRITE(nCreationTime);
+        READWRITE(opId);
+        READWRITE(mtx);
+    }
+};
+
+class OperationJournalDB
+{
+protected:
+    leveldb::DB* db = nullptr;
+    leveldb::Options options;
+    leveldb::ReadOptions readOptions;
+    leveldb::WriteOptions writeOptions;
+    mutable std::mutex lock_;
+
+public:
+    static std::shared_ptr<OperationJournalDB> sharedInstance();
+
+    OperationJournalDB();
+    OperationJournalDB(const fs::path& dbPath);
+    ~OperationJournalDB();
+
+    bool Put(const std::string& key, const OperationJournalRecord& record);
+    bool Get(const std::string& key, OperationJournalRecord& record);
+    bool Erase(const std::string& key);
+    bool GetAll(std::vector<std::pair<std::string, OperationJournalRecord>>& entries);
+};
+
+/** Resubmit any journaled transactions left over from the previous run. */
+void ResumeJournaledOperations();
+
+#endif // ZCASH_WALLET_OPERATIONJOURNAL_H
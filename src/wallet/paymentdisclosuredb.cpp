@@ -8,6 +8,8 @@
 #include "util.h"
 #include "dbwrapper.h"
 
+#include <leveldb/write_batch.h>
+
 using namespace std;
 
 static fs::path emptyPath;
@@ -65,6 +67,27 @@ bool PaymentDisclosureDB::Put(const PaymentDisclosureKey& key, const PaymentDisc
     return true;
 }
 
+bool PaymentDisclosureDB::PutBatch(const std::vector<PaymentDisclosureKeyInfo>& entries)
+{
+    if (db == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    leveldb::WriteBatch batch;
+    for (const PaymentDisclosureKeyInfo& entry : entries) {
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue.reserve(GetSerializeSize(ssValue, entry.second));
+        ssValue << entry.second;
+        batch.Put(entry.first.ToString(), leveldb::Slice(&ssValue[0], ssValue.size()));
+    }
+
+    leveldb::Status status = db->Write(writeOptions, &batch);
+    dbwrapper_private::HandleError(status);
+    return true;
+}
+
 bool PaymentDisclosureDB::Get(const PaymentDisclosureKey& key, PaymentDisclosureInfo& info)
 {
     if (db == nullptr) {
@@ -90,3 +113,38 @@ bool PaymentDisclosureDB::Get(const PaymentDisclosureKey& key, PaymentDisclosure
     }
     return true;
 }
+
+bool PaymentDisclosureDB::GetDisclosuresForTxid(const uint256& txid, std::vector<PaymentDisclosureKeyInfo>& entries)
+{
+    if (db == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+
+    // Keys are JSOutPoint::ToString() strings, so every disclosure recorded
+    // for a transaction shares the same "JSOutPoint(<txid prefix>" key
+    // prefix and can be collected with one seek plus a bounded scan.
+    const std::string prefix = strprintf("JSOutPoint(%s", txid.ToString().substr(0, 10));
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(readOptions));
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        // Recover the joinsplit and output indices from the key remainder.
+        unsigned long jsIndex = 0;
+        unsigned int outputIndex = 0;
+        std::string rest = it->key().ToString().substr(prefix.size());
+        if (sscanf(rest.c_str(), ", %lu, %u)", &jsIndex, &outputIndex) != 2) {
+            continue;
+        }
+        PaymentDisclosureInfo info;
+        try {
+            CDataStream ssValue(it->value().data(), it->value().data() + it->value().size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> info;
+        } catch (const std::exception&) {
+            continue;
+        }
+        PaymentDisclosureKey key(txid, (size_t)jsIndex, (uint8_t)outputIndex);
+        entries.push_back(PaymentDisclosureKeyInfo(key, info));
+    }
+    dbwrapper_private::HandleError(it->status());
+    return true;
+}
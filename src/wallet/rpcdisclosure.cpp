@@ -129,7 +129,16 @@ UniValue z_getpaymentdisclosure(const UniValue& params, bool fHelp)
     shared_ptr<PaymentDisclosureDB> db = PaymentDisclosureDB::sharedInstance();
     PaymentDisclosureInfo info;
     if (!db->Get(key, info)) {
-        throw JSONRPCError(RPC_DATABASE_ERROR, "Could not find payment disclosure info for the given joinsplit output");
+        // Distinguish a wrong index from a transaction with no recorded
+        // disclosures at all, with one key-range scan over the txid.
+        std::vector<PaymentDisclosureKeyInfo> txEntries;
+        db->GetDisclosuresForTxid(hash, txEntries);
+        if (txEntries.empty()) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, "No payment disclosure info is recorded for this transaction");
+        }
+        throw JSONRPCError(RPC_DATABASE_ERROR, strprintf(
+            "Could not find payment disclosure info for the given joinsplit output (%d outputs of this transaction have disclosures)",
+            txEntries.size()));
     }
 
     PaymentDisclosure pd( wtx.joinSplitPubKey, key, info, msg );
@@ -310,6 +310,186 @@ UniValue importpubkey(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+/**
+ * Find the block to start a rescan from for keys created at nTimestamp,
+ * allowing TIMESTAMP_WINDOW (chain.h) of miner clock skew around it.
+ * Uses the timestamp index when available; otherwise walks the header chain
+ * backwards (no disk access either way).
+ */
+static CBlockIndex* FindRescanStart(int64_t nTimestamp)
+{
+    AssertLockHeld(cs_main);
+    if (nTimestamp <= TIMESTAMP_WINDOW)
+        return chainActive.Genesis();
+    unsigned int low = nTimestamp - TIMESTAMP_WINDOW;
+
+    if (fTimestampIndex) {
+        // The index iterates in ascending timestamp order, so the first hit
+        // is the earliest block at or after the requested time.
+        std::vector<std::pair<uint256, unsigned int> > hashes;
+        if (GetTimestampIndex(chainActive.Tip()->nTime, low, true, hashes) && !hashes.empty()) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashes[0].first);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+                return mi->second;
+        }
+    }
+
+    // Block times are only roughly monotonic; the skew window above absorbs
+    // the difference.
+    CBlockIndex* pindex = chainActive.Tip();
+    while (pindex->pprev && pindex->pprev->GetBlockTime() >= low)
+        pindex = pindex->pprev;
+    return pindex;
+}
+
+UniValue importmulti(const UniValue& params, bool fHelp)
+{
+    if (!EnsureWalletIsAvailable(fHelp))
+        return NullUniValue;
+
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "importmulti requests ( options )\n"
+            "\nImports keys, addresses and scripts in one call, followed by at most one\n"
+            "rescan from the earliest requested timestamp. Use this instead of repeated\n"
+            "importprivkey/importaddress calls, which each rescan the whole chain.\n"
+            "\nArguments:\n"
+            "1. requests       (array, required) Data to be imported\n"
+            "  [     (array of json objects)\n"
+            "    {\n"
+            "      \"privkey\": \"key\",      (string) Private key (see dumpprivkey) to import, or instead:\n"
+            "      \"pubkey\": \"hex\",       (string) Hex-encoded public key to watch, or instead:\n"
+            "      \"address\": \"addr\",     (string) Address or hex-encoded script to watch\n"
+            "      \"timestamp\": n | \"now\", (required) Creation time of the key/script, used to bound the rescan\n"
+            "      \"label\": \"label\",      (string, optional, default=\"\") An optional label\n"
+            "      \"p2sh\": true|false      (boolean, optional, default=false) Add the P2SH version of a hex script as well\n"
+            "    }\n"
+            "  ,...\n"
+            "  ]\n"
+            "2. options        (json object, optional)\n"
+            "  {\n"
+            "     \"rescan\": true|false    (boolean, optional, default=true) Rescan after all imports\n"
+            "  }\n"
+            "\nResult: per-request success or error, in request order\n"
+            "\nNote: This call can take minutes to complete if rescan is true.\n"
+            "\nExamples:\n"
+            + HelpExampleCli("importmulti", "'[{ \"address\": \"<my address>\", \"timestamp\":1455191478 }, "
+                                          "{ \"address\": \"<my 2nd address>\", \"timestamp\": \"now\" }]'") +
+            HelpExampleRpc("importmulti", "[{ \"address\": \"<my address>\", \"timestamp\":1455191478 }], { \"rescan\": false}")
+        );
+
+    if (fPruneMode)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Importing is disabled in pruned mode");
+
+    const UniValue& requests = params[0].get_array();
+
+    bool fRescan = true;
+    if (params.size() > 1) {
+        const UniValue& options = params[1].get_obj();
+        const UniValue& rescan = find_value(options, "rescan");
+        if (!rescan.isNull())
+            fRescan = rescan.get_bool();
+    }
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    KeyIO keyIO(Params());
+    UniValue response(UniValue::VARR);
+    int64_t nEarliestTime = GetTime();
+    bool fImportedAny = false;
+
+    for (size_t i = 0; i < requests.size(); i++) {
+        UniValue result(UniValue::VOBJ);
+        try {
+            const UniValue& request = requests[i].get_obj();
+
+            const UniValue& timestamp = find_value(request, "timestamp");
+            int64_t nTime;
+            if (timestamp.isNum())
+                nTime = timestamp.get_int64();
+            else if (timestamp.isStr() && timestamp.get_str() == "now")
+                nTime = GetTime();
+            else
+                throw JSONRPCError(RPC_TYPE_ERROR, "Missing or invalid timestamp");
+
+            string strLabel = "";
+            const UniValue& label = find_value(request, "label");
+            if (!label.isNull())
+                strLabel = label.get_str();
+
+            const UniValue& privkey = find_value(request, "privkey");
+            const UniValue& pubkey = find_value(request, "pubkey");
+            const UniValue& address = find_value(request, "address");
+            if (!privkey.isNull()) {
+                EnsureWalletIsUnlocked();
+                CKey key = keyIO.DecodeSecret(privkey.get_str());
+                if (!key.IsValid())
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid private key encoding");
+                CPubKey vchPubKey = key.GetPubKey();
+                assert(key.VerifyPubKey(vchPubKey));
+                CKeyID vchAddress = vchPubKey.GetID();
+                pwalletMain->MarkDirty();
+                pwalletMain->SetAddressBook(vchAddress, strLabel, "receive");
+                // Don't throw error in case a key is already there
+                if (!pwalletMain->HaveKey(vchAddress)) {
+                    pwalletMain->mapKeyMetadata[vchAddress].nCreateTime = nTime;
+                    if (!pwalletMain->AddKeyPubKey(key, vchPubKey))
+                        throw JSONRPCError(RPC_WALLET_ERROR, "Error adding key to wallet");
+                    if (!pwalletMain->nTimeFirstKey || nTime < pwalletMain->nTimeFirstKey)
+                        pwalletMain->nTimeFirstKey = nTime;
+                }
+            } else if (!pubkey.isNull()) {
+                if (!IsHex(pubkey.get_str()))
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pubkey must be a hex string");
+                std::vector<unsigned char> data(ParseHex(pubkey.get_str()));
+                CPubKey vchPubKey(data.begin(), data.end());
+                if (!vchPubKey.IsFullyValid())
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pubkey is not a valid public key");
+                ImportAddress(vchPubKey.GetID(), strLabel);
+                ImportScript(GetScriptForRawPubKey(vchPubKey), strLabel, false);
+            } else if (!address.isNull()) {
+                bool fP2SH = false;
+                const UniValue& p2sh = find_value(request, "p2sh");
+                if (!p2sh.isNull())
+                    fP2SH = p2sh.get_bool();
+                CTxDestination dest = keyIO.DecodeDestination(address.get_str());
+                if (IsValidDestination(dest)) {
+                    if (fP2SH)
+                        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Cannot use the p2sh flag with an address - use a script instead");
+                    ImportAddress(dest, strLabel);
+                } else if (IsHex(address.get_str())) {
+                    std::vector<unsigned char> data(ParseHex(address.get_str()));
+                    ImportScript(CScript(data.begin(), data.end()), strLabel, fP2SH);
+                } else {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid Koto address or script");
+                }
+            } else {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Each request needs one of \"privkey\", \"pubkey\" or \"address\"");
+            }
+
+            nEarliestTime = min(nEarliestTime, nTime);
+            fImportedAny = true;
+            result.pushKV("success", true);
+        } catch (const UniValue& objError) {
+            result.pushKV("success", false);
+            result.pushKV("error", objError);
+        } catch (const std::exception& e) {
+            result.pushKV("success", false);
+            result.pushKV("error", JSONRPCError(RPC_MISC_ERROR, e.what()));
+        }
+        response.push_back(result);
+    }
+
+    // One rescan for the whole batch, starting at the earliest requested
+    // timestamp instead of genesis.
+    if (fRescan && fImportedAny) {
+        pwalletMain->ScanForWalletTransactions(FindRescanStart(nEarliestTime), true);
+        pwalletMain->ReacceptWalletTransactions();
+    }
+
+    return response;
+}
+
 
 UniValue z_importwallet(const UniValue& params, bool fHelp)
 {
@@ -560,10 +740,6 @@ UniValue dumpwallet(const UniValue& params, bool fHelp)
 
 UniValue dumpwallet_impl(const UniValue& params, bool fDumpZKeys)
 {
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-
-    EnsureWalletIsUnlocked();
-
     fs::path exportdir;
     try {
         exportdir = GetExportDir();
@@ -589,81 +765,134 @@ UniValue dumpwallet_impl(const UniValue& params, bool fDumpZKeys)
     if (!file.is_open())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open wallet dump file");
 
-    std::map<CKeyID, int64_t> mapKeyBirth;
-    std::set<CKeyID> setKeyPool;
-    pwalletMain->GetKeyBirthTimes(mapKeyBirth);
-    pwalletMain->GetAllReserveKeys(setKeyPool);
+    // Snapshot everything under the locks, as quickly as possible: raw keys
+    // and metadata only. The expensive part of a dump — encoding to base58
+    // and writing the file — happens below, after the locks are released,
+    // so a backup of a large wallet no longer blocks wallet operations.
+    struct TKeyExport {
+        CKey key;
+        int64_t nTime;
+        CKeyID keyid;
+        std::string strLabel;
+        bool fHaveLabel;
+        bool fReserve;
+    };
+    std::vector<TKeyExport> vKeys;
+    std::vector<std::tuple<libzcash::SproutSpendingKey, int64_t,
+                           libzcash::SproutPaymentAddress> > vSproutKeys;
+    std::vector<std::tuple<libzcash::SaplingExtendedSpendingKey, CKeyMetadata,
+                           libzcash::SaplingPaymentAddress> > vSaplingKeys;
+    HDSeed hdSeed;
+    int nTipHeight;
+    uint256 hashTip;
+    int64_t nTipTime;
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+
+        EnsureWalletIsUnlocked();
 
-    // sort time/key pairs
-    std::vector<std::pair<int64_t, CKeyID> > vKeyBirth;
-    for (std::map<CKeyID, int64_t>::const_iterator it = mapKeyBirth.begin(); it != mapKeyBirth.end(); it++) {
-        vKeyBirth.push_back(std::make_pair(it->second, it->first));
+        nTipHeight = chainActive.Height();
+        hashTip = chainActive.Tip()->GetBlockHash();
+        nTipTime = chainActive.Tip()->GetBlockTime();
+        pwalletMain->GetHDSeed(hdSeed);
+
+        std::map<CKeyID, int64_t> mapKeyBirth;
+        std::set<CKeyID> setKeyPool;
+        pwalletMain->GetKeyBirthTimes(mapKeyBirth);
+        pwalletMain->GetAllReserveKeys(setKeyPool);
+
+        // sort time/key pairs
+        std::vector<std::pair<int64_t, CKeyID> > vKeyBirth;
+        for (std::map<CKeyID, int64_t>::const_iterator it = mapKeyBirth.begin(); it != mapKeyBirth.end(); it++) {
+            vKeyBirth.push_back(std::make_pair(it->second, it->first));
+        }
+        mapKeyBirth.clear();
+        std::sort(vKeyBirth.begin(), vKeyBirth.end());
+
+        vKeys.reserve(vKeyBirth.size());
+        for (std::vector<std::pair<int64_t, CKeyID> >::const_iterator it = vKeyBirth.begin(); it != vKeyBirth.end(); it++) {
+            const CKeyID &keyid = it->second;
+            TKeyExport entry;
+            if (!pwalletMain->GetKey(keyid, entry.key))
+                continue;
+            entry.nTime = it->first;
+            entry.keyid = keyid;
+            entry.fHaveLabel = pwalletMain->mapAddressBook.count(keyid) != 0;
+            if (entry.fHaveLabel)
+                entry.strLabel = pwalletMain->mapAddressBook[keyid].name;
+            entry.fReserve = setKeyPool.count(keyid) != 0;
+            vKeys.push_back(entry);
+        }
+
+        if (fDumpZKeys) {
+            std::set<libzcash::SproutPaymentAddress> sproutAddresses;
+            pwalletMain->GetSproutPaymentAddresses(sproutAddresses);
+            for (auto addr : sproutAddresses) {
+                libzcash::SproutSpendingKey key;
+                if (pwalletMain->GetSproutSpendingKey(addr, key)) {
+                    vSproutKeys.push_back(std::make_tuple(
+                        key, pwalletMain->mapSproutZKeyMetadata[addr].nCreateTime, addr));
+                }
+            }
+            std::set<libzcash::SaplingPaymentAddress> saplingAddresses;
+            pwalletMain->GetSaplingPaymentAddresses(saplingAddresses);
+            for (auto addr : saplingAddresses) {
+                libzcash::SaplingExtendedSpendingKey extsk;
+                if (pwalletMain->GetSaplingExtendedSpendingKey(addr, extsk)) {
+                    auto ivk = extsk.expsk.full_viewing_key().in_viewing_key();
+                    vSaplingKeys.push_back(std::make_tuple(
+                        extsk, pwalletMain->mapSaplingZKeyMetadata[ivk], addr));
+                }
+            }
+        }
     }
-    mapKeyBirth.clear();
-    std::sort(vKeyBirth.begin(), vKeyBirth.end());
 
     KeyIO keyIO(Params());
 
-    // produce output
+    // produce output; the ofstream flushes its buffer as it fills, so memory
+    // use stays bounded regardless of the wallet size
     file << strprintf("# Wallet dump created by Koto %s (%s)\n", CLIENT_BUILD, CLIENT_DATE);
     file << strprintf("# * Created on %s\n", EncodeDumpTime(GetTime()));
-    file << strprintf("# * Best block at time of backup was %i (%s),\n", chainActive.Height(), chainActive.Tip()->GetBlockHash().ToString());
-    file << strprintf("#   mined on %s\n", EncodeDumpTime(chainActive.Tip()->GetBlockTime()));
+    file << strprintf("# * Best block at time of backup was %i (%s),\n", nTipHeight, hashTip.ToString());
+    file << strprintf("#   mined on %s\n", EncodeDumpTime(nTipTime));
     {
-        HDSeed hdSeed;
-        pwalletMain->GetHDSeed(hdSeed);
         auto rawSeed = hdSeed.RawSeed();
         file << strprintf("# HDSeed=%s fingerprint=%s", HexStr(rawSeed.begin(), rawSeed.end()), hdSeed.Fingerprint().GetHex());
         file << "\n";
     }
     file << "\n";
-    for (std::vector<std::pair<int64_t, CKeyID> >::const_iterator it = vKeyBirth.begin(); it != vKeyBirth.end(); it++) {
-        const CKeyID &keyid = it->second;
-        std::string strTime = EncodeDumpTime(it->first);
-        std::string strAddr = keyIO.EncodeDestination(keyid);
-        CKey key;
-        if (pwalletMain->GetKey(keyid, key)) {
-            if (pwalletMain->mapAddressBook.count(keyid)) {
-                file << strprintf("%s %s label=%s # addr=%s\n", keyIO.EncodeSecret(key), strTime, EncodeDumpString(pwalletMain->mapAddressBook[keyid].name), strAddr);
-            } else if (setKeyPool.count(keyid)) {
-                file << strprintf("%s %s reserve=1 # addr=%s\n", keyIO.EncodeSecret(key), strTime, strAddr);
-            } else {
-                file << strprintf("%s %s change=1 # addr=%s\n", keyIO.EncodeSecret(key), strTime, strAddr);
-            }
+    for (const TKeyExport& entry : vKeys) {
+        std::string strTime = EncodeDumpTime(entry.nTime);
+        std::string strAddr = keyIO.EncodeDestination(entry.keyid);
+        if (entry.fHaveLabel) {
+            file << strprintf("%s %s label=%s # addr=%s\n", keyIO.EncodeSecret(entry.key), strTime, EncodeDumpString(entry.strLabel), strAddr);
+        } else if (entry.fReserve) {
+            file << strprintf("%s %s reserve=1 # addr=%s\n", keyIO.EncodeSecret(entry.key), strTime, strAddr);
+        } else {
+            file << strprintf("%s %s change=1 # addr=%s\n", keyIO.EncodeSecret(entry.key), strTime, strAddr);
         }
     }
     file << "\n";
 
     if (fDumpZKeys) {
-        std::set<libzcash::SproutPaymentAddress> sproutAddresses;
-        pwalletMain->GetSproutPaymentAddresses(sproutAddresses);
         file << "\n";
         file << "# Zkeys\n";
         file << "\n";
-        for (auto addr : sproutAddresses) {
-            libzcash::SproutSpendingKey key;
-            if (pwalletMain->GetSproutSpendingKey(addr, key)) {
-                std::string strTime = EncodeDumpTime(pwalletMain->mapSproutZKeyMetadata[addr].nCreateTime);
-                file << strprintf("%s %s # zaddr=%s\n", keyIO.EncodeSpendingKey(key), strTime, keyIO.EncodePaymentAddress(addr));
-            }
+        for (const auto& entry : vSproutKeys) {
+            std::string strTime = EncodeDumpTime(std::get<1>(entry));
+            file << strprintf("%s %s # zaddr=%s\n", keyIO.EncodeSpendingKey(std::get<0>(entry)), strTime, keyIO.EncodePaymentAddress(std::get<2>(entry)));
         }
-        std::set<libzcash::SaplingPaymentAddress> saplingAddresses;
-        pwalletMain->GetSaplingPaymentAddresses(saplingAddresses);
         file << "\n";
         file << "# Sapling keys\n";
         file << "\n";
-        for (auto addr : saplingAddresses) {
-            libzcash::SaplingExtendedSpendingKey extsk;
-            if (pwalletMain->GetSaplingExtendedSpendingKey(addr, extsk)) {
-                auto ivk = extsk.expsk.full_viewing_key().in_viewing_key();
-                CKeyMetadata keyMeta = pwalletMain->mapSaplingZKeyMetadata[ivk];
-                std::string strTime = EncodeDumpTime(keyMeta.nCreateTime);
-                // Keys imported with z_importkey do not have zip32 metadata
-                if (keyMeta.hdKeypath.empty() || keyMeta.seedFp.IsNull()) {
-                    file << strprintf("%s %s # zaddr=%s\n", keyIO.EncodeSpendingKey(extsk), strTime, keyIO.EncodePaymentAddress(addr));
-                } else {
-                    file << strprintf("%s %s %s %s # zaddr=%s\n", keyIO.EncodeSpendingKey(extsk), strTime, keyMeta.hdKeypath, keyMeta.seedFp.GetHex(), keyIO.EncodePaymentAddress(addr));
-                }
+        for (const auto& entry : vSaplingKeys) {
+            const CKeyMetadata& keyMeta = std::get<1>(entry);
+            std::string strTime = EncodeDumpTime(keyMeta.nCreateTime);
+            // Keys imported with z_importkey do not have zip32 metadata
+            if (keyMeta.hdKeypath.empty() || keyMeta.seedFp.IsNull()) {
+                file << strprintf("%s %s # zaddr=%s\n", keyIO.EncodeSpendingKey(std::get<0>(entry)), strTime, keyIO.EncodePaymentAddress(std::get<2>(entry)));
+            } else {
+                file << strprintf("%s %s %s %s # zaddr=%s\n", keyIO.EncodeSpendingKey(std::get<0>(entry)), strTime, keyMeta.hdKeypath, keyMeta.seedFp.GetHex(), keyIO.EncodePaymentAddress(std::get<2>(entry)));
             }
         }
         file << "\n";
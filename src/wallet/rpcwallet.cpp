@@ -1165,6 +1165,8 @@ void ListTransactions(const CWalletTx& wtx, int nMinDepth, bool fLong, UniValue&
     wtx.GetAmounts(listReceived, listSent, nFee, filter);
 
     bool involvesWatchonly = wtx.IsFromMe(ISMINE_WATCH_ONLY);
+    // Serialize once; casting to CTransaction copies the whole transaction.
+    uint64_t nTxSize = static_cast<uint64_t>(GetSerializeSize(static_cast<CTransaction>(wtx), SER_NETWORK, PROTOCOL_VERSION));
 
     // Sent
     if ((!listSent.empty() || nFee != 0))
@@ -1183,7 +1185,7 @@ void ListTransactions(const CWalletTx& wtx, int nMinDepth, bool fLong, UniValue&
             entry.pushKV("fee", ValueFromAmount(-nFee));
             if (fLong)
                 WalletTxToJSON(wtx, entry);
-            entry.pushKV("size", static_cast<uint64_t>(GetSerializeSize(static_cast<CTransaction>(wtx), SER_NETWORK, PROTOCOL_VERSION)));
+            entry.pushKV("size", nTxSize);
             ret.push_back(entry);
         }
     }
@@ -1220,7 +1222,7 @@ void ListTransactions(const CWalletTx& wtx, int nMinDepth, bool fLong, UniValue&
             entry.pushKV("vout", r.vout);
             if (fLong)
                 WalletTxToJSON(wtx, entry);
-            entry.pushKV("size", static_cast<uint64_t>(GetSerializeSize(static_cast<CTransaction>(wtx), SER_NETWORK, PROTOCOL_VERSION)));
+            entry.pushKV("size", nTxSize);
             ret.push_back(entry);
         }
     }
@@ -2534,6 +2536,25 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
                 throw JSONRPCError(RPC_TYPE_ERROR, "Benchmark must be run in regtest mode");
             }
             sample_times.push_back(benchmark_connectblock_slow());
+        } else if (benchmarktype == "replaychain") {
+            int nBlocks = 64;
+            if (params.size() >= 3) {
+                nBlocks = params[2].get_int();
+            }
+            if (nBlocks <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid block count");
+            }
+            sample_times.push_back(benchmark_replay_chain(nBlocks));
+        } else if (benchmarktype == "replaymempool") {
+            std::string strTraceFile;
+            if (params.size() >= 3) {
+                strTraceFile = params[2].get_str();
+            }
+            sample_times.push_back(benchmark_replay_mempool(strTraceFile));
+#ifdef ENABLE_MINING
+        } else if (benchmarktype == "createblocktemplate") {
+            sample_times.push_back(benchmark_create_block_template());
+#endif
         } else if (benchmarktype == "sendtoaddress") {
             if (Params().NetworkIDString() != "regtest") {
                 throw JSONRPCError(RPC_TYPE_ERROR, "Benchmark must be run in regtest mode");
@@ -4350,6 +4371,8 @@ UniValue z_mergetoaddress(const UniValue& params, bool fHelp)
             "\nconstrained by the consensus rule defining a maximum transaction size of "
             + strprintf("%d bytes before Sapling, and %d", MAX_TX_SIZE_BEFORE_SAPLING, MAX_TX_SIZE_AFTER_SAPLING)
             + "\nbytes once Sapling activates."
+            "\n\nBecause each operation locks the inputs it selects, several merge operations can be submitted and executed"
+            "\nconcurrently (see -rpcasyncthreads); they will always select disjoint inputs."
             + HelpRequiringPassphrase() + "\n"
             "\nArguments:\n"
             "1. fromaddresses         (array, required) A JSON array with addresses.\n"
@@ -4860,6 +4883,7 @@ extern UniValue dumpprivkey(const UniValue& params, bool fHelp); // in rpcdump.c
 extern UniValue importprivkey(const UniValue& params, bool fHelp);
 extern UniValue importaddress(const UniValue& params, bool fHelp);
 extern UniValue importpubkey(const UniValue& params, bool fHelp);
+extern UniValue importmulti(const UniValue& params, bool fHelp);
 extern UniValue dumpwallet(const UniValue& params, bool fHelp);
 extern UniValue importwallet(const UniValue& params, bool fHelp);
 extern UniValue z_exportkey(const UniValue& params, bool fHelp);
@@ -4889,6 +4913,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "gettransaction",           &gettransaction,           false },
     { "wallet",             "getunconfirmedbalance",    &getunconfirmedbalance,    false },
     { "wallet",             "getwalletinfo",            &getwalletinfo,            false },
+    { "wallet",             "importmulti",              &importmulti,              true  },
     { "wallet",             "importprivkey",            &importprivkey,            true  },
     { "wallet",             "importwallet",             &importwallet,             true  },
     { "wallet",             "importaddress",            &importaddress,            true  },
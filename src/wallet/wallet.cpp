@@ -32,6 +32,9 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <variant>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -284,6 +287,10 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
+        if (pwalletdbKeyPool)
+            return pwalletdbKeyPool->WriteKey(pubkey,
+                                              secret.GetPrivKey(),
+                                              mapKeyMetadata[pubkey.GetID()]);
         return CWalletDB(strWalletFile).WriteKey(pubkey,
                                                  secret.GetPrivKey(),
                                                  mapKeyMetadata[pubkey.GetID()]);
@@ -305,6 +312,10 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
             return pwalletdbEncryption->WriteCryptedKey(vchPubKey,
                                                         vchCryptedSecret,
                                                         mapKeyMetadata[vchPubKey.GetID()]);
+        else if (pwalletdbKeyPool)
+            return pwalletdbKeyPool->WriteCryptedKey(vchPubKey,
+                                                     vchCryptedSecret,
+                                                     mapKeyMetadata[vchPubKey.GetID()]);
         else
             return CWalletDB(strWalletFile).WriteCryptedKey(vchPubKey,
                                                             vchCryptedSecret,
@@ -1037,6 +1048,7 @@ bool CWallet::IsSaplingSpent(const uint256& nullifier) const {
 void CWallet::AddToTransparentSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
+    setWalletUTXO.erase(outpoint);
 
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -1081,6 +1093,19 @@ void CWallet::AddToSpends(const uint256& wtxid)
     }
 }
 
+void CWallet::AddToUnspent(const CWalletTx& wtx)
+{
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        COutPoint outpoint(hash, i);
+        // A spend may already be on record when transactions arrive out of
+        // order, e.g. while the wallet file is being loaded.
+        if (IsMine(wtx.vout[i]) != ISMINE_NO && !mapTxSpends.count(outpoint)) {
+            setWalletUTXO.insert(outpoint);
+        }
+    }
+}
+
 void CWallet::ClearNoteWitnessCache()
 {
     LOCK(cs_wallet);
@@ -1102,17 +1127,16 @@ void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nW
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
-        // Only increment witnesses that are behind the current height
-        if (nd->witnessHeight < indexHeight) {
+        // Only increment witnesses that have caught up to the block below
+        // this one. Because witnesses are maintained lazily, a note may be
+        // witnessed further behind; it joins the roll-forward in
+        // CWallet::AdvanceNoteWitnesses() when the replay reaches the block
+        // after its own. Notes witnessed above the current height are only
+        // seen during a reindex, when blocks have been decremented and we
+        // are incrementing the blocks immediately after.
+        if (nd->witnessHeight == indexHeight - 1) {
             // Check the validity of the cache
-            // The only time a note witnessed above the current height
-            // would be invalid here is during a reindex when blocks
-            // have been decremented, and we are incrementing the blocks
-            // immediately after.
             assert(nWitnessCacheSize >= nd->witnesses.size());
-            // Witnesses being incremented should always be either -1
-            // (never incremented or decremented) or one below indexHeight
-            assert((nd->witnessHeight == -1) || (nd->witnessHeight == indexHeight - 1));
             // Copy the witness for the previous block if we have one
             if (nd->witnesses.size() > 0) {
                 nd->witnesses.push_front(nd->witnesses.front());
@@ -1129,7 +1153,7 @@ void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWi
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
-        if (nd->witnessHeight < indexHeight && nd->witnesses.size() > 0) {
+        if (nd->witnessHeight == indexHeight - 1 && nd->witnesses.size() > 0) {
             // Check the validity of the cache
             // See comment in CopyPreviousWitnesses about validity.
             assert(nWitnessCacheSize >= nd->witnesses.size());
@@ -1174,7 +1198,7 @@ void UpdateWitnessHeights(NoteDataMap& noteDataMap, int indexHeight, int64_t nWi
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
-        if (nd->witnessHeight < indexHeight) {
+        if (nd->witnessHeight == indexHeight - 1) {
             nd->witnessHeight = indexHeight;
             // Check the validity of the cache
             // See comment in CopyPreviousWitnesses about validity.
@@ -1189,10 +1213,6 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
                                      SaplingMerkleTree& saplingTree)
 {
     LOCK(cs_wallet);
-    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-       ::CopyPreviousWitnesses(wtxItem.second.mapSproutNoteData, pindex->nHeight, nWitnessCacheSize);
-       ::CopyPreviousWitnesses(wtxItem.second.mapSaplingNoteData, pindex->nHeight, nWitnessCacheSize);
-    }
 
     if (nWitnessCacheSize < WITNESS_CACHE_SIZE) {
         nWitnessCacheSize += 1;
@@ -1205,6 +1225,58 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         pblock = &block;
     }
 
+    // Witnesses are maintained lazily: the per-note work below only happens
+    // for blocks that contain notes of ours. For any other block we leave
+    // the cached witnesses where they are; AdvanceNoteWitnesses() rolls them
+    // forward on demand when a witness is actually needed for a spend.
+    bool fBlockHasOurNotes = false;
+    for (const CTransaction& tx : pblock->vtx) {
+        auto mi = mapWallet.find(tx.GetHash());
+        if (mi != mapWallet.end() &&
+                !(mi->second.mapSproutNoteData.empty() && mi->second.mapSaplingNoteData.empty())) {
+            fBlockHasOurNotes = true;
+            break;
+        }
+    }
+    if (fBlockHasOurNotes) {
+        WitnessBlock(pindex, pblock, sproutTree, saplingTree);
+    } else {
+        // Keep the caller's view of the trees consistent with the chain.
+        for (const CTransaction& tx : pblock->vtx) {
+            for (const JSDescription& jsdesc : tx.vJoinSplit) {
+                for (const uint256& note_commitment : jsdesc.commitments) {
+                    sproutTree.append(note_commitment);
+                }
+            }
+            for (const OutputDescription& output : tx.vShieldedOutput) {
+                saplingTree.append(output.cmu);
+            }
+        }
+    }
+
+    // For performance reasons, we write out the witness cache in
+    // CWallet::SetBestChain() (which also ensures that overall consistency
+    // of the wallet.dat is maintained).
+}
+
+void CWallet::WitnessBlock(const CBlockIndex* pindex,
+                           const CBlock* pblockIn,
+                           SproutMerkleTree& sproutTree,
+                           SaplingMerkleTree& saplingTree)
+{
+    AssertLockHeld(cs_wallet);
+    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
+       ::CopyPreviousWitnesses(wtxItem.second.mapSproutNoteData, pindex->nHeight, nWitnessCacheSize);
+       ::CopyPreviousWitnesses(wtxItem.second.mapSaplingNoteData, pindex->nHeight, nWitnessCacheSize);
+    }
+
+    const CBlock* pblock {pblockIn};
+    CBlock block;
+    if (!pblock) {
+        ReadBlockFromDisk(block, pindex, Params().GetConsensus());
+        pblock = &block;
+    }
+
     for (const CTransaction& tx : pblock->vtx) {
         auto hash = tx.GetHash();
         bool txIsOurs = mapWallet.count(hash);
@@ -1250,10 +1322,51 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         ::UpdateWitnessHeights(wtxItem.second.mapSproutNoteData, pindex->nHeight, nWitnessCacheSize);
         ::UpdateWitnessHeights(wtxItem.second.mapSaplingNoteData, pindex->nHeight, nWitnessCacheSize);
     }
+}
 
-    // For performance reasons, we write out the witness cache in
-    // CWallet::SetBestChain() (which also ensures that overall consistency
-    // of the wallet.dat is maintained).
+void CWallet::AdvanceNoteWitnesses()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    int nTipHeight = chainActive.Height();
+
+    // Find the oldest height any cached witness is valid for. Every
+    // witnessed note joins the replay below once it reaches the block
+    // after the note's own witness height.
+    int nMinHeight = nTipHeight;
+    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
+        for (mapSproutNoteData_t::value_type& item : wtxItem.second.mapSproutNoteData) {
+            const SproutNoteData& nd = item.second;
+            if (nd.witnesses.size() > 0 && nd.witnessHeight >= 0 && nd.witnessHeight < nMinHeight) {
+                nMinHeight = nd.witnessHeight;
+            }
+        }
+        for (mapSaplingNoteData_t::value_type& item : wtxItem.second.mapSaplingNoteData) {
+            const SaplingNoteData& nd = item.second;
+            if (nd.witnesses.size() > 0 && nd.witnessHeight >= 0 && nd.witnessHeight < nMinHeight) {
+                nMinHeight = nd.witnessHeight;
+            }
+        }
+    }
+    if (nMinHeight >= nTipHeight) {
+        return;
+    }
+
+    for (int nHeight = nMinHeight + 1; nHeight <= nTipHeight; nHeight++) {
+        const CBlockIndex* pindex = chainActive[nHeight];
+        SproutMerkleTree sproutTree;
+        SaplingMerkleTree saplingTree;
+        // This should never fail: we should always be able to get the tree
+        // state on the path to the tip of our chain
+        assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, sproutTree));
+        if (pindex->pprev) {
+            if (Params().GetConsensus().NetworkUpgradeActive(pindex->pprev->nHeight, Consensus::UPGRADE_SAPLING)) {
+                assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
+            }
+        }
+        WitnessBlock(pindex, NULL, sproutTree, saplingTree);
+    }
 }
 
 template<typename NoteDataMap>
@@ -1261,16 +1374,15 @@ void DecrementNoteWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t n
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
-        // Only decrement witnesses that are not above the current height
-        if (nd->witnessHeight <= indexHeight) {
+        // Only decrement witnesses that have caught up to the block being
+        // removed. A witness lagging behind it never saw the block's note
+        // commitments, so it remains valid on the shorter chain; witnesses
+        // above the current height only occur during a reindex, and by the
+        // time the reindex reaches the tip of the chain again, the existing
+        // witness caches will be valid again.
+        if (nd->witnessHeight == indexHeight) {
             // Check the validity of the cache
-            // See comment below (this would be invalid if there were a
-            // prior decrement).
             assert(nWitnessCacheSize >= nd->witnesses.size());
-            // Witnesses being decremented should always be either -1
-            // (never incremented or decremented) or equal to the height
-            // of the block being removed (indexHeight)
-            assert((nd->witnessHeight == -1) || (nd->witnessHeight == indexHeight));
             if (nd->witnesses.size() > 0) {
                 nd->witnesses.pop_front();
             }
@@ -1278,21 +1390,6 @@ void DecrementNoteWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t n
             // the new witness cache height is one below it.
             nd->witnessHeight = indexHeight - 1;
         }
-        // Check the validity of the cache
-        // Technically if there are notes witnessed above the current
-        // height, their cache will now be invalid (relative to the new
-        // value of nWitnessCacheSize). However, this would only occur
-        // during a reindex, and by the time the reindex reaches the tip
-        // of the chain again, the existing witness caches will be valid
-        // again.
-        // We don't set nWitnessCacheSize to zero at the start of the
-        // reindex because the on-disk blocks had already resulted in a
-        // chain that didn't trigger the assertion below.
-        if (nd->witnessHeight < indexHeight) {
-            // Subtract 1 to compare to what nWitnessCacheSize will be after
-            // decrementing.
-            assert((nWitnessCacheSize - 1) >= nd->witnesses.size());
-        }
     }
 }
 
@@ -1476,6 +1573,7 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
+        MarkBalanceDirty();
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
     }
@@ -1619,10 +1717,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         wtxOrdered.insert(make_pair(wtx.nOrderPos, &wtx));
         UpdateNullifierNoteMapWithTx(mapWallet[hash]);
         AddToSpends(hash);
+        AddToUnspent(wtx);
+        MarkBalanceDirty();
     }
     else
     {
         LOCK(cs_wallet);
+        MarkBalanceDirty();
         // Inserts only if not already there, returns tx inserted or tx found
         pair<map<uint256, CWalletTx>::iterator, bool> ret = mapWallet.insert(make_pair(hash, wtxIn));
         CWalletTx& wtx = (*ret.first).second;
@@ -1674,6 +1775,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            AddToUnspent(wtx);
         }
 
         bool fUpdated = false;
@@ -1777,14 +1879,30 @@ bool CWallet::UpdatedNoteData(const CWalletTx& wtxIn, CWalletTx& wtx)
  * updated; instead, the transaction being in the mempool or conflicted is determined on
  * the fly in CMerkleTx::GetDepthInMainChain().
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, const int nHeight, bool fUpdate)
+bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, const int nHeight, bool fUpdate,
+                                       const BlockNoteScanResults* pScanResults, CWalletDB* pwalletdb)
 {
     {
         AssertLockHeld(cs_wallet);
         bool fExisted = mapWallet.count(tx.GetHash()) != 0;
         if (fExisted && !fUpdate) return false;
-        auto sproutNoteData = FindMySproutNotes(tx);
-        auto saplingNoteDataAndAddressesToAdd = FindMySaplingNotes(tx, nHeight);
+        mapSproutNoteData_t sproutNoteData;
+        std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> saplingNoteDataAndAddressesToAdd;
+        if (pScanResults) {
+            // The block containing this transaction has already been
+            // trial-decrypted by BatchScanNotes; just pick up its results.
+            auto itSprout = pScanResults->sproutNoteData.find(tx.GetHash());
+            if (itSprout != pScanResults->sproutNoteData.end()) {
+                sproutNoteData = itSprout->second;
+            }
+            auto itSapling = pScanResults->saplingNoteData.find(tx.GetHash());
+            if (itSapling != pScanResults->saplingNoteData.end()) {
+                saplingNoteDataAndAddressesToAdd = itSapling->second;
+            }
+        } else {
+            sproutNoteData = FindMySproutNotes(tx);
+            saplingNoteDataAndAddressesToAdd = FindMySaplingNotes(tx, nHeight);
+        }
         auto saplingNoteData = saplingNoteDataAndAddressesToAdd.first;
         auto addressesToAdd = saplingNoteDataAndAddressesToAdd.second;
         for (const auto &addressToAdd : addressesToAdd) {
@@ -1808,6 +1926,11 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
             if (pblock)
                 wtx.SetMerkleBranch(*pblock);
 
+            // Use the caller's database handle if one was supplied, so that
+            // a rescan can group many records into one database transaction.
+            if (pwalletdb)
+                return AddToWallet(wtx, false, pwalletdb);
+
             // Do not flush the wallet here for performance reasons
             // this is safe, as in case of a crash, we rescan the necessary blocks on startup through our SetBestChain-mechanism
             CWalletDB walletdb(strWalletFile, "r+", false);
@@ -1832,6 +1955,7 @@ void CWallet::MarkAffectedTransactionsDirty(const CTransaction& tx)
     // If a transaction changes 'conflicted' state, that changes the balance
     // available of the outputs it spends. So force those to be
     // recomputed, also:
+    MarkBalanceDirty();
     for (const CTxIn& txin : tx.vin)
     {
         if (mapWallet.count(txin.prevout.hash))
@@ -1861,8 +1985,17 @@ void CWallet::EraseFromWallet(const uint256 &hash)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        map<uint256, CWalletTx>::iterator it = mapWallet.find(hash);
+        if (it != mapWallet.end())
+        {
+            for (unsigned int i = 0; i < it->second.vout.size(); i++)
+                setWalletUTXO.erase(COutPoint(hash, i));
+            for (const auto& nd : it->second.mapSaplingNoteData)
+                mapSaplingNotePlaintexts.erase(nd.first);
+            mapWallet.erase(it);
+            MarkBalanceDirty();
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return;
 }
@@ -1996,6 +2129,180 @@ std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> CWallet::FindMySap
     return std::make_pair(noteData, viewingKeysToAdd);
 }
 
+/**
+ * Trial-decrypts every shielded output in the given block against the
+ * wallet's keys, fanning the decryptions out across the available cores, and
+ * collects the per-transaction results.
+ *
+ * The trial decryptions are independent of each other and only read from a
+ * snapshot of the key material, so the workers run without taking any wallet
+ * locks; nullifier derivation and viewing key lookups for the (rare) outputs
+ * that are ours happen in a serial merge step at the end.
+ */
+void CWallet::BatchScanNotes(const CBlock& block, int nHeight, BlockNoteScanResults& results) const
+{
+    // Snapshot the keys to scan with, so that the workers never touch
+    // cs_KeyStore.
+    std::vector<std::pair<libzcash::SproutPaymentAddress, ZCNoteDecryption>> vSproutDecryptors;
+    std::vector<SaplingIncomingViewingKey> vIvk;
+    {
+        LOCK(cs_KeyStore);
+        vSproutDecryptors.assign(mapNoteDecryptors.begin(), mapNoteDecryptors.end());
+        for (const auto& item : mapSaplingFullViewingKeys) {
+            vIvk.push_back(item.first);
+        }
+    }
+
+    // Flatten the block's shielded outputs into work lists.
+    struct SproutWorkItem {
+        const CTransaction* ptx;
+        size_t js;
+        uint8_t n;
+        // Index into vSproutDecryptors of the decryptor that matched, or -1.
+        int matchedKey = -1;
+    };
+    struct SaplingWorkItem {
+        const CTransaction* ptx;
+        uint32_t n;
+        // Index into vIvk of the ivk that decrypted this output, or -1.
+        int matchedKey = -1;
+        std::optional<libzcash::SaplingPaymentAddress> address;
+    };
+    std::vector<SproutWorkItem> vSproutWork;
+    std::vector<SaplingWorkItem> vSaplingWork;
+    for (const CTransaction& tx : block.vtx) {
+        if (!vSproutDecryptors.empty()) {
+            for (size_t i = 0; i < tx.vJoinSplit.size(); i++) {
+                for (uint8_t j = 0; j < tx.vJoinSplit[i].ciphertexts.size(); j++) {
+                    vSproutWork.push_back({&tx, i, j});
+                }
+            }
+        }
+        if (!vIvk.empty()) {
+            for (uint32_t i = 0; i < tx.vShieldedOutput.size(); i++) {
+                vSaplingWork.push_back({&tx, i});
+            }
+        }
+    }
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+
+    auto scanSprout = [&vSproutDecryptors](SproutWorkItem& item) {
+        const JSDescription& jsdesc = item.ptx->vJoinSplit[item.js];
+        auto hSig = ZCJoinSplit::h_sig(
+            jsdesc.randomSeed, jsdesc.nullifiers, item.ptx->joinSplitPubKey);
+        for (size_t k = 0; k < vSproutDecryptors.size(); k++) {
+            try {
+                auto note_pt = libzcash::SproutNotePlaintext::decrypt(
+                    vSproutDecryptors[k].second,
+                    jsdesc.ciphertexts[item.n],
+                    jsdesc.ephemeralKey,
+                    hSig,
+                    (unsigned char) item.n);
+                // Check the note plaintext against the note commitment, as
+                // GetSproutNoteNullifier() would.
+                auto note = note_pt.note(vSproutDecryptors[k].first);
+                if (note.cm() != jsdesc.commitments[item.n]) {
+                    throw libzcash::note_decryption_failed();
+                }
+                item.matchedKey = k;
+                break;
+            } catch (const libzcash::note_decryption_failed &err) {
+                // Couldn't decrypt with this decryptor
+            } catch (const std::exception &exc) {
+                // Unexpected failure
+                LogPrintf("BatchScanNotes(): Unexpected error while testing decrypt:\n");
+                LogPrintf("%s\n", exc.what());
+            }
+        }
+    };
+    auto scanSapling = [&vIvk, &consensus, nHeight](SaplingWorkItem& item) {
+        const OutputDescription& output = item.ptx->vShieldedOutput[item.n];
+        for (size_t k = 0; k < vIvk.size(); k++) {
+            auto result = SaplingNotePlaintext::decrypt(
+                consensus, nHeight, output.encCiphertext, vIvk[k], output.ephemeralKey, output.cmu);
+            if (!result) {
+                continue;
+            }
+            item.matchedKey = k;
+            item.address = vIvk[k].address(result.value().d);
+            break;
+        }
+    };
+
+    // Fan the trial decryptions out across the cores; a strided partition of
+    // the work lists needs no synchronization between the workers.
+    size_t nWork = vSproutWork.size() + vSaplingWork.size();
+    size_t nThreads = std::min<size_t>(std::max(1, GetNumCores()), nWork);
+    if (nThreads > 1) {
+        boost::thread_group workers;
+        for (size_t t = 0; t < nThreads; t++) {
+            workers.create_thread([&, t]() {
+                for (size_t i = t; i < vSproutWork.size(); i += nThreads) {
+                    scanSprout(vSproutWork[i]);
+                }
+                for (size_t i = t; i < vSaplingWork.size(); i += nThreads) {
+                    scanSapling(vSaplingWork[i]);
+                }
+            });
+        }
+        workers.join_all();
+    } else {
+        for (SproutWorkItem& item : vSproutWork) {
+            scanSprout(item);
+        }
+        for (SaplingWorkItem& item : vSaplingWork) {
+            scanSapling(item);
+        }
+    }
+
+    // Merge the results for the outputs that are ours.
+    LOCK(cs_KeyStore);
+    for (const SproutWorkItem& item : vSproutWork) {
+        if (item.matchedKey < 0) {
+            continue;
+        }
+        const auto& decryptor = vSproutDecryptors[item.matchedKey];
+        const JSDescription& jsdesc = item.ptx->vJoinSplit[item.js];
+        auto hSig = ZCJoinSplit::h_sig(
+            jsdesc.randomSeed, jsdesc.nullifiers, item.ptx->joinSplitPubKey);
+        JSOutPoint jsoutpt {item.ptx->GetHash(), item.js, item.n};
+        try {
+            // This repeats one decryption, but only for outputs that are ours,
+            // and it keeps the nullifier derivation single-sourced.
+            auto nullifier = GetSproutNoteNullifier(
+                jsdesc, decryptor.first, decryptor.second, hSig, item.n);
+            if (nullifier) {
+                SproutNoteData nd {decryptor.first, *nullifier};
+                results.sproutNoteData[item.ptx->GetHash()].insert(std::make_pair(jsoutpt, nd));
+            } else {
+                SproutNoteData nd {decryptor.first};
+                results.sproutNoteData[item.ptx->GetHash()].insert(std::make_pair(jsoutpt, nd));
+            }
+        } catch (const std::exception &exc) {
+            // Unexpected failure
+            LogPrintf("BatchScanNotes(): Unexpected error while deriving nullifier:\n");
+            LogPrintf("%s\n", exc.what());
+        }
+    }
+    for (const SaplingWorkItem& item : vSaplingWork) {
+        if (item.matchedKey < 0) {
+            continue;
+        }
+        const SaplingIncomingViewingKey& ivk = vIvk[item.matchedKey];
+        auto& txResults = results.saplingNoteData[item.ptx->GetHash()];
+        if (item.address && mapSaplingIncomingViewingKeys.count(item.address.value()) == 0) {
+            txResults.second[item.address.value()] = ivk;
+        }
+        // We don't cache the nullifier here as computing it requires knowledge of the note position
+        // in the commitment tree, which can only be determined when the transaction has been mined.
+        SaplingOutPoint op {item.ptx->GetHash(), item.n};
+        SaplingNoteData nd;
+        nd.ivk = ivk;
+        txResults.first.insert(std::make_pair(op, nd));
+    }
+}
+
 bool CWallet::IsSproutNullifierFromMe(const uint256& nullifier) const
 {
     {
@@ -2024,19 +2331,24 @@ void CWallet::GetSproutNoteWitnesses(std::vector<JSOutPoint> notes,
                                      std::vector<std::optional<SproutWitness>>& witnesses,
                                      uint256 &final_anchor)
 {
-    LOCK(cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    AdvanceNoteWitnesses();
     witnesses.resize(notes.size());
     std::optional<uint256> rt;
     int i = 0;
     for (JSOutPoint note : notes) {
-        if (mapWallet.count(note.hash) &&
-                mapWallet[note.hash].mapSproutNoteData.count(note) &&
-                mapWallet[note.hash].mapSproutNoteData[note].witnesses.size() > 0) {
-            witnesses[i] = mapWallet[note.hash].mapSproutNoteData[note].witnesses.front();
-            if (!rt) {
-                rt = witnesses[i]->root();
-            } else {
-                assert(*rt == witnesses[i]->root());
+        // The outpoint carries the txid, so one lookup lands on the wallet
+        // transaction and one more on the note's witness stack.
+        auto wit = mapWallet.find(note.hash);
+        if (wit != mapWallet.end()) {
+            auto nd = wit->second.mapSproutNoteData.find(note);
+            if (nd != wit->second.mapSproutNoteData.end() && nd->second.witnesses.size() > 0) {
+                witnesses[i] = nd->second.witnesses.front();
+                if (!rt) {
+                    rt = witnesses[i]->root();
+                } else {
+                    assert(*rt == witnesses[i]->root());
+                }
             }
         }
         i++;
@@ -2051,19 +2363,22 @@ void CWallet::GetSaplingNoteWitnesses(std::vector<SaplingOutPoint> notes,
                                       std::vector<std::optional<SaplingWitness>>& witnesses,
                                       uint256 &final_anchor)
 {
-    LOCK(cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    AdvanceNoteWitnesses();
     witnesses.resize(notes.size());
     std::optional<uint256> rt;
     int i = 0;
     for (SaplingOutPoint note : notes) {
-        if (mapWallet.count(note.hash) &&
-                mapWallet[note.hash].mapSaplingNoteData.count(note) &&
-                mapWallet[note.hash].mapSaplingNoteData[note].witnesses.size() > 0) {
-            witnesses[i] = mapWallet[note.hash].mapSaplingNoteData[note].witnesses.front();
-            if (!rt) {
-                rt = witnesses[i]->root();
-            } else {
-                assert(*rt == witnesses[i]->root());
+        auto wit = mapWallet.find(note.hash);
+        if (wit != mapWallet.end()) {
+            auto nd = wit->second.mapSaplingNoteData.find(note);
+            if (nd != wit->second.mapSaplingNoteData.end() && nd->second.witnesses.size() > 0) {
+                witnesses[i] = nd->second.witnesses.front();
+                if (!rt) {
+                    rt = witnesses[i]->root();
+                } else {
+                    assert(*rt == witnesses[i]->root());
+                }
             }
         }
         i++;
@@ -2586,6 +2901,18 @@ int CWalletTx::GetRequestCount() const
 void CWalletTx::GetAmounts(std::list<COutputEntry>& listReceived,
                            std::list<COutputEntry>& listSent, CAmount& nFee, const isminefilter& filter) const
 {
+    // The decomposition only depends on wallet state already tracked by
+    // MarkDirty(), so memoize it like the balance caches; the transaction
+    // enumeration RPCs call this for every wallet transaction while holding
+    // cs_wallet, and the cache keeps that critical section short.
+    if (fAmountsCached && filterAmountsCached == filter)
+    {
+        listReceived = listReceivedCached;
+        listSent = listSentCached;
+        nFee = nAmountsFeeCached;
+        return;
+    }
+
     nFee = 0;
     listReceived.clear();
     listSent.clear();
@@ -2695,6 +3022,11 @@ void CWalletTx::GetAmounts(std::list<COutputEntry>& listReceived,
             listReceived.push_back(output);
     }
 
+    listReceivedCached = listReceived;
+    listSentCached = listSent;
+    nAmountsFeeCached = nFee;
+    filterAmountsCached = filter;
+    fAmountsCached = true;
 }
 
 void CWallet::WitnessNoteCommitment(std::vector<uint256> commitments,
@@ -2782,18 +3114,68 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
-        while (pindex)
+
+        // Reuse a single database handle for the whole rescan and group the
+        // records into larger database transactions; otherwise every matched
+        // transaction autocommits (and logs) its write individually.
+        // Do not flush the wallet here for performance reasons.
+        CWalletDB walletdb(strWalletFile, "r+", false);
+        bool fBatch = walletdb.TxnBegin();
+        unsigned int nBatched = 0;
+
+        // Snapshot the indexes to scan. cs_main is held for the whole scan,
+        // so the active chain cannot move underneath the reader thread.
+        std::vector<CBlockIndex*> vToScan;
+        for (CBlockIndex* p = pindex; p != NULL; p = chainActive.Next(p))
+            vToScan.push_back(p);
+
+        // Read-ahead pipeline: a reader thread prefetches blocks from disk
+        // while this thread trial-decrypts and commits the previous ones,
+        // overlapping the I/O with the CPU work. The queue is bounded so
+        // only a few blocks are held in memory at a time.
+        static const size_t RESCAN_READAHEAD = 4;
+        std::mutex readMutex;
+        std::condition_variable readCond;
+        std::deque<CBlock> readQueue;
+        boost::thread reader([&]() {
+            for (CBlockIndex* p : vToScan) {
+                CBlock blockIn;
+                ReadBlockFromDisk(blockIn, p, Params().GetConsensus());
+                std::unique_lock<std::mutex> lock(readMutex);
+                readCond.wait(lock, [&]() { return readQueue.size() < RESCAN_READAHEAD; });
+                readQueue.push_back(std::move(blockIn));
+                readCond.notify_all();
+            }
+        });
+
+        for (size_t nScanned = 0; nScanned < vToScan.size(); nScanned++)
         {
+            pindex = vToScan[nScanned];
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
             CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
+            {
+                std::unique_lock<std::mutex> lock(readMutex);
+                readCond.wait(lock, [&]() { return !readQueue.empty(); });
+                block = std::move(readQueue.front());
+                readQueue.pop_front();
+                readCond.notify_all();
+            }
+            // Trial-decrypt the block's shielded outputs across all cores
+            // before walking its transactions.
+            BlockNoteScanResults scanResults;
+            BatchScanNotes(block, pindex->nHeight, scanResults);
             for (CTransaction& tx : block.vtx)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, pindex->nHeight, fUpdate)) {
+                if (AddToWalletIfInvolvingMe(tx, &block, pindex->nHeight, fUpdate, &scanResults, &walletdb)) {
                     myTxHashes.push_back(tx.GetHash());
                     ret++;
+                    if (fBatch && ++nBatched % WALLET_RESCAN_TXN_BATCH == 0) {
+                        if (!walletdb.TxnCommit())
+                            LogPrintf("Rescanning... failed to commit batched wallet writes\n");
+                        fBatch = walletdb.TxnBegin();
+                    }
                 }
             }
 
@@ -2810,16 +3192,14 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
             // Increment note witness caches
             ChainTipAdded(pindex, &block, sproutTree, saplingTree);
 
-            pindex = chainActive.Next(pindex);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
             }
         }
+        reader.join();
 
         // After rescanning, persist Sapling note data that might have changed, e.g. nullifiers.
-        // Do not flush the wallet here for performance reasons.
-        CWalletDB walletdb(strWalletFile, "r+", false);
         for (auto hash : myTxHashes) {
             CWalletTx wtx = mapWallet[hash];
             if (!wtx.mapSaplingNoteData.empty()) {
@@ -2829,6 +3209,9 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
             }
         }
 
+        if (fBatch && !walletdb.TxnCommit())
+            LogPrintf("Rescanning... failed to commit batched wallet writes\n");
+
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
     return ret;
@@ -3149,6 +3532,14 @@ CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) con
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
+        // Trust and depth change as blocks connect, so the cached aggregate
+        // is only valid while the tip the wallet last summed against is
+        // still the active tip.
+        if (fBalanceCached && filterBalanceCached == filter &&
+            nMinDepthBalanceCached == min_depth && pindexBalanceCached == chainActive.Tip())
+        {
+            return nBalanceCached;
+        }
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
@@ -3156,6 +3547,11 @@ CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) con
                 nTotal += pcoin->GetAvailableCredit(true, filter);
             }
         }
+        nBalanceCached = nTotal;
+        filterBalanceCached = filter;
+        nMinDepthBalanceCached = min_depth;
+        pindexBalanceCached = chainActive.Tip();
+        fBalanceCached = true;
     }
 
     return nTotal;
@@ -3290,53 +3686,147 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins,
     vCoins.clear();
 
     {
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        // Walk the maintained unspent-output candidates instead of every
+        // wallet transaction. setWalletUTXO is ordered by txid, so the
+        // transaction-level checks run once per transaction; every surviving
+        // candidate is still re-validated in full below.
+        const CWalletTx* pcoin = NULL;
+        uint256 wtxid;
+        bool fSkipTx = false;
+        int nDepth = 0;
+        bool isCoinbase = false;
+        for (const COutPoint& outpoint : setWalletUTXO)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            if (pcoin == NULL || outpoint.hash != wtxid)
+            {
+                wtxid = outpoint.hash;
+                pcoin = NULL;
+                fSkipTx = true;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                if (it == mapWallet.end())
+                    continue;
+                pcoin = &it->second;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (pcoin->IsCoinBase() && !fIncludeCoinBase)
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
 
-            bool isCoinbase = pcoin->IsCoinBase();
-            if (isCoinbase && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                isCoinbase = pcoin->IsCoinBase();
+                if (isCoinbase && !fIncludeCoinBase)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain();
-            if (nDepth < nMinDepth)
+                if (isCoinbase && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
+
+                nDepth = pcoin->GetDepthInMainChain();
+                if (nDepth < nMinDepth)
+                    continue;
+
+                fSkipTx = false;
+            }
+            if (fSkipTx || pcoin == NULL || outpoint.n >= pcoin->vout.size())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                const auto& output = pcoin->vout[i];
-                isminetype mine = IsMine(output);
+            unsigned int i = outpoint.n;
+            const auto& output = pcoin->vout[i];
+            isminetype mine = IsMine(output);
 
-                bool isSpendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                    (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
+            bool isSpendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
 
-                if (fOnlySpendable && !isSpendable)
-                    continue;
+            if (fOnlySpendable && !isSpendable)
+                continue;
 
-                // Filter by specific destinations if needed
-                if (onlyFilterByDests && !onlyFilterByDests->empty()) {
-                    CTxDestination address;
-                    if (!ExtractDestination(output.scriptPubKey, address) || onlyFilterByDests->count(address) == 0) {
-                        continue;
-                    }
+            // Filter by specific destinations if needed
+            if (onlyFilterByDests && !onlyFilterByDests->empty()) {
+                CTxDestination address;
+                if (!ExtractDestination(output.scriptPubKey, address) || onlyFilterByDests->count(address) == 0) {
+                    continue;
                 }
+            }
+
+            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                !IsLockedCoin(wtxid, i) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
+                    vCoins.push_back(COutput(pcoin, i, nDepth, isSpendable, isCoinbase));
+        }
+    }
+}
 
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    !IsLockedCoin((*it).first, i) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
-                        vCoins.push_back(COutput(pcoin, i, nDepth, isSpendable, isCoinbase));
+/** Deterministic branch-and-bound search for a subset whose total lands in
+ *  [nTargetValue, nTargetValue + nCostOfChange]. Such a selection leaves an
+ *  excess small enough to fold into the fee, so no change output is created.
+ *  vValue must be sorted by value, largest first; the search explores
+ *  inclusion before omission, prunes branches that overshoot the window or
+ *  cannot reach the target with the remaining coins, and gives up after a
+ *  fixed number of node visits so the cost stays flat on large wallets.
+ *  Returns true and fills vfBest/nBest with the lowest-total solution found.
+ */
+static bool SelectCoinsBnB(const vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >& vValue,
+                           const CAmount& nTargetValue, const CAmount& nCostOfChange,
+                           vector<char>& vfBest, CAmount& nBest)
+{
+    static const int TOTAL_TRIES = 100000;
+
+    vfBest.clear();
+    nBest = 0;
+    bool fFound = false;
+
+    CAmount nLookahead = 0;
+    for (unsigned int i = 0; i < vValue.size(); i++)
+        nLookahead += vValue[i].first;
+    if (nLookahead < nTargetValue)
+        return false;
+
+    // vfIncluded holds the decision for each coin considered so far; its size
+    // is the current search depth.
+    vector<char> vfIncluded;
+    CAmount nTotal = 0;
+
+    for (int nTries = 0; nTries < TOTAL_TRIES; nTries++)
+    {
+        bool fBacktrack = false;
+        if (nTotal + nLookahead < nTargetValue ||         // cannot reach the target anymore
+            nTotal > nTargetValue + nCostOfChange ||      // overshot the window
+            (fFound && nTotal >= nBest)) {                // cannot beat the best solution
+            fBacktrack = true;
+        } else if (nTotal >= nTargetValue) {
+            // Inside the window; remember it and keep looking for a tighter fit.
+            fFound = true;
+            nBest = nTotal;
+            vfBest = vfIncluded;
+            vfBest.resize(vValue.size(), false);
+            if (nBest == nTargetValue)
+                break;
+            fBacktrack = true;
+        } else if (vfIncluded.size() >= vValue.size()) {
+            fBacktrack = true;
+        } else {
+            // Explore including the next coin first.
+            nLookahead -= vValue[vfIncluded.size()].first;
+            nTotal += vValue[vfIncluded.size()].first;
+            vfIncluded.push_back(true);
+        }
+
+        if (fBacktrack)
+        {
+            // Unwind omissions, then turn the most recent inclusion into an
+            // omission and explore that half of the tree.
+            while (!vfIncluded.empty() && !vfIncluded.back()) {
+                vfIncluded.pop_back();
+                nLookahead += vValue[vfIncluded.size()].first;
             }
+            if (vfIncluded.empty())
+                break;
+            vfIncluded.back() = false;
+            nTotal -= vValue[vfIncluded.size() - 1].first;
         }
     }
+
+    return fFound;
 }
 
 static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
@@ -3451,11 +3941,30 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
         return true;
     }
 
-    // Solve subset sum by stochastic approximation
     sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
     vector<char> vfBest;
     CAmount nBest;
 
+    // First try a changeless selection: if a subset overshoots the target by
+    // no more than the dust threshold of a change output, CreateTransaction
+    // folds the excess into the fee instead of creating change.
+    {
+        CTxOut txoutChangeDummy(0, GetScriptForDestination(CKeyID()));
+        const CAmount nCostOfChange = txoutChangeDummy.GetDustThreshold(::minRelayTxFee);
+        if (SelectCoinsBnB(vValue, nTargetValue, nCostOfChange, vfBest, nBest))
+        {
+            for (unsigned int i = 0; i < vValue.size(); i++)
+                if (vfBest[i])
+                {
+                    setCoinsRet.insert(vValue[i].second);
+                    nValueRet += vValue[i].first;
+                }
+            LogPrint("selectcoins", "SelectCoins() changeless subset, total %s\n", FormatMoney(nBest));
+            return true;
+        }
+    }
+
+    // Solve subset sum by stochastic approximation
     ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
     if (nBest != nTargetValue && nTotalLower >= nTargetValue + MIN_CHANGE)
         ApproximateBestSubset(vValue, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest);
@@ -3853,7 +4362,10 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
                 // Grab the current consensus branch ID
                 auto consensusBranchId = CurrentEpochBranchId(chainActive.Height() + 1, Params().GetConsensus());
 
-                // Sign
+                // Sign. Keep keys decrypted for the whole input batch so an
+                // encrypted wallet decrypts each signing key once rather than
+                // once per input.
+                CKeyStoreSigningSession signingSession(*this);
                 int nIn = 0;
                 CTransaction txNewConst(txNew);
                 for (const std::pair<const CWalletTx*, unsigned int>& coin : setCoins)
@@ -4173,8 +4685,6 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         if (IsLocked())
             return false;
 
-        CWalletDB walletdb(strWalletFile);
-
         // Top up key pool
         unsigned int nTargetSize;
         if (kpSize > 0)
@@ -4182,16 +4692,38 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         else
             nTargetSize = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
 
-        while (setKeyPool.size() < (nTargetSize + 1))
-        {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty())
-                nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
-                throw runtime_error("TopUpKeyPool(): writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+        if (setKeyPool.size() >= nTargetSize + 1)
+            return true;
+
+        // Commit the whole refill as one database transaction; key and pool
+        // records are routed through the same handle via pwalletdbKeyPool,
+        // so a large drain is topped back up in a single write burst instead
+        // of one autocommitted transaction per key.
+        CWalletDB walletdb(strWalletFile, "r+", false);
+        bool fBatch = walletdb.TxnBegin();
+        pwalletdbKeyPool = &walletdb;
+        int64_t nGenerated = 0;
+        try {
+            while (setKeyPool.size() < (nTargetSize + 1))
+            {
+                int64_t nEnd = 1;
+                if (!setKeyPool.empty())
+                    nEnd = *(--setKeyPool.end()) + 1;
+                if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
+                    throw runtime_error("TopUpKeyPool(): writing generated key failed");
+                setKeyPool.insert(nEnd);
+                nGenerated++;
+            }
+        } catch (...) {
+            pwalletdbKeyPool = NULL;
+            if (fBatch)
+                walletdb.TxnAbort();
+            throw;
         }
+        pwalletdbKeyPool = NULL;
+        if (fBatch && !walletdb.TxnCommit())
+            throw runtime_error("TopUpKeyPool(): committing generated keys failed");
+        LogPrintf("keypool added %d keys, size=%u\n", nGenerated, setKeyPool.size());
     }
     return true;
 }
@@ -4752,6 +5284,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
         strUsage += HelpMessageOpt("-dblogsize=<n>", strprintf("Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)", DEFAULT_WALLET_DBLOGSIZE));
         strUsage += HelpMessageOpt("-flushwallet", strprintf("Run a thread to flush wallet periodically (default: %u)", DEFAULT_FLUSHWALLET));
         strUsage += HelpMessageOpt("-privdb", strprintf("Sets the DB_PRIVATE flag in the wallet db environment (default: %u)", DEFAULT_WALLET_PRIVDB));
+        strUsage += HelpMessageOpt("-walletflushcap=<n>", strprintf("Wallet updates that may accumulate without a self-contained flush before the flush thread blocks for the database lock (default: %u)", DEFAULT_WALLET_FLUSH_UPDATE_CAP));
     }
 
     return strUsage;
@@ -5066,6 +5599,33 @@ bool CMerkleTx::AcceptToMemoryPool(bool fLimitFree, bool fRejectAbsurdFee)
     return ::AcceptToMemoryPool(Params(), mempool, state, *this, fLimitFree, NULL, fRejectAbsurdFee);
 }
 
+std::pair<libzcash::SaplingPaymentAddress, libzcash::SaplingNotePlaintext> CWallet::GetCachedSaplingNotePlaintext(
+    const CWalletTx& wtx,
+    const SaplingOutPoint& op,
+    const SaplingNoteData& nd)
+{
+    AssertLockHeld(cs_wallet);
+
+    auto it = mapSaplingNotePlaintexts.find(op);
+    if (it != mapSaplingNotePlaintexts.end()) {
+        return it->second;
+    }
+
+    auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
+
+    // The transaction would not have entered the wallet unless
+    // its plaintext had been successfully decrypted previously.
+    assert(optDeserialized != std::nullopt);
+
+    auto notePt = optDeserialized.value();
+    auto maybe_pa = nd.ivk.address(notePt.d);
+    assert(static_cast<bool>(maybe_pa));
+
+    auto entry = std::make_pair(maybe_pa.value(), notePt);
+    mapSaplingNotePlaintexts.insert(std::make_pair(op, entry));
+    return entry;
+}
+
 /**
  * Find notes in the wallet filtered by payment address, min depth and ability to spend.
  * These notes are decrypted and added to the output parameter vector, outEntries.
@@ -5110,7 +5670,7 @@ void CWallet::GetFilteredNotes(
 
     KeyIO keyIO(Params());
     for (auto & p : mapWallet) {
-        CWalletTx wtx = p.second;
+        const CWalletTx& wtx = p.second;
 
         // Filter the transactions before checking for notes
         if (!CheckFinalTx(wtx) ||
@@ -5188,16 +5748,9 @@ void CWallet::GetFilteredNotes(
             SaplingOutPoint op = pair.first;
             SaplingNoteData nd = pair.second;
 
-            auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
-
-            // The transaction would not have entered the wallet unless
-            // its plaintext had been successfully decrypted previously.
-            assert(optDeserialized != std::nullopt);
-
-            auto notePt = optDeserialized.value();
-            auto maybe_pa = nd.ivk.address(notePt.d);
-            assert(static_cast<bool>(maybe_pa));
-            auto pa = maybe_pa.value();
+            auto decrypted = GetCachedSaplingNotePlaintext(wtx, op, nd);
+            auto pa = decrypted.first;
+            auto notePt = decrypted.second;
 
             // skip notes which belong to a different payment address in the wallet
             if (!(filterAddresses.empty() || filterAddresses.count(pa))) {
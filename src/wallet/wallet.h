@@ -66,6 +66,8 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 2;
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 static const bool DEFAULT_WALLETBROADCAST = true;
+//! Number of wallet records written per grouped database transaction during rescan
+static const unsigned int WALLET_RESCAN_TXN_BATCH = 1000;
 //! Size of witness cache
 //  Should be large enough that we can expect not to reorg beyond our cache
 //  unless there is some exceptional network disruption.
@@ -241,10 +243,10 @@ public:
      * Block height corresponding to the most current witness.
      *
      * When we first create a SproutNoteData in CWallet::FindMySproutNotes, this is set to
-     * -1 as a placeholder. The next time CWallet::ChainTip is called, we can
-     * determine what height the witness cache for this note is valid for (even
-     * if no witnesses were cached), and so can set the correct value in
-     * CWallet::IncrementNoteWitnesses and CWallet::DecrementNoteWitnesses.
+     * -1 as a placeholder, and is given its correct value when the note is
+     * witnessed in CWallet::IncrementNoteWitnesses. Because witnesses are
+     * maintained lazily, this may lag behind the chain tip until the note's
+     * witness is rolled forward by CWallet::AdvanceNoteWitnesses.
      */
     int witnessHeight;
 
@@ -320,6 +322,20 @@ public:
 typedef std::map<JSOutPoint, SproutNoteData> mapSproutNoteData_t;
 typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
 
+/**
+ * Trial-decryption results for all shielded outputs of a single block, keyed
+ * by transaction hash.
+ *
+ * Produced by CWallet::BatchScanNotes, which fans the trial decryptions out
+ * across worker threads, and consumed by CWallet::AddToWalletIfInvolvingMe in
+ * place of the single-threaded FindMySproutNotes/FindMySaplingNotes calls.
+ */
+struct BlockNoteScanResults
+{
+    std::map<uint256, mapSproutNoteData_t> sproutNoteData;
+    std::map<uint256, std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> saplingNoteData;
+};
+
 /** Sprout note, its location in a transaction, and number of confirmations. */
 struct SproutNoteEntry
 {
@@ -462,6 +478,11 @@ public:
     mutable CAmount nImmatureWatchCreditCached;
     mutable CAmount nAvailableWatchCreditCached;
     mutable CAmount nChangeCached;
+    mutable bool fAmountsCached;
+    mutable isminefilter filterAmountsCached;
+    mutable std::list<COutputEntry> listReceivedCached;
+    mutable std::list<COutputEntry> listSentCached;
+    mutable CAmount nAmountsFeeCached;
 
     CWalletTx()
     {
@@ -512,6 +533,11 @@ public:
         nAvailableWatchCreditCached = 0;
         nImmatureWatchCreditCached = 0;
         nChangeCached = 0;
+        fAmountsCached = false;
+        filterAmountsCached = ISMINE_NO;
+        listReceivedCached.clear();
+        listSentCached.clear();
+        nAmountsFeeCached = 0;
         nOrderPos = -1;
     }
 
@@ -572,6 +598,7 @@ public:
         fImmatureWatchCreditCached = false;
         fDebitCached = false;
         fChangeCached = false;
+        fAmountsCached = false;
     }
 
     void BindWallet(CWallet *pwalletIn)
@@ -688,6 +715,10 @@ private:
 
     CWalletDB *pwalletdbEncryption;
 
+    //! When non-NULL, key writes go through this handle so that a keypool
+    //! refill commits as a single database transaction (see TopUpKeyPool).
+    CWalletDB *pwalletdbKeyPool;
+
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion;
 
@@ -700,6 +731,21 @@ private:
     int nSetChainUpdates;
     bool fBroadcastTransactions;
 
+    /**
+     * Cached result of GetBalance(). Transaction trust and depth change as
+     * blocks connect, so the cache is keyed on the chain tip in addition to
+     * the filter and depth arguments, and is invalidated whenever the wallet
+     * contents change. Protected by cs_wallet.
+     */
+    mutable bool fBalanceCached;
+    mutable CAmount nBalanceCached;
+    mutable isminefilter filterBalanceCached;
+    mutable int nMinDepthBalanceCached;
+    mutable const CBlockIndex* pindexBalanceCached;
+
+    //! Discard the cached GetBalance() result. Requires cs_wallet to be held.
+    void MarkBalanceDirty() const { fBalanceCached = false; }
+
     template <class T>
     using TxSpendMap = std::multimap<T, uint256>;
     /**
@@ -717,6 +763,24 @@ private:
     TxNullifiers mapTxSproutNullifiers;
     TxNullifiers mapTxSaplingNullifiers;
 
+    /**
+     * Memoized Sapling note decryption results, keyed by outpoint. A note's
+     * plaintext never changes once its transaction is in the wallet, so each
+     * note is trial-decrypted at most once per session; repeated note
+     * selection passes (z_sendmany, z_listunspent) over a large wallet then
+     * reduce to map lookups plus the cheap per-note filters. Decryption only
+     * needs the incoming viewing key, so the cache fills on locked wallets
+     * too. Memory-only: SaplingNoteData is serialized to disk, so nothing is
+     * added there. A stale entry cannot give a wrong answer (the plaintext
+     * for an outpoint is immutable), so eviction is only about memory; we
+     * drop entries when their transaction is erased. Protected by cs_wallet.
+     */
+    std::map<SaplingOutPoint, std::pair<libzcash::SaplingPaymentAddress, libzcash::SaplingNotePlaintext>> mapSaplingNotePlaintexts;
+
+    //! Return the (address, plaintext) for a Sapling note we own, decrypting
+    //! and memoizing it on first use. Requires cs_wallet to be held.
+    std::pair<libzcash::SaplingPaymentAddress, libzcash::SaplingNotePlaintext> GetCachedSaplingNotePlaintext(const CWalletTx& wtx, const SaplingOutPoint& op, const SaplingNoteData& nd);
+
     std::vector<CTransaction> pendingSaplingMigrationTxs;
     AsyncRPCOperationId saplingMigrationOperationId;
 
@@ -724,6 +788,7 @@ private:
     void AddToSproutSpends(const uint256& nullifier, const uint256& wtxid);
     void AddToSaplingSpends(const uint256& nullifier, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
+    void AddToUnspent(const CWalletTx& wtx);
 
 public:
     /*
@@ -739,11 +804,31 @@ public:
 protected:
     /**
      * pindex is the new tip being connected.
+     *
+     * Witnesses are maintained lazily: blocks that do not contain any of
+     * our notes leave the cached witnesses untouched, and the witnesses
+     * are rolled forward on demand by AdvanceNoteWitnesses() when they are
+     * actually needed to build a spend.
      */
     void IncrementNoteWitnesses(const CBlockIndex* pindex,
                                 const CBlock* pblock,
                                 SproutMerkleTree& sproutTree,
                                 SaplingMerkleTree& saplingTree);
+    /**
+     * Apply the note commitments of a single block to the witness cache,
+     * witnessing any of our notes the block contains. The trees must be in
+     * the state they had immediately before the block was connected.
+     */
+    void WitnessBlock(const CBlockIndex* pindex,
+                      const CBlock* pblock,
+                      SproutMerkleTree& sproutTree,
+                      SaplingMerkleTree& saplingTree);
+    /**
+     * Roll witnesses that lag behind the current chain tip forward by
+     * replaying the note commitments of the intervening blocks. Requires
+     * cs_main and cs_wallet to be held.
+     */
+    void AdvanceNoteWitnesses();
     /**
      * pindex is the old tip being disconnected.
      */
@@ -857,11 +942,17 @@ public:
         fFileBacked = false;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
+        pwalletdbKeyPool = NULL;
         nOrderPosNext = 0;
         nNextResend = 0;
         nLastResend = 0;
         nLastSetChain = 0;
         nSetChainUpdates = 0;
+        fBalanceCached = false;
+        nBalanceCached = 0;
+        filterBalanceCached = ISMINE_NO;
+        nMinDepthBalanceCached = 0;
+        pindexBalanceCached = NULL;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nWitnessCacheSize = 0;
@@ -925,6 +1016,15 @@ public:
     typedef std::multimap<int64_t, CWalletTx*> TxItems;
     TxItems wtxOrdered;
 
+    /**
+     * Candidate set of unspent transparent wallet outputs, maintained
+     * incrementally: outputs that are ours enter when their transaction is
+     * added to the wallet and leave when a spend of them is recorded. Readers
+     * must still re-validate candidates (IsSpent, IsMine, locks, depth), so a
+     * stale entry costs a lookup, never a wrong answer.
+     */
+    std::set<COutPoint> setWalletUTXO;
+
     int64_t nOrderPosNext;
     std::map<uint256, int> mapRequestCount;
 
@@ -1102,7 +1202,10 @@ public:
     void UpdateSaplingNullifierNoteMapForBlock(const CBlock* pblock);
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock, const int nHeight);
-    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, const int nHeight, bool fUpdate);
+    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, const int nHeight, bool fUpdate,
+                                  const BlockNoteScanResults* pScanResults = nullptr,
+                                  CWalletDB* pwalletdb = nullptr);
+    void BatchScanNotes(const CBlock& block, int nHeight, BlockNoteScanResults& results) const;
     void EraseFromWallet(const uint256 &hash);
     void WitnessNoteCommitment(
          std::vector<uint256> commitments,
@@ -338,7 +338,13 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             CWalletTx wtx;
             ssValue >> wtx;
             CValidationState state;
-            auto verifier = ProofVerifier::Strict();
+            // These transactions were fully verified when they entered the
+            // wallet, so re-proving every JoinSplit here only slows startup
+            // down on wallets with a long shielded history. Keep the
+            // structural checks and the hash binding to catch corrupt
+            // records; Orchard authorizations are still batch-validated
+            // once after the load loop.
+            auto verifier = ProofVerifier::Disabled();
             if (!(
                 CheckTransaction(wtx, state, verifier, wss.orchardAuth) &&
                 (wtx.GetHash() == hash) &&
@@ -949,6 +955,41 @@ DBErrors CWalletDB::ZapWalletTx(CWallet* pwallet, vector<CWalletTx>& vWtx)
     return DB_LOAD_OK;
 }
 
+// Reset the wallet file LSNs so it is self contained. Requires bitdb.cs_db;
+// does nothing if any database is still in use.
+static void CheckpointWalletFile(const string& strFile, unsigned int& nLastFlushed)
+{
+    AssertLockHeld(bitdb.cs_db);
+
+    // Don't do this if any databases are in use
+    int nRefCount = 0;
+    map<string, int>::iterator mi = bitdb.mapFileUseCount.begin();
+    while (mi != bitdb.mapFileUseCount.end())
+    {
+        nRefCount += (*mi).second;
+        mi++;
+    }
+
+    if (nRefCount == 0)
+    {
+        boost::this_thread::interruption_point();
+        map<string, int>::iterator mi = bitdb.mapFileUseCount.find(strFile);
+        if (mi != bitdb.mapFileUseCount.end())
+        {
+            LogPrint("db", "Flushing %s\n", strFile);
+            nLastFlushed = CWalletDB::GetUpdateCounter();
+            int64_t nStart = GetTimeMillis();
+
+            // Flush wallet file so it's self contained
+            bitdb.CloseDb(strFile);
+            bitdb.CheckpointLSN(strFile);
+
+            bitdb.mapFileUseCount.erase(mi);
+            LogPrint("db", "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
+        }
+    }
+}
+
 void ThreadFlushWalletDB(const string& strFile)
 {
     // Make this thread recognisable as the wallet flushing thread
@@ -964,6 +1005,7 @@ void ThreadFlushWalletDB(const string& strFile)
     unsigned int nLastSeen = CWalletDB::GetUpdateCounter();
     unsigned int nLastFlushed = CWalletDB::GetUpdateCounter();
     int64_t nLastWalletUpdate = GetTime();
+    unsigned int nUpdateCap = GetArg("-walletflushcap", DEFAULT_WALLET_FLUSH_UPDATE_CAP);
     while (true)
     {
         MilliSleep(500);
@@ -976,35 +1018,26 @@ void ThreadFlushWalletDB(const string& strFile)
 
         if (nLastFlushed != CWalletDB::GetUpdateCounter() && GetTime() - nLastWalletUpdate >= 2)
         {
-            TRY_LOCK(bitdb.cs_db,lockDb);
-            if (lockDb)
-            {
-                // Don't do this if any databases are in use
-                int nRefCount = 0;
-                map<string, int>::iterator mi = bitdb.mapFileUseCount.begin();
-                while (mi != bitdb.mapFileUseCount.end())
-                {
-                    nRefCount += (*mi).second;
-                    mi++;
-                }
+            // Checkpoint without cs_db first: concurrent wallet operations
+            // keep running while BDB writes out the dirty pages, and the
+            // LSN reset below is then brief.
+            bitdb.Checkpoint();
+            boost::this_thread::interruption_point();
 
-                if (nRefCount == 0)
+            if (CWalletDB::GetUpdateCounter() - nLastFlushed >= nUpdateCap)
+            {
+                // The log has outgrown the cap without a self-contained
+                // flush (a busy wallet keeps winning the TRY_LOCK below),
+                // so block for the lock this time.
+                LOCK(bitdb.cs_db);
+                CheckpointWalletFile(strFile, nLastFlushed);
+            }
+            else
+            {
+                TRY_LOCK(bitdb.cs_db,lockDb);
+                if (lockDb)
                 {
-                    boost::this_thread::interruption_point();
-                    map<string, int>::iterator mi = bitdb.mapFileUseCount.find(strFile);
-                    if (mi != bitdb.mapFileUseCount.end())
-                    {
-                        LogPrint("db", "Flushing %s\n", strFile);
-                        nLastFlushed = CWalletDB::GetUpdateCounter();
-                        int64_t nStart = GetTimeMillis();
-
-                        // Flush wallet file so it's self contained
-                        bitdb.CloseDb(strFile);
-                        bitdb.CheckpointLSN(strFile);
-
-                        bitdb.mapFileUseCount.erase(mi);
-                        LogPrint("db", "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
-                    }
+                    CheckpointWalletFile(strFile, nLastFlushed);
                 }
             }
         }
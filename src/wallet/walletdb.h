@@ -19,6 +19,9 @@
 #include <vector>
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Wallet updates that may accumulate without a self-contained flush before
+//! the flush thread blocks for the database lock instead of skipping a pass.
+static const unsigned int DEFAULT_WALLET_FLUSH_UPDATE_CAP = 10000;
 
 struct CBlockLocator;
 class CKeyPool;
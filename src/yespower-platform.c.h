@@ -60,6 +60,18 @@ static void *alloc_region(yespower_region_t *region, size_t size)
 		base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
 	}
 
+#ifdef MADV_HUGEPAGE
+/*
+ * Regions below HUGEPAGE_THRESHOLD are mapped with normal pages; ask for
+ * transparent huge pages so the scrypt-like random walk over the region
+ * doesn't thrash the TLB on every hash.  Best effort; the madvise() must
+ * happen before the pre-fault pass below so the pages can be assembled as
+ * huge at fault time.
+ */
+	if (base != MAP_FAILED && !(flags & MAP_HUGETLB))
+		(void)madvise(base, base_size, MADV_HUGEPAGE);
+#endif
+
 #else
 	base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
 #endif
@@ -79,6 +91,17 @@ static void *alloc_region(yespower_region_t *region, size_t size)
 		aligned -= (uintptr_t)aligned & 63;
 	}
 #endif
+/*
+ * Pre-fault the region so neither the first hash on this thread nor the
+ * kernel's on-demand page assembly runs inside the timed hot path.  The
+ * region is reused for the lifetime of the thread, so this runs once.
+ */
+	if (aligned) {
+		size_t i;
+		for (i = 0; i < size; i += 4096)
+			aligned[i] = 0;
+	}
+
 	region->base = base;
 	region->aligned = aligned;
 	region->base_size = base ? base_size : 0;
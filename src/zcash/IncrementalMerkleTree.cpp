@@ -26,6 +26,32 @@ PedersenHash PedersenHash::combine(
     return res;
 }
 
+std::vector<PedersenHash> PedersenHash::combine_batch(
+    const std::vector<PedersenHash>& nodes,
+    size_t depth
+)
+{
+    assert(nodes.size() % 2 == 0);
+
+    std::vector<PedersenHash> res(nodes.size() / 2);
+    if (res.empty()) {
+        return res;
+    }
+
+    // PedersenHash is a bare 32-byte uint256, so the vector of nodes is
+    // already the contiguous array of 64-byte (left, right) pairs the FFI
+    // expects.
+    static_assert(sizeof(PedersenHash) == 32);
+    librustzcash_merkle_hash_batch(
+        depth,
+        nodes.data()->begin(),
+        res.size(),
+        res.data()->begin()
+    );
+
+    return res;
+}
+
 PedersenHash PedersenHash::uncommitted() {
     PedersenHash res = PedersenHash();
 
@@ -435,6 +461,25 @@ SHA256Compress SHA256Compress::combine(
     return res;
 }
 
+std::vector<SHA256Compress> SHA256Compress::combine_batch(
+    const std::vector<SHA256Compress>& nodes,
+    size_t depth
+)
+{
+    assert(nodes.size() % 2 == 0);
+
+    // The SHA256 compression function is cheap enough that there is nothing
+    // to gain from batching; this just satisfies the interface append_batch
+    // expects of its Hash parameter.
+    std::vector<SHA256Compress> res;
+    res.reserve(nodes.size() / 2);
+    for (size_t i = 0; i < nodes.size(); i += 2) {
+        res.push_back(combine(nodes[i], nodes[i+1], depth));
+    }
+
+    return res;
+}
+
 static const std::array<SHA256Compress, 66> sha256_empty_roots = {
     uint256(std::vector<unsigned char>{
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -952,6 +997,73 @@ void IncrementalMerkleTree<Depth, Hash>::append(Hash obj) {
     }
 }
 
+template<size_t Depth, typename Hash>
+void IncrementalMerkleTree<Depth, Hash>::append_batch(const std::vector<Hash>& leaves) {
+    if (leaves.empty()) {
+        return;
+    }
+
+    if ((uint64_t) size() + leaves.size() > ((uint64_t) 1) << Depth) {
+        throw std::runtime_error("tree is full");
+    }
+
+    // Gather the level-0 nodes that are not yet merged into parents: the
+    // current (uncombined) leaf pair, if any, followed by the new leaves.
+    std::vector<Hash> nodes;
+    nodes.reserve(leaves.size() + 2);
+    if (left) {
+        nodes.push_back(*left);
+    }
+    if (right) {
+        nodes.push_back(*right);
+    }
+    nodes.insert(nodes.end(), leaves.begin(), leaves.end());
+    left = std::nullopt;
+    right = std::nullopt;
+
+    // Sequential append() combines a leaf pair lazily, once a third leaf
+    // arrives. Reproduce that exactly so the resulting tree state (and thus
+    // its serialization) matches leaf-at-a-time insertion: the trailing one
+    // or two nodes stay at level 0 uncombined.
+    if (nodes.size() % 2 == 1) {
+        left = nodes.back();
+        nodes.pop_back();
+    } else {
+        right = nodes.back();
+        nodes.pop_back();
+        left = nodes.back();
+        nodes.pop_back();
+    }
+
+    // Combine the remaining nodes pairwise, one batch per level, merging
+    // with the pending subtree stored in parents as we go. Within a level
+    // all hashes are independent, which is what lets combine_batch compute
+    // them in parallel.
+    std::vector<Hash> carry = Hash::combine_batch(nodes, 0);
+    for (size_t i = 0; !carry.empty(); i++) {
+        if (i >= parents.size()) {
+            parents.push_back(std::nullopt);
+        }
+
+        std::vector<Hash> level;
+        level.reserve(carry.size() + 1);
+        if (parents[i]) {
+            level.push_back(*parents[i]);
+            parents[i] = std::nullopt;
+        }
+        level.insert(level.end(), carry.begin(), carry.end());
+
+        // An unpaired trailing node waits at this level for a future
+        // sibling, exactly as sequential insertion would leave it.
+        if (level.size() % 2 == 1) {
+            parents[i] = level.back();
+            level.pop_back();
+        }
+
+        carry = Hash::combine_batch(level, i+1);
+    }
+}
+
 // This is for allowing the witness to determine if a subtree has filled
 // to a particular depth, or for append() to ensure we're not appending
 // to a full tree.
@@ -1112,6 +1224,7 @@ std::deque<Hash> IncrementalWitness<Depth, Hash>::partial_path() const {
 
 template<size_t Depth, typename Hash>
 void IncrementalWitness<Depth, Hash>::append(Hash obj) {
+    cached_root = std::nullopt;
     if (cursor) {
         cursor->append(obj);
 
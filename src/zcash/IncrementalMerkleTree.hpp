@@ -98,6 +98,11 @@ public:
     size_t size() const;
 
     void append(Hash obj);
+    //! Appends a sequence of leaves, making one Hash::combine_batch call
+    //! per affected tree level instead of one Hash::combine call per
+    //! completed node. The resulting tree state is identical to calling
+    //! append() once per leaf, in order.
+    void append_batch(const std::vector<Hash>& leaves);
     Hash root() const {
         return root(Depth, std::deque<Hash>());
     }
@@ -171,8 +176,15 @@ public:
         return tree.size() - 1;
     }
 
+    // The root is re-derived from the shared tree frontier and the partial
+    // path, which costs a full path's worth of hashes; cache it until the
+    // witness is advanced, since spends batch many root() calls against the
+    // same witness state.
     Hash root() const {
-        return tree.root(Depth, partial_path());
+        if (!cached_root) {
+            cached_root = tree.root(Depth, partial_path());
+        }
+        return *cached_root;
     }
 
     void append(Hash obj);
@@ -186,6 +198,9 @@ public:
         READWRITE(cursor);
 
         cursor_depth = tree.next_depth(filled.size());
+        if (ser_action.ForRead()) {
+            cached_root = std::nullopt;
+        }
     }
 
     template <size_t D, typename H>
@@ -197,6 +212,8 @@ private:
     std::vector<Hash> filled;
     std::optional<IncrementalMerkleTree<Depth, Hash>> cursor;
     size_t cursor_depth = 0;
+    // Not serialized and ignored by operator==; purely a recomputation cache.
+    mutable std::optional<Hash> cached_root;
     std::deque<Hash> partial_path() const;
     IncrementalWitness(IncrementalMerkleTree<Depth, Hash> tree) : tree(tree) {}
 };
@@ -221,6 +238,13 @@ public:
         size_t depth
     );
 
+    //! Combines consecutive (left, right) pairs of `nodes` at the given
+    //! depth; `nodes.size()` must be even.
+    static std::vector<SHA256Compress> combine_batch(
+        const std::vector<SHA256Compress>& nodes,
+        size_t depth
+    );
+
     static SHA256Compress uncommitted() {
         return SHA256Compress();
     }
@@ -238,6 +262,14 @@ public:
         size_t depth
     );
 
+    //! Combines consecutive (left, right) pairs of `nodes` at the given
+    //! depth with a single FFI crossing; the hashes are computed in
+    //! parallel on the Rust side. `nodes.size()` must be even.
+    static std::vector<PedersenHash> combine_batch(
+        const std::vector<PedersenHash>& nodes,
+        size_t depth
+    );
+
     static PedersenHash uncommitted();
     static PedersenHash EmptyRoot(size_t);
 };
@@ -10,6 +10,9 @@
 #include "primitives/transaction.h"
 #include "base58.h"
 #include "crypto/equihash.h"
+#ifdef ENABLE_MINING
+#include "pow/tromp/equi_miner.h"
+#endif
 #include "chain.h"
 #include "chainparams.h"
 #include "consensus/upgrades.h"
@@ -153,29 +156,45 @@ double benchmark_verify_joinsplit(const JSDescription &joinsplit)
 #ifdef ENABLE_MINING
 double benchmark_solve_equihash()
 {
-/*
+    // The chain's proof of work is yespower, but the Equihash solver is still
+    // exercised by legacy-height checks and makes a useful benchmark load.
+    // Benchmark with the classic (200,9) parameters that both solvers are
+    // built for; -equihashsolver=tromp selects the cache-optimized
+    // flat-bucket solver from pow/tromp instead of the reference solver.
+    unsigned int n = 200;
+    unsigned int k = 9;
+    eh_HashState eh_state;
+    EhInitialiseState(n, k, eh_state);
+
     CBlock pblock;
     CEquihashInput I{pblock};
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << I;
-
-    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
-    unsigned int n = params.nEquihashN;
-    unsigned int k = params.nEquihashK;
-    eh_HashState eh_state;
-    EhInitialiseState(n, k, eh_state);
     eh_state.Update((unsigned char*)&ss[0], ss.size());
 
     uint256 nonce = GetRandHash();
     eh_state.Update(nonce.begin(), nonce.size());
-*/
+
+    bool fTromp = GetArg("-equihashsolver", "default") == "tromp";
+
     struct timeval tv_start;
     timer_start(tv_start);
-/*
-    std::set<std::vector<unsigned int>> solns;
-    EhOptimisedSolveUncancellable(n, k, eh_state,
-                                  [](std::vector<unsigned char> soln) { return false; });
-*/
+    if (fTromp) {
+        // Single-threaded driver for the tromp solver; each benchmark sample
+        // runs one full solve like the reference path below.
+        equi eq(1);
+        eq.setstate(eh_state.inner.get());
+        eq.digit0(0);
+        eq.xfull = eq.bfull = eq.hfull = 0;
+        for (u32 r = 1; r < WK; r++) {
+            (r&1) ? eq.digitodd(r, 0) : eq.digiteven(r, 0);
+            eq.xfull = eq.bfull = eq.hfull = 0;
+        }
+        eq.digitK(0);
+    } else {
+        EhOptimisedSolveUncancellable(n, k, eh_state,
+                                      [](std::vector<unsigned char> soln) { return false; });
+    }
     return timer_stop(tv_start);
 }
 
@@ -567,6 +586,156 @@ double benchmark_connectblock_slow()
     return duration;
 }
 
+double benchmark_replay_chain(size_t nBlocks)
+{
+    // Caller (zc_benchmark) holds cs_main.
+    const CChainParams& chainparams = Params();
+    CBlockIndex* pindexTip = chainActive.Tip();
+    if (!pindexTip || (size_t)pindexTip->nHeight < nBlocks) {
+        throw std::runtime_error("replaychain: chain is shorter than the requested segment");
+    }
+
+    // The last nBlocks blocks of the active chain, oldest first.
+    std::vector<CBlockIndex*> vSegment;
+    vSegment.reserve(nBlocks);
+    for (CBlockIndex* pindex = pindexTip; pindex && vSegment.size() < nBlocks; pindex = pindex->pprev) {
+        vSegment.push_back(pindex);
+    }
+    std::reverse(vSegment.begin(), vSegment.end());
+
+    // Roll a throwaway view back to the segment start by disconnecting the
+    // segment in reverse. The on-disk chainstate and the live caches are not
+    // touched; the view is simply discarded afterwards.
+    CCoinsViewCache view(pcoinsTip);
+    for (auto it = vSegment.rbegin(); it != vSegment.rend(); ++it) {
+        CBlockIndex* pindex = *it;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus())) {
+            throw std::runtime_error("replaychain: failed to read block from disk");
+        }
+        CValidationState state;
+        if (DisconnectBlock(block, state, pindex, view, chainparams, false) != DISCONNECT_OK) {
+            throw std::runtime_error("replaychain: failed to roll back to segment start");
+        }
+    }
+
+    // Replay with the shortcuts disabled so script and proof verification
+    // actually runs regardless of checkpoints or -assumevalid. Script
+    // parallelism and cache sizes come from the node's own -par/-dbcache.
+    // Run with -debug=bench for ConnectBlock's per-phase timings.
+    bool fCheckpointsSaved = fCheckpointsEnabled;
+    uint256 hashAssumeValidSaved = hashAssumeValid;
+    fCheckpointsEnabled = false;
+    hashAssumeValid.SetNull();
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    try {
+        for (CBlockIndex* pindex : vSegment) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus())) {
+                throw std::runtime_error("replaychain: failed to read block from disk");
+            }
+            CValidationState state;
+            if (!ConnectBlock(block, state, pindex, view, chainparams, true)) {
+                throw std::runtime_error(strprintf("replaychain: ConnectBlock failed at height %d: %s",
+                                                   pindex->nHeight, state.GetRejectReason()));
+            }
+            // fJustCheck skips the best-block update the next iteration asserts on.
+            view.SetBestBlock(pindex->GetBlockHash());
+        }
+    } catch (...) {
+        fCheckpointsEnabled = fCheckpointsSaved;
+        hashAssumeValid = hashAssumeValidSaved;
+        throw;
+    }
+    auto duration = timer_stop(tv_start);
+
+    fCheckpointsEnabled = fCheckpointsSaved;
+    hashAssumeValid = hashAssumeValidSaved;
+
+    LogPrintf("replaychain: replayed %u blocks (heights %d-%d) in %.2fms\n",
+              vSegment.size(), vSegment.front()->nHeight, vSegment.back()->nHeight, duration * 1000);
+    return duration;
+}
+
+double benchmark_replay_mempool(const std::string& strTraceFile)
+{
+    // Caller (zc_benchmark) holds cs_main.
+    const CChainParams& chainparams = Params();
+    fs::path pathTrace = strTraceFile.empty() ? GetDataDir() / "mempool.dat" : fs::path(strTraceFile);
+    FILE* file = fsbridge::fopen(pathTrace, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        throw std::runtime_error(strprintf("replaymempool: failed to open trace file %s", pathTrace.string()));
+    }
+
+    // Parse the whole trace up front so that file I/O and deserialization
+    // stay out of the timed section. The format is that of mempool.dat as
+    // written by DumpMempool, so a trace recorded on a production node can
+    // be copied in and replayed as-is.
+    uint64_t version;
+    filein >> version;
+    if (version != 1) { // MEMPOOL_DUMP_VERSION
+        throw std::runtime_error("replaymempool: unknown trace format version");
+    }
+    uint64_t num;
+    filein >> num;
+    std::vector<std::pair<CTransaction, int64_t>> vTrace;
+    vTrace.reserve(num);
+    while (num--) {
+        CTransaction tx;
+        int64_t nTime;
+        int64_t nFeeDelta;
+        filein >> tx;
+        filein >> nTime;
+        filein >> nFeeDelta;
+        vTrace.emplace_back(tx, nTime);
+    }
+
+    // Feed the recorded transactions through full mempool acceptance into a
+    // throwaway pool, so the node's own mempool is left untouched and the
+    // benchmark can be sampled repeatedly against the same chainstate.
+    CTxMemPool pool(::minRelayTxFee);
+    size_t accepted = 0;
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (const auto& entry : vTrace) {
+        CValidationState state;
+        if (AcceptToMemoryPool(chainparams, pool, state, entry.first, false, NULL, false, entry.second)) {
+            accepted++;
+        }
+    }
+    auto duration = timer_stop(tv_start);
+
+    LogPrintf("replaymempool: replayed %u transactions (%u accepted) in %.2fms\n",
+              vTrace.size(), accepted, duration * 1000);
+    return duration;
+}
+
+#ifdef ENABLE_MINING
+double benchmark_create_block_template()
+{
+    // Caller (zc_benchmark) holds cs_main. Assemble a block template over
+    // the node's current mempool through the same path the internal miner
+    // and getblocktemplate use; run after replaying a mempool trace (or on
+    // a node with a live mempool) to measure template assembly on a real
+    // workload.
+    boost::shared_ptr<CReserveScript> coinbaseScript(new CReserveScript());
+    coinbaseScript->reserveScript = CScript() << OP_TRUE;
+    MinerAddress minerAddress = coinbaseScript;
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    std::unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(Params(), minerAddress));
+    auto duration = timer_stop(tv_start);
+    if (!pblocktemplate) {
+        throw std::runtime_error("createblocktemplate: CreateNewBlock failed");
+    }
+    return duration;
+}
+#endif // ENABLE_MINING
+
 extern UniValue getnewaddress(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue sendtoaddress(const UniValue& params, bool fHelp);
 
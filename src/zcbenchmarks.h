@@ -17,6 +17,11 @@ extern double benchmark_try_decrypt_sapling_notes(size_t nAddrs);
 extern double benchmark_increment_sprout_note_witnesses(size_t nTxs);
 extern double benchmark_increment_sapling_note_witnesses(size_t nTxs);
 extern double benchmark_connectblock_slow();
+extern double benchmark_replay_chain(size_t nBlocks);
+extern double benchmark_replay_mempool(const std::string& strTraceFile);
+#ifdef ENABLE_MINING
+extern double benchmark_create_block_template();
+#endif
 extern double benchmark_sendtoaddress(CAmount amount);
 extern double benchmark_loadwallet();
 extern double benchmark_listunspent();
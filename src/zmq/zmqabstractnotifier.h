@@ -24,6 +24,8 @@ public:
         return new T();
     }
 
+    bool IsActive() const { return psocket != 0; }
+
     std::string GetType() const { return type; }
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
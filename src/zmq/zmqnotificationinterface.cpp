@@ -108,6 +108,10 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    // All sockets are bound; from here on they are only touched by the
+    // publish thread, which drains the bounded message queue.
+    StartZMQPublishThread();
+
     return true;
 }
 
@@ -117,6 +121,10 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // Stop the publish thread (draining its backlog) before the sockets
+        // it writes to are closed.
+        StopZMQPublishThread();
+
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
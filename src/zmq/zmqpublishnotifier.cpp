@@ -7,6 +7,12 @@
 #include "main.h"
 #include "util.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK = "hashblock";
@@ -15,6 +21,110 @@ static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_CHECKEDBLOCK = "checkedblock";
 
+/** A message copied out of a validation thread, awaiting publication. */
+struct CZMQQueuedMessage
+{
+    CZMQAbstractPublishNotifier* notifier;
+    const char* command; //!< one of the static MSG_* strings
+    std::vector<unsigned char> data;
+};
+
+/** Bounded queue between the validation interface callbacks and the publish
+ * thread. Enqueue never blocks: when the queue is full a message is dropped
+ * instead, so consensus-critical threads cannot stall on a slow subscriber.
+ */
+class CZMQPublishQueue
+{
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<CZMQQueuedMessage> queue;
+    bool running;
+    size_t maxDepth;
+    bool fDropOldest;
+    uint64_t nDropped;
+
+public:
+    CZMQPublishQueue(size_t maxDepthIn, bool fDropOldestIn) : running(true),
+                                                              maxDepth(maxDepthIn),
+                                                              fDropOldest(fDropOldestIn),
+                                                              nDropped(0)
+    {
+    }
+
+    void Enqueue(CZMQAbstractPublishNotifier* notifier, const char* command, const void* data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (queue.size() >= maxDepth)
+        {
+            nDropped++;
+            LogPrint("zmq", "zmq: publish queue full, dropping %s message (%d dropped so far)\n",
+                     fDropOldest ? queue.front().command : command, nDropped);
+            if (!fDropOldest)
+                return;
+            queue.pop_front();
+        }
+        CZMQQueuedMessage msg;
+        msg.notifier = notifier;
+        msg.command = command;
+        msg.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+        queue.push_back(std::move(msg));
+        cond.notify_one();
+    }
+
+    void Run()
+    {
+        RenameThread("koto-zmqpub");
+        while (true)
+        {
+            CZMQQueuedMessage msg;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (running && queue.empty())
+                    cond.wait(lock);
+                // drain the backlog before exiting, so subscribers still see
+                // messages queued just before shutdown
+                if (!running && queue.empty())
+                    break;
+                msg = std::move(queue.front());
+                queue.pop_front();
+            }
+            if (!msg.notifier->IsActive())
+                continue;
+            if (!msg.notifier->SendMessage(msg.command, msg.data.data(), msg.data.size()))
+                zmqError("Failed to publish queued message");
+        }
+    }
+
+    void Interrupt()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        running = false;
+        cond.notify_all();
+    }
+};
+
+static CZMQPublishQueue* publishQueue = 0;
+static std::thread threadZMQPublish;
+
+void StartZMQPublishThread()
+{
+    assert(!publishQueue);
+    size_t nDepth = (size_t)std::max((long)GetArg("-zmqhwm", DEFAULT_ZMQ_SNDHWM), 1L);
+    publishQueue = new CZMQPublishQueue(nDepth, GetBoolArg("-zmqdropoldest", true));
+    threadZMQPublish = std::thread(&CZMQPublishQueue::Run, publishQueue);
+}
+
+void StopZMQPublishThread()
+{
+    if (!publishQueue)
+        return;
+    publishQueue->Interrupt();
+    threadZMQPublish.join();
+    delete publishQueue;
+    publishQueue = 0;
+}
+
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 {
@@ -71,6 +181,14 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
+        const int sndhwm = (int)std::max((long)GetArg("-zmqhwm", DEFAULT_ZMQ_SNDHWM), 1L);
+        if (zmq_setsockopt(psocket, ZMQ_SNDHWM, &sndhwm, sizeof(sndhwm)) != 0)
+        {
+            zmqError("Failed to set send high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
         int rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
@@ -141,6 +259,19 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
+bool CZMQAbstractPublishNotifier::QueueMessage(const char *command, const void* data, size_t size)
+{
+    assert(psocket);
+
+    // Publish thread not running (e.g. during tests); fall back to a
+    // synchronous send.
+    if (!publishQueue)
+        return SendMessage(command, data, size);
+
+    publishQueue->Enqueue(this, command, data, size);
+    return true;
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
@@ -148,7 +279,7 @@ bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     char data[32];
     for (unsigned int i = 0; i < 32; i++)
         data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHBLOCK, data, 32);
+    return QueueMessage(MSG_HASHBLOCK, data, 32);
 }
 
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -158,7 +289,7 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     char data[32];
     for (unsigned int i = 0; i < 32; i++)
         data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTX, data, 32);
+    return QueueMessage(MSG_HASHTX, data, 32);
 }
 
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
@@ -179,7 +310,7 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
         ss << block;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return QueueMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
 }
 
 bool CZMQPublishCheckedBlockNotifier::NotifyBlock(const CBlock& block)
@@ -192,7 +323,7 @@ bool CZMQPublishCheckedBlockNotifier::NotifyBlock(const CBlock& block)
         ss << block;
     }
 
-    return SendMessage(MSG_CHECKEDBLOCK, &(*ss.begin()), ss.size());
+    return QueueMessage(MSG_CHECKEDBLOCK, &(*ss.begin()), ss.size());
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -201,5 +332,5 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    return QueueMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
@@ -9,6 +9,10 @@
 
 class CBlockIndex;
 
+//! Default -zmqhwm: bound for the internal publish queue and the socket's
+//! ZMQ_SNDHWM (matches libzmq's own default high water mark)
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
@@ -21,13 +25,24 @@ public:
           * command
           * data
           * message sequence number
+
+       called only from the dedicated publish thread
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
+    /* copy the message into the bounded publish queue without ever blocking
+       the calling (validation) thread; when the queue is full a message is
+       dropped according to -zmqdropoldest */
+    bool QueueMessage(const char *command, const void* data, size_t size);
+
     bool Initialize(void *pcontext);
     void Shutdown();
 };
 
+/** Start/stop the thread that drains the publish queue into the ZMQ sockets */
+void StartZMQPublishThread();
+void StopZMQPublishThread();
+
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public: